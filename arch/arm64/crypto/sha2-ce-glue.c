@@ -15,6 +15,7 @@
 #include <linux/cpufeature.h>
 #include <linux/crypto.h>
 #include <linux/module.h>
+#include <linux/sched.h>
 
 MODULE_DESCRIPTION("SHA-224/SHA-256 secure hash using ARMv8 Crypto Extensions");
 MODULE_AUTHOR("Ard Biesheuvel <ard.biesheuvel@linaro.org>");
@@ -33,6 +34,11 @@ extern const u32 sha256_ce_offsetof_finalize;
 asmlinkage int sha2_ce_transform(struct sha256_ce_state *sst, u8 const *src,
 				 int blocks);
 
+asmlinkage void __sha256_ce_finup2x(const struct sha256_state *sctx,
+				    const u8 *data1, const u8 *data2, int len,
+				    u8 out1[SHA256_DIGEST_SIZE],
+				    u8 out2[SHA256_DIGEST_SIZE]);
+
 static void __sha2_ce_transform(struct sha256_state *sst, u8 const *src,
 				int blocks)
 {
@@ -48,6 +54,27 @@ static void __sha2_ce_transform(struct sha256_state *sst, u8 const *src,
 	}
 }
 
+/*
+ * Like __sha2_ce_transform(), but for callers that already own the NEON
+ * unit: only give it up briefly when the asm code asks to yield.
+ */
+static void __sha2_ce_transform_held(struct sha256_state *sst, u8 const *src,
+				     int blocks)
+{
+	while (blocks) {
+		int rem;
+
+		rem = sha2_ce_transform(container_of(sst, struct sha256_ce_state,
+						     sst), src, blocks);
+		src += (blocks - rem) * SHA256_BLOCK_SIZE;
+		blocks = rem;
+		if (rem) {
+			kernel_neon_end();
+			kernel_neon_begin();
+		}
+	}
+}
+
 const u32 sha256_ce_offsetof_count = offsetof(struct sha256_ce_state,
 					      sst.count);
 const u32 sha256_ce_offsetof_finalize = offsetof(struct sha256_ce_state,
@@ -102,6 +129,61 @@ static int sha256_ce_finup(struct shash_desc *desc, const u8 *data,
 	return sha256_base_finish(desc, out);
 }
 
+#define SHA256_CE_MAX_MSGS	8
+
+/*
+ * Finish several messages from the same starting state inside a single
+ * kernel_neon_begin()/end() section, so fs-verity and dm-verity pay for the
+ * FPSIMD state save/restore once per batch instead of once per block.  Pairs
+ * of SHA-256 messages go through the interleaved two-lane routine; an odd
+ * one out and SHA-224 (whose digest is shorter) are hashed one at a time.
+ */
+static int sha256_ce_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			      unsigned int len, u8 * const outs[],
+			      unsigned int num_msgs)
+{
+	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
+	SHASH_DESC_ON_STACK(mdesc, desc->tfm);
+	struct sha256_ce_state *mctx = shash_desc_ctx(mdesc);
+	bool finalize = !sctx->sst.count && !(len % SHA256_BLOCK_SIZE) && len;
+	bool interleave = crypto_shash_digestsize(desc->tfm) ==
+			  SHA256_DIGEST_SIZE &&
+			  len >= SHA256_BLOCK_SIZE && len <= INT_MAX;
+	unsigned int i = 0;
+
+	/* __sha256_ce_finup2x() assumes the following offsets. */
+	BUILD_BUG_ON(offsetof(struct sha256_state, state) != 0);
+	BUILD_BUG_ON(offsetof(struct sha256_state, count) != 32);
+	BUILD_BUG_ON(offsetof(struct sha256_state, buf) != 40);
+
+	if (!crypto_simd_usable())
+		return -EOPNOTSUPP;
+
+	mdesc->tfm = desc->tfm;
+	kernel_neon_begin();
+	for (; interleave && i + 2 <= num_msgs; i += 2) {
+		__sha256_ce_finup2x(&sctx->sst, data[i], data[i + 1], len,
+				    outs[i], outs[i + 1]);
+		if (need_resched()) {
+			kernel_neon_end();
+			kernel_neon_begin();
+		}
+	}
+	for (; i < num_msgs; i++) {
+		*mctx = *sctx;
+		mctx->finalize = finalize;
+		sha256_base_do_update(mdesc, data[i], len,
+				      __sha2_ce_transform_held);
+		if (!finalize)
+			sha256_base_do_finalize(mdesc, __sha2_ce_transform_held);
+		sha256_base_finish(mdesc, outs[i]);
+	}
+	kernel_neon_end();
+	shash_desc_zero(mdesc);
+	memzero_explicit(sctx, sizeof(*sctx));
+	return 0;
+}
+
 static int sha256_ce_final(struct shash_desc *desc, u8 *out)
 {
 	struct sha256_ce_state *sctx = shash_desc_ctx(desc);
@@ -138,6 +220,8 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
+	.mb_max_msgs		= SHA256_CE_MAX_MSGS,
 	.export			= sha256_ce_export,
 	.import			= sha256_ce_import,
 	.descsize		= sizeof(struct sha256_ce_state),
@@ -155,6 +239,8 @@ static struct shash_alg algs[] = { {
 	.update			= sha256_ce_update,
 	.final			= sha256_ce_final,
 	.finup			= sha256_ce_finup,
+	.finup_mb		= sha256_ce_finup_mb,
+	.mb_max_msgs		= SHA256_CE_MAX_MSGS,
 	.export			= sha256_ce_export,
 	.import			= sha256_ce_import,
 	.descsize		= sizeof(struct sha256_ce_state),
@@ -1052,6 +1052,10 @@ struct kvm_vcpu_stat {
 	u64 mmio_exit_kernel;
 	u64 signal_exits;
 	u64 exits;
+	u64 pkvm_s2_faults;
+	u64 pkvm_map_hypercalls;
+	u64 pkvm_block_maps;
+	u64 pkvm_fault_around;
 };
 
 unsigned long kvm_arm_num_regs(struct kvm_vcpu *vcpu);
@@ -911,6 +911,15 @@ __SYSCALL(__NR_set_mempolicy_home_node, sys_set_mempolicy_home_node)
 __SYSCALL(__NR_cachestat, sys_cachestat)
 #define __NR_fchmodat2 452
 __SYSCALL(__NR_fchmodat2, sys_fchmodat2)
+#define __NR_map_shadow_stack 453
+__SYSCALL(__NR_map_shadow_stack, sys_map_shadow_stack)
+#define __NR_futex_wake 454
+__SYSCALL(__NR_futex_wake, sys_futex_wake)
+#define __NR_futex_wait 455
+__SYSCALL(__NR_futex_wait, sys_futex_wait)
+/* Not upstream, see include/uapi/asm-generic/unistd.h */
+#define __NR_finit_module_batch 500
+__SYSCALL(__NR_finit_module_batch, sys_finit_module_batch)
 
 /*
  * Please add new compat syscalls above this comment and update
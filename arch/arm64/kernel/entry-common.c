@@ -136,7 +136,7 @@ static __always_inline void exit_to_user_mode_prepare(struct pt_regs *regs)
 	local_daif_mask();
 
 	flags = read_thread_flags();
-	if (unlikely(flags & _TIF_WORK_MASK))
+	if (unlikely(thread_work_flags(flags)))
 		do_notify_resume(regs, flags);
 
 	lockdep_sys_exit();
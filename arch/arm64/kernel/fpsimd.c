@@ -16,6 +16,7 @@
 #include <linux/cpu.h>
 #include <linux/cpu_pm.h>
 #include <linux/ctype.h>
+#include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/linkage.h>
 #include <linux/irqflags.h>
@@ -24,6 +25,7 @@
 #include <linux/prctl.h>
 #include <linux/preempt.h>
 #include <linux/ptrace.h>
+#include <linux/seq_file.h>
 #include <linux/sched/signal.h>
 #include <linux/sched/task_stack.h>
 #include <linux/signal.h>
@@ -213,6 +215,7 @@ DEFINE_PER_CPU(bool, fpsimd_context_busy);
 EXPORT_PER_CPU_SYMBOL(fpsimd_context_busy);
 
 static void fpsimd_bind_task_to_cpu(void);
+static void fpsimd_lazy_stop(void);
 
 static void __get_cpu_fpsimd_context(void)
 {
@@ -1475,6 +1478,7 @@ void do_sve_acc(unsigned long esr, struct pt_regs *regs)
 
 	get_cpu_fpsimd_context();
 
+	fpsimd_lazy_stop();
 	if (test_and_set_thread_flag(TIF_SVE))
 		WARN_ON(1); /* SVE access shouldn't have trapped */
 
@@ -1527,6 +1531,7 @@ void do_sme_acc(unsigned long esr, struct pt_regs *regs)
 
 	get_cpu_fpsimd_context();
 
+	fpsimd_lazy_stop();
 	/* With TIF_SME userspace shouldn't generate any traps */
 	if (test_and_set_thread_flag(TIF_SME))
 		WARN_ON(1);
@@ -1542,13 +1547,138 @@ void do_sme_acc(unsigned long esr, struct pt_regs *regs)
 	put_cpu_fpsimd_context();
 }
 
+/*
+ * Lazy FPSIMD: a user task which has been switched in fpsimd_lazy_switches
+ * times since it last took an FPSIMD access trap is assumed to have stopped
+ * using FPSIMD. It then gets TIF_FPSIMD_TRAP, which makes it return to
+ * userspace with EL0 FPSIMD access disabled instead of reloading its
+ * registers. Its state stays in memory with TIF_FOREIGN_FPSTATE set, so
+ * nothing needs saving when it is switched out again, until the first
+ * FPSIMD instruction traps into do_fpsimd_acc() and the task goes back to
+ * eager mode. Tasks with SVE or SME state are never made lazy.
+ *
+ * CPACR_EL1.FPEN's EL0 bit follows TIF_FPSIMD_TRAP of current: it is set
+ * up on every context switch and only ever enabled in between.
+ */
+static unsigned int fpsimd_lazy_switches __read_mostly;
+
+struct fpsimd_lazy_stats {
+	unsigned long	saves;		/* registers saved on switch out */
+	unsigned long	restores;	/* registers loaded on return to user */
+	unsigned long	skips;		/* switched in lazily */
+	unsigned long	traps;		/* lazy tasks which trapped */
+};
+
+static DEFINE_PER_CPU(struct fpsimd_lazy_stats, fpsimd_lazy_stats);
+
+static inline void fpsimd_user_trap(bool trap)
+{
+	if (trap)
+		sysreg_clear_set(cpacr_el1, CPACR_EL1_FPEN_EL0EN, 0);
+	else
+		sysreg_clear_set(cpacr_el1, 0, CPACR_EL1_FPEN_EL0EN);
+}
+
+/*
+ * Called on switching from current to next, with the cpu FPSIMD context
+ * held.
+ */
+static void fpsimd_lazy_switch(struct task_struct *next)
+{
+	unsigned int limit = READ_ONCE(fpsimd_lazy_switches);
+	struct thread_struct *thread = &current->thread;
+	bool trap;
+
+	if (!(current->flags & PF_KTHREAD) && limit &&
+	    !test_thread_flag(TIF_FPSIMD_TRAP) &&
+	    !test_thread_flag(TIF_SVE) && !test_thread_flag(TIF_SME) &&
+	    ++thread->fpsimd_switches >= limit)
+		set_thread_flag(TIF_FPSIMD_TRAP);
+
+	trap = test_tsk_thread_flag(next, TIF_FPSIMD_TRAP);
+	if (trap)
+		__this_cpu_inc(fpsimd_lazy_stats.skips);
+	fpsimd_user_trap(trap);
+}
+
+/*
+ * Put current back into eager mode, with the cpu FPSIMD context held.
+ * TIF_FOREIGN_FPSTATE gets handled on the way back to userspace.
+ */
+static void fpsimd_lazy_stop(void)
+{
+	current->thread.fpsimd_switches = 0;
+	if (test_and_clear_thread_flag(TIF_FPSIMD_TRAP))
+		fpsimd_user_trap(false);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int fpsimd_lazy_stats_show(struct seq_file *m, void *v)
+{
+	struct fpsimd_lazy_stats *st;
+	int cpu;
+
+	seq_puts(m, "cpu saves restores skips traps\n");
+	for_each_online_cpu(cpu) {
+		st = per_cpu_ptr(&fpsimd_lazy_stats, cpu);
+		seq_printf(m, "%d %lu %lu %lu %lu\n", cpu, READ_ONCE(st->saves),
+			   READ_ONCE(st->restores), READ_ONCE(st->skips),
+			   READ_ONCE(st->traps));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fpsimd_lazy_stats);
+
+static int __init fpsimd_lazy_debugfs_init(void)
+{
+	if (system_supports_fpsimd())
+		debugfs_create_file("fpsimd_lazy_stats", 0444, NULL, NULL,
+				    &fpsimd_lazy_stats_fops);
+	return 0;
+}
+late_initcall(fpsimd_lazy_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
+
+#ifdef CONFIG_SYSCTL
+static struct ctl_table fpsimd_lazy_table[] = {
+	{
+		.procname	= "fpsimd_lazy_switches",
+		.data		= &fpsimd_lazy_switches,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
+	{ }
+};
+
+static int __init fpsimd_lazy_sysctl_init(void)
+{
+	if (!register_sysctl("abi", fpsimd_lazy_table))
+		return -EINVAL;
+
+	return 0;
+}
+#else
+static int __init fpsimd_lazy_sysctl_init(void) { return 0; }
+#endif /* CONFIG_SYSCTL */
+
 /*
  * Trapped FP/ASIMD access.
  */
 void do_fpsimd_acc(unsigned long esr, struct pt_regs *regs)
 {
-	/* TODO: implement lazy context saving/restoring */
-	WARN_ON(1);
+	if (WARN_ON(!system_supports_fpsimd())) {
+		force_signal_inject(SIGILL, ILL_ILLOPC, regs->pc, 0);
+		return;
+	}
+
+	get_cpu_fpsimd_context();
+
+	if (test_thread_flag(TIF_FPSIMD_TRAP))
+		__this_cpu_inc(fpsimd_lazy_stats.traps);
+	fpsimd_lazy_stop();
+
+	put_cpu_fpsimd_context();
 }
 
 /*
@@ -1586,7 +1716,10 @@ void fpsimd_thread_switch(struct task_struct *next)
 	__get_cpu_fpsimd_context();
 
 	/* Save unsaved fpsimd state, if any: */
+	if (!test_thread_flag(TIF_FOREIGN_FPSTATE))
+		__this_cpu_inc(fpsimd_lazy_stats.saves);
 	fpsimd_save();
+	fpsimd_lazy_switch(next);
 
 	/*
 	 * Fix up TIF_FOREIGN_FPSTATE to correctly describe next's
@@ -1649,6 +1782,7 @@ void fpsimd_flush_thread(void)
 	get_cpu_fpsimd_context();
 
 	fpsimd_flush_task_state(current);
+	fpsimd_lazy_stop();
 	memset(&current->thread.uw.fpsimd_state, 0,
 	       sizeof(current->thread.uw.fpsimd_state));
 
@@ -1711,6 +1845,13 @@ void fpsimd_signal_preserve_current_state(void)
  */
 void fpsimd_kvm_prepare(void)
 {
+	/* KVM manages CPACR_EL1 itself, keep the vcpu thread eager */
+	if (system_supports_fpsimd() && test_thread_flag(TIF_FPSIMD_TRAP)) {
+		get_cpu_fpsimd_context();
+		fpsimd_lazy_stop();
+		put_cpu_fpsimd_context();
+	}
+
 	if (!system_supports_sve())
 		return;
 
@@ -1805,6 +1946,7 @@ void fpsimd_restore_current_state(void)
 	get_cpu_fpsimd_context();
 
 	if (test_and_clear_thread_flag(TIF_FOREIGN_FPSTATE)) {
+		__this_cpu_inc(fpsimd_lazy_stats.restores);
 		task_fpsimd_load();
 		fpsimd_bind_task_to_cpu();
 	}
@@ -2146,6 +2288,7 @@ static int __init fpsimd_init(void)
 
 	sve_sysctl_init();
 	sme_sysctl_init();
+	fpsimd_lazy_sysctl_init();
 
 	return 0;
 }
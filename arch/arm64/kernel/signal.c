@@ -1309,13 +1309,13 @@ void do_notify_resume(struct pt_regs *regs, unsigned long thread_flags)
 			if (thread_flags & _TIF_NOTIFY_RESUME)
 				resume_user_mode_work(regs);
 
-			if (thread_flags & _TIF_FOREIGN_FPSTATE)
+			if (thread_work_flags(thread_flags) & _TIF_FOREIGN_FPSTATE)
 				fpsimd_restore_current_state();
 		}
 
 		local_daif_mask();
 		thread_flags = read_thread_flags();
-	} while (thread_flags & _TIF_WORK_MASK);
+	} while (thread_work_flags(thread_flags));
 }
 
 unsigned long __ro_after_init signal_minsigstksz;
@@ -53,7 +53,11 @@ const struct _kvm_stats_desc kvm_vcpu_stats_desc[] = {
 	STATS_DESC_COUNTER(VCPU, mmio_exit_user),
 	STATS_DESC_COUNTER(VCPU, mmio_exit_kernel),
 	STATS_DESC_COUNTER(VCPU, signal_exits),
-	STATS_DESC_COUNTER(VCPU, exits)
+	STATS_DESC_COUNTER(VCPU, exits),
+	STATS_DESC_COUNTER(VCPU, pkvm_s2_faults),
+	STATS_DESC_COUNTER(VCPU, pkvm_map_hypercalls),
+	STATS_DESC_COUNTER(VCPU, pkvm_block_maps),
+	STATS_DESC_COUNTER(VCPU, pkvm_fault_around)
 };
 
 const struct kvm_stats_header kvm_vcpu_stats_header = {
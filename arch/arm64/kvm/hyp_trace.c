@@ -5,10 +5,13 @@
 
 #include <linux/arm-smccc.h>
 #include <linux/list.h>
+#include <linux/mm.h>
 #include <linux/percpu-defs.h>
 #include <linux/trace_events.h>
 #include <linux/tracefs.h>
 
+#include <uapi/linux/trace_mmap.h>
+
 #include <asm/kvm_host.h>
 #include <asm/kvm_hyptrace.h>
 #include <asm/kvm_hypevents_defs.h>
@@ -716,9 +719,99 @@ static int hyp_trace_raw_release(struct inode *inode, struct file *file)
 	return hyp_trace_pipe_release(inode, file);
 }
 
+static __poll_t hyp_trace_raw_poll(struct file *file, poll_table *wait)
+{
+	struct ht_iterator *iter = file->private_data;
+
+	return ring_buffer_poll_wait(iter->hyp_buffer->trace_buffer, iter->cpu,
+				     file, wait, 0);
+}
+
+static long hyp_trace_raw_ioctl(struct file *file, unsigned int cmd,
+				unsigned long arg)
+{
+	struct ht_iterator *iter = file->private_data;
+	struct trace_buffer *trace_buffer = iter->hyp_buffer->trace_buffer;
+	int ret;
+
+	if (cmd != TRACE_MMAP_IOCTL_GET_READER)
+		return -ENOIOCTLCMD;
+
+	if (!(file->f_flags & O_NONBLOCK)) {
+		ret = ring_buffer_wait(trace_buffer, iter->cpu, 0);
+		if (ret)
+			return ret;
+	}
+
+	return ring_buffer_map_get_reader_page(trace_buffer, iter->cpu);
+}
+
+static vm_fault_t hyp_trace_raw_mmap_fault(struct vm_fault *vmf)
+{
+	struct ht_iterator *iter = vmf->vma->vm_file->private_data;
+	struct page *page;
+
+	page = ring_buffer_map_fault(iter->hyp_buffer->trace_buffer, iter->cpu,
+				     vmf->pgoff);
+	if (!page)
+		return VM_FAULT_SIGBUS;
+
+	get_page(page);
+	vmf->page = page;
+
+	return 0;
+}
+
+static void hyp_trace_raw_mmap_open(struct vm_area_struct *vma)
+{
+	struct ht_iterator *iter = vma->vm_file->private_data;
+
+	WARN_ON(ring_buffer_map(iter->hyp_buffer->trace_buffer, iter->cpu));
+}
+
+static void hyp_trace_raw_mmap_close(struct vm_area_struct *vma)
+{
+	struct ht_iterator *iter = vma->vm_file->private_data;
+
+	WARN_ON(ring_buffer_unmap(iter->hyp_buffer->trace_buffer, iter->cpu));
+}
+
+static const struct vm_operations_struct hyp_trace_raw_vmops = {
+	.open		= hyp_trace_raw_mmap_open,
+	.close		= hyp_trace_raw_mmap_close,
+	.fault		= hyp_trace_raw_mmap_fault,
+};
+
+/*
+ * Same layout as the host's trace_pipe_raw mapping: the meta-page followed
+ * by the data pages the hypervisor writes to, so events are consumed in
+ * place. TRACE_MMAP_IOCTL_GET_READER only calls into the hypervisor once
+ * the reader page has been fully consumed.
+ */
+static int hyp_trace_raw_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct ht_iterator *iter = file->private_data;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	ret = ring_buffer_map(iter->hyp_buffer->trace_buffer, iter->cpu);
+	if (ret)
+		return ret;
+
+	vm_flags_mod(vma, VM_DONTCOPY | VM_DONTDUMP, VM_MAYWRITE);
+	vma->vm_ops = &hyp_trace_raw_vmops;
+
+	return 0;
+}
+
 static const struct file_operations hyp_trace_raw_fops = {
 	.open           = hyp_trace_raw_open,
 	.read           = hyp_trace_raw_read,
+	.poll		= hyp_trace_raw_poll,
+	.unlocked_ioctl	= hyp_trace_raw_ioctl,
+	.mmap		= hyp_trace_raw_mmap,
 	.release        = hyp_trace_raw_release,
 	.llseek         = no_llseek,
 };
@@ -1666,7 +1666,7 @@ static int pkvm_relax_perms(struct kvm_vcpu *vcpu, u64 pfn, u64 gfn, u8 order,
 
 static int pkvm_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t *fault_ipa,
 			  struct kvm_memory_slot *memslot, unsigned long hva,
-			  size_t *size)
+			  size_t *size, bool prefault)
 {
 	unsigned int flags = FOLL_HWPOISON | FOLL_LONGTERM | FOLL_WRITE;
 	struct kvm_hyp_memcache *hyp_memcache = &vcpu->arch.stage2_mc;
@@ -1696,6 +1696,9 @@ static int pkvm_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t *fault_ipa,
 	mmap_read_unlock(mm);
 
 	if (ret == -EHWPOISON) {
+		/* Leave it to the guest to touch it, if it ever does */
+		if (prefault)
+			goto free_ppage;
 		kvm_send_hwpoison_signal(hva, PAGE_SHIFT);
 		ret = 0;
 		goto free_ppage;
@@ -1728,9 +1731,6 @@ static int pkvm_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t *fault_ipa,
 						fault_ipa);
 	page = pfn_to_page(pfn);
 
-	if (size)
-		*size = page_size;
-
 retry:
 	ret = account_locked_vm(mm, page_size >> PAGE_SHIFT, true);
 	if (ret)
@@ -1749,11 +1749,16 @@ static int pkvm_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t *fault_ipa,
 		*fault_ipa += pmd_offset;
 		pfn += pmd_offset >> PAGE_SHIFT;
 		page = pfn_to_page(pfn);
-		page_size = PAGE_SIZE;
 		account_locked_vm(mm, page_size >> PAGE_SHIFT, false);
+		page_size = PAGE_SIZE;
 		goto retry;
 	}
 
+	/* Only now is it known whether the THP can be mapped as a block */
+	if (size)
+		*size = page_size;
+
+	vcpu->stat.pkvm_map_hypercalls++;
 	ret = pkvm_host_map_guest(pfn, *fault_ipa >> PAGE_SHIFT,
 				  page_size >> PAGE_SHIFT, KVM_PGTABLE_PROT_R);
 	if (ret) {
@@ -1771,6 +1776,9 @@ static int pkvm_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t *fault_ipa,
 
 	write_unlock(&kvm->mmu_lock);
 
+	if (page_size > PAGE_SIZE)
+		vcpu->stat.pkvm_block_maps++;
+
 	return 0;
 
 dec_account:
@@ -1823,7 +1831,8 @@ int pkvm_mem_abort_range(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa, size_t si
 			}
 
 			read_unlock(&vcpu->kvm->mmu_lock);
-			err = pkvm_mem_abort(vcpu, &fault_ipa, memslot, hva, &page_size);
+			err = pkvm_mem_abort(vcpu, &fault_ipa, memslot, hva,
+					     &page_size, false);
 			read_lock(&vcpu->kvm->mmu_lock);
 			if (err)
 				goto end;
@@ -1845,6 +1854,61 @@ int pkvm_mem_abort_range(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa, size_t si
 	return err;
 }
 
+/*
+ * Number of pages following a page granular stage-2 fault of a protected
+ * guest which are mapped along with it, without going past the end of the
+ * faulting PMD block. Guests mostly populate their memory sequentially at
+ * boot, and each fault is a round trip through the hypervisor. Disabled by
+ * default since it donates memory the guest has not touched yet, possibly
+ * again after the guest relinquished it.
+ */
+static unsigned int pkvm_fault_around_pages;
+
+static int __init early_pkvm_fault_around_cfg(char *arg)
+{
+	return kstrtouint(arg, 0, &pkvm_fault_around_pages);
+}
+early_param("kvm-arm.pkvm_fault_around", early_pkvm_fault_around_cfg);
+
+static void pkvm_fault_around(struct kvm_vcpu *vcpu, phys_addr_t ipa,
+			      struct kvm_memory_slot *memslot)
+{
+	struct kvm *kvm = vcpu->kvm;
+	struct kvm_pinned_page *ppage;
+	phys_addr_t end;
+	size_t size = 0;
+
+	end = min(ALIGN_DOWN(ipa, PMD_SIZE) + PMD_SIZE,
+		  ipa + ((phys_addr_t)pkvm_fault_around_pages + 1) * PAGE_SIZE);
+	end = min(end, kvm_phys_size(kvm));
+
+	for (ipa += PAGE_SIZE; ipa < end; ipa += PAGE_SIZE) {
+		gfn_t gfn = gpa_to_gfn(ipa);
+		unsigned long hva;
+		bool writable;
+
+		if (gfn >= memslot->base_gfn + memslot->npages)
+			break;
+
+		/* Stop at the first page the guest already has */
+		read_lock(&kvm->mmu_lock);
+		ppage = find_ppage(kvm, ipa);
+		read_unlock(&kvm->mmu_lock);
+		if (ppage)
+			break;
+
+		hva = gfn_to_hva_memslot_prot(memslot, gfn, &writable);
+		if (kvm_is_error_hva(hva) || !writable)
+			break;
+
+		if (pkvm_mem_abort(vcpu, &ipa, memslot, hva, &size, true) ||
+		    size != PAGE_SIZE)
+			break;
+
+		vcpu->stat.pkvm_fault_around++;
+	}
+}
+
 static int user_mem_abort(struct kvm_vcpu *vcpu, phys_addr_t fault_ipa,
 			  struct kvm_memory_slot *memslot, unsigned long hva,
 			  unsigned long fault_status)
@@ -2219,10 +2283,17 @@ int kvm_handle_guest_abort(struct kvm_vcpu *vcpu)
 		goto out_unlock;
 	}
 
-	if (is_protected_kvm_enabled() && fault_status != ESR_ELx_FSC_PERM)
-		ret = pkvm_mem_abort(vcpu, &fault_ipa, memslot, hva, NULL);
-	else
+	if (is_protected_kvm_enabled() && fault_status != ESR_ELx_FSC_PERM) {
+		size_t size = 0;
+
+		vcpu->stat.pkvm_s2_faults++;
+		ret = pkvm_mem_abort(vcpu, &fault_ipa, memslot, hva, &size,
+				     false);
+		if (!ret && size == PAGE_SIZE && pkvm_fault_around_pages)
+			pkvm_fault_around(vcpu, fault_ipa, memslot);
+	} else {
 		ret = user_mem_abort(vcpu, fault_ipa, memslot, hva, fault_status);
+	}
 
 	if (ret == 0)
 		ret = 1;
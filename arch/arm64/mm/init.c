@@ -555,6 +555,18 @@ void __init mem_init(void)
 	}
 }
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+int __init deferred_page_init_max_threads(const struct cpumask *node_cpumask)
+{
+	/*
+	 * Most arm64 systems have a single node, so the per-node init thread
+	 * is the only one unless its section chunks are spread over all of
+	 * the node's CPUs.  Nothing else is running yet, so use them all.
+	 */
+	return max_t(int, cpumask_weight(node_cpumask), 1);
+}
+#endif
+
 void free_initmem(void)
 {
 	free_reserved_area(lm_alias(__init_begin),
@@ -275,6 +275,7 @@ static void blk_free_queue_rcu(struct rcu_head *rcu_head)
 
 static void blk_free_queue(struct request_queue *q)
 {
+	blk_mq_poll_stats_free(q);
 	blk_free_queue_stats(q->stats);
 	blk_disable_sub_page_limits(&q->limits);
 	if (queue_is_mq(q))
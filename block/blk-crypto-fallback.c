@@ -13,6 +13,7 @@
 #include <linux/blk-crypto.h>
 #include <linux/blk-crypto-profile.h>
 #include <linux/blkdev.h>
+#include <linux/completion.h>
 #include <linux/crypto.h>
 #include <linux/mempool.h>
 #include <linux/module.h>
@@ -37,6 +38,11 @@ module_param(num_prealloc_fallback_crypt_ctxs, uint, 0);
 MODULE_PARM_DESC(num_prealloc_crypt_fallback_ctxs,
 		 "Number of preallocated bio fallback crypto contexts for blk-crypto to use during crypto API fallback");
 
+static unsigned int parallel_chunk_size = 65536;
+module_param(parallel_chunk_size, uint, 0644);
+MODULE_PARM_DESC(parallel_chunk_size,
+		 "Minimum number of bytes per chunk when en/decrypting a bio on multiple CPUs in the blk-crypto crypto API fallback (0 to disable)");
+
 struct bio_fallback_crypt_ctx {
 	struct bio_crypt_ctx crypt_ctx;
 	/*
@@ -80,6 +86,7 @@ static struct blk_crypto_fallback_keyslot {
 
 static struct blk_crypto_profile *blk_crypto_fallback_profile;
 static struct workqueue_struct *blk_crypto_wq;
+static struct workqueue_struct *blk_crypto_chunk_wq;
 static mempool_t *blk_crypto_bounce_page_pool;
 static struct bio_set crypto_bio_split;
 
@@ -254,6 +261,204 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 		iv->dun[i] = cpu_to_le64(dun[i]);
 }
 
+struct blk_crypto_fallback_batch {
+	atomic_t remaining;
+	blk_status_t status;
+	struct completion done;
+};
+
+/*
+ * A contiguous run of data units of one bio, en/decrypted as a unit.  Large
+ * bios are cut into several of these so that they can be processed on
+ * multiple CPUs at once; the keyslot's tfm is shared between them, which the
+ * crypto API allows since all per-operation state lives in the request.
+ */
+struct blk_crypto_fallback_chunk {
+	struct work_struct work;
+	struct blk_crypto_keyslot *slot;
+	struct bio *bio;
+	struct bvec_iter iter;
+	/* Destination pages for encryption, or NULL to decrypt in place */
+	struct bio_vec *dst_bvecs;
+	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	unsigned int data_unit_size;
+	bool encrypt;
+	struct blk_crypto_fallback_batch *batch;
+};
+
+static blk_status_t
+blk_crypto_fallback_crypt_chunk(struct blk_crypto_fallback_chunk *chunk)
+{
+	const unsigned int data_unit_size = chunk->data_unit_size;
+	struct skcipher_request *ciph_req = NULL;
+	DECLARE_CRYPTO_WAIT(wait);
+	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	struct scatterlist src, dst;
+	union blk_crypto_iv iv;
+	struct bio_vec bv;
+	struct bvec_iter iter;
+	unsigned int i = 0, j;
+	blk_status_t blk_st = BLK_STS_OK;
+	int err;
+
+	if (!blk_crypto_fallback_alloc_cipher_req(chunk->slot, &ciph_req,
+						  &wait))
+		return BLK_STS_RESOURCE;
+
+	memcpy(curr_dun, chunk->dun, sizeof(curr_dun));
+	sg_init_table(&src, 1);
+	sg_init_table(&dst, 1);
+	skcipher_request_set_crypt(ciph_req, &src,
+				   chunk->dst_bvecs ? &dst : &src,
+				   data_unit_size, iv.bytes);
+
+	__bio_for_each_segment(bv, chunk->bio, iter, chunk->iter) {
+		sg_set_page(&src, bv.bv_page, data_unit_size, bv.bv_offset);
+		if (chunk->dst_bvecs) {
+			const struct bio_vec *dst_bv = &chunk->dst_bvecs[i++];
+
+			sg_set_page(&dst, dst_bv->bv_page, data_unit_size,
+				    dst_bv->bv_offset);
+		}
+
+		/* En/decrypt each data unit in this segment */
+		for (j = 0; j < bv.bv_len; j += data_unit_size) {
+			blk_crypto_dun_to_iv(curr_dun, &iv);
+			if (chunk->encrypt)
+				err = crypto_skcipher_encrypt(ciph_req);
+			else
+				err = crypto_skcipher_decrypt(ciph_req);
+			if (crypto_wait_req(err, &wait)) {
+				blk_st = BLK_STS_IOERR;
+				goto out;
+			}
+			bio_crypt_dun_increment(curr_dun, 1);
+			src.offset += data_unit_size;
+			dst.offset += data_unit_size;
+		}
+	}
+out:
+	skcipher_request_free(ciph_req);
+	return blk_st;
+}
+
+static void blk_crypto_fallback_chunk_work(struct work_struct *work)
+{
+	struct blk_crypto_fallback_chunk *chunk =
+		container_of(work, struct blk_crypto_fallback_chunk, work);
+	struct blk_crypto_fallback_batch *batch = chunk->batch;
+	blk_status_t blk_st = blk_crypto_fallback_crypt_chunk(chunk);
+
+	if (blk_st != BLK_STS_OK)
+		WRITE_ONCE(batch->status, blk_st);
+	if (atomic_dec_and_test(&batch->remaining))
+		complete(&batch->done);
+}
+
+/*
+ * Cut the part of @bio described by @start into chunks of at least
+ * @chunk_bytes each, always on segment boundaries.  Returns the number of
+ * chunks, which is at most @max_chunks.
+ */
+static unsigned int
+blk_crypto_fallback_init_chunks(struct blk_crypto_fallback_chunk *chunks,
+				unsigned int max_chunks,
+				unsigned int chunk_bytes,
+				struct blk_crypto_keyslot *slot,
+				struct bio *bio, struct bvec_iter start,
+				struct bio_vec *dst_bvecs,
+				const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
+				unsigned int data_unit_size, bool encrypt)
+{
+	struct blk_crypto_fallback_chunk *chunk = NULL;
+	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	unsigned int nr = 0, seg = 0;
+	struct bvec_iter iter;
+	struct bio_vec bv;
+
+	memcpy(curr_dun, dun, sizeof(curr_dun));
+
+	__bio_for_each_segment(bv, bio, iter, start) {
+		if (!chunk ||
+		    (nr < max_chunks && chunk->iter.bi_size >= chunk_bytes)) {
+			chunk = &chunks[nr++];
+			chunk->slot = slot;
+			chunk->bio = bio;
+			chunk->iter = iter;
+			chunk->iter.bi_size = 0;
+			chunk->dst_bvecs = dst_bvecs ? &dst_bvecs[seg] : NULL;
+			memcpy(chunk->dun, curr_dun, sizeof(chunk->dun));
+			chunk->data_unit_size = data_unit_size;
+			chunk->encrypt = encrypt;
+		}
+		chunk->iter.bi_size += bv.bv_len;
+		bio_crypt_dun_increment(curr_dun, bv.bv_len / data_unit_size);
+		seg++;
+	}
+	return nr;
+}
+
+/*
+ * En/decrypt the part of @bio described by @iter, either into the pages of
+ * @dst_bvecs (which must mirror @bio's segments one to one) or in place if
+ * @dst_bvecs is NULL.  Bios larger than the parallel_chunk_size parameter are
+ * split into chunks which are spread over blk_crypto_chunk_wq, with the first
+ * chunk handled by the caller while it waits for the rest.
+ */
+static blk_status_t
+blk_crypto_fallback_crypt(struct blk_crypto_keyslot *slot, struct bio *bio,
+			  struct bvec_iter iter, struct bio_vec *dst_bvecs,
+			  const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
+			  unsigned int data_unit_size, bool encrypt)
+{
+	struct blk_crypto_fallback_chunk single, *chunks = &single;
+	unsigned int chunk_bytes = READ_ONCE(parallel_chunk_size);
+	unsigned int ncpus = num_online_cpus();
+	unsigned int max_chunks = 1;
+	struct blk_crypto_fallback_batch batch;
+	blk_status_t blk_st;
+	unsigned int nr, i;
+
+	if (chunk_bytes && ncpus > 1 && iter.bi_size > chunk_bytes) {
+		chunk_bytes = max(chunk_bytes, DIV_ROUND_UP(iter.bi_size, ncpus));
+		max_chunks = DIV_ROUND_UP(iter.bi_size, chunk_bytes);
+		chunks = kmalloc_array(max_chunks, sizeof(*chunks),
+				       GFP_NOIO | __GFP_NOWARN);
+		if (!chunks) {
+			chunks = &single;
+			max_chunks = 1;
+		}
+	}
+
+	nr = blk_crypto_fallback_init_chunks(chunks, max_chunks, chunk_bytes,
+					     slot, bio, iter, dst_bvecs, dun,
+					     data_unit_size, encrypt);
+	if (nr <= 1) {
+		blk_st = nr ? blk_crypto_fallback_crypt_chunk(&chunks[0]) :
+			      BLK_STS_OK;
+		goto out;
+	}
+
+	atomic_set(&batch.remaining, nr - 1);
+	batch.status = BLK_STS_OK;
+	init_completion(&batch.done);
+
+	for (i = 1; i < nr; i++) {
+		chunks[i].batch = &batch;
+		INIT_WORK(&chunks[i].work, blk_crypto_fallback_chunk_work);
+		queue_work(blk_crypto_chunk_wq, &chunks[i].work);
+	}
+
+	blk_st = blk_crypto_fallback_crypt_chunk(&chunks[0]);
+	wait_for_completion(&batch.done);
+	if (blk_st == BLK_STS_OK)
+		blk_st = READ_ONCE(batch.status);
+out:
+	if (chunks != &single)
+		kfree(chunks);
+	return blk_st;
+}
+
 /*
  * The crypto API fallback's encryption routine.
  * Allocate a bounce bio for encryption, encrypt the input bio using crypto API,
@@ -267,12 +472,7 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 	struct bio_crypt_ctx *bc;
 	struct blk_crypto_keyslot *slot;
 	int data_unit_size;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	struct scatterlist src, dst;
-	union blk_crypto_iv iv;
-	unsigned int i, j;
+	unsigned int i;
 	bool ret = false;
 	blk_status_t blk_st;
 
@@ -302,51 +502,29 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 		goto out_put_enc_bio;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	if (!blk_crypto_fallback_alloc_cipher_req(slot, &ciph_req, &wait)) {
-		src_bio->bi_status = BLK_STS_RESOURCE;
-		goto out_release_keyslot;
-	}
-
-	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&src, 1);
-	sg_init_table(&dst, 1);
-
-	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
-				   iv.bytes);
-
-	/* Encrypt each page in the bounce bio */
+	/*
+	 * Replace each page in the bounce bio with a ciphertext page.  The
+	 * plaintext is still reachable through src_bio.  This is done up front
+	 * so that the chunks encrypted in parallel never compete for the bounce
+	 * page pool.
+	 */
 	for (i = 0; i < enc_bio->bi_vcnt; i++) {
 		struct bio_vec *enc_bvec = &enc_bio->bi_io_vec[i];
-		struct page *plaintext_page = enc_bvec->bv_page;
-		struct page *ciphertext_page =
-			mempool_alloc(blk_crypto_bounce_page_pool, GFP_NOIO);
 
-		enc_bvec->bv_page = ciphertext_page;
-
-		if (!ciphertext_page) {
+		enc_bvec->bv_page = mempool_alloc(blk_crypto_bounce_page_pool,
+						  GFP_NOIO);
+		if (!enc_bvec->bv_page) {
 			src_bio->bi_status = BLK_STS_RESOURCE;
 			goto out_free_bounce_pages;
 		}
+	}
 
-		sg_set_page(&src, plaintext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-		sg_set_page(&dst, ciphertext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-
-		/* Encrypt each data unit in this page */
-		for (j = 0; j < enc_bvec->bv_len; j += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_encrypt(ciph_req),
-					    &wait)) {
-				i++;
-				src_bio->bi_status = BLK_STS_IOERR;
-				goto out_free_bounce_pages;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			src.offset += data_unit_size;
-			dst.offset += data_unit_size;
-		}
+	blk_st = blk_crypto_fallback_crypt(slot, src_bio, src_bio->bi_iter,
+					   enc_bio->bi_io_vec, bc->bc_dun,
+					   data_unit_size, true);
+	if (blk_st != BLK_STS_OK) {
+		src_bio->bi_status = blk_st;
+		goto out_free_bounce_pages;
 	}
 
 	enc_bio->bi_private = src_bio;
@@ -355,14 +533,12 @@ static bool blk_crypto_fallback_encrypt_bio(struct bio **bio_ptr)
 	ret = true;
 
 	enc_bio = NULL;
-	goto out_free_ciph_req;
+	goto out_release_keyslot;
 
 out_free_bounce_pages:
 	while (i > 0)
 		mempool_free(enc_bio->bi_io_vec[--i].bv_page,
 			     blk_crypto_bounce_page_pool);
-out_free_ciph_req:
-	skcipher_request_free(ciph_req);
 out_release_keyslot:
 	blk_crypto_put_keyslot(slot);
 out_put_enc_bio:
@@ -383,15 +559,6 @@ static void blk_crypto_fallback_decrypt_bio(struct work_struct *work)
 	struct bio *bio = f_ctx->bio;
 	struct bio_crypt_ctx *bc = &f_ctx->crypt_ctx;
 	struct blk_crypto_keyslot *slot;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist sg;
-	struct bio_vec bv;
-	struct bvec_iter iter;
-	const int data_unit_size = bc->bc_key->crypto_cfg.data_unit_size;
-	unsigned int i;
 	blk_status_t blk_st;
 
 	/*
@@ -405,38 +572,13 @@ static void blk_crypto_fallback_decrypt_bio(struct work_struct *work)
 		goto out_no_keyslot;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	if (!blk_crypto_fallback_alloc_cipher_req(slot, &ciph_req, &wait)) {
-		bio->bi_status = BLK_STS_RESOURCE;
-		goto out;
-	}
-
-	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&sg, 1);
-	skcipher_request_set_crypt(ciph_req, &sg, &sg, data_unit_size,
-				   iv.bytes);
-
-	/* Decrypt each segment in the bio */
-	__bio_for_each_segment(bv, bio, iter, f_ctx->crypt_iter) {
-		struct page *page = bv.bv_page;
-
-		sg_set_page(&sg, page, data_unit_size, bv.bv_offset);
-
-		/* Decrypt each data unit in the segment */
-		for (i = 0; i < bv.bv_len; i += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_decrypt(ciph_req),
-					    &wait)) {
-				bio->bi_status = BLK_STS_IOERR;
-				goto out;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			sg.offset += data_unit_size;
-		}
-	}
+	blk_st = blk_crypto_fallback_crypt(slot, bio, f_ctx->crypt_iter, NULL,
+					   bc->bc_dun,
+					   bc->bc_key->crypto_cfg.data_unit_size,
+					   false);
+	if (blk_st != BLK_STS_OK)
+		bio->bi_status = blk_st;
 
-out:
-	skcipher_request_free(ciph_req);
 	blk_crypto_put_keyslot(slot);
 out_no_keyslot:
 	mempool_free(f_ctx, bio_fallback_crypt_ctx_pool);
@@ -576,11 +718,21 @@ static int blk_crypto_fallback_init(void)
 	if (!blk_crypto_wq)
 		goto fail_destroy_profile;
 
+	/*
+	 * Separate from blk_crypto_wq since decryption work items wait for
+	 * their chunks to finish.
+	 */
+	blk_crypto_chunk_wq = alloc_workqueue("blk_crypto_chunk_wq",
+					      WQ_UNBOUND | WQ_HIGHPRI |
+					      WQ_MEM_RECLAIM, num_online_cpus());
+	if (!blk_crypto_chunk_wq)
+		goto fail_free_wq;
+
 	blk_crypto_keyslots = kcalloc(blk_crypto_num_keyslots,
 				      sizeof(blk_crypto_keyslots[0]),
 				      GFP_KERNEL);
 	if (!blk_crypto_keyslots)
-		goto fail_free_wq;
+		goto fail_free_chunk_wq;
 
 	blk_crypto_bounce_page_pool =
 		mempool_create_page_pool(num_prealloc_bounce_pg, 0);
@@ -606,6 +758,8 @@ static int blk_crypto_fallback_init(void)
 	mempool_destroy(blk_crypto_bounce_page_pool);
 fail_free_keyslots:
 	kfree(blk_crypto_keyslots);
+fail_free_chunk_wq:
+	destroy_workqueue(blk_crypto_chunk_wq);
 fail_free_wq:
 	destroy_workqueue(blk_crypto_wq);
 fail_destroy_profile:
@@ -29,6 +29,7 @@
 #include <linux/atomic.h>
 #include <linux/mutex.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 #include <linux/wait.h>
 #include <linux/blkdev.h>
 #include <linux/blk-integrity.h>
@@ -40,6 +41,8 @@ struct blk_crypto_keyslot {
 	struct hlist_node hash_node;
 	const struct blk_crypto_key *key;
 	struct blk_crypto_profile *profile;
+	/* Holds a reference of its own; see blk_crypto_pin_keyslot() */
+	bool pinned;
 };
 
 static inline void blk_crypto_hw_enter(struct blk_crypto_profile *profile)
@@ -266,14 +269,14 @@ blk_status_t blk_crypto_get_keyslot(struct blk_crypto_profile *profile,
 	slot = blk_crypto_find_and_grab_keyslot(profile, key);
 	up_read(&profile->lock);
 	if (slot)
-		goto success;
+		goto hit;
 
 	for (;;) {
 		blk_crypto_hw_enter(profile);
 		slot = blk_crypto_find_and_grab_keyslot(profile, key);
 		if (slot) {
 			blk_crypto_hw_exit(profile);
-			goto success;
+			goto hit;
 		}
 
 		/*
@@ -299,9 +302,15 @@ blk_status_t blk_crypto_get_keyslot(struct blk_crypto_profile *profile,
 		return errno_to_blk_status(err);
 	}
 
+	profile->keyslot_misses++;
+	atomic_long_inc(&key->stats_ptr->misses);
+
 	/* Move this slot to the hash list for the new key. */
-	if (slot->key)
+	if (slot->key) {
 		hlist_del(&slot->hash_node);
+		profile->keyslot_evictions++;
+		atomic_long_inc(&slot->key->stats_ptr->evictions);
+	}
 	slot->key = key;
 	hlist_add_head(&slot->hash_node,
 		       blk_crypto_hash_bucket_for_key(profile, key));
@@ -311,6 +320,9 @@ blk_status_t blk_crypto_get_keyslot(struct blk_crypto_profile *profile,
 	blk_crypto_remove_slot_from_lru_list(slot);
 
 	blk_crypto_hw_exit(profile);
+	goto success;
+hit:
+	atomic_long_inc(&key->stats_ptr->hits);
 success:
 	*slot_ptr = slot;
 	return BLK_STS_OK;
@@ -335,6 +347,81 @@ void blk_crypto_put_keyslot(struct blk_crypto_keyslot *slot)
 	}
 }
 
+/*
+ * A pinned keyslot keeps a reference of its own, so it never goes back on the
+ * idle list and its key can't be displaced by other keys.  At most half of the
+ * keyslots can be pinned, so that unpinned keys always have slots to use.
+ *
+ * Context: Process context.  Takes and releases profile->lock.
+ * Return: 0 on success or if the key is already pinned, -ENOSPC if the maximum
+ *	   number of keyslots is already pinned, or another -errno code.
+ */
+int blk_crypto_pin_keyslot(struct blk_crypto_profile *profile,
+			   const struct blk_crypto_key *key)
+{
+	struct blk_crypto_keyslot *slot;
+	blk_status_t status;
+	int err = 0;
+
+	if (profile->num_slots == 0)
+		return 0;
+
+	status = blk_crypto_get_keyslot(profile, key, &slot);
+	if (status != BLK_STS_OK)
+		return blk_status_to_errno(status);
+
+	down_write(&profile->lock);
+	if (!slot->pinned) {
+		if (profile->num_pinned_slots < profile->num_slots / 2) {
+			/* The reference from blk_crypto_get_keyslot() is kept */
+			slot->pinned = true;
+			profile->num_pinned_slots++;
+			up_write(&profile->lock);
+			return 0;
+		}
+		err = -ENOSPC;
+	}
+	up_write(&profile->lock);
+	blk_crypto_put_keyslot(slot);
+	return err;
+}
+
+/* Must be called with profile->lock held for write. */
+static void blk_crypto_unpin_slot(struct blk_crypto_keyslot *slot)
+{
+	slot->pinned = false;
+	slot->profile->num_pinned_slots--;
+	blk_crypto_put_keyslot(slot);
+}
+
+/* Dump the state of each keyslot and the statistics of the key in it. */
+void blk_crypto_show_keyslots(struct blk_crypto_profile *profile,
+			      struct seq_file *m)
+{
+	unsigned int i;
+
+	if (!profile || profile->num_slots == 0)
+		return;
+
+	down_read(&profile->lock);
+	for (i = 0; i < profile->num_slots; i++) {
+		struct blk_crypto_keyslot *slot = &profile->slots[i];
+		struct blk_crypto_key_stats *stats;
+
+		if (!slot->key) {
+			seq_printf(m, "%u: empty\n", i);
+			continue;
+		}
+		stats = slot->key->stats_ptr;
+		seq_printf(m, "%u: refs=%d pinned=%d hits=%ld misses=%ld evictions=%ld\n",
+			   i, atomic_read(&slot->slot_refs), slot->pinned,
+			   atomic_long_read(&stats->hits),
+			   atomic_long_read(&stats->misses),
+			   atomic_long_read(&stats->evictions));
+	}
+	up_read(&profile->lock);
+}
+
 /**
  * __blk_crypto_cfg_supported() - Check whether the given crypto profile
  *				  supports the given crypto configuration.
@@ -389,6 +476,10 @@ int __blk_crypto_evict_key(struct blk_crypto_profile *profile,
 		goto out;
 	}
 
+	/* Pinning must not keep a key that's being destroyed in its slot. */
+	if (slot->pinned)
+		blk_crypto_unpin_slot(slot);
+
 	if (WARN_ON_ONCE(atomic_read(&slot->slot_refs) != 0)) {
 		/* BUG: key is still in use by I/O */
 		err = -EBUSY;
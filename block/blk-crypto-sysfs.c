@@ -43,15 +43,31 @@ static ssize_t num_keyslots_show(struct blk_crypto_profile *profile,
 	return sysfs_emit(page, "%u\n", profile->num_slots);
 }
 
+static ssize_t keyslot_misses_show(struct blk_crypto_profile *profile,
+				   struct blk_crypto_attr *attr, char *page)
+{
+	return sysfs_emit(page, "%lu\n", READ_ONCE(profile->keyslot_misses));
+}
+
+static ssize_t keyslot_evictions_show(struct blk_crypto_profile *profile,
+				      struct blk_crypto_attr *attr, char *page)
+{
+	return sysfs_emit(page, "%lu\n", READ_ONCE(profile->keyslot_evictions));
+}
+
 #define BLK_CRYPTO_RO_ATTR(_name) \
 	static struct blk_crypto_attr _name##_attr = __ATTR_RO(_name)
 
 BLK_CRYPTO_RO_ATTR(max_dun_bits);
 BLK_CRYPTO_RO_ATTR(num_keyslots);
+BLK_CRYPTO_RO_ATTR(keyslot_misses);
+BLK_CRYPTO_RO_ATTR(keyslot_evictions);
 
 static struct attribute *blk_crypto_attrs[] = {
 	&max_dun_bits_attr.attr,
 	&num_keyslots_attr.attr,
+	&keyslot_misses_attr.attr,
+	&keyslot_evictions_attr.attr,
 	NULL,
 };
 
@@ -378,6 +378,7 @@ int blk_crypto_init_key(struct blk_crypto_key *blk_key,
 	blk_key->data_unit_size_bits = ilog2(data_unit_size);
 	blk_key->size = raw_key_size;
 	memcpy(blk_key->raw, raw_key, raw_key_size);
+	blk_key->stats_ptr = &blk_key->stats;
 
 	return 0;
 }
@@ -469,3 +470,60 @@ void blk_crypto_evict_key(struct block_device *bdev,
 		pr_warn_ratelimited("%pg: error %d evicting key\n", bdev, err);
 }
 EXPORT_SYMBOL_GPL(blk_crypto_evict_key);
+
+/**
+ * blk_crypto_prime_key() - Program a blk_crypto_key into a keyslot ahead of I/O
+ * @bdev: block device to operate on
+ * @key: a key that blk_crypto_start_using_key() was called for on @bdev
+ *
+ * Keys are normally programmed into a keyslot by the first I/O that uses them.
+ * Upper layers that know a key will be shared by many files can call this
+ * when setting it up, so that no read has to wait for the programming.  The
+ * key stays in its slot until it's evicted for lack of idle slots, like any
+ * other key.  This is only an optimization and can be skipped on failure.
+ *
+ * Context: Process context.  May sleep.
+ * Return: 0 on success or if the device doesn't use keyslots, else -errno.
+ */
+int blk_crypto_prime_key(struct block_device *bdev,
+			 const struct blk_crypto_key *key)
+{
+	struct blk_crypto_profile *profile = bdev_get_queue(bdev)->crypto_profile;
+	struct blk_crypto_keyslot *slot;
+	blk_status_t status;
+
+	if (!blk_crypto_config_supported_natively(bdev, &key->crypto_cfg))
+		return 0;
+	status = blk_crypto_get_keyslot(profile, key, &slot);
+	if (status != BLK_STS_OK)
+		return blk_status_to_errno(status);
+	if (slot)
+		blk_crypto_put_keyslot(slot);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_crypto_prime_key);
+
+/**
+ * blk_crypto_pin_key() - Program a blk_crypto_key and keep it in its keyslot
+ * @bdev: block device to operate on
+ * @key: a key that blk_crypto_start_using_key() was called for on @bdev
+ *
+ * Like blk_crypto_prime_key(), but the key also can't be evicted to make room
+ * for other keys until blk_crypto_evict_key() is called for it.  This is meant for the keys of the user in the foreground,
+ * so that background users can't make their I/O wait for reprogramming.  Only
+ * up to half of a device's keyslots can be pinned.
+ *
+ * Context: Process context.  May sleep.
+ * Return: 0 on success or if the device doesn't use keyslots, -ENOSPC if too
+ *	   many keys are pinned already, or another -errno code.
+ */
+int blk_crypto_pin_key(struct block_device *bdev,
+		       const struct blk_crypto_key *key)
+{
+	struct blk_crypto_profile *profile = bdev_get_queue(bdev)->crypto_profile;
+
+	if (!blk_crypto_config_supported_natively(bdev, &key->crypto_cfg))
+		return 0;
+	return blk_crypto_pin_keyslot(profile, key);
+}
+EXPORT_SYMBOL_GPL(blk_crypto_pin_key);
@@ -10,6 +10,7 @@
 #include "blk.h"
 #include "blk-mq.h"
 #include "blk-mq-debugfs.h"
+#include "blk-crypto-internal.h"
 #include "blk-mq-sched.h"
 #include "blk-rq-qos.h"
 
@@ -77,6 +78,16 @@ static int queue_pm_only_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+#ifdef CONFIG_BLK_INLINE_ENCRYPTION
+static int queue_crypto_keyslots_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+
+	blk_crypto_show_keyslots(q->crypto_profile, m);
+	return 0;
+}
+#endif
+
 #define QUEUE_FLAG_NAME(name) [QUEUE_FLAG_##name] = #name
 static const char *const blk_queue_flag_name[] = {
 	QUEUE_FLAG_NAME(STOPPED),
@@ -161,6 +172,9 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
 	{ "pm_only", 0600, queue_pm_only_show, NULL },
 	{ "state", 0600, queue_state_show, queue_state_write },
 	{ "zone_wlock", 0400, queue_zone_wlock_show, NULL },
+#ifdef CONFIG_BLK_INLINE_ENCRYPTION
+	{ "crypto_keyslots", 0400, queue_crypto_keyslots_show, NULL },
+#endif
 	{ },
 };
 
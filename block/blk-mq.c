@@ -1264,8 +1264,15 @@ void blk_mq_start_request(struct request *rq)
 	if (blk_integrity_rq(rq) && req_op(rq) == REQ_OP_WRITE)
 		q->integrity.profile->prepare_fn(rq);
 #endif
-	if (rq->bio && rq->bio->bi_opf & REQ_POLLED)
+	if (rq->bio && rq->bio->bi_opf & REQ_POLLED) {
 	        WRITE_ONCE(rq->bio->bi_cookie, rq->mq_hctx->queue_num);
+		if (READ_ONCE(q->poll_nsec) != BLK_MQ_POLL_CLASSIC) {
+			struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
+
+			WRITE_ONCE(hctx->poll_issue_ns, ktime_get_ns());
+			WRITE_ONCE(hctx->poll_issued, hctx->poll_issued + 1);
+		}
+	}
 }
 EXPORT_SYMBOL(blk_mq_start_request);
 
@@ -4290,6 +4297,7 @@ int blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 
 	q->queue_flags |= QUEUE_FLAG_MQ_DEFAULT;
 	blk_mq_update_poll_flag(q);
+	q->poll_nsec = BLK_MQ_POLL_CLASSIC;
 
 	INIT_DELAYED_WORK(&q->requeue_work, blk_mq_requeue_work);
 	INIT_LIST_HEAD(&q->flush_list);
@@ -4819,12 +4827,104 @@ void blk_mq_update_nr_hw_queues(struct blk_mq_tag_set *set, int nr_hw_queues)
 }
 EXPORT_SYMBOL_GPL(blk_mq_update_nr_hw_queues);
 
+static int blk_mq_poll_stats_bkt(const struct request *rq)
+{
+	return (rq->cmd_flags & REQ_POLLED) ? 0 : -1;
+}
+
+static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb)
+{
+	struct request_queue *q = cb->data;
+
+	if (cb->stat[0].nr_samples)
+		q->poll_stat = cb->stat[0];
+}
+
+/* Start collecting the completion latencies of polled requests on @q. */
+int blk_mq_poll_stats_enable(struct request_queue *q)
+{
+	struct blk_stat_callback *cb;
+
+	if (q->poll_cb)
+		return 0;
+
+	cb = blk_stat_alloc_callback(blk_mq_poll_stats_fn,
+				     blk_mq_poll_stats_bkt, 1, q);
+	if (!cb)
+		return -ENOMEM;
+	blk_stat_add_callback(q, cb);
+	smp_store_release(&q->poll_cb, cb);
+	return 0;
+}
+
+void blk_mq_poll_stats_free(struct request_queue *q)
+{
+	if (!q->poll_cb)
+		return;
+	blk_stat_remove_callback(q, q->poll_cb);
+	blk_stat_free_callback(q->poll_cb);
+}
+
+/* Sleeps shorter than this cost more than they save */
+#define BLK_MQ_POLL_MIN_SLEEP_NS	(10 * NSEC_PER_USEC)
+
+/* Adaptive hybrid polling sleeps for half the mean polled completion time */
+static u64 blk_mq_poll_nsecs(struct request_queue *q)
+{
+	struct blk_stat_callback *cb = smp_load_acquire(&q->poll_cb);
+
+	if (!cb)
+		return 0;
+	if (!blk_stat_is_active(cb))
+		blk_stat_activate_msecs(cb, 100);
+	return q->poll_stat.nr_samples ? (q->poll_stat.mean + 1) / 2 : 0;
+}
+
+/*
+ * Hybrid polling: rather than spin for the whole device latency, sleep for
+ * most of it first.  The sleep is counted from the start of the latest polled
+ * request on @hctx and is taken at most once per request, so a caller that
+ * keeps polling spins once the estimate has run out.
+ */
+static bool blk_hctx_poll_hybrid_sleep(struct request_queue *q,
+				       struct blk_mq_hw_ctx *hctx)
+{
+	int poll_nsec = READ_ONCE(q->poll_nsec);
+	unsigned long issued = READ_ONCE(hctx->poll_issued);
+	struct hrtimer_sleeper hs;
+	s64 nsecs;
+
+	if (poll_nsec == BLK_MQ_POLL_CLASSIC || issued == hctx->poll_slept)
+		return false;
+	hctx->poll_slept = issued;
+
+	nsecs = poll_nsec ?: blk_mq_poll_nsecs(q);
+	nsecs -= ktime_get_ns() - READ_ONCE(hctx->poll_issue_ns);
+	if (nsecs < BLK_MQ_POLL_MIN_SLEEP_NS)
+		return false;
+
+	hrtimer_init_sleeper_on_stack(&hs, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	hrtimer_set_expires(&hs.timer, ns_to_ktime(nsecs));
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	hrtimer_sleeper_start_expires(&hs, HRTIMER_MODE_REL);
+	if (hs.task)
+		io_schedule();
+	hrtimer_cancel(&hs.timer);
+	__set_current_state(TASK_RUNNING);
+	destroy_hrtimer_on_stack(&hs.timer);
+	return true;
+}
+
 static int blk_hctx_poll(struct request_queue *q, struct blk_mq_hw_ctx *hctx,
 			 struct io_comp_batch *iob, unsigned int flags)
 {
 	long state = get_current_state();
 	int ret;
 
+	/* like a wakeup, a hybrid sleep makes the caller check for completion */
+	if (!(flags & BLK_POLL_ONESHOT) && blk_hctx_poll_hybrid_sleep(q, hctx))
+		return 1;
+
 	do {
 		ret = q->mq_ops->poll(hctx, iob);
 		if (ret > 0) {
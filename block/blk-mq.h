@@ -126,6 +126,10 @@ void blk_mq_cancel_work_sync(struct request_queue *q);
 
 void blk_mq_release(struct request_queue *q);
 
+#define BLK_MQ_POLL_CLASSIC	-1
+int blk_mq_poll_stats_enable(struct request_queue *q);
+void blk_mq_poll_stats_free(struct request_queue *q);
+
 static inline struct blk_mq_ctx *__blk_mq_get_ctx(struct request_queue *q,
 					   unsigned int cpu)
 {
@@ -11,10 +11,32 @@
 #include "blk-mq.h"
 #include "blk.h"
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+enum {
+	BLK_LAT_HIST_READ,
+	BLK_LAT_HIST_WRITE,
+	BLK_LAT_HIST_FLUSH,
+	BLK_LAT_HIST_DISCARD,
+	BLK_LAT_HIST_OPS,
+};
+
+/* Request sizes up to 4K, 32K, 256K and larger */
+#define BLK_LAT_HIST_SIZES	4
+/* Bucket i counts latencies in [2^i, 2^(i+1)) us, the last one is open */
+#define BLK_LAT_HIST_BUCKETS	24
+
+struct blk_lat_hist {
+	u32 cnt[BLK_LAT_HIST_OPS][BLK_LAT_HIST_SIZES][2][BLK_LAT_HIST_BUCKETS];
+};
+#endif
+
 struct blk_queue_stats {
 	struct list_head callbacks;
 	spinlock_t lock;
 	int accounting;
+#ifdef CONFIG_BLK_LATENCY_HIST
+	struct blk_lat_hist __percpu *hist;
+#endif
 };
 
 void blk_rq_stat_init(struct blk_rq_stat *stat)
@@ -47,6 +69,47 @@ void blk_rq_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->nr_samples++;
 }
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+static void blk_lat_hist_add(struct blk_lat_hist *hist, struct request *rq,
+			     u64 value)
+{
+	unsigned int sectors = rq->stats_sectors;
+	int op, size, bucket;
+	u64 us;
+
+	switch (req_op(rq)) {
+	case REQ_OP_READ:
+		op = BLK_LAT_HIST_READ;
+		break;
+	case REQ_OP_WRITE:
+		op = BLK_LAT_HIST_WRITE;
+		break;
+	case REQ_OP_FLUSH:
+		op = BLK_LAT_HIST_FLUSH;
+		break;
+	case REQ_OP_DISCARD:
+		op = BLK_LAT_HIST_DISCARD;
+		break;
+	default:
+		return;
+	}
+
+	if (sectors <= SZ_4K >> SECTOR_SHIFT)
+		size = 0;
+	else if (sectors <= SZ_32K >> SECTOR_SHIFT)
+		size = 1;
+	else if (sectors <= SZ_256K >> SECTOR_SHIFT)
+		size = 2;
+	else
+		size = 3;
+
+	us = div_u64(value, NSEC_PER_USEC);
+	bucket = us ? min_t(int, ilog2(us), BLK_LAT_HIST_BUCKETS - 1) : 0;
+
+	this_cpu_inc(hist->cnt[op][size][op_is_sync(rq->cmd_flags)][bucket]);
+}
+#endif
+
 void blk_stat_add(struct request *rq, u64 now)
 {
 	struct request_queue *q = rq->q;
@@ -62,6 +125,10 @@ void blk_stat_add(struct request *rq, u64 now)
 
 	rcu_read_lock();
 	cpu = get_cpu();
+#ifdef CONFIG_BLK_LATENCY_HIST
+	if (q->stats->hist)
+		blk_lat_hist_add(q->stats->hist, rq, value);
+#endif
 	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
 		if (!blk_stat_is_active(cb))
 			continue;
@@ -206,6 +273,96 @@ void blk_stat_enable_accounting(struct request_queue *q)
 }
 EXPORT_SYMBOL_GPL(blk_stat_enable_accounting);
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+/*
+ * Called when the queue is registered. Once allocated, the histograms stay
+ * until the queue is freed, so blk_stat_add() needs no synchronization.
+ */
+void blk_stat_enable_latency_hist(struct request_queue *q)
+{
+	if (!queue_is_mq(q))
+		return;
+
+	if (!q->stats->hist) {
+		q->stats->hist = alloc_percpu(struct blk_lat_hist);
+		if (!q->stats->hist)
+			return;
+	}
+	blk_stat_enable_accounting(q);
+}
+
+void blk_stat_disable_latency_hist(struct request_queue *q)
+{
+	if (q->stats->hist)
+		blk_stat_disable_accounting(q);
+}
+
+ssize_t blk_stat_latency_hist_show(struct request_queue *q, char *page)
+{
+	static const char *const ops[] = { "read", "write", "flush", "discard" };
+	static const char *const sizes[] = { "4k", "32k", "256k", "max" };
+	static const char *const sync[] = { "async", "sync" };
+	struct blk_lat_hist *sum;
+	int op, size, s, b, cpu;
+	ssize_t len;
+
+	if (!q->stats->hist)
+		return -EOPNOTSUPP;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct blk_lat_hist *hist = per_cpu_ptr(q->stats->hist, cpu);
+
+		for (op = 0; op < BLK_LAT_HIST_OPS; op++)
+			for (size = 0; size < BLK_LAT_HIST_SIZES; size++)
+				for (s = 0; s < 2; s++)
+					for (b = 0; b < BLK_LAT_HIST_BUCKETS; b++)
+						sum->cnt[op][size][s][b] +=
+							READ_ONCE(hist->cnt[op][size][s][b]);
+	}
+
+	/* Only non-empty buckets, as log2(latency in us):count */
+	len = sysfs_emit(page, "# op sync size log2_usec:count...\n");
+	for (op = 0; op < BLK_LAT_HIST_OPS; op++) {
+		for (size = 0; size < BLK_LAT_HIST_SIZES; size++) {
+			for (s = 0; s < 2; s++) {
+				u32 *cnt = sum->cnt[op][size][s];
+
+				if (!memchr_inv(cnt, 0, sizeof(sum->cnt[0][0][0])))
+					continue;
+				len += sysfs_emit_at(page, len, "%s %s %s",
+						     ops[op], sync[s],
+						     sizes[size]);
+				for (b = 0; b < BLK_LAT_HIST_BUCKETS; b++)
+					if (cnt[b])
+						len += sysfs_emit_at(page, len,
+								     " %d:%u",
+								     b, cnt[b]);
+				len += sysfs_emit_at(page, len, "\n");
+			}
+		}
+	}
+
+	kfree(sum);
+	return len;
+}
+
+void blk_stat_latency_hist_reset(struct request_queue *q)
+{
+	int cpu;
+
+	if (!q->stats->hist)
+		return;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(q->stats->hist, cpu), 0,
+		       sizeof(struct blk_lat_hist));
+}
+#endif
+
 struct blk_queue_stats *blk_alloc_queue_stats(void)
 {
 	struct blk_queue_stats *stats;
@@ -217,6 +374,9 @@ struct blk_queue_stats *blk_alloc_queue_stats(void)
 	INIT_LIST_HEAD(&stats->callbacks);
 	spin_lock_init(&stats->lock);
 	stats->accounting = 0;
+#ifdef CONFIG_BLK_LATENCY_HIST
+	stats->hist = NULL;
+#endif
 
 	return stats;
 }
@@ -228,5 +388,8 @@ void blk_free_queue_stats(struct blk_queue_stats *stats)
 
 	WARN_ON(!list_empty(&stats->callbacks));
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+	free_percpu(stats->hist);
+#endif
 	kfree(stats);
 }
@@ -72,6 +72,28 @@ void blk_stat_add(struct request *rq, u64 now);
 void blk_stat_enable_accounting(struct request_queue *q);
 void blk_stat_disable_accounting(struct request_queue *q);
 
+#ifdef CONFIG_BLK_LATENCY_HIST
+void blk_stat_enable_latency_hist(struct request_queue *q);
+void blk_stat_disable_latency_hist(struct request_queue *q);
+ssize_t blk_stat_latency_hist_show(struct request_queue *q, char *page);
+void blk_stat_latency_hist_reset(struct request_queue *q);
+#else
+static inline void blk_stat_enable_latency_hist(struct request_queue *q)
+{
+}
+static inline void blk_stat_disable_latency_hist(struct request_queue *q)
+{
+}
+static inline ssize_t blk_stat_latency_hist_show(struct request_queue *q,
+						 char *page)
+{
+	return -EOPNOTSUPP;
+}
+static inline void blk_stat_latency_hist_reset(struct request_queue *q)
+{
+}
+#endif
+
 /**
  * blk_stat_alloc_callback() - Allocate a block statistics callback.
  * @timer_fn: Timer callback function.
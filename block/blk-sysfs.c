@@ -394,12 +394,42 @@ queue_rq_affinity_store(struct request_queue *q, const char *page, size_t count)
 
 static ssize_t queue_poll_delay_show(struct request_queue *q, char *page)
 {
-	return sprintf(page, "%d\n", -1);
+	int val;
+
+	if (q->poll_nsec == BLK_MQ_POLL_CLASSIC)
+		val = BLK_MQ_POLL_CLASSIC;
+	else
+		val = q->poll_nsec / 1000;
+
+	return sprintf(page, "%d\n", val);
 }
 
 static ssize_t queue_poll_delay_store(struct request_queue *q, const char *page,
 				size_t count)
 {
+	int err, val;
+
+	if (!q->mq_ops || !q->mq_ops->poll)
+		return -EINVAL;
+
+	err = kstrtoint(page, 10, &val);
+	if (err < 0)
+		return err;
+
+	if (val == BLK_MQ_POLL_CLASSIC) {
+		WRITE_ONCE(q->poll_nsec, BLK_MQ_POLL_CLASSIC);
+	} else if (val >= 0 && val <= INT_MAX / 1000) {
+		/* 0 sleeps for an estimate based on the polled latencies */
+		if (!val) {
+			err = blk_mq_poll_stats_enable(q);
+			if (err)
+				return err;
+		}
+		WRITE_ONCE(q->poll_nsec, val * 1000);
+	} else {
+		return -EINVAL;
+	}
+
 	return count;
 }
 
@@ -418,6 +448,28 @@ static ssize_t queue_poll_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+static ssize_t queue_latency_hist_show(struct request_queue *q, char *page)
+{
+	return blk_stat_latency_hist_show(q, page);
+}
+
+/* Writing 0 clears the histograms */
+static ssize_t queue_latency_hist_store(struct request_queue *q,
+					const char *page, size_t count)
+{
+	unsigned long val;
+	ssize_t ret;
+
+	ret = queue_var_store(&val, page, count);
+	if (ret < 0)
+		return ret;
+	if (val)
+		return -EINVAL;
+
+	blk_stat_latency_hist_reset(q);
+	return count;
+}
+
 static ssize_t queue_io_timeout_show(struct request_queue *q, char *page)
 {
 	return sprintf(page, "%u\n", jiffies_to_msecs(q->rq_timeout));
@@ -525,6 +577,7 @@ QUEUE_RW_ENTRY(queue_wc, "write_cache");
 QUEUE_RO_ENTRY(queue_fua, "fua");
 QUEUE_RO_ENTRY(queue_dax, "dax");
 QUEUE_RW_ENTRY(queue_io_timeout, "io_timeout");
+QUEUE_RW_ENTRY(queue_latency_hist, "latency_hist");
 QUEUE_RO_ENTRY(queue_virt_boundary_mask, "virt_boundary_mask");
 QUEUE_RO_ENTRY(queue_dma_alignment, "dma_alignment");
 
@@ -613,6 +666,39 @@ static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
 }
 
 QUEUE_RW_ENTRY(queue_wb_lat, "wbt_lat_usec");
+
+static ssize_t queue_wb_fg_cgroup_show(struct request_queue *q, char *page)
+{
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	return sprintf(page, "%llu\n", wbt_get_fg_cgroup(q));
+}
+
+static ssize_t queue_wb_fg_cgroup_store(struct request_queue *q,
+					const char *page, size_t count)
+{
+	u64 id;
+	int ret;
+
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	ret = kstrtou64(page, 10, &id);
+	if (ret < 0)
+		return ret;
+
+	wbt_set_fg_cgroup(q, id);
+	return count;
+}
+
+static ssize_t queue_wb_state_show(struct request_queue *q, char *page)
+{
+	return wbt_state_show(q, page);
+}
+
+QUEUE_RW_ENTRY(queue_wb_fg_cgroup, "wbt_fg_cgroup");
+QUEUE_RO_ENTRY(queue_wb_state, "wbt_state");
 #endif
 
 static struct attribute *queue_attrs[] = {
@@ -664,8 +750,11 @@ static struct attribute *blk_mq_queue_attrs[] = {
 	&elv_iosched_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_io_timeout_entry.attr,
+	&queue_latency_hist_entry.attr,
 #ifdef CONFIG_BLK_WBT
 	&queue_wb_lat_entry.attr,
+	&queue_wb_fg_cgroup_entry.attr,
+	&queue_wb_state_entry.attr,
 #endif
 	NULL,
 };
@@ -824,6 +913,7 @@ int blk_register_queue(struct gendisk *disk)
 
 	blk_queue_flag_set(QUEUE_FLAG_REGISTERED, q);
 	wbt_enable_default(disk);
+	blk_stat_enable_latency_hist(q);
 	blk_throtl_register(disk);
 
 	/* Now everything is ready and send out KOBJ_ADD uevent */
@@ -887,6 +977,7 @@ void blk_unregister_queue(struct gendisk *disk)
 	 */
 	mutex_lock(&q->sysfs_lock);
 	blk_queue_flag_clear(QUEUE_FLAG_REGISTERED, q);
+	blk_stat_disable_latency_hist(q);
 	mutex_unlock(&q->sysfs_lock);
 
 	mutex_lock(&q->sysfs_dir_lock);
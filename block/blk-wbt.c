@@ -28,6 +28,7 @@
 #include "blk-stat.h"
 #include "blk-wbt.h"
 #include "blk-rq-qos.h"
+#include "blk-cgroup.h"
 #include "elevator.h"
 
 #define CREATE_TRACE_POINTS
@@ -89,6 +90,15 @@ struct rq_wb {
 	unsigned long last_issue;		/* last non-throttled issue */
 	unsigned long last_comp;		/* last non-throttled comp */
 	unsigned long min_lat_nsec;
+
+	/*
+	 * Foreground tracking. Reads from the cgroup with id fg_cgrp mark the
+	 * queue foreground-active; other cgroups' background writeback is then
+	 * squeezed harder, and read latency misses count as exceeded windows.
+	 */
+	u64 fg_cgrp;
+	unsigned long last_fg_read;		/* last foreground read issue */
+	unsigned int fg_misses;			/* windows failed due to fg reads */
 	struct rq_qos rqos;
 	struct rq_wait rq_wait[WBT_NUM_RWQ];
 	struct rq_depth rq_depth;
@@ -143,6 +153,9 @@ enum {
 	RWB_UNKNOWN_BUMP	= 5,
 };
 
+/* How long a foreground read keeps the queue foreground-active */
+#define RWB_FG_HOLD	(HZ / 5)
+
 static inline bool rwb_enabled(struct rq_wb *rwb)
 {
 	return rwb && rwb->enable_state != WBT_STATE_OFF_DEFAULT &&
@@ -170,6 +183,24 @@ static bool wb_recent_wait(struct rq_wb *rwb)
 	return time_before(jiffies, bdi->last_bdp_sleep + HZ);
 }
 
+static bool wbt_fg_active(struct rq_wb *rwb)
+{
+	return READ_ONCE(rwb->fg_cgrp) &&
+		time_before(jiffies, READ_ONCE(rwb->last_fg_read) + RWB_FG_HOLD);
+}
+
+static bool wbt_bio_is_fg(struct rq_wb *rwb, struct bio *bio)
+{
+#ifdef CONFIG_BLK_CGROUP
+	u64 id = READ_ONCE(rwb->fg_cgrp);
+
+	return id && bio->bi_blkg &&
+		cgroup_id(bio->bi_blkg->blkcg->css.cgroup) == id;
+#else
+	return false;
+#endif
+}
+
 static inline struct rq_wait *get_rq_wait(struct rq_wb *rwb,
 					  enum wbt_flags wb_acct)
 {
@@ -348,6 +379,17 @@ static int latency_exceeded(struct rq_wb *rwb, struct blk_rq_stat *stat)
 		return LAT_EXCEEDED;
 	}
 
+	/*
+	 * While the foreground is reading, hold reads to the average as well,
+	 * so a few fast reads don't hide the slow ones the user is waiting on.
+	 */
+	if (wbt_fg_active(rwb) && stat[READ].mean > rwb->min_lat_nsec) {
+		rwb->fg_misses++;
+		trace_wbt_lat(bdi, stat[READ].mean);
+		trace_wbt_stat(bdi, stat);
+		return LAT_EXCEEDED;
+	}
+
 	if (rqd->scale_step)
 		trace_wbt_stat(bdi, stat);
 
@@ -449,9 +491,11 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 		/*
 		 * We started a the center step, but don't have a valid
 		 * read/write sample, but we do have writes going on.
-		 * Allow step to go negative, to increase write perf.
+		 * Allow step to go negative, to increase write perf, unless
+		 * the foreground is active.
 		 */
-		scale_up(rwb);
+		if (rqd->scale_step > 0 || !wbt_fg_active(rwb))
+			scale_up(rwb);
 		break;
 	case LAT_UNKNOWN:
 		if (++rwb->unknown_cnt < RWB_UNKNOWN_BUMP)
@@ -520,6 +564,44 @@ void wbt_set_min_lat(struct request_queue *q, u64 val)
 	wbt_update_limits(RQWB(rqos));
 }
 
+u64 wbt_get_fg_cgroup(struct request_queue *q)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+
+	if (!rqos)
+		return 0;
+	return READ_ONCE(RQWB(rqos)->fg_cgrp);
+}
+
+void wbt_set_fg_cgroup(struct request_queue *q, u64 id)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+
+	if (!rqos)
+		return;
+
+	WRITE_ONCE(RQWB(rqos)->fg_cgrp, id);
+	rwb_wake_all(RQWB(rqos));
+}
+
+ssize_t wbt_state_show(struct request_queue *q, char *page)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	struct rq_wb *rwb;
+
+	if (!rqos)
+		return -EINVAL;
+
+	rwb = RQWB(rqos);
+	return sysfs_emit(page,
+			  "scale_step %d\nmax_depth %u\nwb_normal %u\n"
+			  "wb_background %u\ncur_win_usec %llu\nfg_active %d\n"
+			  "fg_misses %u\n",
+			  rwb->rq_depth.scale_step, rwb->rq_depth.max_depth,
+			  rwb->wb_normal, rwb->wb_background,
+			  div_u64(rwb->cur_win_nsec, NSEC_PER_USEC),
+			  wbt_fg_active(rwb), rwb->fg_misses);
+}
 
 static bool close_io(struct rq_wb *rwb)
 {
@@ -531,12 +613,15 @@ static bool close_io(struct rq_wb *rwb)
 
 #define REQ_HIPRIO	(REQ_SYNC | REQ_META | REQ_PRIO)
 
-static inline unsigned int get_limit(struct rq_wb *rwb, blk_opf_t opf)
+static inline unsigned int get_limit(struct rq_wb *rwb, blk_opf_t opf,
+				     bool fg)
 {
 	unsigned int limit;
 
-	if ((opf & REQ_OP_MASK) == REQ_OP_DISCARD)
-		return rwb->wb_background;
+	if ((opf & REQ_OP_MASK) == REQ_OP_DISCARD) {
+		limit = rwb->wb_background;
+		goto fg_backoff;
+	}
 
 	/*
 	 * At this point we know it's a buffered write. If this is
@@ -557,6 +642,17 @@ static inline unsigned int get_limit(struct rq_wb *rwb, blk_opf_t opf)
 	} else
 		limit = rwb->wb_normal;
 
+	if (opf & REQ_HIPRIO)
+		return limit;
+
+fg_backoff:
+	/*
+	 * Writeback from outside the foreground cgroup gets half the
+	 * background limit while the foreground is reading.
+	 */
+	if (!fg && !current_is_kswapd() && wbt_fg_active(rwb))
+		limit = min(limit, max(rwb->wb_background / 2, 1U));
+
 	return limit;
 }
 
@@ -564,12 +660,14 @@ struct wbt_wait_data {
 	struct rq_wb *rwb;
 	enum wbt_flags wb_acct;
 	blk_opf_t opf;
+	bool fg;
 };
 
 static bool wbt_inflight_cb(struct rq_wait *rqw, void *private_data)
 {
 	struct wbt_wait_data *data = private_data;
-	return rq_wait_inc_below(rqw, get_limit(data->rwb, data->opf));
+	return rq_wait_inc_below(rqw, get_limit(data->rwb, data->opf,
+						data->fg));
 }
 
 static void wbt_cleanup_cb(struct rq_wait *rqw, void *private_data)
@@ -583,13 +681,14 @@ static void wbt_cleanup_cb(struct rq_wait *rqw, void *private_data)
  * the timer to kick off queuing again.
  */
 static void __wbt_wait(struct rq_wb *rwb, enum wbt_flags wb_acct,
-		       blk_opf_t opf)
+		       struct bio *bio)
 {
 	struct rq_wait *rqw = get_rq_wait(rwb, wb_acct);
 	struct wbt_wait_data data = {
 		.rwb = rwb,
 		.wb_acct = wb_acct,
-		.opf = opf,
+		.opf = bio->bi_opf,
+		.fg = wbt_bio_is_fg(rwb, bio),
 	};
 
 	rq_qos_wait(rqw, &data, wbt_inflight_cb, wbt_cleanup_cb);
@@ -651,12 +750,15 @@ static void wbt_wait(struct rq_qos *rqos, struct bio *bio)
 
 	flags = bio_to_wbt_flags(rwb, bio);
 	if (!(flags & WBT_TRACKED)) {
-		if (flags & WBT_READ)
+		if (flags & WBT_READ) {
 			wb_timestamp(rwb, &rwb->last_issue);
+			if (wbt_bio_is_fg(rwb, bio))
+				wb_timestamp(rwb, &rwb->last_fg_read);
+		}
 		return;
 	}
 
-	__wbt_wait(rwb, flags, bio->bi_opf);
+	__wbt_wait(rwb, flags, bio);
 
 	if (!blk_stat_is_active(rwb->cb))
 		rwb_arm_timer(rwb);
@@ -12,6 +12,10 @@ u64 wbt_get_min_lat(struct request_queue *q);
 void wbt_set_min_lat(struct request_queue *q, u64 val);
 bool wbt_disabled(struct request_queue *);
 
+u64 wbt_get_fg_cgroup(struct request_queue *q);
+void wbt_set_fg_cgroup(struct request_queue *q, u64 id);
+ssize_t wbt_state_show(struct request_queue *q, char *page);
+
 void wbt_set_write_cache(struct request_queue *, bool);
 
 u64 wbt_default_latency_nsec(struct request_queue *);
@@ -20,6 +20,7 @@
 
 #include "elevator.h"
 #include "blk.h"
+#include "blk-cgroup.h"
 #include "blk-mq.h"
 #include "blk-mq-debugfs.h"
 #include "blk-mq-sched.h"
@@ -37,6 +38,10 @@ static const int prio_aging_expire = 10 * HZ;
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+/* Express lane: max time before a foreground request is submitted. */
+static const int express_expire = HZ / 50;
+/* Express lane requests dispatched in a row while other requests wait. */
+static const int express_quota = 8;
 
 enum dd_data_dir {
 	DD_READ		= READ,
@@ -66,6 +71,19 @@ struct io_stats_per_prio {
 	atomic_t completed;
 };
 
+/* Time from insertion until dispatch, protected by deadline_data.lock. */
+struct dd_dispatch_lat {
+	u64 nr;
+	u64 sum_ns;
+	u64 max_ns;
+};
+
+/* Flags stored in rq->elv.priv[0]. */
+enum {
+	DD_RQ_INSERTED	= 1 << 0,
+	DD_RQ_EXPRESS	= 1 << 1,
+};
+
 /*
  * Deadline scheduler data per I/O priority (enum dd_prio). Requests are
  * present on both sort_list[] and fifo_list[].
@@ -77,6 +95,7 @@ struct dd_per_prio {
 	/* Position of the most recently dispatched request. */
 	sector_t latest_pos[DD_DIR_COUNT];
 	struct io_stats_per_prio stats;
+	struct dd_dispatch_lat lat;
 };
 
 struct deadline_data {
@@ -86,6 +105,15 @@ struct deadline_data {
 
 	struct dd_per_prio per_prio[DD_PRIO_COUNT];
 
+	/*
+	 * Requests from the cgroup with ID express_cgrp (the foreground app),
+	 * whatever their I/O priority. Dispatched before all priority levels,
+	 * but at most express_quota in a row while other requests are
+	 * queued.
+	 */
+	struct dd_per_prio express;
+	unsigned int express_batch;
+
 	/* Data direction of latest dispatched request. */
 	enum dd_data_dir last_dir;
 	unsigned int batching;		/* number of sequential requests made */
@@ -100,6 +128,9 @@ struct deadline_data {
 	int front_merges;
 	u32 async_depth;
 	int prio_aging_expire;
+	u64 express_cgrp;
+	int express_expire;
+	int express_quota;
 
 	spinlock_t lock;
 	spinlock_t zone_lock;
@@ -128,6 +159,40 @@ static u8 dd_rq_ioclass(struct request *rq)
 	return IOPRIO_PRIO_CLASS(req_get_ioprio(rq));
 }
 
+static bool dd_rq_is_express(struct request *rq)
+{
+	return (uintptr_t)rq->elv.priv[0] & DD_RQ_EXPRESS;
+}
+
+/* Returns the lane a request has been inserted into. */
+static struct dd_per_prio *dd_rq_per_prio(struct deadline_data *dd,
+					  struct request *rq)
+{
+	if (dd_rq_is_express(rq))
+		return &dd->express;
+	return &dd->per_prio[ioprio_class_to_prio[dd_rq_ioclass(rq)]];
+}
+
+/* Whether @bio has been issued by the express lane cgroup. */
+static bool dd_bio_is_express(struct deadline_data *dd, struct bio *bio)
+{
+#ifdef CONFIG_BLK_CGROUP
+	u64 id = READ_ONCE(dd->express_cgrp);
+
+	return id && bio && bio->bi_blkg &&
+		cgroup_id(bio->bi_blkg->blkcg->css.cgroup) == id;
+#else
+	return false;
+#endif
+}
+
+static int dd_rq_expire(struct deadline_data *dd, struct request *rq)
+{
+	if (dd_rq_is_express(rq))
+		return dd->express_expire;
+	return dd->fifo_expire[rq_data_dir(rq)];
+}
+
 /*
  * get the request before `rq' in sector-sorted order
  */
@@ -228,9 +293,7 @@ static void dd_request_merged(struct request_queue *q, struct request *req,
 			      enum elv_merge type)
 {
 	struct deadline_data *dd = q->elevator->elevator_data;
-	const u8 ioprio_class = dd_rq_ioclass(req);
-	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
-	struct dd_per_prio *per_prio = &dd->per_prio[prio];
+	struct dd_per_prio *per_prio = dd_rq_per_prio(dd, req);
 
 	/*
 	 * if the merge was a front merge, we need to reposition request
@@ -248,12 +311,11 @@ static void dd_merged_requests(struct request_queue *q, struct request *req,
 			       struct request *next)
 {
 	struct deadline_data *dd = q->elevator->elevator_data;
-	const u8 ioprio_class = dd_rq_ioclass(next);
-	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
+	struct dd_per_prio *per_prio = dd_rq_per_prio(dd, next);
 
 	lockdep_assert_held(&dd->lock);
 
-	dd->per_prio[prio].stats.merged++;
+	per_prio->stats.merged++;
 
 	/*
 	 * if next expires before rq, assign its expire time to rq
@@ -270,7 +332,7 @@ static void dd_merged_requests(struct request_queue *q, struct request *req,
 	/*
 	 * kill knowledge of next, this one is a goner
 	 */
-	deadline_remove_request(q, &dd->per_prio[prio], next);
+	deadline_remove_request(q, per_prio, next);
 }
 
 /*
@@ -286,16 +348,21 @@ deadline_move_request(struct deadline_data *dd, struct dd_per_prio *per_prio,
 	deadline_remove_request(rq->q, per_prio, rq);
 }
 
-/* Number of requests queued for a given priority level. */
-static u32 dd_queued(struct deadline_data *dd, enum dd_prio prio)
+static u32 __dd_queued(struct deadline_data *dd, struct dd_per_prio *per_prio)
 {
-	const struct io_stats_per_prio *stats = &dd->per_prio[prio].stats;
+	const struct io_stats_per_prio *stats = &per_prio->stats;
 
 	lockdep_assert_held(&dd->lock);
 
 	return stats->inserted - atomic_read(&stats->completed);
 }
 
+/* Number of requests queued for a given priority level. */
+static u32 dd_queued(struct deadline_data *dd, enum dd_prio prio)
+{
+	return __dd_queued(dd, &dd->per_prio[prio]);
+}
+
 /*
  * deadline_check_fifo returns true if and only if there are expired requests
  * in the FIFO list. Requires !list_empty(&dd->fifo_list[data_dir]).
@@ -431,7 +498,7 @@ static bool started_after(struct deadline_data *dd, struct request *rq,
 {
 	unsigned long start_time = (unsigned long)rq->fifo_time;
 
-	start_time -= dd->fifo_expire[rq_data_dir(rq)];
+	start_time -= dd_rq_expire(dd, rq);
 
 	return time_after(start_time, latest_start);
 }
@@ -446,8 +513,7 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 {
 	struct request *rq, *next_rq;
 	enum dd_data_dir data_dir;
-	enum dd_prio prio;
-	u8 ioprio_class;
+	u64 lat;
 
 	lockdep_assert_held(&dd->lock);
 
@@ -545,10 +611,15 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd,
 	dd->batching++;
 	deadline_move_request(dd, per_prio, rq);
 done:
-	ioprio_class = dd_rq_ioclass(rq);
-	prio = ioprio_class_to_prio[ioprio_class];
-	dd->per_prio[prio].latest_pos[data_dir] = blk_rq_pos(rq);
-	dd->per_prio[prio].stats.dispatched++;
+	per_prio = dd_rq_per_prio(dd, rq);
+	per_prio->latest_pos[data_dir] = blk_rq_pos(rq);
+	per_prio->stats.dispatched++;
+	/* The insertion time is truncated to unsigned long, so is the delta */
+	lat = (unsigned long)ktime_get_ns() - (uintptr_t)rq->elv.priv[1];
+	per_prio->lat.nr++;
+	per_prio->lat.sum_ns += lat;
+	if (lat > per_prio->lat.max_ns)
+		per_prio->lat.max_ns = lat;
 	/*
 	 * If the request needs its target zone locked, do it.
 	 */
@@ -585,6 +656,47 @@ static struct request *dd_dispatch_prio_aged_requests(struct deadline_data *dd,
 	return NULL;
 }
 
+/*
+ * Dispatch from the express lane ahead of all priority levels. To keep
+ * background I/O moving, give way to one other request after express_quota
+ * express requests in a row.
+ */
+static bool dd_has_work_for_prio(struct dd_per_prio *per_prio)
+{
+	return !list_empty_careful(&per_prio->dispatch) ||
+		!list_empty_careful(&per_prio->fifo_list[DD_READ]) ||
+		!list_empty_careful(&per_prio->fifo_list[DD_WRITE]);
+}
+
+static struct request *dd_dispatch_express(struct deadline_data *dd,
+					   unsigned long now)
+{
+	struct request *rq;
+	enum dd_prio prio;
+	bool others = false;
+
+	lockdep_assert_held(&dd->lock);
+
+	/*
+	 * Test the lists rather than dd_queued(), which also counts requests
+	 * that have been dispatched and not yet completed.
+	 */
+	if (!dd_has_work_for_prio(&dd->express))
+		return NULL;
+
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		others |= dd_has_work_for_prio(&dd->per_prio[prio]);
+	if (others && dd->express_batch >= dd->express_quota) {
+		dd->express_batch = 0;
+		return NULL;
+	}
+
+	rq = __dd_dispatch_request(dd, &dd->express, now);
+	if (rq)
+		dd->express_batch++;
+	return rq;
+}
+
 /*
  * Called from blk_mq_run_hw_queue() -> __blk_mq_sched_dispatch_requests().
  *
@@ -605,6 +717,10 @@ static struct request *dd_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	if (rq)
 		goto unlock;
 
+	rq = dd_dispatch_express(dd, now);
+	if (rq)
+		goto unlock;
+
 	/*
 	 * Next, dispatch requests in priority order. Ignore lower priority
 	 * requests if any higher priority requests are pending.
@@ -682,9 +798,21 @@ static void dd_exit_sched(struct elevator_queue *e)
 			  stats->dispatched, atomic_read(&stats->completed));
 	}
 
+	WARN_ON_ONCE(!list_empty(&dd->express.fifo_list[DD_READ]));
+	WARN_ON_ONCE(!list_empty(&dd->express.fifo_list[DD_WRITE]));
+
 	kfree(dd);
 }
 
+static void dd_init_per_prio(struct dd_per_prio *per_prio)
+{
+	INIT_LIST_HEAD(&per_prio->dispatch);
+	INIT_LIST_HEAD(&per_prio->fifo_list[DD_READ]);
+	INIT_LIST_HEAD(&per_prio->fifo_list[DD_WRITE]);
+	per_prio->sort_list[DD_READ] = RB_ROOT;
+	per_prio->sort_list[DD_WRITE] = RB_ROOT;
+}
+
 /*
  * initialize elevator private data (deadline_data).
  */
@@ -705,15 +833,9 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 
 	eq->elevator_data = dd;
 
-	for (prio = 0; prio <= DD_PRIO_MAX; prio++) {
-		struct dd_per_prio *per_prio = &dd->per_prio[prio];
-
-		INIT_LIST_HEAD(&per_prio->dispatch);
-		INIT_LIST_HEAD(&per_prio->fifo_list[DD_READ]);
-		INIT_LIST_HEAD(&per_prio->fifo_list[DD_WRITE]);
-		per_prio->sort_list[DD_READ] = RB_ROOT;
-		per_prio->sort_list[DD_WRITE] = RB_ROOT;
-	}
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		dd_init_per_prio(&dd->per_prio[prio]);
+	dd_init_per_prio(&dd->express);
 	dd->fifo_expire[DD_READ] = read_expire;
 	dd->fifo_expire[DD_WRITE] = write_expire;
 	dd->writes_starved = writes_starved;
@@ -721,6 +843,8 @@ static int dd_init_sched(struct request_queue *q, struct elevator_type *e)
 	dd->last_dir = DD_WRITE;
 	dd->fifo_batch = fifo_batch;
 	dd->prio_aging_expire = prio_aging_expire;
+	dd->express_expire = express_expire;
+	dd->express_quota = express_quota;
 	spin_lock_init(&dd->lock);
 	spin_lock_init(&dd->zone_lock);
 
@@ -745,7 +869,8 @@ static int dd_request_merge(struct request_queue *q, struct request **rq,
 	struct deadline_data *dd = q->elevator->elevator_data;
 	const u8 ioprio_class = IOPRIO_PRIO_CLASS(bio->bi_ioprio);
 	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
-	struct dd_per_prio *per_prio = &dd->per_prio[prio];
+	struct dd_per_prio *per_prio = dd_bio_is_express(dd, bio) ?
+		&dd->express : &dd->per_prio[prio];
 	sector_t sector = bio_end_sector(bio);
 	struct request *__rq;
 
@@ -796,11 +921,7 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 {
 	struct request_queue *q = hctx->queue;
 	struct deadline_data *dd = q->elevator->elevator_data;
-	const enum dd_data_dir data_dir = rq_data_dir(rq);
-	u16 ioprio = req_get_ioprio(rq);
-	u8 ioprio_class = IOPRIO_PRIO_CLASS(ioprio);
 	struct dd_per_prio *per_prio;
-	enum dd_prio prio;
 
 	lockdep_assert_held(&dd->lock);
 
@@ -810,12 +931,17 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 	 */
 	blk_req_zone_write_unlock(rq);
 
-	prio = ioprio_class_to_prio[ioprio_class];
-	per_prio = &dd->per_prio[prio];
 	if (!rq->elv.priv[0]) {
-		per_prio->stats.inserted++;
-		rq->elv.priv[0] = (void *)(uintptr_t)1;
+		uintptr_t rq_flags = DD_RQ_INSERTED;
+
+		/* A requeued request stays in the lane it was inserted into */
+		if (dd_bio_is_express(dd, rq->bio))
+			rq_flags |= DD_RQ_EXPRESS;
+		rq->elv.priv[0] = (void *)rq_flags;
+		dd_rq_per_prio(dd, rq)->stats.inserted++;
 	}
+	per_prio = dd_rq_per_prio(dd, rq);
+	rq->elv.priv[1] = (void *)(uintptr_t)ktime_get_ns();
 
 	if (blk_mq_sched_try_insert_merge(q, rq, free))
 		return;
@@ -839,8 +965,8 @@ static void dd_insert_request(struct blk_mq_hw_ctx *hctx, struct request *rq,
 		/*
 		 * set expire time and add to fifo list
 		 */
-		rq->fifo_time = jiffies + dd->fifo_expire[data_dir];
-		insert_before = &per_prio->fifo_list[data_dir];
+		rq->fifo_time = jiffies + dd_rq_expire(dd, rq);
+		insert_before = &per_prio->fifo_list[rq_data_dir(rq)];
 #ifdef CONFIG_BLK_DEV_ZONED
 		/*
 		 * Insert zoned writes such that requests are sorted by
@@ -885,6 +1011,7 @@ static void dd_insert_requests(struct blk_mq_hw_ctx *hctx,
 static void dd_prepare_request(struct request *rq)
 {
 	rq->elv.priv[0] = NULL;
+	rq->elv.priv[1] = NULL;
 }
 
 static bool dd_has_write_work(struct blk_mq_hw_ctx *hctx)
@@ -896,7 +1023,7 @@ static bool dd_has_write_work(struct blk_mq_hw_ctx *hctx)
 		if (!list_empty_careful(&dd->per_prio[p].fifo_list[DD_WRITE]))
 			return true;
 
-	return false;
+	return !list_empty_careful(&dd->express.fifo_list[DD_WRITE]);
 }
 
 /*
@@ -919,9 +1046,6 @@ static void dd_finish_request(struct request *rq)
 {
 	struct request_queue *q = rq->q;
 	struct deadline_data *dd = q->elevator->elevator_data;
-	const u8 ioprio_class = dd_rq_ioclass(rq);
-	const enum dd_prio prio = ioprio_class_to_prio[ioprio_class];
-	struct dd_per_prio *per_prio = &dd->per_prio[prio];
 
 	/*
 	 * The block layer core may call dd_finish_request() without having
@@ -931,7 +1055,7 @@ static void dd_finish_request(struct request *rq)
 	if (!rq->elv.priv[0])
 		return;
 
-	atomic_inc(&per_prio->stats.completed);
+	atomic_inc(&dd_rq_per_prio(dd, rq)->stats.completed);
 
 	if (blk_queue_is_zoned(q)) {
 		unsigned long flags;
@@ -945,13 +1069,6 @@ static void dd_finish_request(struct request *rq)
 	}
 }
 
-static bool dd_has_work_for_prio(struct dd_per_prio *per_prio)
-{
-	return !list_empty_careful(&per_prio->dispatch) ||
-		!list_empty_careful(&per_prio->fifo_list[DD_READ]) ||
-		!list_empty_careful(&per_prio->fifo_list[DD_WRITE]);
-}
-
 static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 {
 	struct deadline_data *dd = hctx->queue->elevator->elevator_data;
@@ -961,7 +1078,7 @@ static bool dd_has_work(struct blk_mq_hw_ctx *hctx)
 		if (dd_has_work_for_prio(&dd->per_prio[prio]))
 			return true;
 
-	return false;
+	return dd_has_work_for_prio(&dd->express);
 }
 
 /*
@@ -982,6 +1099,8 @@ SHOW_INT(deadline_writes_starved_show, dd->writes_starved);
 SHOW_INT(deadline_front_merges_show, dd->front_merges);
 SHOW_INT(deadline_async_depth_show, dd->async_depth);
 SHOW_INT(deadline_fifo_batch_show, dd->fifo_batch);
+SHOW_JIFFIES(deadline_express_expire_show, dd->express_expire);
+SHOW_INT(deadline_express_quota_show, dd->express_quota);
 #undef SHOW_INT
 #undef SHOW_JIFFIES
 
@@ -1012,10 +1131,40 @@ STORE_INT(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX);
 STORE_INT(deadline_front_merges_store, &dd->front_merges, 0, 1);
 STORE_INT(deadline_async_depth_store, &dd->async_depth, 1, INT_MAX);
 STORE_INT(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX);
+STORE_JIFFIES(deadline_express_expire_store, &dd->express_expire, 0, INT_MAX);
+STORE_INT(deadline_express_quota_store, &dd->express_quota, 1, INT_MAX);
 #undef STORE_FUNCTION
 #undef STORE_INT
 #undef STORE_JIFFIES
 
+static ssize_t deadline_express_cgroup_show(struct elevator_queue *e,
+					    char *page)
+{
+	struct deadline_data *dd = e->elevator_data;
+
+	return sysfs_emit(page, "%llu\n", READ_ONCE(dd->express_cgrp));
+}
+
+/*
+ * ID of the cgroup (as in the inode number of its cgroup directory) whose
+ * requests go through the express lane, 0 to disable the express lane.
+ */
+static ssize_t deadline_express_cgroup_store(struct elevator_queue *e,
+					     const char *page, size_t count)
+{
+	struct deadline_data *dd = e->elevator_data;
+	u64 id;
+	int ret;
+
+	ret = kstrtou64(page, 0, &id);
+	if (ret < 0)
+		return ret;
+	if (id && !IS_ENABLED(CONFIG_BLK_CGROUP))
+		return -EOPNOTSUPP;
+	WRITE_ONCE(dd->express_cgrp, id);
+	return count;
+}
+
 #define DD_ATTR(name) \
 	__ATTR(name, 0644, deadline_##name##_show, deadline_##name##_store)
 
@@ -1027,6 +1176,9 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(async_depth),
 	DD_ATTR(fifo_batch),
 	DD_ATTR(prio_aging_expire),
+	DD_ATTR(express_cgroup),
+	DD_ATTR(express_expire),
+	DD_ATTR(express_quota),
 	__ATTR_NULL
 };
 
@@ -1137,6 +1289,50 @@ static int dd_queued_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int dd_express_queued_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	u32 queued;
+
+	spin_lock(&dd->lock);
+	queued = __dd_queued(dd, &dd->express);
+	spin_unlock(&dd->lock);
+
+	seq_printf(m, "%u\n", queued);
+
+	return 0;
+}
+
+/*
+ * Number of dispatched requests and their average and maximum time from
+ * insertion until dispatch per lane: express, rt, be and idle.
+ */
+static int dd_dispatch_latency_show(void *data, struct seq_file *m)
+{
+	static const char *const names[] = { "rt", "be", "idle" };
+	struct request_queue *q = data;
+	struct deadline_data *dd = q->elevator->elevator_data;
+	struct dd_dispatch_lat lat[DD_PRIO_COUNT + 1];
+	enum dd_prio prio;
+	int i;
+
+	spin_lock(&dd->lock);
+	lat[0] = dd->express.lat;
+	for (prio = 0; prio <= DD_PRIO_MAX; prio++)
+		lat[prio + 1] = dd->per_prio[prio].lat;
+	spin_unlock(&dd->lock);
+
+	for (i = 0; i < ARRAY_SIZE(lat); i++)
+		seq_printf(m, "%s %llu %llu %llu\n",
+			   i ? names[i - 1] : "express", lat[i].nr,
+			   lat[i].nr ? div64_u64(lat[i].sum_ns, lat[i].nr) /
+				       NSEC_PER_USEC : 0,
+			   div_u64(lat[i].max_ns, NSEC_PER_USEC));
+
+	return 0;
+}
+
 /* Number of requests owned by the block driver for a given priority. */
 static u32 dd_owned_by_driver(struct deadline_data *dd, enum dd_prio prio)
 {
@@ -1235,6 +1431,8 @@ static const struct blk_mq_debugfs_attr deadline_queue_debugfs_attrs[] = {
 	{"dispatch2", 0400, .seq_ops = &deadline_dispatch2_seq_ops},
 	{"owned_by_driver", 0400, dd_owned_by_driver_show},
 	{"queued", 0400, dd_queued_show},
+	{"express_queued", 0400, dd_express_queued_show},
+	{"dispatch_latency", 0400, dd_dispatch_latency_show},
 	{},
 };
 #undef DEADLINE_QUEUE_DDIR_ATTRS
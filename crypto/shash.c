@@ -216,6 +216,69 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+static noinline_for_stack int
+shash_finup_mb_fallback(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	SHASH_DESC_ON_STACK(desc2, tfm);
+	unsigned int i;
+	int err;
+
+	for (i = 0; i < num_msgs - 1; i++) {
+		desc2->tfm = tfm;
+		memcpy(shash_desc_ctx(desc2), shash_desc_ctx(desc),
+		       crypto_shash_descsize(tfm));
+		err = crypto_shash_finup(desc2, data[i], len, outs[i]);
+		if (err)
+			goto out;
+	}
+	err = crypto_shash_finup(desc, data[i], len, outs[i]);
+out:
+	shash_desc_zero(desc2);
+	return err;
+}
+
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct shash_alg *shash = crypto_shash_alg(desc->tfm);
+	unsigned long alignmask = crypto_shash_alignmask(desc->tfm);
+	unsigned int i;
+	int err;
+
+	if (num_msgs == 0)
+		return 0;
+	if (num_msgs == 1)
+		return crypto_shash_finup(desc, data[0], len, outs[0]);
+
+	if (WARN_ON_ONCE(num_msgs > shash->mb_max_msgs))
+		goto fallback;
+	for (i = 0; i < num_msgs; i++) {
+		if (((unsigned long)data[i] | (unsigned long)outs[i]) &
+		    alignmask)
+			goto fallback;
+	}
+
+	if (IS_ENABLED(CONFIG_CRYPTO_STATS)) {
+		struct crypto_istat_hash *istat = shash_get_stat(shash);
+
+		atomic64_add(num_msgs, &istat->hash_cnt);
+		atomic64_add((u64)len * num_msgs, &istat->hash_tlen);
+	}
+
+	err = shash->finup_mb(desc, data, len, outs, num_msgs);
+	if (unlikely(err == -EOPNOTSUPP))
+		goto fallback;
+	return crypto_shash_errstat(shash, err);
+
+fallback:
+	return shash_finup_mb_fallback(desc, data, len, outs, num_msgs);
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_digest_unaligned(struct shash_desc *desc, const u8 *data,
 				  unsigned int len, u8 *out)
 {
@@ -645,6 +708,11 @@ static int shash_prepare_alg(struct shash_alg *alg)
 	if (base->cra_alignmask > MAX_SHASH_ALIGNMASK)
 		return -EINVAL;
 
+	if (alg->mb_max_msgs > 1 && !alg->finup_mb)
+		return -EINVAL;
+	if (!alg->finup_mb)
+		alg->mb_max_msgs = 1;
+
 	if ((alg->export && !alg->import) || (alg->import && !alg->export))
 		return -EINVAL;
 
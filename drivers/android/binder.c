@@ -25,6 +25,11 @@
  *    node->async_todo), as well as thread->transaction_stack
  *    binder_inner_proc_lock() and binder_inner_proc_unlock()
  *    are used to acq/rel
+ * 4) proc->threads_lock : also protects proc->threads, so that
+ *    a thread can look itself up on every ioctl without taking
+ *    proc->inner_lock. Changes to proc->threads hold both locks.
+ *    binder_threads_lock() and binder_threads_unlock() are used
+ *    to acq/rel
  *
  * Any lock under procA must never be nested under any lock at the same
  * level or below on procB.
@@ -67,6 +72,10 @@
 #include <linux/task_work.h>
 #include <linux/sizes.h>
 #include <linux/ktime.h>
+#include <linux/hash.h>
+#include <linux/sort.h>
+#include <linux/memfd.h>
+#include <linux/mman.h>
 
 #include <uapi/linux/sched/types.h>
 #include <uapi/linux/android/binder.h>
@@ -137,6 +146,30 @@ static int binder_set_stop_on_user_error(const char *val,
 module_param_call(stop_on_user_error, binder_set_stop_on_user_error,
 	param_get_int, &binder_stop_on_user_error, 0644);
 
+/*
+ * With spawn_policy set, BR_SPAWN_LOOPER is driven by how long sync work
+ * waits on proc->todo for a thread instead of by pool exhaustion, and
+ * spawned loopers that stay idle while the proc is quiet are told to exit.
+ */
+static bool binder_spawn_policy;
+module_param_named(spawn_policy, binder_spawn_policy, bool, 0644);
+
+static uint binder_spawn_wait_us = 2000;
+module_param_named(spawn_wait_us, binder_spawn_wait_us, uint, 0644);
+
+static uint binder_idle_exit_ms = 10000;
+module_param_named(idle_exit_ms, binder_idle_exit_ms, uint, 0644);
+
+#define BINDER_SPAWN_RATE_WINDOW	(HZ / 10)
+
+/*
+ * Async transactions to a frozen proc are held back and queued in one go on
+ * thaw. A new one is checked against the newest frozen_defer_max deferred
+ * ones for a transaction it supersedes. 0 queues them right away.
+ */
+static uint binder_frozen_defer_max = 64;
+module_param_named(frozen_defer_max, binder_frozen_defer_max, uint, 0644);
+
 static __printf(2, 3) void binder_debug(int mask, const char *format, ...)
 {
 	struct va_format vaf;
@@ -248,6 +281,89 @@ static struct binder_transaction_log_entry *binder_transaction_log_add(
 	return e;
 }
 
+/*
+ * Always-on latency aggregate per (target node, code). A transaction is
+ * accounted when it's delivered as BR_TRANSACTION and, if sync, again when
+ * the server replies, both relative to when the client sent it. The table
+ * is direct mapped by a hash of the key. A (node, code) pair whose slot
+ * holds another pair takes it over and starts from zero, so slots of nodes
+ * which have gone away are reused rather than filling up the table.
+ */
+#define BINDER_LAT_SLOTS	256
+#define BINDER_LAT_BUCKETS	16	/* log2(usecs), the last one is open */
+#define BINDER_LAT_TOP		32
+
+struct binder_lat_slot {
+	atomic64_t key;		/* node debug_id << 32 | code, 0 if unused */
+	int pid;		/* proc owning the node */
+	atomic_t nr_delivered;
+	atomic_t nr_replied;
+	atomic64_t deliver_us;
+	atomic64_t reply_us;
+	atomic_t reply_hist[BINDER_LAT_BUCKETS];
+};
+
+static struct binder_lat_slot binder_lat_slots[BINDER_LAT_SLOTS];
+static atomic_t binder_lat_dropped;
+static atomic_t binder_lat_evicted;
+
+static struct binder_lat_slot *binder_lat_slot(u64 key)
+{
+	return &binder_lat_slots[hash_64(key, ilog2(BINDER_LAT_SLOTS))];
+}
+
+/* Returns the key for binder_latency_reply(), 0 if untracked */
+static u64 binder_latency_deliver(struct binder_transaction *t,
+				  struct binder_node *node, int pid)
+{
+	u64 key = (u64)node->debug_id << 32 | t->code;
+	struct binder_lat_slot *slot = binder_lat_slot(key);
+	s64 cur = atomic64_read(&slot->key);
+	int i;
+
+	if (cur != key) {
+		/* lost a race for the slot, don't reset it twice */
+		if (atomic64_cmpxchg(&slot->key, cur, key) != cur) {
+			atomic_inc(&binder_lat_dropped);
+			return 0;
+		}
+		if (cur)
+			atomic_inc(&binder_lat_evicted);
+		slot->pid = pid;
+		atomic_set(&slot->nr_delivered, 0);
+		atomic_set(&slot->nr_replied, 0);
+		atomic64_set(&slot->deliver_us, 0);
+		atomic64_set(&slot->reply_us, 0);
+		for (i = 0; i < BINDER_LAT_BUCKETS; i++)
+			atomic_set(&slot->reply_hist[i], 0);
+	}
+
+	atomic_inc(&slot->nr_delivered);
+	atomic64_add(ktime_us_delta(ktime_get(), t->start_time),
+		     &slot->deliver_us);
+	return key;
+}
+
+static void binder_latency_reply(struct binder_transaction *in_reply_to)
+{
+	struct binder_lat_slot *slot;
+	s64 us;
+
+	if (!in_reply_to->lat_key)
+		return;
+
+	/* the slot may have been taken over since the transaction's delivery */
+	slot = binder_lat_slot(in_reply_to->lat_key);
+	if (atomic64_read(&slot->key) != in_reply_to->lat_key)
+		return;
+
+	us = max_t(s64, ktime_us_delta(ktime_get(), in_reply_to->start_time), 0);
+	atomic_inc(&slot->nr_replied);
+	atomic64_add(us, &slot->reply_us);
+	atomic_inc(&slot->reply_hist[min_t(int, us ? ilog2(us) : 0,
+					   BINDER_LAT_BUCKETS - 1)]);
+}
+
 enum binder_deferred_state {
 	BINDER_DEFERRED_FLUSH        = 0x01,
 	BINDER_DEFERRED_RELEASE      = 0x02,
@@ -260,8 +376,22 @@ enum {
 	BINDER_LOOPER_STATE_INVALID     = 0x08,
 	BINDER_LOOPER_STATE_WAITING     = 0x10,
 	BINDER_LOOPER_STATE_POLL        = 0x20,
+	BINDER_LOOPER_STATE_RETIRED     = 0x40,
 };
 
+/* the contention check is a trylock, so it costs nothing uncontended */
+static inline void binder_spin_lock_stat(spinlock_t *lock,
+					 struct binder_lock_stat *stat)
+	__acquires(lock)
+{
+	bool contended = !spin_trylock(lock);
+
+	if (contended)
+		spin_lock(lock);
+	stat->acquired++;
+	stat->contended += contended;
+}
+
 /**
  * binder_proc_lock() - Acquire outer lock for given binder_proc
  * @proc:         struct binder_proc to acquire
@@ -276,7 +406,7 @@ _binder_proc_lock(struct binder_proc *proc, int line)
 {
 	binder_debug(BINDER_DEBUG_SPINLOCKS,
 		     "%s: line=%d\n", __func__, line);
-	spin_lock(&proc->outer_lock);
+	binder_spin_lock_stat(&proc->outer_lock, &proc->outer_stat);
 }
 
 /**
@@ -308,7 +438,7 @@ _binder_inner_proc_lock(struct binder_proc *proc, int line)
 {
 	binder_debug(BINDER_DEBUG_SPINLOCKS,
 		     "%s: line=%d\n", __func__, line);
-	spin_lock(&proc->inner_lock);
+	binder_spin_lock_stat(&proc->inner_lock, &proc->inner_stat);
 }
 
 /**
@@ -327,6 +457,38 @@ _binder_inner_proc_unlock(struct binder_proc *proc, int line)
 	spin_unlock(&proc->inner_lock);
 }
 
+/**
+ * binder_threads_lock() - Acquire threads lock for given binder_proc
+ * @proc:         struct binder_proc to acquire
+ *
+ * Acquires proc->threads_lock. Used to protect proc->threads
+ */
+#define binder_threads_lock(proc) _binder_threads_lock(proc, __LINE__)
+static void
+_binder_threads_lock(struct binder_proc *proc, int line)
+	__acquires(&proc->threads_lock)
+{
+	binder_debug(BINDER_DEBUG_SPINLOCKS,
+		     "%s: line=%d\n", __func__, line);
+	binder_spin_lock_stat(&proc->threads_lock, &proc->threads_stat);
+}
+
+/**
+ * binder_threads_unlock() - Release threads lock for given binder_proc
+ * @proc:         struct binder_proc to acquire
+ *
+ * Release lock acquired via binder_threads_lock()
+ */
+#define binder_threads_unlock(proc) _binder_threads_unlock(proc, __LINE__)
+static void
+_binder_threads_unlock(struct binder_proc *proc, int line)
+	__releases(&proc->threads_lock)
+{
+	binder_debug(BINDER_DEBUG_SPINLOCKS,
+		     "%s: line=%d\n", __func__, line);
+	spin_unlock(&proc->threads_lock);
+}
+
 /**
  * binder_node_lock() - Acquire spinlock for given binder_node
  * @node:         struct binder_node to acquire
@@ -550,6 +712,8 @@ binder_defer_work(struct binder_proc *proc, enum binder_deferred_state defer);
 static void binder_free_thread(struct binder_thread *thread);
 static void binder_free_proc(struct binder_proc *proc);
 static void binder_inc_node_tmpref_ilocked(struct binder_node *node);
+static void binder_release_work(struct binder_proc *proc,
+				struct list_head *list);
 
 static bool binder_has_work_ilocked(struct binder_thread *thread,
 				    bool do_proc_work)
@@ -863,6 +1027,7 @@ static void binder_transaction_priority(struct binder_thread *thread,
 	spin_unlock(&thread->prio_lock);
 
 	binder_set_priority(thread, &desired);
+	scx_sync_inherit_begin(task, &t->scx_prop, &t->saved_scx_prop);
 	trace_android_vh_binder_set_priority(t, task);
 }
 
@@ -2510,6 +2675,47 @@ static int binder_translate_fd(u32 fd, binder_size_t fd_offset,
 	return ret;
 }
 
+/*
+ * Only files whose contents can't change under the receiver are mapped:
+ * memfds sealed with F_SEAL_WRITE and F_SEAL_SHRINK. F_SEAL_FUTURE_WRITE
+ * leaves existing shared writable mappings, and a dma-buf's exporter and
+ * importers can write to it, so neither is accepted.
+ */
+static int binder_translate_fd_map(struct binder_fd_object *fp,
+				   binder_size_t object_offset,
+				   struct binder_transaction *t,
+				   struct binder_thread *thread)
+{
+	struct binder_proc *proc = thread->proc;
+	struct binder_txn_fd_fixup *fixup;
+	struct file *file;
+	long seals;
+	size_t len;
+
+	fixup = list_last_entry(&t->fd_fixups, struct binder_txn_fd_fixup,
+				fixup_entry);
+	file = fixup->file;
+
+	seals = memfd_fcntl(file, F_GET_SEALS, 0);
+	if (seals < 0 || !(seals & F_SEAL_SHRINK) || !(seals & F_SEAL_WRITE)) {
+		binder_user_error("%d:%d fd %d to map isn't a write sealed memfd\n",
+				  proc->pid, thread->pid, fp->fd);
+		return -EPERM;
+	}
+	len = i_size_read(file_inode(file));
+
+	if (!len) {
+		binder_user_error("%d:%d fd %d to map is empty\n",
+				  proc->pid, thread->pid, fp->fd);
+		return -EINVAL;
+	}
+
+	fixup->map_offset = object_offset + offsetof(struct binder_fd_object,
+						     cookie);
+	fixup->map_len = len;
+	return 0;
+}
+
 /**
  * struct binder_ptr_fixup - data to be fixed-up in target buffer
  * @offset	offset in target buffer to fixup
@@ -2922,6 +3128,148 @@ binder_find_outdated_transaction_ilocked(struct binder_transaction *t,
 	return NULL;
 }
 
+/* payloads up to this size are compared to coalesce deferred transactions */
+#define BINDER_DEFER_CMP_MAX	128
+
+static bool binder_txn_same_payload(struct binder_proc *proc,
+				    struct binder_transaction *t1,
+				    struct binder_transaction *t2)
+{
+	struct binder_buffer *b1 = t1->buffer, *b2 = t2->buffer;
+	u8 d1[32], d2[32];
+	size_t off;
+
+	if (t1->code != t2->code || t1->flags != t2->flags ||
+	    t1->sender_euid.val != t2->sender_euid.val ||
+	    b1->target_node != b2->target_node || b1->pid != b2->pid ||
+	    b1->data_size != b2->data_size ||
+	    b1->data_size > BINDER_DEFER_CMP_MAX ||
+	    b1->offsets_size || b2->offsets_size ||
+	    b1->extra_buffers_size || b2->extra_buffers_size)
+		return false;
+
+	for (off = 0; off < b1->data_size; off += sizeof(d1)) {
+		size_t len = min(b1->data_size - off, sizeof(d1));
+
+		if (binder_alloc_copy_from_buffer(&proc->alloc, d1, b1,
+						  off, len) ||
+		    binder_alloc_copy_from_buffer(&proc->alloc, d2, b2,
+						  off, len) ||
+		    memcmp(d1, d2, len))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * binder_frozen_defer_ilocked() - hold back an async transaction until thaw
+ * @proc:	frozen process @t is sent to
+ * @t:		new async transaction
+ * @t_outdated:	set to a deferred transaction @t supersedes
+ *
+ * A deferred transaction that @t may update, see
+ * binder_can_update_transaction(), or that carries the same object-less
+ * payload is replaced by @t and returned in @t_outdated to be freed. Only
+ * the newest frozen_defer_max deferred transactions are looked at, older
+ * ones stay queued.
+ *
+ * Also called after thaw while binder_frozen_deliver() is still draining
+ * @proc->frozen_todo, so that @t can't overtake the deferred transactions.
+ *
+ * Return: true if @t was deferred, false if deferring is disabled
+ *
+ * Requires the proc->inner_lock to be held.
+ */
+static bool binder_frozen_defer_ilocked(struct binder_proc *proc,
+					struct binder_transaction *t,
+					struct binder_transaction **t_outdated)
+{
+	uint scan = READ_ONCE(binder_frozen_defer_max);
+	struct binder_work *w;
+
+	if (!scan && list_empty(&proc->frozen_todo))
+		return false;
+
+	list_for_each_entry_reverse(w, &proc->frozen_todo, entry) {
+		struct binder_transaction *t_queued;
+
+		if (!scan--)
+			break;
+		t_queued = container_of(w, struct binder_transaction, work);
+		if (binder_can_update_transaction(t_queued, t) ||
+		    binder_txn_same_payload(proc, t_queued, t)) {
+			binder_debug(BINDER_DEBUG_TRANSACTION,
+				     "txn %d supersedes deferred %d\n",
+				     t->debug_id, t_queued->debug_id);
+			list_del_init(&t_queued->work.entry);
+			proc->nr_frozen_todo--;
+			proc->outstanding_txns--;
+			*t_outdated = t_queued;
+			break;
+		}
+	}
+
+	binder_enqueue_work_ilocked(&t->work, &proc->frozen_todo);
+	proc->nr_frozen_todo++;
+	return true;
+}
+
+/**
+ * binder_frozen_deliver() - queue the transactions deferred while frozen
+ * @proc:	process that was thawed
+ *
+ * Async transactions keep their per-node ordering, and a single wakeup is
+ * issued once all of them are queued.
+ *
+ * The transactions are taken off the head of @proc->frozen_todo one at a
+ * time, and new async transactions are appended to it for as long as it
+ * isn't empty, so none of them overtakes the deferred ones. Draining stops
+ * if @proc is frozen again or dies, the rest then stays deferred or is
+ * released with @proc's other work.
+ */
+static void binder_frozen_deliver(struct binder_proc *proc)
+{
+	struct binder_transaction *t;
+	struct binder_node *node;
+
+	for (;;) {
+		binder_inner_proc_lock(proc);
+		t = list_first_entry_or_null(&proc->frozen_todo,
+					     struct binder_transaction,
+					     work.entry);
+		if (!t || proc->is_frozen || proc->is_dead)
+			break;
+		node = t->buffer->target_node;
+		binder_inc_node_tmpref_ilocked(node);
+		binder_inner_proc_unlock(proc);
+
+		binder_node_lock(node);
+		binder_inner_proc_lock(proc);
+		/* @t may have been superseded while the lock was dropped */
+		if (!proc->is_frozen && !proc->is_dead &&
+		    list_first_entry(&proc->frozen_todo,
+				     struct binder_transaction, work.entry) == t) {
+			list_del_init(&t->work.entry);
+			proc->nr_frozen_todo--;
+			if (node->has_async_transaction) {
+				binder_enqueue_work_ilocked(&t->work,
+							    &node->async_todo);
+			} else {
+				node->has_async_transaction = true;
+				binder_enqueue_work_ilocked(&t->work,
+							    &proc->todo);
+			}
+		}
+		binder_inner_proc_unlock(proc);
+		binder_node_unlock(node);
+		binder_dec_node_tmpref(node);
+	}
+
+	if (!binder_worklist_empty_ilocked(&proc->todo))
+		binder_wakeup_proc_ilocked(proc);
+	binder_inner_proc_unlock(proc);
+}
+
 /**
  * binder_proc_transaction() - sends a transaction to a process and wakes it up
  * @t:		transaction to send
@@ -2979,6 +3327,14 @@ static int binder_proc_transaction(struct binder_transaction *t,
 		return frozen ? BR_FROZEN_REPLY : BR_DEAD_REPLY;
 	}
 
+	if (oneway && (frozen || !list_empty(&proc->frozen_todo)) &&
+	    binder_frozen_defer_ilocked(proc, t, &t_outdated)) {
+		/* the node's async slot is taken on thaw */
+		if (!pending_async)
+			node->has_async_transaction = false;
+		goto queued;
+	}
+
 	if (!thread && !pending_async)
 		thread = binder_select_thread_ilocked(proc);
 
@@ -3017,6 +3373,7 @@ static int binder_proc_transaction(struct binder_transaction *t,
 	if (!pending_async)
 		binder_wakeup_thread_ilocked(proc, thread, !oneway /* sync */);
 
+queued:
 	proc->outstanding_txns++;
 	binder_inner_proc_unlock(proc);
 	binder_node_unlock(node);
@@ -3184,6 +3541,7 @@ static void binder_transaction(struct binder_proc *proc,
 		}
 		thread->transaction_stack = in_reply_to->to_parent;
 		binder_inner_proc_unlock(proc);
+		binder_latency_reply(in_reply_to);
 		target_thread = binder_get_txn_from_and_acq_inner(in_reply_to);
 		if (target_thread == NULL) {
 			/* annotation for sparse */
@@ -3408,6 +3766,8 @@ static void binder_transaction(struct binder_proc *proc,
 	t->code = tr->code;
 	t->flags = tr->flags;
 	t->is_nested = is_nested;
+	if (!(t->flags & TF_ONE_WAY))
+		scx_sync_prop_capture(current, &t->scx_prop);
 	if (!(t->flags & TF_ONE_WAY) &&
 	    binder_supported_policy(current->policy)) {
 		/* Inherit supported policies for synchronous transactions */
@@ -3638,6 +3998,12 @@ static void binder_transaction(struct binder_proc *proc,
 			int ret = binder_translate_fd(fp->fd, fd_offset, t,
 						      thread, in_reply_to);
 
+			if (!ret && (fp->pad_flags & BINDER_FD_FLAG_MAP_RO)) {
+				ret = binder_translate_fd_map(fp, object_offset,
+							      t, thread);
+				/* the fixup writes the mapping address here */
+				fp->cookie = 0;
+			}
 			fp->pad_binder = 0;
 			if (ret < 0 ||
 			    binder_alloc_copy_to_buffer(&target_proc->alloc,
@@ -3839,6 +4205,7 @@ static void binder_transaction(struct binder_proc *proc,
 		wake_up_interruptible_sync(&target_thread->wait);
 		trace_android_vh_binder_restore_priority(in_reply_to, current);
 		binder_restore_priority(thread, &in_reply_to->saved_priority);
+		scx_sync_inherit_end(thread->task, &in_reply_to->saved_scx_prop);
 		binder_free_transaction(in_reply_to);
 	} else if (!(t->flags & TF_ONE_WAY)) {
 		BUG_ON(t->buffer->async_transaction != 0);
@@ -3971,6 +4338,7 @@ static void binder_transaction(struct binder_proc *proc,
 	if (in_reply_to) {
 		trace_android_vh_binder_restore_priority(in_reply_to, current);
 		binder_restore_priority(thread, &in_reply_to->saved_priority);
+		scx_sync_inherit_end(thread->task, &in_reply_to->saved_scx_prop);
 		binder_set_txn_from_error(in_reply_to, t_debug_id,
 				return_error, return_error_param);
 		thread->return_error.cmd = BR_TRANSACTION_COMPLETE;
@@ -4531,13 +4899,93 @@ static int binder_put_node_cmd(struct binder_proc *proc,
 	return 0;
 }
 
+static void binder_spawn_rollover_ilocked(struct binder_proc *proc)
+{
+	unsigned long now = jiffies;
+
+	if (time_before(now, proc->spawn_window + BINDER_SPAWN_RATE_WINDOW))
+		return;
+
+	/* a window without any samples counts as an idle one */
+	if (time_after_eq(now, proc->spawn_window +
+			  2 * BINDER_SPAWN_RATE_WINDOW))
+		proc->spawn_rate_cur = 0;
+	if (!proc->spawn_rate_cur)
+		proc->spawn_wait_us /= 2;
+	proc->spawn_rate_prev = proc->spawn_rate_cur;
+	proc->spawn_rate_cur = 0;
+	proc->spawn_window = now;
+}
+
+/*
+ * Account a sync transaction taken off proc->todo. The wait is measured
+ * from when the sender issued it, which is close enough to the enqueue.
+ */
+static void binder_spawn_account_ilocked(struct binder_proc *proc,
+					 struct binder_transaction *t)
+{
+	s64 us;
+
+	if (!binder_spawn_policy || (t->flags & TF_ONE_WAY))
+		return;
+
+	binder_spawn_rollover_ilocked(proc);
+	us = clamp_t(s64, ktime_us_delta(ktime_get(), t->start_time),
+		     0, USEC_PER_SEC);
+	proc->spawn_wait_us = (proc->spawn_wait_us * 7 + us) / 8;
+	proc->spawn_rate_cur++;
+}
+
+/* whether the pool should grow, with no thread waiting for proc work */
+static bool binder_spawn_wanted_ilocked(struct binder_proc *proc)
+{
+	if (!list_empty(&proc->waiting_threads))
+		return false;
+	if (!binder_spawn_policy)
+		return true;
+
+	binder_spawn_rollover_ilocked(proc);
+	if (!binder_worklist_empty_ilocked(&proc->todo))
+		return true;
+	if (proc->spawn_wait_us >= binder_spawn_wait_us)
+		return true;
+	/* a burst is building up, get ahead of it */
+	return proc->spawn_rate_cur > 2 * proc->spawn_rate_prev &&
+	       proc->spawn_rate_cur >= 8;
+}
+
+/*
+ * A spawned looper which timed out waiting for proc work may go away if the
+ * proc is quiet and another thread is still waiting. Userspace handles the
+ * -ETIMEDOUT from the read by exiting a non-main looper.
+ */
+static bool binder_spawn_retire_ilocked(struct binder_thread *thread)
+{
+	struct binder_proc *proc = thread->proc;
+
+	binder_spawn_rollover_ilocked(proc);
+	if (list_empty(&proc->waiting_threads) ||
+	    proc->spawn_wait_us >= binder_spawn_wait_us / 2 ||
+	    proc->spawn_rate_cur > proc->spawn_rate_prev)
+		return false;
+
+	thread->looper |= BINDER_LOOPER_STATE_RETIRED;
+	proc->requested_threads_started--;
+	return true;
+}
+
 static int binder_wait_for_work(struct binder_thread *thread,
 				bool do_proc_work)
 {
 	DEFINE_WAIT(wait);
 	struct binder_proc *proc = thread->proc;
+	long timeout = MAX_SCHEDULE_TIMEOUT;
 	int ret = 0;
 
+	if (binder_spawn_policy && do_proc_work && binder_idle_exit_ms &&
+	    (thread->looper & BINDER_LOOPER_STATE_REGISTERED))
+		timeout = msecs_to_jiffies(binder_idle_exit_ms);
+
 	binder_inner_proc_lock(proc);
 	for (;;) {
 		prepare_to_wait(&thread->wait, &wait, TASK_INTERRUPTIBLE|TASK_FREEZABLE);
@@ -4548,13 +4996,21 @@ static int binder_wait_for_work(struct binder_thread *thread,
 				 &proc->waiting_threads);
 		trace_android_vh_binder_wait_for_work(do_proc_work, thread, proc);
 		binder_inner_proc_unlock(proc);
-		schedule();
+		timeout = schedule_timeout(timeout);
 		binder_inner_proc_lock(proc);
 		list_del_init(&thread->waiting_thread_node);
 		if (signal_pending(current)) {
 			ret = -EINTR;
 			break;
 		}
+		if (!timeout) {
+			if (!binder_has_work_ilocked(thread, do_proc_work) &&
+			    binder_spawn_retire_ilocked(thread)) {
+				ret = -ETIMEDOUT;
+				break;
+			}
+			timeout = msecs_to_jiffies(binder_idle_exit_ms);
+		}
 	}
 	finish_wait(&thread->wait, &wait);
 	binder_inner_proc_unlock(proc);
@@ -4602,6 +5058,29 @@ static int binder_apply_fd_fixups(struct binder_proc *proc,
 			ret = -EINVAL;
 			goto err;
 		}
+		if (fixup->map_len) {
+			binder_uintptr_t cookie;
+			unsigned long addr;
+
+			addr = vm_mmap(fixup->file, 0, fixup->map_len,
+				       PROT_READ, MAP_SHARED, 0);
+			if (IS_ERR_VALUE(addr)) {
+				binder_debug(BINDER_DEBUG_TRANSACTION,
+					     "failed map fixup txn %d fd %d: %ld\n",
+					     t->debug_id, fd, (long)addr);
+				ret = (int)addr;
+				goto err;
+			}
+			fixup->map_addr = addr;
+			cookie = addr;
+			if (binder_alloc_copy_to_buffer(&proc->alloc, t->buffer,
+							fixup->map_offset,
+							&cookie,
+							sizeof(cookie))) {
+				ret = -EINVAL;
+				goto err;
+			}
+		}
 	}
 	list_for_each_entry_safe(fixup, tmp, &t->fd_fixups, fixup_entry) {
 		fd_install(fixup->target_fd, fixup->file);
@@ -4612,6 +5091,9 @@ static int binder_apply_fd_fixups(struct binder_proc *proc,
 	return ret;
 
 err:
+	list_for_each_entry(fixup, &t->fd_fixups, fixup_entry)
+		if (fixup->map_addr)
+			vm_munmap(fixup->map_addr, fixup->map_len);
 	binder_free_txn_fixups(t);
 	return ret;
 }
@@ -4638,6 +5120,11 @@ static int binder_thread_read(struct binder_proc *proc,
 
 retry:
 	binder_inner_proc_lock(proc);
+	if (thread->looper & BINDER_LOOPER_STATE_RETIRED) {
+		/* userspace kept the retired looper, count it again */
+		thread->looper &= ~BINDER_LOOPER_STATE_RETIRED;
+		proc->requested_threads_started++;
+	}
 	wait_for_proc_work = binder_available_for_proc_work_ilocked(thread);
 	binder_inner_proc_unlock(proc);
 
@@ -4656,6 +5143,7 @@ static int binder_thread_read(struct binder_proc *proc,
 		}
 		trace_android_vh_binder_restore_priority(NULL, current);
 		binder_restore_priority(thread, &proc->default_priority);
+		scx_sync_inherit_end(thread->task, NULL);
 	}
 
 	if (non_block) {
@@ -4714,8 +5202,10 @@ static int binder_thread_read(struct binder_proc *proc,
 
 		switch (w->type) {
 		case BINDER_WORK_TRANSACTION: {
-			binder_inner_proc_unlock(proc);
 			t = container_of(w, struct binder_transaction, work);
+			if (list == &proc->todo)
+				binder_spawn_account_ilocked(proc, t);
+			binder_inner_proc_unlock(proc);
 		} break;
 		case BINDER_WORK_RETURN_ERROR: {
 			struct binder_error *e = container_of(
@@ -4898,6 +5388,8 @@ static int binder_thread_read(struct binder_proc *proc,
 			trd->target.ptr = target_node->ptr;
 			trd->cookie =  target_node->cookie;
 			binder_transaction_priority(thread, t, target_node);
+			t->lat_key = binder_latency_deliver(t, target_node,
+							    proc->pid);
 			cmd = BR_TRANSACTION;
 		} else {
 			trd->target.ptr = 0;
@@ -5018,7 +5510,7 @@ static int binder_thread_read(struct binder_proc *proc,
 	trace_android_vh_binder_spawn_new_thread(thread, proc, &force_spawn);
 
 	if (force_spawn || (proc->requested_threads == 0 &&
-	    list_empty(&thread->proc->waiting_threads) &&
+	    binder_spawn_wanted_ilocked(proc) &&
 	    proc->requested_threads_started < proc->max_threads &&
 	    (thread->looper & (BINDER_LOOPER_STATE_REGISTERED |
 	     BINDER_LOOPER_STATE_ENTERED)))/* the user-space code fails to */
@@ -5097,6 +5589,10 @@ static void binder_release_work(struct binder_proc *proc,
 
 }
 
+/*
+ * Looking up needs proc->inner_lock or proc->threads_lock, inserting
+ * @new_thread needs both.
+ */
 static struct binder_thread *binder_get_thread_ilocked(
 		struct binder_proc *proc, struct binder_thread *new_thread)
 {
@@ -5145,15 +5641,17 @@ static struct binder_thread *binder_get_thread(struct binder_proc *proc)
 	struct binder_thread *thread;
 	struct binder_thread *new_thread;
 
-	binder_inner_proc_lock(proc);
+	binder_threads_lock(proc);
 	thread = binder_get_thread_ilocked(proc, NULL);
-	binder_inner_proc_unlock(proc);
+	binder_threads_unlock(proc);
 	if (!thread) {
 		new_thread = kzalloc(sizeof(*thread), GFP_KERNEL);
 		if (new_thread == NULL)
 			return NULL;
 		binder_inner_proc_lock(proc);
+		binder_threads_lock(proc);
 		thread = binder_get_thread_ilocked(proc, new_thread);
+		binder_threads_unlock(proc);
 		binder_inner_proc_unlock(proc);
 		if (thread != new_thread)
 			kfree(new_thread);
@@ -5213,7 +5711,9 @@ static int binder_thread_release(struct binder_proc *proc,
 	 * survives while we are releasing it
 	 */
 	atomic_inc(&thread->tmp_ref);
+	binder_threads_lock(proc);
 	rb_erase(&thread->rb_node, &proc->threads);
+	binder_threads_unlock(proc);
 	t = thread->transaction_stack;
 	if (t) {
 		spin_lock(&t->lock);
@@ -5508,6 +6008,7 @@ static int binder_ioctl_freeze(struct binder_freeze_info *info,
 		target_proc->async_recv = false;
 		target_proc->is_frozen = false;
 		binder_inner_proc_unlock(target_proc);
+		binder_frozen_deliver(target_proc);
 		return 0;
 	}
 
@@ -5540,6 +6041,7 @@ static int binder_ioctl_freeze(struct binder_freeze_info *info,
 		binder_inner_proc_lock(target_proc);
 		target_proc->is_frozen = false;
 		binder_inner_proc_unlock(target_proc);
+		binder_frozen_deliver(target_proc);
 	}
 
 	return ret;
@@ -5892,10 +6394,12 @@ static int binder_open(struct inode *nodp, struct file *filp)
 		return -ENOMEM;
 	spin_lock_init(&proc->inner_lock);
 	spin_lock_init(&proc->outer_lock);
+	spin_lock_init(&proc->threads_lock);
 	get_task_struct(current->group_leader);
 	proc->tsk = current->group_leader;
 	proc->cred = get_cred(filp->f_cred);
 	INIT_LIST_HEAD(&proc->todo);
+	INIT_LIST_HEAD(&proc->frozen_todo);
 	init_waitqueue_head(&proc->freeze_wait);
 	if (binder_supported_policy(current->policy)) {
 		proc->default_priority.sched_policy = current->policy;
@@ -6167,6 +6671,7 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_proc_unlock(proc);
 
 	binder_release_work(proc, &proc->todo);
+	binder_release_work(proc, &proc->frozen_todo);
 	trace_android_vh_binder_release_special_work(proc, &special_list);
 	if (special_list)
 		binder_release_work(proc, special_list);
@@ -6585,6 +7090,19 @@ static void print_binder_proc_stats(struct seq_file *m,
 			proc->requested_threads_started, proc->max_threads,
 			ready_threads,
 			free_async_space);
+	seq_printf(m, "  inner lock: %lu acquired, %lu contended\n"
+			"  outer lock: %lu acquired, %lu contended\n"
+			"  threads lock: %lu acquired, %lu contended\n",
+			proc->inner_stat.acquired, proc->inner_stat.contended,
+			proc->outer_stat.acquired, proc->outer_stat.contended,
+			proc->threads_stat.acquired,
+			proc->threads_stat.contended);
+	if (proc->nr_frozen_todo)
+		seq_printf(m, "  frozen deferred %d\n", proc->nr_frozen_todo);
+	if (binder_spawn_policy)
+		seq_printf(m, "  spawn wait %u us rate %u/%u\n",
+			   proc->spawn_wait_us, proc->spawn_rate_cur,
+			   proc->spawn_rate_prev);
 	count = 0;
 	for (n = rb_first(&proc->nodes); n != NULL; n = rb_next(n))
 		count++;
@@ -6753,6 +7271,78 @@ static int transaction_log_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+struct binder_lat_entry {
+	u64 key;
+	int pid;
+	u32 nr_delivered;
+	u32 nr_replied;
+	u64 deliver_us;
+	u64 reply_us;
+	u32 reply_hist[BINDER_LAT_BUCKETS];
+};
+
+/* slowest first by total reply time, then by total delivery time */
+static int binder_lat_entry_cmp(const void *a, const void *b)
+{
+	const struct binder_lat_entry *ea = a, *eb = b;
+
+	if (ea->reply_us != eb->reply_us)
+		return ea->reply_us < eb->reply_us ? 1 : -1;
+	if (ea->deliver_us != eb->deliver_us)
+		return ea->deliver_us < eb->deliver_us ? 1 : -1;
+	return 0;
+}
+
+static int latency_show(struct seq_file *m, void *unused)
+{
+	struct binder_lat_entry *entries;
+	int i, j, nr = 0;
+
+	entries = kcalloc(BINDER_LAT_SLOTS, sizeof(*entries), GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+
+	for (i = 0; i < BINDER_LAT_SLOTS; i++) {
+		struct binder_lat_slot *slot = &binder_lat_slots[i];
+		struct binder_lat_entry *e = &entries[nr];
+
+		e->key = atomic64_read(&slot->key);
+		if (!e->key)
+			continue;
+		e->pid = slot->pid;
+		e->nr_delivered = atomic_read(&slot->nr_delivered);
+		e->nr_replied = atomic_read(&slot->nr_replied);
+		e->deliver_us = atomic64_read(&slot->deliver_us);
+		e->reply_us = atomic64_read(&slot->reply_us);
+		for (j = 0; j < BINDER_LAT_BUCKETS; j++)
+			e->reply_hist[j] = atomic_read(&slot->reply_hist[j]);
+		nr++;
+	}
+
+	sort(entries, nr, sizeof(*entries), binder_lat_entry_cmp, NULL);
+
+	seq_printf(m, "binder latency, dropped %d, evicted %d\n",
+		   atomic_read(&binder_lat_dropped),
+		   atomic_read(&binder_lat_evicted));
+	seq_puts(m, "node code pid delivered avg_deliver_us replied avg_reply_us reply_hist_log2_us\n");
+	for (i = 0; i < min(nr, BINDER_LAT_TOP); i++) {
+		struct binder_lat_entry *e = &entries[i];
+
+		seq_printf(m, "%u %u %d %u %llu %u %llu",
+			   (u32)(e->key >> 32), (u32)e->key, e->pid,
+			   e->nr_delivered,
+			   e->nr_delivered ? e->deliver_us / e->nr_delivered : 0,
+			   e->nr_replied,
+			   e->nr_replied ? e->reply_us / e->nr_replied : 0);
+		for (j = 0; j < BINDER_LAT_BUCKETS; j++)
+			seq_printf(m, " %u", e->reply_hist[j]);
+		seq_putc(m, '\n');
+	}
+
+	kfree(entries);
+	return 0;
+}
+
 const struct file_operations binder_fops = {
 	.owner = THIS_MODULE,
 	.poll = binder_poll,
@@ -6768,6 +7358,7 @@ DEFINE_SHOW_ATTRIBUTE(state);
 DEFINE_SHOW_ATTRIBUTE(stats);
 DEFINE_SHOW_ATTRIBUTE(transactions);
 DEFINE_SHOW_ATTRIBUTE(transaction_log);
+DEFINE_SHOW_ATTRIBUTE(latency);
 
 const struct binder_debugfs_entry binder_debugfs_entries[] = {
 	{
@@ -6800,6 +7391,12 @@ const struct binder_debugfs_entry binder_debugfs_entries[] = {
 		.fops = &transaction_log_fops,
 		.data = &binder_transaction_log_failed,
 	},
+	{
+		.name = "latency",
+		.mode = 0444,
+		.fops = &latency_fops,
+		.data = NULL,
+	},
 	{} /* terminator */
 };
 
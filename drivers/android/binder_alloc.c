@@ -18,6 +18,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/list_lru.h>
+#include <linux/memcontrol.h>
 #include <linux/ratelimit.h>
 #include <asm/cacheflush.h>
 #include <linux/uaccess.h>
@@ -66,6 +67,27 @@ static size_t binder_alloc_buffer_size(struct binder_alloc *alloc,
 	return binder_buffer_next(buffer)->user_data - buffer->user_data;
 }
 
+/* size class for a free buffer of @size, -1 if it goes in free_buffers */
+static int binder_free_class(size_t size)
+{
+	int class;
+
+	if (size < BINDER_SIZE_CLASS_MIN)
+		return -1;
+
+	class = ilog2(size / BINDER_SIZE_CLASS_MIN);
+	return class < BINDER_NR_SIZE_CLASSES ? class : -1;
+}
+
+/* smallest size class whose buffers all fit @size, -1 if none */
+static int binder_alloc_class(size_t size)
+{
+	int class;
+
+	class = order_base_2(DIV_ROUND_UP(size, BINDER_SIZE_CLASS_MIN));
+	return class < BINDER_NR_SIZE_CLASSES ? class : -1;
+}
+
 static void binder_insert_free_buffer(struct binder_alloc *alloc,
 				      struct binder_buffer *new_buffer)
 {
@@ -74,6 +96,7 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 	struct binder_buffer *buffer;
 	size_t buffer_size;
 	size_t new_buffer_size;
+	int class;
 
 	BUG_ON(!new_buffer->free);
 
@@ -83,6 +106,14 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 		     "%d: add free buffer, size %zd, at %pK\n",
 		      alloc->pid, new_buffer_size, new_buffer);
 
+	/* LIFO so that the pages of a recently freed buffer are reused */
+	class = binder_free_class(new_buffer_size);
+	if (class >= 0) {
+		new_buffer->in_class = 1;
+		list_add(&new_buffer->class_entry, &alloc->free_classes[class]);
+		return;
+	}
+
 	while (*p) {
 		parent = *p;
 		buffer = rb_entry(parent, struct binder_buffer, rb_node);
@@ -99,6 +130,63 @@ static void binder_insert_free_buffer(struct binder_alloc *alloc,
 	rb_insert_color(&new_buffer->rb_node, &alloc->free_buffers);
 }
 
+static void binder_remove_free_buffer(struct binder_alloc *alloc,
+				      struct binder_buffer *buffer)
+{
+	BUG_ON(!buffer->free);
+
+	if (buffer->in_class) {
+		list_del(&buffer->class_entry);
+		buffer->in_class = 0;
+	} else {
+		rb_erase(&buffer->rb_node, &alloc->free_buffers);
+	}
+}
+
+/* O(1) pick from the size classes, NULL if they have nothing for @size */
+static struct binder_buffer *binder_class_pick(struct binder_alloc *alloc,
+					       size_t size)
+{
+	int class = binder_alloc_class(size);
+	struct binder_buffer *buffer;
+
+	if (class < 0)
+		return NULL;
+
+	for (; class < BINDER_NR_SIZE_CLASSES; class++) {
+		buffer = list_first_entry_or_null(&alloc->free_classes[class],
+						  struct binder_buffer,
+						  class_entry);
+		if (buffer) {
+			alloc->class_hits++;
+			return buffer;
+		}
+	}
+
+	alloc->class_misses++;
+	return NULL;
+}
+
+/*
+ * Last resort before failing: the class holding buffers of @size's range can
+ * still contain one which is large enough, e.g. 250 bytes for 200.
+ */
+static struct binder_buffer *binder_class_scan(struct binder_alloc *alloc,
+					       size_t size)
+{
+	int class = binder_free_class(size);
+	struct binder_buffer *buffer;
+
+	if (class < 0)
+		return NULL;
+
+	list_for_each_entry(buffer, &alloc->free_classes[class], class_entry)
+		if (binder_alloc_buffer_size(alloc, buffer) >= size)
+			return buffer;
+
+	return NULL;
+}
+
 static void binder_insert_allocated_buffer_locked(
 		struct binder_alloc *alloc, struct binder_buffer *new_buffer)
 {
@@ -191,6 +279,24 @@ binder_get_installed_page(struct binder_lru_page *lru_page)
 	return smp_load_acquire(&lru_page->page_ptr);
 }
 
+/*
+ * Unused pages sit on the sublist of their node and of the memcg of the
+ * proc mapping them, so that reclaim of that cgroup trims them first.
+ */
+static bool binder_lru_page_add(struct binder_lru_page *page)
+{
+	return list_lru_add_memcg(&binder_freelist, &page->lru,
+				  page_to_nid(page->page_ptr),
+				  page->alloc->memcg);
+}
+
+static bool binder_lru_page_del(struct binder_lru_page *page)
+{
+	return list_lru_del_memcg(&binder_freelist, &page->lru,
+				  page_to_nid(page->page_ptr),
+				  page->alloc->memcg);
+}
+
 static void binder_lru_freelist_add(struct binder_alloc *alloc,
 				    unsigned long start, unsigned long end)
 {
@@ -211,7 +317,7 @@ static void binder_lru_freelist_add(struct binder_alloc *alloc,
 
 		trace_binder_free_lru_start(alloc, index);
 
-		ret = list_lru_add(&binder_freelist, &page->lru);
+		ret = binder_lru_page_add(page);
 		WARN_ON(!ret);
 
 		trace_binder_free_lru_end(alloc, index);
@@ -266,6 +372,80 @@ static int binder_install_single_page(struct binder_alloc *alloc,
 	return ret;
 }
 
+#define BINDER_INSTALL_BATCH	32
+
+/*
+ * Install the missing pages of [@index, @index + @nr) under a single mmap
+ * lock hold, with one bulk allocation and one vm_insert_pages() per run of
+ * pages which are still missing once the lock is held.
+ */
+static int binder_install_page_batch(struct binder_alloc *alloc,
+				     unsigned long index, unsigned long nr)
+{
+	struct page *pages[BINDER_INSTALL_BATCH];
+	unsigned long i, j, run = 0, left = 0;
+	int ret = 0;
+
+	if (!mmget_not_zero(alloc->mm))
+		return -ESRCH;
+
+	mmap_write_lock(alloc->mm);
+	if (!alloc->vma) {
+		pr_err("%d: %s failed, no vma\n", alloc->pid, __func__);
+		ret = -ESRCH;
+		goto out;
+	}
+
+	for (i = 0; i < nr; i += run) {
+		unsigned long addr = alloc->buffer + (index + i) * PAGE_SIZE;
+
+		/* racing installers may have filled in some of them */
+		run = 1;
+		if (binder_get_installed_page(&alloc->pages[index + i]))
+			continue;
+		while (i + run < nr &&
+		       !binder_get_installed_page(&alloc->pages[index + i + run]))
+			run++;
+
+		for (j = 0; j < run; j++)
+			trace_binder_alloc_page_start(alloc, index + i + j);
+
+		memset(pages, 0, sizeof(pages[0]) * run);
+		left = run;
+		if (alloc_pages_bulk_array(GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO,
+					   run, pages) < run) {
+			pr_err("%d: failed to allocate page\n", alloc->pid);
+			ret = -ENOMEM;
+			goto free;
+		}
+
+		ret = vm_insert_pages(alloc->vma, addr, pages, &left);
+		if (ret) {
+			pr_err("%d: %s failed to insert pages at offset %lx with %d\n",
+			       alloc->pid, __func__, addr - alloc->buffer, ret);
+			ret = -ENOMEM;
+		}
+
+		/* Mark page installation complete and safe to use */
+		for (j = 0; j < run - left; j++) {
+			binder_set_installed_page(&alloc->pages[index + i + j],
+						  pages[j]);
+			trace_binder_alloc_page_end(alloc, index + i + j);
+		}
+		if (ret)
+			goto free;
+	}
+	goto out;
+free:
+	for (j = run - left; j < run; j++)
+		if (pages[j])
+			__free_page(pages[j]);
+out:
+	mmap_write_unlock(alloc->mm);
+	mmput_async(alloc->mm);
+	return ret;
+}
+
 static int binder_install_buffer_pages(struct binder_alloc *alloc,
 				       struct binder_buffer *buffer,
 				       size_t size)
@@ -278,7 +458,7 @@ static int binder_install_buffer_pages(struct binder_alloc *alloc,
 	final = PAGE_ALIGN(buffer->user_data + size);
 
 	for (page_addr = start; page_addr < final; page_addr += PAGE_SIZE) {
-		unsigned long index;
+		unsigned long index, nr;
 		int ret;
 
 		index = (page_addr - alloc->buffer) / PAGE_SIZE;
@@ -287,6 +467,19 @@ static int binder_install_buffer_pages(struct binder_alloc *alloc,
 		if (binder_get_installed_page(page))
 			continue;
 
+		/* large buffers, install the run of missing pages at once */
+		for (nr = 1; nr < BINDER_INSTALL_BATCH &&
+		     page_addr + nr * PAGE_SIZE < final &&
+		     !binder_get_installed_page(&page[nr]); nr++)
+			;
+		if (nr > 1) {
+			ret = binder_install_page_batch(alloc, index, nr);
+			if (ret)
+				return ret;
+			page_addr += (nr - 1) * PAGE_SIZE;
+			continue;
+		}
+
 		trace_binder_alloc_page_start(alloc, index);
 
 		ret = binder_install_single_page(alloc, page, page_addr);
@@ -318,7 +511,7 @@ static void binder_lru_freelist_del(struct binder_alloc *alloc,
 		if (page->page_ptr) {
 			trace_binder_alloc_lru_start(alloc, index);
 
-			on_lru = list_lru_del(&binder_freelist, &page->lru);
+			on_lru = binder_lru_page_del(page);
 			WARN_ON(!on_lru);
 
 			trace_binder_alloc_lru_end(alloc, index);
@@ -355,6 +548,7 @@ static void debug_no_space_locked(struct binder_alloc *alloc)
 	size_t free_buffers = 0;
 	size_t buffer_size;
 	struct rb_node *n;
+	int class;
 
 	for (n = rb_first(&alloc->allocated_buffers); n; n = rb_next(n)) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
@@ -374,6 +568,17 @@ static void debug_no_space_locked(struct binder_alloc *alloc)
 			largest_free_size = buffer_size;
 	}
 
+	for (class = 0; class < BINDER_NR_SIZE_CLASSES; class++) {
+		list_for_each_entry(buffer, &alloc->free_classes[class],
+				    class_entry) {
+			buffer_size = binder_alloc_buffer_size(alloc, buffer);
+			free_buffers++;
+			total_free_size += buffer_size;
+			if (buffer_size > largest_free_size)
+				largest_free_size = buffer_size;
+		}
+	}
+
 	binder_alloc_debug(BINDER_DEBUG_USER_ERROR,
 			   "allocated: %zd (num: %zd largest: %zd), free: %zd (num: %zd largest: %zd)\n",
 			   total_alloc_size, allocated_buffers,
@@ -466,6 +671,10 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 		goto out;
 	}
 
+	buffer = binder_class_pick(alloc, size);
+	if (buffer)
+		goto found;
+
 	while (n) {
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
 		BUG_ON(!buffer->free);
@@ -482,7 +691,12 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 		}
 	}
 
-	if (unlikely(!best_fit)) {
+	if (best_fit)
+		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
+	else
+		buffer = binder_class_scan(alloc, size);
+
+	if (unlikely(!buffer)) {
 		binder_alloc_debug(BINDER_DEBUG_USER_ERROR,
 				   "%d: binder_alloc_buf size %zd failed, no address space\n",
 				   alloc->pid, size);
@@ -491,12 +705,11 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 		goto out;
 	}
 
+found:
+	buffer_size = binder_alloc_buffer_size(alloc, buffer);
 	if (buffer_size != size) {
 		/* Found an oversized buffer and needs to be split */
-		buffer = rb_entry(best_fit, struct binder_buffer, rb_node);
-		buffer_size = binder_alloc_buffer_size(alloc, buffer);
-
-		WARN_ON(n || buffer_size == size);
+		WARN_ON(buffer_size < size);
 		new_buffer->user_data = buffer->user_data + size;
 		list_add(&new_buffer->entry, &buffer->entry);
 		new_buffer->free = 1;
@@ -519,7 +732,7 @@ static struct binder_buffer *binder_alloc_new_buf_locked(
 	binder_lru_freelist_del(alloc, PAGE_ALIGN(buffer->user_data),
 				min(next_used_page, curr_last_page));
 
-	rb_erase(&buffer->rb_node, &alloc->free_buffers);
+	binder_remove_free_buffer(alloc, buffer);
 	buffer->free = 0;
 	buffer->allow_user_free = 0;
 	binder_insert_allocated_buffer_locked(alloc, buffer);
@@ -705,7 +918,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 		struct binder_buffer *next = binder_buffer_next(buffer);
 
 		if (next->free) {
-			rb_erase(&next->rb_node, &alloc->free_buffers);
+			binder_remove_free_buffer(alloc, next);
 			binder_delete_free_buffer(alloc, next);
 		}
 	}
@@ -714,7 +927,7 @@ static void binder_free_buf_locked(struct binder_alloc *alloc,
 
 		if (prev->free) {
 			binder_delete_free_buffer(alloc, buffer);
-			rb_erase(&prev->rb_node, &alloc->free_buffers);
+			binder_remove_free_buffer(alloc, prev);
 			buffer = prev;
 		}
 	}
@@ -810,6 +1023,19 @@ void binder_alloc_free_buf(struct binder_alloc *alloc,
 	spin_unlock(&alloc->lock);
 }
 
+static void binder_alloc_set_memcg(struct binder_alloc *alloc)
+{
+	alloc->memcg = get_mem_cgroup_from_mm(alloc->mm);
+#ifdef CONFIG_MEMCG_KMEM
+	if (alloc->memcg &&
+	    memcg_list_lru_alloc(alloc->memcg, &binder_freelist, GFP_KERNEL)) {
+		/* fall back to the root sublists */
+		mem_cgroup_put(alloc->memcg);
+		alloc->memcg = NULL;
+	}
+#endif
+}
+
 /**
  * binder_alloc_mmap_handler() - map virtual address space for proc
  * @alloc:	alloc structure for this proc
@@ -874,6 +1100,7 @@ int binder_alloc_mmap_handler(struct binder_alloc *alloc,
 	buffer->free = 1;
 	binder_insert_free_buffer(alloc, buffer);
 	alloc->free_async_space = alloc->buffer_size / 2;
+	binder_alloc_set_memcg(alloc);
 
 	/* Signal binder_alloc is fully initialized */
 	binder_alloc_set_vma(alloc, vma);
@@ -943,8 +1170,7 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 			if (!alloc->pages[i].page_ptr)
 				continue;
 
-			on_lru = list_lru_del(&binder_freelist,
-					      &alloc->pages[i].lru);
+			on_lru = binder_lru_page_del(&alloc->pages[i]);
 			page_addr = alloc->buffer + i * PAGE_SIZE;
 			binder_alloc_debug(BINDER_DEBUG_BUFFER_ALLOC,
 				     "%s: %d: page %d %s\n",
@@ -958,6 +1184,7 @@ void binder_alloc_deferred_release(struct binder_alloc *alloc)
 	kvfree(alloc->pages);
 	if (alloc->mm)
 		mmdrop(alloc->mm);
+	mem_cgroup_put(alloc->memcg);
 
 	binder_alloc_debug(BINDER_DEBUG_OPEN_CLOSE,
 		     "%s: %d buffers %d, pages %d\n",
@@ -988,6 +1215,11 @@ void binder_alloc_print_allocated(struct seq_file *m,
 			   buffer->extra_buffers_size,
 			   buffer->transaction ? "active" : "delivered");
 	}
+	if (alloc->class_hits + alloc->class_misses)
+		seq_printf(m, "  size classes: hits %zu misses %zu (%zu%%)\n",
+			   alloc->class_hits, alloc->class_misses,
+			   alloc->class_hits * 100 /
+			   (alloc->class_hits + alloc->class_misses));
 	spin_unlock(&alloc->lock);
 }
 
@@ -1058,11 +1290,92 @@ void binder_alloc_vma_close(struct binder_alloc *alloc)
 	binder_alloc_set_vma(alloc, NULL);
 }
 
+/*
+ * Pages of one alloc isolated by binder_alloc_free_page() in a row are
+ * unmapped and freed together, under a single mmap_lock and mm reference.
+ */
+#define BINDER_SHRINK_BATCH	16
+
+struct binder_shrink_batch {
+	struct binder_alloc *alloc;	/* owner of @pages, NULL if empty */
+	struct vm_area_struct *vma;
+	int nr;
+	struct {
+		struct page *page;
+		size_t index;
+	} pages[BINDER_SHRINK_BATCH];
+};
+
+/* Called with alloc->lock held, drops it along with the mm */
+static void binder_shrink_batch_flush(struct binder_shrink_batch *batch)
+{
+	struct binder_alloc *alloc = batch->alloc;
+	struct mm_struct *mm = alloc->mm;
+	int i, j;
+
+	spin_unlock(&alloc->lock);
+
+	for (i = 0; i < batch->nr; i = j) {
+		size_t index = batch->pages[i].index;
+
+		/* zap runs of adjacent pages in one go */
+		for (j = i + 1; j < batch->nr; j++)
+			if (batch->pages[j].index != index + (j - i))
+				break;
+
+		if (!batch->vma)
+			continue;
+
+		trace_binder_unmap_user_start(alloc, index);
+
+		zap_page_range_single(batch->vma,
+				      alloc->buffer + index * PAGE_SIZE,
+				      (j - i) * PAGE_SIZE, NULL);
+
+		trace_binder_unmap_user_end(alloc, index);
+	}
+
+	mmap_read_unlock(mm);
+	mmput_async(mm);
+
+	for (i = 0; i < batch->nr; i++)
+		__free_page(batch->pages[i].page);
+
+	batch->alloc = NULL;
+	batch->nr = 0;
+}
+
+/* Takes the mm and alloc->lock of @alloc for a new batch */
+static bool binder_shrink_batch_start(struct binder_shrink_batch *batch,
+				      struct binder_alloc *alloc)
+{
+	struct mm_struct *mm = alloc->mm;
+
+	if (!mmget_not_zero(mm))
+		return false;
+	if (!mmap_read_trylock(mm))
+		goto err_mmap_read_lock_failed;
+	if (!spin_trylock(&alloc->lock))
+		goto err_get_alloc_lock_failed;
+
+	batch->alloc = alloc;
+	batch->vma = binder_alloc_get_vma(alloc);
+	batch->nr = 0;
+	return true;
+
+err_get_alloc_lock_failed:
+	mmap_read_unlock(mm);
+err_mmap_read_lock_failed:
+	mmput_async(mm);
+	return false;
+}
+
 /**
  * binder_alloc_free_page() - shrinker callback to free pages
  * @item:   item to free
  * @lock:   lock protecting the item
- * @cb_arg: callback argument
+ * @cb_arg: struct binder_shrink_batch to collect pages in, or %NULL to
+ *          free each page right away
  *
  * Called from list_lru_walk() in binder_shrink_scan() to free
  * up pages when the system is under memory pressure.
@@ -1075,82 +1388,92 @@ enum lru_status binder_alloc_free_page(struct list_head *item,
 {
 	struct binder_lru_page *page = container_of(item, typeof(*page), lru);
 	struct binder_alloc *alloc = page->alloc;
-	struct mm_struct *mm = alloc->mm;
+	struct binder_shrink_batch single, *batch = cb_arg ?: &single;
 	struct vm_area_struct *vma;
-	struct page *page_to_free;
 	unsigned long page_addr;
 	size_t index;
 
-	if (!mmget_not_zero(mm))
-		goto err_mmget;
-	if (!mmap_read_trylock(mm))
-		goto err_mmap_read_lock_failed;
-	if (!spin_trylock(&alloc->lock))
-		goto err_get_alloc_lock_failed;
+	if (!cb_arg)
+		single.alloc = NULL;
+
+	if (batch->alloc && batch->alloc != alloc) {
+		/* pages of another proc, flush and redo this one */
+		spin_unlock(lock);
+		binder_shrink_batch_flush(batch);
+		spin_lock(lock);
+		return LRU_RETRY;
+	}
+
+	if (!batch->alloc && !binder_shrink_batch_start(batch, alloc))
+		return LRU_SKIP;
+
 	if (!page->page_ptr)
 		goto err_page_already_freed;
 
 	index = page - alloc->pages;
 	page_addr = alloc->buffer + index * PAGE_SIZE;
 
-	vma = vma_lookup(mm, page_addr);
-	if (vma && vma != binder_alloc_get_vma(alloc))
+	vma = vma_lookup(alloc->mm, page_addr);
+	if (vma && vma != batch->vma)
 		goto err_invalid_vma;
 
 	trace_binder_unmap_kernel_start(alloc, index);
 
-	page_to_free = page->page_ptr;
+	batch->pages[batch->nr].page = page->page_ptr;
+	batch->pages[batch->nr].index = index;
+	batch->nr++;
 	page->page_ptr = NULL;
 
 	trace_binder_unmap_kernel_end(alloc, index);
 
 	list_lru_isolate(lru, item);
-	spin_unlock(&alloc->lock);
-	spin_unlock(lock);
-
-	if (vma) {
-		trace_binder_unmap_user_start(alloc, index);
-
-		zap_page_range_single(vma, page_addr, PAGE_SIZE, NULL);
-
-		trace_binder_unmap_user_end(alloc, index);
-	}
 
-	mmap_read_unlock(mm);
-	mmput_async(mm);
-	__free_page(page_to_free);
+	if (batch->nr < BINDER_SHRINK_BATCH && cb_arg)
+		return LRU_REMOVED;
 
+	spin_unlock(lock);
+	binder_shrink_batch_flush(batch);
 	spin_lock(lock);
 	return LRU_REMOVED_RETRY;
 
 err_invalid_vma:
 err_page_already_freed:
-	spin_unlock(&alloc->lock);
-err_get_alloc_lock_failed:
-	mmap_read_unlock(mm);
-err_mmap_read_lock_failed:
-	mmput_async(mm);
-err_mmget:
+	if (!batch->nr) {
+		struct mm_struct *mm = alloc->mm;
+
+		spin_unlock(&alloc->lock);
+		mmap_read_unlock(mm);
+		mmput_async(mm);
+		batch->alloc = NULL;
+	}
 	return LRU_SKIP;
 }
 
 static unsigned long
 binder_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
 {
-	return list_lru_count(&binder_freelist);
+	return list_lru_shrink_count(&binder_freelist, sc);
 }
 
 static unsigned long
 binder_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 {
-	return list_lru_walk(&binder_freelist, binder_alloc_free_page,
-			    NULL, sc->nr_to_scan);
+	struct binder_shrink_batch batch = { .alloc = NULL };
+	unsigned long freed;
+
+	freed = list_lru_shrink_walk(&binder_freelist, sc,
+				     binder_alloc_free_page, &batch);
+	if (batch.alloc)
+		binder_shrink_batch_flush(&batch);
+
+	return freed;
 }
 
 static struct shrinker binder_shrinker = {
 	.count_objects = binder_shrink_count,
 	.scan_objects = binder_shrink_scan,
 	.seeks = DEFAULT_SEEKS,
+	.flags = SHRINKER_NUMA_AWARE | SHRINKER_MEMCG_AWARE,
 };
 
 /**
@@ -1162,23 +1485,33 @@ static struct shrinker binder_shrinker = {
  */
 void binder_alloc_init(struct binder_alloc *alloc)
 {
+	int i;
+
 	alloc->pid = current->group_leader->pid;
 	alloc->mm = current->mm;
 	mmgrab(alloc->mm);
 	spin_lock_init(&alloc->lock);
 	INIT_LIST_HEAD(&alloc->buffers);
+	for (i = 0; i < BINDER_NR_SIZE_CLASSES; i++)
+		INIT_LIST_HEAD(&alloc->free_classes[i]);
 }
 
 int binder_alloc_shrinker_init(void)
 {
-	int ret = list_lru_init(&binder_freelist);
+	int ret;
 
-	if (ret == 0) {
-		ret = register_shrinker(&binder_shrinker, "android-binder");
-		if (ret)
-			list_lru_destroy(&binder_freelist);
+	ret = prealloc_shrinker(&binder_shrinker, "android-binder");
+	if (ret)
+		return ret;
+
+	ret = list_lru_init_memcg(&binder_freelist, &binder_shrinker);
+	if (ret) {
+		free_prealloced_shrinker(&binder_shrinker);
+		return ret;
 	}
-	return ret;
+
+	register_shrinker_prepared(&binder_shrinker);
+	return 0;
 }
 
 void binder_alloc_shrinker_exit(void)
@@ -22,7 +22,9 @@ struct binder_transaction;
  * struct binder_buffer - buffer used for binder transactions
  * @entry:              entry alloc->buffers
  * @rb_node:            node for allocated_buffers/free_buffers rb trees
+ * @class_entry:        entry in alloc->free_classes, if @in_class
  * @free:               %true if buffer is free
+ * @in_class:           %true if buffer is free and on a size class list
  * @clear_on_free:      %true if buffer must be zeroed after use
  * @allow_user_free:    %true if user is allowed to free buffer
  * @async_transaction:  %true if buffer is in use for an async txn
@@ -41,9 +43,13 @@ struct binder_transaction;
  */
 struct binder_buffer {
 	struct list_head entry; /* free and allocated entries by address */
-	struct rb_node rb_node; /* free entry by size or allocated entry */
-				/* by address */
+	union {
+		struct rb_node rb_node; /* free entry by size or allocated */
+					/* entry by address */
+		struct list_head class_entry;
+	};
 	unsigned free:1;
+	unsigned in_class:1;
 	unsigned clear_on_free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
@@ -70,16 +76,31 @@ struct binder_lru_page {
 	struct binder_alloc *alloc;
 };
 
+/*
+ * Free buffers of BINDER_SIZE_CLASS_MIN up to
+ * BINDER_SIZE_CLASS_MIN << BINDER_NR_SIZE_CLASSES bytes are kept on size
+ * class lists rather than in free_buffers. Class c holds the buffers of
+ * [BINDER_SIZE_CLASS_MIN << c, BINDER_SIZE_CLASS_MIN << (c + 1)) bytes.
+ */
+#define BINDER_SIZE_CLASS_MIN		128
+#define BINDER_NR_SIZE_CLASSES		8
+
 /**
  * struct binder_alloc - per-binder proc state for binder allocator
  * @lock:               protects binder_alloc fields
  * @vma:                vm_area_struct passed to mmap_handler
  *                      (invariant after mmap)
  * @mm:                 copy of task->mm (invariant after open)
+ * @memcg:              memcg whose binder_freelist sublists hold the unused
+ *                      pages of this proc (invariant after mmap)
  * @buffer:             base of per-proc address space mapped via mmap
  * @buffers:            list of all buffers for this proc
  * @free_buffers:       rb tree of buffers available for allocation
  *                      sorted by size
+ * @free_classes:       lists of small free buffers by size class
+ * @class_hits:         allocations served from @free_classes
+ * @class_misses:       allocations small enough for @free_classes which had
+ *                      to search @free_buffers
  * @allocated_buffers:  rb tree of allocated buffers sorted by address
  * @free_async_space:   VA space available for async buffers. This is
  *                      initialized at mmap time to 1/2 the full VA space
@@ -99,9 +120,13 @@ struct binder_alloc {
 	spinlock_t lock;
 	struct vm_area_struct *vma;
 	struct mm_struct *mm;
+	struct mem_cgroup *memcg;
 	unsigned long buffer;
 	struct list_head buffers;
 	struct rb_root free_buffers;
+	struct list_head free_classes[BINDER_NR_SIZE_CLASSES];
+	size_t class_hits;
+	size_t class_misses;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 	struct binder_lru_page *pages;
@@ -10,6 +10,11 @@
 
 #include <linux/mm_types.h>
 #include <linux/err.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/moduleparam.h>
+#include <linux/random.h>
+#include <linux/sort.h>
 #include "binder_alloc.h"
 
 #define BUFFER_NUM 5
@@ -19,6 +24,14 @@ static bool binder_selftest_run = true;
 static int binder_selftest_failures;
 static DEFINE_MUTEX(binder_selftest_lock);
 
+/*
+ * Setting bench_iters runs the allocator benchmark with that many
+ * operations per case on the next binder ioctl of a process with a mapped
+ * buffer. It's cleared once the benchmark is done.
+ */
+static uint binder_bench_iters;
+module_param_named(bench_iters, binder_bench_iters, uint, 0644);
+
 /**
  * enum buf_end_align_type - Page alignment of a buffer
  * end with regard to the end of the previous buffer.
@@ -271,6 +284,256 @@ static void binder_selftest_alloc_offset(struct binder_alloc *alloc,
 	}
 }
 
+#define BINDER_BENCH_MAX_ITERS		(1U << 20)
+#define BINDER_BENCH_BATCH		4
+#define BINDER_BENCH_INSTALL_PAGES	16
+
+/**
+ * struct binder_bench_mix - weighted buffer size mix
+ * @name:   name printed with the results
+ * @sizes:  buffer sizes, 0 terminated
+ * @weight: relative frequency of each entry of @sizes
+ */
+struct binder_bench_mix {
+	const char *name;
+	size_t sizes[8];
+	u32 weight[8];
+};
+
+static const struct binder_bench_mix binder_bench_mixes[] = {
+	{ "small", { 64, 128, 256, 512 }, { 4, 3, 2, 1 } },
+	/* roughly what a busy system_server sees */
+	{ "mixed", { 128, 512, 2048, SZ_8K, SZ_32K, SZ_128K },
+	  { 40, 30, 15, 10, 4, 1 } },
+	{ "large", { SZ_16K, SZ_64K, SZ_128K }, { 2, 1, 1 } },
+};
+
+struct binder_bench_result {
+	u32 *lat;	/* nsecs per operation */
+	u32 nr;
+	u32 failed;
+	u64 elapsed;	/* nsecs for all of @lat */
+};
+
+static void binder_bench_reset(struct binder_bench_result *res)
+{
+	res->nr = 0;
+	res->failed = 0;
+	res->elapsed = 0;
+}
+
+static int binder_bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void binder_bench_report(const char *name, const char *op,
+				struct binder_bench_result *res,
+				unsigned int div)
+{
+	u32 *lat = res->lat, nr = res->nr;
+
+	if (!nr) {
+		pr_info("bench %s %s: no samples, %u failed\n",
+			name, op, res->failed);
+		return;
+	}
+
+	sort(lat, nr, sizeof(*lat), binder_bench_cmp, NULL);
+	pr_info("bench %s %s: %u ops %llu ops/s p50 %u p90 %u p99 %u max %u ns, %u failed\n",
+		name, op, nr,
+		div64_u64((u64)nr * div * NSEC_PER_SEC, res->elapsed ?: 1),
+		lat[nr / 2] / div, lat[nr * 9 / 10] / div,
+		lat[nr * 99 / 100] / div, lat[nr - 1] / div, res->failed);
+}
+
+static size_t binder_bench_pick(const struct binder_bench_mix *mix,
+				size_t max)
+{
+	u32 total = 0, r;
+	int i;
+
+	for (i = 0; mix->sizes[i]; i++)
+		if (mix->sizes[i] <= max)
+			total += mix->weight[i];
+	if (!total)
+		return mix->sizes[0];
+
+	r = get_random_u32_below(total);
+	for (i = 0; mix->sizes[i]; i++) {
+		if (mix->sizes[i] > max)
+			continue;
+		if (r < mix->weight[i])
+			break;
+		r -= mix->weight[i];
+	}
+	return mix->sizes[i];
+}
+
+/* new_buf and free_buf of @mix with warm pages, in batches */
+static void binder_bench_mix_run(struct binder_alloc *alloc,
+				 const struct binder_bench_mix *mix,
+				 struct binder_bench_result *alloc_res,
+				 struct binder_bench_result *free_res,
+				 u32 iters)
+{
+	struct binder_buffer *buffers[BINDER_BENCH_BATCH];
+	size_t max = alloc->buffer_size / (4 * BINDER_BENCH_BATCH);
+	int i, n;
+	u64 t0;
+
+	while (alloc_res->nr + alloc_res->failed < iters) {
+		for (n = 0; n < BINDER_BENCH_BATCH; n++) {
+			size_t size = binder_bench_pick(mix, max);
+
+			t0 = ktime_get_ns();
+			buffers[n] = binder_alloc_new_buf(alloc, size, 0, 0, 0);
+			t0 = ktime_get_ns() - t0;
+			if (IS_ERR(buffers[n])) {
+				alloc_res->failed++;
+				break;
+			}
+			alloc_res->lat[alloc_res->nr++] = min_t(u64, t0, U32_MAX);
+			alloc_res->elapsed += t0;
+			if (alloc_res->nr + alloc_res->failed >= iters) {
+				n++;
+				break;
+			}
+		}
+
+		for (i = 0; i < n; i++) {
+			if (IS_ERR(buffers[i]))
+				continue;
+			t0 = ktime_get_ns();
+			binder_alloc_free_buf(alloc, buffers[i]);
+			t0 = ktime_get_ns() - t0;
+			free_res->lat[free_res->nr++] = min_t(u64, t0, U32_MAX);
+			free_res->elapsed += t0;
+		}
+		cond_resched();
+	}
+}
+
+#define BINDER_BENCH_DRAIN_PASSES	4
+
+/*
+ * Pages whose mm or lock can't be taken are skipped by the walk, so give up
+ * after a few passes or once a pass frees nothing.
+ */
+static void binder_bench_drain_freelist(void)
+{
+	unsigned long count;
+	int pass;
+
+	for (pass = 0; pass < BINDER_BENCH_DRAIN_PASSES; pass++) {
+		count = list_lru_count(&binder_freelist);
+		if (!count ||
+		    !list_lru_walk(&binder_freelist, binder_alloc_free_page,
+				   NULL, count))
+			break;
+	}
+}
+
+/*
+ * new_buf of BINDER_BENCH_INSTALL_PAGES pages with none of them installed.
+ * This empties binder_freelist of every proc, not just the one of @alloc.
+ */
+static void binder_bench_install_run(struct binder_alloc *alloc,
+				     struct binder_bench_result *res, u32 iters)
+{
+	size_t size = BINDER_BENCH_INSTALL_PAGES * PAGE_SIZE;
+	struct binder_buffer *buffer;
+	u64 t0;
+
+	if (size > alloc->buffer_size / 2)
+		return;
+
+	while (res->nr + res->failed < iters) {
+		binder_bench_drain_freelist();
+
+		t0 = ktime_get_ns();
+		buffer = binder_alloc_new_buf(alloc, size, 0, 0, 0);
+		t0 = ktime_get_ns() - t0;
+		if (IS_ERR(buffer)) {
+			res->failed++;
+			continue;
+		}
+		res->lat[res->nr++] = min_t(u64, t0, U32_MAX);
+		res->elapsed += t0;
+		binder_alloc_free_buf(alloc, buffer);
+		cond_resched();
+	}
+}
+
+static int binder_bench_shrinker_fn(void *data)
+{
+	unsigned long *reclaimed = data;
+
+	while (!kthread_should_stop()) {
+		*reclaimed += list_lru_walk(&binder_freelist,
+					    binder_alloc_free_page, NULL, 32);
+		cond_resched();
+	}
+	return 0;
+}
+
+static void binder_bench(struct binder_alloc *alloc, u32 iters)
+{
+	struct binder_bench_result res[2] = {};
+	const struct binder_bench_mix *mix;
+	struct task_struct *shrinker;
+	unsigned long reclaimed = 0;
+	int i;
+
+	iters = min(iters, BINDER_BENCH_MAX_ITERS);
+	for (i = 0; i < ARRAY_SIZE(res); i++) {
+		res[i].lat = kvmalloc_array(iters, sizeof(u32), GFP_KERNEL);
+		if (!res[i].lat) {
+			pr_err("bench: no memory for %u samples\n", iters);
+			goto out;
+		}
+	}
+
+	pr_info("bench: %u iterations, buffer size %zu\n",
+		iters, alloc->buffer_size);
+
+	for (i = 0; i < ARRAY_SIZE(binder_bench_mixes); i++) {
+		mix = &binder_bench_mixes[i];
+		binder_bench_reset(&res[0]);
+		binder_bench_reset(&res[1]);
+		binder_bench_mix_run(alloc, mix, &res[0], &res[1], iters);
+		binder_bench_report(mix->name, "alloc", &res[0], 1);
+		binder_bench_report(mix->name, "free", &res[1], 1);
+	}
+
+	binder_bench_reset(&res[0]);
+	binder_bench_install_run(alloc, &res[0],
+				 max(iters / BINDER_BENCH_INSTALL_PAGES, 1U));
+	binder_bench_report("install", "per page", &res[0],
+			    BINDER_BENCH_INSTALL_PAGES);
+
+	shrinker = kthread_run(binder_bench_shrinker_fn, &reclaimed,
+			       "binder_bench_shrink");
+	if (IS_ERR(shrinker)) {
+		pr_err("bench: failed to start shrinker thread\n");
+		goto out;
+	}
+	mix = &binder_bench_mixes[1];
+	binder_bench_reset(&res[0]);
+	binder_bench_reset(&res[1]);
+	binder_bench_mix_run(alloc, mix, &res[0], &res[1], iters);
+	kthread_stop(shrinker);
+	binder_bench_report("shrink+mixed", "alloc", &res[0], 1);
+	binder_bench_report("shrink+mixed", "free", &res[1], 1);
+	pr_info("bench: shrinker reclaimed %lu pages\n", reclaimed);
+
+out:
+	for (i = 0; i < ARRAY_SIZE(res); i++)
+		kvfree(res[i].lat);
+}
+
 /**
  * binder_selftest_alloc() - Test alloc and free of buffer pages.
  * @alloc: Pointer to alloc struct.
@@ -283,19 +546,27 @@ static void binder_selftest_alloc_offset(struct binder_alloc *alloc,
 void binder_selftest_alloc(struct binder_alloc *alloc)
 {
 	size_t end_offset[BUFFER_NUM];
+	u32 iters;
 
-	if (!binder_selftest_run)
+	if (!binder_selftest_run && !READ_ONCE(binder_bench_iters))
 		return;
 	mutex_lock(&binder_selftest_lock);
-	if (!binder_selftest_run || !alloc->vma)
+	if (!alloc->vma)
 		goto done;
-	pr_info("STARTED\n");
-	binder_selftest_alloc_offset(alloc, end_offset, 0);
-	binder_selftest_run = false;
-	if (binder_selftest_failures > 0)
-		pr_info("%d tests FAILED\n", binder_selftest_failures);
-	else
-		pr_info("PASSED\n");
+	if (binder_selftest_run) {
+		pr_info("STARTED\n");
+		binder_selftest_alloc_offset(alloc, end_offset, 0);
+		binder_selftest_run = false;
+		if (binder_selftest_failures > 0)
+			pr_info("%d tests FAILED\n", binder_selftest_failures);
+		else
+			pr_info("PASSED\n");
+	}
+	iters = READ_ONCE(binder_bench_iters);
+	if (iters) {
+		binder_bench(alloc, iters);
+		WRITE_ONCE(binder_bench_iters, 0);
+	}
 
 done:
 	mutex_unlock(&binder_selftest_lock);
@@ -9,6 +9,7 @@
 #include <linux/miscdevice.h>
 #include <linux/mutex.h>
 #include <linux/refcount.h>
+#include <linux/sched.h>
 #include <linux/stddef.h>
 #include <linux/types.h>
 #include <linux/uidgid.h>
@@ -355,6 +356,18 @@ enum binder_prio_state {
 	BINDER_PRIO_ABORT,	/* abort the pending priority restore */
 };
 
+/**
+ * struct binder_lock_stat - acquisition counters of a binder_proc lock
+ * @acquired:   number of acquisitions
+ * @contended:  acquisitions which found the lock held
+ *
+ * Both are updated with the lock held.
+ */
+struct binder_lock_stat {
+	unsigned long acquired;
+	unsigned long contended;
+};
+
 /**
  * struct binder_proc - binder process bookkeeping
  * @proc_node:            element for binder_procs list
@@ -400,6 +413,11 @@ enum binder_prio_state {
  *                        (protected by @inner_lock)
  * @todo:                 list of work for this process
  *                        (protected by @inner_lock)
+ * @frozen_todo:          async transactions held back while frozen, queued
+ *                        on thaw
+ *                        (protected by @inner_lock)
+ * @nr_frozen_todo:       number of transactions on @frozen_todo
+ *                        (protected by @inner_lock)
  * @stats:                per-process binder statistics
  *                        (atomics, no lock needed)
  * @delivered_death:      list of delivered death notification
@@ -412,6 +430,16 @@ enum binder_prio_state {
  *                        (protected by @inner_lock)
  * @requested_threads_started: number binder threads started
  *                        (protected by @inner_lock)
+ * @spawn_wait_us:        average time sync work waited on @todo for a
+ *                        thread, used by the spawn policy
+ *                        (protected by @inner_lock)
+ * @spawn_rate_cur:       sync transactions taken off @todo in the
+ *                        current spawn policy window
+ *                        (protected by @inner_lock)
+ * @spawn_rate_prev:      same for the previous window
+ *                        (protected by @inner_lock)
+ * @spawn_window:         start of the current window in jiffies
+ *                        (protected by @inner_lock)
  * @tmp_ref:              temporary reference to indicate proc is in use
  *                        (protected by @inner_lock)
  * @default_priority:     default scheduler priority
@@ -423,6 +451,12 @@ enum binder_prio_state {
  * @inner_lock:           can nest under outer_lock and/or node lock
  * @outer_lock:           no nesting under innor or node lock
  *                        Lock order: 1) outer, 2) node, 3) inner
+ * @threads_lock:         protects @threads along with @inner_lock: changes
+ *                        hold both, lookups either one. Nests under
+ *                        @inner_lock
+ * @inner_stat:           contention counters of @inner_lock
+ * @outer_stat:           contention counters of @outer_lock
+ * @threads_stat:         contention counters of @threads_lock
  * @binderfs_entry:       process-specific binderfs log file
  * @oneway_spam_detection_enabled: process enabled oneway spam detection
  *                        or not
@@ -449,11 +483,17 @@ struct binder_proc {
 	wait_queue_head_t freeze_wait;
 
 	struct list_head todo;
+	struct list_head frozen_todo;
+	int nr_frozen_todo;
 	struct binder_stats stats;
 	struct list_head delivered_death;
 	u32 max_threads;
 	int requested_threads;
 	int requested_threads_started;
+	u32 spawn_wait_us;
+	u32 spawn_rate_cur;
+	u32 spawn_rate_prev;
+	unsigned long spawn_window;
 	int tmp_ref;
 	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
@@ -461,6 +501,10 @@ struct binder_proc {
 	struct binder_context *context;
 	spinlock_t inner_lock;
 	spinlock_t outer_lock;
+	spinlock_t threads_lock;
+	struct binder_lock_stat inner_stat;
+	struct binder_lock_stat outer_stat;
+	struct binder_lock_stat threads_stat;
 	struct dentry *binderfs_entry;
 	bool oneway_spam_detection_enabled;
 	ANDROID_OEM_DATA(1);
@@ -534,12 +578,25 @@ struct binder_thread {
 	enum binder_prio_state prio_state;
 };
 
+/*
+ * binder_fd_object.pad_flags bit asking the driver to also map the file, a
+ * memfd sealed against writes, read-only into the receiver on delivery. The
+ * receiver finds the address in binder_fd_object.cookie and owns both the
+ * fd and the mapping, so large payloads are handed over without the driver
+ * copying them into the binder buffer.
+ */
+#define BINDER_FD_FLAG_MAP_RO	0x01
+
 /**
  * struct binder_txn_fd_fixup - transaction fd fixup list element
  * @fixup_entry:          list entry
  * @file:                 struct file to be associated with new fd
  * @offset:               offset in buffer data to this fixup
  * @target_fd:            fd to use by the target to install @file
+ * @map_offset:           offset in buffer data to the cookie receiving the
+ *                        address of the read-only mapping of @file
+ * @map_len:              length to map, 0 if @file isn't to be mapped
+ * @map_addr:             address of the mapping in the target
  *
  * List element for fd fixups in a transaction. Since file
  * descriptors need to be allocated in the context of the
@@ -551,6 +608,9 @@ struct binder_txn_fd_fixup {
 	struct file *file;
 	size_t offset;
 	int target_fd;
+	size_t map_offset;
+	size_t map_len;
+	unsigned long map_addr;
 };
 
 struct binder_transaction {
@@ -571,10 +631,13 @@ struct binder_transaction {
 	unsigned int    flags;
 	struct binder_priority priority;
 	struct binder_priority saved_priority;
+	struct scx_sync_prop scx_prop;	/* caller's ext properties */
+	struct scx_sync_prop saved_scx_prop;
 	bool set_priority_called;
 	bool is_nested;
 	kuid_t  sender_euid;
 	ktime_t start_time;
+	u64 lat_key;		/* binder_latency_deliver() key, 0 if untracked */
 	struct list_head fd_fixups;
 	binder_uintptr_t security_ctx;
 	/**
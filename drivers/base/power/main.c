@@ -18,6 +18,7 @@
 #define pr_fmt(fmt) "PM: " fmt
 #define dev_fmt pr_fmt
 
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/export.h>
 #include <linux/mutex.h>
@@ -35,6 +36,7 @@
 #include <linux/devfreq.h>
 #include <linux/timer.h>
 #include <linux/wakeup_reason.h>
+#include <linux/sched/clock.h>
 
 #include "../base.h"
 #include "power.h"
@@ -65,6 +67,9 @@ struct suspend_stats suspend_stats;
 static DEFINE_MUTEX(dpm_list_mtx);
 static pm_message_t pm_transition;
 
+/* Phase of the current transition, for per-device callback timings */
+static enum suspend_phase dpm_phase;
+
 static int async_error;
 
 static const char *pm_verb(int event)
@@ -475,6 +480,7 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, const char *info)
 {
 	ktime_t calltime;
+	u64 start;
 	int error;
 
 	if (!cb)
@@ -484,7 +490,10 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 
 	pm_dev_dbg(dev, state, info);
 	trace_device_pm_callback_start(dev, info, state.event);
+	start = local_clock();
 	error = cb(dev);
+	log_suspend_phase_dev_time(dpm_phase, dev_name(dev),
+				   local_clock() - start);
 	trace_device_pm_callback_end(dev, error);
 	suspend_report_result(dev, cb, error);
 
@@ -671,6 +680,18 @@ static bool is_async(struct device *dev)
 		&& !pm_trace_is_enabled();
 }
 
+static bool dpm_async_schedule(struct device *dev, async_func_t func)
+{
+	get_device(dev);
+
+	if (async_schedule_dev_nocall(func, dev))
+		return true;
+
+	put_device(dev);
+
+	return false;
+}
+
 static bool dpm_async_fn(struct device *dev, async_func_t func)
 {
 	reinit_completion(&dev->power.completion);
@@ -678,14 +699,47 @@ static bool dpm_async_fn(struct device *dev, async_func_t func)
 	if (!is_async(dev))
 		return false;
 
-	get_device(dev);
+	return dpm_async_schedule(dev, func);
+}
 
-	if (async_schedule_dev_nocall(func, dev))
-		return true;
+/*
+ * A device without the async flag can still be resumed in parallel with the
+ * rest of the list if the device graph covers everything it depends on and
+ * nothing depends on it: all of its firmware dependencies have been turned
+ * into device links, which an async resume waits for along with the parent,
+ * and it has no children or consumers that may be relying on the list order.
+ */
+static bool dpm_resume_graph_independent(struct device *dev)
+{
+	struct device_link *link;
+	struct device *child;
+	bool ret = true;
+	int idx;
 
-	put_device(dev);
+	if (!pm_async_graph_enabled || !pm_async_enabled ||
+	    pm_trace_is_enabled())
+		return false;
 
-	return false;
+	if (!dev->fwnode || !(dev->fwnode->flags & FWNODE_FLAG_LINKS_ADDED))
+		return false;
+
+	child = device_find_any_child(dev);
+	if (child) {
+		put_device(child);
+		return false;
+	}
+
+	idx = device_links_read_lock();
+
+	list_for_each_entry_rcu_locked(link, &dev->links.consumers, s_node)
+		if (READ_ONCE(link->status) != DL_STATE_DORMANT) {
+			ret = false;
+			break;
+		}
+
+	device_links_read_unlock(idx);
+
+	return ret;
 }
 
 static void async_resume_noirq(void *data, async_cookie_t cookie)
@@ -741,10 +795,14 @@ static void dpm_noirq_resume_devices(pm_message_t state)
  */
 void dpm_resume_noirq(pm_message_t state)
 {
+	u64 start = local_clock();
+
+	dpm_phase = RESUME_PHASE_NOIRQ;
 	dpm_noirq_resume_devices(state);
 
 	resume_device_irqs();
 	device_wakeup_disarm_wake_irqs();
+	log_suspend_phase_time(RESUME_PHASE_NOIRQ, start);
 }
 
 /**
@@ -841,6 +899,9 @@ void dpm_resume_early(pm_message_t state)
 {
 	struct device *dev;
 	ktime_t starttime = ktime_get();
+	u64 start = local_clock();
+
+	dpm_phase = RESUME_PHASE_EARLY;
 
 	trace_suspend_resume(TPS("dpm_resume_early"), state.event, true);
 	mutex_lock(&dpm_list_mtx);
@@ -861,6 +922,7 @@ void dpm_resume_early(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	log_suspend_phase_time(RESUME_PHASE_EARLY, start);
 	dpm_show_time(starttime, state, 0, "early");
 	trace_suspend_resume(TPS("dpm_resume_early"), state.event, false);
 }
@@ -886,6 +948,7 @@ static void __device_resume(struct device *dev, pm_message_t state, bool async)
 {
 	pm_callback_t callback = NULL;
 	const char *info = NULL;
+	ktime_t starttime = ktime_get(), cbtime;
 	int error = 0;
 	DECLARE_DPM_WATCHDOG_ON_STACK(wd);
 
@@ -904,6 +967,7 @@ static void __device_resume(struct device *dev, pm_message_t state, bool async)
 	if (!dpm_wait_for_superior(dev, async))
 		goto Complete;
 
+	cbtime = ktime_get();
 	dpm_watchdog_set(&wd, dev);
 	device_lock(dev);
 
@@ -955,6 +1019,10 @@ static void __device_resume(struct device *dev, pm_message_t state, bool async)
 	error = dpm_run_callback(callback, dev, state, info);
 	dev->power.is_suspended = false;
 
+	dev->power.resumed_async = async;
+	dev->power.resume_wait_ns = ktime_to_ns(ktime_sub(cbtime, starttime));
+	dev->power.resume_cb_ns = ktime_to_ns(ktime_sub(ktime_get(), cbtime));
+
  Unlock:
 	device_unlock(dev);
 	dpm_watchdog_clear(&wd);
@@ -985,6 +1053,10 @@ static void device_resume(struct device *dev)
 	if (dpm_async_fn(dev, async_resume))
 		return;
 
+	if (dpm_resume_graph_independent(dev) &&
+	    dpm_async_schedule(dev, async_resume))
+		return;
+
 	__device_resume(dev, pm_transition, false);
 }
 
@@ -1131,8 +1203,12 @@ void dpm_complete(pm_message_t state)
  */
 void dpm_resume_end(pm_message_t state)
 {
+	u64 start = local_clock();
+
+	dpm_phase = RESUME_PHASE_DEVICES;
 	dpm_resume(state);
 	dpm_complete(state);
+	log_suspend_phase_time(RESUME_PHASE_DEVICES, start);
 }
 EXPORT_SYMBOL_GPL(dpm_resume_end);
 
@@ -1339,12 +1415,15 @@ static int dpm_noirq_suspend_devices(pm_message_t state)
  */
 int dpm_suspend_noirq(pm_message_t state)
 {
+	u64 start = local_clock();
 	int ret;
 
+	dpm_phase = SUSPEND_PHASE_NOIRQ;
 	device_wakeup_arm_wake_irqs();
 	suspend_device_irqs();
 
 	ret = dpm_noirq_suspend_devices(state);
+	log_suspend_phase_time(SUSPEND_PHASE_NOIRQ, start);
 	if (ret)
 		dpm_resume_noirq(resume_event(state));
 
@@ -1469,8 +1548,11 @@ static int device_suspend_late(struct device *dev)
 int dpm_suspend_late(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = local_clock();
 	int error = 0;
 
+	dpm_phase = SUSPEND_PHASE_LATE;
+
 	trace_suspend_resume(TPS("dpm_suspend_late"), state.event, true);
 	wake_up_all_idle_cpus();
 	mutex_lock(&dpm_list_mtx);
@@ -1507,6 +1589,7 @@ int dpm_suspend_late(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	log_suspend_phase_time(SUSPEND_PHASE_LATE, start);
 	if (!error)
 		error = async_error;
 	if (error) {
@@ -1946,14 +2029,17 @@ int dpm_prepare(pm_message_t state)
 int dpm_suspend_start(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = local_clock();
 	int error;
 
+	dpm_phase = SUSPEND_PHASE_DEVICES;
 	error = dpm_prepare(state);
 	if (error) {
 		suspend_stats.failed_prepare++;
 		dpm_save_failed_step(SUSPEND_PREPARE);
 	} else
 		error = dpm_suspend(state);
+	log_suspend_phase_time(SUSPEND_PHASE_DEVICES, start);
 	dpm_show_time(starttime, state, error, "start");
 	return error;
 }
@@ -2036,3 +2122,36 @@ bool dev_pm_skip_suspend(struct device *dev)
 	return dev_pm_test_driver_flags(dev, DPM_FLAG_SMART_SUSPEND) &&
 		pm_runtime_status_suspended(dev);
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int dpm_resume_times_show(struct seq_file *m, void *unused)
+{
+	struct device *dev;
+
+	seq_puts(m, "device\t\t\twait_us\tresume_us\tmode\n");
+
+	mutex_lock(&dpm_list_mtx);
+	list_for_each_entry(dev, &dpm_list, power.entry) {
+		if (!dev->power.resume_cb_ns)
+			continue;
+
+		seq_printf(m, "%-24s\t%llu\t%llu\t\t%s\n", dev_name(dev),
+			   div_u64(dev->power.resume_wait_ns, NSEC_PER_USEC),
+			   div_u64(dev->power.resume_cb_ns, NSEC_PER_USEC),
+			   dev->power.resumed_async ? "async" : "sync");
+	}
+	mutex_unlock(&dpm_list_mtx);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dpm_resume_times);
+
+static int __init dpm_debugfs_init(void)
+{
+	debugfs_create_file("pm_resume_times", 0444, NULL, NULL,
+			    &dpm_resume_times_fops);
+	return 0;
+}
+
+postcore_initcall(dpm_debugfs_init);
+#endif /* CONFIG_DEBUG_FS */
@@ -81,6 +81,7 @@ struct loop_device {
 struct loop_cmd {
 	struct list_head list_entry;
 	bool use_aio; /* use AIO interface to handle I/O */
+	bool nowait; /* aio issued from ->queue_rq with IOCB_NOWAIT */
 	atomic_t ref; /* only for aio */
 	long ret;
 	struct kiocb iocb;
@@ -91,11 +92,27 @@ struct loop_cmd {
 
 #define LOOP_IDLE_WORKER_TIMEOUT (60 * HZ)
 #define LOOP_DEFAULT_HW_Q_DEPTH 128
+#define LOOP_BATCH_MAX 1024
 
 static DEFINE_IDR(loop_index_idr);
 static DEFINE_MUTEX(loop_ctl_mutex);
 static DEFINE_MUTEX(loop_validate_mutex);
 
+static bool force_dio;
+module_param(force_dio, bool, 0644);
+MODULE_PARM_DESC(force_dio, "Configure every loop device for direct I/O to the backing file. Default: false");
+
+static bool nowait_dio = true;
+module_param(nowait_dio, bool, 0444);
+MODULE_PARM_DESC(nowait_dio, "Issue direct I/O from the submitting context with IOCB_NOWAIT before falling back to the worker. Default: true");
+
+static unsigned int nr_hw_queues = 1;
+module_param(nr_hw_queues, uint, 0444);
+MODULE_PARM_DESC(nr_hw_queues, "Number of hardware queues per loop device, capped to the number of CPUs. Default: 1");
+
+static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd);
+static void loop_cmd_init_css(struct loop_cmd *cmd);
+
 /**
  * loop_global_lock_killable() - take locks for safe loop_validate_file() test
  *
@@ -377,6 +394,21 @@ static void lo_rw_aio_do_completion(struct loop_cmd *cmd)
 		return;
 	kfree(cmd->bvec);
 	cmd->bvec = NULL;
+
+	/*
+	 * A NOWAIT attempt that would have blocked, or a short NOWAIT write,
+	 * is redone from the worker. This may run in irq context.
+	 */
+	if (cmd->nowait && (cmd->ret == -EAGAIN ||
+	    (op_is_write(req_op(rq)) && cmd->ret >= 0 &&
+	     cmd->ret < blk_rq_bytes(rq)))) {
+		cmd->nowait = false;
+		cmd->ret = 0;
+		loop_cmd_init_css(cmd);
+		loop_queue_work(rq->q->queuedata, cmd);
+		return;
+	}
+
 	if (likely(!blk_should_fake_timeout(rq->q)))
 		blk_mq_complete_request(rq);
 }
@@ -409,9 +441,9 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	if (rq->bio != rq->biotail) {
 
 		bvec = kmalloc_array(nr_bvec, sizeof(struct bio_vec),
-				     GFP_NOIO);
+				     cmd->nowait ? GFP_NOWAIT : GFP_NOIO);
 		if (!bvec)
-			return -EIO;
+			return cmd->nowait ? -EAGAIN : -EIO;
 		cmd->bvec = bvec;
 
 		/*
@@ -444,6 +476,8 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	cmd->iocb.ki_filp = file;
 	cmd->iocb.ki_complete = lo_rw_aio_complete;
 	cmd->iocb.ki_flags = IOCB_DIRECT;
+	if (cmd->nowait)
+		cmd->iocb.ki_flags |= IOCB_NOWAIT;
 	cmd->iocb.ki_ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
 
 	if (rw == ITER_SOURCE)
@@ -832,8 +866,10 @@ static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd)
 	struct loop_worker *cur_worker, *worker = NULL;
 	struct work_struct *work;
 	struct list_head *cmd_list;
+	unsigned long flags;
 
-	spin_lock_irq(&lo->lo_work_lock);
+	/* Also called from aio completion to retry a failed NOWAIT attempt */
+	spin_lock_irqsave(&lo->lo_work_lock, flags);
 
 	if (queue_on_root_worker(cmd->blkcg_css))
 		goto queue_work;
@@ -893,7 +929,7 @@ static void loop_queue_work(struct loop_device *lo, struct loop_cmd *cmd)
 	}
 	list_add_tail(&cmd->list_entry, cmd_list);
 	queue_work(lo->workqueue, work);
-	spin_unlock_irq(&lo->lo_work_lock);
+	spin_unlock_irqrestore(&lo->lo_work_lock, flags);
 }
 
 static void loop_set_timer(struct loop_device *lo)
@@ -1068,6 +1104,8 @@ static int loop_configure(struct loop_device *lo, blk_mode_t mode,
 	disk_force_media_change(lo->lo_disk);
 	set_disk_ro(lo->lo_disk, (lo->lo_flags & LO_FLAGS_READ_ONLY) != 0);
 
+	if (force_dio)
+		lo->lo_flags |= LO_FLAGS_DIRECT_IO;
 	lo->use_dio = lo->lo_flags & LO_FLAGS_DIRECT_IO;
 	lo->lo_device = bdev;
 	lo->lo_backing_file = file;
@@ -1840,12 +1878,46 @@ MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
 MODULE_IMPORT_NS(VFS_internal_I_am_really_a_filesystem_and_am_NOT_a_driver);
 
+static void loop_cmd_init_css(struct loop_cmd *cmd)
+{
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+
+	/* always use the first bio's css */
+	cmd->blkcg_css = NULL;
+	cmd->memcg_css = NULL;
+#ifdef CONFIG_BLK_CGROUP
+	if (rq->bio) {
+		cmd->blkcg_css = bio_blkcg_css(rq->bio);
+#ifdef CONFIG_MEMCG
+		if (cmd->blkcg_css) {
+			cmd->memcg_css =
+				cgroup_get_e_css(cmd->blkcg_css->cgroup,
+						&memory_cgrp_subsys);
+		}
+#endif
+	}
+#endif
+}
+
+/*
+ * Direct I/O can be issued straight from ->queue_rq, in the submitter's
+ * context, as long as the backing file won't block for it. Anything that
+ * would block comes back as -EAGAIN and is redone by the worker.
+ */
+static bool loop_can_nowait(struct loop_device *lo, struct request *rq)
+{
+	return nowait_dio &&
+		(lo->lo_backing_file->f_mode & FMODE_NOWAIT) &&
+		!(op_is_write(req_op(rq)) && (lo->lo_flags & LO_FLAGS_READ_ONLY));
+}
+
 static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 		const struct blk_mq_queue_data *bd)
 {
 	struct request *rq = bd->rq;
 	struct loop_cmd *cmd = blk_mq_rq_to_pdu(rq);
 	struct loop_device *lo = rq->q->queuedata;
+	int ret;
 
 	blk_mq_start_request(rq);
 
@@ -1863,21 +1935,17 @@ static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 		break;
 	}
 
-	/* always use the first bio's css */
-	cmd->blkcg_css = NULL;
-	cmd->memcg_css = NULL;
-#ifdef CONFIG_BLK_CGROUP
-	if (rq->bio) {
-		cmd->blkcg_css = bio_blkcg_css(rq->bio);
-#ifdef CONFIG_MEMCG
-		if (cmd->blkcg_css) {
-			cmd->memcg_css =
-				cgroup_get_e_css(cmd->blkcg_css->cgroup,
-						&memory_cgrp_subsys);
-		}
-#endif
+	cmd->nowait = cmd->use_aio && loop_can_nowait(lo, rq);
+	if (cmd->nowait) {
+		ret = do_req_filebacked(lo, rq);
+		if (!ret)
+			return BLK_STS_OK;
+		if (ret != -EAGAIN)
+			return BLK_STS_IOERR;
+		cmd->nowait = false;
 	}
-#endif
+
+	loop_cmd_init_css(cmd);
 	loop_queue_work(lo, cmd);
 
 	return BLK_STS_OK;
@@ -2018,12 +2086,15 @@ static int loop_add(int i)
 	i = err;
 
 	lo->tag_set.ops = &loop_mq_ops;
-	lo->tag_set.nr_hw_queues = 1;
+	lo->tag_set.nr_hw_queues = clamp(nr_hw_queues, 1U, nr_cpu_ids);
 	lo->tag_set.queue_depth = hw_queue_depth;
 	lo->tag_set.numa_node = NUMA_NO_NODE;
 	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
 	lo->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_STACKING |
 		BLK_MQ_F_NO_SCHED_BY_DEFAULT;
+	/* NOWAIT submission still calls into the backing filesystem */
+	if (nowait_dio)
+		lo->tag_set.flags |= BLK_MQ_F_BLOCKING;
 	lo->tag_set.driver_data = lo;
 
 	err = blk_mq_alloc_tag_set(&lo->tag_set);
@@ -2201,6 +2272,79 @@ static int loop_control_get_free(int idx)
 	return id;
 }
 
+static int loop_control_configure_one(struct loop_batch_entry *entry)
+{
+	struct block_device *bdev;
+	struct loop_device *lo;
+	blk_mode_t mode = BLK_OPEN_READ | BLK_OPEN_WRITE;
+	int idx = entry->index;
+	int ret;
+
+	if (idx < 0) {
+		idx = loop_control_get_free(-1);
+		if (idx < 0)
+			return idx;
+	} else {
+		ret = loop_add(idx);
+		if (ret < 0 && ret != -EEXIST)
+			return ret;
+	}
+	entry->index = idx;
+
+	ret = mutex_lock_killable(&loop_ctl_mutex);
+	if (ret)
+		return ret;
+	lo = idr_find(&loop_index_idr, idx);
+	if (!lo || !lo->idr_visible)
+		ret = -ENODEV;
+	mutex_unlock(&loop_ctl_mutex);
+	if (ret)
+		return ret;
+
+	if (entry->config.info.lo_flags & LO_FLAGS_READ_ONLY)
+		mode &= ~BLK_OPEN_WRITE;
+	bdev = blkdev_get_by_dev(disk_devt(lo->lo_disk), mode, NULL, NULL);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+	ret = loop_configure(lo, mode, bdev, &entry->config);
+	blkdev_put(bdev, NULL);
+	return ret;
+}
+
+/*
+ * Set up many loop devices in one call, e.g. for all APEX images at boot.
+ * Each entry reports its own result; returns the number that succeeded.
+ */
+static long loop_control_configure_batch(struct loop_batch __user *arg)
+{
+	struct loop_batch_entry __user *uentries;
+	struct loop_batch_entry entry;
+	struct loop_batch batch;
+	long done = 0;
+	u32 i;
+
+	if (copy_from_user(&batch, arg, sizeof(batch)))
+		return -EFAULT;
+	if (batch.flags || batch.nr > LOOP_BATCH_MAX)
+		return -EINVAL;
+
+	uentries = u64_to_user_ptr(batch.entries);
+	for (i = 0; i < batch.nr; i++) {
+		if (copy_from_user(&entry, &uentries[i], sizeof(entry)))
+			return done ? done : -EFAULT;
+
+		entry.error = loop_control_configure_one(&entry);
+		if (!entry.error)
+			done++;
+
+		if (copy_to_user(&uentries[i], &entry, sizeof(entry)))
+			return done ? done : -EFAULT;
+		if (fatal_signal_pending(current))
+			break;
+	}
+	return done;
+}
+
 static long loop_control_ioctl(struct file *file, unsigned int cmd,
 			       unsigned long parm)
 {
@@ -2211,6 +2355,8 @@ static long loop_control_ioctl(struct file *file, unsigned int cmd,
 		return loop_control_remove(parm);
 	case LOOP_CTL_GET_FREE:
 		return loop_control_get_free(parm);
+	case LOOP_CTL_CONFIGURE_BATCH:
+		return loop_control_configure_batch((void __user *)parm);
 	default:
 		return -ENOSYS;
 	}
@@ -200,7 +200,7 @@ static inline struct ublksrv_io_desc *ublk_get_iod(struct ublk_queue *ubq,
 
 static inline bool ublk_dev_is_user_copy(const struct ublk_device *ub)
 {
-	return ub->dev_info.flags & UBLK_F_USER_COPY;
+	return ub->dev_info.flags & (UBLK_F_USER_COPY | UBLK_F_SUPPORT_ZERO_COPY);
 }
 
 static inline bool ublk_dev_is_zoned(const struct ublk_device *ub)
@@ -597,14 +597,20 @@ static int ublk_apply_params(struct ublk_device *ub)
 
 static inline bool ublk_support_user_copy(const struct ublk_queue *ubq)
 {
-	return ubq->flags & UBLK_F_USER_COPY;
+	return ubq->flags & (UBLK_F_USER_COPY | UBLK_F_SUPPORT_ZERO_COPY);
+}
+
+static inline bool ublk_support_zero_copy(const struct ublk_queue *ubq)
+{
+	return ubq->flags & UBLK_F_SUPPORT_ZERO_COPY;
 }
 
 static inline bool ublk_need_req_ref(const struct ublk_queue *ubq)
 {
 	/*
-	 * read()/write() is involved in user copy, so request reference
-	 * has to be grabbed
+	 * read()/write() is involved in user copy, and zero copy buffers
+	 * are still in use after the command is committed, so request
+	 * reference has to be grabbed
 	 */
 	return ublk_support_user_copy(ubq);
 }
@@ -1656,6 +1662,52 @@ static inline int ublk_check_cmd_op(u32 cmd_op)
 	return 0;
 }
 
+static inline struct request *__ublk_check_and_get_req(struct ublk_device *ub,
+		struct ublk_queue *ubq, int tag, size_t offset);
+
+static void ublk_io_release(void *priv)
+{
+	struct request *rq = priv;
+	struct ublk_queue *ubq = rq->mq_hctx->driver_data;
+
+	ublk_put_req_ref(ubq, rq);
+}
+
+/* The buffer holds a request reference until io_uring releases it */
+static int ublk_register_io_buf(struct io_uring_cmd *cmd,
+		struct ublk_device *ub, struct ublk_queue *ubq,
+		struct ublk_io *io, unsigned int index,
+		unsigned int issue_flags)
+{
+	struct request *req;
+	int ret;
+
+	if (!ublk_support_zero_copy(ubq))
+		return -EINVAL;
+	if (!(io->flags & UBLK_IO_FLAG_OWNED_BY_SRV))
+		return -EINVAL;
+
+	req = __ublk_check_and_get_req(ub, ubq, io - ubq->ios, 0);
+	if (!req)
+		return -EINVAL;
+
+	ret = io_buffer_register_bvec(cmd, req, ublk_io_release, index,
+				      issue_flags);
+	if (ret)
+		ublk_put_req_ref(ubq, req);
+	return ret;
+}
+
+static int ublk_unregister_io_buf(struct io_uring_cmd *cmd,
+		struct ublk_queue *ubq, unsigned int index,
+		unsigned int issue_flags)
+{
+	if (!ublk_support_zero_copy(ubq))
+		return -EINVAL;
+
+	return io_buffer_unregister_bvec(cmd, index, issue_flags);
+}
+
 static inline void ublk_fill_io_cmd(struct ublk_io *io,
 		struct io_uring_cmd *cmd, unsigned long buf_addr)
 {
@@ -1776,6 +1828,14 @@ static int __ublk_ch_uring_cmd(struct io_uring_cmd *cmd,
 		ublk_fill_io_cmd(io, cmd, ub_cmd->addr);
 		ublk_handle_need_get_data(ub, ub_cmd->q_id, ub_cmd->tag);
 		break;
+	case UBLK_IO_REGISTER_IO_BUF:
+		ret = ublk_register_io_buf(cmd, ub, ubq, io, ub_cmd->addr,
+					   issue_flags);
+		goto out;
+	case UBLK_IO_UNREGISTER_IO_BUF:
+		ret = ublk_unregister_io_buf(cmd, ubq, ub_cmd->addr,
+					     issue_flags);
+		goto out;
 	default:
 		goto out;
 	}
@@ -2361,9 +2421,6 @@ static int ublk_ctrl_add_dev(struct io_uring_cmd *cmd)
 		goto out_free_dev_number;
 	}
 
-	/* We are not ready to support zero copy */
-	ub->dev_info.flags &= ~UBLK_F_SUPPORT_ZERO_COPY;
-
 	ub->dev_info.nr_hw_queues = min_t(unsigned int,
 			ub->dev_info.nr_hw_queues, nr_cpu_ids);
 	ublk_align_max_io_size(ub);
@@ -2678,7 +2735,7 @@ static int ublk_ctrl_get_features(struct io_uring_cmd *cmd)
 {
 	const struct ublksrv_ctrl_cmd *header = io_uring_sqe_cmd(cmd->sqe);
 	void __user *argp = (void __user *)(unsigned long)header->addr;
-	u64 features = UBLK_F_ALL & ~UBLK_F_SUPPORT_ZERO_COPY;
+	u64 features = UBLK_F_ALL;
 
 	if (header->len != UBLK_FEATURES_LEN || !header->addr)
 		return -EINVAL;
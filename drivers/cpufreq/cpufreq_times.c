@@ -16,14 +16,35 @@
 #include <linux/cpufreq.h>
 #include <linux/cpufreq_times.h>
 #include <linux/jiffies.h>
+#include <linux/pid_namespace.h>
+#include <linux/proc_fs.h>
+#include <linux/ptrace.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
-#include <linux/spinlock.h>
 #include <linux/threads.h>
 #include <trace/hooks/cpufreq.h>
 
-static DEFINE_SPINLOCK(task_time_in_state_lock); /* task->time_in_state */
+/**
+ * struct cpufreq_task_times - per-task time spent at each frequency
+ * @rcu: for freeing the array after it has been grown
+ * @seq: makes readers see a consistent snapshot of @time_in_state
+ * @max_state: number of entries in @time_in_state
+ * @time_in_state: cputime in ns, indexed by cpu_freqs offset + freq index
+ *
+ * Only the CPU accounting cputime to the task writes to it, so the tick
+ * path needs neither a lock nor atomics. When a new policy shows up the
+ * writer replaces the array by a bigger copy and frees the old one after
+ * a grace period, readers use RCU and retry on @seq.
+ */
+struct cpufreq_task_times {
+	struct rcu_head rcu;
+	seqcount_t seq;
+	unsigned int max_state;
+	u64 time_in_state[];
+};
 
 /**
  * struct cpu_freqs - per-cpu frequency information
@@ -43,74 +64,98 @@ static struct cpu_freqs *all_freqs[NR_CPUS];
 
 static unsigned int next_offset;
 
-void cpufreq_task_times_init(struct task_struct *p)
+static struct cpufreq_task_times *cpufreq_task_times_new(unsigned int max_state)
 {
-	unsigned long flags;
+	struct cpufreq_task_times *times;
+
+	/* We use one array to avoid multiple allocs per task */
+	times = kzalloc(struct_size(times, time_in_state, max_state), GFP_ATOMIC);
+	if (!times)
+		return NULL;
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
-	p->time_in_state = NULL;
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
-	p->max_state = 0;
+	seqcount_init(&times->seq);
+	times->max_state = max_state;
+	return times;
 }
 
-void cpufreq_task_times_alloc(struct task_struct *p)
+void cpufreq_task_times_init(struct task_struct *p)
 {
-	void *temp;
-	unsigned long flags;
-	unsigned int max_state = READ_ONCE(next_offset);
+	RCU_INIT_POINTER(p->time_in_state, NULL);
+}
 
-	/* We use one array to avoid multiple allocs per task */
-	temp = kcalloc(max_state, sizeof(p->time_in_state[0]), GFP_ATOMIC);
-	if (!temp)
-		return;
+void cpufreq_task_times_alloc(struct task_struct *p)
+{
+	struct cpufreq_task_times *times;
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
-	p->time_in_state = temp;
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
-	p->max_state = max_state;
+	times = cpufreq_task_times_new(READ_ONCE(next_offset));
+	if (times)
+		rcu_assign_pointer(p->time_in_state, times);
 }
 
-/* Caller must hold task_time_in_state_lock */
-static int cpufreq_task_times_realloc_locked(struct task_struct *p)
+/* Called by the only writer of p's times, with interrupts disabled */
+static struct cpufreq_task_times *
+cpufreq_task_times_grow(struct task_struct *p, struct cpufreq_task_times *old)
 {
-	void *temp;
-	unsigned int max_state = READ_ONCE(next_offset);
+	struct cpufreq_task_times *times;
 
-	temp = krealloc(p->time_in_state, max_state * sizeof(u64), GFP_ATOMIC);
-	if (!temp)
-		return -ENOMEM;
-	p->time_in_state = temp;
-	memset(p->time_in_state + p->max_state, 0,
-	       (max_state - p->max_state) * sizeof(u64));
-	p->max_state = max_state;
-	return 0;
+	times = cpufreq_task_times_new(READ_ONCE(next_offset));
+	if (!times)
+		return NULL;
+
+	memcpy(times->time_in_state, old->time_in_state,
+	       old->max_state * sizeof(old->time_in_state[0]));
+	rcu_assign_pointer(p->time_in_state, times);
+	kfree_rcu(old, rcu);
+	return times;
 }
 
 void cpufreq_task_times_exit(struct task_struct *p)
 {
-	unsigned long flags;
-	void *temp;
+	struct cpufreq_task_times *times;
 
-	if (!p->time_in_state)
+	times = rcu_dereference_protected(p->time_in_state, true);
+	if (!times)
 		return;
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
-	temp = p->time_in_state;
-	p->time_in_state = NULL;
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
-	kfree(temp);
+	RCU_INIT_POINTER(p->time_in_state, NULL);
+	kfree_rcu(times, rcu);
+}
+
+/* Caller must be in an RCU read side critical section */
+static unsigned int cpufreq_task_times_read(struct cpufreq_task_times *times,
+					    u64 *buf, unsigned int len)
+{
+	unsigned int seq, n;
+
+	n = min(len, times->max_state);
+	do {
+		seq = read_seqcount_begin(&times->seq);
+		memcpy(buf, times->time_in_state, n * sizeof(*buf));
+	} while (read_seqcount_retry(&times->seq, seq));
+
+	return n;
 }
 
 int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
 	struct pid *pid, struct task_struct *p)
 {
-	unsigned int cpu, i;
-	u64 cputime;
-	unsigned long flags;
+	unsigned int cpu, i, n = 0;
+	unsigned int max_state = READ_ONCE(next_offset);
+	struct cpufreq_task_times *times;
 	struct cpu_freqs *freqs;
 	struct cpu_freqs *last_freqs = NULL;
+	u64 *buf;
+
+	buf = kcalloc(max_state, sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	rcu_read_lock();
+	times = rcu_dereference(p->time_in_state);
+	if (times)
+		n = cpufreq_task_times_read(times, buf, max_state);
+	rcu_read_unlock();
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
 	for_each_possible_cpu(cpu) {
 		freqs = all_freqs[cpu];
 		if (!freqs || freqs == last_freqs)
@@ -119,15 +164,16 @@ int proc_time_in_state_show(struct seq_file *m, struct pid_namespace *ns,
 
 		seq_printf(m, "cpu%u\n", cpu);
 		for (i = 0; i < freqs->max_state; i++) {
-			cputime = 0;
-			if (freqs->offset + i < p->max_state &&
-			    p->time_in_state)
-				cputime = p->time_in_state[freqs->offset + i];
+			u64 cputime = 0;
+
+			if (freqs->offset + i < n)
+				cputime = buf[freqs->offset + i];
 			seq_printf(m, "%u %lu\n", freqs->freq_table[i],
 				   (unsigned long)nsec_to_clock_t(cputime));
 		}
 	}
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
+
+	kfree(buf);
 	return 0;
 }
 
@@ -135,6 +181,7 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 {
 	unsigned long flags;
 	unsigned int state;
+	struct cpufreq_task_times *times;
 	struct cpu_freqs *freqs = all_freqs[task_cpu(p)];
 
 	if (!freqs || is_idle_task(p) || p->flags & PF_EXITING)
@@ -142,11 +189,20 @@ void cpufreq_acct_update_power(struct task_struct *p, u64 cputime)
 
 	state = freqs->offset + READ_ONCE(freqs->last_index);
 
-	spin_lock_irqsave(&task_time_in_state_lock, flags);
-	if ((state < p->max_state || !cpufreq_task_times_realloc_locked(p)) &&
-	    p->time_in_state)
-		p->time_in_state[state] += cputime;
-	spin_unlock_irqrestore(&task_time_in_state_lock, flags);
+	/*
+	 * Cputime is only accounted to p by the CPU it runs on, so this is
+	 * the only writer; keep interrupts off so the tick cannot nest.
+	 */
+	local_irq_save(flags);
+	times = rcu_dereference_protected(p->time_in_state, true);
+	if (times && state >= times->max_state)
+		times = cpufreq_task_times_grow(p, times);
+	if (times) {
+		write_seqcount_begin(&times->seq);
+		times->time_in_state[state] += cputime;
+		write_seqcount_end(&times->seq);
+	}
+	local_irq_restore(flags);
 
 	trace_android_vh_cpufreq_acct_update_power(cputime, p, state);
 }
@@ -211,3 +267,152 @@ void cpufreq_times_record_transition(struct cpufreq_policy *policy,
 	if (index >= 0)
 		WRITE_ONCE(freqs->last_index, index);
 }
+
+/*
+ * /proc/task_time_in_state: time_in_state of every thread in one binary read,
+ * for battery accounting which would otherwise open and parse thousands of
+ * per-thread files. Little overhead for the tick, readers never block it.
+ *
+ * The file starts with a header of two u32: the format version (1) and the
+ * total number of frequency states, that is the sum of all policies' entries
+ * in cpufreq_stats order. It is followed by one record per thread with a
+ * time_in_state array: u32 pid, u32 nr, then nr u64 times in nanoseconds.
+ * nr can be less than the total number of states, the missing entries are 0.
+ * Threads whose /proc/<pid> the reader may not look into because of the
+ * hidepid mount option are left out.
+ */
+struct task_times_iter {
+	u64 *buf;
+	unsigned int len;
+};
+
+static struct pid_namespace *task_times_ns(struct seq_file *m)
+{
+	return proc_pid_ns(file_inode(m->file)->i_sb);
+}
+
+/* The hidepid part of has_pid_permissions(), for HIDEPID_NO_ACCESS */
+static bool task_times_visible(struct seq_file *m, struct task_struct *p)
+{
+	struct proc_fs_info *fs_info = proc_sb_info(file_inode(m->file)->i_sb);
+
+	if (fs_info->hide_pid != HIDEPID_NOT_PTRACEABLE) {
+		if (fs_info->hide_pid < HIDEPID_NO_ACCESS)
+			return true;
+		if (in_group_p(fs_info->pid_gid))
+			return true;
+	}
+	return ptrace_may_access(p, PTRACE_MODE_READ_FSCREDS);
+}
+
+static void *task_times_next_pid(struct seq_file *m, int nr, loff_t *pos)
+{
+	struct pid *pid = find_ge_pid(nr, task_times_ns(m));
+
+	if (!pid)
+		return NULL;
+	*pos = (loff_t)pid_nr_ns(pid, task_times_ns(m)) + 1;
+	return pid;
+}
+
+static void *task_times_start(struct seq_file *m, loff_t *pos)
+{
+	struct task_times_iter *it = m->private;
+	unsigned int len = READ_ONCE(next_offset);
+
+	if (it->len < len) {
+		kfree(it->buf);
+		it->buf = kcalloc(len, sizeof(*it->buf), GFP_KERNEL);
+		it->len = it->buf ? len : 0;
+		if (!it->buf)
+			return ERR_PTR(-ENOMEM);
+	}
+
+	rcu_read_lock();
+	if (!*pos)
+		return SEQ_START_TOKEN;
+	if (*pos > INT_MAX)
+		return NULL;
+	return task_times_next_pid(m, *pos - 1, pos);
+}
+
+static void *task_times_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	int nr = v == SEQ_START_TOKEN ? 1 : *pos;
+
+	/* Always move forward, even when no pid is left */
+	(*pos)++;
+	return task_times_next_pid(m, nr, pos);
+}
+
+static void task_times_stop(struct seq_file *m, void *v)
+{
+	if (!IS_ERR(v))
+		rcu_read_unlock();
+}
+
+static int task_times_show(struct seq_file *m, void *v)
+{
+	struct task_times_iter *it = m->private;
+	struct cpufreq_task_times *times;
+	struct task_struct *p;
+	u32 rec[2];
+
+	if (v == SEQ_START_TOKEN) {
+		rec[0] = 1;
+		rec[1] = READ_ONCE(next_offset);
+		seq_write(m, rec, sizeof(rec));
+		return 0;
+	}
+
+	p = pid_task(v, PIDTYPE_PID);
+	if (!p || !task_times_visible(m, p))
+		return 0;
+	times = rcu_dereference(p->time_in_state);
+	if (!times)
+		return 0;
+
+	rec[0] = pid_nr_ns(v, task_times_ns(m));
+	rec[1] = cpufreq_task_times_read(times, it->buf, it->len);
+	seq_write(m, rec, sizeof(rec));
+	seq_write(m, it->buf, rec[1] * sizeof(*it->buf));
+	return 0;
+}
+
+static const struct seq_operations task_times_seq_ops = {
+	.start	= task_times_start,
+	.next	= task_times_next,
+	.stop	= task_times_stop,
+	.show	= task_times_show,
+};
+
+static int task_times_release(struct inode *inode, struct file *file)
+{
+	struct seq_file *m = file->private_data;
+	struct task_times_iter *it = m->private;
+
+	kfree(it->buf);
+	return seq_release_private(inode, file);
+}
+
+static int task_times_open(struct inode *inode, struct file *file)
+{
+	if (!__seq_open_private(file, &task_times_seq_ops,
+				sizeof(struct task_times_iter)))
+		return -ENOMEM;
+	return 0;
+}
+
+static const struct proc_ops task_times_proc_ops = {
+	.proc_open	= task_times_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= task_times_release,
+};
+
+static int __init cpufreq_times_init(void)
+{
+	proc_create("task_time_in_state", 0444, NULL, &task_times_proc_ops);
+	return 0;
+}
+fs_initcall(cpufreq_times_init);
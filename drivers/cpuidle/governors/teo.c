@@ -130,9 +130,21 @@
  * util to the precomputed util threshold. If it's below, it defaults to the
  * TEO metrics mechanism. If it's above, the closest shallower idle state will
  * be selected instead, as long as is not a polling state.
+ *
+ * Device interrupt prediction:
+ *
+ * Some device interrupts (display vsync, audio DMA, modem paging) recur at
+ * intervals of their own and are not covered by the timer based sleep length.
+ * With CONFIG_CPU_IDLE_GOV_TEO_IRQ_PREDICT, the per-IRQ inter-arrival
+ * statistics kept by the IRQ timings code are used to predict the next device
+ * interrupt on the CPU. If that is expected before the closest timer, it
+ * bounds the sleep length used for the timers check, so that a deep state is
+ * not entered only to be left early. The hits/intercepts accounting keeps
+ * using the timer sleep length.
  */
 
 #include <linux/cpuidle.h>
+#include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
 #include <linux/sched.h>
@@ -189,6 +201,7 @@ struct teo_bin {
  * @recent_idx: Indices of bins corresponding to recent "intercepts".
  * @tick_hits: Number of "hits" after TICK_NSEC.
  * @util_threshold: Threshold above which the CPU is considered utilized
+ * @irq_next_ns: Predicted time of the next device interrupt (local_clock()).
  */
 struct teo_cpu {
 	s64 time_span_ns;
@@ -199,6 +212,7 @@ struct teo_cpu {
 	int recent_idx[NR_RECENT];
 	unsigned int tick_hits;
 	unsigned long util_threshold;
+	u64 irq_next_ns;
 };
 
 static DEFINE_PER_CPU(struct teo_cpu, teo_cpus);
@@ -345,6 +359,34 @@ static void teo_update(struct cpuidle_driver *drv, struct cpuidle_device *dev)
 	cpu_data->total += PULSE;
 }
 
+#ifdef CONFIG_CPU_IDLE_GOV_TEO_IRQ_PREDICT
+/*
+ * Time till the next device interrupt expected on this CPU. The IRQ timings
+ * code only predicts after new interrupts have been recorded, so keep the
+ * last prediction around for as long as it lies in the future.
+ */
+static s64 teo_irq_sleep_length(struct teo_cpu *cpu_data)
+{
+	u64 now = local_clock();
+	u64 next = irq_timings_next_event(now);
+
+	if (next != U64_MAX)
+		cpu_data->irq_next_ns = next;
+	else if (cpu_data->irq_next_ns <= now)
+		return KTIME_MAX;
+
+	if (cpu_data->irq_next_ns <= now)
+		return 0;
+
+	return min_t(u64, cpu_data->irq_next_ns - now, KTIME_MAX);
+}
+#else
+static inline s64 teo_irq_sleep_length(struct teo_cpu *cpu_data)
+{
+	return KTIME_MAX;
+}
+#endif
+
 static bool teo_state_ok(int i, struct cpuidle_driver *drv)
 {
 	return !tick_nohz_tick_stopped() ||
@@ -604,6 +646,12 @@ static int teo_select(struct cpuidle_driver *drv, struct cpuidle_device *dev,
 	duration_ns = tick_nohz_get_sleep_length(&delta_tick);
 	cpu_data->sleep_length_ns = duration_ns;
 
+	/*
+	 * A periodic device interrupt may be due before the closest timer, in
+	 * which case it is the expected wakeup.
+	 */
+	duration_ns = min(duration_ns, teo_irq_sleep_length(cpu_data));
+
 	/*
 	 * If the closest expected timer is before the terget residency of the
 	 * candidate state, a shallower one needs to be found.
@@ -702,6 +750,10 @@ static struct cpuidle_governor teo_governor = {
 
 static int __init teo_governor_init(void)
 {
+#ifdef CONFIG_CPU_IDLE_GOV_TEO_IRQ_PREDICT
+	irq_timings_enable();
+#endif
+
 	return cpuidle_register_governor(&teo_governor);
 }
 
@@ -11,12 +11,109 @@
 #include <linux/cpu.h>
 #include <linux/cpufreq.h>
 #include <linux/cpumask.h>
+#include <linux/irq_work.h>
+#include <linux/jiffies.h>
 #include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/devfreq.h>
 #include <linux/units.h>
+#include <linux/workqueue.h>
 #include "governor.h"
 
+/* Default stall ratio (in %) at which the stall vote reaches the max freq */
+#define MEM_STALL_FULL_PCT	50
+/* Change of a CPU's stall ratio that triggers a re-evaluation */
+#define MEM_STALL_KICK_PCT	10
+
+/* Memory stall ratio of each CPU, fed by PMU drivers or the ext scheduler */
+static DEFINE_PER_CPU(unsigned int, mem_stall_pct);
+
+/* Passive devices with a cpufreq parent, to be re-evaluated on stall changes */
+static LIST_HEAD(mem_stall_list);
+static DEFINE_MUTEX(mem_stall_lock);
+
+static void mem_stall_work_fn(struct work_struct *work)
+{
+	struct devfreq_passive_data *p_data;
+
+	mutex_lock(&mem_stall_lock);
+	list_for_each_entry(p_data, &mem_stall_list, mem_stall_node) {
+		struct devfreq *devfreq = p_data->this;
+
+		mutex_lock(&devfreq->lock);
+		if (p_data->mem_stall_mode && devfreq_update_target(devfreq, 0L))
+			dev_err(&devfreq->dev, "failed to update the frequency.\n");
+		mutex_unlock(&devfreq->lock);
+	}
+	mutex_unlock(&mem_stall_lock);
+}
+static DECLARE_WORK(mem_stall_work, mem_stall_work_fn);
+
+static void mem_stall_irq_work_fn(struct irq_work *irq_work)
+{
+	schedule_work(&mem_stall_work);
+}
+static DEFINE_IRQ_WORK(mem_stall_irq_work, mem_stall_irq_work_fn);
+
+/**
+ * devfreq_passive_set_mem_stall() - Report the memory stall ratio of a CPU
+ * @cpu:	the CPU the ratio was measured on.
+ * @stall_pct:	share (in %) of the CPU's busy cycles stalled on memory.
+ *
+ * Passive devices in memory stall mode vote for a frequency proportional to
+ * the highest stall ratio of their parent CPUs, so that memory-bound work
+ * gets bandwidth even while the CPUs run slowly. A large enough change
+ * triggers a re-evaluation; smaller ones are picked up on the next CPU
+ * frequency change. Can be called from any context.
+ */
+void devfreq_passive_set_mem_stall(int cpu, unsigned int stall_pct)
+{
+	unsigned int old;
+
+	stall_pct = min(stall_pct, 100U);
+	old = per_cpu(mem_stall_pct, cpu);
+	WRITE_ONCE(per_cpu(mem_stall_pct, cpu), stall_pct);
+
+	if (abs((int)stall_pct - (int)old) >= MEM_STALL_KICK_PCT)
+		irq_work_queue(&mem_stall_irq_work);
+}
+EXPORT_SYMBOL_GPL(devfreq_passive_set_mem_stall);
+
+static void mem_stall_account(struct devfreq *devfreq,
+			      struct devfreq_passive_data *p_data)
+{
+	u64 now = get_jiffies_64();
+
+	if (p_data->mem_stall_time)
+		p_data->mem_stall_time[p_data->mem_stall_idx] +=
+			now - p_data->mem_stall_last;
+	p_data->mem_stall_last = now;
+}
+
+static unsigned long mem_stall_get_vote(struct devfreq *devfreq,
+					struct devfreq_passive_data *p_data)
+{
+	unsigned long dev_min, dev_max, vote;
+	unsigned int cpu, stall = 0;
+	int i;
+
+	for_each_online_cpu(cpu)
+		stall = max(stall, READ_ONCE(per_cpu(mem_stall_pct, cpu)));
+
+	stall = min(stall * 100 / p_data->mem_stall_full_pct, 100U);
+	devfreq_get_freq_range(devfreq, &dev_min, &dev_max);
+	vote = dev_min + mult_frac(dev_max - dev_min, stall, 100);
+
+	mem_stall_account(devfreq, p_data);
+	for (i = 0; i < devfreq->max_state - 1; i++)
+		if (devfreq->freq_table[i] >= vote)
+			break;
+	p_data->mem_stall_idx = i;
+	p_data->mem_stall_vote = vote;
+
+	return vote;
+}
+
 static struct devfreq_cpu_data *
 get_parent_cpu_data(struct devfreq_passive_data *p_data,
 		    struct cpufreq_policy *policy)
@@ -124,6 +221,10 @@ static int get_target_freq_with_cpufreq(struct devfreq *devfreq,
 		cpufreq_cpu_put(policy);
 	}
 
+	if (p_data->mem_stall_mode)
+		*target_freq = max(mem_stall_get_vote(devfreq, p_data),
+				   *target_freq);
+
 	return ret;
 }
 
@@ -390,6 +491,161 @@ static int devfreq_passive_register_notifier(struct devfreq *devfreq)
 	return devfreq_register_notifier(parent, nb, DEVFREQ_TRANSITION_NOTIFIER);
 }
 
+static ssize_t mem_stall_mode_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct devfreq_passive_data *p_data = to_devfreq(dev)->data;
+
+	return sprintf(buf, "%d\n", p_data->mem_stall_mode);
+}
+
+static ssize_t mem_stall_mode_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_passive_data *p_data = devfreq->data;
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(buf, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&devfreq->lock);
+	if (enable && !p_data->mem_stall_mode)
+		p_data->mem_stall_last = get_jiffies_64();
+	else if (!enable && p_data->mem_stall_mode)
+		mem_stall_account(devfreq, p_data);
+	p_data->mem_stall_mode = enable;
+	ret = devfreq_update_target(devfreq, 0L);
+	mutex_unlock(&devfreq->lock);
+
+	return ret ? ret : count;
+}
+static DEVICE_ATTR_RW(mem_stall_mode);
+
+static ssize_t mem_stall_full_pct_show(struct device *dev,
+				       struct device_attribute *attr, char *buf)
+{
+	struct devfreq_passive_data *p_data = to_devfreq(dev)->data;
+
+	return sprintf(buf, "%u\n", p_data->mem_stall_full_pct);
+}
+
+static ssize_t mem_stall_full_pct_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_passive_data *p_data = devfreq->data;
+	unsigned int pct;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &pct);
+	if (ret)
+		return ret;
+	if (!pct || pct > 100)
+		return -EINVAL;
+
+	mutex_lock(&devfreq->lock);
+	p_data->mem_stall_full_pct = pct;
+	mutex_unlock(&devfreq->lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(mem_stall_full_pct);
+
+static ssize_t mem_stall_vote_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct devfreq_passive_data *p_data = to_devfreq(dev)->data;
+
+	return sprintf(buf, "%lu\n", p_data->mem_stall_vote);
+}
+static DEVICE_ATTR_RO(mem_stall_vote);
+
+static ssize_t mem_stall_time_in_state_show(struct device *dev,
+					    struct device_attribute *attr,
+					    char *buf)
+{
+	struct devfreq *devfreq = to_devfreq(dev);
+	struct devfreq_passive_data *p_data = devfreq->data;
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&devfreq->lock);
+	if (p_data->mem_stall_mode)
+		mem_stall_account(devfreq, p_data);
+	for (i = 0; i < devfreq->max_state && p_data->mem_stall_time; i++)
+		len += sysfs_emit_at(buf, len, "%lu %llu\n",
+				     devfreq->freq_table[i],
+				     jiffies64_to_msecs(p_data->mem_stall_time[i]));
+	mutex_unlock(&devfreq->lock);
+
+	return len;
+}
+static DEVICE_ATTR_RO(mem_stall_time_in_state);
+
+static struct attribute *mem_stall_attrs[] = {
+	&dev_attr_mem_stall_mode.attr,
+	&dev_attr_mem_stall_full_pct.attr,
+	&dev_attr_mem_stall_vote.attr,
+	&dev_attr_mem_stall_time_in_state.attr,
+	NULL,
+};
+
+static const struct attribute_group mem_stall_attr_group = {
+	.attrs = mem_stall_attrs,
+};
+
+static int mem_stall_start(struct devfreq *devfreq)
+{
+	struct devfreq_passive_data *p_data = devfreq->data;
+	int ret;
+
+	if (!p_data->mem_stall_full_pct)
+		p_data->mem_stall_full_pct = MEM_STALL_FULL_PCT;
+	p_data->mem_stall_last = get_jiffies_64();
+	p_data->mem_stall_time = kcalloc(devfreq->max_state,
+					 sizeof(*p_data->mem_stall_time),
+					 GFP_KERNEL);
+	if (!p_data->mem_stall_time)
+		return -ENOMEM;
+
+	ret = sysfs_create_group(&devfreq->dev.kobj, &mem_stall_attr_group);
+	if (ret) {
+		kfree(p_data->mem_stall_time);
+		p_data->mem_stall_time = NULL;
+		return ret;
+	}
+
+	mutex_lock(&mem_stall_lock);
+	list_add_tail(&p_data->mem_stall_node, &mem_stall_list);
+	mutex_unlock(&mem_stall_lock);
+
+	return 0;
+}
+
+static void mem_stall_stop(struct devfreq *devfreq)
+{
+	struct devfreq_passive_data *p_data = devfreq->data;
+
+	if (!p_data->mem_stall_time)
+		return;
+
+	mutex_lock(&mem_stall_lock);
+	list_del(&p_data->mem_stall_node);
+	mutex_unlock(&mem_stall_lock);
+
+	sysfs_remove_group(&devfreq->dev.kobj, &mem_stall_attr_group);
+
+	mutex_lock(&devfreq->lock);
+	kfree(p_data->mem_stall_time);
+	p_data->mem_stall_time = NULL;
+	mutex_unlock(&devfreq->lock);
+}
+
 static int devfreq_passive_event_handler(struct devfreq *devfreq,
 				unsigned int event, void *data)
 {
@@ -406,14 +662,22 @@ static int devfreq_passive_event_handler(struct devfreq *devfreq,
 	case DEVFREQ_GOV_START:
 		if (p_data->parent_type == DEVFREQ_PARENT_DEV)
 			ret = devfreq_passive_register_notifier(devfreq);
-		else if (p_data->parent_type == CPUFREQ_PARENT_DEV)
+		else if (p_data->parent_type == CPUFREQ_PARENT_DEV) {
+			ret = mem_stall_start(devfreq);
+			if (ret)
+				break;
 			ret = cpufreq_passive_register_notifier(devfreq);
+			if (ret)
+				mem_stall_stop(devfreq);
+		}
 		break;
 	case DEVFREQ_GOV_STOP:
-		if (p_data->parent_type == DEVFREQ_PARENT_DEV)
+		if (p_data->parent_type == DEVFREQ_PARENT_DEV) {
 			WARN_ON(devfreq_passive_unregister_notifier(devfreq));
-		else if (p_data->parent_type == CPUFREQ_PARENT_DEV)
+		} else if (p_data->parent_type == CPUFREQ_PARENT_DEV) {
 			WARN_ON(cpufreq_passive_unregister_notifier(devfreq));
+			mem_stall_stop(devfreq);
+		}
 		break;
 	default:
 		break;
@@ -442,6 +706,9 @@ static void __exit devfreq_passive_exit(void)
 	ret = devfreq_remove_governor(&devfreq_passive);
 	if (ret)
 		pr_err("%s: failed remove governor %d\n", __func__, ret);
+
+	irq_work_sync(&mem_stall_irq_work);
+	cancel_work_sync(&mem_stall_work);
 }
 module_exit(devfreq_passive_exit);
 
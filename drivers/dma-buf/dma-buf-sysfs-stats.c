@@ -7,12 +7,19 @@
 
 #include <linux/dma-buf.h>
 #include <linux/dma-resv.h>
+#include <linux/hashtable.h>
+#include <linux/kernfs.h>
 #include <linux/kobject.h>
+#include <linux/moduleparam.h>
 #include <linux/printk.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/stringhash.h>
 #include <linux/sysfs.h>
 #include <linux/workqueue.h>
 
+#include <uapi/linux/dma-buf.h>
+
 #include "dma-buf-sysfs-stats.h"
 
 #define to_dma_buf_entry_from_kobj(x) container_of(x, struct dma_buf_sysfs_entry, kobj)
@@ -49,7 +56,220 @@
  *
  * Detailed documentation about the interface is present in
  * Documentation/ABI/testing/sysfs-kernel-dmabuf-buffers.
+ *
+ * Creating a kobject for every buffer is expensive on workloads that export
+ * thousands of buffers per second, so it can be turned off by booting with
+ * ``dma_buf_sysfs_stats.per_buffer_stats=0``. Either way the buffers are
+ * summed per exporter and per exporting process, and that summary can be
+ * read as a single binary snapshot, taken when the file is opened, from
+ * ``/sys/kernel/dmabuf/stats``, see
+ * &struct dma_buf_stats_header.
+ */
+
+static bool per_buffer_stats = true;
+module_param(per_buffer_stats, bool, 0444);
+
+/*
+ * An exporter bucket has a @name and lives forever; a process bucket has a
+ * @tgid and goes away with its last buffer.
+ */
+struct dma_buf_stats_bucket {
+	struct hlist_node node;
+	pid_t tgid;
+	u64 count;
+	u64 size;
+	const char *name;
+	char name_buf[];
+};
+
+static DEFINE_HASHTABLE(dma_buf_stats_buckets, 7);
+static DEFINE_SPINLOCK(dma_buf_stats_lock);
+static unsigned int dma_buf_stats_nr_exporters;
+static unsigned int dma_buf_stats_nr_processes;
+
+static unsigned long dma_buf_stats_key(const char *name, pid_t tgid)
+{
+	return name ? full_name_hash(NULL, name, strlen(name)) : tgid;
+}
+
+static struct dma_buf_stats_bucket *
+dma_buf_stats_find_locked(const char *name, pid_t tgid, unsigned long key)
+{
+	struct dma_buf_stats_bucket *b;
+
+	hash_for_each_possible(dma_buf_stats_buckets, b, node, key) {
+		if (name ? b->name && !strcmp(b->name, name) :
+			   !b->name && b->tgid == tgid)
+			return b;
+	}
+	return NULL;
+}
+
+/* Find or create the bucket for @name or @tgid and account @size to it */
+static struct dma_buf_stats_bucket *dma_buf_stats_get(const char *name,
+						      pid_t tgid, size_t size)
+{
+	unsigned long key = dma_buf_stats_key(name, tgid);
+	struct dma_buf_stats_bucket *b, *new = NULL;
+
+	spin_lock(&dma_buf_stats_lock);
+	b = dma_buf_stats_find_locked(name, tgid, key);
+	if (!b) {
+		spin_unlock(&dma_buf_stats_lock);
+		new = kzalloc(struct_size(new, name_buf,
+					  name ? strlen(name) + 1 : 0),
+			      GFP_KERNEL);
+		if (!new)
+			return NULL;
+		new->tgid = tgid;
+		if (name) {
+			strcpy(new->name_buf, name);
+			new->name = new->name_buf;
+		}
+
+		spin_lock(&dma_buf_stats_lock);
+		b = dma_buf_stats_find_locked(name, tgid, key);
+		if (!b) {
+			b = new;
+			new = NULL;
+			hash_add(dma_buf_stats_buckets, &b->node, key);
+			if (name)
+				dma_buf_stats_nr_exporters++;
+			else
+				dma_buf_stats_nr_processes++;
+		}
+	}
+	b->count++;
+	b->size += size;
+	spin_unlock(&dma_buf_stats_lock);
+
+	kfree(new);
+	return b;
+}
+
+static void dma_buf_stats_put(struct dma_buf_stats_bucket *b, size_t size)
+{
+	bool free = false;
+
+	if (!b)
+		return;
+
+	spin_lock(&dma_buf_stats_lock);
+	b->count--;
+	b->size -= size;
+	if (!b->count && !b->name) {
+		hash_del(&b->node);
+		dma_buf_stats_nr_processes--;
+		free = true;
+	}
+	spin_unlock(&dma_buf_stats_lock);
+
+	if (free)
+		kfree(b);
+}
+
+static void dma_buf_stats_unaccount(struct dma_buf_sysfs_entry *sysfs_entry)
+{
+	dma_buf_stats_put(sysfs_entry->exporter, sysfs_entry->size);
+	dma_buf_stats_put(sysfs_entry->process, sysfs_entry->size);
+}
+
+static size_t dma_buf_stats_snapshot_size(const struct dma_buf_stats_header *hdr)
+{
+	return sizeof(*hdr) +
+	       hdr->nr_exporters * sizeof(struct dma_buf_stats_exporter) +
+	       hdr->nr_processes * sizeof(struct dma_buf_stats_process);
+}
+
+static struct dma_buf_stats_header *dma_buf_stats_snapshot(void)
+{
+	struct dma_buf_stats_exporter *exp;
+	struct dma_buf_stats_process *proc;
+	struct dma_buf_stats_header *hdr;
+	struct dma_buf_stats_bucket *b;
+	unsigned int nr_exp, nr_proc;
+	size_t size;
+	void *snap;
+	int bkt;
+
+	/*
+	 * Size the snapshot without the lock held and retry on the rare
+	 * occasion more buckets appeared meanwhile.
+	 */
+	for (;;) {
+		nr_exp = READ_ONCE(dma_buf_stats_nr_exporters);
+		nr_proc = READ_ONCE(dma_buf_stats_nr_processes);
+		size = sizeof(*hdr) + nr_exp * sizeof(*exp) +
+		       nr_proc * sizeof(*proc);
+		snap = kvzalloc(size, GFP_KERNEL);
+		if (!snap)
+			return NULL;
+
+		spin_lock(&dma_buf_stats_lock);
+		if (dma_buf_stats_nr_exporters <= nr_exp &&
+		    dma_buf_stats_nr_processes <= nr_proc)
+			break;
+		spin_unlock(&dma_buf_stats_lock);
+		kvfree(snap);
+	}
+
+	hdr = snap;
+	exp = (void *)(hdr + 1);
+	proc = (void *)(exp + dma_buf_stats_nr_exporters);
+	hdr->magic = DMA_BUF_STATS_MAGIC;
+	hdr->version = DMA_BUF_STATS_VERSION;
+	hdr->nr_exporters = dma_buf_stats_nr_exporters;
+	hdr->nr_processes = dma_buf_stats_nr_processes;
+	hash_for_each(dma_buf_stats_buckets, bkt, b, node) {
+		if (b->name) {
+			strscpy(exp->name, b->name, sizeof(exp->name));
+			exp->count = b->count;
+			exp->size = b->size;
+			exp++;
+		} else {
+			proc->tgid = b->tgid;
+			proc->count = b->count;
+			proc->size = b->size;
+			proc++;
+		}
+	}
+	spin_unlock(&dma_buf_stats_lock);
+
+	return hdr;
+}
+
+/*
+ * The snapshot is taken once per open, so that reads at any offset return
+ * parts of the same snapshot. A bin_attribute has no open method, hence the
+ * kernfs file.
  */
+static int dma_buf_stats_dump_open(struct kernfs_open_file *of)
+{
+	of->priv = dma_buf_stats_snapshot();
+	return of->priv ? 0 : -ENOMEM;
+}
+
+static void dma_buf_stats_dump_release(struct kernfs_open_file *of)
+{
+	kvfree(of->priv);
+}
+
+static ssize_t dma_buf_stats_dump_read(struct kernfs_open_file *of, char *buf,
+				       size_t count, loff_t off)
+{
+	struct dma_buf_stats_header *hdr = of->priv;
+
+	return memory_read_from_buffer(buf, count, &off, hdr,
+				       dma_buf_stats_snapshot_size(hdr));
+}
+
+static const struct kernfs_ops dma_buf_stats_dump_kfops = {
+	.open		= dma_buf_stats_dump_open,
+	.release	= dma_buf_stats_dump_release,
+	.read		= dma_buf_stats_dump_read,
+};
+
+static struct kernfs_node *dma_buf_stats_dump_kn;
 
 struct dma_buf_stats_attribute {
 	struct attribute attr;
@@ -110,6 +330,7 @@ static void dma_buf_sysfs_release(struct kobject *kobj)
 	struct dma_buf_sysfs_entry *sysfs_entry;
 
 	sysfs_entry = to_dma_buf_entry_from_kobj(kobj);
+	dma_buf_stats_unaccount(sysfs_entry);
 	kfree(sysfs_entry);
 }
 
@@ -127,6 +348,12 @@ void dma_buf_stats_teardown(struct dma_buf *dmabuf)
 	if (!sysfs_entry)
 		return;
 
+	if (!per_buffer_stats) {
+		dma_buf_stats_unaccount(sysfs_entry);
+		kfree(sysfs_entry);
+		return;
+	}
+
 	kobject_del(&sysfs_entry->kobj);
 	kobject_put(&sysfs_entry->kobj);
 }
@@ -160,11 +387,23 @@ int dma_buf_init_sysfs_statistics(void)
 		return -ENOMEM;
 	}
 
+	dma_buf_stats_dump_kn = __kernfs_create_file(dma_buf_stats_kset->kobj.sd,
+						     "stats", 0444,
+						     GLOBAL_ROOT_UID,
+						     GLOBAL_ROOT_GID, 0,
+						     &dma_buf_stats_dump_kfops,
+						     NULL, NULL, NULL);
+	if (IS_ERR(dma_buf_stats_dump_kn)) {
+		pr_warn("failed to create the dma-buf stats dump\n");
+		dma_buf_stats_dump_kn = NULL;
+	}
+
 	return 0;
 }
 
 void dma_buf_uninit_sysfs_statistics(void)
 {
+	kernfs_remove(dma_buf_stats_dump_kn);
 	kset_unregister(dma_buf_per_buffer_stats_kset);
 	kset_unregister(dma_buf_stats_kset);
 }
@@ -200,6 +439,7 @@ static void sysfs_add_workfn(struct work_struct *work)
 		 * Free the sysfs_entry and reset the pointer so dma_buf_stats_teardown doesn't
 		 * attempt to operate on it.
 		 */
+		dma_buf_stats_unaccount(dmabuf->sysfs_entry);
 		kfree(dmabuf->sysfs_entry);
 		dmabuf->sysfs_entry = NULL;
 	}
@@ -220,8 +460,16 @@ int dma_buf_stats_setup(struct dma_buf *dmabuf, struct file *file)
 		return -ENOMEM;
 
 	sysfs_entry->dmabuf = dmabuf;
+	sysfs_entry->size = dmabuf->size;
+	sysfs_entry->exporter = dma_buf_stats_get(dmabuf->exp_name, 0,
+						  dmabuf->size);
+	sysfs_entry->process = dma_buf_stats_get(NULL, current->tgid,
+						 dmabuf->size);
 	dmabuf->sysfs_entry = sysfs_entry;
 
+	if (!per_buffer_stats)
+		return 0;
+
 	INIT_WORK(&dmabuf->sysfs_entry->sysfs_add_work, sysfs_add_workfn);
 	get_dma_buf(dmabuf); /* This reference will be dropped in sysfs_add_workfn. */
 	schedule_work(&dmabuf->sysfs_entry->sysfs_add_work);
@@ -71,30 +71,45 @@ static bool dma_fence_array_enable_signaling(struct dma_fence *fence)
 {
 	struct dma_fence_array *array = to_dma_fence_array(fence);
 	struct dma_fence_array_cb *cb = (void *)(&array[1]);
+	unsigned int ready = 0;
 	unsigned i;
 
+	/*
+	 * Fences that are already signaled are only counted, without taking
+	 * their lock or a reference on the array, and num_pending is updated
+	 * for all of them at once at the end. Until then num_pending can't
+	 * drop below the number of ready fences, so no callback can see it
+	 * reach zero early.
+	 */
 	for (i = 0; i < array->num_fences; ++i) {
+		struct dma_fence *f = array->fences[i];
+
 		cb[i].array = array;
-		/*
-		 * As we may report that the fence is signaled before all
-		 * callbacks are complete, we need to take an additional
-		 * reference count on the array so that we do not free it too
-		 * early. The core fence handling will only hold the reference
-		 * until we signal the array as complete (but that is now
-		 * insufficient).
-		 */
-		dma_fence_get(&array->base);
-		if (dma_fence_add_callback(array->fences[i], &cb[i].cb,
-					   dma_fence_array_cb_func)) {
-			int error = array->fences[i]->error;
-
-			dma_fence_array_set_pending_error(array, error);
+		if (!dma_fence_is_signaled(f)) {
+			/*
+			 * As we may report that the fence is signaled before
+			 * all callbacks are complete, we need to take an
+			 * additional reference count on the array so that we
+			 * do not free it too early. The core fence handling
+			 * will only hold the reference until we signal the
+			 * array as complete (but that is now insufficient).
+			 */
+			dma_fence_get(&array->base);
+			if (!dma_fence_add_callback(f, &cb[i].cb,
+						    dma_fence_array_cb_func))
+				continue;
 			dma_fence_put(&array->base);
-			if (atomic_dec_and_test(&array->num_pending)) {
-				dma_fence_array_clear_pending_error(array);
-				return false;
-			}
 		}
+
+		dma_fence_array_set_pending_error(array, f->error);
+		/* Enough for signal_on_any, or nothing left to look at */
+		if (++ready >= atomic_read(&array->num_pending))
+			break;
+	}
+
+	if (ready && atomic_sub_and_test(ready, &array->num_pending)) {
+		dma_fence_array_clear_pending_error(array);
+		return false;
 	}
 
 	return true;
@@ -111,6 +126,14 @@ static bool dma_fence_array_signaled(struct dma_fence *fence)
 	return true;
 }
 
+/* Fence storage of arrays from dma_fence_array_create_inline() */
+static struct dma_fence **dma_fence_array_inline(struct dma_fence_array *array)
+{
+	struct dma_fence_array_cb *cb = (void *)(&array[1]);
+
+	return (struct dma_fence **)&cb[array->num_fences];
+}
+
 static void dma_fence_array_release(struct dma_fence *fence)
 {
 	struct dma_fence_array *array = to_dma_fence_array(fence);
@@ -119,7 +142,8 @@ static void dma_fence_array_release(struct dma_fence *fence)
 	for (i = 0; i < array->num_fences; ++i)
 		dma_fence_put(array->fences[i]);
 
-	kfree(array->fences);
+	if (array->fences != dma_fence_array_inline(array))
+		kfree(array->fences);
 	dma_fence_free(fence);
 }
 
@@ -143,29 +167,10 @@ const struct dma_fence_ops dma_fence_array_ops = {
 };
 EXPORT_SYMBOL(dma_fence_array_ops);
 
-/**
- * dma_fence_array_create - Create a custom fence array
- * @num_fences:		[in]	number of fences to add in the array
- * @fences:		[in]	array containing the fences
- * @context:		[in]	fence context to use
- * @seqno:		[in]	sequence number to use
- * @signal_on_any:	[in]	signal on any fence in the array
- *
- * Allocate a dma_fence_array object and initialize the base fence with
- * dma_fence_init().
- * In case of error it returns NULL.
- *
- * The caller should allocate the fences array with num_fences size
- * and fill it with the fences it wants to add to the object. Ownership of this
- * array is taken and dma_fence_put() is used on each fence on release.
- *
- * If @signal_on_any is true the fence array signals if any fence in the array
- * signals, otherwise it signals when all fences in the array signal.
- */
-struct dma_fence_array *dma_fence_array_create(int num_fences,
-					       struct dma_fence **fences,
-					       u64 context, unsigned seqno,
-					       bool signal_on_any)
+static struct dma_fence_array *
+__dma_fence_array_create(int num_fences, struct dma_fence **fences,
+			 u64 context, unsigned seqno, bool signal_on_any,
+			 bool embed)
 {
 	struct dma_fence_array *array;
 	size_t size = sizeof(*array);
@@ -174,6 +179,9 @@ struct dma_fence_array *dma_fence_array_create(int num_fences,
 
 	/* Allocate the callback structures behind the array. */
 	size += num_fences * sizeof(struct dma_fence_array_cb);
+	/* ... followed by the fence pointers when embedding them */
+	if (embed)
+		size += num_fences * sizeof(*fences);
 	array = kzalloc(size, GFP_KERNEL);
 	if (!array)
 		return NULL;
@@ -185,7 +193,13 @@ struct dma_fence_array *dma_fence_array_create(int num_fences,
 
 	array->num_fences = num_fences;
 	atomic_set(&array->num_pending, signal_on_any ? 1 : num_fences);
-	array->fences = fences;
+	if (embed) {
+		array->fences = dma_fence_array_inline(array);
+		memcpy(array->fences, fences, num_fences * sizeof(*fences));
+		fences = array->fences;
+	} else {
+		array->fences = fences;
+	}
 
 	array->base.error = PENDING_ERROR;
 
@@ -205,8 +219,61 @@ struct dma_fence_array *dma_fence_array_create(int num_fences,
 
 	return array;
 }
+
+/**
+ * dma_fence_array_create - Create a custom fence array
+ * @num_fences:		[in]	number of fences to add in the array
+ * @fences:		[in]	array containing the fences
+ * @context:		[in]	fence context to use
+ * @seqno:		[in]	sequence number to use
+ * @signal_on_any:	[in]	signal on any fence in the array
+ *
+ * Allocate a dma_fence_array object and initialize the base fence with
+ * dma_fence_init().
+ * In case of error it returns NULL.
+ *
+ * The caller should allocate the fences array with num_fences size
+ * and fill it with the fences it wants to add to the object. Ownership of this
+ * array is taken and dma_fence_put() is used on each fence on release.
+ *
+ * If @signal_on_any is true the fence array signals if any fence in the array
+ * signals, otherwise it signals when all fences in the array signal.
+ */
+struct dma_fence_array *dma_fence_array_create(int num_fences,
+					       struct dma_fence **fences,
+					       u64 context, unsigned seqno,
+					       bool signal_on_any)
+{
+	return __dma_fence_array_create(num_fences, fences, context, seqno,
+					signal_on_any, false);
+}
 EXPORT_SYMBOL(dma_fence_array_create);
 
+/**
+ * dma_fence_array_create_inline - Create a fence array with embedded storage
+ * @num_fences:		[in]	number of fences to add in the array
+ * @fences:		[in]	array containing the fences
+ * @context:		[in]	fence context to use
+ * @seqno:		[in]	sequence number to use
+ * @signal_on_any:	[in]	signal on any fence in the array
+ *
+ * Same as dma_fence_array_create(), except that the fence pointers are copied
+ * into storage allocated together with the array object. The references to
+ * the fences are still taken over, but @fences itself stays with the caller
+ * and may live on the stack. Meant for small arrays, where this saves an
+ * allocation per array.
+ */
+struct dma_fence_array *dma_fence_array_create_inline(int num_fences,
+						      struct dma_fence **fences,
+						      u64 context,
+						      unsigned seqno,
+						      bool signal_on_any)
+{
+	return __dma_fence_array_create(num_fences, fences, context, seqno,
+					signal_on_any, true);
+}
+EXPORT_SYMBOL(dma_fence_array_create_inline);
+
 /**
  * dma_fence_match_context - Check if all fences are from the given context
  * @fence:		[in]	fence or fence array
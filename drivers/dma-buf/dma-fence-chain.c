@@ -51,10 +51,16 @@ struct dma_fence *dma_fence_chain_walk(struct dma_fence *fence)
 
 		prev_chain = to_dma_fence_chain(prev);
 		if (prev_chain) {
-			if (!dma_fence_is_signaled(prev_chain->fence))
+			/*
+			 * A signaled chain node implies that everything before
+			 * it is complete as well, so drop the whole tail.
+			 */
+			if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &prev->flags))
+				replacement = NULL;
+			else if (!dma_fence_is_signaled(prev_chain->fence))
 				break;
-
-			replacement = dma_fence_chain_get_prev(prev_chain);
+			else
+				replacement = dma_fence_chain_get_prev(prev_chain);
 		} else {
 			if (!dma_fence_is_signaled(prev))
 				break;
@@ -119,16 +125,48 @@ static const char *dma_fence_chain_get_timeline_name(struct dma_fence *fence)
         return "unbound";
 }
 
+/*
+ * Signal the chain nodes from @prev backwards, which the caller knows to be
+ * complete, in one pass instead of waiting for each of them to get through
+ * its own callback and irq_work. Stops at the first node that is already
+ * signaled, as everything before that one is taken care of. Consumes the
+ * reference to @prev.
+ */
+static void dma_fence_chain_signal_prev(struct dma_fence *prev)
+{
+	struct dma_fence_chain *chain;
+	struct dma_fence *tmp;
+
+	while ((chain = to_dma_fence_chain(prev))) {
+		if (test_bit(DMA_FENCE_FLAG_SIGNALED_BIT, &prev->flags))
+			break;
+
+		dma_fence_signal(prev);
+		tmp = dma_fence_chain_get_prev(chain);
+		dma_fence_put(prev);
+		prev = tmp;
+	}
+	dma_fence_put(prev);
+}
+
 static void dma_fence_chain_irq_work(struct irq_work *work)
 {
 	struct dma_fence_chain *chain;
+	struct dma_fence *prev;
 
 	chain = container_of(work, typeof(*chain), work);
 
+	/* Rearming prunes our link to the previous nodes, so grab it first */
+	prev = dma_fence_chain_get_prev(chain);
+
 	/* Try to rearm the callback */
-	if (!dma_fence_chain_enable_signaling(&chain->base))
+	if (!dma_fence_chain_enable_signaling(&chain->base)) {
 		/* Ok, we are done. No more unsignaled fences left */
 		dma_fence_signal(&chain->base);
+		dma_fence_chain_signal_prev(prev);
+	} else {
+		dma_fence_put(prev);
+	}
 	dma_fence_put(&chain->base);
 }
 
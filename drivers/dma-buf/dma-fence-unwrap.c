@@ -64,6 +64,7 @@ struct dma_fence *__dma_fence_unwrap_merge(unsigned int num_fences,
 					   struct dma_fence **fences,
 					   struct dma_fence_unwrap *iter)
 {
+	struct dma_fence *inline_array[DMA_FENCE_UNWRAP_INLINE];
 	struct dma_fence_array *result;
 	struct dma_fence *tmp, **array;
 	ktime_t timestamp;
@@ -92,9 +93,13 @@ struct dma_fence *__dma_fence_unwrap_merge(unsigned int num_fences,
 	if (count == 0)
 		return dma_fence_allocate_private_stub(timestamp);
 
-	array = kmalloc_array(count, sizeof(*array), GFP_KERNEL);
-	if (!array)
-		return NULL;
+	if (count <= ARRAY_SIZE(inline_array)) {
+		array = inline_array;
+	} else {
+		array = kmalloc_array(count, sizeof(*array), GFP_KERNEL);
+		if (!array)
+			return NULL;
+	}
 
 	/*
 	 * This trashes the input fence array and uses it as position for the
@@ -160,9 +165,22 @@ struct dma_fence *__dma_fence_unwrap_merge(unsigned int num_fences,
 		goto return_tmp;
 	}
 
-	result = dma_fence_array_create(count, array,
-					dma_fence_context_alloc(1),
-					1, false);
+	/*
+	 * Small results keep the fence pointers in the array object itself, even
+	 * when the pessimistic count above made us allocate the scratch array.
+	 */
+	if (count <= DMA_FENCE_UNWRAP_INLINE) {
+		result = dma_fence_array_create_inline(count, array,
+						       dma_fence_context_alloc(1),
+						       1, false);
+		if (array != inline_array)
+			kfree(array);
+		array = inline_array;
+	} else {
+		result = dma_fence_array_create(count, array,
+						dma_fence_context_alloc(1),
+						1, false);
+	}
 	if (!result) {
 		tmp = NULL;
 		goto return_tmp;
@@ -170,7 +188,8 @@ struct dma_fence *__dma_fence_unwrap_merge(unsigned int num_fences,
 	return &result->base;
 
 return_tmp:
-	kfree(array);
+	if (array != inline_array)
+		kfree(array);
 	return tmp;
 }
 EXPORT_SYMBOL_GPL(__dma_fence_unwrap_merge);
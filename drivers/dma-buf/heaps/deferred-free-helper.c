@@ -9,17 +9,28 @@
  */
 
 #include <linux/freezer.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/swap.h>
 #include <linux/sched/signal.h>
 
 #include "deferred-free-helper.h"
 
+/*
+ * Items are drained in batches of up to DF_BATCH_PAGES, so the list lock is
+ * taken once per batch rather than once per buffer. One more worker joins
+ * in for every DF_WORKER_PAGES of backlog, up to DF_MAX_WORKERS.
+ */
+#define DF_BATCH_PAGES		(SZ_4M >> PAGE_SHIFT)
+#define DF_WORKER_PAGES		(SZ_64M >> PAGE_SHIFT)
+#define DF_MAX_WORKERS		4
+
 static LIST_HEAD(free_list);
 static size_t list_nr_pages;
 wait_queue_head_t freelist_waitqueue;
-struct task_struct *freelist_task;
+static struct task_struct *freelist_task[DF_MAX_WORKERS];
 static DEFINE_SPINLOCK(free_list_lock);
 
 void deferred_free(struct deferred_freelist_item *item,
@@ -41,27 +52,39 @@ void deferred_free(struct deferred_freelist_item *item,
 }
 EXPORT_SYMBOL_GPL(deferred_free);
 
-static size_t free_one_item(enum df_reason reason)
+/*
+ * Detach the oldest items, at least one and about @max_pages worth, onto
+ * @batch. Returns the number of pages detached.
+ */
+static size_t take_batch(struct list_head *batch, size_t max_pages)
 {
-	unsigned long flags;
-	size_t nr_pages;
 	struct deferred_freelist_item *item;
+	unsigned long flags;
+	size_t nr_pages = 0;
 
 	spin_lock_irqsave(&free_list_lock, flags);
-	if (list_empty(&free_list)) {
-		spin_unlock_irqrestore(&free_list_lock, flags);
-		return 0;
+	while (nr_pages < max_pages && !list_empty(&free_list)) {
+		item = list_last_entry(&free_list, struct deferred_freelist_item,
+				       list);
+		list_move_tail(&item->list, batch);
+		nr_pages += item->nr_pages;
 	}
-	item = list_first_entry(&free_list, struct deferred_freelist_item, list);
-	list_del(&item->list);
-	nr_pages = item->nr_pages;
 	list_nr_pages -= nr_pages;
 	spin_unlock_irqrestore(&free_list_lock, flags);
 
-	item->free(item, reason);
 	return nr_pages;
 }
 
+static void free_batch(struct list_head *batch, enum df_reason reason)
+{
+	struct deferred_freelist_item *item, *tmp;
+
+	list_for_each_entry_safe(item, tmp, batch, list) {
+		list_del(&item->list);
+		item->free(item, reason);
+	}
+}
+
 static unsigned long get_freelist_nr_pages(void)
 {
 	unsigned long nr_pages;
@@ -79,24 +102,23 @@ static unsigned long freelist_shrink_count(struct shrinker *shrinker,
 	return get_freelist_nr_pages();
 }
 
+/*
+ * Under pressure, detach everything the shrinker asked for in one go and
+ * hand it straight back to the buddy allocator instead of the page pools.
+ */
 static unsigned long freelist_shrink_scan(struct shrinker *shrinker,
 					  struct shrink_control *sc)
 {
-	unsigned long total_freed = 0;
+	LIST_HEAD(batch);
+	unsigned long total_freed;
 
 	if (sc->nr_to_scan == 0)
 		return 0;
 
-	while (total_freed < sc->nr_to_scan) {
-		size_t pages_freed = free_one_item(DF_UNDER_PRESSURE);
-
-		if (!pages_freed)
-			break;
-
-		total_freed += pages_freed;
-	}
+	total_freed = take_batch(&batch, sc->nr_to_scan);
+	free_batch(&batch, DF_UNDER_PRESSURE);
 
-	return total_freed;
+	return total_freed ? total_freed : SHRINK_STOP;
 }
 
 static struct shrinker freelist_shrinker = {
@@ -106,13 +128,24 @@ static struct shrinker freelist_shrinker = {
 	.batch = 0,
 };
 
+/*
+ * Worker @data only runs while the backlog exceeds @data * DF_WORKER_PAGES,
+ * so a large burst of frees is drained in parallel while the common case
+ * keeps a single worker.
+ */
 static int deferred_free_thread(void *data)
 {
+	size_t threshold = (unsigned long)data * DF_WORKER_PAGES;
+
 	while (true) {
+		LIST_HEAD(batch);
+
 		wait_event_freezable(freelist_waitqueue,
-				     get_freelist_nr_pages() > 0);
+				     get_freelist_nr_pages() > threshold);
 
-		free_one_item(DF_NORMAL);
+		if (take_batch(&batch, DF_BATCH_PAGES))
+			free_batch(&batch, DF_NORMAL);
+		cond_resched();
 	}
 
 	return 0;
@@ -120,16 +153,26 @@ static int deferred_free_thread(void *data)
 
 static int deferred_freelist_init(void)
 {
+	int nr_workers = min_t(int, num_possible_cpus(), DF_MAX_WORKERS);
+	int i;
+
 	list_nr_pages = 0;
 
 	init_waitqueue_head(&freelist_waitqueue);
-	freelist_task = kthread_run(deferred_free_thread, NULL,
-				    "%s", "dmabuf-deferred-free-worker");
-	if (IS_ERR(freelist_task)) {
-		pr_err("Creating thread for deferred free failed\n");
-		return -1;
+	for (i = 0; i < nr_workers; i++) {
+		freelist_task[i] = kthread_run(deferred_free_thread,
+					       (void *)(unsigned long)i,
+					       "dmabuf-deferred-free-worker/%d",
+					       i);
+		if (IS_ERR(freelist_task[i])) {
+			freelist_task[i] = NULL;
+			if (i)
+				break;
+			pr_err("Creating thread for deferred free failed\n");
+			return -1;
+		}
+		sched_set_normal(freelist_task[i], 19);
 	}
-	sched_set_normal(freelist_task, 19);
 
 	return register_shrinker(&freelist_shrinker, "dmabuf-deferred-free-shrinker");
 }
@@ -44,6 +44,9 @@ struct deferred_freelist_item {
 /**
  * deferred_free - call to add item to the deferred free list
  *
+ * Items are freed oldest first, in batches, by background workers with
+ * DF_NORMAL, or by the shrinker with DF_UNDER_PRESSURE.
+ *
  * @item: Pointer to deferred_freelist_item field of a structure
  * @free: Function pointer to the free call
  * @nr_pages: number of pages to be freed
@@ -10,10 +10,17 @@
 
 #include "page_pool.h"
 
+#include <linux/freezer.h>
+#include <linux/kobject.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/shrinker.h>
+#include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/swap.h>
+#include <linux/sizes.h>
+#include <linux/sysfs.h>
 #include <linux/sched/signal.h>
 
 /* page types we track in the pool */
@@ -24,6 +31,35 @@ enum {
 	POOL_TYPE_SIZE,
 };
 
+/*
+ * Per-cpu magazine sizing: at most POOL_PCP_MAX entries and POOL_PCP_BYTES
+ * of memory per cpu and pool, moved to and from the shared lists in batches
+ * of half a magazine.
+ */
+#define POOL_PCP_MAX		64
+#define POOL_PCP_BYTES		SZ_1M
+
+/**
+ * struct dmabuf_page_pool_pcp - per-cpu magazine in front of a pool
+ * @lock:		protects the magazine; only contended when the
+ *			shrinker drains it from another cpu
+ * @nr:			number of pages in @pages
+ * @pages:		cached pages, most recently freed last
+ * @alloc_hit:		allocations served from the magazine
+ * @alloc_miss:		allocations that found the magazine empty
+ * @free_hit:		frees that fit into the magazine
+ * @free_miss:		frees that found the magazine full
+ */
+struct dmabuf_page_pool_pcp {
+	spinlock_t lock;
+	unsigned int nr;
+	struct page *pages[POOL_PCP_MAX];
+	unsigned long alloc_hit;
+	unsigned long alloc_miss;
+	unsigned long free_hit;
+	unsigned long free_miss;
+};
+
 /**
  * struct dmabuf_page_pool - pagepool struct
  * @count[]:		array of number of pages of that type in the pool
@@ -32,6 +68,13 @@ enum {
  *			item list
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
+ * @low_wm:		wake the refill worker once the pool holds fewer
+ *			than this many order @order pages
+ * @high_wm:		number of order @order pages the refill worker
+ *			fills the pool up to
+ * @pcp:		per-cpu magazines, NULL when @pcp_high is 0
+ * @pcp_high:		capacity of each magazine
+ * @pcp_batch:		pages moved between a magazine and @items at once
  * @list:		list node for list of pools
  *
  * Allows you to keep a pool of pre allocated pages to use
@@ -42,11 +85,37 @@ struct dmabuf_page_pool {
 	spinlock_t lock;
 	gfp_t gfp_mask;
 	unsigned int order;
+	unsigned int low_wm;
+	unsigned int high_wm;
+	struct dmabuf_page_pool_pcp __percpu *pcp;
+	unsigned int pcp_high;
+	unsigned int pcp_batch;
 	struct list_head list;
 };
 
+/*
+ * pool_list is modified with both pool_refill_lock and pool_list_lock held.
+ * The refill worker walks it under pool_refill_lock alone so that it can
+ * enter direct reclaim, and thus our own shrinker, while allocating.
+ */
 static LIST_HEAD(pool_list);
 static DEFINE_MUTEX(pool_list_lock);
+static DEFINE_MUTEX(pool_refill_lock);
+
+/* Per-order watermarks, applied to every pool of that order */
+static unsigned int pool_low_wm[MAX_ORDER + 1];
+static unsigned int pool_high_wm[MAX_ORDER + 1];
+static struct kobject *pool_kobj;
+static struct kobject *pool_order_kobj[MAX_ORDER + 1];
+
+/* Back off refilling for a while after the shrinker took pages from us */
+#define POOL_REFILL_BACKOFF	HZ
+static unsigned long pool_shrink_stamp = INITIAL_JIFFIES - POOL_REFILL_BACKOFF;
+
+static DECLARE_WAIT_QUEUE_HEAD(pool_refill_wait);
+static atomic_t pool_refill_pending = ATOMIC_INIT(0);
+static struct task_struct *pool_refill_task;
+static const struct attribute_group pool_order_group;
 
 static inline
 struct page *dmabuf_page_pool_alloc_pages(struct dmabuf_page_pool *pool)
@@ -98,14 +167,172 @@ static struct page *dmabuf_page_pool_remove(struct dmabuf_page_pool *pool, int i
 	return page;
 }
 
-static struct page *dmabuf_page_pool_fetch(struct dmabuf_page_pool *pool)
+/* Move the @nr oldest pages of a magazine to the shared lists */
+static void dmabuf_page_pool_pcp_flush(struct dmabuf_page_pool *pool,
+				       struct dmabuf_page_pool_pcp *pcp,
+				       unsigned int nr)
+{
+	unsigned int i;
+
+	nr = min(nr, pcp->nr);
+	if (!nr)
+		return;
+
+	spin_lock(&pool->lock);
+	for (i = 0; i < nr; i++) {
+		struct page *page = pcp->pages[i];
+		int index = PageHighMem(page) ? POOL_HIGHPAGE : POOL_LOWPAGE;
+
+		list_add_tail(&page->lru, &pool->items[index]);
+		pool->count[index]++;
+	}
+	spin_unlock(&pool->lock);
+
+	pcp->nr -= nr;
+	memmove(pcp->pages, pcp->pages + nr, pcp->nr * sizeof(pcp->pages[0]));
+}
+
+/* Move up to @nr pages from the shared lists into an empty magazine */
+static void dmabuf_page_pool_pcp_fill(struct dmabuf_page_pool *pool,
+				      struct dmabuf_page_pool_pcp *pcp,
+				      unsigned int nr)
+{
+	int index;
+
+	spin_lock(&pool->lock);
+	for (index = POOL_HIGHPAGE; index >= POOL_LOWPAGE; index--) {
+		while (pcp->nr < nr) {
+			struct page *page;
+
+			page = list_first_entry_or_null(&pool->items[index],
+							struct page, lru);
+			if (!page)
+				break;
+			list_del(&page->lru);
+			pool->count[index]--;
+			pcp->pages[pcp->nr++] = page;
+		}
+	}
+	spin_unlock(&pool->lock);
+}
+
+/*
+ * The magazine lookups below don't disable preemption: should we migrate
+ * after picking a magazine we merely use another cpu's, which its lock
+ * makes safe.
+ */
+static bool dmabuf_page_pool_pcp_add(struct dmabuf_page_pool *pool,
+				     struct page *page)
+{
+	struct dmabuf_page_pool_pcp *pcp;
+
+	if (!pool->pcp)
+		return false;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->nr == pool->pcp_high) {
+		pcp->free_miss++;
+		dmabuf_page_pool_pcp_flush(pool, pcp, pool->pcp_batch);
+	} else {
+		pcp->free_hit++;
+	}
+	pcp->pages[pcp->nr++] = page;
+	spin_unlock(&pcp->lock);
+
+	mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
+			    1 << pool->order);
+	return true;
+}
+
+static struct page *dmabuf_page_pool_pcp_remove(struct dmabuf_page_pool *pool)
 {
+	struct dmabuf_page_pool_pcp *pcp;
 	struct page *page = NULL;
 
-	page = dmabuf_page_pool_remove(pool, POOL_HIGHPAGE);
+	if (!pool->pcp)
+		return NULL;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->nr) {
+		pcp->alloc_hit++;
+	} else {
+		pcp->alloc_miss++;
+		dmabuf_page_pool_pcp_fill(pool, pcp, pool->pcp_batch);
+	}
+	if (pcp->nr)
+		page = pcp->pages[--pcp->nr];
+	spin_unlock(&pcp->lock);
+
+	if (page)
+		mod_node_page_state(page_pgdat(page), NR_KERNEL_MISC_RECLAIMABLE,
+				    -(1 << pool->order));
+	return page;
+}
+
+/* Hand every magazine's pages back to the shared lists */
+static void dmabuf_page_pool_pcp_drain(struct dmabuf_page_pool *pool)
+{
+	int cpu;
+
+	if (!pool->pcp)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct dmabuf_page_pool_pcp *pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		dmabuf_page_pool_pcp_flush(pool, pcp, pcp->nr);
+		spin_unlock(&pcp->lock);
+	}
+}
+
+/* Racy snapshot of the number of pages held in the magazines */
+static unsigned int dmabuf_page_pool_pcp_count(struct dmabuf_page_pool *pool)
+{
+	unsigned int nr = 0;
+	int cpu;
+
+	if (!pool->pcp)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		nr += READ_ONCE(per_cpu_ptr(pool->pcp, cpu)->nr);
+	return nr;
+}
+
+/*
+ * Racy snapshot of the number of order pool->order pages in the shared
+ * lists. The magazines are left out; they hold too little to matter for the
+ * watermarks and are expensive to sum on every allocation.
+ */
+static unsigned int dmabuf_page_pool_nr_items(struct dmabuf_page_pool *pool)
+{
+	return READ_ONCE(pool->count[POOL_LOWPAGE]) +
+	       READ_ONCE(pool->count[POOL_HIGHPAGE]);
+}
+
+static void dmabuf_page_pool_wake_refill(void)
+{
+	if (!atomic_read(&pool_refill_pending) &&
+	    !atomic_xchg(&pool_refill_pending, 1))
+		wake_up(&pool_refill_wait);
+}
+
+static struct page *dmabuf_page_pool_fetch(struct dmabuf_page_pool *pool)
+{
+	struct page *page;
+
+	page = dmabuf_page_pool_pcp_remove(pool);
+	if (!page)
+		page = dmabuf_page_pool_remove(pool, POOL_HIGHPAGE);
 	if (!page)
 		page = dmabuf_page_pool_remove(pool, POOL_LOWPAGE);
 
+	if (dmabuf_page_pool_nr_items(pool) < READ_ONCE(pool->low_wm))
+		dmabuf_page_pool_wake_refill();
+
 	return page;
 }
 
@@ -129,7 +356,8 @@ void dmabuf_page_pool_free(struct dmabuf_page_pool *pool, struct page *page)
 	if (WARN_ON(pool->order != compound_order(page)))
 		return;
 
-	dmabuf_page_pool_add(pool, page);
+	if (!dmabuf_page_pool_pcp_add(pool, page))
+		dmabuf_page_pool_add(pool, page);
 }
 EXPORT_SYMBOL_GPL(dmabuf_page_pool_free);
 
@@ -146,11 +374,25 @@ static int dmabuf_page_pool_total(struct dmabuf_page_pool *pool, bool high)
 struct dmabuf_page_pool *dmabuf_page_pool_create(gfp_t gfp_mask, unsigned int order)
 {
 	struct dmabuf_page_pool *pool = kmalloc(sizeof(*pool), GFP_KERNEL);
-	int i;
+	int i, cpu;
 
 	if (!pool)
 		return NULL;
 
+	pool->pcp_high = min_t(unsigned int, POOL_PCP_MAX,
+			       POOL_PCP_BYTES >> (PAGE_SHIFT + order));
+	pool->pcp_batch = max(pool->pcp_high / 2, 1U);
+	pool->pcp = NULL;
+	if (pool->pcp_high > 1) {
+		pool->pcp = alloc_percpu(struct dmabuf_page_pool_pcp);
+		if (!pool->pcp) {
+			kfree(pool);
+			return NULL;
+		}
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(pool->pcp, cpu)->lock);
+	}
+
 	for (i = 0; i < POOL_TYPE_SIZE; i++) {
 		pool->count[i] = 0;
 		INIT_LIST_HEAD(&pool->items[i]);
@@ -159,9 +401,26 @@ struct dmabuf_page_pool *dmabuf_page_pool_create(gfp_t gfp_mask, unsigned int or
 	pool->order = order;
 	spin_lock_init(&pool->lock);
 
+	mutex_lock(&pool_refill_lock);
+	if (pool_kobj && !pool_order_kobj[order]) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "order-%u", order);
+		pool_order_kobj[order] = kobject_create_and_add(name, pool_kobj);
+		if (!pool_order_kobj[order] ||
+		    sysfs_create_group(pool_order_kobj[order], &pool_order_group))
+			pr_warn("dmabuf page pool: no sysfs for order %u\n", order);
+	}
+	pool->low_wm = pool_low_wm[order];
+	pool->high_wm = pool_high_wm[order];
+
 	mutex_lock(&pool_list_lock);
 	list_add(&pool->list, &pool_list);
 	mutex_unlock(&pool_list_lock);
+	mutex_unlock(&pool_refill_lock);
+
+	if (pool->low_wm)
+		dmabuf_page_pool_wake_refill();
 
 	return pool;
 }
@@ -173,16 +432,20 @@ void dmabuf_page_pool_destroy(struct dmabuf_page_pool *pool)
 	int i;
 
 	/* Remove us from the pool list */
+	mutex_lock(&pool_refill_lock);
 	mutex_lock(&pool_list_lock);
 	list_del(&pool->list);
 	mutex_unlock(&pool_list_lock);
+	mutex_unlock(&pool_refill_lock);
 
 	/* Free any remaining pages in the pool */
+	dmabuf_page_pool_pcp_drain(pool);
 	for (i = 0; i < POOL_TYPE_SIZE; i++) {
 		while ((page = dmabuf_page_pool_remove(pool, i)))
 			dmabuf_page_pool_free_pages(pool, page);
 	}
 
+	free_percpu(pool->pcp);
 	kfree(pool);
 }
 EXPORT_SYMBOL_GPL(dmabuf_page_pool_destroy);
@@ -196,6 +459,7 @@ unsigned long dmabuf_page_pool_get_size(struct dmabuf_page_pool *pool)
        for (i = 0; i < POOL_TYPE_SIZE; ++i)
                num_pages += pool->count[i];
        spin_unlock(&pool->lock);
+       num_pages += dmabuf_page_pool_pcp_count(pool);
        num_pages <<= pool->order; /* pool order is immutable */
 
        return num_pages * PAGE_SIZE;
@@ -214,8 +478,10 @@ static int dmabuf_page_pool_do_shrink(struct dmabuf_page_pool *pool, gfp_t gfp_m
 		high = !!(gfp_mask & __GFP_HIGHMEM);
 
 	if (nr_to_scan == 0)
-		return dmabuf_page_pool_total(pool, high);
+		return dmabuf_page_pool_total(pool, high) +
+		       (dmabuf_page_pool_pcp_count(pool) << pool->order);
 
+	dmabuf_page_pool_pcp_drain(pool);
 	while (freed < nr_to_scan) {
 		struct page *page;
 
@@ -276,6 +542,7 @@ static unsigned long dmabuf_page_pool_shrink_scan(struct shrinker *shrinker,
 {
 	if (sc->nr_to_scan == 0)
 		return 0;
+	WRITE_ONCE(pool_shrink_stamp, jiffies);
 	return dmabuf_page_pool_shrink(sc->gfp_mask, sc->nr_to_scan);
 }
 
@@ -286,8 +553,231 @@ struct shrinker pool_shrinker = {
 	.batch = 0,
 };
 
+static bool dmabuf_page_pool_refill_backoff(void)
+{
+	return time_before(jiffies, READ_ONCE(pool_shrink_stamp) +
+				    POOL_REFILL_BACKOFF);
+}
+
+/*
+ * Top the pool up to its high watermark. Unlike the allocation path we are
+ * allowed to compact and reclaim here, which is the whole point: the cost of
+ * assembling high order pages is paid in the background instead of by the
+ * first large allocation after an idle period.
+ */
+static void dmabuf_page_pool_refill(struct dmabuf_page_pool *pool)
+{
+	gfp_t gfp = pool->gfp_mask | __GFP_DIRECT_RECLAIM | __GFP_NORETRY |
+		    __GFP_NOWARN;
+	struct page *page;
+
+	while (dmabuf_page_pool_nr_items(pool) < READ_ONCE(pool->high_wm)) {
+		if (kthread_should_stop() || dmabuf_page_pool_refill_backoff())
+			break;
+
+		page = alloc_pages(gfp, pool->order);
+		if (!page)
+			break;
+
+		dmabuf_page_pool_add(pool, page);
+		cond_resched();
+	}
+}
+
+static int dmabuf_page_pool_refill_thread(void *data)
+{
+	struct dmabuf_page_pool *pool;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(pool_refill_wait,
+				     atomic_read(&pool_refill_pending) ||
+				     kthread_should_stop());
+		atomic_set(&pool_refill_pending, 0);
+
+		if (dmabuf_page_pool_refill_backoff()) {
+			schedule_timeout_interruptible(POOL_REFILL_BACKOFF);
+			atomic_set(&pool_refill_pending, 1);
+			continue;
+		}
+
+		mutex_lock(&pool_refill_lock);
+		list_for_each_entry(pool, &pool_list, list)
+			dmabuf_page_pool_refill(pool);
+		mutex_unlock(&pool_refill_lock);
+	}
+
+	return 0;
+}
+
+static int pool_kobj_order(struct kobject *kobj)
+{
+	int order;
+
+	for (order = 0; order <= MAX_ORDER; order++)
+		if (pool_order_kobj[order] == kobj)
+			return order;
+	return -ENOENT;
+}
+
+static ssize_t pool_wm_show(struct kobject *kobj, char *buf,
+			    unsigned int *wm)
+{
+	int order = pool_kobj_order(kobj);
+
+	if (order < 0)
+		return order;
+	return sysfs_emit(buf, "%u\n", READ_ONCE(wm[order]));
+}
+
+static ssize_t pool_wm_store(struct kobject *kobj, const char *buf,
+			     size_t count, bool high)
+{
+	struct dmabuf_page_pool *pool;
+	int order = pool_kobj_order(kobj);
+	unsigned int val;
+	int ret;
+
+	if (order < 0)
+		return order;
+	ret = kstrtouint(buf, 0, &val);
+	if (ret)
+		return ret;
+
+	mutex_lock(&pool_refill_lock);
+	if (high) {
+		pool_high_wm[order] = val;
+		if (pool_low_wm[order] > val)
+			pool_low_wm[order] = val;
+	} else {
+		pool_low_wm[order] = val;
+		if (pool_high_wm[order] < val)
+			pool_high_wm[order] = val;
+	}
+	mutex_lock(&pool_list_lock);
+	list_for_each_entry(pool, &pool_list, list) {
+		if (pool->order != order)
+			continue;
+		WRITE_ONCE(pool->low_wm, pool_low_wm[order]);
+		WRITE_ONCE(pool->high_wm, pool_high_wm[order]);
+	}
+	mutex_unlock(&pool_list_lock);
+	mutex_unlock(&pool_refill_lock);
+
+	dmabuf_page_pool_wake_refill();
+	return count;
+}
+
+static ssize_t low_watermark_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return pool_wm_show(kobj, buf, pool_low_wm);
+}
+
+static ssize_t low_watermark_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	return pool_wm_store(kobj, buf, count, false);
+}
+
+static ssize_t high_watermark_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return pool_wm_show(kobj, buf, pool_high_wm);
+}
+
+static ssize_t high_watermark_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	return pool_wm_store(kobj, buf, count, true);
+}
+
+static ssize_t pages_show(struct kobject *kobj, struct kobj_attribute *attr,
+			  char *buf)
+{
+	struct dmabuf_page_pool *pool;
+	int order = pool_kobj_order(kobj);
+	unsigned int nr = 0;
+
+	if (order < 0)
+		return order;
+
+	mutex_lock(&pool_list_lock);
+	list_for_each_entry(pool, &pool_list, list)
+		if (pool->order == order)
+			nr += dmabuf_page_pool_nr_items(pool) +
+			      dmabuf_page_pool_pcp_count(pool);
+	mutex_unlock(&pool_list_lock);
+
+	return sysfs_emit(buf, "%u\n", nr);
+}
+
+static ssize_t magazine_stats_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	unsigned long alloc_hit = 0, alloc_miss = 0;
+	unsigned long free_hit = 0, free_miss = 0;
+	struct dmabuf_page_pool *pool;
+	int order = pool_kobj_order(kobj);
+	int cpu;
+
+	if (order < 0)
+		return order;
+
+	mutex_lock(&pool_list_lock);
+	list_for_each_entry(pool, &pool_list, list) {
+		if (pool->order != order || !pool->pcp)
+			continue;
+		for_each_possible_cpu(cpu) {
+			struct dmabuf_page_pool_pcp *pcp;
+
+			pcp = per_cpu_ptr(pool->pcp, cpu);
+			alloc_hit += READ_ONCE(pcp->alloc_hit);
+			alloc_miss += READ_ONCE(pcp->alloc_miss);
+			free_hit += READ_ONCE(pcp->free_hit);
+			free_miss += READ_ONCE(pcp->free_miss);
+		}
+	}
+	mutex_unlock(&pool_list_lock);
+
+	return sysfs_emit(buf, "alloc_hit %lu\nalloc_miss %lu\nfree_hit %lu\nfree_miss %lu\n",
+			  alloc_hit, alloc_miss, free_hit, free_miss);
+}
+
+static struct kobj_attribute low_watermark_attr = __ATTR_RW(low_watermark);
+static struct kobj_attribute high_watermark_attr = __ATTR_RW(high_watermark);
+static struct kobj_attribute pages_attr = __ATTR_RO(pages);
+static struct kobj_attribute magazine_stats_attr = __ATTR_RO(magazine_stats);
+
+static struct attribute *pool_order_attrs[] = {
+	&low_watermark_attr.attr,
+	&high_watermark_attr.attr,
+	&pages_attr.attr,
+	&magazine_stats_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group pool_order_group = {
+	.attrs = pool_order_attrs,
+};
+
 static int dmabuf_page_pool_init_shrinker(void)
 {
+	pool_kobj = kobject_create_and_add("dmabuf_page_pool", kernel_kobj);
+	if (!pool_kobj)
+		pr_warn("dmabuf page pool: failed to create sysfs directory\n");
+
+	pool_refill_task = kthread_run(dmabuf_page_pool_refill_thread, NULL,
+				       "%s", "dmabuf-page-pool-refill");
+	if (IS_ERR(pool_refill_task)) {
+		pr_err("Creating thread for page pool refill failed\n");
+		pool_refill_task = NULL;
+	} else {
+		sched_set_normal(pool_refill_task, 19);
+	}
+
 	return register_shrinker(&pool_shrinker, "dmabuf-page-pool-shrinker");
 }
 module_init(dmabuf_page_pool_init_shrinker);
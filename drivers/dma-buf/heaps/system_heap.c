@@ -17,13 +17,25 @@
 #include <linux/highmem.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 
+#include "deferred-free-helper.h"
+#include "page_pool.h"
+
 static struct dma_heap *sys_heap;
 static struct dma_heap *sys_uncached_heap;
 
+/*
+ * Keep an attachment's DMA mapping alive across unmap/map cycles and only
+ * tear it down on detach, or when it is remapped with a different direction
+ * or attributes.
+ */
+static bool cache_attach_map = true;
+module_param(cache_attach_map, bool, 0644);
+
 struct system_heap_buffer {
 	struct dma_heap *heap;
 	struct list_head attachments;
@@ -34,8 +46,15 @@ struct system_heap_buffer {
 	void *vaddr;
 
 	bool uncached;
+	struct deferred_freelist_item deferred_free;
 };
 
+/*
+ * @table is only duplicated on the first map. While @dma_mapped, @table is
+ * mapped for @dev with @dir and @attrs, even if the importer has unmapped it
+ * (@mapped is false). @needs_sync records that the cpu may have written the
+ * buffer since, so the next map has to sync it for the device.
+ */
 struct dma_heap_attachment {
 	struct device *dev;
 	struct sg_table *table;
@@ -43,6 +62,11 @@ struct dma_heap_attachment {
 	bool mapped;
 
 	bool uncached;
+
+	bool dma_mapped;
+	bool needs_sync;
+	enum dma_data_direction dir;
+	unsigned long attrs;
 };
 
 #define LOW_ORDER_GFP (GFP_HIGHUSER | __GFP_ZERO)
@@ -58,6 +82,17 @@ static gfp_t order_flags[] = {HIGH_ORDER_GFP, HIGH_ORDER_GFP, LOW_ORDER_GFP};
  */
 static const unsigned int orders[] = {8, 4, 0};
 #define NUM_ORDERS ARRAY_SIZE(orders)
+static struct dmabuf_page_pool *pools[NUM_ORDERS];
+
+static int order_to_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++)
+		if (order == orders[i])
+			return i;
+	return -1;
+}
 
 static struct sg_table *dup_sg_table(struct sg_table *table)
 {
@@ -89,19 +124,11 @@ static int system_heap_attach(struct dma_buf *dmabuf,
 {
 	struct system_heap_buffer *buffer = dmabuf->priv;
 	struct dma_heap_attachment *a;
-	struct sg_table *table;
 
 	a = kzalloc(sizeof(*a), GFP_KERNEL);
 	if (!a)
 		return -ENOMEM;
 
-	table = dup_sg_table(&buffer->sg_table);
-	if (IS_ERR(table)) {
-		kfree(a);
-		return -ENOMEM;
-	}
-
-	a->table = table;
 	a->dev = attachment->dev;
 	INIT_LIST_HEAD(&a->list);
 	a->mapped = false;
@@ -125,41 +152,81 @@ static void system_heap_detach(struct dma_buf *dmabuf,
 	list_del(&a->list);
 	mutex_unlock(&buffer->lock);
 
-	sg_free_table(a->table);
-	kfree(a->table);
+	if (a->dma_mapped)
+		dma_unmap_sgtable(a->dev, a->table, a->dir,
+				  a->attrs | DMA_ATTR_SKIP_CPU_SYNC);
+	if (a->table) {
+		sg_free_table(a->table);
+		kfree(a->table);
+	}
 	kfree(a);
 }
 
 static struct sg_table *system_heap_map_dma_buf(struct dma_buf_attachment *attachment,
 						enum dma_data_direction direction)
 {
+	struct system_heap_buffer *buffer = attachment->dmabuf->priv;
 	struct dma_heap_attachment *a = attachment->priv;
-	struct sg_table *table = a->table;
-	int attr = attachment->dma_map_attrs;
-	int ret;
+	unsigned long attr = attachment->dma_map_attrs;
+	struct sg_table *table;
+	int ret = 0;
 
 	if (a->uncached)
 		attr |= DMA_ATTR_SKIP_CPU_SYNC;
 
-	ret = dma_map_sgtable(attachment->dev, table, direction, attr);
-	if (ret)
-		return ERR_PTR(ret);
+	mutex_lock(&buffer->lock);
+	if (!a->table) {
+		table = dup_sg_table(&buffer->sg_table);
+		if (IS_ERR(table)) {
+			ret = PTR_ERR(table);
+			goto out;
+		}
+		a->table = table;
+	}
+	table = a->table;
+
+	if (a->dma_mapped && (a->dir != direction || a->attrs != attr)) {
+		dma_unmap_sgtable(a->dev, table, a->dir, a->attrs);
+		a->dma_mapped = false;
+	}
 
+	if (a->dma_mapped) {
+		if (a->needs_sync && !(attr & DMA_ATTR_SKIP_CPU_SYNC))
+			dma_sync_sgtable_for_device(a->dev, table, direction);
+	} else {
+		ret = dma_map_sgtable(a->dev, table, direction, attr);
+		if (ret)
+			goto out;
+		a->dma_mapped = true;
+		a->dir = direction;
+		a->attrs = attr;
+	}
+	a->needs_sync = false;
 	a->mapped = true;
-	return table;
+out:
+	mutex_unlock(&buffer->lock);
+
+	return ret ? ERR_PTR(ret) : table;
 }
 
 static void system_heap_unmap_dma_buf(struct dma_buf_attachment *attachment,
 				      struct sg_table *table,
 				      enum dma_data_direction direction)
 {
+	struct system_heap_buffer *buffer = attachment->dmabuf->priv;
 	struct dma_heap_attachment *a = attachment->priv;
-	int attr = attachment->dma_map_attrs;
+	unsigned long attr = attachment->dma_map_attrs;
 
 	if (a->uncached)
 		attr |= DMA_ATTR_SKIP_CPU_SYNC;
+
+	mutex_lock(&buffer->lock);
 	a->mapped = false;
-	dma_unmap_sgtable(attachment->dev, table, direction, attr);
+	if (!cache_attach_map) {
+		dma_unmap_sgtable(attachment->dev, table, direction, attr);
+		a->dma_mapped = false;
+	}
+	mutex_unlock(&buffer->lock);
 }
 
 static int system_heap_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
@@ -173,11 +240,17 @@ static int system_heap_dma_buf_begin_cpu_access(struct dma_buf *dmabuf,
 	if (buffer->vmap_cnt)
 		invalidate_kernel_vmap_range(buffer->vaddr, buffer->len);
 
+	/*
+	 * Cached but idle mappings still have to be synced for the cpu, as
+	 * their unmap didn't. Their sync back for the device is left to the
+	 * next map.
+	 */
 	if (!buffer->uncached) {
 		list_for_each_entry(a, &buffer->attachments, list) {
-			if (!a->mapped)
+			if (!a->dma_mapped)
 				continue;
 			dma_sync_sgtable_for_cpu(a->dev, a->table, direction);
+			a->needs_sync = true;
 		}
 	}
 	mutex_unlock(&buffer->lock);
@@ -201,6 +274,7 @@ static int system_heap_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 			if (!a->mapped)
 				continue;
 			dma_sync_sgtable_for_device(a->dev, a->table, direction);
+			a->needs_sync = false;
 		}
 	}
 	mutex_unlock(&buffer->lock);
@@ -208,28 +282,43 @@ static int system_heap_dma_buf_end_cpu_access(struct dma_buf *dmabuf,
 	return 0;
 }
 
+#define MMAP_BATCH	64
+
+/*
+ * Insert the pages as normal, refcounted pages rather than with
+ * remap_pfn_range(): special ptes are never folded, whereas these are
+ * turned into contiguous mappings wherever an order 4 or order 8 chunk ends
+ * up naturally aligned in the vma.
+ */
 static int system_heap_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
 {
 	struct system_heap_buffer *buffer = dmabuf->priv;
 	struct sg_table *table = &buffer->sg_table;
+	unsigned long nr_left = vma_pages(vma);
 	unsigned long addr = vma->vm_start;
+	struct page *batch[MMAP_BATCH];
 	struct sg_page_iter piter;
+	unsigned long nr = 0;
 	int ret;
 
 	if (buffer->uncached)
 		vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
 
 	for_each_sgtable_page(table, &piter, vma->vm_pgoff) {
-		struct page *page = sg_page_iter_page(&piter);
+		batch[nr++] = sg_page_iter_page(&piter);
+		if (nr < MMAP_BATCH && nr < nr_left)
+			continue;
 
-		ret = remap_pfn_range(vma, addr, page_to_pfn(page), PAGE_SIZE,
-				      vma->vm_page_prot);
+		nr_left -= nr;
+		ret = vm_insert_pages(vma, addr, batch, &nr);
 		if (ret)
 			return ret;
-		addr += PAGE_SIZE;
-		if (addr >= vma->vm_end)
+		addr += MMAP_BATCH * PAGE_SIZE;
+		if (!nr_left)
 			return 0;
 	}
+	if (nr)
+		return vm_insert_pages(vma, addr, batch, &nr);
 	return 0;
 }
 
@@ -254,7 +343,7 @@ static void *system_heap_do_vmap(struct system_heap_buffer *buffer)
 		*tmp++ = sg_page_iter_page(&piter);
 	}
 
-	vaddr = vmap(pages, npages, VM_MAP, pgprot);
+	vaddr = vmap_compound(pages, npages, VM_MAP, pgprot);
 	vfree(pages);
 
 	if (!vaddr)
@@ -304,23 +393,61 @@ static void system_heap_vunmap(struct dma_buf *dmabuf, struct iosys_map *map)
 	iosys_map_clear(map);
 }
 
-static void system_heap_dma_buf_release(struct dma_buf *dmabuf)
+/*
+ * Pages handed out by the pools are expected to be zeroed, so clear a page
+ * before returning it to its pool.
+ */
+static void system_heap_free_page(struct page *page)
 {
-	struct system_heap_buffer *buffer = dmabuf->priv;
+	unsigned int order = compound_order(page);
+	int j = order_to_index(order);
+	unsigned int k;
+
+	if (j < 0) {
+		__free_pages(page, order);
+		return;
+	}
+
+	for (k = 0; k < (1 << order); k++)
+		clear_highpage(page + k);
+	dmabuf_page_pool_free(pools[j], page);
+}
+
+/*
+ * Called from the deferred free workers with DF_NORMAL, when the pages are
+ * zeroed and recycled through the pools, or from the deferred free shrinker
+ * with DF_UNDER_PRESSURE, when they go straight back to the buddy allocator.
+ */
+static void system_heap_buf_free(struct deferred_freelist_item *item,
+				 enum df_reason reason)
+{
+	struct system_heap_buffer *buffer;
 	struct sg_table *table;
 	struct scatterlist *sg;
 	int i;
 
+	buffer = container_of(item, struct system_heap_buffer, deferred_free);
 	table = &buffer->sg_table;
 	for_each_sgtable_sg(table, sg, i) {
 		struct page *page = sg_page(sg);
 
-		__free_pages(page, compound_order(page));
+		if (reason == DF_UNDER_PRESSURE)
+			__free_pages(page, compound_order(page));
+		else
+			system_heap_free_page(page);
 	}
 	sg_free_table(table);
 	kfree(buffer);
 }
 
+static void system_heap_dma_buf_release(struct dma_buf *dmabuf)
+{
+	struct system_heap_buffer *buffer = dmabuf->priv;
+	int npages = PAGE_ALIGN(buffer->len) / PAGE_SIZE;
+
+	deferred_free(&buffer->deferred_free, system_heap_buf_free, npages);
+}
+
 static const struct dma_buf_ops system_heap_buf_ops = {
 	.attach = system_heap_attach,
 	.detach = system_heap_detach,
@@ -346,7 +473,7 @@ static struct page *alloc_largest_available(unsigned long size,
 		if (max_order < orders[i])
 			continue;
 
-		page = alloc_pages(order_flags[i], orders[i]);
+		page = dmabuf_page_pool_alloc(pools[i]);
 		if (!page)
 			continue;
 		return page;
@@ -491,6 +618,16 @@ static struct dma_heap_ops system_uncached_heap_ops = {
 static int system_heap_create(void)
 {
 	struct dma_heap_export_info exp_info;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		pools[i] = dmabuf_page_pool_create(order_flags[i], orders[i]);
+		if (!pools[i]) {
+			while (--i >= 0)
+				dmabuf_page_pool_destroy(pools[i]);
+			return -ENOMEM;
+		}
+	}
 
 	exp_info.name = "system";
 	exp_info.ops = &system_heap_ops;
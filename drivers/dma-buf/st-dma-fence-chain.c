@@ -5,6 +5,7 @@
  */
 
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/dma-fence.h>
 #include <linux/dma-fence-chain.h>
 #include <linux/kernel.h>
@@ -677,6 +678,50 @@ static int wait_random(void *arg)
 	return err;
 }
 
+static int __bench_signal(bool backward)
+{
+	struct fence_chains fc;
+	ktime_t start, dt;
+	unsigned int i;
+	int err;
+
+	err = fence_chains_init(&fc, CHAIN_SZ, seqno_inc);
+	if (err)
+		return err;
+
+	start = ktime_get();
+	for (i = 0; i < fc.chain_length; i++)
+		dma_fence_signal(fc.fences[backward ? fc.chain_length - 1 - i : i]);
+
+	for (i = 0; i < fc.chain_length; i++) {
+		if (dma_fence_wait_timeout(fc.chains[i], false, HZ) <= 0) {
+			pr_err("chain[%u] was not signaled!\n", i);
+			err = -ETIMEDOUT;
+			goto err;
+		}
+	}
+	dt = ktime_sub(ktime_get(), start);
+
+	pr_info("%s: %u nodes signaled %s in %lluus, %lluns per node\n",
+		__func__, fc.chain_length, backward ? "backward" : "forward",
+		ktime_to_us(dt), div_u64(ktime_to_ns(dt), fc.chain_length));
+
+err:
+	fence_chains_fini(&fc);
+	return err;
+}
+
+static int bench_signal(void *arg)
+{
+	int err;
+
+	err = __bench_signal(false);
+	if (err)
+		return err;
+
+	return __bench_signal(true);
+}
+
 int dma_fence_chain(void)
 {
 	static const struct subtest tests[] = {
@@ -691,6 +736,7 @@ int dma_fence_chain(void)
 		SUBTEST(wait_forward),
 		SUBTEST(wait_backward),
 		SUBTEST(wait_random),
+		SUBTEST(bench_signal),
 	};
 	int ret;
 
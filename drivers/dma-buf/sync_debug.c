@@ -142,6 +142,13 @@ static int sync_info_debugfs_show(struct seq_file *s, void *unused)
 {
 	struct list_head *pos;
 
+	seq_puts(s, "merges:\n--------------\n");
+	seq_printf(s, "count: %lld\nallocs: %lld\nalloc_bytes: %lld\ntime_ns: %lld\n\n",
+		   atomic64_read(&sync_merge_stats.merges),
+		   atomic64_read(&sync_merge_stats.allocs),
+		   atomic64_read(&sync_merge_stats.alloc_bytes),
+		   atomic64_read(&sync_merge_stats.ns));
+
 	seq_puts(s, "objs:\n--------------\n");
 
 	spin_lock_irq(&sync_timeline_list_lock);
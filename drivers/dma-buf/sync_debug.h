@@ -62,6 +62,22 @@ struct sync_pt {
 	struct rb_node node;
 };
 
+/**
+ * struct sync_merge_stats - SYNC_IOC_MERGE accounting
+ * @merges:		number of successful merges
+ * @allocs:		merges whose fence array needed a separate allocation
+ * @alloc_bytes:	total size of those separate allocations
+ * @ns:			total time spent merging, in nanoseconds
+ */
+struct sync_merge_stats {
+	atomic64_t		merges;
+	atomic64_t		allocs;
+	atomic64_t		alloc_bytes;
+	atomic64_t		ns;
+};
+
+extern struct sync_merge_stats sync_merge_stats;
+
 extern const struct file_operations sw_sync_debugfs_fops;
 
 void sync_timeline_debug_add(struct sync_timeline *obj);
@@ -5,11 +5,13 @@
  * Copyright (C) 2012 Google, Inc.
  */
 
+#include <linux/dma-fence-array.h>
 #include <linux/dma-fence-unwrap.h>
 #include <linux/export.h>
 #include <linux/file.h>
 #include <linux/fs.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
@@ -18,6 +20,8 @@
 #include <linux/sync_file.h>
 #include <uapi/linux/sync_file.h>
 
+#include "sync_debug.h"
+
 static const struct file_operations sync_file_fops;
 
 static struct sync_file *sync_file_alloc(void)
@@ -146,6 +150,23 @@ char *sync_file_get_name(struct sync_file *sync_file, char *buf, int len)
 	return buf;
 }
 
+struct sync_merge_stats sync_merge_stats;
+
+static void sync_file_merge_account(struct dma_fence *fence, ktime_t start)
+{
+	struct dma_fence_array *array = to_dma_fence_array(fence);
+
+	atomic64_inc(&sync_merge_stats.merges);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &sync_merge_stats.ns);
+
+	if (array && array->num_fences > DMA_FENCE_UNWRAP_INLINE) {
+		atomic64_inc(&sync_merge_stats.allocs);
+		atomic64_add(array->num_fences * sizeof(*array->fences),
+			     &sync_merge_stats.alloc_bytes);
+	}
+}
+
 /**
  * sync_file_merge() - merge two sync_files
  * @name:	name of new fence
@@ -161,16 +182,19 @@ static struct sync_file *sync_file_merge(const char *name, struct sync_file *a,
 {
 	struct sync_file *sync_file;
 	struct dma_fence *fence;
+	ktime_t start;
 
 	sync_file = sync_file_alloc();
 	if (!sync_file)
 		return NULL;
 
+	start = ktime_get();
 	fence = dma_fence_unwrap_merge(a->fence, b->fence);
 	if (!fence) {
 		fput(sync_file->file);
 		return NULL;
 	}
+	sync_file_merge_account(fence, start);
 	sync_file->fence = fence;
 	strscpy(sync_file->user_name, name, sizeof(sync_file->user_name));
 	return sync_file;
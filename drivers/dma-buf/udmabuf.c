@@ -3,13 +3,18 @@
 #include <linux/device.h>
 #include <linux/dma-buf.h>
 #include <linux/dma-resv.h>
+#include <linux/hashtable.h>
 #include <linux/highmem.h>
+#include <linux/hugetlb.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/memfd.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/pagemap.h>
 #include <linux/shmem_fs.h>
+#include <linux/shrinker.h>
 #include <linux/slab.h>
 #include <linux/udmabuf.h>
 #include <linux/vmalloc.h>
@@ -23,13 +28,266 @@ static int size_limit_mb = 64;
 module_param(size_limit_mb, int, 0644);
 MODULE_PARM_DESC(size_limit_mb, "Max size of a dmabuf, in megabytes. Default is 64.");
 
+static int pin_cache_mb = 64;
+module_param(pin_cache_mb, int, 0644);
+MODULE_PARM_DESC(pin_cache_mb, "Max size of unused pinned memfd ranges kept for reuse, in megabytes. Default is 64.");
+
+/* sg entries are limited to an unsigned int length */
+#define UDMABUF_SEG_MAX_PAGES	(UINT_MAX >> PAGE_SHIFT)
+
+/*
+ * A pinned memfd range, backing one item of a create request. Pins are
+ * shared by all udmabufs created from the same range, and kept on the lru
+ * for reuse once the last of them is gone.
+ */
+struct udmabuf_pin {
+	struct hlist_node node;
+	struct list_head lru;
+	struct file *memfd;
+	pgoff_t pgoff;
+	pgoff_t pagecount;
+	unsigned int users;
+	struct page *pages[];
+};
+
+static DEFINE_HASHTABLE(udmabuf_pins, 6);
+static LIST_HEAD(udmabuf_pin_lru);
+static DEFINE_MUTEX(udmabuf_pin_lock);
+static unsigned long udmabuf_pin_cached;
+
 struct udmabuf {
 	pgoff_t pagecount;
 	struct page **pages;
+	unsigned int nr_segs;
+	u32 nr_pins;
+	struct udmabuf_pin **pins;
 	struct sg_table *sg;
 	struct miscdevice *device;
 };
 
+/* Number of physically contiguous pages starting at @start */
+static pgoff_t udmabuf_seg_pages(struct page **pages, pgoff_t pagecount,
+				 pgoff_t start)
+{
+	unsigned long pfn = page_to_pfn(pages[start]);
+	pgoff_t nr = 1;
+
+	while (start + nr < pagecount && nr < UDMABUF_SEG_MAX_PAGES &&
+	       page_to_pfn(pages[start + nr]) == pfn + nr)
+		nr++;
+	return nr;
+}
+
+static unsigned long udmabuf_pin_key(struct file *memfd, pgoff_t pgoff)
+{
+	return (unsigned long)memfd->f_mapping ^ pgoff;
+}
+
+static void udmabuf_pin_free(struct udmabuf_pin *pin)
+{
+	pgoff_t pg, nr;
+
+	/* Drop the references of each folio in one go */
+	for (pg = 0; pg < pin->pagecount; pg += nr) {
+		struct folio *folio = page_folio(pin->pages[pg]);
+
+		for (nr = 1; pg + nr < pin->pagecount; nr++)
+			if (page_folio(pin->pages[pg + nr]) != folio)
+				break;
+		folio_put_refs(folio, nr);
+	}
+	fput(pin->memfd);
+	kvfree(pin);
+}
+
+/*
+ * Pin @pgcnt pages of the memfd, looking up each folio only once. Large
+ * shmem folios and hugetlb pages are naturally aligned in the page cache,
+ * so the position within the folio follows from the index.
+ */
+static int udmabuf_pin_pages(struct udmabuf_pin *pin, pgoff_t pgcnt)
+{
+	struct address_space *mapping = pin->memfd->f_mapping;
+	bool hugetlb = is_file_hugepages(pin->memfd);
+	unsigned int order = 0;
+
+	if (hugetlb)
+		order = huge_page_order(hstate_file(pin->memfd));
+
+	while (pin->pagecount < pgcnt) {
+		pgoff_t index = pin->pgoff + pin->pagecount;
+		struct folio *folio;
+		pgoff_t first, nr;
+
+		if (hugetlb) {
+			/* hugetlb page cache is indexed in huge page units */
+			folio = filemap_get_folio(mapping, index >> order);
+			if (IS_ERR(folio))
+				return -EINVAL;
+		} else {
+			folio = shmem_read_folio(mapping, index);
+			if (IS_ERR(folio))
+				return PTR_ERR(folio);
+		}
+
+		first = index & (folio_nr_pages(folio) - 1);
+		nr = min_t(pgoff_t, folio_nr_pages(folio) - first,
+			   pgcnt - pin->pagecount);
+		if (nr > 1)
+			folio_ref_add(folio, nr - 1);
+		while (nr--)
+			pin->pages[pin->pagecount++] = folio_page(folio, first++);
+	}
+	return 0;
+}
+
+/* A range may have been punched out of the memfd since it was pinned */
+static bool udmabuf_pin_valid(struct udmabuf_pin *pin)
+{
+	struct address_space *mapping = pin->memfd->f_mapping;
+	struct folio *folio = NULL;
+	pgoff_t pg;
+
+	for (pg = 0; pg < pin->pagecount; pg++) {
+		if (page_folio(pin->pages[pg]) == folio)
+			continue;
+		folio = page_folio(pin->pages[pg]);
+		if (READ_ONCE(folio->mapping) != mapping)
+			return false;
+	}
+	return true;
+}
+
+/* Called with udmabuf_pin_lock held, returns the number of pages released */
+static unsigned long udmabuf_pin_evict(unsigned long limit)
+{
+	struct udmabuf_pin *pin;
+	unsigned long freed = 0;
+
+	while (udmabuf_pin_cached > limit) {
+		pin = list_first_entry(&udmabuf_pin_lru, struct udmabuf_pin, lru);
+		list_del(&pin->lru);
+		hash_del(&pin->node);
+		udmabuf_pin_cached -= pin->pagecount;
+		freed += pin->pagecount;
+		udmabuf_pin_free(pin);
+	}
+	return freed;
+}
+
+static struct udmabuf_pin *udmabuf_pin_lookup(struct file *memfd,
+					      pgoff_t pgoff, pgoff_t pgcnt)
+{
+	struct udmabuf_pin *pin;
+	struct hlist_node *tmp;
+
+	lockdep_assert_held(&udmabuf_pin_lock);
+
+	hash_for_each_possible_safe(udmabuf_pins, pin, tmp, node,
+				    udmabuf_pin_key(memfd, pgoff)) {
+		if (pin->memfd->f_mapping != memfd->f_mapping ||
+		    pin->pgoff != pgoff || pin->pagecount != pgcnt)
+			continue;
+
+		if (!udmabuf_pin_valid(pin)) {
+			/* Users keep their pages, but nobody new gets them */
+			hash_del(&pin->node);
+			if (!pin->users) {
+				list_del(&pin->lru);
+				udmabuf_pin_cached -= pin->pagecount;
+				udmabuf_pin_free(pin);
+			}
+			continue;
+		}
+
+		if (!pin->users++) {
+			list_del_init(&pin->lru);
+			udmabuf_pin_cached -= pin->pagecount;
+		}
+		return pin;
+	}
+	return NULL;
+}
+
+static struct udmabuf_pin *udmabuf_pin_get(struct file *memfd,
+					   pgoff_t pgoff, pgoff_t pgcnt)
+{
+	struct udmabuf_pin *pin;
+	int ret;
+
+	mutex_lock(&udmabuf_pin_lock);
+	pin = udmabuf_pin_lookup(memfd, pgoff, pgcnt);
+	mutex_unlock(&udmabuf_pin_lock);
+	if (pin)
+		return pin;
+
+	pin = kvzalloc(struct_size(pin, pages, pgcnt), GFP_KERNEL);
+	if (!pin)
+		return ERR_PTR(-ENOMEM);
+	INIT_LIST_HEAD(&pin->lru);
+	pin->memfd = get_file(memfd);
+	pin->pgoff = pgoff;
+	pin->users = 1;
+
+	ret = udmabuf_pin_pages(pin, pgcnt);
+	if (ret) {
+		udmabuf_pin_free(pin);
+		return ERR_PTR(ret);
+	}
+
+	mutex_lock(&udmabuf_pin_lock);
+	hash_add(udmabuf_pins, &pin->node, udmabuf_pin_key(memfd, pgoff));
+	mutex_unlock(&udmabuf_pin_lock);
+	return pin;
+}
+
+static void udmabuf_pin_put(struct udmabuf_pin *pin)
+{
+	unsigned long limit = (unsigned long)max(pin_cache_mb, 0) <<
+			      (20 - PAGE_SHIFT);
+
+	mutex_lock(&udmabuf_pin_lock);
+	if (--pin->users)
+		goto out;
+
+	if (hlist_unhashed(&pin->node) || pin->pagecount > limit) {
+		hash_del(&pin->node);
+		udmabuf_pin_free(pin);
+		goto out;
+	}
+
+	list_add_tail(&pin->lru, &udmabuf_pin_lru);
+	udmabuf_pin_cached += pin->pagecount;
+	udmabuf_pin_evict(limit);
+out:
+	mutex_unlock(&udmabuf_pin_lock);
+}
+
+static unsigned long udmabuf_pin_shrink_count(struct shrinker *shrinker,
+					      struct shrink_control *sc)
+{
+	return READ_ONCE(udmabuf_pin_cached) ?: SHRINK_EMPTY;
+}
+
+static unsigned long udmabuf_pin_shrink_scan(struct shrinker *shrinker,
+					     struct shrink_control *sc)
+{
+	unsigned long freed;
+
+	if (!mutex_trylock(&udmabuf_pin_lock))
+		return SHRINK_STOP;
+	freed = udmabuf_pin_evict(udmabuf_pin_cached > sc->nr_to_scan ?
+				  udmabuf_pin_cached - sc->nr_to_scan : 0);
+	mutex_unlock(&udmabuf_pin_lock);
+	return freed;
+}
+
+static struct shrinker udmabuf_pin_shrinker = {
+	.count_objects = udmabuf_pin_shrink_count,
+	.scan_objects = udmabuf_pin_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
 static vm_fault_t udmabuf_vm_fault(struct vm_fault *vmf)
 {
 	struct vm_area_struct *vma = vmf->vma;
@@ -87,17 +345,23 @@ static struct sg_table *get_sg_table(struct device *dev, struct dma_buf *buf,
 				     enum dma_data_direction direction)
 {
 	struct udmabuf *ubuf = buf->priv;
+	struct scatterlist *sgl;
 	struct sg_table *sg;
+	pgoff_t pg, nr;
 	int ret;
 
 	sg = kzalloc(sizeof(*sg), GFP_KERNEL);
 	if (!sg)
 		return ERR_PTR(-ENOMEM);
-	ret = sg_alloc_table_from_pages(sg, ubuf->pages, ubuf->pagecount,
-					0, ubuf->pagecount << PAGE_SHIFT,
-					GFP_KERNEL);
+	ret = sg_alloc_table(sg, ubuf->nr_segs, GFP_KERNEL);
 	if (ret < 0)
 		goto err;
+	sgl = sg->sgl;
+	for (pg = 0; pg < ubuf->pagecount; pg += nr) {
+		nr = udmabuf_seg_pages(ubuf->pages, ubuf->pagecount, pg);
+		sg_set_page(sgl, ubuf->pages[pg], nr << PAGE_SHIFT, 0);
+		sgl = sg_next(sgl);
+	}
 	ret = dma_map_sgtable(dev, sg, direction, 0);
 	if (ret < 0)
 		goto err;
@@ -134,13 +398,14 @@ static void release_udmabuf(struct dma_buf *buf)
 {
 	struct udmabuf *ubuf = buf->priv;
 	struct device *dev = ubuf->device->this_device;
-	pgoff_t pg;
+	u32 i;
 
 	if (ubuf->sg)
 		put_sg_table(dev, ubuf->sg, DMA_BIDIRECTIONAL);
 
-	for (pg = 0; pg < ubuf->pagecount; pg++)
-		put_page(ubuf->pages[pg]);
+	for (i = 0; i < ubuf->nr_pins; i++)
+		udmabuf_pin_put(ubuf->pins[i]);
+	kfree(ubuf->pins);
 	kfree(ubuf->pages);
 	kfree(ubuf);
 }
@@ -201,10 +466,10 @@ static long udmabuf_create(struct miscdevice *device,
 	DEFINE_DMA_BUF_EXPORT_INFO(exp_info);
 	struct file *memfd = NULL;
 	struct address_space *mapping = NULL;
+	struct udmabuf_pin *pin;
 	struct udmabuf *ubuf;
 	struct dma_buf *buf;
-	pgoff_t pgoff, pgcnt, pgidx, pgbuf = 0, pglimit;
-	struct page *page;
+	pgoff_t pgoff, pgcnt, pg, pgbuf = 0, pglimit;
 	int seals, ret = -EINVAL;
 	u32 i, flags;
 
@@ -232,6 +497,11 @@ static long udmabuf_create(struct miscdevice *device,
 		ret = -ENOMEM;
 		goto err;
 	}
+	ubuf->pins = kcalloc(head->count, sizeof(*ubuf->pins), GFP_KERNEL);
+	if (!ubuf->pins) {
+		ret = -ENOMEM;
+		goto err;
+	}
 
 	pgbuf = 0;
 	for (i = 0; i < head->count; i++) {
@@ -240,7 +510,7 @@ static long udmabuf_create(struct miscdevice *device,
 		if (!memfd)
 			goto err;
 		mapping = memfd->f_mapping;
-		if (!shmem_mapping(mapping))
+		if (!shmem_mapping(mapping) && !is_file_hugepages(memfd))
 			goto err;
 		seals = memfd_fcntl(memfd, F_GET_SEALS, 0);
 		if (seals == -EINVAL)
@@ -251,18 +521,25 @@ static long udmabuf_create(struct miscdevice *device,
 			goto err;
 		pgoff = list[i].offset >> PAGE_SHIFT;
 		pgcnt = list[i].size   >> PAGE_SHIFT;
-		for (pgidx = 0; pgidx < pgcnt; pgidx++) {
-			page = shmem_read_mapping_page(mapping, pgoff + pgidx);
-			if (IS_ERR(page)) {
-				ret = PTR_ERR(page);
-				goto err;
-			}
-			ubuf->pages[pgbuf++] = page;
+		if (!pgcnt)
+			goto next;
+		pin = udmabuf_pin_get(memfd, pgoff, pgcnt);
+		if (IS_ERR(pin)) {
+			ret = PTR_ERR(pin);
+			goto err;
 		}
+		ubuf->pins[ubuf->nr_pins++] = pin;
+		memcpy(&ubuf->pages[pgbuf], pin->pages,
+		       pgcnt * sizeof(*ubuf->pages));
+		pgbuf += pgcnt;
+next:
 		fput(memfd);
 		memfd = NULL;
 	}
 
+	for (pg = 0; pg < ubuf->pagecount; ubuf->nr_segs++)
+		pg += udmabuf_seg_pages(ubuf->pages, ubuf->pagecount, pg);
+
 	exp_info.ops  = &udmabuf_ops;
 	exp_info.size = ubuf->pagecount << PAGE_SHIFT;
 	exp_info.priv = ubuf;
@@ -281,10 +558,11 @@ static long udmabuf_create(struct miscdevice *device,
 	return dma_buf_fd(buf, flags);
 
 err:
-	while (pgbuf > 0)
-		put_page(ubuf->pages[--pgbuf]);
+	while (ubuf->nr_pins > 0)
+		udmabuf_pin_put(ubuf->pins[--ubuf->nr_pins]);
 	if (memfd)
 		fput(memfd);
+	kfree(ubuf->pins);
 	kfree(ubuf->pages);
 	kfree(ubuf);
 	return ret;
@@ -381,11 +659,22 @@ static int __init udmabuf_dev_init(void)
 		return ret;
 	}
 
+	ret = register_shrinker(&udmabuf_pin_shrinker, "udmabuf-pin");
+	if (ret < 0) {
+		pr_err("Could not register udmabuf pin shrinker\n");
+		misc_deregister(&udmabuf_misc);
+		return ret;
+	}
+
 	return 0;
 }
 
 static void __exit udmabuf_dev_exit(void)
 {
+	unregister_shrinker(&udmabuf_pin_shrinker);
+	mutex_lock(&udmabuf_pin_lock);
+	udmabuf_pin_evict(0);
+	mutex_unlock(&udmabuf_pin_lock);
 	misc_deregister(&udmabuf_misc);
 }
 
@@ -25,8 +25,11 @@
  * Daniel Vetter <daniel.vetter@ffwll.ch>
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-fence.h>
+#include <linux/kthread.h>
 #include <linux/ktime.h>
+#include <linux/seq_file.h>
 
 #include <drm/drm_atomic.h>
 #include <drm/drm_atomic_helper.h>
@@ -38,6 +41,7 @@
 #include <drm/drm_drv.h>
 #include <drm/drm_framebuffer.h>
 #include <drm/drm_gem_atomic_helper.h>
+#include <drm/drm_managed.h>
 #include <drm/drm_print.h>
 #include <drm/drm_self_refresh_helper.h>
 #include <drm/drm_vblank.h>
@@ -1530,22 +1534,23 @@ void drm_atomic_helper_commit_modeset_enables(struct drm_device *dev,
 EXPORT_SYMBOL(drm_atomic_helper_commit_modeset_enables);
 
 /*
- * For atomic updates which touch just a single CRTC, calculate the time of the
- * next vblank, and inform all the fences of the deadline.
+ * Calculate the time of the next vblank of the CRTCs updated by @state, the
+ * earliest one if there are several. Returns 0 if there is none, otherwise
+ * @crtcp, if not NULL, is set to the CRTC if @state touches only that one.
  */
-static void set_fence_deadline(struct drm_device *dev,
-			       struct drm_atomic_state *state)
+static ktime_t commit_deadline(struct drm_atomic_state *state,
+			       struct drm_crtc **crtcp)
 {
-	struct drm_crtc *crtc;
+	struct drm_crtc *crtc, *single = NULL;
 	struct drm_crtc_state *new_crtc_state;
-	struct drm_plane *plane;
-	struct drm_plane_state *new_plane_state;
 	ktime_t vbltime = 0;
-	int i;
+	int i, nr_crtcs = 0;
 
 	for_each_new_crtc_in_state (state, crtc, new_crtc_state, i) {
 		ktime_t v;
 
+		nr_crtcs++;
+
 		if (drm_atomic_crtc_needs_modeset(new_crtc_state))
 			continue;
 
@@ -1555,10 +1560,28 @@ static void set_fence_deadline(struct drm_device *dev,
 		if (drm_crtc_next_vblank_start(crtc, &v))
 			continue;
 
-		if (!vbltime || ktime_before(v, vbltime))
+		if (!vbltime || ktime_before(v, vbltime)) {
 			vbltime = v;
+			single = crtc;
+		}
 	}
 
+	if (crtcp)
+		*crtcp = nr_crtcs == 1 ? single : NULL;
+
+	return vbltime;
+}
+
+/*
+ * Inform all the fences of @state of the deadline @vbltime, as calculated by
+ * commit_deadline().
+ */
+static void set_fence_deadline(struct drm_atomic_state *state, ktime_t vbltime)
+{
+	struct drm_plane *plane;
+	struct drm_plane_state *new_plane_state;
+	int i;
+
 	/* If no CRTCs updated, then nothing to do: */
 	if (!vbltime)
 		return;
@@ -1599,7 +1622,7 @@ int drm_atomic_helper_wait_for_fences(struct drm_device *dev,
 	struct drm_plane_state *new_plane_state;
 	int i, ret;
 
-	set_fence_deadline(dev, state);
+	set_fence_deadline(state, commit_deadline(state, NULL));
 
 	for_each_new_plane_in_state(state, plane, new_plane_state, i) {
 		if (!new_plane_state->fence)
@@ -1789,7 +1812,125 @@ void drm_atomic_helper_commit_tail_rpm(struct drm_atomic_state *old_state)
 }
 EXPORT_SYMBOL(drm_atomic_helper_commit_tail_rpm);
 
-static void commit_tail(struct drm_atomic_state *old_state)
+/*
+ * Nonblocking commits which update a single active CRTC run on a SCHED_FIFO
+ * kthread worker of that CRTC rather than on system_unbound_wq, so they are
+ * not delayed behind unrelated work when the target vblank is close. The
+ * vblank is also passed on as deadline to the fences right away, instead of
+ * when the commit gets to wait for them. Commits which touch several CRTCs,
+ * or none, stay on the workqueue so that unrelated CRTCs don't serialize.
+ */
+struct drm_crtc_commit_worker {
+	struct list_head head;
+	struct drm_crtc *crtc;
+	struct kthread_worker *worker;
+	/* Whether the fences were ready before the target vblank */
+	atomic_t met;
+	atomic_t missed;
+	/* Missed, and the worker only ran after the vblank */
+	atomic_t late_start;
+};
+
+struct drm_deadline_commit {
+	struct kthread_work work;
+	struct drm_atomic_state *state;
+	struct drm_crtc_commit_worker *cw;
+	ktime_t deadline;
+};
+
+static LIST_HEAD(commit_workers);
+static DEFINE_MUTEX(commit_workers_lock);
+
+#if defined(CONFIG_DEBUG_FS)
+static int commit_deadlines_show(struct seq_file *m, void *data)
+{
+	struct drm_crtc_commit_worker *cw = m->private;
+
+	seq_printf(m, "met: %d\n", atomic_read(&cw->met));
+	seq_printf(m, "missed: %d\n", atomic_read(&cw->missed));
+	seq_printf(m, "late_start: %d\n", atomic_read(&cw->late_start));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(commit_deadlines);
+
+static void commit_worker_debugfs_init(struct drm_crtc_commit_worker *cw)
+{
+	if (cw->crtc->debugfs_entry)
+		debugfs_create_file("commit_deadlines", 0444,
+				    cw->crtc->debugfs_entry, cw,
+				    &commit_deadlines_fops);
+}
+#else
+static void commit_worker_debugfs_init(struct drm_crtc_commit_worker *cw) {}
+#endif
+
+static void commit_worker_release(struct drm_device *dev, void *ptr)
+{
+	struct drm_crtc_commit_worker *cw = ptr;
+
+	mutex_lock(&commit_workers_lock);
+	list_del(&cw->head);
+	mutex_unlock(&commit_workers_lock);
+
+	kthread_destroy_worker(cw->worker);
+	kfree(cw);
+}
+
+static struct drm_crtc_commit_worker *commit_worker_get(struct drm_crtc *crtc)
+{
+	struct drm_crtc_commit_worker *cw;
+	struct kthread_worker *worker;
+
+	mutex_lock(&commit_workers_lock);
+	list_for_each_entry(cw, &commit_workers, head) {
+		if (cw->crtc == crtc)
+			goto out;
+	}
+
+	cw = kzalloc(sizeof(*cw), GFP_KERNEL);
+	if (!cw)
+		goto out;
+
+	worker = kthread_create_worker(0, "crtc_commit:%d", crtc->base.id);
+	if (IS_ERR(worker)) {
+		kfree(cw);
+		cw = NULL;
+		goto out;
+	}
+	sched_set_fifo(worker->task);
+
+	cw->crtc = crtc;
+	cw->worker = worker;
+	list_add(&cw->head, &commit_workers);
+	mutex_unlock(&commit_workers_lock);
+
+	if (drmm_add_action_or_reset(crtc->dev, commit_worker_release, cw))
+		return NULL;
+
+	commit_worker_debugfs_init(cw);
+	return cw;
+out:
+	mutex_unlock(&commit_workers_lock);
+	return cw;
+}
+
+static void commit_account_deadline(struct drm_deadline_commit *dc,
+				    ktime_t start)
+{
+	struct drm_crtc_commit_worker *cw = dc->cw;
+
+	if (!ktime_after(ktime_get(), dc->deadline)) {
+		atomic_inc(&cw->met);
+		return;
+	}
+
+	atomic_inc(&cw->missed);
+	if (ktime_after(start, dc->deadline))
+		atomic_inc(&cw->late_start);
+}
+
+static void commit_tail(struct drm_atomic_state *old_state,
+			struct drm_deadline_commit *dc)
 {
 	struct drm_device *dev = old_state->dev;
 	const struct drm_mode_config_helper_funcs *funcs;
@@ -1815,6 +1956,9 @@ static void commit_tail(struct drm_atomic_state *old_state)
 
 	drm_atomic_helper_wait_for_fences(dev, old_state, false);
 
+	if (dc)
+		commit_account_deadline(dc, start);
+
 	drm_atomic_helper_wait_for_dependencies(old_state);
 
 	/*
@@ -1847,7 +1991,53 @@ static void commit_work(struct work_struct *work)
 	struct drm_atomic_state *state = container_of(work,
 						      struct drm_atomic_state,
 						      commit_work);
-	commit_tail(state);
+	commit_tail(state, NULL);
+}
+
+static void deadline_commit_work(struct kthread_work *work)
+{
+	struct drm_deadline_commit *dc = container_of(work,
+						      struct drm_deadline_commit,
+						      work);
+
+	commit_tail(dc->state, dc);
+	kfree(dc);
+}
+
+/*
+ * Queue a nonblocking commit, on the worker of its CRTC with the deadline of
+ * the next vblank when possible.
+ */
+static void queue_commit(struct drm_atomic_state *state)
+{
+	struct drm_deadline_commit *dc;
+	struct drm_crtc *crtc;
+	ktime_t deadline;
+
+	deadline = commit_deadline(state, &crtc);
+	if (!deadline || !crtc)
+		goto fallback;
+
+	dc = kmalloc(sizeof(*dc), GFP_KERNEL);
+	if (!dc)
+		goto fallback;
+
+	dc->cw = commit_worker_get(crtc);
+	if (!dc->cw) {
+		kfree(dc);
+		goto fallback;
+	}
+
+	set_fence_deadline(state, deadline);
+
+	kthread_init_work(&dc->work, deadline_commit_work);
+	dc->state = state;
+	dc->deadline = deadline;
+	kthread_queue_work(dc->cw->worker, &dc->work);
+	return;
+
+fallback:
+	queue_work(system_unbound_wq, &state->commit_work);
 }
 
 /**
@@ -2065,9 +2255,9 @@ int drm_atomic_helper_commit(struct drm_device *dev,
 
 	drm_atomic_state_get(state);
 	if (nonblock)
-		queue_work(system_unbound_wq, &state->commit_work);
+		queue_commit(state);
 	else
-		commit_tail(state);
+		commit_tail(state, NULL);
 
 	return 0;
 
@@ -92,6 +92,17 @@ struct dm_exception_store_type {
 	 */
 	int (*commit_merge)(struct dm_exception_store *store, int nr_merged);
 
+	/*
+	 * Optional.  Like prepare_merge, but looks at the exceptions
+	 * preceding the last nr_skipped still-to-be-merged ones, so that
+	 * several runs can be merged and then committed together.
+	 * Returns 0 when there is nothing more to merge before the next
+	 * call to commit_merge.
+	 */
+	int (*prepare_merge_more)(struct dm_exception_store *store,
+				  int nr_skipped, chunk_t *last_old_chunk,
+				  chunk_t *last_new_chunk);
+
 	/*
 	 * The snapshot is invalid, note this in the metadata.
 	 */
@@ -760,13 +760,35 @@ static void persistent_commit_exception(struct dm_exception_store *store,
 	ps->callback_count = 0;
 }
 
+/*
+ * Find the run of consecutive chunks ending with exception nr_left - 1
+ * of the current area, working backwards.
+ */
+static int find_merge_run(struct pstore *ps, uint32_t nr_left,
+			  chunk_t *last_old_chunk, chunk_t *last_new_chunk)
+{
+	struct core_exception ce;
+	int nr_consecutive;
+
+	read_exception(ps, ps->area, nr_left - 1, &ce);
+	*last_old_chunk = ce.old_chunk;
+	*last_new_chunk = ce.new_chunk;
+
+	for (nr_consecutive = 1; nr_consecutive < nr_left; nr_consecutive++) {
+		read_exception(ps, ps->area, nr_left - 1 - nr_consecutive, &ce);
+		if (ce.old_chunk != *last_old_chunk - nr_consecutive ||
+		    ce.new_chunk != *last_new_chunk - nr_consecutive)
+			break;
+	}
+
+	return nr_consecutive;
+}
+
 static int persistent_prepare_merge(struct dm_exception_store *store,
 				    chunk_t *last_old_chunk,
 				    chunk_t *last_new_chunk)
 {
 	struct pstore *ps = get_info(store);
-	struct core_exception ce;
-	int nr_consecutive;
 	int r;
 
 	/*
@@ -786,24 +808,26 @@ static int persistent_prepare_merge(struct dm_exception_store *store,
 		ps->current_committed = ps->exceptions_per_area;
 	}
 
-	read_exception(ps, ps->area, ps->current_committed - 1, &ce);
-	*last_old_chunk = ce.old_chunk;
-	*last_new_chunk = ce.new_chunk;
+	return find_merge_run(ps, ps->current_committed, last_old_chunk,
+			      last_new_chunk);
+}
 
-	/*
-	 * Find number of consecutive chunks within the current area,
-	 * working backwards.
-	 */
-	for (nr_consecutive = 1; nr_consecutive < ps->current_committed;
-	     nr_consecutive++) {
-		read_exception(ps, ps->area,
-			       ps->current_committed - 1 - nr_consecutive, &ce);
-		if (ce.old_chunk != *last_old_chunk - nr_consecutive ||
-		    ce.new_chunk != *last_new_chunk - nr_consecutive)
-			break;
-	}
+/*
+ * Stays within the current area: commit_merge() has to run before
+ * prepare_merge() can move on to the preceding one.
+ */
+static int persistent_prepare_merge_more(struct dm_exception_store *store,
+					 int nr_skipped,
+					 chunk_t *last_old_chunk,
+					 chunk_t *last_new_chunk)
+{
+	struct pstore *ps = get_info(store);
 
-	return nr_consecutive;
+	if (nr_skipped >= ps->current_committed)
+		return 0;
+
+	return find_merge_run(ps, ps->current_committed - nr_skipped,
+			      last_old_chunk, last_new_chunk);
 }
 
 static int persistent_commit_merge(struct dm_exception_store *store,
@@ -933,6 +957,7 @@ static struct dm_exception_store_type _persistent_type = {
 	.commit_exception = persistent_commit_exception,
 	.prepare_merge = persistent_prepare_merge,
 	.commit_merge = persistent_commit_merge,
+	.prepare_merge_more = persistent_prepare_merge_more,
 	.drop_snapshot = persistent_drop_snapshot,
 	.usage = persistent_usage,
 	.status = persistent_status,
@@ -948,6 +973,7 @@ static struct dm_exception_store_type _persistent_compat_type = {
 	.commit_exception = persistent_commit_exception,
 	.prepare_merge = persistent_prepare_merge,
 	.commit_merge = persistent_commit_merge,
+	.prepare_merge_more = persistent_prepare_merge_more,
 	.drop_snapshot = persistent_drop_snapshot,
 	.usage = persistent_usage,
 	.status = persistent_status,
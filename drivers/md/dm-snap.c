@@ -17,6 +17,7 @@
 #include <linux/module.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <linux/log2.h>
 #include <linux/dm-kcopyd.h>
 
@@ -46,6 +47,15 @@ struct dm_exception_table {
 	struct hlist_bl_head *table;
 };
 
+/* Upper bound of snapshot_merge_parallel */
+#define DM_SNAP_MERGE_MAX_RUNS	32U
+
+struct dm_snap_merge_run {
+	chunk_t old_chunk;
+	chunk_t new_chunk;
+	int nr_chunks;
+};
+
 struct dm_snapshot {
 	struct rw_semaphore lock;
 
@@ -115,9 +125,23 @@ struct dm_snapshot {
 	/* Wait for events based on state_bits */
 	unsigned long state_bits;
 
-	/* Range of chunks currently being merged. */
-	chunk_t first_merging_chunk;
+	/*
+	 * Runs of chunks currently being merged.  They are copied in
+	 * parallel and committed to the exception store together.
+	 */
+	struct dm_snap_merge_run merge_runs[DM_SNAP_MERGE_MAX_RUNS];
+	int num_merge_runs;
 	int num_merging_chunks;
+	atomic_t merge_copies_pending;
+	bool merge_copy_failed;
+
+	/* Number of runs the next merge step may copy at once. */
+	unsigned int merge_width;
+	struct delayed_work merge_work;
+
+	/* Foreground reads seen by the snapshot-merge target. */
+	u64 fg_read_lat_ns;
+	unsigned long last_fg_read;
 
 	/*
 	 * The merge operation failed if this flag is set.
@@ -153,6 +177,24 @@ struct dm_snapshot {
 #define RUNNING_MERGE          0
 #define SHUTDOWN_MERGE         1
 
+/*
+ * Merge throttling: while foreground reads have completed within
+ * MERGE_FG_WINDOW and their average latency is above
+ * snapshot_merge_read_latency_us, each merge step halves the number of
+ * runs copied in parallel and waits MERGE_THROTTLE_DELAY before the
+ * next one.  Otherwise the width grows back by one run per step.
+ */
+#define MERGE_FG_WINDOW		(HZ / 10)
+#define MERGE_THROTTLE_DELAY	(HZ / 20)
+
+static unsigned int merge_parallel = 8;
+module_param_named(snapshot_merge_parallel, merge_parallel, uint, 0644);
+MODULE_PARM_DESC(snapshot_merge_parallel, "Maximum number of chunk runs merged in parallel");
+
+static unsigned int merge_read_latency_us = 10000;
+module_param_named(snapshot_merge_read_latency_us, merge_read_latency_us, uint, 0644);
+MODULE_PARM_DESC(snapshot_merge_read_latency_us, "Foreground read latency above which merging backs off (0 to disable)");
+
 /*
  * Maximum number of chunks being copied on write.
  *
@@ -240,6 +282,7 @@ static struct kmem_cache *pending_cache;
 struct dm_snap_tracked_chunk {
 	struct hlist_node node;
 	chunk_t chunk;
+	u64 start_ns;	/* foreground reads on snapshot-merge */
 };
 
 static void init_tracked_chunk(struct bio *bio)
@@ -247,6 +290,7 @@ static void init_tracked_chunk(struct bio *bio)
 	struct dm_snap_tracked_chunk *c = dm_per_bio_data(bio, sizeof(struct dm_snap_tracked_chunk));
 
 	INIT_HLIST_NODE(&c->node);
+	c->start_ns = 0;
 }
 
 static bool is_bio_tracked(struct bio *bio)
@@ -927,7 +971,7 @@ static void merge_shutdown(struct dm_snapshot *s)
 
 static struct bio *__release_queued_bios_after_merge(struct dm_snapshot *s)
 {
-	s->first_merging_chunk = 0;
+	s->num_merge_runs = 0;
 	s->num_merging_chunks = 0;
 
 	return bio_list_get(&s->bios_queued_during_merge);
@@ -985,23 +1029,29 @@ static int __remove_single_exception_chunk(struct dm_snapshot *s,
 
 static void flush_bios(struct bio *bio);
 
-static int remove_single_exception_chunk(struct dm_snapshot *s)
+static int remove_merged_exception_chunks(struct dm_snapshot *s)
 {
+	struct dm_snap_merge_run *run;
 	struct bio *b = NULL;
-	int r;
-	chunk_t old_chunk = s->first_merging_chunk + s->num_merging_chunks - 1;
+	chunk_t old_chunk;
+	int i, r = 0;
 
 	down_write(&s->lock);
 
 	/*
 	 * Process chunks (and associated exceptions) in reverse order
 	 * so that dm_consecutive_chunk_count_dec() accounting works.
+	 * The runs were taken from the exception store latest first.
 	 */
-	do {
-		r = __remove_single_exception_chunk(s, old_chunk);
-		if (r)
-			goto out;
-	} while (old_chunk-- > s->first_merging_chunk);
+	for (i = 0; i < s->num_merge_runs; i++) {
+		run = &s->merge_runs[i];
+		old_chunk = run->old_chunk + run->nr_chunks - 1;
+		do {
+			r = __remove_single_exception_chunk(s, old_chunk);
+			if (r)
+				goto out;
+		} while (old_chunk-- > run->old_chunk);
+	}
 
 	b = __release_queued_bios_after_merge(s);
 
@@ -1016,8 +1066,8 @@ static int remove_single_exception_chunk(struct dm_snapshot *s)
 static int origin_write_extent(struct dm_snapshot *merging_snap,
 			       sector_t sector, unsigned int chunk_size);
 
-static void merge_callback(int read_err, unsigned long write_err,
-			   void *context);
+static void merge_copy_callback(int read_err, unsigned long write_err,
+				void *context);
 
 static uint64_t read_pending_exceptions_done_count(void)
 {
@@ -1039,10 +1089,17 @@ static void increment_pending_exceptions_done_count(void)
 	wake_up_all(&_pending_exceptions_done);
 }
 
+static unsigned int merge_max_width(void)
+{
+	return clamp(READ_ONCE(merge_parallel), 1U, DM_SNAP_MERGE_MAX_RUNS);
+}
+
 static void snapshot_merge_next_chunks(struct dm_snapshot *s)
 {
-	int i, linear_chunks;
+	int i, j, linear_chunks, nr_runs = 0, nr_chunks = 0;
+	unsigned int width = min(s->merge_width, merge_max_width());
 	chunk_t old_chunk, new_chunk;
+	struct dm_snap_merge_run *run;
 	struct dm_io_region src, dest;
 	sector_t io_size;
 	uint64_t previous_count;
@@ -1059,35 +1116,41 @@ static void snapshot_merge_next_chunks(struct dm_snapshot *s)
 		goto shut;
 	}
 
-	linear_chunks = s->store->type->prepare_merge(s->store, &old_chunk,
-						      &new_chunk);
-	if (linear_chunks <= 0) {
+	/*
+	 * Collect up to 'width' runs of linear chunks, latest first.
+	 * Map doesn't look at merge_runs until num_merge_runs is set.
+	 */
+	do {
+		if (!nr_runs)
+			linear_chunks = s->store->type->prepare_merge(s->store,
+					&old_chunk, &new_chunk);
+		else if (s->store->type->prepare_merge_more)
+			linear_chunks = s->store->type->prepare_merge_more(
+					s->store, nr_chunks, &old_chunk,
+					&new_chunk);
+		else
+			break;
+
 		if (linear_chunks < 0) {
 			DMERR("Read error in exception store: shutting down merge");
 			down_write(&s->lock);
 			s->merge_failed = true;
 			up_write(&s->lock);
+			goto shut;
 		}
-		goto shut;
-	}
-
-	/* Adjust old_chunk and new_chunk to reflect start of linear region */
-	old_chunk = old_chunk + 1 - linear_chunks;
-	new_chunk = new_chunk + 1 - linear_chunks;
-
-	/*
-	 * Use one (potentially large) I/O to copy all 'linear_chunks'
-	 * from the exception store to the origin
-	 */
-	io_size = linear_chunks * s->store->chunk_size;
+		if (!linear_chunks)
+			break;
 
-	dest.bdev = s->origin->bdev;
-	dest.sector = chunk_to_sector(s->store, old_chunk);
-	dest.count = min(io_size, get_dev_size(dest.bdev) - dest.sector);
+		/* Adjust old_chunk and new_chunk to reflect start of linear region */
+		run = &s->merge_runs[nr_runs++];
+		run->old_chunk = old_chunk + 1 - linear_chunks;
+		run->new_chunk = new_chunk + 1 - linear_chunks;
+		run->nr_chunks = linear_chunks;
+		nr_chunks += linear_chunks;
+	} while (nr_runs < width);
 
-	src.bdev = s->cow->bdev;
-	src.sector = chunk_to_sector(s->store, new_chunk);
-	src.count = dest.count;
+	if (!nr_runs)
+		goto shut;
 
 	/*
 	 * Reallocate any exceptions needed in other snapshots then
@@ -1098,25 +1161,55 @@ static void snapshot_merge_next_chunks(struct dm_snapshot *s)
 	 * efficient algorithm, it is not expected to have any
 	 * significant impact on performance.
 	 */
-	previous_count = read_pending_exceptions_done_count();
-	while (origin_write_extent(s, dest.sector, io_size)) {
-		wait_event(_pending_exceptions_done,
-			   (read_pending_exceptions_done_count() !=
-			    previous_count));
-		/* Retry after the wait, until all exceptions are done. */
+	for (i = 0; i < nr_runs; i++) {
+		run = &s->merge_runs[i];
+		io_size = run->nr_chunks * s->store->chunk_size;
+
 		previous_count = read_pending_exceptions_done_count();
+		while (origin_write_extent(s, chunk_to_sector(s->store,
+							      run->old_chunk),
+					   io_size)) {
+			wait_event(_pending_exceptions_done,
+				   (read_pending_exceptions_done_count() !=
+				    previous_count));
+			/* Retry after the wait, until all exceptions are done. */
+			previous_count = read_pending_exceptions_done_count();
+		}
 	}
 
 	down_write(&s->lock);
-	s->first_merging_chunk = old_chunk;
-	s->num_merging_chunks = linear_chunks;
+	s->num_merge_runs = nr_runs;
+	s->num_merging_chunks = nr_chunks;
 	up_write(&s->lock);
 
-	/* Wait until writes to all 'linear_chunks' drain */
-	for (i = 0; i < linear_chunks; i++)
-		__check_for_conflicting_io(s, old_chunk + i);
+	/* Wait until writes to all the chunks being merged drain */
+	for (i = 0; i < nr_runs; i++)
+		for (j = 0; j < s->merge_runs[i].nr_chunks; j++)
+			__check_for_conflicting_io(s,
+					s->merge_runs[i].old_chunk + j);
 
-	dm_kcopyd_copy(s->kcopyd_client, &src, 1, &dest, 0, merge_callback, s);
+	s->merge_copy_failed = false;
+	atomic_set(&s->merge_copies_pending, nr_runs);
+
+	/*
+	 * Use one (potentially large) I/O per run to copy it from the
+	 * exception store to the origin, all of them in flight at once.
+	 */
+	for (i = 0; i < nr_runs; i++) {
+		run = &s->merge_runs[i];
+		io_size = run->nr_chunks * s->store->chunk_size;
+
+		dest.bdev = s->origin->bdev;
+		dest.sector = chunk_to_sector(s->store, run->old_chunk);
+		dest.count = min(io_size, get_dev_size(dest.bdev) - dest.sector);
+
+		src.bdev = s->cow->bdev;
+		src.sector = chunk_to_sector(s->store, run->new_chunk);
+		src.count = dest.count;
+
+		dm_kcopyd_copy(s->kcopyd_client, &src, 1, &dest, 0,
+			       merge_copy_callback, s);
+	}
 	return;
 
 shut:
@@ -1125,18 +1218,40 @@ static void snapshot_merge_next_chunks(struct dm_snapshot *s)
 
 static void error_bios(struct bio *bio);
 
-static void merge_callback(int read_err, unsigned long write_err, void *context)
+/*
+ * Adjusts the merge width for the next step and returns how long to
+ * wait before taking it.
+ */
+static unsigned long merge_throttle(struct dm_snapshot *s)
+{
+	unsigned int target_us = READ_ONCE(merge_read_latency_us);
+
+	if (target_us &&
+	    time_before(jiffies, READ_ONCE(s->last_fg_read) + MERGE_FG_WINDOW) &&
+	    READ_ONCE(s->fg_read_lat_ns) > (u64)target_us * NSEC_PER_USEC) {
+		s->merge_width = max(s->merge_width / 2, 1U);
+		return MERGE_THROTTLE_DELAY;
+	}
+
+	s->merge_width = min(s->merge_width + 1, merge_max_width());
+	return 0;
+}
+
+static void do_merge_work(struct work_struct *work)
+{
+	struct dm_snapshot *s = container_of(to_delayed_work(work),
+					     struct dm_snapshot, merge_work);
+
+	snapshot_merge_next_chunks(s);
+}
+
+static void merge_callback(struct dm_snapshot *s)
 {
-	struct dm_snapshot *s = context;
 	struct bio *b = NULL;
+	unsigned long delay;
 
-	if (read_err || write_err) {
-		if (read_err)
-			DMERR("Read error: shutting down merge.");
-		else
-			DMERR("Write error: shutting down merge.");
+	if (s->merge_copy_failed)
 		goto shut;
-	}
 
 	if (blkdev_issue_flush(s->origin->bdev) < 0) {
 		DMERR("Flush after merge failed: shutting down merge");
@@ -1149,10 +1264,14 @@ static void merge_callback(int read_err, unsigned long write_err, void *context)
 		goto shut;
 	}
 
-	if (remove_single_exception_chunk(s) < 0)
+	if (remove_merged_exception_chunks(s) < 0)
 		goto shut;
 
-	snapshot_merge_next_chunks(s);
+	delay = merge_throttle(s);
+	if (delay)
+		queue_delayed_work(system_long_wq, &s->merge_work, delay);
+	else
+		snapshot_merge_next_chunks(s);
 
 	return;
 
@@ -1166,10 +1285,30 @@ static void merge_callback(int read_err, unsigned long write_err, void *context)
 	merge_shutdown(s);
 }
 
+static void merge_copy_callback(int read_err, unsigned long write_err,
+				void *context)
+{
+	struct dm_snapshot *s = context;
+
+	if (read_err || write_err) {
+		if (read_err)
+			DMERR("Read error: shutting down merge.");
+		else
+			DMERR("Write error: shutting down merge.");
+		s->merge_copy_failed = true;
+	}
+
+	/* The last copy of the step to finish commits all of them */
+	if (atomic_dec_and_test(&s->merge_copies_pending))
+		merge_callback(s);
+}
+
 static void start_merge(struct dm_snapshot *s)
 {
-	if (!test_and_set_bit(RUNNING_MERGE, &s->state_bits))
+	if (!test_and_set_bit(RUNNING_MERGE, &s->state_bits)) {
+		s->merge_width = 1;
 		snapshot_merge_next_chunks(s);
+	}
 }
 
 /*
@@ -1178,10 +1317,26 @@ static void start_merge(struct dm_snapshot *s)
 static void stop_merge(struct dm_snapshot *s)
 {
 	set_bit(SHUTDOWN_MERGE, &s->state_bits);
+	/* Don't sit out a throttling delay */
+	flush_delayed_work(&s->merge_work);
 	wait_on_bit(&s->state_bits, RUNNING_MERGE, TASK_UNINTERRUPTIBLE);
+	cancel_delayed_work_sync(&s->merge_work);
 	clear_bit(SHUTDOWN_MERGE, &s->state_bits);
 }
 
+/*
+ * Average latency of foreground reads through the snapshot-merge
+ * target, which merge_throttle() weighs against the merge.
+ */
+static void merge_account_read(struct dm_snapshot *s, u64 start_ns)
+{
+	u64 lat = ktime_get_ns() - start_ns;
+	u64 avg = READ_ONCE(s->fg_read_lat_ns);
+
+	WRITE_ONCE(s->fg_read_lat_ns, avg ? (avg * 7 + lat) >> 3 : lat);
+	WRITE_ONCE(s->last_fg_read, jiffies);
+}
+
 static int parse_snapshot_features(struct dm_arg_set *as, struct dm_snapshot *s,
 				   struct dm_target *ti)
 {
@@ -1320,8 +1475,13 @@ static int snapshot_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	spin_lock_init(&s->pe_lock);
 	s->state_bits = 0;
 	s->merge_failed = false;
-	s->first_merging_chunk = 0;
+	s->num_merge_runs = 0;
 	s->num_merging_chunks = 0;
+	atomic_set(&s->merge_copies_pending, 0);
+	s->merge_width = 1;
+	INIT_DELAYED_WORK(&s->merge_work, do_merge_work);
+	s->fg_read_lat_ns = 0;
+	s->last_fg_read = jiffies - MERGE_FG_WINDOW;
 	bio_list_init(&s->bios_queued_during_merge);
 
 	/* Allocate hash table for COW data */
@@ -2101,6 +2261,22 @@ static int snapshot_map(struct dm_target *ti, struct bio *bio)
 	return r;
 }
 
+/* Called with s->lock held */
+static bool chunk_is_merging(struct dm_snapshot *s, chunk_t chunk)
+{
+	struct dm_snap_merge_run *run;
+	int i;
+
+	for (i = 0; i < s->num_merge_runs; i++) {
+		run = &s->merge_runs[i];
+		if (chunk >= run->old_chunk &&
+		    chunk < run->old_chunk + run->nr_chunks)
+			return true;
+	}
+
+	return false;
+}
+
 /*
  * A snapshot-merge target behaves like a combination of a snapshot
  * target and a snapshot-origin target.  It only generates new
@@ -2138,6 +2314,13 @@ static int snapshot_merge_map(struct dm_target *ti, struct bio *bio)
 
 	chunk = sector_to_chunk(s->store, bio->bi_iter.bi_sector);
 
+	if (bio_data_dir(bio) == READ) {
+		struct dm_snap_tracked_chunk *c =
+			dm_per_bio_data(bio, sizeof(struct dm_snap_tracked_chunk));
+
+		c->start_ns = ktime_get_ns();
+	}
+
 	down_write(&s->lock);
 
 	/* Full merging snapshots are redirected to the origin */
@@ -2148,10 +2331,7 @@ static int snapshot_merge_map(struct dm_target *ti, struct bio *bio)
 	e = dm_lookup_exception(&s->complete, chunk);
 	if (e) {
 		/* Queue writes overlapping with chunks being merged */
-		if (bio_data_dir(bio) == WRITE &&
-		    chunk >= s->first_merging_chunk &&
-		    chunk < (s->first_merging_chunk +
-			     s->num_merging_chunks)) {
+		if (bio_data_dir(bio) == WRITE && chunk_is_merging(s, chunk)) {
 			bio_set_dev(bio, s->origin->bdev);
 			bio_list_add(&s->bios_queued_during_merge, bio);
 			r = DM_MAPIO_SUBMITTED;
@@ -2183,10 +2363,15 @@ static int snapshot_end_io(struct dm_target *ti, struct bio *bio,
 		blk_status_t *error)
 {
 	struct dm_snapshot *s = ti->private;
+	struct dm_snap_tracked_chunk *c =
+		dm_per_bio_data(bio, sizeof(struct dm_snap_tracked_chunk));
 
 	if (is_bio_tracked(bio))
 		stop_tracking_chunk(s, bio);
 
+	if (c->start_ns)
+		merge_account_read(s, c->start_ns);
+
 	return DM_ENDIO_DONE;
 }
 
@@ -2768,7 +2953,7 @@ static struct target_type snapshot_target = {
 
 static struct target_type merge_target = {
 	.name    = dm_snapshot_merge_target_name,
-	.version = {1, 5, 0},
+	.version = {1, 6, 0},
 	.module  = THIS_MODULE,
 	.ctr     = snapshot_ctr,
 	.dtr     = snapshot_dtr,
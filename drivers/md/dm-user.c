@@ -8,12 +8,15 @@
 #include <uapi/linux/dm-user.h>
 
 #include <linux/bio.h>
+#include <linux/bitmap.h>
 #include <linux/init.h>
 #include <linux/mempool.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/poll.h>
 #include <linux/uio.h>
+#include <linux/vmalloc.h>
 #include <linux/wait.h>
 #include <linux/workqueue.h>
 
@@ -21,6 +24,11 @@
 
 #define MAX_OUTSTANDING_MESSAGES 128
 
+#define DM_USER_RING_MAX_ENTRIES 4096
+#define DM_USER_RING_MAX_SLOTS 65536
+#define DM_USER_RING_MAX_SLOT_SIZE SZ_1M
+#define DM_USER_RING_MAX_SIZE SZ_256M
+
 static unsigned int daemon_timeout_msec = 4000;
 module_param_named(dm_user_daemon_timeout_msec, daemon_timeout_msec, uint,
 		   0644);
@@ -91,6 +99,10 @@ struct message {
 	struct delayed_work work;
 	bool delayed;
 	struct target *t;
+
+	/* Data area slots owned by the message in ring mode */
+	unsigned int ring_slot;
+	unsigned int ring_nr_slots;
 };
 
 struct target {
@@ -144,6 +156,35 @@ struct target {
 	struct kref references;
 	int dm_destroyed;
 	bool daemon_terminated;
+
+	/* Throughput counters, reported as the target's status */
+	atomic64_t nr_bios;
+	atomic64_t nr_done;
+	atomic64_t nr_errors;
+	atomic64_t read_bytes;
+	atomic64_t write_bytes;
+	atomic64_t nr_ring_batches;
+
+	char *table_args;
+};
+
+/*
+ * Kernel-side state of a channel's shared ring.  Everything userspace may
+ * scribble on is only read from the shared header where it is ours to
+ * consume (req_head and cmp_tail); the layout is kept here.
+ */
+struct channel_ring {
+	struct dm_user_ring *shared;
+	size_t size;
+	u32 nr_entries;
+	u32 nr_slots;
+	u32 slot_size;
+	size_t req_off;
+	size_t cmp_off;
+	size_t data_off;
+	u32 req_tail;
+	u32 cmp_head;
+	unsigned long slots[];	/* data area slots in use */
 };
 
 struct channel {
@@ -182,10 +223,14 @@ struct channel {
 	 * only ever be pointer to by from_user_cur, and will never have a BIO.
 	 */
 	struct message scratch_message_from_user;
+
+	/* Set once DM_USER_IOC_RING_SETUP has been done on the channel */
+	struct channel_ring *ring;
 };
 
 static void message_kill(struct message *m, mempool_t *pool)
 {
+	atomic64_inc(&m->t->nr_errors);
 	m->bio->bi_status = BLK_STS_IOERR;
 	bio_endio(m->bio);
 	mempool_free(m, pool);
@@ -292,6 +337,14 @@ static inline struct target *target_from_channel(struct channel *c)
 	return c->target;
 }
 
+static void target_account_done(struct target *t, struct bio *bio)
+{
+	if (bio->bi_status)
+		atomic64_inc(&t->nr_errors);
+	else
+		atomic64_inc(&t->nr_done);
+}
+
 static inline size_t bio_size(struct bio *bio)
 {
 	struct bio_vec bvec;
@@ -672,6 +725,7 @@ static void target_release(struct kref *ref)
 	mempool_exit(&t->message_pool);
 	mutex_unlock(&t->lock);
 	mutex_destroy(&t->lock);
+	kfree(t->table_args);
 	kfree(t);
 }
 
@@ -756,6 +810,11 @@ static void channel_free(struct channel *c)
 		message_kill(list_entry(cur, struct message, from_user),
 			     &c->target->message_pool);
 
+	if (c->ring) {
+		vfree(c->ring->shared);
+		kfree(c->ring);
+	}
+
 	mutex_lock(&c->target->lock);
 	target_put(c->target);
 	mutex_unlock(&c->lock);
@@ -801,6 +860,11 @@ static ssize_t dev_read(struct kiocb *iocb, struct iov_iter *to)
 
 	mutex_lock(&c->lock);
 
+	if (unlikely(c->ring)) {
+		total_processed = -EBUSY;
+		goto cleanup_unlock;
+	}
+
 	if (unlikely(c->to_user_error)) {
 		total_processed = c->to_user_error;
 		goto cleanup_unlock;
@@ -896,6 +960,11 @@ static ssize_t dev_write(struct kiocb *iocb, struct iov_iter *from)
 
 	mutex_lock(&c->lock);
 
+	if (unlikely(c->ring)) {
+		total_processed = -EBUSY;
+		goto cleanup_unlock;
+	}
+
 	if (unlikely(c->from_user_error)) {
 		total_processed = c->from_user_error;
 		goto cleanup_unlock;
@@ -983,6 +1052,7 @@ static ssize_t dev_write(struct kiocb *iocb, struct iov_iter *from)
 	 * has gone off the rails.
 	 */
 	WARN_ON(bio_size(c->cur_from_user->bio) != 0);
+	target_account_done(c->target, c->cur_from_user->bio);
 	bio_endio(c->cur_from_user->bio);
 
 	/*
@@ -1011,12 +1081,325 @@ static int dev_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static inline struct dm_user_ring_req *ring_req(struct channel_ring *r,
+						u32 idx)
+{
+	return (void *)r->shared + r->req_off +
+	       (idx & (r->nr_entries - 1)) * sizeof(struct dm_user_ring_req);
+}
+
+static inline struct dm_user_ring_cmp *ring_cmp(struct channel_ring *r,
+						u32 idx)
+{
+	return (void *)r->shared + r->cmp_off +
+	       (idx & (r->nr_entries - 1)) * sizeof(struct dm_user_ring_cmp);
+}
+
+static long channel_ring_setup(struct channel *c,
+			       struct dm_user_ring_setup __user *arg)
+{
+	struct dm_user_ring_setup setup;
+	struct channel_ring *r;
+	size_t req_off, cmp_off, data_off, size;
+	long ret = 0;
+
+	if (copy_from_user(&setup, arg, sizeof(setup)))
+		return -EFAULT;
+
+	if (setup.flags || !is_power_of_2(setup.nr_entries) ||
+	    setup.nr_entries > DM_USER_RING_MAX_ENTRIES ||
+	    !setup.nr_slots || setup.nr_slots > DM_USER_RING_MAX_SLOTS ||
+	    !is_power_of_2(setup.slot_size) || setup.slot_size < PAGE_SIZE ||
+	    setup.slot_size > DM_USER_RING_MAX_SLOT_SIZE)
+		return -EINVAL;
+
+	req_off = ALIGN(sizeof(struct dm_user_ring), SMP_CACHE_BYTES);
+	cmp_off = req_off + setup.nr_entries * sizeof(struct dm_user_ring_req);
+	data_off = PAGE_ALIGN(cmp_off +
+			      setup.nr_entries * sizeof(struct dm_user_ring_cmp));
+	size = data_off + (size_t)setup.nr_slots * setup.slot_size;
+	if (size > DM_USER_RING_MAX_SIZE)
+		return -EINVAL;
+
+	r = kzalloc(struct_size(r, slots, BITS_TO_LONGS(setup.nr_slots)),
+		    GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+	r->shared = vmalloc_user(size);
+	if (!r->shared) {
+		kfree(r);
+		return -ENOMEM;
+	}
+
+	r->size = size;
+	r->nr_entries = setup.nr_entries;
+	r->nr_slots = setup.nr_slots;
+	r->slot_size = setup.slot_size;
+	r->req_off = req_off;
+	r->cmp_off = cmp_off;
+	r->data_off = data_off;
+	r->shared->nr_entries = r->nr_entries;
+	r->shared->nr_slots = r->nr_slots;
+	r->shared->slot_size = r->slot_size;
+	r->shared->req_off = req_off;
+	r->shared->cmp_off = cmp_off;
+	r->shared->data_off = data_off;
+
+	mutex_lock(&c->lock);
+	/* A channel is either in ring mode or in read()/write() mode */
+	if (c->ring || c->cur_to_user || !list_empty(&c->from_user) ||
+	    c->cur_from_user != &c->scratch_message_from_user ||
+	    c->scratch_message_from_user.posn_from_user) {
+		ret = -EBUSY;
+	} else {
+		c->ring = r;
+	}
+	mutex_unlock(&c->lock);
+
+	if (ret) {
+		vfree(r->shared);
+		kfree(r);
+		return ret;
+	}
+
+	setup.mmap_size = size;
+	if (copy_to_user(arg, &setup, sizeof(setup)))
+		return -EFAULT;
+	return 0;
+}
+
+/* Copies a message's data between its bio and its data area slots */
+static void channel_ring_copy(struct channel_ring *r, struct message *m,
+			      bool to_ring)
+{
+	struct kvec kv = {
+		.iov_base = (void *)r->shared + r->data_off +
+			    (size_t)m->ring_slot * r->slot_size,
+		.iov_len = m->msg.len,
+	};
+	struct iov_iter iter;
+	ssize_t copied;
+
+	iov_iter_kvec(&iter, to_ring ? ITER_DEST : ITER_SOURCE, &kv, 1,
+		      kv.iov_len);
+	if (to_ring)
+		copied = bio_copy_to_iter(m->bio, &iter);
+	else
+		copied = bio_copy_from_iter(m->bio, &iter);
+	if (copied > 0)
+		bio_advance(m->bio, copied);
+}
+
+static int channel_ring_reap(struct channel *c)
+{
+	struct channel_ring *r = c->ring;
+	struct target *t = target_from_channel(c);
+	u32 tail = smp_load_acquire(&r->shared->cmp_tail);
+	int reaped = 0;
+
+	lockdep_assert_held(&c->lock);
+
+	if (tail - r->cmp_head > r->nr_entries)
+		return -EINVAL;
+
+	while (r->cmp_head != tail) {
+		struct dm_user_ring_cmp *cmp = ring_cmp(r, r->cmp_head);
+		u64 seq = READ_ONCE(cmp->seq);
+		u64 result = READ_ONCE(cmp->result);
+		struct message *m;
+		struct bio *bio;
+
+		mutex_lock(&t->lock);
+		m = msg_get_from_user(c, seq);
+		mutex_unlock(&t->lock);
+		if (!m) {
+			pr_info("user provided an invalid messag seq of %llx\n",
+				seq);
+			reaped = -EINVAL;
+			break;
+		}
+
+		bio = m->bio;
+		if (result == DM_USER_RESP_SUCCESS) {
+			bio->bi_status = BLK_STS_OK;
+			if (m->ring_nr_slots && bio_op(bio) == REQ_OP_READ)
+				channel_ring_copy(r, m, false);
+		} else {
+			bio->bi_status = BLK_STS_IOERR;
+		}
+		if (m->ring_nr_slots)
+			bitmap_clear(r->slots, m->ring_slot, m->ring_nr_slots);
+
+		target_account_done(t, bio);
+		bio_endio(bio);
+		mempool_free(m, &t->message_pool);
+		r->cmp_head++;
+		reaped++;
+	}
+
+	smp_store_release(&r->shared->cmp_head, r->cmp_head);
+	return reaped;
+}
+
+static int channel_ring_post(struct channel *c)
+{
+	struct channel_ring *r = c->ring;
+	struct target *t = target_from_channel(c);
+	int posted = 0;
+
+	lockdep_assert_held(&c->lock);
+
+	mutex_lock(&t->lock);
+	while (r->req_tail - smp_load_acquire(&r->shared->req_head) <
+	       r->nr_entries) {
+		struct dm_user_ring_req *req;
+		unsigned int nr_slots = 0;
+		unsigned long slot = 0;
+		struct message *m;
+
+		if (list_empty(&t->to_user) || t->dm_destroyed)
+			break;
+
+		m = list_first_entry(&t->to_user, struct message, to_user);
+		if (bio_op(m->bio) == REQ_OP_READ ||
+		    bio_op(m->bio) == REQ_OP_WRITE)
+			nr_slots = DIV_ROUND_UP(m->msg.len, r->slot_size);
+
+		if (nr_slots > r->nr_slots) {
+			/* Can never fit in this ring */
+			m = msg_get_to_user(t);
+			message_kill(m, &t->message_pool);
+			continue;
+		}
+		if (nr_slots) {
+			slot = bitmap_find_next_zero_area(r->slots, r->nr_slots,
+							  0, nr_slots, 0);
+			/* Wait for completions to free up the data area */
+			if (slot >= r->nr_slots)
+				break;
+		}
+
+		/* Still the first entry, we haven't dropped the lock */
+		m = msg_get_to_user(t);
+		m->ring_slot = slot;
+		m->ring_nr_slots = nr_slots;
+		if (nr_slots)
+			bitmap_set(r->slots, slot, nr_slots);
+		mutex_unlock(&t->lock);
+
+		if (nr_slots && bio_op(m->bio) == REQ_OP_WRITE)
+			channel_ring_copy(r, m, true);
+
+		req = ring_req(r, r->req_tail);
+		req->seq = m->msg.seq;
+		req->type = m->msg.type;
+		req->flags = m->msg.flags;
+		req->sector = m->msg.sector;
+		req->len = m->msg.len;
+		req->data_off = nr_slots ?
+			r->data_off + (u64)slot * r->slot_size : 0;
+		list_add_tail(&m->from_user, &c->from_user);
+		r->req_tail++;
+		posted++;
+
+		mutex_lock(&t->lock);
+	}
+	mutex_unlock(&t->lock);
+
+	smp_store_release(&r->shared->req_tail, r->req_tail);
+	return posted;
+}
+
+static long channel_ring_enter(struct channel *c, unsigned long flags)
+{
+	struct target *t = target_from_channel(c);
+	int reaped, posted = 0;
+	bool batch = false;
+
+	if (flags & ~DM_USER_RING_ENTER_WAIT)
+		return -EINVAL;
+
+	mutex_lock(&c->lock);
+	if (!c->ring) {
+		mutex_unlock(&c->lock);
+		return -EINVAL;
+	}
+
+	for (;;) {
+		int e;
+
+		reaped = channel_ring_reap(c);
+		if (reaped < 0) {
+			posted = reaped;
+			break;
+		}
+		posted = channel_ring_post(c);
+		if (reaped || posted)
+			batch = true;
+		if (posted || !(flags & DM_USER_RING_ENTER_WAIT))
+			break;
+		if (READ_ONCE(t->dm_destroyed)) {
+			posted = -ENOTBLK;
+			break;
+		}
+		/*
+		 * Only sleep for new bios: if some are already queued, the
+		 * ring or its data area is full and userspace has to
+		 * complete requests first.
+		 */
+		if (target_poll(t))
+			break;
+
+		mutex_unlock(&c->lock);
+		e = wait_event_interruptible(t->wq, target_poll(t));
+		mutex_lock(&c->lock);
+		if (e) {
+			posted = e;
+			break;
+		}
+	}
+	if (batch)
+		atomic64_inc(&t->nr_ring_batches);
+	mutex_unlock(&c->lock);
+	return posted;
+}
+
+static long dev_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
+{
+	struct channel *c = channel_from_file(file);
+
+	switch (cmd) {
+	case DM_USER_IOC_RING_SETUP:
+		return channel_ring_setup(c, (void __user *)arg);
+	case DM_USER_IOC_RING_ENTER:
+		return channel_ring_enter(c, arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct channel *c = channel_from_file(file);
+	int ret = -EINVAL;
+
+	mutex_lock(&c->lock);
+	if (c->ring && vma->vm_pgoff == 0 &&
+	    vma->vm_end - vma->vm_start <= PAGE_ALIGN(c->ring->size))
+		ret = remap_vmalloc_range(vma, c->ring->shared, 0);
+	mutex_unlock(&c->lock);
+	return ret;
+}
+
 static const struct file_operations file_operations = {
 	.owner = THIS_MODULE,
 	.open = dev_open,
 	.llseek = no_llseek,
 	.read_iter = dev_read,
 	.write_iter = dev_write,
+	.unlocked_ioctl = dev_ioctl,
+	.compat_ioctl = compat_ptr_ioctl,
+	.mmap = dev_mmap,
 	.release = dev_release,
 };
 
@@ -1038,6 +1421,13 @@ static int user_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	}
 	ti->private = t;
 
+	t->table_args = kasprintf(GFP_KERNEL, "%s %s %s", argv[0], argv[1],
+				  argv[2]);
+	if (t->table_args == NULL) {
+		r = -ENOMEM;
+		goto cleanup_target;
+	}
+
 	/* Enable more BIO types. */
 	ti->num_discard_bios = 1;
 	ti->discards_supported = true;
@@ -1097,6 +1487,8 @@ static int user_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	kfree(t->miscdev.name);
 cleanup_message_pool:
 	mempool_exit(&t->message_pool);
+	kfree(t->table_args);
+cleanup_target:
 	kfree(t);
 cleanup_none:
 	return r;
@@ -1232,10 +1624,18 @@ static int user_map(struct dm_target *ti, struct bio *bio)
 	entry->total_from_user = bio_bytes_needed_from_user(bio);
 	entry->delayed = false;
 	entry->t = t;
+	entry->ring_slot = 0;
+	entry->ring_nr_slots = 0;
 	/* Pairs with the barrier in dev_read() */
 	smp_wmb();
 	list_add_tail(&entry->to_user, &t->to_user);
 
+	atomic64_inc(&t->nr_bios);
+	if (bio_op(bio) == REQ_OP_READ)
+		atomic64_add(entry->msg.len, &t->read_bytes);
+	else if (bio_op(bio) == REQ_OP_WRITE)
+		atomic64_add(entry->msg.len, &t->write_bytes);
+
 	/*
 	 * If there is no daemon to process the IO's,
 	 * queue these messages into a workqueue with
@@ -1249,13 +1649,45 @@ static int user_map(struct dm_target *ti, struct bio *bio)
 	return DM_MAPIO_SUBMITTED;
 }
 
+/*
+ * INFO status: <bios> <completed> <errors> <read bytes> <write bytes>
+ * <ring batches>, all counted since the target was created.
+ */
+static void user_status(struct dm_target *ti, status_type_t type,
+			unsigned int status_flags, char *result,
+			unsigned int maxlen)
+{
+	struct target *t = target_from_target(ti);
+	int sz = 0;
+
+	switch (type) {
+	case STATUSTYPE_INFO:
+		DMEMIT("%lld %lld %lld %lld %lld %lld",
+		       atomic64_read(&t->nr_bios), atomic64_read(&t->nr_done),
+		       atomic64_read(&t->nr_errors),
+		       atomic64_read(&t->read_bytes),
+		       atomic64_read(&t->write_bytes),
+		       atomic64_read(&t->nr_ring_batches));
+		break;
+
+	case STATUSTYPE_TABLE:
+		DMEMIT("%s", t->table_args);
+		break;
+
+	case STATUSTYPE_IMA:
+		*result = '\0';
+		break;
+	}
+}
+
 static struct target_type user_target = {
 	.name = "user",
-	.version = { 1, 0, 0 },
+	.version = { 1, 1, 0 },
 	.module = THIS_MODULE,
 	.ctr = user_ctr,
 	.dtr = user_dtr,
 	.map = user_map,
+	.status = user_status,
 };
 
 static int __init dm_user_init(void)
@@ -10,7 +10,8 @@
  * default prefetch value. Data are read in "prefetch_cluster" chunks from the
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
- * access behavior.
+ * access behavior.  With "prefetch_adaptive" (the default) the cluster is only
+ * used for readahead bios; other reads prefetch just the blocks they need.
  */
 
 #include "dm-verity.h"
@@ -38,20 +39,35 @@
 #define DM_VERITY_OPT_IGN_ZEROES	"ignore_zero_blocks"
 #define DM_VERITY_OPT_AT_MOST_ONCE	"check_at_most_once"
 #define DM_VERITY_OPT_TASKLET_VERIFY	"try_verify_in_tasklet"
+#define DM_VERITY_OPT_PIN_LEVELS	"pin_hash_levels"
 
-#define DM_VERITY_OPTS_MAX		(4 + DM_VERITY_OPTS_FEC + \
+/* Upper bound on the hash blocks pin_hash_levels may keep in memory */
+#define DM_VERITY_MAX_PINNED_BLOCKS	4096
+
+#define DM_VERITY_OPTS_MAX		(6 + DM_VERITY_OPTS_FEC + \
 					 DM_VERITY_ROOT_HASH_VERIFICATION_OPTS)
 
 static unsigned int dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, 0644);
 
+/*
+ * With adaptive prefetch, only readahead bios get the prefetch_cluster
+ * treatment, extended to cover the next readahead window as well.  Other
+ * (random) reads prefetch just the hash blocks they need, so a scattered
+ * read isn't held up behind a cluster of hash blocks it won't use.
+ */
+static bool dm_verity_prefetch_adaptive = true;
+
+module_param_named(prefetch_adaptive, dm_verity_prefetch_adaptive, bool, 0644);
+
 static DEFINE_STATIC_KEY_FALSE(use_tasklet_enabled);
 
 struct dm_verity_prefetch_work {
 	struct work_struct work;
 	struct dm_verity *v;
 	unsigned short ioprio;
+	bool readahead;
 	sector_t block;
 	unsigned int n_blocks;
 };
@@ -309,9 +325,16 @@ static int verity_verify_level(struct dm_verity *v, struct dm_verity_io *io,
 			 */
 			return -EAGAIN;
 		}
+		this_cpu_inc(v->stats->hash_hits);
 	} else {
-		data = dm_bufio_read_with_ioprio(v->bufio, hash_block,
-						&buf, bio_prio(bio));
+		data = dm_bufio_get(v->bufio, hash_block, &buf);
+		if (data) {
+			this_cpu_inc(v->stats->hash_hits);
+		} else {
+			this_cpu_inc(v->stats->hash_misses);
+			data = dm_bufio_read_with_ioprio(v->bufio, hash_block,
+							&buf, bio_prio(bio));
+		}
 	}
 
 	if (IS_ERR(data))
@@ -562,6 +585,118 @@ static inline void verity_bv_skip_block(struct dm_verity *v,
 	bio_advance_iter(bio, iter, 1 << v->data_dev_block_bits);
 }
 
+/*
+ * Handle a data block whose digest doesn't match: recheck it, try FEC and
+ * otherwise report the corruption.
+ */
+static int verity_handle_data_hash_mismatch(struct dm_verity *v,
+					    struct dm_verity_io *io,
+					    struct bio *bio, sector_t blkno,
+					    struct bvec_iter start)
+{
+	if (static_branch_unlikely(&use_tasklet_enabled) && io->in_tasklet) {
+		/*
+		 * Error handling code (FEC included) cannot be run in a
+		 * tasklet since it may sleep, so fallback to work-queue.
+		 */
+		return -EAGAIN;
+	}
+	if (verity_recheck(v, io, start, blkno) == 0) {
+		if (v->validated_blocks)
+			set_bit(blkno, v->validated_blocks);
+		return 0;
+	}
+#if defined(CONFIG_DM_VERITY_FEC)
+	if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA, blkno,
+			      NULL, &start) == 0)
+		return 0;
+#endif
+	if (bio->bi_status) {
+		/*
+		 * Error correction failed; Just return error
+		 */
+		return -EIO;
+	}
+	if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA, blkno)) {
+		dm_audit_log_bio(DM_MSG_PREFIX, "verify-data", bio, blkno, 0);
+		return -EIO;
+	}
+	return 0;
+}
+
+/*
+ * Can the data block at @iter be queued for multibuffer hashing?  It must
+ * sit in a single bvec, which is the common case of page-sized blocks.
+ */
+static bool verity_can_queue_block(struct dm_verity *v, struct bio *bio,
+				   struct bvec_iter *iter)
+{
+	return v->mb_tfm &&
+	       bio_iter_iovec(bio, *iter).bv_len >= 1 << v->data_dev_block_bits;
+}
+
+static void verity_clear_pending_blocks(struct dm_verity_io *io)
+{
+	int i;
+
+	/* kmap_local mappings must be released in reverse order */
+	for (i = io->num_pending - 1; i >= 0; i--)
+		kunmap_local(io->pending_blocks[i].data);
+	io->num_pending = 0;
+}
+
+/*
+ * Hash the queued data blocks together, then check each digest.
+ */
+static int verity_verify_pending_blocks(struct dm_verity *v,
+					struct dm_verity_io *io,
+					struct bio *bio)
+{
+	SHASH_DESC_ON_STACK(desc, v->mb_tfm);
+	const u8 *data[DM_VERITY_MAX_PENDING_DATA_BLOCKS];
+	u8 *outs[DM_VERITY_MAX_PENDING_DATA_BLOCKS];
+	unsigned int n = io->num_pending;
+	unsigned int i;
+	int r;
+
+	if (!n)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		data[i] = io->pending_blocks[i].data;
+		outs[i] = io->pending_blocks[i].real_digest;
+	}
+	desc->tfm = v->mb_tfm;
+	r = v->mb_hashstate ? crypto_shash_import(desc, v->mb_hashstate) :
+			      crypto_shash_init(desc);
+	if (likely(!r))
+		r = crypto_shash_finup_mb(desc, data,
+					  1 << v->data_dev_block_bits, outs, n);
+	verity_clear_pending_blocks(io);
+	if (unlikely(r)) {
+		DMERR("%s crypto op failed: %d", __func__, r);
+		return r;
+	}
+
+	for (i = 0; i < n; i++) {
+		struct dm_verity_pending_block *block = &io->pending_blocks[i];
+
+		if (likely(memcmp(block->real_digest, block->want_digest,
+				  v->digest_size) == 0)) {
+			if (v->validated_blocks)
+				set_bit(block->blkno, v->validated_blocks);
+			continue;
+		}
+		memcpy(verity_io_want_digest(v, io), block->want_digest,
+		       v->digest_size);
+		r = verity_handle_data_hash_mismatch(v, io, bio, block->blkno,
+						     block->start);
+		if (unlikely(r))
+			return r;
+	}
+	return 0;
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -575,6 +710,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 	struct crypto_wait wait;
 	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_io_data_size);
 	unsigned int b;
+	int r = 0;
 
 	if (static_branch_unlikely(&use_tasklet_enabled) && io->in_tasklet) {
 		/*
@@ -586,8 +722,9 @@ static int verity_verify_io(struct dm_verity_io *io)
 	} else
 		iter = &io->iter;
 
+	io->num_pending = 0;
+
 	for (b = 0; b < io->n_blocks; b++) {
-		int r;
 		sector_t cur_block = io->block + b;
 		struct ahash_request *req = verity_io_hash_req(v, io);
 
@@ -601,7 +738,7 @@ static int verity_verify_io(struct dm_verity_io *io)
 					  verity_io_want_digest(v, io),
 					  &is_zero);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		if (is_zero) {
 			/*
@@ -611,63 +748,69 @@ static int verity_verify_io(struct dm_verity_io *io)
 			r = verity_for_bv_block(v, io, iter,
 						verity_bv_zero);
 			if (unlikely(r < 0))
-				return r;
+				goto out;
 
 			continue;
 		}
 
+		if (verity_can_queue_block(v, bio, iter)) {
+			struct dm_verity_pending_block *block =
+				&io->pending_blocks[io->num_pending];
+			struct bio_vec bv = bio_iter_iovec(bio, *iter);
+
+			block->data = bvec_kmap_local(&bv);
+			block->blkno = cur_block;
+			block->start = *iter;
+			memcpy(block->want_digest, verity_io_want_digest(v, io),
+			       v->digest_size);
+			io->num_pending++;
+			verity_bv_skip_block(v, io, iter);
+			if (io->num_pending == v->mb_max_msgs) {
+				r = verity_verify_pending_blocks(v, io, bio);
+				if (unlikely(r))
+					goto out;
+			}
+			continue;
+		}
+
+		/*
+		 * Don't keep queued blocks mapped while the error handling
+		 * below may sleep.
+		 */
+		r = verity_verify_pending_blocks(v, io, bio);
+		if (unlikely(r))
+			goto out;
+
 		r = verity_hash_init(v, req, &wait, !io->in_tasklet);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		start = *iter;
 		r = verity_for_io_block(v, io, iter, &wait);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		r = verity_hash_final(v, req, verity_io_real_digest(v, io),
 					&wait);
 		if (unlikely(r < 0))
-			return r;
+			goto out;
 
 		if (likely(memcmp(verity_io_real_digest(v, io),
 				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
 			if (v->validated_blocks)
 				set_bit(cur_block, v->validated_blocks);
 			continue;
-		} else if (static_branch_unlikely(&use_tasklet_enabled) &&
-			   io->in_tasklet) {
-			/*
-			 * Error handling code (FEC included) cannot be run in a
-			 * tasklet since it may sleep, so fallback to work-queue.
-			 */
-			return -EAGAIN;
-		} else if (verity_recheck(v, io, start, cur_block) == 0) {
-			if (v->validated_blocks)
-				set_bit(cur_block, v->validated_blocks);
-			continue;
-#if defined(CONFIG_DM_VERITY_FEC)
-		} else if (verity_fec_decode(v, io, DM_VERITY_BLOCK_TYPE_DATA,
-					     cur_block, NULL, &start) == 0) {
-			continue;
-#endif
-		} else {
-			if (bio->bi_status) {
-				/*
-				 * Error correction failed; Just return error
-				 */
-				return -EIO;
-			}
-			if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
-					      cur_block)) {
-				dm_audit_log_bio(DM_MSG_PREFIX, "verify-data",
-						 bio, cur_block, 0);
-				return -EIO;
-			}
 		}
+		r = verity_handle_data_hash_mismatch(v, io, bio, cur_block,
+						     start);
+		if (unlikely(r))
+			goto out;
 	}
 
-	return 0;
+	r = verity_verify_pending_blocks(v, io, bio);
+out:
+	verity_clear_pending_blocks(io);
+	return r;
 }
 
 /*
@@ -743,6 +886,17 @@ static void verity_prefetch_io(struct work_struct *work)
 		if (!i) {
 			unsigned int cluster = READ_ONCE(dm_verity_prefetch_cluster);
 
+			if (READ_ONCE(dm_verity_prefetch_adaptive)) {
+				if (!pw->readahead)
+					goto no_prefetch_cluster;
+				/*
+				 * Readahead windows tend to be followed by one
+				 * of the same size: cover that one too.
+				 */
+				hash_block_end += hash_block_end -
+						  hash_block_start + 1;
+			}
+
 			cluster >>= v->data_dev_block_bits;
 			if (unlikely(!cluster))
 				goto no_prefetch_cluster;
@@ -752,10 +906,10 @@ static void verity_prefetch_io(struct work_struct *work)
 
 			hash_block_start &= ~(sector_t)(cluster - 1);
 			hash_block_end |= cluster - 1;
-			if (unlikely(hash_block_end >= v->hash_blocks))
-				hash_block_end = v->hash_blocks - 1;
 		}
 no_prefetch_cluster:
+		if (unlikely(hash_block_end >= v->hash_blocks))
+			hash_block_end = v->hash_blocks - 1;
 		dm_bufio_prefetch_with_ioprio(v->bufio, hash_block_start,
 					hash_block_end - hash_block_start + 1,
 					pw->ioprio);
@@ -765,7 +919,7 @@ static void verity_prefetch_io(struct work_struct *work)
 }
 
 static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io,
-				   unsigned short ioprio)
+				   unsigned short ioprio, bool readahead)
 {
 	sector_t block = io->block;
 	unsigned int n_blocks = io->n_blocks;
@@ -794,6 +948,7 @@ static void verity_submit_prefetch(struct dm_verity *v, struct dm_verity_io *io,
 	pw->block = block;
 	pw->n_blocks = n_blocks;
 	pw->ioprio = ioprio;
+	pw->readahead = readahead;
 	queue_work(v->verify_wq, &pw->work);
 }
 
@@ -836,7 +991,8 @@ static int verity_map(struct dm_target *ti, struct bio *bio)
 
 	verity_fec_init_io(io);
 
-	verity_submit_prefetch(v, io, bio_prio(bio));
+	verity_submit_prefetch(v, io, bio_prio(bio),
+			       bio->bi_opf & REQ_RAHEAD);
 
 	submit_bio_noacct(bio);
 
@@ -887,6 +1043,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 			args++;
 		if (v->use_tasklet)
 			args++;
+		if (v->pin_levels)
+			args += 2;
 		if (v->signature_key_desc)
 			args += DM_VERITY_ROOT_HASH_VERIFICATION_OPTS;
 		if (!args)
@@ -914,6 +1072,8 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 			DMEMIT(" " DM_VERITY_OPT_AT_MOST_ONCE);
 		if (v->use_tasklet)
 			DMEMIT(" " DM_VERITY_OPT_TASKLET_VERIFY);
+		if (v->pin_levels)
+			DMEMIT(" " DM_VERITY_OPT_PIN_LEVELS " %u", v->pin_levels);
 		sz = verity_fec_status_table(v, sz, result, maxlen);
 		if (v->signature_key_desc)
 			DMEMIT(" " DM_VERITY_ROOT_HASH_VERIFICATION_OPT_SIG_KEY
@@ -997,6 +1157,59 @@ static void verity_io_hints(struct dm_target *ti, struct queue_limits *limits)
 	blk_limits_io_min(limits, limits->logical_block_size);
 }
 
+static void verity_unpin_hash_levels(struct dm_verity *v)
+{
+	unsigned int i;
+
+	for (i = 0; i < v->n_pinned; i++)
+		dm_bufio_release(v->pinned[i]);
+	kvfree(v->pinned);
+	v->pinned = NULL;
+	v->n_pinned = 0;
+}
+
+/*
+ * Read the blocks of the top pin_levels tree levels and keep a reference to
+ * them, so dm-bufio never evicts them and lookups of the upper levels can't
+ * stall on I/O.  They are still verified on first use like any hash block.
+ */
+static int verity_pin_hash_levels(struct dm_verity *v)
+{
+	unsigned int levels = min_t(unsigned int, v->pin_levels, v->levels);
+	sector_t end, block;
+
+	if (!levels)
+		return 0;
+
+	/* The top level comes first on the hash device, see verity_ctr() */
+	end = levels < v->levels ?
+		v->hash_level_block[v->levels - levels - 1] : v->hash_blocks;
+	if (end - v->hash_start > DM_VERITY_MAX_PINNED_BLOCKS) {
+		v->ti->error = "Too many hash blocks to pin";
+		return -E2BIG;
+	}
+
+	v->pinned = kvcalloc(end - v->hash_start, sizeof(*v->pinned),
+			     GFP_KERNEL);
+	if (!v->pinned) {
+		v->ti->error = "Cannot allocate pinned hash blocks";
+		return -ENOMEM;
+	}
+
+	dm_bufio_prefetch(v->bufio, v->hash_start, end - v->hash_start);
+	for (block = v->hash_start; block < end; block++) {
+		void *data = dm_bufio_read(v->bufio, block,
+					   &v->pinned[v->n_pinned]);
+
+		if (IS_ERR(data)) {
+			v->ti->error = "Cannot read hash blocks to pin";
+			return PTR_ERR(data);
+		}
+		v->n_pinned++;
+	}
+	return 0;
+}
+
 static void verity_dtr(struct dm_target *ti)
 {
 	struct dm_verity *v = ti->private;
@@ -1008,8 +1221,10 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->io)
 		dm_io_client_destroy(v->io);
 
+	verity_unpin_hash_levels(v);
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
+	free_percpu(v->stats);
 
 	kvfree(v->validated_blocks);
 	kfree(v->salt);
@@ -1018,6 +1233,9 @@ static void verity_dtr(struct dm_target *ti)
 
 	if (v->tfm)
 		crypto_free_ahash(v->tfm);
+	kfree_sensitive(v->mb_hashstate);
+	if (v->mb_tfm)
+		crypto_free_shash(v->mb_tfm);
 
 	kfree(v->alg_name);
 
@@ -1091,6 +1309,56 @@ static int verity_alloc_zero_digest(struct dm_verity *v)
 	return r;
 }
 
+/*
+ * If the implementation picked for the hash has a multibuffer fast path, also
+ * get it as a shash so data blocks can be hashed several at a time.  This is
+ * only an optimization; any failure just leaves v->mb_tfm NULL.
+ */
+static void verity_setup_mb_hash(struct dm_verity *v)
+{
+	const char *driver = crypto_hash_alg_common(v->tfm)->base.cra_driver_name;
+	struct crypto_shash *tfm;
+
+	/* Version 0 appends the salt, which doesn't fit a shared state */
+	if (v->salt_size && !v->version)
+		return;
+
+	tfm = crypto_alloc_shash(driver, 0, 0);
+	if (IS_ERR(tfm))
+		return;
+	if (crypto_shash_mb_max_msgs(tfm) < 2)
+		goto free_tfm;
+
+	if (v->salt_size) {
+		SHASH_DESC_ON_STACK(desc, tfm);
+
+		v->mb_hashstate = kmalloc(crypto_shash_statesize(tfm),
+					  GFP_KERNEL);
+		if (!v->mb_hashstate)
+			goto free_tfm;
+		desc->tfm = tfm;
+		if (crypto_shash_init(desc) ||
+		    crypto_shash_update(desc, v->salt, v->salt_size) ||
+		    crypto_shash_export(desc, v->mb_hashstate)) {
+			shash_desc_zero(desc);
+			kfree_sensitive(v->mb_hashstate);
+			v->mb_hashstate = NULL;
+			goto free_tfm;
+		}
+		shash_desc_zero(desc);
+	}
+
+	v->mb_tfm = tfm;
+	v->mb_max_msgs = min_t(unsigned int, crypto_shash_mb_max_msgs(tfm),
+			       DM_VERITY_MAX_PENDING_DATA_BLOCKS);
+	DMINFO("%s hashing up to %u data blocks at once", v->alg_name,
+	       v->mb_max_msgs);
+	return;
+
+free_tfm:
+	crypto_free_shash(tfm);
+}
+
 static inline bool verity_is_verity_mode(const char *arg_name)
 {
 	return (!strcasecmp(arg_name, DM_VERITY_OPT_LOGGING) ||
@@ -1170,6 +1438,25 @@ static int verity_parse_opt_args(struct dm_arg_set *as, struct dm_verity *v,
 			static_branch_inc(&use_tasklet_enabled);
 			continue;
 
+		} else if (!strcasecmp(arg_name, DM_VERITY_OPT_PIN_LEVELS)) {
+			unsigned int num;
+			char dummy;
+
+			if (!argc) {
+				ti->error = "Missing " DM_VERITY_OPT_PIN_LEVELS " value";
+				return -EINVAL;
+			}
+			arg_name = dm_shift_arg(as);
+			argc--;
+			if (only_modifier_opts)
+				continue;
+			if (sscanf(arg_name, "%u%c", &num, &dummy) != 1 || !num) {
+				ti->error = "Invalid " DM_VERITY_OPT_PIN_LEVELS " value";
+				return -EINVAL;
+			}
+			v->pin_levels = num;
+			continue;
+
 		} else if (verity_is_fec_opt_arg(arg_name)) {
 			if (only_modifier_opts)
 				continue;
@@ -1477,6 +1764,17 @@ static int verity_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	v->stats = alloc_percpu(struct dm_verity_stats);
+	if (!v->stats) {
+		ti->error = "Cannot allocate stats";
+		r = -ENOMEM;
+		goto bad;
+	}
+
+	r = verity_pin_hash_levels(v);
+	if (r)
+		goto bad;
+
 	/*
 	 * Using WQ_HIGHPRI improves throughput and completion latency by
 	 * reducing wait times when reading from a dm-verity device.
@@ -1493,6 +1791,8 @@ static int verity_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
+	verity_setup_mb_hash(v);
+
 	ti->per_io_data_size = sizeof(struct dm_verity_io) +
 				v->ahash_reqsize + v->digest_size * 2;
 
@@ -1518,6 +1818,30 @@ static int verity_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	return r;
 }
 
+/*
+ * "hash_stats" reports hash block lookups served from dm-bufio (hits) and
+ * those that had to be read from the hash device (misses).
+ */
+static int verity_message(struct dm_target *ti, unsigned int argc, char **argv,
+			  char *result, unsigned int maxlen)
+{
+	struct dm_verity *v = ti->private;
+	unsigned int sz = 0;
+	u64 hits = 0, misses = 0;
+	int cpu;
+
+	if (argc != 1 || strcasecmp(argv[0], "hash_stats"))
+		return -EINVAL;
+
+	for_each_possible_cpu(cpu) {
+		hits += per_cpu_ptr(v->stats, cpu)->hash_hits;
+		misses += per_cpu_ptr(v->stats, cpu)->hash_misses;
+	}
+	DMEMIT("hash_hits=%llu hash_misses=%llu pinned_blocks=%u",
+	       hits, misses, v->n_pinned);
+	return 1;
+}
+
 /*
  * Check whether a DM target is a verity target.
  */
@@ -1567,12 +1891,13 @@ int dm_verity_get_root_digest(struct dm_target *ti, u8 **root_digest, unsigned i
 static struct target_type verity_target = {
 	.name		= "verity",
 	.features	= DM_TARGET_IMMUTABLE,
-	.version	= {1, 9, 0},
+	.version	= {1, 10, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
 	.map		= verity_map,
 	.status		= verity_status,
+	.message	= verity_message,
 	.prepare_ioctl	= verity_prepare_ioctl,
 	.iterate_devices = verity_iterate_devices,
 	.io_hints	= verity_io_hints,
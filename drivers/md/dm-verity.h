@@ -19,6 +19,9 @@
 
 #define DM_VERITY_MAX_LEVELS		63
 
+/* Data blocks hashed together through crypto_shash_finup_mb() */
+#define DM_VERITY_MAX_PENDING_DATA_BLOCKS	2
+
 enum verity_mode {
 	DM_VERITY_MODE_EIO,
 	DM_VERITY_MODE_LOGGING,
@@ -40,6 +43,9 @@ struct dm_verity {
 	struct dm_bufio_client *bufio;
 	char *alg_name;
 	struct crypto_ahash *tfm;
+	struct crypto_shash *mb_tfm;	/* same hash with multibuffer support */
+	u8 *mb_hashstate;	/* mb_tfm state after the salt, or NULL */
+	unsigned int mb_max_msgs;	/* data blocks to hash at once */
 	u8 *root_digest;	/* digest of the root block */
 	u8 *salt;		/* salt: its size is salt_size */
 	u8 *zero_digest;	/* digest for a zero block */
@@ -72,6 +78,19 @@ struct dm_verity {
 
 	struct dm_io_client *io;
 	mempool_t recheck_pool;
+
+	/* buffers of the top pin_levels tree levels, held for the lifetime */
+	unsigned int pin_levels;
+	unsigned int n_pinned;
+	struct dm_buffer **pinned;
+
+	/* hash block lookups that found the block in dm-bufio, or not */
+	struct dm_verity_stats __percpu *stats;
+};
+
+struct dm_verity_stats {
+	u64 hash_hits;
+	u64 hash_misses;
 };
 
 struct dm_verity_io {
@@ -90,6 +109,16 @@ struct dm_verity_io {
 
 	char *recheck_buffer;
 
+	/* Data blocks waiting to be hashed together, see mb_tfm */
+	unsigned int num_pending;
+	struct dm_verity_pending_block {
+		void *data;
+		sector_t blkno;
+		struct bvec_iter start;
+		u8 want_digest[HASH_MAX_DIGESTSIZE];
+		u8 real_digest[HASH_MAX_DIGESTSIZE];
+	} pending_blocks[DM_VERITY_MAX_PENDING_DATA_BLOCKS];
+
 	/*
 	 * Three variably-size fields follow this struct:
 	 *
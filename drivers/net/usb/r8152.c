@@ -28,6 +28,7 @@
 #include <crypto/hash.h>
 #include <linux/usb/r8152.h>
 #include <net/gso.h>
+#include <net/page_pool/helpers.h>
 
 /* Information for net-next */
 #define NETNEXT_VERSION		"12"
@@ -874,6 +875,7 @@ struct r8152 {
 	struct tx_agg tx_info[RTL8152_MAX_TX];
 	struct list_head rx_info, rx_used;
 	struct list_head rx_done, tx_free;
+	struct page_pool *page_pool;	/* rx_agg buffers */
 	struct sk_buff_head tx_queue, rx_queue;
 	spinlock_t rx_lock, tx_lock;
 	struct delayed_work schedule, hw_phy_work;
@@ -2031,7 +2033,8 @@ static void free_rx_agg(struct r8152 *tp, struct rx_agg *agg)
 	list_del(&agg->info_list);
 
 	usb_free_urb(agg->urb);
-	put_page(agg->page);
+	/* Recycled if no skb still holds a fragment of it */
+	page_pool_put_full_page(tp->page_pool, agg->page, false);
 	kfree(agg);
 
 	atomic_dec(&tp->rx_count);
@@ -2041,7 +2044,6 @@ static struct rx_agg *alloc_rx_agg(struct r8152 *tp, gfp_t mflags)
 {
 	struct net_device *netdev = tp->netdev;
 	int node = netdev->dev.parent ? dev_to_node(netdev->dev.parent) : -1;
-	unsigned int order = get_order(tp->rx_buf_sz);
 	struct rx_agg *rx_agg;
 	unsigned long flags;
 
@@ -2049,7 +2051,8 @@ static struct rx_agg *alloc_rx_agg(struct r8152 *tp, gfp_t mflags)
 	if (!rx_agg)
 		return NULL;
 
-	rx_agg->page = alloc_pages(mflags | __GFP_COMP | __GFP_NOWARN, order);
+	rx_agg->page = page_pool_alloc_pages(tp->page_pool,
+					     mflags | __GFP_NOWARN);
 	if (!rx_agg->page)
 		goto free_rx;
 
@@ -2072,7 +2075,7 @@ static struct rx_agg *alloc_rx_agg(struct r8152 *tp, gfp_t mflags)
 	return rx_agg;
 
 free_buf:
-	__free_pages(rx_agg->page, order);
+	page_pool_put_full_page(tp->page_pool, rx_agg->page, false);
 free_rx:
 	kfree(rx_agg);
 	return NULL;
@@ -2093,6 +2096,12 @@ static void free_all_mem(struct r8152 *tp)
 
 	WARN_ON(atomic_read(&tp->rx_count));
 
+	/* Pages still referenced by skbs are released as those are freed */
+	if (tp->page_pool) {
+		page_pool_destroy(tp->page_pool);
+		tp->page_pool = NULL;
+	}
+
 	for (i = 0; i < RTL8152_MAX_TX; i++) {
 		usb_free_urb(tp->tx_info[i].urb);
 		tp->tx_info[i].urb = NULL;
@@ -2115,10 +2124,24 @@ static int alloc_all_mem(struct r8152 *tp)
 	struct usb_interface *intf = tp->intf;
 	struct usb_host_interface *alt = intf->cur_altsetting;
 	struct usb_host_endpoint *ep_intr = alt->endpoint + 2;
+	struct page_pool_params pp_params = {};
 	int node, i;
 
 	node = netdev->dev.parent ? dev_to_node(netdev->dev.parent) : -1;
 
+	/* The URB buffers are mapped by the host controller driver, so the
+	 * pool only caches the high order pages freed by rtl_get_free_rx()
+	 * and rtl_stop_rx() instead of returning them to the page allocator.
+	 */
+	pp_params.order = get_order(tp->rx_buf_sz);
+	pp_params.pool_size = tp->rx_pending;
+	pp_params.nid = node;
+	tp->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(tp->page_pool)) {
+		tp->page_pool = NULL;
+		return -ENOMEM;
+	}
+
 	spin_lock_init(&tp->rx_lock);
 	spin_lock_init(&tp->tx_lock);
 	INIT_LIST_HEAD(&tp->rx_info);
@@ -8846,7 +8869,8 @@ static int rtl8152_get_sset_count(struct net_device *dev, int sset)
 {
 	switch (sset) {
 	case ETH_SS_STATS:
-		return ARRAY_SIZE(rtl8152_gstrings);
+		return ARRAY_SIZE(rtl8152_gstrings) +
+		       page_pool_ethtool_stats_get_count();
 	default:
 		return -EOPNOTSUPP;
 	}
@@ -8878,6 +8902,17 @@ static void rtl8152_get_ethtool_stats(struct net_device *dev,
 	data[10] = le32_to_cpu(tally.rx_multicast);
 	data[11] = le16_to_cpu(tally.tx_aborted);
 	data[12] = le16_to_cpu(tally.tx_underrun);
+
+#ifdef CONFIG_PAGE_POOL_STATS
+	{
+		struct page_pool_stats pp_stats = {};
+
+		if (tp->page_pool)
+			page_pool_get_stats(tp->page_pool, &pp_stats);
+		page_pool_ethtool_stats_get(&data[ARRAY_SIZE(rtl8152_gstrings)],
+					    &pp_stats);
+	}
+#endif
 }
 
 static void rtl8152_get_strings(struct net_device *dev, u32 stringset, u8 *data)
@@ -8885,6 +8920,7 @@ static void rtl8152_get_strings(struct net_device *dev, u32 stringset, u8 *data)
 	switch (stringset) {
 	case ETH_SS_STATS:
 		memcpy(data, rtl8152_gstrings, sizeof(rtl8152_gstrings));
+		page_pool_ethtool_stats_get_strings(data + sizeof(rtl8152_gstrings));
 		break;
 	}
 }
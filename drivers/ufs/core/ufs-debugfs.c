@@ -57,6 +57,41 @@ static int ufs_debugfs_stats_show(struct seq_file *s, void *data)
 }
 DEFINE_SHOW_ATTRIBUTE(ufs_debugfs_stats);
 
+static int ufs_debugfs_hwq_stats_show(struct seq_file *s, void *data)
+{
+	struct ufs_hba *hba = hba_from_file(s->file);
+	struct ufs_hwq_stats *stats = ufshcd_priv(hba)->hwq_stats;
+	unsigned int i;
+
+	if (!stats)
+		return -ENODEV;
+
+	seq_puts(s, "hwq submitted completed cancelled max_depth avg_lat_us max_lat_us cpus\n");
+	for (i = 0; i < hba->nr_hw_queues; i++) {
+		struct ufs_hwq_stats *st = &stats[i];
+		u64 completed = READ_ONCE(st->completed);
+
+		seq_printf(s, "%u %llu %llu %llu %u %llu %llu %*pbl\n", i,
+			   READ_ONCE(st->submitted), completed,
+			   READ_ONCE(st->cancelled), READ_ONCE(st->max_depth),
+			   completed ? div64_u64(READ_ONCE(st->lat_sum_us),
+						 completed) : 0,
+			   READ_ONCE(st->lat_max_us), cpumask_pr_args(&st->cpus));
+	}
+
+	seq_puts(s, "\nhwq poll_calls poll_hits\n");
+	for (i = 0; i < hba->nr_hw_queues; i++) {
+		struct ufs_hwq_stats *st = &stats[i];
+
+		if (!READ_ONCE(st->poll_calls))
+			continue;
+		seq_printf(s, "%u %llu %llu\n", i,
+			   READ_ONCE(st->poll_calls), READ_ONCE(st->poll_hits));
+	}
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(ufs_debugfs_hwq_stats);
+
 static int ee_usr_mask_get(void *data, u64 *val)
 {
 	struct ufs_hba *hba = data;
@@ -204,6 +239,7 @@ static const struct file_operations ufs_saved_err_fops = {
 
 static const struct ufs_debugfs_attr ufs_attrs[] = {
 	{ "stats", 0400, &ufs_debugfs_stats_fops },
+	{ "hwq_stats", 0400, &ufs_debugfs_hwq_stats_fops },
 	{ "saved_err", 0600, &ufs_saved_err_fops },
 	{ "saved_uic_err", 0600, &ufs_saved_err_fops },
 	{ }
@@ -16,6 +16,7 @@
 #include <scsi/scsi_cmnd.h>
 #include <linux/bitfield.h>
 #include <linux/iopoll.h>
+#include <linux/topology.h>
 
 #define MAX_QUEUE_SUP GENMASK(7, 0)
 #define UFS_MCQ_MIN_RW_QUEUES 2
@@ -80,6 +81,11 @@ module_param_cb(poll_queues, &poll_queue_count_ops, &poll_queues, 0644);
 MODULE_PARM_DESC(poll_queues,
 		 "Number of poll queues used for r/w. Default value is 1");
 
+static bool cluster_queues;
+module_param(cluster_queues, bool, 0644);
+MODULE_PARM_DESC(cluster_queues,
+		 "Map hardware queues to CPU clusters instead of the default blk-mq spread. Default value is false");
+
 /**
  * ufshcd_mcq_config_mac - Set the #Max Activ Cmds.
  * @hba: per adapter instance
@@ -281,6 +287,7 @@ static void ufshcd_mcq_process_cqe(struct ufs_hba *hba,
 	int tag = ufshcd_mcq_get_tag(hba, hwq, cqe);
 
 	if (cqe->command_desc_base_addr) {
+		ufshcd_mcq_account_compl(hba, hwq, &hba->lrb[tag]);
 		ufshcd_compl_one_cqe(hba, tag, cqe);
 		/* After processed the cqe, mark it empty (invalid) entry */
 		cqe->command_desc_base_addr = 0;
@@ -327,6 +334,29 @@ unsigned long ufshcd_mcq_poll_cqe_lock(struct ufs_hba *hba,
 }
 EXPORT_SYMBOL_GPL(ufshcd_mcq_poll_cqe_lock);
 
+/**
+ * ufshcd_mcq_poll - poll a hardware queue for completions on behalf of blk-mq
+ * @hba: per adapter instance
+ * @queue_num: index of the hardware queue
+ *
+ * Return: the number of completed requests.
+ */
+int ufshcd_mcq_poll(struct ufs_hba *hba, unsigned int queue_num)
+{
+	struct ufs_hw_queue *hwq = &hba->uhq[queue_num];
+	struct ufs_hwq_stats *stats = ufshcd_hwq_stats(hba, hwq);
+	unsigned long completed;
+
+	completed = ufshcd_mcq_poll_cqe_lock(hba, hwq);
+
+	if (stats) {
+		stats->poll_calls++;
+		if (completed)
+			stats->poll_hits++;
+	}
+	return completed;
+}
+
 void ufshcd_mcq_make_queues_operational(struct ufs_hba *hba)
 {
 	struct ufs_hw_queue *hwq;
@@ -406,10 +436,110 @@ void ufshcd_mcq_config_esi(struct ufs_hba *hba, struct msi_msg *msg)
 }
 EXPORT_SYMBOL_GPL(ufshcd_mcq_config_esi);
 
+/**
+ * ufshcd_mcq_map_clusters - assign the queues of one map type to CPU clusters
+ * @hba: per adapter instance
+ * @nr_queues: number of queues of the map type
+ * @offset: index of the first queue of the map type
+ *
+ * Each cluster gets a share of the queues proportional to its number of CPUs,
+ * and its CPUs are spread round-robin over that share only.  Clusters only
+ * share queues if there are fewer queues than clusters.
+ */
+static void ufshcd_mcq_map_clusters(struct ufs_hba *hba,
+				    unsigned int nr_queues, unsigned int offset)
+{
+	struct ufs_hwq_stats *stats = ufshcd_priv(hba)->hwq_stats + offset;
+	unsigned int rem_queues = nr_queues, rem_cpus = num_possible_cpus();
+	unsigned int first = 0, shared = 0, cpu, c;
+	cpumask_var_t left;
+
+	if (!nr_queues || !zalloc_cpumask_var(&left, GFP_KERNEL))
+		return;
+
+	cpumask_copy(left, cpu_possible_mask);
+	while ((cpu = cpumask_first(left)) < nr_cpu_ids) {
+		const struct cpumask *cluster = topology_cluster_cpumask(cpu);
+		unsigned int weight, nr, i = 0;
+
+		if (!cpumask_test_cpu(cpu, cluster))
+			cluster = cpumask_of(cpu);
+		weight = cpumask_weight_and(cluster, left);
+
+		if (rem_queues) {
+			nr = DIV_ROUND_CLOSEST(rem_queues * weight, rem_cpus);
+			nr = clamp(nr, 1U, rem_queues);
+		} else {
+			first = shared++ % nr_queues;
+			nr = 1;
+		}
+
+		for_each_cpu_and(c, cluster, left)
+			cpumask_set_cpu(c, &stats[first + i++ % nr].cpus);
+		cpumask_andnot(left, left, cluster);
+
+		if (rem_queues) {
+			first += nr;
+			rem_queues -= nr;
+		}
+		rem_cpus -= weight;
+	}
+
+	free_cpumask_var(left);
+}
+
+/**
+ * ufshcd_mcq_map_queues - map CPUs to the hardware queues of a queue map
+ * @hba: per adapter instance
+ * @map: queue map with nr_queues and queue_offset set up
+ *
+ * Return: true if @map was filled in from the cluster mapping, false if the
+ * caller should fall back to the default blk-mq mapping.
+ */
+bool ufshcd_mcq_map_queues(struct ufs_hba *hba, struct blk_mq_queue_map *map)
+{
+	struct ufs_hwq_stats *stats = ufshcd_priv(hba)->hwq_stats;
+	unsigned int i, cpu;
+
+	if (!stats || !ufshcd_priv(hba)->cluster_map)
+		return false;
+
+	for (i = map->queue_offset; i < map->queue_offset + map->nr_queues; i++)
+		for_each_cpu(cpu, &stats[i].cpus)
+			map->mq_map[cpu] = i;
+	return true;
+}
+
+/**
+ * ufshcd_mcq_hwq_affinity - CPUs a hardware queue is mapped to
+ * @hba: per adapter instance
+ * @hwq_id: index of the hardware queue
+ *
+ * Host drivers may steer the ESI vector of a queue to these CPUs from their
+ * config_esi() callback, so completions are handled by the cluster which
+ * submitted the requests.  Only valid once ufshcd_mcq_init() has run.
+ *
+ * Return: the CPUs mapped to @hwq_id, or NULL if queues are not mapped per
+ * cluster.
+ */
+const struct cpumask *ufshcd_mcq_hwq_affinity(struct ufs_hba *hba, int hwq_id)
+{
+	struct ufs_hwq_stats *stats = ufshcd_priv(hba)->hwq_stats;
+
+	if (!stats || !ufshcd_priv(hba)->cluster_map ||
+	    hwq_id >= hba->nr_hw_queues ||
+	    cpumask_empty(&stats[hwq_id].cpus))
+		return NULL;
+	return &stats[hwq_id].cpus;
+}
+EXPORT_SYMBOL_GPL(ufshcd_mcq_hwq_affinity);
+
 int ufshcd_mcq_init(struct ufs_hba *hba)
 {
+	struct ufs_hba_priv *priv = ufshcd_priv(hba);
 	struct Scsi_Host *host = hba->host;
 	struct ufs_hw_queue *hwq;
+	unsigned int offset = 0;
 	int ret, i;
 
 	ret = ufshcd_mcq_config_nr_queues(hba);
@@ -442,6 +572,24 @@ int ufshcd_mcq_init(struct ufs_hba *hba)
 		mutex_init(&hwq->sq_mutex);
 	}
 
+	priv->hwq_stats = devm_kcalloc(hba->dev, hba->nr_hw_queues,
+				       sizeof(*priv->hwq_stats), GFP_KERNEL);
+	if (!priv->hwq_stats) {
+		dev_err(hba->dev, "ufs hw queue stats allocation failed\n");
+		return -ENOMEM;
+	}
+
+	/*
+	 * Set up the cluster mapping before config_esi() runs, so host drivers
+	 * can set the ESI affinity from it.  Same queue order as
+	 * ufshcd_map_queues().
+	 */
+	priv->cluster_map = cluster_queues;
+	for (i = 0; priv->cluster_map && i < HCTX_MAX_TYPES; i++) {
+		ufshcd_mcq_map_clusters(hba, hba->nr_queues[i], offset);
+		offset += hba->nr_queues[i];
+	}
+
 	/* The very first HW queue serves device commands */
 	hba->dev_cmd_queue = &hba->uhq[0];
 
@@ -671,8 +819,10 @@ int ufshcd_mcq_abort(struct scsi_cmnd *cmd)
 
 	err = SUCCESS;
 	spin_lock_irqsave(&hwq->cq_lock, flags);
-	if (ufshcd_cmd_inflight(lrbp->cmd))
+	if (ufshcd_cmd_inflight(lrbp->cmd)) {
 		ufshcd_release_scsi_cmd(hba, lrbp);
+		ufshcd_mcq_account_cancel(hba, hwq);
+	}
 	spin_unlock_irqrestore(&hwq->cq_lock, flags);
 
 out:
@@ -4,6 +4,7 @@
 #include <linux/err.h>
 #include <linux/string.h>
 #include <linux/bitfield.h>
+#include <linux/sizes.h>
 #include <asm/unaligned.h>
 
 #include <ufs/ufs.h>
@@ -628,6 +629,262 @@ static const struct attribute_group ufs_sysfs_monitor_group = {
 	.attrs = ufs_sysfs_monitor_attrs,
 };
 
+static ssize_t boost_enable_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", ufshcd_clk_boost(hba)->enabled);
+}
+
+static ssize_t boost_enable_store(struct device *dev,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags;
+	bool value;
+
+	if (kstrtobool(buf, &value))
+		return -EINVAL;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	ufshcd_clk_boost(hba)->enabled = value;
+	if (!value)
+		ufshcd_clk_boost(hba)->hold_until = 0;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+#define UFS_CLK_BOOST_PARAM(_name, _field, _scale)			\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct ufs_hba *hba = dev_get_drvdata(dev);			\
+									\
+	return sysfs_emit(buf, "%u\n",					\
+			  ufshcd_clk_boost(hba)->_field / (_scale));	\
+}									\
+									\
+static ssize_t _name##_store(struct device *dev,			\
+			     struct device_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	struct ufs_hba *hba = dev_get_drvdata(dev);			\
+	unsigned long flags;						\
+	u32 value;							\
+									\
+	if (kstrtou32(buf, 0, &value) || !value ||			\
+	    value > U32_MAX / (_scale))					\
+		return -EINVAL;						\
+									\
+	spin_lock_irqsave(hba->host->host_lock, flags);			\
+	ufshcd_clk_boost(hba)->_field = value * (_scale);		\
+	spin_unlock_irqrestore(hba->host->host_lock, flags);		\
+									\
+	return count;							\
+}									\
+static DEVICE_ATTR_RW(_name)
+
+UFS_CLK_BOOST_PARAM(boost_queue_depth, queue_depth, 1);
+UFS_CLK_BOOST_PARAM(boost_read_kb, read_bytes, SZ_1K);
+UFS_CLK_BOOST_PARAM(boost_hold_ms, hold_ms, 1);
+
+static ssize_t time_in_gear_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	u64 gear_time_us[UFSHCD_GEAR_STATS_MAX];
+	ssize_t len = 0;
+	int i;
+
+	ufshcd_clk_boost_gear_time(hba, gear_time_us);
+
+	len += sysfs_emit_at(buf, len, "PWM %llu\n",
+			     div_u64(gear_time_us[0], USEC_PER_MSEC));
+	for (i = 1; i < UFSHCD_GEAR_STATS_MAX; i++)
+		len += sysfs_emit_at(buf, len, "HS-G%d %llu\n", i,
+				     div_u64(gear_time_us[i], USEC_PER_MSEC));
+	return len;
+}
+
+static DEVICE_ATTR_RW(boost_enable);
+static DEVICE_ATTR_RO(time_in_gear);
+
+static struct attribute *ufs_sysfs_clk_scaling_attrs[] = {
+	&dev_attr_boost_enable.attr,
+	&dev_attr_boost_queue_depth.attr,
+	&dev_attr_boost_read_kb.attr,
+	&dev_attr_boost_hold_ms.attr,
+	&dev_attr_time_in_gear.attr,
+	NULL
+};
+
+static umode_t ufs_sysfs_clk_scaling_is_visible(struct kobject *kobj,
+						struct attribute *attr, int n)
+{
+	struct ufs_hba *hba = dev_get_drvdata(kobj_to_dev(kobj));
+
+	/* The gear statistics don't depend on clock scaling */
+	if (attr == &dev_attr_time_in_gear.attr ||
+	    ufshcd_is_clkscaling_supported(hba))
+		return attr->mode;
+	return 0;
+}
+
+/*
+ * Event-driven boost of the clocks and gear on top of devfreq, and the time
+ * spent in each gear ("PWM" for all non-HS modes), in milliseconds.
+ */
+static const struct attribute_group ufs_sysfs_clk_scaling_group = {
+	.name = "clk_scaling",
+	.attrs = ufs_sysfs_clk_scaling_attrs,
+	.is_visible = ufs_sysfs_clk_scaling_is_visible,
+};
+
+static ssize_t policy_enable_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", READ_ONCE(ufshcd_wb_policy(hba)->enabled));
+}
+
+static ssize_t policy_enable_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	bool value;
+
+	if (kstrtobool(buf, &value))
+		return -EINVAL;
+
+	ufshcd_wb_policy_enable(hba, value);
+	return count;
+}
+
+static ssize_t thermal_throttle_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n",
+			  READ_ONCE(ufshcd_wb_policy(hba)->thermal_user));
+}
+
+static ssize_t thermal_throttle_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+	bool value;
+
+	if (kstrtobool(buf, &value))
+		return -EINVAL;
+
+	WRITE_ONCE(policy->thermal_user, value);
+	if (value && READ_ONCE(policy->enabled))
+		mod_delayed_work(system_freezable_wq, &policy->work, 0);
+	return count;
+}
+
+#define UFS_WB_POLICY_PARAM(_name, _field, _max)			\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct ufs_hba *hba = dev_get_drvdata(dev);			\
+									\
+	return sysfs_emit(buf, "%u\n",					\
+			  READ_ONCE(ufshcd_wb_policy(hba)->_field));	\
+}									\
+									\
+static ssize_t _name##_store(struct device *dev,			\
+			     struct device_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	struct ufs_hba *hba = dev_get_drvdata(dev);			\
+	u32 value;							\
+									\
+	if (kstrtou32(buf, 0, &value) || !value || value > (_max))	\
+		return -EINVAL;						\
+									\
+	WRITE_ONCE(ufshcd_wb_policy(hba)->_field, value);		\
+	return count;							\
+}									\
+static DEVICE_ATTR_RW(_name)
+
+UFS_WB_POLICY_PARAM(period_ms, period_ms, 60 * MSEC_PER_SEC);
+UFS_WB_POLICY_PARAM(idle_ms, idle_ms, 60 * MSEC_PER_SEC);
+UFS_WB_POLICY_PARAM(flush_threshold, flush_threshold,
+		    UFS_WB_BUF_REMAIN_PERCENT(100));
+UFS_WB_POLICY_PARAM(thermal_hold_ms, thermal_hold_ms, 600 * MSEC_PER_SEC);
+
+static ssize_t buf_used_pct_show(struct device *dev,
+				 struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+	u32 avail = min_t(u32, READ_ONCE(policy->avail_buf), 10);
+	u32 min_avail = min_t(u32, READ_ONCE(policy->min_avail_buf), 10);
+
+	/* The device reports the available buffer in steps of 10% */
+	return sysfs_emit(buf, "%u %u\n", 100 - avail * 10,
+			  100 - min_avail * 10);
+}
+
+static ssize_t flush_stats_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+
+	return sysfs_emit(buf, "flushes %llu\nflush_time_ms %llu\nio_stops %llu\nthermal_stops %llu\n",
+			  READ_ONCE(policy->nr_flushes),
+			  READ_ONCE(policy->flush_time_ms),
+			  READ_ONCE(policy->nr_io_stops),
+			  READ_ONCE(policy->nr_thermal_stops));
+}
+
+static struct device_attribute dev_attr_policy_enable =
+	__ATTR(enable, 0644, policy_enable_show, policy_enable_store);
+static DEVICE_ATTR_RW(thermal_throttle);
+static DEVICE_ATTR_RO(buf_used_pct);
+static DEVICE_ATTR_RO(flush_stats);
+
+static struct attribute *ufs_sysfs_wb_policy_attrs[] = {
+	&dev_attr_policy_enable.attr,
+	&dev_attr_period_ms.attr,
+	&dev_attr_idle_ms.attr,
+	&dev_attr_flush_threshold.attr,
+	&dev_attr_thermal_hold_ms.attr,
+	&dev_attr_thermal_throttle.attr,
+	&dev_attr_buf_used_pct.attr,
+	&dev_attr_flush_stats.attr,
+	NULL
+};
+
+static umode_t ufs_sysfs_wb_policy_is_visible(struct kobject *kobj,
+					      struct attribute *attr, int n)
+{
+	struct ufs_hba *hba = dev_get_drvdata(kobj_to_dev(kobj));
+
+	return ufshcd_is_wb_allowed(hba) ? attr->mode : 0;
+}
+
+/*
+ * WriteBooster buffer flush policy: flush_threshold is the available buffer
+ * level, in units of 10%, at which an idle host starts flushing.
+ * buf_used_pct shows the last and the highest buffer use the policy saw.
+ */
+static const struct attribute_group ufs_sysfs_wb_policy_group = {
+	.name = "wb_policy",
+	.attrs = ufs_sysfs_wb_policy_attrs,
+	.is_visible = ufs_sysfs_wb_policy_is_visible,
+};
+
 static ssize_t ufs_sysfs_read_desc_param(struct ufs_hba *hba,
 				  enum desc_idn desc_id,
 				  u8 desc_index,
@@ -1233,6 +1490,8 @@ static const struct attribute_group *ufs_sysfs_groups[] = {
 	&ufs_sysfs_default_group,
 	&ufs_sysfs_capabilities_group,
 	&ufs_sysfs_monitor_group,
+	&ufs_sysfs_clk_scaling_group,
+	&ufs_sysfs_wb_policy_group,
 	&ufs_sysfs_device_descriptor_group,
 	&ufs_sysfs_interconnect_descriptor_group,
 	&ufs_sysfs_geometry_descriptor_group,
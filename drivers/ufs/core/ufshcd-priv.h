@@ -6,6 +6,239 @@
 #include <linux/pm_runtime.h>
 #include <ufs/ufshcd.h>
 
+/* Gears tracked by the time-in-state statistics; 0 stands for PWM mode */
+#define UFSHCD_GEAR_STATS_MAX		8
+
+/* Length of the window over which read bytes are summed for a boost */
+#define UFSHCD_CLK_BOOST_WINDOW_US	10000
+
+/**
+ * struct ufs_clk_boost - event-driven clock and gear scale-up
+ * @hba: the host this belongs to
+ * @boost_work: calls into devfreq to scale up outside of the I/O path
+ * @enabled: whether a burst of I/O may scale up right away
+ * @scaled_down: whether clocks and gear are currently scaled down
+ * @queue_depth: outstanding requests which trigger a scale-up
+ * @read_bytes: bytes read within a window which trigger a scale-up
+ * @hold_ms: time after the last trigger during which devfreq may not scale
+ *	     down again
+ * @window_start: start of the current read byte window
+ * @window_read_bytes: bytes read within the current window
+ * @hold_until: devfreq may only scale down after this time
+ * @reason: what triggered the last scale-up, for tracing
+ * @stats_lock: protects the gear statistics below
+ * @cur_gear: gear the time since @gear_since is accounted to
+ * @gear_since: time of the last gear change or statistics update
+ * @gear_time_us: time spent in each gear
+ *
+ * devfreq only samples the busy time every polling interval, so a launch burst
+ * can be over before the gear goes up.  Instead, the submission path asks for
+ * a scale-up as soon as the queue depth or read volume says a burst started.
+ * Protected by the host lock unless noted otherwise.
+ */
+struct ufs_clk_boost {
+	struct ufs_hba *hba;
+	struct work_struct boost_work;
+	bool enabled;
+	bool scaled_down;
+	u32 queue_depth;
+	u32 read_bytes;
+	u32 hold_ms;
+	ktime_t window_start;
+	u64 window_read_bytes;
+	ktime_t hold_until;
+	const char *reason;
+
+	spinlock_t stats_lock;
+	u8 cur_gear;
+	ktime_t gear_since;
+	u64 gear_time_us[UFSHCD_GEAR_STATS_MAX];
+};
+
+/**
+ * struct ufs_hwq_stats - per MCQ hardware queue mapping and statistics
+ * @cpus: CPUs submitting on this queue, only set up by the cluster mapping
+ * @submitted: requests submitted, protected by the SQ lock
+ * @max_depth: highest number of outstanding requests, protected by the SQ lock
+ * @completed: requests completed through a CQE, protected by the CQ lock
+ * @cancelled: requests released without a CQE, protected by the CQ lock
+ * @lat_sum_us: sum of the completion latencies of @completed
+ * @lat_max_us: highest completion latency
+ * @poll_calls: number of ->mq_poll() calls on this queue
+ * @poll_hits: ->mq_poll() calls that completed at least one request
+ *
+ * The poll fields are updated without locking by the tasks polling the queue.
+ * They are approximate if several tasks poll one queue at the same time.
+ */
+struct ufs_hwq_stats {
+	struct cpumask cpus;
+	u64 submitted;
+	u32 max_depth;
+	u64 completed;
+	u64 cancelled;
+	u64 lat_sum_us;
+	u64 lat_max_us;
+	u64 poll_calls;
+	u64 poll_hits;
+};
+
+/**
+ * struct ufs_wb_policy - WriteBooster buffer flush policy
+ * @hba: host the policy runs for
+ * @work: periodic policy evaluation
+ * @enabled: whether the policy rather than the device controls flushing
+ * @period_ms: interval between evaluations
+ * @idle_ms: time without new commands after which the host counts as idle
+ * @flush_threshold: start flushing at or below this available buffer level,
+ *	in units of 10%
+ * @thermal_hold_ms: how long a too-high-temperature exception suspends
+ *	flushing
+ * @thermal_user: flushing suspended from user space
+ * @thermal_until: flushing suspended by the device until this time (jiffies)
+ * @last_cmd: time of the last command (jiffies), updated locklessly
+ * @flush_start: time the current flush started (jiffies)
+ * @avail_buf: last read dAvailableWriteBoosterBufferSize
+ * @min_avail_buf: lowest dAvailableWriteBoosterBufferSize seen
+ * @nr_flushes: number of flushes started by the policy
+ * @nr_io_stops: flushes stopped because of foreground I/O
+ * @nr_thermal_stops: flushes stopped because of the device temperature
+ * @flush_time_ms: total time spent flushing
+ *
+ * The device flushes the WriteBooster buffer by itself only in hibernate, or
+ * all the time once fWriteBoosterBufferFlushEn is set.  The policy sets that
+ * flag while the host is idle and the buffer is getting full, and clears it
+ * again as soon as commands come in or the device reports that it is too
+ * hot.  Everything but @last_cmd is only changed by @work or from sysfs.
+ */
+struct ufs_wb_policy {
+	struct ufs_hba *hba;
+	struct delayed_work work;
+	bool enabled;
+	u32 period_ms;
+	u32 idle_ms;
+	u32 flush_threshold;
+	u32 thermal_hold_ms;
+	bool thermal_user;
+	unsigned long thermal_until;
+	unsigned long last_cmd;
+	unsigned long flush_start;
+	u32 avail_buf;
+	u32 min_avail_buf;
+	u64 nr_flushes;
+	u64 nr_io_stops;
+	u64 nr_thermal_stops;
+	u64 flush_time_ms;
+};
+
+/**
+ * struct ufs_hba_priv - core private per host state
+ * @clk_boost: event-driven clock scaling state
+ * @hwq_stats: one entry per MCQ hardware queue, NULL in SDB mode
+ * @cluster_map: whether hardware queues are mapped per CPU cluster
+ * @wb_policy: WriteBooster buffer flush policy
+ *
+ * This lives right behind struct ufs_hba in the SCSI host private data; see
+ * ufshcd_alloc_host().
+ */
+struct ufs_hba_priv {
+	struct ufs_clk_boost clk_boost;
+	struct ufs_hwq_stats *hwq_stats;
+	bool cluster_map;
+	struct ufs_wb_policy wb_policy;
+};
+
+static inline struct ufs_hba_priv *ufshcd_priv(struct ufs_hba *hba)
+{
+	return (struct ufs_hba_priv *)(hba + 1);
+}
+
+static inline struct ufs_clk_boost *ufshcd_clk_boost(struct ufs_hba *hba)
+{
+	return &ufshcd_priv(hba)->clk_boost;
+}
+
+static inline struct ufs_wb_policy *ufshcd_wb_policy(struct ufs_hba *hba)
+{
+	return &ufshcd_priv(hba)->wb_policy;
+}
+
+static inline struct ufs_hwq_stats *ufshcd_hwq_stats(struct ufs_hba *hba,
+						     struct ufs_hw_queue *hwq)
+{
+	struct ufs_hwq_stats *stats = ufshcd_priv(hba)->hwq_stats;
+
+	return stats ? &stats[hwq - hba->uhq] : NULL;
+}
+
+/* Called with the SQ lock of @hwq held */
+static inline void ufshcd_mcq_account_submit(struct ufs_hba *hba,
+					     struct ufs_hw_queue *hwq)
+{
+	struct ufs_hwq_stats *stats = ufshcd_hwq_stats(hba, hwq);
+	u32 depth;
+
+	if (!stats)
+		return;
+	stats->submitted++;
+	depth = stats->submitted - READ_ONCE(stats->completed) -
+		READ_ONCE(stats->cancelled);
+	if (depth > stats->max_depth)
+		stats->max_depth = depth;
+}
+
+/* Called with the CQ lock of @hwq held, before @lrbp is completed */
+static inline void ufshcd_mcq_account_compl(struct ufs_hba *hba,
+					    struct ufs_hw_queue *hwq,
+					    struct ufshcd_lrb *lrbp)
+{
+	struct ufs_hwq_stats *stats = ufshcd_hwq_stats(hba, hwq);
+	u64 lat;
+
+	if (!stats)
+		return;
+	lat = ktime_us_delta(ktime_get(), lrbp->issue_time_stamp);
+	WRITE_ONCE(stats->completed, stats->completed + 1);
+	stats->lat_sum_us += lat;
+	if (lat > stats->lat_max_us)
+		stats->lat_max_us = lat;
+}
+
+/* Called with the CQ lock of @hwq held */
+static inline void ufshcd_mcq_account_cancel(struct ufs_hba *hba,
+					     struct ufs_hw_queue *hwq)
+{
+	struct ufs_hwq_stats *stats = ufshcd_hwq_stats(hba, hwq);
+
+	if (stats)
+		WRITE_ONCE(stats->cancelled, stats->cancelled + 1);
+}
+
+void ufshcd_wb_policy_enable(struct ufs_hba *hba, bool enable);
+
+/* Called for each new SCSI command */
+static inline void ufshcd_wb_policy_note_cmd(struct ufs_hba *hba)
+{
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+
+	if (READ_ONCE(policy->last_cmd) != jiffies)
+		WRITE_ONCE(policy->last_cmd, jiffies);
+	/* Get the device back to foreground work right away */
+	if (READ_ONCE(policy->enabled) && hba->dev_info.wb_buf_flush_enabled)
+		mod_delayed_work(system_freezable_wq, &policy->work, 0);
+}
+
+static inline void ufshcd_wb_policy_thermal(struct ufs_hba *hba)
+{
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+
+	WRITE_ONCE(policy->thermal_until,
+		   jiffies + msecs_to_jiffies(policy->thermal_hold_ms));
+	if (READ_ONCE(policy->enabled))
+		mod_delayed_work(system_freezable_wq, &policy->work, 0);
+}
+void ufshcd_clk_boost_gear_time(struct ufs_hba *hba,
+				u64 gear_time_us[UFSHCD_GEAR_STATS_MAX]);
+
 static inline bool ufshcd_is_user_access_allowed(struct ufs_hba *hba)
 {
 	return !hba->shutting_down;
@@ -64,6 +297,9 @@ void ufshcd_auto_hibern8_update(struct ufs_hba *hba, u32 ahit);
 void ufshcd_compl_one_cqe(struct ufs_hba *hba, int task_tag,
 			  struct cq_entry *cqe);
 int ufshcd_mcq_init(struct ufs_hba *hba);
+bool ufshcd_mcq_map_queues(struct ufs_hba *hba, struct blk_mq_queue_map *map);
+/* For host drivers setting up ESI interrupt affinity */
+const struct cpumask *ufshcd_mcq_hwq_affinity(struct ufs_hba *hba, int hwq_id);
 int ufshcd_mcq_decide_queue_depth(struct ufs_hba *hba);
 int ufshcd_mcq_memory_alloc(struct ufs_hba *hba);
 void ufshcd_mcq_make_queues_operational(struct ufs_hba *hba);
@@ -72,6 +308,7 @@ u32 ufshcd_mcq_read_cqis(struct ufs_hba *hba, int i);
 void ufshcd_mcq_write_cqis(struct ufs_hba *hba, u32 val, int i);
 struct ufs_hw_queue *ufshcd_mcq_req_to_hwq(struct ufs_hba *hba,
 					   struct request *req);
+int ufshcd_mcq_poll(struct ufs_hba *hba, unsigned int queue_num);
 unsigned long ufshcd_mcq_poll_cqe_lock(struct ufs_hba *hba,
 				       struct ufs_hw_queue *hwq);
 void ufshcd_mcq_compl_all_cqes_lock(struct ufs_hba *hba,
@@ -315,7 +315,9 @@ static void ufshcd_configure_wb(struct ufs_hba *hba)
 
 	ufshcd_wb_toggle_buf_flush_during_h8(hba, true);
 
-	if (ufshcd_is_wb_buf_flush_allowed(hba))
+	/* With the flush policy enabled, flushing is up to the policy */
+	if (ufshcd_is_wb_buf_flush_allowed(hba) &&
+	    !READ_ONCE(ufshcd_wb_policy(hba)->enabled))
 		ufshcd_wb_toggle_buf_flush(hba, true);
 }
 
@@ -1347,6 +1349,8 @@ static int ufshcd_devfreq_scale(struct ufs_hba *hba, bool scale_up)
 	}
 
 out_unprepare:
+	if (!ret)
+		WRITE_ONCE(ufshcd_clk_boost(hba)->scaled_down, !scale_up);
 	ufshcd_clock_scaling_unprepare(hba, ret, scale_up);
 	return ret;
 }
@@ -1386,6 +1390,31 @@ static void ufshcd_clk_scaling_resume_work(struct work_struct *work)
 	devfreq_resume_device(hba->devfreq);
 }
 
+/*
+ * Scale up for a burst that ufshcd_clk_boost_check() noticed, rather than
+ * waiting for the next devfreq polling interval.  update_devfreq() ends up in
+ * ufshcd_devfreq_target(), which keeps the clocks up while the boost holds.
+ */
+static void ufshcd_clk_scaling_boost_work(struct work_struct *work)
+{
+	struct ufs_clk_boost *boost =
+		container_of(work, struct ufs_clk_boost, boost_work);
+	struct ufs_hba *hba = boost->hba;
+	struct devfreq *devfreq = hba->devfreq;
+	unsigned long irq_flags;
+
+	if (devfreq) {
+		mutex_lock(&devfreq->lock);
+		update_devfreq(devfreq);
+		mutex_unlock(&devfreq->lock);
+	}
+
+	/* Allow the next burst to ask again even if nothing was scaled */
+	spin_lock_irqsave(hba->host->host_lock, irq_flags);
+	boost->reason = NULL;
+	spin_unlock_irqrestore(hba->host->host_lock, irq_flags);
+}
+
 static int ufshcd_devfreq_target(struct device *dev,
 				unsigned long *freq, u32 flags)
 {
@@ -1395,6 +1424,8 @@ static int ufshcd_devfreq_target(struct device *dev,
 	bool scale_up, sched_clk_scaling_suspend_work = false;
 	struct list_head *clk_list = &hba->clk_list_head;
 	struct ufs_clk_info *clki;
+	struct ufs_clk_boost *boost = ufshcd_clk_boost(hba);
+	const char *reason;
 	unsigned long irq_flags;
 
 	if (!ufshcd_is_clkscaling_supported(hba))
@@ -1426,6 +1457,14 @@ static int ufshcd_devfreq_target(struct device *dev,
 
 	/* Decide based on the rounded-off frequency and update */
 	scale_up = *freq == clki->max_freq;
+	reason = boost->reason ?: "busy time";
+	boost->reason = NULL;
+	/* Don't scale down in the middle of a burst that asked for a boost */
+	if (!scale_up && ktime_before(ktime_get(), boost->hold_until)) {
+		*freq = clki->max_freq;
+		scale_up = true;
+		reason = "boost hold";
+	}
 	if (!scale_up)
 		*freq = clki->min_freq;
 	/* Update the frequency */
@@ -1436,6 +1475,10 @@ static int ufshcd_devfreq_target(struct device *dev,
 	}
 	spin_unlock_irqrestore(hba->host->host_lock, irq_flags);
 
+	trace_ufshcd_clk_scaling_reason(dev_name(hba->dev),
+		(scale_up ? "up" : "down"), reason,
+		hba->clk_scaling.active_reqs, boost->window_read_bytes);
+
 	start = ktime_get();
 	ret = ufshcd_devfreq_scale(hba, scale_up);
 
@@ -1655,6 +1698,7 @@ static void ufshcd_remove_clk_scaling_sysfs(struct ufs_hba *hba)
 
 static void ufshcd_init_clk_scaling(struct ufs_hba *hba)
 {
+	struct ufs_clk_boost *boost = ufshcd_clk_boost(hba);
 	char wq_name[sizeof("ufs_clkscaling_00")];
 
 	if (!ufshcd_is_clkscaling_supported(hba))
@@ -1668,6 +1712,12 @@ static void ufshcd_init_clk_scaling(struct ufs_hba *hba)
 	INIT_WORK(&hba->clk_scaling.resume_work,
 		  ufshcd_clk_scaling_resume_work);
 
+	INIT_WORK(&boost->boost_work, ufshcd_clk_scaling_boost_work);
+	boost->queue_depth = 8;
+	boost->read_bytes = SZ_1M;
+	boost->hold_ms = 100;
+	boost->enabled = true;
+
 	snprintf(wq_name, sizeof(wq_name), "ufs_clkscaling_%d",
 		 hba->host->host_no);
 	hba->clk_scaling.workq = create_singlethread_workqueue(wq_name);
@@ -1681,6 +1731,7 @@ static void ufshcd_exit_clk_scaling(struct ufs_hba *hba)
 		return;
 
 	ufshcd_remove_clk_scaling_sysfs(hba);
+	cancel_work_sync(&ufshcd_clk_boost(hba)->boost_work);
 	destroy_workqueue(hba->clk_scaling.workq);
 	ufshcd_devfreq_remove(hba);
 	hba->clk_scaling.is_initialized = false;
@@ -2034,7 +2085,49 @@ static void ufshcd_exit_clk_gating(struct ufs_hba *hba)
 	destroy_workqueue(hba->clk_gating.clk_gating_workq);
 }
 
-static void ufshcd_clk_scaling_start_busy(struct ufs_hba *hba)
+/*
+ * Called with the host lock held for each new command.  Asks for a scale-up as
+ * soon as the queue depth or the bytes read over a short window show that a
+ * burst started, and keeps devfreq from scaling down while the burst lasts.
+ */
+static void ufshcd_clk_boost_check(struct ufs_hba *hba, struct scsi_cmnd *cmd,
+				   ktime_t now)
+{
+	struct ufs_clk_boost *boost = ufshcd_clk_boost(hba);
+	struct request *rq = scsi_cmd_to_rq(cmd);
+	const char *reason = NULL;
+
+	if (!boost->enabled)
+		return;
+
+	if (req_op(rq) == REQ_OP_READ) {
+		if (ktime_us_delta(now, boost->window_start) >
+		    UFSHCD_CLK_BOOST_WINDOW_US) {
+			boost->window_start = now;
+			boost->window_read_bytes = 0;
+		}
+		boost->window_read_bytes += blk_rq_bytes(rq);
+		if (boost->window_read_bytes >= boost->read_bytes)
+			reason = "read bytes";
+	}
+	if (hba->clk_scaling.active_reqs >= boost->queue_depth)
+		reason = "queue depth";
+	if (!reason)
+		return;
+
+	boost->hold_until = ktime_add_ms(now, boost->hold_ms);
+	if (READ_ONCE(boost->scaled_down) && !boost->reason) {
+		boost->reason = reason;
+		trace_ufshcd_clk_scaling_reason(dev_name(hba->dev), "boost",
+						reason,
+						hba->clk_scaling.active_reqs,
+						boost->window_read_bytes);
+		queue_work(hba->clk_scaling.workq, &boost->boost_work);
+	}
+}
+
+static void ufshcd_clk_scaling_start_busy(struct ufs_hba *hba,
+					  struct scsi_cmnd *cmd)
 {
 	bool queue_resume_work = false;
 	ktime_t curr_t = ktime_get();
@@ -2066,6 +2159,8 @@ static void ufshcd_clk_scaling_start_busy(struct ufs_hba *hba)
 		hba->clk_scaling.busy_start_t = curr_t;
 		hba->clk_scaling.is_busy_started = true;
 	}
+
+	ufshcd_clk_boost_check(hba, cmd, curr_t);
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
 }
 
@@ -2171,8 +2266,10 @@ void ufshcd_send_command(struct ufs_hba *hba, unsigned int task_tag,
 	lrbp->compl_time_stamp_local_clock = 0;
 	trace_android_vh_ufs_send_command(hba, lrbp);
 	ufshcd_add_command_trace(hba, task_tag, UFS_CMD_SEND);
-	if (lrbp->cmd)
-		ufshcd_clk_scaling_start_busy(hba);
+	if (lrbp->cmd) {
+		ufshcd_clk_scaling_start_busy(hba, lrbp->cmd);
+		ufshcd_wb_policy_note_cmd(hba);
+	}
 	if (unlikely(ufshcd_should_inform_monitor(hba, lrbp)))
 		ufshcd_start_monitor(hba, lrbp);
 
@@ -2185,6 +2282,7 @@ void ufshcd_send_command(struct ufs_hba *hba, unsigned int task_tag,
 		dest = hwq->sqe_base_addr + hwq->sq_tail_slot;
 		memcpy(dest, src, utrd_size);
 		ufshcd_inc_sq_tail(hwq);
+		ufshcd_mcq_account_submit(hba, hwq);
 		spin_unlock(&hwq->sq_lock);
 	} else {
 		spin_lock_irqsave(&hba->outstanding_lock, flags);
@@ -2793,7 +2891,8 @@ static void ufshcd_map_queues(struct Scsi_Host *shost)
 		if (i == HCTX_TYPE_POLL && !is_mcq_supported(hba))
 			map->queue_offset = 0;
 
-		blk_mq_map_queues(map);
+		if (!ufshcd_mcq_map_queues(hba, map))
+			blk_mq_map_queues(map);
 		queue_offset += map->nr_queues;
 	}
 }
@@ -4447,6 +4546,29 @@ static int ufshcd_get_max_pwr_mode(struct ufs_hba *hba)
 	return 0;
 }
 
+static u8 ufshcd_gear_stats_idx(const struct ufs_pa_layer_attr *pwr_info)
+{
+	if (pwr_info->pwr_rx != FAST_MODE && pwr_info->pwr_rx != FASTAUTO_MODE)
+		return 0;
+	return min_t(u32, pwr_info->gear_rx, UFSHCD_GEAR_STATS_MAX - 1);
+}
+
+/* Account the time spent in the old gear before switching to @pwr_mode. */
+static void ufshcd_update_gear_stats(struct ufs_hba *hba,
+				     const struct ufs_pa_layer_attr *pwr_mode)
+{
+	struct ufs_clk_boost *boost = ufshcd_clk_boost(hba);
+	ktime_t now = ktime_get();
+	unsigned long flags;
+
+	spin_lock_irqsave(&boost->stats_lock, flags);
+	boost->gear_time_us[boost->cur_gear] +=
+		ktime_us_delta(now, boost->gear_since);
+	boost->gear_since = now;
+	boost->cur_gear = ufshcd_gear_stats_idx(pwr_mode);
+	spin_unlock_irqrestore(&boost->stats_lock, flags);
+}
+
 static int ufshcd_change_power_mode(struct ufs_hba *hba,
 			     struct ufs_pa_layer_attr *pwr_mode)
 {
@@ -4528,6 +4650,7 @@ static int ufshcd_change_power_mode(struct ufs_hba *hba,
 		ufshcd_vops_pwr_change_notify(hba, POST_CHANGE, NULL,
 								pwr_mode);
 
+		ufshcd_update_gear_stats(hba, pwr_mode);
 		memcpy(&hba->pwr_info, pwr_mode,
 			sizeof(struct ufs_pa_layer_attr));
 	}
@@ -4535,6 +4658,25 @@ static int ufshcd_change_power_mode(struct ufs_hba *hba,
 	return ret;
 }
 
+/**
+ * ufshcd_clk_boost_gear_time - get the time spent in each gear
+ * @hba: per-adapter instance
+ * @gear_time_us: filled with the time in microseconds spent in each HS gear,
+ *	with index 0 used for all non-HS power modes
+ */
+void ufshcd_clk_boost_gear_time(struct ufs_hba *hba,
+				u64 gear_time_us[UFSHCD_GEAR_STATS_MAX])
+{
+	struct ufs_clk_boost *boost = ufshcd_clk_boost(hba);
+	unsigned long flags;
+
+	spin_lock_irqsave(&boost->stats_lock, flags);
+	memcpy(gear_time_us, boost->gear_time_us, sizeof(boost->gear_time_us));
+	gear_time_us[boost->cur_gear] += ktime_us_delta(ktime_get(),
+							boost->gear_since);
+	spin_unlock_irqrestore(&boost->stats_lock, flags);
+}
+
 /**
  * ufshcd_config_pwr_mode - configure a new power mode
  * @hba: per-adapter instance
@@ -5487,13 +5629,9 @@ static int ufshcd_poll(struct Scsi_Host *shost, unsigned int queue_num)
 	struct ufs_hba *hba = shost_priv(shost);
 	unsigned long completed_reqs, flags;
 	u32 tr_doorbell;
-	struct ufs_hw_queue *hwq;
 
-	if (is_mcq_enabled(hba)) {
-		hwq = &hba->uhq[queue_num];
-
-		return ufshcd_mcq_poll_cqe_lock(hba, hwq);
-	}
+	if (is_mcq_enabled(hba))
+		return ufshcd_mcq_poll(hba, queue_num);
 
 	spin_lock_irqsave(&hba->outstanding_lock, flags);
 	tr_doorbell = ufshcd_readl(hba, REG_UTP_TRANSFER_REQ_DOOR_BELL);
@@ -5556,6 +5694,7 @@ static void ufshcd_mcq_compl_pending_transfer(struct ufs_hba *hba,
 				spin_lock_irqsave(&hwq->cq_lock, flags);
 				set_host_byte(cmd, DID_REQUEUE);
 				ufshcd_release_scsi_cmd(hba, lrbp);
+				ufshcd_mcq_account_cancel(hba, hwq);
 				scsi_done(cmd);
 				spin_unlock_irqrestore(&hwq->cq_lock, flags);
 			}
@@ -5895,6 +6034,9 @@ static void ufshcd_temp_exception_event_handler(struct ufs_hba *hba, u16 status)
 
 	dev_info(hba->dev, "exception Tcase %d\n", value - 80);
 
+	if (status & MASK_EE_TOO_HIGH_TEMP)
+		ufshcd_wb_policy_thermal(hba);
+
 	ufs_hwmon_notify_event(hba, status & MASK_EE_URGENT_TEMP);
 
 	/*
@@ -6081,6 +6223,119 @@ static bool ufshcd_wb_need_flush(struct ufs_hba *hba)
 	return ufshcd_wb_presrv_usrspc_keep_vcc_on(hba, avail_buf);
 }
 
+/*
+ * Flush the WriteBooster buffer while the host is idle and the buffer is
+ * getting full, and stop as soon as commands come in or the device gets too
+ * hot.  A runtime suspended device is left alone, it flushes in hibernate
+ * anyway.
+ */
+static void ufshcd_wb_policy_work(struct work_struct *work)
+{
+	struct ufs_wb_policy *policy = container_of(to_delayed_work(work),
+						    struct ufs_wb_policy, work);
+	struct ufs_hba *hba = policy->hba;
+	bool flushing, busy, hot;
+	struct device *wlun;
+	u32 avail_buf;
+	u8 index;
+
+	if (!READ_ONCE(policy->enabled) || !ufshcd_is_wb_allowed(hba))
+		return;
+	if (!hba->ufs_device_wlun)
+		goto resched;
+	wlun = &hba->ufs_device_wlun->sdev_gendev;
+	if (pm_runtime_get_if_active(wlun, true) <= 0)
+		goto resched;
+
+	down(&hba->host_sem);
+	if (!ufshcd_is_user_access_allowed(hba))
+		goto out;
+
+	index = ufshcd_wb_get_query_index(hba);
+	if (ufshcd_query_attr_retry(hba, UPIU_QUERY_OPCODE_READ_ATTR,
+				    QUERY_ATTR_IDN_AVAIL_WB_BUFF_SIZE,
+				    index, 0, &avail_buf))
+		goto out;
+	policy->avail_buf = avail_buf;
+	if (avail_buf < policy->min_avail_buf)
+		policy->min_avail_buf = avail_buf;
+
+	busy = time_before(jiffies, READ_ONCE(policy->last_cmd) +
+				    msecs_to_jiffies(policy->idle_ms));
+	hot = policy->thermal_user ||
+	      time_before(jiffies, READ_ONCE(policy->thermal_until));
+	flushing = hba->dev_info.wb_buf_flush_enabled;
+
+	if (flushing && (busy || hot ||
+			 avail_buf >= UFS_WB_BUF_REMAIN_PERCENT(100))) {
+		if (ufshcd_wb_toggle_buf_flush(hba, false))
+			goto out;
+		policy->flush_time_ms +=
+			jiffies_to_msecs(jiffies - policy->flush_start);
+		if (hot)
+			policy->nr_thermal_stops++;
+		else if (busy)
+			policy->nr_io_stops++;
+	} else if (!flushing && !busy && !hot &&
+		   avail_buf <= policy->flush_threshold) {
+		if (ufshcd_wb_toggle_buf_flush(hba, true))
+			goto out;
+		policy->flush_start = jiffies;
+		policy->nr_flushes++;
+	}
+
+out:
+	up(&hba->host_sem);
+	pm_runtime_put(wlun);
+resched:
+	if (READ_ONCE(policy->enabled))
+		queue_delayed_work(system_freezable_wq, &policy->work,
+				   msecs_to_jiffies(policy->period_ms));
+}
+
+/**
+ * ufshcd_wb_policy_enable - hand WriteBooster buffer flushing to the policy
+ * @hba: per adapter instance
+ * @enable: true to let the policy flush, false to go back to the
+ *	    fWriteBoosterBufferFlushEn setting made at probe time
+ */
+void ufshcd_wb_policy_enable(struct ufs_hba *hba, bool enable)
+{
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+
+	WRITE_ONCE(policy->enabled, enable);
+	if (enable) {
+		mod_delayed_work(system_freezable_wq, &policy->work, 0);
+		return;
+	}
+
+	cancel_delayed_work_sync(&policy->work);
+	down(&hba->host_sem);
+	if (ufshcd_is_user_access_allowed(hba)) {
+		ufshcd_rpm_get_sync(hba);
+		if (hba->dev_info.wb_buf_flush_enabled)
+			policy->flush_time_ms +=
+				jiffies_to_msecs(jiffies - policy->flush_start);
+		ufshcd_wb_toggle_buf_flush(hba,
+					   ufshcd_is_wb_buf_flush_allowed(hba));
+		ufshcd_rpm_put_sync(hba);
+	}
+	up(&hba->host_sem);
+}
+
+static void ufshcd_wb_policy_init(struct ufs_hba *hba)
+{
+	struct ufs_wb_policy *policy = ufshcd_wb_policy(hba);
+
+	policy->hba = hba;
+	INIT_DELAYED_WORK(&policy->work, ufshcd_wb_policy_work);
+	policy->period_ms = 100;
+	policy->idle_ms = 500;
+	policy->flush_threshold = UFS_WB_BUF_REMAIN_PERCENT(50);
+	policy->thermal_hold_ms = 30 * MSEC_PER_SEC;
+	policy->min_avail_buf = UFS_WB_BUF_REMAIN_PERCENT(100);
+}
+
 static void ufshcd_rpm_dev_flush_recheck_work(struct work_struct *work)
 {
 	struct ufs_hba *hba = container_of(to_delayed_work(work),
@@ -10169,6 +10424,8 @@ void ufshcd_remove(struct ufs_hba *hba)
 	ufs_hwmon_remove(hba);
 	ufs_bsg_remove(hba);
 	ufs_sysfs_remove_nodes(hba->dev);
+	WRITE_ONCE(ufshcd_wb_policy(hba)->enabled, false);
+	cancel_delayed_work_sync(&ufshcd_wb_policy(hba)->work);
 	blk_mq_destroy_queue(hba->tmf_queue);
 	blk_put_queue(hba->tmf_queue);
 	blk_mq_free_tag_set(&hba->tmf_tag_set);
@@ -10277,7 +10534,8 @@ int ufshcd_alloc_host(struct device *dev, struct ufs_hba **hba_handle)
 	}
 
 	host = scsi_host_alloc(&ufshcd_driver_template,
-				sizeof(struct ufs_hba));
+				sizeof(struct ufs_hba) +
+				sizeof(struct ufs_hba_priv));
 	if (!host) {
 		dev_err(dev, "scsi_host_alloc failed\n");
 		err = -ENOMEM;
@@ -10292,6 +10550,10 @@ int ufshcd_alloc_host(struct device *dev, struct ufs_hba **hba_handle)
 	ufshcd_set_sg_entry_size(hba, sizeof(struct ufshcd_sg_entry));
 	INIT_LIST_HEAD(&hba->clk_list_head);
 	spin_lock_init(&hba->outstanding_lock);
+	ufshcd_clk_boost(hba)->hba = hba;
+	spin_lock_init(&ufshcd_clk_boost(hba)->stats_lock);
+	ufshcd_clk_boost(hba)->gear_since = ktime_get();
+	ufshcd_wb_policy_init(hba);
 
 	*hba_handle = hba;
 
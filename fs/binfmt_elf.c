@@ -47,6 +47,7 @@
 #include <linux/dax.h>
 #include <linux/uaccess.h>
 #include <linux/rseq.h>
+#include <linux/xattr.h>
 #include <asm/param.h>
 #include <asm/page.h>
 
@@ -364,6 +365,43 @@ create_elf_tables(struct linux_binprm *bprm, const struct elfhdr *exec,
 	return 0;
 }
 
+/*
+ * Executables and interpreters carrying this xattr get their text mapped
+ * from the page cache at exec time, rather than one fault at a time while
+ * the process starts.
+ */
+#define ELF_PREFAULT_XATTR	XATTR_TRUSTED_PREFIX "exec_prefault"
+
+static bool prefault_text = true;
+module_param(prefault_text, bool, 0644);
+
+static bool elf_wants_prefault(struct file *file)
+{
+	if (!READ_ONCE(prefault_text))
+		return false;
+
+	return __vfs_getxattr(file_dentry(file), file_inode(file),
+			      ELF_PREFAULT_XATTR, NULL, 0) >= 0;
+}
+
+/* Map the cached pages of the segment @eppnt, which elf_map() put at @addr */
+static void elf_prefault(struct file *filep, unsigned long addr,
+		const struct elf_phdr *eppnt)
+{
+	unsigned long size = eppnt->p_filesz + ELF_PAGEOFFSET(eppnt->p_vaddr);
+	unsigned long end = addr + ELF_PAGEALIGN(size);
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	VMA_ITERATOR(vmi, mm, addr);
+
+	mmap_read_lock(mm);
+	for_each_vma_range(vmi, vma, end) {
+		if (vma->vm_file == filep)
+			vma_map_cached_pages(vma, addr, end);
+	}
+	mmap_read_unlock(mm);
+}
+
 static unsigned long elf_map(struct file *filep, unsigned long addr,
 		const struct elf_phdr *eppnt, int prot, int type,
 		unsigned long total_size)
@@ -597,6 +635,7 @@ static unsigned long load_elf_interp(struct elfhdr *interp_elf_ex,
 	int bss_prot = 0;
 	unsigned long error = ~0UL;
 	unsigned long total_size;
+	bool prefault;
 	int i;
 
 	/* First of all, some simple consistency checks */
@@ -616,6 +655,8 @@ static unsigned long load_elf_interp(struct elfhdr *interp_elf_ex,
 		goto out;
 	}
 
+	prefault = elf_wants_prefault(interpreter);
+
 	eppnt = interp_elf_phdata;
 	for (i = 0; i < interp_elf_ex->e_phnum; i++, eppnt++) {
 		if (eppnt->p_type == PT_LOAD) {
@@ -638,6 +679,9 @@ static unsigned long load_elf_interp(struct elfhdr *interp_elf_ex,
 			if (BAD_ADDR(map_addr))
 				goto out;
 
+			if (prefault && (eppnt->p_flags & PF_X))
+				elf_prefault(interpreter, map_addr, eppnt);
+
 			if (!load_addr_set &&
 			    interp_elf_ex->e_type == ET_DYN) {
 				load_addr = map_addr - ELF_PAGESTART(vaddr);
@@ -828,6 +872,7 @@ static int load_elf_binary(struct linux_binprm *bprm)
 	unsigned long elf_bss, elf_brk;
 	int bss_prot = 0;
 	int retval, i;
+	bool prefault;
 	unsigned long elf_entry;
 	unsigned long e_entry;
 	unsigned long interp_load_addr = 0;
@@ -1025,6 +1070,8 @@ static int load_elf_binary(struct linux_binprm *bprm)
 	start_data = 0;
 	end_data = 0;
 
+	prefault = elf_wants_prefault(bprm->file);
+
 	/* Now we do a little grungy work by mmapping the ELF image into
 	   the correct location in memory. */
 	for(i = 0, elf_ppnt = elf_phdata;
@@ -1167,6 +1214,9 @@ static int load_elf_binary(struct linux_binprm *bprm)
 			goto out_free_dentry;
 		}
 
+		if (prefault && (elf_ppnt->p_flags & PF_X))
+			elf_prefault(bprm->file, error, elf_ppnt);
+
 		if (first_pt_load) {
 			first_pt_load = 0;
 			if (elf_ex->e_type == ET_DYN) {
@@ -409,6 +409,10 @@ int fscrypt_prepare_inline_crypt_key(struct fscrypt_prepared_key *prep_key,
 				     bool is_hw_wrapped,
 				     const struct fscrypt_inode_info *ci);
 
+void fscrypt_prime_inline_crypt_key(struct super_block *sb,
+				    struct fscrypt_prepared_key *prep_key,
+				    bool pin);
+
 void fscrypt_destroy_inline_crypt_key(struct super_block *sb,
 				      struct fscrypt_prepared_key *prep_key);
 
@@ -461,6 +465,13 @@ fscrypt_prepare_inline_crypt_key(struct fscrypt_prepared_key *prep_key,
 	return -EOPNOTSUPP;
 }
 
+static inline void
+fscrypt_prime_inline_crypt_key(struct super_block *sb,
+			       struct fscrypt_prepared_key *prep_key,
+			       bool pin)
+{
+}
+
 static inline void
 fscrypt_destroy_inline_crypt_key(struct super_block *sb,
 				 struct fscrypt_prepared_key *prep_key)
@@ -509,6 +520,13 @@ struct fscrypt_master_key_secret {
 	 */
 	bool			is_hw_wrapped;
 
+	/*
+	 * True if the inline encryption keys derived from this key should be
+	 * pinned in the keyslots of the filesystem's block devices, e.g.
+	 * because this is the key of the user in the foreground.
+	 */
+	bool			pin_inline_keys;
+
 	/*
 	 * Size of the raw key in bytes.  This remains set even if ->raw was
 	 * zeroized due to no longer being needed.  I.e. we still remember the
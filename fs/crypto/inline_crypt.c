@@ -212,6 +212,32 @@ int fscrypt_prepare_inline_crypt_key(struct fscrypt_prepared_key *prep_key,
 	return err;
 }
 
+/*
+ * Program a shared (per-mode) blk-crypto key into the keyslots of all the
+ * filesystem's block devices right away, rather than on the first read of the
+ * first file that uses it.  If @pin is true, also keep it from being evicted
+ * by other keys until it's destroyed.  Failures are harmless: I/O will program
+ * the key.
+ */
+void fscrypt_prime_inline_crypt_key(struct super_block *sb,
+				    struct fscrypt_prepared_key *prep_key,
+				    bool pin)
+{
+	struct block_device **devs;
+	unsigned int num_devs;
+	unsigned int i;
+
+	devs = fscrypt_get_devices(sb, &num_devs);
+	if (IS_ERR(devs))
+		return;
+	for (i = 0; i < num_devs; i++) {
+		if (pin && blk_crypto_pin_key(devs[i], prep_key->blk_key) == 0)
+			continue;
+		blk_crypto_prime_key(devs[i], prep_key->blk_key);
+	}
+	kfree(devs);
+}
+
 void fscrypt_destroy_inline_crypt_key(struct super_block *sb,
 				      struct fscrypt_prepared_key *prep_key)
 {
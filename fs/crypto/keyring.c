@@ -747,11 +747,15 @@ int fscrypt_ioctl_add_key(struct file *filp, void __user *_uarg)
 	memset(&secret, 0, sizeof(secret));
 
 	if (arg.__flags) {
-		if (arg.__flags & ~__FSCRYPT_ADD_KEY_FLAG_HW_WRAPPED)
+		if (arg.__flags & ~(__FSCRYPT_ADD_KEY_FLAG_HW_WRAPPED |
+				    __FSCRYPT_ADD_KEY_FLAG_PIN_INLINE_KEYS))
 			return -EINVAL;
 		if (arg.key_spec.type != FSCRYPT_KEY_SPEC_TYPE_IDENTIFIER)
 			return -EINVAL;
-		secret.is_hw_wrapped = true;
+		secret.is_hw_wrapped =
+			arg.__flags & __FSCRYPT_ADD_KEY_FLAG_HW_WRAPPED;
+		secret.pin_inline_keys =
+			arg.__flags & __FSCRYPT_ADD_KEY_FLAG_PIN_INLINE_KEYS;
 	}
 
 	if (arg.key_id) {
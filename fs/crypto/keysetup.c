@@ -238,7 +238,7 @@ static int setup_per_mode_enc_key(struct fscrypt_inode_info *ci,
 						       ci);
 		if (err)
 			goto out_unlock;
-		goto done_unlock;
+		goto prepared;
 	}
 
 	BUILD_BUG_ON(sizeof(mode_num) != 1);
@@ -259,6 +259,11 @@ static int setup_per_mode_enc_key(struct fscrypt_inode_info *ci,
 	memzero_explicit(mode_key, mode->keysize);
 	if (err)
 		goto out_unlock;
+prepared:
+	/* This key is shared by every file with this policy, load it now */
+	if (fscrypt_using_inline_encryption(ci))
+		fscrypt_prime_inline_crypt_key(inode->i_sb, prep_key,
+					       mk->mk_secret.pin_inline_keys);
 done_unlock:
 	ci->ci_enc_key = *prep_key;
 	err = 0;
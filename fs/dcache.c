@@ -127,6 +127,16 @@ struct dentry_stat_t {
 static DEFINE_PER_CPU(long, nr_dentry);
 static DEFINE_PER_CPU(long, nr_dentry_unused);
 static DEFINE_PER_CPU(long, nr_dentry_negative);
+static DEFINE_PER_CPU(long, nr_dentry_negative_hits);
+static DEFINE_PER_CPU(long, nr_dentry_negative_misses);
+static DEFINE_PER_CPU(long, nr_dentry_negative_pruned);
+
+/*
+ * Maximum number of unused negative dentries per superblock, 0 for no limit.
+ * Beyond this, the oldest negative dentries of the superblock are pruned
+ * without touching its positive ones.
+ */
+static unsigned long dentry_negative_limit __read_mostly;
 
 #if defined(CONFIG_SYSCTL) && defined(CONFIG_PROC_FS)
 /* Statistics gathering. */
@@ -183,6 +193,34 @@ static int proc_nr_dentry(struct ctl_table *table, int write, void *buffer,
 	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
 }
 
+/*
+ * Negative dentry lookup hits, lookups which had to create a new negative
+ * dentry, and negative dentries pruned to stay within the limit.
+ */
+static long dentry_negative_stat[3];
+
+static long get_nr_dentry_negative_stat(long __percpu *counter)
+{
+	int i;
+	long sum = 0;
+
+	for_each_possible_cpu(i)
+		sum += per_cpu(*counter, i);
+	return sum < 0 ? 0 : sum;
+}
+
+static int proc_dentry_negative_stat(struct ctl_table *table, int write,
+				     void *buffer, size_t *lenp, loff_t *ppos)
+{
+	dentry_negative_stat[0] =
+		get_nr_dentry_negative_stat(&nr_dentry_negative_hits);
+	dentry_negative_stat[1] =
+		get_nr_dentry_negative_stat(&nr_dentry_negative_misses);
+	dentry_negative_stat[2] =
+		get_nr_dentry_negative_stat(&nr_dentry_negative_pruned);
+	return proc_doulongvec_minmax(table, write, buffer, lenp, ppos);
+}
+
 static struct ctl_table fs_dcache_sysctls[] = {
 	{
 		.procname	= "dentry-state",
@@ -191,6 +229,20 @@ static struct ctl_table fs_dcache_sysctls[] = {
 		.mode		= 0444,
 		.proc_handler	= proc_nr_dentry,
 	},
+	{
+		.procname	= "negative-dentry-state",
+		.data		= &dentry_negative_stat,
+		.maxlen		= sizeof(dentry_negative_stat),
+		.mode		= 0444,
+		.proc_handler	= proc_dentry_negative_stat,
+	},
+	{
+		.procname	= "negative-dentry-limit",
+		.data		= &dentry_negative_limit,
+		.maxlen		= sizeof(dentry_negative_limit),
+		.mode		= 0644,
+		.proc_handler	= proc_doulongvec_minmax,
+	},
 	{ }
 };
 
@@ -349,6 +401,29 @@ static inline void __d_set_inode_and_type(struct dentry *dentry,
 	smp_store_release(&dentry->d_flags, flags);
 }
 
+/*
+ * Account a dentry that became an unused negative dentry on its superblock's
+ * LRU list, or stopped being one.  d_lock must be held by the caller.
+ */
+static inline void d_negative_inc(struct dentry *dentry)
+{
+	struct super_block *sb = dentry->d_sb;
+	unsigned long limit = READ_ONCE(dentry_negative_limit);
+	long nr;
+
+	this_cpu_inc(nr_dentry_negative);
+	nr = atomic_long_inc_return(&sb->s_nr_negative_dentry);
+	if (unlikely(limit && nr > limit) &&
+	    !work_pending(&sb->s_negative_dentry_work))
+		queue_work(system_unbound_wq, &sb->s_negative_dentry_work);
+}
+
+static inline void d_negative_dec(struct dentry *dentry)
+{
+	this_cpu_dec(nr_dentry_negative);
+	atomic_long_dec(&dentry->d_sb->s_nr_negative_dentry);
+}
+
 static inline void __d_clear_type_and_inode(struct dentry *dentry)
 {
 	unsigned flags = READ_ONCE(dentry->d_flags);
@@ -357,7 +432,7 @@ static inline void __d_clear_type_and_inode(struct dentry *dentry)
 	WRITE_ONCE(dentry->d_flags, flags);
 	dentry->d_inode = NULL;
 	if (dentry->d_flags & DCACHE_LRU_LIST)
-		this_cpu_inc(nr_dentry_negative);
+		d_negative_inc(dentry);
 }
 
 static void dentry_free(struct dentry *dentry)
@@ -427,7 +502,7 @@ static void d_lru_add(struct dentry *dentry)
 	dentry->d_flags |= DCACHE_LRU_LIST;
 	this_cpu_inc(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_inc(nr_dentry_negative);
+		d_negative_inc(dentry);
 	WARN_ON_ONCE(!list_lru_add(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -437,7 +512,7 @@ static void d_lru_del(struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	WARN_ON_ONCE(!list_lru_del(&dentry->d_sb->s_dentry_lru, &dentry->d_lru));
 }
 
@@ -469,7 +544,7 @@ static void d_lru_isolate(struct list_lru_one *lru, struct dentry *dentry)
 	dentry->d_flags &= ~DCACHE_LRU_LIST;
 	this_cpu_dec(nr_dentry_unused);
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	list_lru_isolate(lru, &dentry->d_lru);
 }
 
@@ -479,7 +554,7 @@ static void d_lru_shrink_move(struct list_lru_one *lru, struct dentry *dentry,
 	D_FLAG_VERIFY(dentry, DCACHE_LRU_LIST);
 	dentry->d_flags |= DCACHE_SHRINK_LIST;
 	if (d_is_negative(dentry))
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	list_lru_isolate_move(lru, &dentry->d_lru, list);
 }
 
@@ -1284,6 +1359,76 @@ long prune_dcache_sb(struct super_block *sb, struct shrink_control *sc)
 	return freed;
 }
 
+/*
+ * Like dentry_lru_isolate(), but only for unused negative dentries: positive
+ * ones are left alone, wherever they are on the LRU.
+ */
+static enum lru_status dentry_lru_isolate_negative(struct list_head *item,
+		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
+{
+	struct list_head *freeable = arg;
+	struct dentry	*dentry = container_of(item, struct dentry, d_lru);
+
+	if (!spin_trylock(&dentry->d_lock))
+		return LRU_SKIP;
+
+	if (!d_is_negative(dentry)) {
+		spin_unlock(&dentry->d_lock);
+		return LRU_SKIP;
+	}
+
+	if (dentry->d_lockref.count) {
+		d_lru_isolate(lru, dentry);
+		spin_unlock(&dentry->d_lock);
+		return LRU_REMOVED;
+	}
+
+	/* Lookups that keep failing the same way keep their dentry cached */
+	if (dentry->d_flags & DCACHE_REFERENCED) {
+		dentry->d_flags &= ~DCACHE_REFERENCED;
+		spin_unlock(&dentry->d_lock);
+		return LRU_ROTATE;
+	}
+
+	d_lru_shrink_move(lru, dentry, freeable);
+	this_cpu_inc(nr_dentry_negative_pruned);
+	spin_unlock(&dentry->d_lock);
+
+	return LRU_REMOVED;
+}
+
+/*
+ * Prune the oldest negative dentries of a superblock that has more than
+ * fs.negative-dentry-limit of them, down to 7/8 of the limit so that this
+ * doesn't run again for every new negative dentry.
+ */
+void prune_dcache_negative_work(struct work_struct *work)
+{
+	struct super_block *sb =
+		container_of(work, struct super_block, s_negative_dentry_work);
+	unsigned long limit = READ_ONCE(dentry_negative_limit);
+	long excess;
+
+	/* Being unmounted; shrink_dcache_for_umount() gets rid of them all */
+	if (!down_read_trylock(&sb->s_umount))
+		return;
+	if (!limit || !sb->s_root || !(sb->s_flags & SB_BORN))
+		goto out;
+
+	excess = atomic_long_read(&sb->s_nr_negative_dentry) -
+		 (long)(limit - limit / 8);
+	if (excess > 0) {
+		LIST_HEAD(dispose);
+
+		/* Allow for positive and referenced dentries in the way */
+		list_lru_walk(&sb->s_dentry_lru, dentry_lru_isolate_negative,
+			      &dispose, excess * 4);
+		shrink_dentry_list(&dispose);
+	}
+out:
+	up_read(&sb->s_umount);
+}
+
 static enum lru_status dentry_lru_isolate_shrink(struct list_head *item,
 		struct list_lru_one *lru, spinlock_t *lru_lock, void *arg)
 {
@@ -2003,7 +2148,7 @@ static void __d_instantiate(struct dentry *dentry, struct inode *inode)
 	 * Decrement negative dentry count if it was in the LRU list.
 	 */
 	if (dentry->d_flags & DCACHE_LRU_LIST)
-		this_cpu_dec(nr_dentry_negative);
+		d_negative_dec(dentry);
 	hlist_add_head(&dentry->d_u.d_alias, &inode->i_dentry);
 	raw_write_seqcount_begin(&dentry->d_seq);
 	__d_set_inode_and_type(dentry, inode, add_flags);
@@ -2306,6 +2451,8 @@ static noinline struct dentry *__d_lookup_rcu_op_compare(
 		}
 		if (parent->d_op->d_compare(dentry, tlen, tname, name) != 0)
 			continue;
+		if (d_is_negative(dentry))
+			this_cpu_inc(nr_dentry_negative_hits);
 		*seqp = seq;
 		return dentry;
 	}
@@ -2403,6 +2550,8 @@ struct dentry *__d_lookup_rcu(const struct dentry *parent,
 			continue;
 		if (dentry_cmp(dentry, str, hashlen_len(hashlen)) != 0)
 			continue;
+		if (d_is_negative(dentry))
+			this_cpu_inc(nr_dentry_negative_hits);
 		*seqp = seq;
 		return dentry;
 	}
@@ -2496,6 +2645,8 @@ struct dentry *__d_lookup(const struct dentry *parent, const struct qstr *name)
 
 		dentry->d_lockref.count++;
 		found = dentry;
+		if (d_is_negative(dentry))
+			this_cpu_inc(nr_dentry_negative_hits);
 		spin_unlock(&dentry->d_lock);
 		break;
 next:
@@ -2790,6 +2941,8 @@ static inline void __d_add(struct dentry *dentry, struct inode *inode)
 		__d_set_inode_and_type(dentry, inode, add_flags);
 		raw_write_seqcount_end(&dentry->d_seq);
 		fsnotify_update_flags(dentry);
+	} else {
+		this_cpu_inc(nr_dentry_negative_misses);
 	}
 	__d_rehash(dentry);
 	if (dir)
@@ -3304,7 +3457,8 @@ static void __init dcache_init(void)
 	 * of the dcache.
 	 */
 	dentry_cache = KMEM_CACHE_USERCOPY(dentry,
-		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD|SLAB_ACCOUNT,
+		SLAB_RECLAIM_ACCOUNT|SLAB_PANIC|SLAB_MEM_SPREAD|SLAB_ACCOUNT|
+		SLAB_PCPU_SHEAVES,
 		d_iname);
 
 	/* Hash may have been set up in dcache_init_early */
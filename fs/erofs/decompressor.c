@@ -31,6 +31,7 @@ static int z_erofs_load_lz4_config(struct super_block *sb,
 	struct erofs_sb_info *sbi = EROFS_SB(sb);
 	struct z_erofs_lz4_cfgs *lz4 = data;
 	u16 distance;
+	int ret;
 
 	if (lz4) {
 		if (size < sizeof(struct z_erofs_lz4_cfgs)) {
@@ -56,7 +57,10 @@ static int z_erofs_load_lz4_config(struct super_block *sb,
 	sbi->lz4.max_distance_pages = distance ?
 					DIV_ROUND_UP(distance, PAGE_SIZE) + 1 :
 					LZ4_MAX_DISTANCE_PAGES;
-	return erofs_pcpubuf_growsize(sbi->lz4.max_pclusterblks);
+	ret = erofs_pcpubuf_growsize(sbi->lz4.max_pclusterblks);
+	if (!ret)
+		sbi->lz4.pcpubuf_pages = sbi->lz4.max_pclusterblks;
+	return ret;
 }
 
 /*
@@ -122,6 +126,22 @@ static int z_erofs_lz4_prepare_dstpages(struct z_erofs_lz4_decompress_ctx *ctx,
 	return kaddr ? 1 : 0;
 }
 
+/* check if all compressed pages are physically consecutive lowmem pages */
+static bool z_erofs_lz4_inpages_contig(struct z_erofs_lz4_decompress_ctx *ctx)
+{
+	struct page **in = ctx->rq->in;
+	unsigned int i;
+
+	for (i = 0; i < ctx->inpages; ++i) {
+		if (PageHighMem(in[i]))
+			return false;
+		if (i && page_address(in[i]) !=
+			 page_address(in[i - 1]) + PAGE_SIZE)
+			return false;
+	}
+	return true;
+}
+
 static void *z_erofs_lz4_handle_overlap(struct z_erofs_lz4_decompress_ctx *ctx,
 			void *inpage, void *out, unsigned int *inputmargin,
 			int *maptype, bool may_inplace)
@@ -151,6 +171,11 @@ static void *z_erofs_lz4_handle_overlap(struct z_erofs_lz4_decompress_ctx *ctx,
 		return inpage;
 	}
 	kunmap_local(inpage);
+	/* no need to map consecutive pages again, use the linear mapping */
+	if (z_erofs_lz4_inpages_contig(ctx)) {
+		*maptype = 3;
+		return page_address(rq->in[0]);
+	}
 	src = erofs_vm_map_ram(rq->in, ctx->inpages);
 	if (!src)
 		return ERR_PTR(-ENOMEM);
@@ -161,10 +186,15 @@ static void *z_erofs_lz4_handle_overlap(struct z_erofs_lz4_decompress_ctx *ctx,
 	/* Or copy compressed data which can be overlapped to per-CPU buffer */
 	in = rq->in;
 	src = erofs_get_pcpubuf(ctx->inpages);
+	*maptype = 2;
 	if (!src) {
-		DBG_BUGON(1);
-		kunmap_local(inpage);
-		return ERR_PTR(-EFAULT);
+		/* the per-CPU buffer is bounded, fall back to a temporary one */
+		src = kvmalloc(ctx->inpages << PAGE_SHIFT, GFP_KERNEL);
+		if (!src) {
+			kunmap_local(inpage);
+			return ERR_PTR(-ENOMEM);
+		}
+		*maptype = 4;
 	}
 
 	tmp = src;
@@ -183,7 +213,6 @@ static void *z_erofs_lz4_handle_overlap(struct z_erofs_lz4_decompress_ctx *ctx,
 		++in;
 		*inputmargin = 0;
 	}
-	*maptype = 2;
 	return src;
 }
 
@@ -277,6 +306,8 @@ static int z_erofs_lz4_decompress_mem(struct z_erofs_lz4_decompress_ctx *ctx,
 		vm_unmap_ram(src, ctx->inpages);
 	} else if (maptype == 2) {
 		erofs_put_pcpubuf(src);
+	} else if (maptype == 4) {
+		kvfree(src);
 	} else if (maptype != 3) {
 		DBG_BUGON(1);
 		return -EFAULT;
@@ -416,6 +447,13 @@ const struct z_erofs_decompressor erofs_decompressors[] = {
 		.name = "deflate"
 	},
 #endif
+#ifdef CONFIG_EROFS_FS_ZIP_ZSTD
+	[Z_EROFS_COMPRESSION_ZSTD] = {
+		.config = z_erofs_load_zstd_config,
+		.decompress = z_erofs_zstd_decompress,
+		.name = "zstd"
+	},
+#endif
 };
 
 int z_erofs_parse_cfgs(struct super_block *sb, struct erofs_super_block *dsb)
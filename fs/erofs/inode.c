@@ -291,6 +291,7 @@ static int erofs_fill_inode(struct inode *inode)
 				  erofs_info, inode->i_sb,
 				  "EXPERIMENTAL EROFS subpage compressed block support in use. Use at your own risk!");
 			inode->i_mapping->a_ops = &z_erofs_aops;
+			mapping_set_large_folios(inode->i_mapping);
 			err = 0;
 			goto out_unlock;
 		}
@@ -71,6 +71,8 @@ struct erofs_mount_opts {
 	/* threshold for decompression synchronously */
 	unsigned int max_sync_decompress_pages;
 #endif
+	/* size (in KiB) of the metadata area to prefetch at mount time */
+	unsigned int meta_prefetch;
 	unsigned int mount_opt;
 };
 
@@ -95,6 +97,8 @@ struct erofs_sb_lz4_info {
 	u16 max_distance_pages;
 	/* maximum possible blocks for pclusters in the filesystem */
 	u16 max_pclusterblks;
+	/* # of per-CPU buffer pages registered by this filesystem */
+	u16 pcpubuf_pages;
 };
 
 struct erofs_domain {
@@ -473,6 +477,16 @@ int z_erofs_map_blocks_iter(struct inode *inode, struct erofs_map_blocks *map,
 void *erofs_get_pcpubuf(unsigned int requiredpages);
 void erofs_put_pcpubuf(void *ptr);
 int erofs_pcpubuf_growsize(unsigned int nrpages);
+void erofs_pcpubuf_release(unsigned int nrpages);
+int erofs_pcpubuf_set_max_pages(unsigned int nrpages);
+
+enum {
+	EROFS_PCPUBUF_STAT_PAGES,
+	EROFS_PCPUBUF_STAT_MAX_PAGES,
+	EROFS_PCPUBUF_STAT_HITS,
+	EROFS_PCPUBUF_STAT_MISSES,
+};
+unsigned long erofs_pcpubuf_stat(int item);
 void __init erofs_pcpubuf_init(void);
 void erofs_pcpubuf_exit(void);
 int erofs_init_managed_cache(struct super_block *sb);
@@ -505,6 +519,14 @@ static inline int z_erofs_deflate_init(void) { return 0; }
 static inline int z_erofs_deflate_exit(void) { return 0; }
 #endif	/* !CONFIG_EROFS_FS_ZIP_DEFLATE */
 
+#ifdef CONFIG_EROFS_FS_ZIP_ZSTD
+int __init z_erofs_zstd_init(void);
+void z_erofs_zstd_exit(void);
+#else
+static inline int z_erofs_zstd_init(void) { return 0; }
+static inline int z_erofs_zstd_exit(void) { return 0; }
+#endif	/* !CONFIG_EROFS_FS_ZIP_ZSTD */
+
 #ifdef CONFIG_EROFS_FS_ONDEMAND
 int erofs_fscache_register_fs(struct super_block *sb);
 void erofs_fscache_unregister_fs(struct super_block *sb);
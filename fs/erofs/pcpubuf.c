@@ -6,18 +6,32 @@
  * per-CPU virtual memory (in pages) in advance to store such inplace I/O
  * data if inplace decompression is failed (due to unmet inplace margin for
  * example).
+ *
+ * The pool is sized to the largest requirement of the filesystems currently
+ * mounted (bounded by `max_pages'), and shrinks again once they go away.
  */
+#include <linux/module.h>
 #include "internal.h"
 
+#define EROFS_PCPUBUF_MAX_PAGES	(Z_EROFS_PCLUSTER_MAX_SIZE / PAGE_SIZE)
+
 struct erofs_pcpubuf {
 	raw_spinlock_t lock;
 	void *ptr;
 	struct page **pages;
 	unsigned int nrpages;
+	unsigned long hits, misses;
 };
 
 static DEFINE_PER_CPU(struct erofs_pcpubuf, erofs_pcb);
 
+static DEFINE_MUTEX(pcb_resize_mutex);
+/* # of mounted filesystems which need each pcpubuf size */
+static unsigned int pcb_users[EROFS_PCPUBUF_MAX_PAGES + 1];
+static unsigned int pcb_nrpages;
+static unsigned int pcb_max_pages = EROFS_PCPUBUF_MAX_PAGES;
+module_param_named(pcpubuf_max_pages, pcb_max_pages, uint, 0444);
+
 void *erofs_get_pcpubuf(unsigned int requiredpages)
 	__acquires(pcb->lock)
 {
@@ -26,12 +40,14 @@ void *erofs_get_pcpubuf(unsigned int requiredpages)
 	raw_spin_lock(&pcb->lock);
 	/* check if the per-CPU buffer is too small */
 	if (requiredpages > pcb->nrpages) {
+		++pcb->misses;
 		raw_spin_unlock(&pcb->lock);
 		put_cpu_var(erofs_pcb);
 		/* (for sparse checker) pretend pcb->lock is still taken */
 		__acquire(pcb->lock);
 		return NULL;
 	}
+	++pcb->hits;
 	return pcb->ptr;
 }
 
@@ -45,24 +61,19 @@ void erofs_put_pcpubuf(void *ptr) __releases(pcb->lock)
 }
 
 /* the next step: support per-CPU page buffers hotplug */
-int erofs_pcpubuf_growsize(unsigned int nrpages)
+static int erofs_pcpubuf_resize(unsigned int nrpages)
 {
-	static DEFINE_MUTEX(pcb_resize_mutex);
-	static unsigned int pcb_nrpages;
 	struct page *pagepool = NULL;
-	int delta, cpu, ret, i;
-
-	mutex_lock(&pcb_resize_mutex);
-	delta = nrpages - pcb_nrpages;
-	ret = 0;
-	/* avoid shrinking pcpubuf, since no idea how many fses rely on */
-	if (delta <= 0)
-		goto out;
+	int cpu, ret = 0, i;
 
+	lockdep_assert_held(&pcb_resize_mutex);
 	for_each_possible_cpu(cpu) {
 		struct erofs_pcpubuf *pcb = &per_cpu(erofs_pcb, cpu);
-		struct page **pages, **oldpages;
-		void *ptr, *old_ptr;
+		struct page **pages = NULL, **oldpages;
+		void *ptr = NULL, *old_ptr;
+
+		if (!nrpages)
+			goto swap;
 
 		pages = kmalloc_array(nrpages, sizeof(*pages), GFP_KERNEL);
 		if (!pages) {
@@ -84,6 +95,7 @@ int erofs_pcpubuf_growsize(unsigned int nrpages)
 			oldpages = pages;
 			goto free_pagearray;
 		}
+swap:
 		raw_spin_lock(&pcb->lock);
 		old_ptr = pcb->ptr;
 		pcb->ptr = ptr;
@@ -107,13 +119,91 @@ int erofs_pcpubuf_growsize(unsigned int nrpages)
 		if (ret)
 			break;
 	}
-	pcb_nrpages = nrpages;
+	if (!ret)
+		pcb_nrpages = nrpages;
 	erofs_release_pages(&pagepool);
-out:
+	return ret;
+}
+
+/* resize the pool to the largest requirement left, bounded by max_pages */
+static int erofs_pcpubuf_rebalance(void)
+{
+	unsigned int nrpages = EROFS_PCPUBUF_MAX_PAGES;
+
+	while (nrpages && !pcb_users[nrpages])
+		--nrpages;
+	nrpages = min(nrpages, READ_ONCE(pcb_max_pages));
+	if (nrpages == pcb_nrpages)
+		return 0;
+	return erofs_pcpubuf_resize(nrpages);
+}
+
+int erofs_pcpubuf_growsize(unsigned int nrpages)
+{
+	int ret;
+
+	nrpages = min_t(unsigned int, nrpages, EROFS_PCPUBUF_MAX_PAGES);
+	mutex_lock(&pcb_resize_mutex);
+	++pcb_users[nrpages];
+	ret = 0;
+	/* only grow here; smaller requirements are already covered */
+	if (nrpages > pcb_nrpages)
+		ret = erofs_pcpubuf_rebalance();
+	if (ret)
+		--pcb_users[nrpages];
+	mutex_unlock(&pcb_resize_mutex);
+	return ret;
+}
+
+void erofs_pcpubuf_release(unsigned int nrpages)
+{
+	if (!nrpages)
+		return;
+	nrpages = min_t(unsigned int, nrpages, EROFS_PCPUBUF_MAX_PAGES);
+	mutex_lock(&pcb_resize_mutex);
+	DBG_BUGON(!pcb_users[nrpages]);
+	--pcb_users[nrpages];
+	/* failing to shrink is harmless, the old buffers are kept instead */
+	erofs_pcpubuf_rebalance();
+	mutex_unlock(&pcb_resize_mutex);
+}
+
+int erofs_pcpubuf_set_max_pages(unsigned int nrpages)
+{
+	int ret;
+
+	if (nrpages > EROFS_PCPUBUF_MAX_PAGES)
+		return -EINVAL;
+	mutex_lock(&pcb_resize_mutex);
+	WRITE_ONCE(pcb_max_pages, nrpages);
+	ret = erofs_pcpubuf_rebalance();
 	mutex_unlock(&pcb_resize_mutex);
 	return ret;
 }
 
+unsigned long erofs_pcpubuf_stat(int item)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	switch (item) {
+	case EROFS_PCPUBUF_STAT_PAGES:
+		return pcb_nrpages;
+	case EROFS_PCPUBUF_STAT_MAX_PAGES:
+		return READ_ONCE(pcb_max_pages);
+	}
+
+	for_each_possible_cpu(cpu) {
+		struct erofs_pcpubuf *pcb = &per_cpu(erofs_pcb, cpu);
+
+		if (item == EROFS_PCPUBUF_STAT_HITS)
+			sum += READ_ONCE(pcb->hits);
+		else if (item == EROFS_PCPUBUF_STAT_MISSES)
+			sum += READ_ONCE(pcb->misses);
+	}
+	return sum;
+}
+
 void __init erofs_pcpubuf_init(void)
 {
 	int cpu;
@@ -123,6 +213,8 @@ void __init erofs_pcpubuf_init(void)
 
 		raw_spin_lock_init(&pcb->lock);
 	}
+	if (pcb_max_pages > EROFS_PCPUBUF_MAX_PAGES)
+		pcb_max_pages = EROFS_PCPUBUF_MAX_PAGES;
 }
 
 void erofs_pcpubuf_exit(void)
@@ -391,6 +391,7 @@ enum {
 	Opt_device,
 	Opt_fsid,
 	Opt_domain_id,
+	Opt_meta_prefetch,
 	Opt_err
 };
 
@@ -417,6 +418,7 @@ static const struct fs_parameter_spec erofs_fs_parameters[] = {
 	fsparam_string("device",	Opt_device),
 	fsparam_string("fsid",		Opt_fsid),
 	fsparam_string("domain_id",	Opt_domain_id),
+	fsparam_u32("meta_prefetch",	Opt_meta_prefetch),
 	{}
 };
 
@@ -531,6 +533,9 @@ static int erofs_fc_parse_param(struct fs_context *fc,
 		errorfc(fc, "%s option not supported", erofs_fs_parameters[opt].name);
 		break;
 #endif
+	case Opt_meta_prefetch:
+		ctx->opt.meta_prefetch = result.uint_32;
+		break;
 	default:
 		return -ENOPARAM;
 	}
@@ -575,6 +580,38 @@ static const struct export_operations erofs_export_ops = {
 	.get_parent = erofs_get_parent,
 };
 
+/* upper bound of meta_prefetch, in KiB */
+#define EROFS_META_PREFETCH_MAX		(64 << 10)
+
+/*
+ * Kick off asynchronous readahead of the metadata area (inodes, and
+ * directories which are usually laid out right after them by mkfs) so that
+ * the first lookups don't have to wait for many small random reads.
+ */
+static void erofs_prefetch_metadata(struct super_block *sb)
+{
+	struct erofs_sb_info *sbi = EROFS_SB(sb);
+	struct address_space *mapping = sb->s_bdev->bd_inode->i_mapping;
+	erofs_off_t start = erofs_pos(sb, sbi->meta_blkaddr);
+	erofs_off_t end = bdev_nr_bytes(sb->s_bdev);
+	struct file_ra_state ra;
+	DEFINE_READAHEAD(ractl, NULL, &ra, mapping, start >> PAGE_SHIFT);
+	unsigned long nr_pages;
+
+	/* page_cache_ra_unbounded() doesn't stop at the end of the device */
+	if (start >= end)
+		return;
+	end = min_t(erofs_off_t, end, start +
+		    ((erofs_off_t)min_t(unsigned int, sbi->opt.meta_prefetch,
+					EROFS_META_PREFETCH_MAX) << 10));
+	nr_pages = (end >> PAGE_SHIFT) - (start >> PAGE_SHIFT);
+	if (!nr_pages)
+		return;
+
+	file_ra_state_init(&ra, mapping);
+	page_cache_ra_unbounded(&ractl, nr_pages, 0);
+}
+
 static int erofs_fc_fill_super(struct super_block *sb, struct fs_context *fc)
 {
 	struct inode *inode;
@@ -661,6 +698,8 @@ static int erofs_fc_fill_super(struct super_block *sb, struct fs_context *fc)
 	xa_init(&sbi->managed_pslots);
 #endif
 
+	if (sbi->opt.meta_prefetch && !erofs_is_fscache_mode(sb))
+		erofs_prefetch_metadata(sb);
 	inode = erofs_iget(sb, ROOT_NID(sbi));
 	if (IS_ERR(inode))
 		return PTR_ERR(inode);
@@ -810,6 +849,9 @@ static void erofs_kill_sb(struct super_block *sb)
 	erofs_free_dev_context(sbi->devs);
 	fs_put_dax(sbi->dax_dev, NULL);
 	erofs_fscache_unregister_fs(sb);
+#ifdef CONFIG_EROFS_FS_ZIP
+	erofs_pcpubuf_release(sbi->lz4.pcpubuf_pages);
+#endif
 	kfree(sbi->fsid);
 	kfree(sbi->domain_id);
 	kfree(sbi);
@@ -870,6 +912,10 @@ static int __init erofs_module_init(void)
 	if (err)
 		goto deflate_err;
 
+	err = z_erofs_zstd_init();
+	if (err)
+		goto zstd_err;
+
 	erofs_pcpubuf_init();
 	err = z_erofs_init_zip_subsystem();
 	if (err)
@@ -890,6 +936,8 @@ static int __init erofs_module_init(void)
 sysfs_err:
 	z_erofs_exit_zip_subsystem();
 zip_err:
+	z_erofs_zstd_exit();
+zstd_err:
 	z_erofs_deflate_exit();
 deflate_err:
 	z_erofs_lzma_exit();
@@ -909,6 +957,7 @@ static void __exit erofs_module_exit(void)
 
 	erofs_exit_sysfs();
 	z_erofs_exit_zip_subsystem();
+	z_erofs_zstd_exit();
 	z_erofs_deflate_exit();
 	z_erofs_lzma_exit();
 	erofs_exit_shrinker();
@@ -974,6 +1023,8 @@ static int erofs_show_options(struct seq_file *seq, struct dentry *root)
 	if (sbi->domain_id)
 		seq_printf(seq, ",domain_id=%s", sbi->domain_id);
 #endif
+	if (opt->meta_prefetch)
+		seq_printf(seq, ",meta_prefetch=%u", opt->meta_prefetch);
 	return 0;
 }
 
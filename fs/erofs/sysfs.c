@@ -12,6 +12,7 @@ enum {
 	attr_feature,
 	attr_pointer_ui,
 	attr_pointer_bool,
+	attr_pcpubuf,
 };
 
 enum {
@@ -94,6 +95,30 @@ static struct attribute *erofs_feat_attrs[] = {
 };
 ATTRIBUTE_GROUPS(erofs_feat);
 
+#ifdef CONFIG_EROFS_FS_ZIP
+/* Global per-CPU buffer pool statistics, `offset' is the stat index */
+#define EROFS_ATTR_PCPUBUF(_name, _mode, _item)			\
+static struct erofs_attr erofs_attr_pcpubuf_##_name = {		\
+	.attr = {.name = __stringify(_name), .mode = _mode },	\
+	.attr_id = attr_pcpubuf,				\
+	.offset = EROFS_PCPUBUF_STAT_##_item,			\
+}
+
+EROFS_ATTR_PCPUBUF(pages, 0444, PAGES);
+EROFS_ATTR_PCPUBUF(max_pages, 0644, MAX_PAGES);
+EROFS_ATTR_PCPUBUF(hits, 0444, HITS);
+EROFS_ATTR_PCPUBUF(misses, 0444, MISSES);
+
+static struct attribute *erofs_pcpubuf_attrs[] = {
+	ATTR_LIST(pcpubuf_pages),
+	ATTR_LIST(pcpubuf_max_pages),
+	ATTR_LIST(pcpubuf_hits),
+	ATTR_LIST(pcpubuf_misses),
+	NULL,
+};
+ATTRIBUTE_GROUPS(erofs_pcpubuf);
+#endif
+
 static unsigned char *__struct_ptr(struct erofs_sb_info *sbi,
 					  int struct_type, int offset)
 {
@@ -123,6 +148,10 @@ static ssize_t erofs_attr_show(struct kobject *kobj,
 		if (!ptr)
 			return 0;
 		return sysfs_emit(buf, "%d\n", *(bool *)ptr);
+#ifdef CONFIG_EROFS_FS_ZIP
+	case attr_pcpubuf:
+		return sysfs_emit(buf, "%lu\n", erofs_pcpubuf_stat(a->offset));
+#endif
 	}
 	return 0;
 }
@@ -163,6 +192,18 @@ static ssize_t erofs_attr_store(struct kobject *kobj, struct attribute *attr,
 			return -EINVAL;
 		*(bool *)ptr = !!t;
 		return len;
+#ifdef CONFIG_EROFS_FS_ZIP
+	case attr_pcpubuf:
+		if (a->offset != EROFS_PCPUBUF_STAT_MAX_PAGES)
+			return -EPERM;
+		ret = kstrtoul(skip_spaces(buf), 0, &t);
+		if (ret)
+			return ret;
+		if (t != (unsigned int)t)
+			return -ERANGE;
+		ret = erofs_pcpubuf_set_max_pages(t);
+		return ret ? ret : len;
+#endif
 	}
 	return 0;
 }
@@ -202,6 +243,17 @@ static struct kobject erofs_feat = {
 	.kset	= &erofs_root,
 };
 
+#ifdef CONFIG_EROFS_FS_ZIP
+static const struct kobj_type erofs_pcpubuf_ktype = {
+	.default_groups = erofs_pcpubuf_groups,
+	.sysfs_ops	= &erofs_attr_ops,
+};
+
+static struct kobject erofs_pcpubuf = {
+	.kset	= &erofs_root,
+};
+#endif
+
 int erofs_register_sysfs(struct super_block *sb)
 {
 	struct erofs_sb_info *sbi = EROFS_SB(sb);
@@ -261,8 +313,18 @@ int __init erofs_init_sysfs(void)
 				   NULL, "features");
 	if (ret)
 		goto feat_err;
+#ifdef CONFIG_EROFS_FS_ZIP
+	ret = kobject_init_and_add(&erofs_pcpubuf, &erofs_pcpubuf_ktype,
+				   NULL, "pcpubuf");
+	if (ret)
+		goto pcpubuf_err;
+#endif
 	return ret;
 
+#ifdef CONFIG_EROFS_FS_ZIP
+pcpubuf_err:
+	kobject_put(&erofs_pcpubuf);
+#endif
 feat_err:
 	kobject_put(&erofs_feat);
 	kset_unregister(&erofs_root);
@@ -272,6 +334,9 @@ int __init erofs_init_sysfs(void)
 
 void erofs_exit_sysfs(void)
 {
+#ifdef CONFIG_EROFS_FS_ZIP
+	kobject_put(&erofs_pcpubuf);
+#endif
 	kobject_put(&erofs_feat);
 	kset_unregister(&erofs_root);
 }
@@ -7,11 +7,17 @@
 #include "compress.h"
 #include <linux/psi.h>
 #include <linux/cpuhotplug.h>
+#include <linux/topology.h>
 #include <trace/events/erofs.h>
 
 #define Z_EROFS_PCLUSTER_MAX_PAGES	(Z_EROFS_PCLUSTER_MAX_SIZE / PAGE_SIZE)
 #define Z_EROFS_INLINE_BVECS		2
 
+/* queues shorter than this are decompressed by a single context */
+#define Z_EROFS_PARALLEL_MIN_PCLUSTERS	4
+/* the minimum number of pclusters handed to one decompression job */
+#define Z_EROFS_JOB_MIN_PCLUSTERS	2
+
 /*
  * let's leave a type here in case of introducing
  * another tagged pointer later.
@@ -114,48 +120,55 @@ static inline unsigned int z_erofs_pclusterpages(struct z_erofs_pcluster *pcl)
 }
 
 /*
- * bit 30: I/O error occurred on this page
- * bit 0 - 29: remaining parts to complete this page
+ * The parts of all pages of an online folio are counted on the folio, so
+ * that each of its pages can be decompressed by a different pcluster:
+ * bit 30: I/O error occurred on this folio
+ * bit 0 - 29: remaining parts to complete this folio
  */
-#define Z_EROFS_PAGE_EIO			(1 << 30)
+#define Z_EROFS_FOLIO_EIO			(1 << 30)
 
-static inline void z_erofs_onlinepage_init(struct page *page)
+static inline void z_erofs_onlinefolio_init(struct folio *folio)
 {
 	union {
 		atomic_t o;
-		unsigned long v;
+		void *v;
 	} u = { .o = ATOMIC_INIT(1) };
 
-	set_page_private(page, u.v);
+	folio->private = u.v;
 	smp_wmb();
-	SetPagePrivate(page);
+	folio_set_private(folio);
 }
 
-static inline void z_erofs_onlinepage_split(struct page *page)
+static inline void z_erofs_onlinefolio_split(struct folio *folio)
 {
-	atomic_inc((atomic_t *)&page->private);
+	atomic_inc((atomic_t *)&folio->private);
 }
 
-static void z_erofs_onlinepage_endio(struct page *page, int err)
+static void z_erofs_onlinefolio_end(struct folio *folio, int err)
 {
 	int orig, v;
 
-	DBG_BUGON(!PagePrivate(page));
+	DBG_BUGON(!folio_test_private(folio));
 
 	do {
-		orig = atomic_read((atomic_t *)&page->private);
-		v = (orig - 1) | (err ? Z_EROFS_PAGE_EIO : 0);
-	} while (atomic_cmpxchg((atomic_t *)&page->private, orig, v) != orig);
-
-	if (!(v & ~Z_EROFS_PAGE_EIO)) {
-		set_page_private(page, 0);
-		ClearPagePrivate(page);
-		if (!(v & Z_EROFS_PAGE_EIO))
-			SetPageUptodate(page);
-		unlock_page(page);
+		orig = atomic_read((atomic_t *)&folio->private);
+		v = (orig - 1) | (err ? Z_EROFS_FOLIO_EIO : 0);
+	} while (atomic_cmpxchg((atomic_t *)&folio->private, orig, v) != orig);
+
+	if (!(v & ~Z_EROFS_FOLIO_EIO)) {
+		folio->private = NULL;
+		folio_clear_private(folio);
+		if (!(v & Z_EROFS_FOLIO_EIO))
+			folio_mark_uptodate(folio);
+		folio_unlock(folio);
 	}
 }
 
+static void z_erofs_onlinepage_endio(struct page *page, int err)
+{
+	z_erofs_onlinefolio_end(page_folio(page), err);
+}
+
 #define Z_EROFS_ONSTACK_PAGES		32
 
 /*
@@ -959,18 +972,18 @@ static int z_erofs_read_fragment(struct super_block *sb, struct page *page,
 	return 0;
 }
 
-static int z_erofs_do_read_page(struct z_erofs_decompress_frontend *fe,
-				struct page *page)
+/* @i is the index of @page in @folio, tail pages have no page->index */
+static int z_erofs_scan_page(struct z_erofs_decompress_frontend *fe,
+			     struct folio *folio, struct page *page, long i)
 {
 	struct inode *const inode = fe->inode;
 	struct erofs_map_blocks *const map = &fe->map;
-	const loff_t offset = page_offset(page);
+	const loff_t offset = folio_pos(folio) + ((loff_t)i << PAGE_SHIFT);
 	const unsigned int bs = i_blocksize(inode);
 	bool tight = true, exclusive;
 	unsigned int cur, end, len, split;
 	int err = 0;
 
-	z_erofs_onlinepage_init(page);
 	split = 0;
 	end = PAGE_SIZE;
 repeat:
@@ -1031,7 +1044,7 @@ static int z_erofs_do_read_page(struct z_erofs_decompress_frontend *fe,
 	if (err)
 		goto out;
 
-	z_erofs_onlinepage_split(page);
+	z_erofs_onlinefolio_split(folio);
 	if (fe->pcl->pageofs_out != (map->m_la & ~PAGE_MASK))
 		fe->pcl->multibases = true;
 	if (fe->pcl->length < offset + end - map->m_la) {
@@ -1052,7 +1065,20 @@ static int z_erofs_do_read_page(struct z_erofs_decompress_frontend *fe,
 		goto repeat;
 
 out:
-	z_erofs_onlinepage_endio(page, err);
+	return err;
+}
+
+static int z_erofs_scan_folio(struct z_erofs_decompress_frontend *fe,
+			      struct folio *folio)
+{
+	long i;
+	int err = 0;
+
+	z_erofs_onlinefolio_init(folio);
+	/* pages are attached backwards, like the parts of each page */
+	for (i = folio_nr_pages(folio) - 1; i >= 0 && !err; --i)
+		err = z_erofs_scan_page(fe, folio, folio_page(folio, i), i);
+	z_erofs_onlinefolio_end(folio, err);
 	return err;
 }
 
@@ -1337,16 +1363,16 @@ static int z_erofs_decompress_pcluster(struct z_erofs_decompress_backend *be,
 	return err;
 }
 
-static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
+static void z_erofs_decompress_chain(struct super_block *sb,
+				     z_erofs_next_pcluster_t owned, bool eio,
 				     struct page **pagepool)
 {
 	struct z_erofs_decompress_backend be = {
-		.sb = io->sb,
+		.sb = sb,
 		.pagepool = pagepool,
 		.decompressed_secondary_bvecs =
 			LIST_HEAD_INIT(be.decompressed_secondary_bvecs),
 	};
-	z_erofs_next_pcluster_t owned = io->head;
 
 	while (owned != Z_EROFS_PCLUSTER_TAIL) {
 		DBG_BUGON(owned == Z_EROFS_PCLUSTER_NIL);
@@ -1354,7 +1380,7 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 		be.pcl = container_of(owned, struct z_erofs_pcluster, next);
 		owned = READ_ONCE(be.pcl->next);
 
-		z_erofs_decompress_pcluster(&be, io->eio ? -EIO : 0);
+		z_erofs_decompress_pcluster(&be, eio ? -EIO : 0);
 		if (z_erofs_is_inline_pcluster(be.pcl))
 			z_erofs_free_pcluster(be.pcl);
 		else
@@ -1362,6 +1388,96 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	}
 }
 
+/* a part of a decompression queue handed over to another CPU */
+struct z_erofs_decompress_job {
+	struct work_struct work;
+	struct super_block *sb;
+	z_erofs_next_pcluster_t head;
+	bool eio;
+};
+
+static void z_erofs_decompress_job_work(struct work_struct *work)
+{
+	struct z_erofs_decompress_job *job =
+		container_of(work, struct z_erofs_decompress_job, work);
+	struct page *pagepool = NULL;
+
+	z_erofs_decompress_chain(job->sb, job->head, job->eio, &pagepool);
+	erofs_release_pages(&pagepool);
+	kfree(job);
+}
+
+/*
+ * Cut a long queue into chunks of pclusters and queue all but the last one
+ * to the workqueue, starting from the CPUs of the current cluster, so that
+ * a large readahead batch doesn't get decompressed by one CPU alone.
+ * Return the remaining chain, which is left for the caller to decompress.
+ */
+static z_erofs_next_pcluster_t
+z_erofs_spread_queue(const struct z_erofs_decompressqueue *io)
+{
+	z_erofs_next_pcluster_t owned = io->head;
+	const struct cpumask *mask;
+	struct z_erofs_pcluster *pcl;
+	unsigned int nr = 0, nr_cpus, per_job, i;
+	int cpu;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		++nr;
+	}
+	if (nr < Z_EROFS_PARALLEL_MIN_PCLUSTERS)
+		return io->head;
+
+	cpu = raw_smp_processor_id();
+	mask = topology_cluster_cpumask(cpu);
+	nr_cpus = cpumask_weight_and(mask, cpu_online_mask);
+	if (nr_cpus <= 1) {
+		mask = cpu_online_mask;
+		nr_cpus = num_online_cpus();
+	}
+	per_job = max_t(unsigned int, Z_EROFS_JOB_MIN_PCLUSTERS,
+			DIV_ROUND_UP(nr, nr_cpus));
+
+	owned = io->head;
+	while (nr > per_job) {
+		struct z_erofs_decompress_job *job;
+
+		job = kmalloc(sizeof(*job), GFP_NOWAIT | __GFP_NOWARN);
+		if (!job)
+			break;
+		job->sb = io->sb;
+		job->head = owned;
+		job->eio = io->eio;
+
+		for (i = 0; i < per_job; ++i) {
+			pcl = container_of(owned, struct z_erofs_pcluster, next);
+			owned = READ_ONCE(pcl->next);
+		}
+		/* pcl is still owned by this queue, just end the chunk here */
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL);
+		nr -= per_job;
+
+		cpu = cpumask_next_and(cpu, mask, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first_and(mask, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = WORK_CPU_UNBOUND;
+
+		INIT_WORK(&job->work, z_erofs_decompress_job_work);
+		queue_work_on(cpu, z_erofs_workqueue, &job->work);
+	}
+	return owned;
+}
+
+static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
+				     struct page **pagepool)
+{
+	z_erofs_decompress_chain(io->sb, z_erofs_spread_queue(io), io->eio,
+				 pagepool);
+}
+
 static void z_erofs_decompressqueue_work(struct work_struct *work)
 {
 	struct z_erofs_decompressqueue *bgq =
@@ -1803,14 +1919,18 @@ static void z_erofs_pcluster_readmore(struct z_erofs_decompress_frontend *f,
 
 		page = erofs_grab_cache_page_nowait(inode->i_mapping, index);
 		if (page) {
-			if (PageUptodate(page))
-				unlock_page(page);
+			struct folio *folio = page_folio(page);
+
+			if (folio_test_uptodate(folio))
+				folio_unlock(folio);
 			else
-				(void)z_erofs_do_read_page(f, page);
+				(void)z_erofs_scan_folio(f, folio);
+			/* skip the rest of a large folio */
+			index = folio->index;
 			put_page(page);
 		}
 
-		if (cur < PAGE_SIZE)
+		if (!index)
 			break;
 		cur = (index << PAGE_SHIFT) - 1;
 	}
@@ -1824,10 +1944,10 @@ static int z_erofs_read_folio(struct file *file, struct folio *folio)
 	int err;
 
 	trace_erofs_read_folio(folio, false);
-	f.headoffset = (erofs_off_t)folio->index << PAGE_SHIFT;
+	f.headoffset = folio_pos(folio);
 
 	z_erofs_pcluster_readmore(&f, NULL, true);
-	err = z_erofs_do_read_page(&f, &folio->page);
+	err = z_erofs_scan_folio(&f, folio);
 	z_erofs_pcluster_readmore(&f, NULL, false);
 	z_erofs_pcluster_end(&f);
 
@@ -1868,7 +1988,7 @@ static void z_erofs_readahead(struct readahead_control *rac)
 		folio = head;
 		head = folio_get_private(folio);
 
-		err = z_erofs_do_read_page(&f, &folio->page);
+		err = z_erofs_scan_folio(&f, folio);
 		if (err && err != -EINTR)
 			erofs_err(inode->i_sb, "readahead error at folio %lu @ nid %llu",
 				  folio->index, EROFS_I(inode)->nid);
@@ -18,6 +18,7 @@
 #include "f2fs.h"
 #include "node.h"
 #include "segment.h"
+#include "iostat.h"
 #include <trace/events/f2fs.h>
 
 static struct kmem_cache *cic_entry_slab;
@@ -622,6 +623,7 @@ static int f2fs_compress_pages(struct compress_ctx *cc)
 				f2fs_cops[fi->i_compress_algorithm];
 	unsigned int max_len, new_nr_cpages;
 	u32 chksum = 0;
+	u64 start;
 	int i, ret;
 
 	trace_f2fs_compress_pages_start(cc->inode, cc->cluster_idx,
@@ -658,9 +660,12 @@ static int f2fs_compress_pages(struct compress_ctx *cc)
 		goto out_vunmap_rbuf;
 	}
 
+	start = ktime_get_ns();
 	ret = cops->compress_pages(cc);
 	if (ret)
 		goto out_vunmap_cbuf;
+	f2fs_update_compr_iostat(F2FS_I_SB(cc->inode), fi->i_compress_algorithm,
+				cc->rlen, cc->clen, ktime_get_ns() - start);
 
 	max_len = PAGE_SIZE * (cc->cluster_size - 1) - COMPRESS_HEADER_SIZE;
 
@@ -1556,30 +1561,30 @@ static int f2fs_write_raw_pages(struct compress_ctx *cc,
 	return ret;
 }
 
-int f2fs_write_multi_pages(struct compress_ctx *cc,
-					int *submitted,
+/*
+ * Write a cluster back, either as raw pages or, if @compressed, as the
+ * result of f2fs_compress_pages() which returned @err.
+ */
+static int f2fs_write_cluster(struct compress_ctx *cc, bool compressed,
+					int err, int *submitted,
 					struct writeback_control *wbc,
 					enum iostat_type io_type)
 {
-	int err;
-
 	*submitted = 0;
-	if (cluster_may_compress(cc)) {
-		err = f2fs_compress_pages(cc);
-		if (err == -EAGAIN) {
-			add_compr_block_stat(cc->inode, cc->cluster_size);
-			goto write;
-		} else if (err) {
-			f2fs_put_rpages_wbc(cc, wbc, true, 1);
-			goto destroy_out;
-		}
-
-		err = f2fs_write_compressed_pages(cc, submitted,
-							wbc, io_type);
-		if (!err)
-			return 0;
-		f2fs_bug_on(F2FS_I_SB(cc->inode), err != -EAGAIN);
+	if (!compressed) {
+		goto write;
+	} else if (err == -EAGAIN) {
+		add_compr_block_stat(cc->inode, cc->cluster_size);
+		goto write;
+	} else if (err) {
+		f2fs_put_rpages_wbc(cc, wbc, true, 1);
+		goto destroy_out;
 	}
+
+	err = f2fs_write_compressed_pages(cc, submitted, wbc, io_type);
+	if (!err)
+		return 0;
+	f2fs_bug_on(F2FS_I_SB(cc->inode), err != -EAGAIN);
 write:
 	f2fs_bug_on(F2FS_I_SB(cc->inode), *submitted);
 
@@ -1590,6 +1595,125 @@ int f2fs_write_multi_pages(struct compress_ctx *cc,
 	return err;
 }
 
+/*
+ * A cluster taken over by the writeback compression workqueue.  The raw
+ * pages stay locked until the writeback context submits the cluster, which
+ * is always done in cluster order.
+ */
+struct f2fs_compress_work {
+	struct compress_ctx cc;
+	struct work_struct work;
+	struct completion done;
+	struct f2fs_compress_work *next;
+	int err;
+};
+
+static void f2fs_compress_work_fn(struct work_struct *work)
+{
+	struct f2fs_compress_work *cw =
+			container_of(work, struct f2fs_compress_work, work);
+
+	cw->err = f2fs_compress_pages(&cw->cc);
+	complete(&cw->done);
+}
+
+static bool f2fs_queue_compress_work(struct compress_ctx *cc,
+					unsigned int depth)
+{
+	struct workqueue_struct *wq = F2FS_I_SB(cc->inode)->compress_wq;
+	struct f2fs_compress_work *cw, **tail;
+
+	if (!wq || cc->nr_pending >= depth)
+		return false;
+
+	cw = kmalloc(sizeof(*cw), GFP_NOFS);
+	if (!cw)
+		return false;
+
+	/* move the cluster over, @cc gets a new page array for the next one */
+	cw->cc = *cc;
+	cw->cc.pending = NULL;
+	cw->cc.nr_pending = 0;
+	cw->next = NULL;
+	init_completion(&cw->done);
+	INIT_WORK(&cw->work, f2fs_compress_work_fn);
+
+	cc->rpages = NULL;
+	cc->nr_rpages = 0;
+	cc->cluster_idx = NULL_CLUSTER;
+
+	for (tail = &cc->pending; *tail; tail = &(*tail)->next)
+		;
+	*tail = cw;
+	cc->nr_pending++;
+	queue_work(wq, &cw->work);
+	return true;
+}
+
+/* submit the oldest @nr clusters compressed in background, in order */
+int f2fs_flush_compress_work(struct compress_ctx *cc, unsigned int nr,
+					int *submitted,
+					struct writeback_control *wbc,
+					enum iostat_type io_type)
+{
+	int err = 0;
+
+	while (cc->pending && nr--) {
+		struct f2fs_compress_work *cw = cc->pending;
+		int nr_submitted, ret;
+
+		wait_for_completion(&cw->done);
+		cc->pending = cw->next;
+		cc->nr_pending--;
+
+		ret = f2fs_write_cluster(&cw->cc, true, cw->err,
+					&nr_submitted, wbc, io_type);
+		*submitted += nr_submitted;
+		if (ret && !err)
+			err = ret;
+		kfree(cw);
+	}
+	return err;
+}
+
+int f2fs_write_multi_pages(struct compress_ctx *cc,
+					int *submitted,
+					struct writeback_control *wbc,
+					enum iostat_type io_type)
+{
+	unsigned int depth =
+		READ_ONCE(F2FS_I_SB(cc->inode)->compress_pipeline_depth);
+	bool may_compress;
+	int nr_submitted = 0;
+	int err = 0, ret;
+
+	*submitted = 0;
+	may_compress = !f2fs_cluster_is_empty(cc) && cluster_may_compress(cc);
+
+	/* make room for this cluster in the pipeline */
+	if (may_compress && depth && cc->nr_pending >= depth)
+		err = f2fs_flush_compress_work(cc, cc->nr_pending - depth + 1,
+						submitted, wbc, io_type);
+	if (!err && may_compress && f2fs_queue_compress_work(cc, depth))
+		return 0;
+
+	/*
+	 * Keep clusters submitted in order.  The cluster in @cc still holds
+	 * its locked pages, so write it even if an earlier one failed.
+	 */
+	ret = f2fs_flush_compress_work(cc, UINT_MAX, submitted, wbc, io_type);
+	if (!err)
+		err = ret;
+	if (f2fs_cluster_is_empty(cc))
+		return err;
+
+	ret = f2fs_write_cluster(cc, may_compress,
+			may_compress ? f2fs_compress_pages(cc) : 0,
+			&nr_submitted, wbc, io_type);
+	*submitted += nr_submitted;
+	return err ?: ret;
+}
+
 static inline bool allow_memalloc_for_decomp(struct f2fs_sb_info *sbi,
 		bool pre_alloc)
 {
@@ -1991,6 +2115,22 @@ void f2fs_invalidate_compress_pages(struct f2fs_sb_info *sbi, nid_t ino)
 	} while (index < end);
 }
 
+int f2fs_init_compress_wq(struct f2fs_sb_info *sbi)
+{
+	if (!f2fs_sb_has_compression(sbi))
+		return 0;
+
+	sbi->compress_wq = alloc_workqueue("f2fs_compress_wq",
+					WQ_UNBOUND, num_online_cpus());
+	return sbi->compress_wq ? 0 : -ENOMEM;
+}
+
+void f2fs_destroy_compress_wq(struct f2fs_sb_info *sbi)
+{
+	if (sbi->compress_wq)
+		destroy_workqueue(sbi->compress_wq);
+}
+
 int f2fs_init_compress_inode(struct f2fs_sb_info *sbi)
 {
 	struct inode *inode;
@@ -3237,6 +3237,21 @@ static int f2fs_write_cache_pages(struct address_space *mapping,
 			retry = 0;
 		}
 	}
+	/* and the clusters still in the compression pipeline, on any exit */
+	if (f2fs_compressed_file(inode) && cc.nr_pending) {
+		int ret2;
+
+		submitted = 0;
+		ret2 = f2fs_flush_compress_work(&cc, UINT_MAX, &submitted,
+						wbc, io_type);
+		nwritten += submitted;
+		wbc->nr_to_write -= submitted;
+		if (ret2 && !ret) {
+			ret = ret2;
+			done = 1;
+			retry = 0;
+		}
+	}
 	if (f2fs_compressed_file(inode))
 		f2fs_destroy_compress_ctx(&cc, false);
 #endif
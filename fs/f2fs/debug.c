@@ -543,6 +543,19 @@ static int stat_show(struct seq_file *s, void *v)
 				sbi->gc_reclaimed_segs[GC_URGENT_HIGH]);
 		seq_printf(s, "    - Urgent Mid : %d\n", sbi->gc_reclaimed_segs[GC_URGENT_MID]);
 		seq_printf(s, "    - Urgent Low : %d\n", sbi->gc_reclaimed_segs[GC_URGENT_LOW]);
+		seq_puts(s, "  - Victims (avg valid blocks) :\n");
+		seq_printf(s, "    - Cost-Benefit : %d (%llu)\n",
+				si->gc_victims[GC_CB], !si->gc_victims[GC_CB] ? 0 :
+				div_u64(si->gc_victim_blks[GC_CB], si->gc_victims[GC_CB]));
+		seq_printf(s, "    - Greedy : %d (%llu)\n",
+				si->gc_victims[GC_GREEDY], !si->gc_victims[GC_GREEDY] ? 0 :
+				div_u64(si->gc_victim_blks[GC_GREEDY], si->gc_victims[GC_GREEDY]));
+		seq_printf(s, "    - Age-threshold : %d (%llu)\n",
+				si->gc_victims[GC_AT], !si->gc_victims[GC_AT] ? 0 :
+				div_u64(si->gc_victim_blks[GC_AT], si->gc_victims[GC_AT]));
+		seq_printf(s, "    - Temperature-age : %d (%llu)\n",
+				si->gc_victims[GC_TA], !si->gc_victims[GC_TA] ? 0 :
+				div_u64(si->gc_victim_blks[GC_TA], si->gc_victims[GC_TA]));
 		seq_printf(s, "Try to move %d blocks (BG: %d)\n", si->tot_blks,
 				si->bg_data_blks + si->bg_node_blks);
 		seq_printf(s, "  - data blocks : %d (%d)\n", si->data_blks,
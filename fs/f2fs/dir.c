@@ -970,6 +970,35 @@ bool f2fs_empty_dir(struct inode *dir)
 	return true;
 }
 
+/*
+ * Prefetch the NAT entries of the dentries about to be emitted, so that the
+ * per-dentry f2fs_ra_node_page() below does not block on NAT reads one by one.
+ */
+static void f2fs_ra_dentry_nats(struct f2fs_sb_info *sbi,
+			struct f2fs_dentry_ptr *d, unsigned int bit_pos)
+{
+	nid_t nids[F2FS_RA_NAT_BATCH];
+	unsigned int nr = 0;
+
+	while (nr < F2FS_RA_NAT_BATCH) {
+		struct f2fs_dir_entry *de;
+
+		bit_pos = find_next_bit_le(d->bitmap, d->max, bit_pos);
+		if (bit_pos >= d->max)
+			break;
+
+		de = &d->dentry[bit_pos];
+		if (de->name_len == 0) {
+			bit_pos++;
+			continue;
+		}
+		nids[nr++] = le32_to_cpu(de->ino);
+		bit_pos += GET_DENTRY_SLOTS(le16_to_cpu(de->name_len));
+	}
+
+	f2fs_ra_node_info(sbi, nids, nr, false);
+}
+
 int f2fs_fill_dentries(struct dir_context *ctx, struct f2fs_dentry_ptr *d,
 			unsigned int start_pos, struct fscrypt_str *fstr)
 {
@@ -985,8 +1014,10 @@ int f2fs_fill_dentries(struct dir_context *ctx, struct f2fs_dentry_ptr *d,
 
 	bit_pos = ((unsigned long)ctx->pos % d->max);
 
-	if (readdir_ra)
+	if (readdir_ra) {
 		blk_start_plug(&plug);
+		f2fs_ra_dentry_nats(sbi, d, bit_pos);
+	}
 
 	while (bit_pos < d->max) {
 		bit_pos = find_next_bit_le(d->bitmap, d->max, bit_pos);
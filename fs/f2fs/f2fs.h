@@ -1150,8 +1150,16 @@ enum cp_reason_type {
 	CP_FASTBOOT_MODE,
 	CP_SPEC_LOG_NUM,
 	CP_RECOVER_DIR,
+	NR_CP_REASON,
 };
 
+/* fsync latency histogram buckets: < 64us, < 128us, ..., >= 64ms */
+#define FSYNC_LAT_BUCKET_MIN_SHIFT	6
+#define NR_FSYNC_LAT_BUCKET		12
+
+/* per-uid iostat slots, uids beyond that are folded into the last one */
+#define IOSTAT_UID_SLOTS		16
+
 enum iostat_type {
 	/* WRITE IO */
 	APP_DIRECT_IO,			/* app direct write IOs */
@@ -1441,6 +1449,8 @@ enum compress_flag {
 
 #define	COMPRESS_WATERMARK			20
 #define	COMPRESS_PERCENT			20
+/* upper bound of clusters compressed in background per writeback */
+#define MAX_COMPRESS_PIPELINE_DEPTH		64
 
 #define COMPRESS_DATA_RESERVED_SIZE		4
 struct compress_data {
@@ -1475,6 +1485,8 @@ struct compress_ctx {
 	size_t clen;			/* valid data length in cbuf */
 	void *private;			/* payload buffer for specified compression algorithm */
 	void *private2;			/* extra payload buffer */
+	struct f2fs_compress_work *pending;	/* clusters compressed in background */
+	unsigned int nr_pending;	/* # of clusters in pending list */
 };
 
 /* compress context for write IO path */
@@ -1601,6 +1613,8 @@ struct f2fs_sb_info {
 	/* for extent tree cache */
 	struct extent_tree_info extent_tree[NR_EXTENT_CACHES];
 	atomic64_t allocated_data_blocks;	/* for block age extent_cache */
+	/* memory budget (in KB) of read and age extent caches, 0: ram_thresh */
+	unsigned int extent_cache_budget;
 
 	/* The threshold used for hot and warm data seperation*/
 	unsigned int hot_data_age_threshold;
@@ -1677,6 +1691,8 @@ struct f2fs_sb_info {
 
 	/* maximum # of trials to find a victim segment for SSR and GC */
 	unsigned int max_victim_search;
+	/* use temperature-aware cost-benefit victim selection for BG_GC */
+	unsigned int gc_temp_aware;
 	/* migration granularity of garbage collection, unit: segment */
 	unsigned int migration_granularity;
 
@@ -1750,6 +1766,11 @@ struct f2fs_sb_info {
 	__u32 s_chksum_seed;
 
 	struct workqueue_struct *post_read_wq;	/* post read workqueue */
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+	struct workqueue_struct *compress_wq;	/* writeback compression workqueue */
+	/* max # of clusters compressed asynchronously per writeback */
+	unsigned int compress_pipeline_depth;
+#endif
 
 	/*
 	 * If we are in irq context, let's update error information into
@@ -1801,7 +1822,19 @@ struct f2fs_sb_info {
 	unsigned long long iostat_count[NR_IO_TYPE];
 	unsigned long long iostat_bytes[NR_IO_TYPE];
 	unsigned long long prev_iostat_bytes[NR_IO_TYPE];
+	/* raw/compressed bytes and time spent for each compress algorithm */
+	unsigned long long iostat_compr_rbytes[COMPRESS_MAX];
+	unsigned long long iostat_compr_cbytes[COMPRESS_MAX];
+	unsigned long long iostat_compr_ns[COMPRESS_MAX];
+	/* fsync count and latency for each cp_reason, and latency histogram */
+	unsigned long long iostat_fsync_count[NR_CP_REASON];
+	unsigned long long iostat_fsync_lat[NR_CP_REASON];
+	unsigned long long iostat_fsync_hist[NR_FSYNC_LAT_BUCKET];
 	bool iostat_enable;
+	bool iostat_uid_enable;
+	/* owner of each per-uid slot, (uid_t)-1 if the slot is free */
+	uid_t iostat_uid[IOSTAT_UID_SLOTS];
+	struct iostat_uid_info __percpu *iostat_uid_info;
 	unsigned long iostat_next_period;
 	unsigned int iostat_period_ms;
 
@@ -3645,6 +3678,8 @@ bool f2fs_nat_bitmap_enabled(struct f2fs_sb_info *sbi);
 int f2fs_remove_inode_page(struct inode *inode);
 struct page *f2fs_new_inode_page(struct inode *inode);
 struct page *f2fs_new_node_page(struct dnode_of_data *dn, unsigned int ofs);
+void f2fs_ra_node_info(struct f2fs_sb_info *sbi, const nid_t *nids,
+					unsigned int nr, bool sync);
 void f2fs_ra_node_page(struct f2fs_sb_info *sbi, nid_t nid);
 struct page *f2fs_get_node_page(struct f2fs_sb_info *sbi, pgoff_t nid);
 struct page *f2fs_get_node_page_ra(struct page *parent, int start);
@@ -3958,6 +3993,8 @@ struct f2fs_stat_info {
 	int gc_call_count[MAX_CALL_TYPE];
 	int gc_segs[2][2];
 	int gc_secs[2][2];
+	int gc_victims[MAX_GC_POLICY];
+	unsigned long long gc_victim_blks[MAX_GC_POLICY];
 	int tot_blks, data_blks, node_blks;
 	int bg_data_blks, bg_node_blks;
 	int curseg[NR_CURSEG_TYPE];
@@ -4072,6 +4109,11 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		(F2FS_STAT(sbi)->gc_secs[(type)][(gc_type)]++)
 #define stat_inc_gc_seg_count(sbi, type, gc_type)			\
 		(F2FS_STAT(sbi)->gc_segs[(type)][(gc_type)]++)
+#define stat_inc_gc_victim_count(sbi, gc_mode, blks)			\
+	do {								\
+		F2FS_STAT(sbi)->gc_victims[(gc_mode)]++;		\
+		F2FS_STAT(sbi)->gc_victim_blks[(gc_mode)] += (blks);	\
+	} while (0)
 
 #define stat_inc_tot_blk_count(si, blks)				\
 	((si)->tot_blks += (blks))
@@ -4130,6 +4172,7 @@ void f2fs_update_sit_info(struct f2fs_sb_info *sbi);
 #define stat_inc_gc_call_count(sbi, foreground)		do { } while (0)
 #define stat_inc_gc_sec_count(sbi, type, gc_type)	do { } while (0)
 #define stat_inc_gc_seg_count(sbi, type, gc_type)	do { } while (0)
+#define stat_inc_gc_victim_count(sbi, gc_mode, blks)	do { } while (0)
 #define stat_inc_tot_blk_count(si, blks)		do { } while (0)
 #define stat_inc_data_blk_count(sbi, blks, gc_type)	do { } while (0)
 #define stat_inc_node_blk_count(sbi, blks, gc_type)	do { } while (0)
@@ -4298,6 +4341,10 @@ int f2fs_write_multi_pages(struct compress_ctx *cc,
 						int *submitted,
 						struct writeback_control *wbc,
 						enum iostat_type io_type);
+int f2fs_flush_compress_work(struct compress_ctx *cc, unsigned int nr,
+						int *submitted,
+						struct writeback_control *wbc,
+						enum iostat_type io_type);
 int f2fs_is_compressed_cluster(struct inode *inode, pgoff_t index);
 void f2fs_update_read_extent_tree_range_compressed(struct inode *inode,
 				pgoff_t fofs, block_t blkaddr,
@@ -4314,6 +4361,8 @@ unsigned int f2fs_cluster_blocks_are_contiguous(struct dnode_of_data *dn,
 int f2fs_init_compress_ctx(struct compress_ctx *cc);
 void f2fs_destroy_compress_ctx(struct compress_ctx *cc, bool reuse);
 void f2fs_init_compress_info(struct f2fs_sb_info *sbi);
+int f2fs_init_compress_wq(struct f2fs_sb_info *sbi);
+void f2fs_destroy_compress_wq(struct f2fs_sb_info *sbi);
 int f2fs_init_compress_inode(struct f2fs_sb_info *sbi);
 void f2fs_destroy_compress_inode(struct f2fs_sb_info *sbi);
 int f2fs_init_page_array_cache(struct f2fs_sb_info *sbi);
@@ -4370,6 +4419,8 @@ static inline void f2fs_put_page_dic(struct page *page, bool in_task)
 static inline unsigned int f2fs_cluster_blocks_are_contiguous(
 			struct dnode_of_data *dn, unsigned int ofs_in_node) { return 0; }
 static inline bool f2fs_sanity_check_cluster(struct dnode_of_data *dn) { return false; }
+static inline int f2fs_init_compress_wq(struct f2fs_sb_info *sbi) { return 0; }
+static inline void f2fs_destroy_compress_wq(struct f2fs_sb_info *sbi) { }
 static inline int f2fs_init_compress_inode(struct f2fs_sb_info *sbi) { return 0; }
 static inline void f2fs_destroy_compress_inode(struct f2fs_sb_info *sbi) { }
 static inline int f2fs_init_page_array_cache(struct f2fs_sb_info *sbi) { return 0; }
@@ -220,6 +220,8 @@ static int select_gc_type(struct f2fs_sb_info *sbi, int gc_type)
 	if (gc_type == BG_GC) {
 		if (sbi->am.atgc_enabled)
 			gc_mode = GC_AT;
+		else if (sbi->gc_temp_aware)
+			gc_mode = GC_TA;
 		else
 			gc_mode = GC_CB;
 	} else {
@@ -228,7 +230,7 @@ static int select_gc_type(struct f2fs_sb_info *sbi, int gc_type)
 
 	switch (sbi->gc_mode) {
 	case GC_IDLE_CB:
-		gc_mode = GC_CB;
+		gc_mode = sbi->gc_temp_aware ? GC_TA : GC_CB;
 		break;
 	case GC_IDLE_GREEDY:
 	case GC_URGENT_HIGH:
@@ -306,6 +308,8 @@ static unsigned int get_max_cost(struct f2fs_sb_info *sbi,
 		return UINT_MAX;
 	else if (p->gc_mode == GC_AT)
 		return UINT_MAX;
+	else if (p->gc_mode == GC_TA)
+		return UINT_MAX;
 	else /* No other gc_mode */
 		return 0;
 }
@@ -329,7 +333,8 @@ static unsigned int check_bg_victims(struct f2fs_sb_info *sbi)
 	return NULL_SEGNO;
 }
 
-static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
+static unsigned int get_cb_benefit(struct f2fs_sb_info *sbi,
+						unsigned int segno)
 {
 	struct sit_info *sit_i = SIT_I(sbi);
 	unsigned int secno = GET_SEC_FROM_SEG(sbi, segno);
@@ -359,7 +364,38 @@ static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
 		age = 100 - div64_u64(100 * (mtime - sit_i->min_mtime),
 				sit_i->max_mtime - sit_i->min_mtime);
 
-	return UINT_MAX - ((100 * (100 - u) * age) / (100 + u));
+	return (100 * (100 - u) * age) / (100 + u);
+}
+
+static unsigned int get_cb_cost(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	return UINT_MAX - get_cb_benefit(sbi, segno);
+}
+
+/*
+ * Valid blocks left in hot segments are likely to be overwritten soon, so
+ * migrating them now mostly rewrites data which would die anyway, whereas
+ * what survives in cold segments is stable and only has to be moved once.
+ * Scale the cost-benefit score up for colder segments accordingly.
+ */
+static unsigned int get_ta_cost(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	unsigned int weight;
+
+	switch (get_seg_entry(sbi, segno)->type) {
+	case CURSEG_HOT_DATA:
+	case CURSEG_HOT_NODE:
+		weight = 1;
+		break;
+	case CURSEG_WARM_DATA:
+	case CURSEG_WARM_NODE:
+		weight = 2;
+		break;
+	default:
+		weight = 4;
+		break;
+	}
+	return UINT_MAX - get_cb_benefit(sbi, segno) * weight;
 }
 
 static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
@@ -373,6 +409,8 @@ static inline unsigned int get_gc_cost(struct f2fs_sb_info *sbi,
 		return get_valid_blocks(sbi, segno, true);
 	else if (p->gc_mode == GC_CB)
 		return get_cb_cost(sbi, segno);
+	else if (p->gc_mode == GC_TA)
+		return get_ta_cost(sbi, segno);
 
 	f2fs_bug_on(sbi, 1);
 	return 0;
@@ -917,6 +955,8 @@ int f2fs_get_victim(struct f2fs_sb_info *sbi, unsigned int *result,
 		*result = (p.min_segno / p.ofs_unit) * p.ofs_unit;
 got_result:
 		if (p.alloc_mode == LFS) {
+			stat_inc_gc_victim_count(sbi, p.gc_mode,
+				get_valid_blocks(sbi, p.min_segno, true));
 			secno = GET_SEC_FROM_SEG(sbi, p.min_segno);
 			if (gc_type == FG_GC)
 				sbi->cur_victim_sec = secno;
@@ -1026,8 +1066,7 @@ static int gc_node_segment(struct f2fs_sb_info *sbi,
 			continue;
 
 		if (phase == 0) {
-			f2fs_ra_meta_pages(sbi, NAT_BLOCK_OFFSET(nid), 1,
-							META_NAT, true);
+			f2fs_ra_node_info(sbi, &nid, 1, true);
 			continue;
 		}
 
@@ -1529,8 +1568,7 @@ static int gc_data_segment(struct f2fs_sb_info *sbi, struct f2fs_summary *sum,
 			continue;
 
 		if (phase == 0) {
-			f2fs_ra_meta_pages(sbi, NAT_BLOCK_OFFSET(nid), 1,
-							META_NAT, true);
+			f2fs_ra_node_info(sbi, &nid, 1, true);
 			continue;
 		}
 
@@ -9,6 +9,7 @@
 #include <linux/fs.h>
 #include <linux/f2fs_fs.h>
 #include <linux/seq_file.h>
+#include <linux/cred.h>
 
 #include "f2fs.h"
 #include "iostat.h"
@@ -30,10 +31,34 @@ static inline unsigned long long iostat_get_avg_bytes(struct f2fs_sb_info *sbi,
 			sbi->iostat_count[type],			\
 			iostat_get_avg_bytes(sbi, type))
 
+/* bytes per nanosecond * 1000 is MB/s */
+#define IOSTAT_COMPR_SHOW(name, algo)					\
+	seq_printf(seq, "%-23s %-16llu %-16llu %-16llu\n",		\
+			name":", sbi->iostat_compr_rbytes[algo],	\
+			sbi->iostat_compr_cbytes[algo],			\
+			sbi->iostat_compr_ns[algo] ?			\
+			div64_u64(sbi->iostat_compr_rbytes[algo] * 1000,\
+				sbi->iostat_compr_ns[algo]) : 0)
+
+static const char *fsync_cp_reason_names[NR_CP_REASON] = {
+	"no needed",
+	"non regular",
+	"compressed",
+	"hardlink",
+	"sb needs cp",
+	"wrong pino",
+	"no space roll forward",
+	"node needs cp",
+	"fastboot mode",
+	"log type is 2",
+	"dir needs recovery",
+};
+
 int __maybe_unused iostat_info_seq_show(struct seq_file *seq, void *offset)
 {
 	struct super_block *sb = seq->private;
 	struct f2fs_sb_info *sbi = F2FS_SB(sb);
+	int i;
 
 	if (!sbi->iostat_enable)
 		return 0;
@@ -82,6 +107,130 @@ int __maybe_unused iostat_info_seq_show(struct seq_file *seq, void *offset)
 	IOSTAT_INFO_SHOW("fs flush", FS_FLUSH_IO);
 	IOSTAT_INFO_SHOW("fs zone reset", FS_ZONE_RESET_IO);
 
+#ifdef CONFIG_F2FS_FS_COMPRESSION
+	/* print compression throughput */
+	seq_puts(seq, "[COMPRESS]\n");
+	seq_printf(seq, "\t\t\t%-16s %-16s %-16s\n",
+				"raw_bytes", "comp_bytes", "raw_MB/s");
+	IOSTAT_COMPR_SHOW("lzo", COMPRESS_LZO);
+	IOSTAT_COMPR_SHOW("lz4", COMPRESS_LZ4);
+	IOSTAT_COMPR_SHOW("zstd", COMPRESS_ZSTD);
+	IOSTAT_COMPR_SHOW("lzo-rle", COMPRESS_LZORLE);
+#endif
+
+	/* print fsync count and average latency per checkpoint reason */
+	seq_puts(seq, "[FSYNC]\n");
+	seq_printf(seq, "\t\t\t%-16s %-16s\n", "count", "avg_lat_us");
+	for (i = 0; i < NR_CP_REASON; i++)
+		seq_printf(seq, "%-23s %-16llu %-16llu\n",
+			fsync_cp_reason_names[i], sbi->iostat_fsync_count[i],
+			sbi->iostat_fsync_count[i] ?
+			div64_u64(sbi->iostat_fsync_lat[i],
+				sbi->iostat_fsync_count[i]) : 0);
+	for (i = 0; i < NR_FSYNC_LAT_BUCKET; i++)
+		seq_printf(seq, "%s%-5u us: %-16llu\n",
+			i == NR_FSYNC_LAT_BUCKET - 1 ? ">=" : "< ",
+			1U << (FSYNC_LAT_BUCKET_MIN_SHIFT +
+			       min(i, NR_FSYNC_LAT_BUCKET - 2)),
+			sbi->iostat_fsync_hist[i]);
+	return 0;
+}
+
+static unsigned int iostat_uid_lat_pct(unsigned long long *hist,
+			unsigned long long total, unsigned int pct)
+{
+	unsigned long long sum = 0;
+	int i;
+
+	if (!total)
+		return 0;
+
+	for (i = 0; i < NR_IOSTAT_UID_LAT_BUCKET - 1; i++) {
+		sum += hist[i];
+		if (sum * 100 >= total * pct)
+			break;
+	}
+	return 1U << i;
+}
+
+static void iostat_uid_sum(struct f2fs_sb_info *sbi, unsigned int slot,
+			struct iostat_uid_info *sum)
+{
+	int cpu, rw, i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		struct iostat_uid_info *info =
+			per_cpu_ptr(sbi->iostat_uid_info, cpu) + slot;
+
+		for (rw = READ; rw <= WRITE; rw++) {
+			sum->bytes[rw] += info->bytes[rw];
+			for (i = 0; i < NR_IOSTAT_UID_LAT_BUCKET; i++)
+				sum->lat_hist[rw][i] += info->lat_hist[rw][i];
+		}
+	}
+}
+
+int __maybe_unused iostat_uid_info_seq_show(struct seq_file *seq,
+			void *offset)
+{
+	struct super_block *sb = seq->private;
+	struct f2fs_sb_info *sbi = F2FS_SB(sb);
+	unsigned long long total[IOSTAT_UID_SLOTS + 1];
+	bool shown[IOSTAT_UID_SLOTS + 1] = { false };
+	struct iostat_uid_info sum;
+	int slot, i, j, rw;
+
+	if (!sbi->iostat_enable || !sbi->iostat_uid_enable)
+		return 0;
+
+	for (slot = 0; slot <= IOSTAT_UID_OTHER; slot++) {
+		iostat_uid_sum(sbi, slot, &sum);
+		total[slot] = sum.bytes[READ] + sum.bytes[WRITE];
+	}
+
+	seq_printf(seq, "%-10s %-16s %-16s %-8s %-8s %-8s %-8s %-8s %-8s\n",
+			"uid", "read_bytes", "write_bytes",
+			"rd_p50", "rd_p90", "rd_p99",
+			"wr_p50", "wr_p90", "wr_p99");
+
+	/* slots are few, print them ordered by the amount of app io */
+	for (i = 0; i <= IOSTAT_UID_OTHER; i++) {
+		unsigned long long cnt[2] = { 0, 0 };
+		int top = -1;
+
+		for (slot = 0; slot <= IOSTAT_UID_OTHER; slot++) {
+			if (shown[slot])
+				continue;
+			if (slot < IOSTAT_UID_OTHER &&
+			    READ_ONCE(sbi->iostat_uid[slot]) == (uid_t)-1)
+				continue;
+			if (top < 0 || total[slot] > total[top])
+				top = slot;
+		}
+		if (top < 0)
+			break;
+		shown[top] = true;
+
+		iostat_uid_sum(sbi, top, &sum);
+		for (rw = READ; rw <= WRITE; rw++)
+			for (j = 0; j < NR_IOSTAT_UID_LAT_BUCKET; j++)
+				cnt[rw] += sum.lat_hist[rw][j];
+
+		if (top == IOSTAT_UID_OTHER)
+			seq_printf(seq, "%-10s ", "other");
+		else
+			seq_printf(seq, "%-10u ", READ_ONCE(sbi->iostat_uid[top]));
+		seq_printf(seq, "%-16llu %-16llu", sum.bytes[READ],
+				sum.bytes[WRITE]);
+		for (rw = READ; rw <= WRITE; rw++)
+			seq_printf(seq, " %-8u %-8u %-8u",
+				iostat_uid_lat_pct(sum.lat_hist[rw], cnt[rw], 50),
+				iostat_uid_lat_pct(sum.lat_hist[rw], cnt[rw], 90),
+				iostat_uid_lat_pct(sum.lat_hist[rw], cnt[rw], 99));
+		seq_putc(seq, '\n');
+	}
+	seq_puts(seq, "(latency percentiles are upper bounds in ms)\n");
 	return 0;
 }
 
@@ -151,8 +300,25 @@ void f2fs_reset_iostat(struct f2fs_sb_info *sbi)
 		sbi->iostat_bytes[i] = 0;
 		sbi->prev_iostat_bytes[i] = 0;
 	}
+	for (i = 0; i < COMPRESS_MAX; i++) {
+		sbi->iostat_compr_rbytes[i] = 0;
+		sbi->iostat_compr_cbytes[i] = 0;
+		sbi->iostat_compr_ns[i] = 0;
+	}
+	for (i = 0; i < NR_CP_REASON; i++) {
+		sbi->iostat_fsync_count[i] = 0;
+		sbi->iostat_fsync_lat[i] = 0;
+	}
+	for (i = 0; i < NR_FSYNC_LAT_BUCKET; i++)
+		sbi->iostat_fsync_hist[i] = 0;
 	spin_unlock_irq(&sbi->iostat_lock);
 
+	for (i = 0; i < IOSTAT_UID_SLOTS; i++)
+		WRITE_ONCE(sbi->iostat_uid[i], (uid_t)-1);
+	for_each_possible_cpu(i)
+		memset(per_cpu_ptr(sbi->iostat_uid_info, i), 0,
+			sizeof(struct iostat_uid_info) * (IOSTAT_UID_SLOTS + 1));
+
 	spin_lock_irq(&sbi->iostat_lat_lock);
 	memset(io_lat, 0, sizeof(struct iostat_lat_info));
 	spin_unlock_irq(&sbi->iostat_lat_lock);
@@ -165,6 +331,53 @@ static inline void __f2fs_update_iostat(struct f2fs_sb_info *sbi,
 	sbi->iostat_count[type]++;
 }
 
+/*
+ * Find the slot of the current fsuid, claiming a free one on first use.
+ * Once all slots are taken, the remaining uids share IOSTAT_UID_OTHER.
+ */
+static unsigned int iostat_uid_slot(struct f2fs_sb_info *sbi)
+{
+	uid_t uid = from_kuid(&init_user_ns, current_fsuid());
+	int i;
+
+	for (i = 0; i < IOSTAT_UID_SLOTS; i++) {
+		uid_t owner = READ_ONCE(sbi->iostat_uid[i]);
+
+		if (owner == uid)
+			return i;
+		if (owner != (uid_t)-1)
+			continue;
+		owner = cmpxchg(&sbi->iostat_uid[i], (uid_t)-1, uid);
+		if (owner == (uid_t)-1 || owner == uid)
+			return i;
+	}
+	return IOSTAT_UID_OTHER;
+}
+
+static inline void f2fs_update_uid_iostat(struct f2fs_sb_info *sbi,
+			enum iostat_type type, unsigned long long io_bytes)
+{
+	int rw;
+
+	switch (type) {
+	case APP_BUFFERED_IO:
+	case APP_DIRECT_IO:
+	case APP_MAPPED_IO:
+		rw = WRITE;
+		break;
+	case APP_BUFFERED_READ_IO:
+	case APP_DIRECT_READ_IO:
+	case APP_MAPPED_READ_IO:
+		rw = READ;
+		break;
+	default:
+		return;
+	}
+
+	this_cpu_add(sbi->iostat_uid_info[iostat_uid_slot(sbi)].bytes[rw],
+			io_bytes);
+}
+
 void f2fs_update_iostat(struct f2fs_sb_info *sbi, struct inode *inode,
 			enum iostat_type type, unsigned long long io_bytes)
 {
@@ -173,6 +386,9 @@ void f2fs_update_iostat(struct f2fs_sb_info *sbi, struct inode *inode,
 	if (!sbi->iostat_enable)
 		return;
 
+	if (sbi->iostat_uid_enable)
+		f2fs_update_uid_iostat(sbi, type, io_bytes);
+
 	spin_lock_irqsave(&sbi->iostat_lock, flags);
 	__f2fs_update_iostat(sbi, type, io_bytes);
 
@@ -209,6 +425,41 @@ void f2fs_update_iostat(struct f2fs_sb_info *sbi, struct inode *inode,
 	f2fs_record_iostat(sbi);
 }
 
+void f2fs_update_compr_iostat(struct f2fs_sb_info *sbi, unsigned char algo,
+			size_t rlen, size_t clen, u64 ns)
+{
+	unsigned long flags;
+
+	if (!sbi->iostat_enable || algo >= COMPRESS_MAX)
+		return;
+
+	spin_lock_irqsave(&sbi->iostat_lock, flags);
+	sbi->iostat_compr_rbytes[algo] += rlen;
+	sbi->iostat_compr_cbytes[algo] += clen;
+	sbi->iostat_compr_ns[algo] += ns;
+	spin_unlock_irqrestore(&sbi->iostat_lock, flags);
+}
+
+void f2fs_update_fsync_iostat(struct f2fs_sb_info *sbi,
+			enum cp_reason_type cp_reason, u64 lat_us)
+{
+	unsigned long flags;
+	int bucket;
+
+	if (!sbi->iostat_enable || cp_reason >= NR_CP_REASON)
+		return;
+
+	bucket = fls64(lat_us >> FSYNC_LAT_BUCKET_MIN_SHIFT);
+	if (bucket >= NR_FSYNC_LAT_BUCKET)
+		bucket = NR_FSYNC_LAT_BUCKET - 1;
+
+	spin_lock_irqsave(&sbi->iostat_lock, flags);
+	sbi->iostat_fsync_count[cp_reason]++;
+	sbi->iostat_fsync_lat[cp_reason] += lat_us;
+	sbi->iostat_fsync_hist[bucket]++;
+	spin_unlock_irqrestore(&sbi->iostat_lock, flags);
+}
+
 static inline void __update_iostat_latency(struct bio_iostat_ctx *iostat_ctx,
 				enum iostat_lat_type lat_type)
 {
@@ -235,6 +486,15 @@ static inline void __update_iostat_latency(struct bio_iostat_ctx *iostat_ctx,
 	if (ts_diff > io_lat->peak_lat[lat_type][page_type])
 		io_lat->peak_lat[lat_type][page_type] = ts_diff;
 	spin_unlock_irqrestore(&sbi->iostat_lat_lock, flags);
+
+	if (iostat_ctx->uid_slot != IOSTAT_UID_NONE) {
+		int bucket = fls(jiffies_to_msecs(ts_diff));
+
+		if (bucket >= NR_IOSTAT_UID_LAT_BUCKET)
+			bucket = NR_IOSTAT_UID_LAT_BUCKET - 1;
+		this_cpu_inc(sbi->iostat_uid_info[iostat_ctx->uid_slot].lat_hist
+				[lat_type == READ_IO ? READ : WRITE][bucket]);
+	}
 }
 
 void iostat_update_and_unbind_ctx(struct bio *bio)
@@ -264,6 +524,8 @@ void iostat_alloc_and_bind_ctx(struct f2fs_sb_info *sbi,
 	iostat_ctx->sbi = sbi;
 	iostat_ctx->submit_ts = 0;
 	iostat_ctx->type = 0;
+	iostat_ctx->uid_slot = sbi->iostat_enable && sbi->iostat_uid_enable ?
+				iostat_uid_slot(sbi) : IOSTAT_UID_NONE;
 	iostat_ctx->post_read_ctx = ctx;
 	bio->bi_private = iostat_ctx;
 }
@@ -296,20 +558,34 @@ void f2fs_destroy_iostat_processing(void)
 
 int f2fs_init_iostat(struct f2fs_sb_info *sbi)
 {
+	int i;
+
 	/* init iostat info */
 	spin_lock_init(&sbi->iostat_lock);
 	spin_lock_init(&sbi->iostat_lat_lock);
 	sbi->iostat_enable = false;
+	sbi->iostat_uid_enable = false;
 	sbi->iostat_period_ms = DEFAULT_IOSTAT_PERIOD_MS;
 	sbi->iostat_io_lat = f2fs_kzalloc(sbi, sizeof(struct iostat_lat_info),
 					GFP_KERNEL);
 	if (!sbi->iostat_io_lat)
 		return -ENOMEM;
 
+	for (i = 0; i < IOSTAT_UID_SLOTS; i++)
+		sbi->iostat_uid[i] = (uid_t)-1;
+	sbi->iostat_uid_info = __alloc_percpu(sizeof(struct iostat_uid_info) *
+				(IOSTAT_UID_SLOTS + 1),
+				__alignof__(struct iostat_uid_info));
+	if (!sbi->iostat_uid_info) {
+		kfree(sbi->iostat_io_lat);
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void f2fs_destroy_iostat(struct f2fs_sb_info *sbi)
 {
+	free_percpu(sbi->iostat_uid_info);
 	kfree(sbi->iostat_io_lat);
 }
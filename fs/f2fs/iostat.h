@@ -23,6 +23,18 @@ enum iostat_lat_type {
 /* maximum period of iostat tracing is 1 day */
 #define MAX_IOSTAT_PERIOD_MS		8640000
 
+/* per-uid latency histogram buckets: < 1ms, < 2ms, ..., >= 1024ms */
+#define NR_IOSTAT_UID_LAT_BUCKET	12
+/* slot index for uids which did not get a slot of their own */
+#define IOSTAT_UID_OTHER		IOSTAT_UID_SLOTS
+/* bio not attributed to any uid */
+#define IOSTAT_UID_NONE			(IOSTAT_UID_SLOTS + 1)
+
+struct iostat_uid_info {
+	unsigned long long bytes[2];				/* app READ/WRITE bytes */
+	unsigned long long lat_hist[2][NR_IOSTAT_UID_LAT_BUCKET];	/* bio latencies */
+};
+
 struct iostat_lat_info {
 	unsigned long sum_lat[MAX_IO_TYPE][NR_PAGE_TYPE];	/* sum of io latencies */
 	unsigned long peak_lat[MAX_IO_TYPE][NR_PAGE_TYPE];	/* peak io latency */
@@ -31,14 +43,21 @@ struct iostat_lat_info {
 
 extern int __maybe_unused iostat_info_seq_show(struct seq_file *seq,
 			void *offset);
+extern int __maybe_unused iostat_uid_info_seq_show(struct seq_file *seq,
+			void *offset);
 extern void f2fs_reset_iostat(struct f2fs_sb_info *sbi);
 extern void f2fs_update_iostat(struct f2fs_sb_info *sbi, struct inode *inode,
 			enum iostat_type type, unsigned long long io_bytes);
+extern void f2fs_update_compr_iostat(struct f2fs_sb_info *sbi,
+			unsigned char algo, size_t rlen, size_t clen, u64 ns);
+extern void f2fs_update_fsync_iostat(struct f2fs_sb_info *sbi,
+			enum cp_reason_type cp_reason, u64 lat_us);
 
 struct bio_iostat_ctx {
 	struct f2fs_sb_info *sbi;
 	unsigned long submit_ts;
 	enum page_type type;
+	unsigned int uid_slot;
 	struct bio_post_read_ctx *post_read_ctx;
 };
 
@@ -68,6 +87,10 @@ extern void f2fs_destroy_iostat(struct f2fs_sb_info *sbi);
 #else
 static inline void f2fs_update_iostat(struct f2fs_sb_info *sbi, struct inode *inode,
 		enum iostat_type type, unsigned long long io_bytes) {}
+static inline void f2fs_update_compr_iostat(struct f2fs_sb_info *sbi,
+		unsigned char algo, size_t rlen, size_t clen, u64 ns) {}
+static inline void f2fs_update_fsync_iostat(struct f2fs_sb_info *sbi,
+		enum cp_reason_type cp_reason, u64 lat_us) {}
 static inline void iostat_update_and_unbind_ctx(struct bio *bio) {}
 static inline void iostat_alloc_and_bind_ctx(struct f2fs_sb_info *sbi,
 		struct bio *bio, struct bio_post_read_ctx *ctx) {}
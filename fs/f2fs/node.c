@@ -42,6 +42,15 @@ int f2fs_check_nid_range(struct f2fs_sb_info *sbi, nid_t nid)
 	return 0;
 }
 
+static unsigned long extent_cache_mem_size(struct f2fs_sb_info *sbi,
+						enum extent_type type)
+{
+	struct extent_tree_info *eti = &sbi->extent_tree[type];
+
+	return atomic_read(&eti->total_ext_tree) * sizeof(struct extent_tree) +
+		atomic_read(&eti->total_ext_node) * sizeof(struct extent_node);
+}
+
 bool f2fs_available_free_memory(struct f2fs_sb_info *sbi, int type)
 {
 	struct f2fs_nm_info *nm_i = NM_I(sbi);
@@ -85,15 +94,17 @@ bool f2fs_available_free_memory(struct f2fs_sb_info *sbi, int type)
 						sizeof(struct ino_entry);
 		mem_size >>= PAGE_SHIFT;
 		res = mem_size < ((avail_ram * nm_i->ram_thresh / 100) >> 1);
+	} else if (sbi->extent_cache_budget &&
+			(type == READ_EXTENT_CACHE || type == AGE_EXTENT_CACHE)) {
+		/* both extent caches share one budget */
+		mem_size = (extent_cache_mem_size(sbi, EX_READ) +
+			    extent_cache_mem_size(sbi, EX_BLOCK_AGE)) >> 10;
+		res = mem_size < sbi->extent_cache_budget;
 	} else if (type == READ_EXTENT_CACHE || type == AGE_EXTENT_CACHE) {
 		enum extent_type etype = type == READ_EXTENT_CACHE ?
 						EX_READ : EX_BLOCK_AGE;
-		struct extent_tree_info *eti = &sbi->extent_tree[etype];
 
-		mem_size = (atomic_read(&eti->total_ext_tree) *
-				sizeof(struct extent_tree) +
-				atomic_read(&eti->total_ext_node) *
-				sizeof(struct extent_node)) >> PAGE_SHIFT;
+		mem_size = extent_cache_mem_size(sbi, etype) >> PAGE_SHIFT;
 		res = mem_size < ((avail_ram * nm_i->ram_thresh / 100) >> 2);
 	} else if (type == DISCARD_CACHE) {
 		mem_size = (atomic_read(&dcc->discard_cmd_cnt) *
@@ -1409,6 +1420,47 @@ static int read_node_page(struct page *page, blk_opf_t op_flags)
 	return err;
 }
 
+/*
+ * Readahead the NAT blocks backing a batch of nids whose node info is not
+ * cached yet, so that the following f2fs_get_node_info() calls hit memory
+ * instead of issuing one synchronous NAT read per nid.
+ */
+void f2fs_ra_node_info(struct f2fs_sb_info *sbi, const nid_t *nids,
+					unsigned int nr, bool sync)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	pgoff_t blks[F2FS_RA_NAT_BATCH];
+	unsigned int nr_blks = 0, i, j;
+	struct blk_plug plug;
+
+	f2fs_down_read(&nm_i->nat_tree_lock);
+	for (i = 0; i < nr && nr_blks < F2FS_RA_NAT_BATCH; i++) {
+		pgoff_t blk;
+
+		if (!nids[i] || nids[i] < F2FS_ROOT_INO(sbi) ||
+				nids[i] >= nm_i->max_nid)
+			continue;
+		if (__lookup_nat_cache(nm_i, nids[i]))
+			continue;
+
+		blk = NAT_BLOCK_OFFSET(nids[i]);
+		for (j = 0; j < nr_blks; j++)
+			if (blks[j] == blk)
+				break;
+		if (j == nr_blks)
+			blks[nr_blks++] = blk;
+	}
+	f2fs_up_read(&nm_i->nat_tree_lock);
+
+	if (!nr_blks)
+		return;
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr_blks; i++)
+		f2fs_ra_meta_pages(sbi, blks[i], 1, META_NAT, sync);
+	blk_finish_plug(&plug);
+}
+
 /*
  * Readahead a node page
  */
@@ -1875,7 +1927,14 @@ int f2fs_fsync_node_pages(struct f2fs_sb_info *sbi, struct inode *inode,
 		goto retry;
 	}
 out:
-	if (nwritten)
+	/*
+	 * If other fsyncs are writing node pages concurrently, leave the
+	 * merged bio open so that their dnodes go out in the same bio. It
+	 * gets submitted at the latest by f2fs_wait_on_node_pages_writeback()
+	 * of whoever waits first; atomic callers don't wait, so submit now.
+	 */
+	if (nwritten && (atomic || ret ||
+			atomic_read(&sbi->wb_sync_req[NODE]) <= 1))
 		f2fs_submit_merged_write_cond(sbi, NULL, NULL, ino, NODE);
 	return ret ? -EIO : 0;
 }
@@ -23,6 +23,9 @@
 /* maximum readahead size for node during getting data blocks */
 #define MAX_RA_NODE		128
 
+/* maximum number of nids resolved by one batched NAT readahead */
+#define F2FS_RA_NAT_BATCH	64
+
 /* control the memory footprint threshold (10MB per 1GB ram) */
 #define DEF_RAM_THRESHOLD	1
 
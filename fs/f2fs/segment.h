@@ -153,11 +153,13 @@ enum {
  * GC_CB is based on cost-benefit algorithm.
  * GC_GREEDY is based on greedy algorithm.
  * GC_AT is based on age-threshold algorithm.
+ * GC_TA is cost-benefit weighted by the temperature of the segment.
  */
 enum {
 	GC_CB = 0,
 	GC_GREEDY,
 	GC_AT,
+	GC_TA,
 	ALLOC_NEXT,
 	FLUSH_DEVICE,
 	MAX_GC_POLICY,
@@ -10,6 +10,7 @@
 #include <linux/filelock.h>
 #include <linux/filter.h>
 #include <linux/fs_stack.h>
+#include <linux/moduleparam.h>
 #include <linux/splice.h>
 #include <linux/namei.h>
 
@@ -25,6 +26,11 @@ struct fuse_bpf_aio_req {
 
 static struct kmem_cache *fuse_bpf_aio_request_cachep;
 
+static unsigned int backing_attr_timeout_ms;
+module_param(backing_attr_timeout_ms, uint, 0644);
+MODULE_PARM_DESC(backing_attr_timeout_ms,
+		 "Cache attributes of backing inodes for this long (0 = never)");
+
 static void fuse_stat_to_attr(struct fuse_conn *fc, struct inode *inode,
 		struct kstat *stat, struct fuse_attr *attr);
 
@@ -983,6 +989,7 @@ ssize_t fuse_splice_read_backing(struct file *in, loff_t *ppos,
 
 	ret = vfs_splice_read(ff->backing_file, ppos, pipe, len, flags);
 	fuse_file_accessed(in, ff->backing_file);
+	fuse_bpf_count_backing(get_fuse_conn(file_inode(in)), FUSE_READ);
 
 	return ret;
 }
@@ -1966,13 +1973,47 @@ int fuse_getattr_backing(struct fuse_bpf_args *fa,
 	else
 		err = vfs_getattr(backing_path, stat, request_mask, flags);
 
-	if (!err)
+	if (!err) {
+		unsigned int timeout = READ_ONCE(backing_attr_timeout_ms);
+
 		fuse_stat_to_attr(get_fuse_conn(entry->d_inode),
 				  backing_inode, stat, &fao->attr);
+		fao->attr_valid = timeout / MSEC_PER_SEC;
+		fao->attr_valid_nsec = (timeout % MSEC_PER_SEC) * NSEC_PER_MSEC;
+	}
 
 	return err;
 }
 
+/*
+ * With backing_attr_timeout_ms set, the attributes fetched from the backing
+ * inode are cached in the fuse inode like a regular FUSE_GETATTR reply, and
+ * getattr is served from there until they expire.  Inodes with a bpf filter
+ * always go to the backing path since the filter may rewrite the reply.
+ */
+bool fuse_backing_attr_cached(struct inode *inode, u32 request_mask,
+			      unsigned int flags)
+{
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	if (!READ_ONCE(backing_attr_timeout_ms) || !fi->backing_inode ||
+	    fi->bpf)
+		return false;
+
+	if (flags & AT_STATX_FORCE_SYNC)
+		return false;
+
+	if (request_mask & READ_ONCE(fi->inval_mask) &
+	    ~fuse_get_cache_mask(inode))
+		return false;
+
+	if (time_before64(fi->i_time, get_jiffies_64()))
+		return false;
+
+	fuse_bpf_count_backing(get_fuse_conn(inode), FUSE_GETATTR);
+	return true;
+}
+
 void *fuse_getattr_finalize(struct fuse_bpf_args *fa,
 			const struct dentry *entry, struct kstat *stat,
 			u32 request_mask, unsigned int flags)
@@ -2318,6 +2359,7 @@ struct extfuse_ctx {
 	struct dir_context ctx;
 	u8 *addr;
 	size_t offset;
+	size_t prev;
 };
 
 static bool filldir(struct dir_context *ctx, const char *name, int namelen,
@@ -2326,6 +2368,13 @@ static bool filldir(struct dir_context *ctx, const char *name, int namelen,
 	struct extfuse_ctx *ec = container_of(ctx, struct extfuse_ctx, ctx);
 	struct fuse_dirent *fd = (struct fuse_dirent *) (ec->addr + ec->offset);
 
+	/*
+	 * As in a FUSE_READDIR reply, ->off is the position to resume at
+	 * after the entry, i.e. the position of the next one.
+	 */
+	if (ec->offset)
+		((struct fuse_dirent *) (ec->addr + ec->prev))->off = offset;
+
 	if (ec->offset + sizeof(struct fuse_dirent) + namelen > PAGE_SIZE)
 		return false;
 
@@ -2337,12 +2386,14 @@ static bool filldir(struct dir_context *ctx, const char *name, int namelen,
 	};
 
 	memcpy(fd->name, name, namelen);
+	ec->prev = ec->offset;
 	ec->offset += FUSE_DIRENT_SIZE(fd);
 
 	return true;
 }
 
-static int parse_dirfile(char *buf, size_t nbytes, struct dir_context *ctx)
+static int parse_dirfile(char *buf, size_t nbytes, struct file *file,
+			 struct dir_context *ctx, bool cache, bool *full)
 {
 	while (nbytes >= FUSE_NAME_OFFSET) {
 		struct fuse_dirent *dirent = (struct fuse_dirent *) buf;
@@ -2355,13 +2406,16 @@ static int parse_dirfile(char *buf, size_t nbytes, struct dir_context *ctx)
 		if (memchr(dirent->name, '/', dirent->namelen) != NULL)
 			return -EIO;
 
-		ctx->pos = dirent->off;
-		if (!dir_emit(ctx, dirent->name, dirent->namelen, dirent->ino,
-				dirent->type))
+		if (cache ? !fuse_emit(file, ctx, dirent) :
+			    !dir_emit(ctx, dirent->name, dirent->namelen,
+				      dirent->ino, dirent->type)) {
+			*full = true;
 			break;
+		}
 
 		buf += reclen;
 		nbytes -= reclen;
+		ctx->pos = dirent->off;
 	}
 
 	return 0;
@@ -2393,6 +2447,8 @@ int fuse_readdir_backing(struct fuse_bpf_args *fa,
 	err = iterate_dir(backing_dir, &ec.ctx);
 	if (ec.offset == 0)
 		*allow_force = false;
+	else
+		((struct fuse_dirent *) (ec.addr + ec.prev))->off = ec.ctx.pos;
 	fa->out_args[1].size = ec.offset;
 
 	fro->offset = ec.ctx.pos;
@@ -2407,16 +2463,34 @@ void *fuse_readdir_finalize(struct fuse_bpf_args *fa,
 	struct fuse_read_out *fro = fa->out_args[0].value;
 	struct fuse_file *ff = file->private_data;
 	struct file *backing_dir = ff->backing_file;
+	/* a bpf filter may tailor the listing to the caller, don't share it */
+	bool cache = !get_fuse_inode(file_inode(file))->bpf;
+	bool full = false;
 	int err = 0;
 
-	err = parse_dirfile(fa->out_args[1].value, fa->out_args[1].size, ctx);
+	err = parse_dirfile(fa->out_args[1].value, fa->out_args[1].size, file,
+			    ctx, cache, &full);
+	if (full) {
+		/*
+		 * The caller ran out of buffer space: resume from the cookie
+		 * of the first entry not emitted instead of skipping the rest
+		 * of the batch read from the backing directory.
+		 */
+		*force_again = false;
+		backing_dir->f_pos = ctx->pos;
+		goto out;
+	}
+
 	*force_again = !!fro->again;
 	if (*force_again && !*allow_force)
 		err = -EINVAL;
 
 	ctx->pos = fro->offset;
 	backing_dir->f_pos = fro->offset;
-
+	if (cache && !*force_again && !fa->out_args[1].size &&
+	    (ff->open_flags & FOPEN_CACHE_DIR))
+		fuse_readdir_cache_end(file, ctx->pos);
+out:
 	free_page((unsigned long) fa->out_args[1].value);
 	return ERR_PTR(err);
 }
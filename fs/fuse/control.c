@@ -184,6 +184,48 @@ static ssize_t fuse_conn_congestion_threshold_write(struct file *file,
 	return ret;
 }
 
+#ifdef CONFIG_FUSE_BPF
+static ssize_t fuse_conn_backing_ops_read(struct file *file, char __user *buf,
+					  size_t len, loff_t *ppos)
+{
+	struct fuse_conn *fc;
+	char *tmp;
+	size_t size = 0;
+	ssize_t ret;
+	int i;
+
+	fc = fuse_ctl_file_conn_get(file);
+	if (!fc)
+		return 0;
+
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!tmp) {
+		fuse_conn_put(fc);
+		return -ENOMEM;
+	}
+
+	/* opcode 0 accounts for opcodes beyond FUSE_BPF_STAT_OPS */
+	for (i = 0; i < FUSE_BPF_STAT_OPS; i++) {
+		s64 val = atomic64_read(&fc->bpf_backing_ops[i]);
+
+		if (val)
+			size += scnprintf(tmp + size, PAGE_SIZE - size,
+					  "%d %lld\n", i, val);
+	}
+	fuse_conn_put(fc);
+
+	ret = simple_read_from_buffer(buf, len, ppos, tmp, size);
+	kfree(tmp);
+	return ret;
+}
+
+static const struct file_operations fuse_ctl_backing_ops_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_backing_ops_read,
+	.llseek = no_llseek,
+};
+#endif
+
 static const struct file_operations fuse_ctl_abort_ops = {
 	.open = nonseekable_open,
 	.write = fuse_conn_abort_write,
@@ -281,6 +323,12 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 &fuse_conn_congestion_threshold_ops))
 		goto err;
 
+#ifdef CONFIG_FUSE_BPF
+	if (!fuse_ctl_add_dentry(parent, fc, "backing_ops", S_IFREG | 0400, 1,
+				 NULL, &fuse_ctl_backing_ops_ops))
+		goto err;
+#endif
+
 	return 0;
 
  err:
@@ -22,6 +22,7 @@
 #include <linux/swap.h>
 #include <linux/splice.h>
 #include <linux/sched.h>
+#include <linux/io_uring.h>
 
 #include <trace/hooks/fuse.h>
 
@@ -207,6 +208,14 @@ static unsigned int fuse_req_hash(u64 unique)
 	return hash_long(unique & ~FUSE_INT_REQ_BIT, FUSE_PQ_HASH_BITS);
 }
 
+#ifdef CONFIG_FUSE_IO_URING
+static void fuse_uring_kick(struct fuse_conn *fc);
+static void fuse_uring_cancel(struct fuse_conn *fc, struct file *file);
+#else
+static inline void fuse_uring_kick(struct fuse_conn *fc) {}
+static inline void fuse_uring_cancel(struct fuse_conn *fc, struct file *file) {}
+#endif
+
 /*
  * A new request is available, wake fiq->waitq
  */
@@ -217,6 +226,7 @@ __releases(fiq->lock)
 		wake_up_sync(&fiq->waitq);
 	else
 		wake_up(&fiq->waitq);
+	fuse_uring_kick(container_of(fiq, struct fuse_conn, iq));
 	kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 	spin_unlock(&fiq->lock);
 }
@@ -1215,7 +1225,7 @@ __releases(fiq->lock)
  * fuse_request_end().  Otherwise add it to the processing list, and set
  * the 'sent' flag.
  */
-static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
+static ssize_t fuse_dev_do_read(struct fuse_dev *fud, bool nonblock,
 				struct fuse_copy_state *cs, size_t nbytes)
 {
 	ssize_t err;
@@ -1252,7 +1262,7 @@ static ssize_t fuse_dev_do_read(struct fuse_dev *fud, struct file *file,
 			break;
 		spin_unlock(&fiq->lock);
 
-		if (file->f_flags & O_NONBLOCK)
+		if (nonblock)
 			return -EAGAIN;
 		err = wait_event_interruptible_exclusive(fiq->waitq,
 				!fiq->connected || request_pending(fiq));
@@ -1378,7 +1388,8 @@ static ssize_t fuse_dev_read(struct kiocb *iocb, struct iov_iter *to)
 
 	fuse_copy_init(&cs, 1, to);
 
-	return fuse_dev_do_read(fud, file, &cs, iov_iter_count(to));
+	return fuse_dev_do_read(fud, file->f_flags & O_NONBLOCK, &cs,
+				iov_iter_count(to));
 }
 
 static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
@@ -1402,7 +1413,7 @@ static ssize_t fuse_dev_splice_read(struct file *in, loff_t *ppos,
 	fuse_copy_init(&cs, 1, NULL);
 	cs.pipebufs = bufs;
 	cs.pipe = pipe;
-	ret = fuse_dev_do_read(fud, in, &cs, len);
+	ret = fuse_dev_do_read(fud, in->f_flags & O_NONBLOCK, &cs, len);
 	if (ret < 0)
 		goto out;
 
@@ -2209,6 +2220,7 @@ void fuse_abort_conn(struct fuse_conn *fc)
 		while (forget_pending(fiq))
 			kfree(fuse_dequeue_forget(fiq, 1, NULL));
 		wake_up_all(&fiq->waitq);
+		fuse_uring_cancel(fc, NULL);
 		spin_unlock(&fiq->lock);
 		kill_fasync(&fiq->fasync, SIGIO, POLL_IN);
 		end_polls(fc);
@@ -2334,6 +2346,257 @@ static long fuse_dev_ioctl(struct file *file, unsigned int cmd,
 	return res;
 }
 
+#ifdef CONFIG_FUSE_IO_URING
+/*
+ * io_uring transport: the server parks FETCH commands, each carrying a
+ * buffer, on per-cpu queues.  A new request hands one parked command to
+ * task work, which copies the request into its buffer in the server's
+ * context and completes the command.  COMMIT_AND_FETCH writes the reply
+ * found in the buffer and parks the command again, so a server thread
+ * needs no read()/write() syscall per request.
+ *
+ * Request state is kept by the regular fuse_dev_do_read() and
+ * fuse_dev_do_write() paths, so interrupts, forgets and aborts work the
+ * same as with read() and write().
+ */
+struct fuse_uring_pdu {
+	struct list_head list;
+	void __user *buf;
+	u32 len;
+	u16 qid;
+};
+
+static struct fuse_uring_pdu *fuse_uring_pdu(struct io_uring_cmd *cmd)
+{
+	BUILD_BUG_ON(sizeof(struct fuse_uring_pdu) > sizeof(cmd->pdu));
+	return (struct fuse_uring_pdu *)cmd->pdu;
+}
+
+static struct io_uring_cmd *fuse_uring_cmd(struct fuse_uring_pdu *pdu)
+{
+	return container_of((void *)pdu, struct io_uring_cmd, pdu);
+}
+
+static struct fuse_uring *fuse_uring_get(struct fuse_conn *fc)
+{
+	struct fuse_uring *ring = READ_ONCE(fc->ring);
+	unsigned int i;
+
+	if (ring)
+		return ring;
+
+	ring = kzalloc(struct_size(ring, queues, nr_cpu_ids),
+		       GFP_KERNEL_ACCOUNT);
+	if (!ring)
+		return NULL;
+
+	ring->nr_queues = nr_cpu_ids;
+	for (i = 0; i < ring->nr_queues; i++)
+		INIT_LIST_HEAD(&ring->queues[i].cmds);
+
+	if (cmpxchg(&fc->ring, NULL, ring)) {
+		kfree(ring);
+		ring = READ_ONCE(fc->ring);
+	}
+	return ring;
+}
+
+static void fuse_uring_fetch_tw(struct io_uring_cmd *cmd,
+				unsigned int issue_flags);
+
+/*
+ * Hand a request to a parked command, preferring the queue of this cpu.
+ * Called with fiq->lock held.
+ */
+static void fuse_uring_kick(struct fuse_conn *fc)
+{
+	struct fuse_uring *ring = READ_ONCE(fc->ring);
+	struct fuse_uring_pdu *pdu = NULL;
+	unsigned int qid, i;
+
+	if (!ring)
+		return;
+
+	qid = raw_smp_processor_id();
+	for (i = 0; i < ring->nr_queues && !pdu; i++) {
+		struct fuse_uring_queue *queue =
+			&ring->queues[(qid + i) % ring->nr_queues];
+
+		pdu = list_first_entry_or_null(&queue->cmds,
+					       struct fuse_uring_pdu, list);
+	}
+	if (!pdu)
+		return;
+
+	list_del_init(&pdu->list);
+	io_uring_cmd_complete_in_task(fuse_uring_cmd(pdu), fuse_uring_fetch_tw);
+}
+
+/*
+ * Unpark the commands issued on @file, or all of them if @file is NULL.
+ * Their task work completes them if the connection is gone or their
+ * submitter is exiting, and parks them again otherwise.  Called with
+ * fiq->lock held.
+ */
+static void fuse_uring_cancel(struct fuse_conn *fc, struct file *file)
+{
+	struct fuse_uring *ring = READ_ONCE(fc->ring);
+	struct fuse_uring_pdu *pdu, *next;
+	unsigned int i;
+
+	if (!ring)
+		return;
+
+	for (i = 0; i < ring->nr_queues; i++) {
+		list_for_each_entry_safe(pdu, next, &ring->queues[i].cmds,
+					 list) {
+			struct io_uring_cmd *cmd = fuse_uring_cmd(pdu);
+
+			if (file && cmd->file != file)
+				continue;
+			list_del_init(&pdu->list);
+			io_uring_cmd_complete_in_task(cmd, fuse_uring_fetch_tw);
+		}
+	}
+}
+
+static void fuse_uring_park(struct io_uring_cmd *cmd, struct fuse_conn *fc)
+{
+	struct fuse_uring_pdu *pdu = fuse_uring_pdu(cmd);
+	struct fuse_iqueue *fiq = &fc->iq;
+
+	spin_lock(&fiq->lock);
+	if (!fiq->connected || request_pending(fiq)) {
+		spin_unlock(&fiq->lock);
+		io_uring_cmd_complete_in_task(cmd, fuse_uring_fetch_tw);
+		return;
+	}
+	list_add_tail(&pdu->list, &fc->ring->queues[pdu->qid].cmds);
+	spin_unlock(&fiq->lock);
+}
+
+static ssize_t fuse_uring_fetch(struct io_uring_cmd *cmd,
+				struct fuse_dev *fud)
+{
+	struct fuse_uring_pdu *pdu = fuse_uring_pdu(cmd);
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	int err;
+
+	err = import_ubuf(ITER_DEST, pdu->buf, pdu->len, &iter);
+	if (err)
+		return err;
+
+	fuse_copy_init(&cs, 1, &iter);
+	return fuse_dev_do_read(fud, true, &cs, pdu->len);
+}
+
+static void fuse_uring_fetch_tw(struct io_uring_cmd *cmd,
+				unsigned int issue_flags)
+{
+	struct fuse_dev *fud = fuse_get_dev(cmd->file);
+	ssize_t ret;
+
+	/* The submitter is going away, there is no mm to copy into */
+	if (current->flags & (PF_EXITING | PF_KTHREAD)) {
+		ret = -ECANCELED;
+		goto done;
+	}
+
+	ret = fuse_uring_fetch(cmd, fud);
+	if (ret == -EAGAIN) {
+		/* another reader got the request first */
+		fuse_uring_park(cmd, fud->fc);
+		return;
+	}
+done:
+	io_uring_cmd_done(cmd, ret, 0, issue_flags);
+}
+
+static ssize_t fuse_uring_commit(struct fuse_dev *fud, u64 buf, u32 len)
+{
+	struct fuse_copy_state cs;
+	struct iov_iter iter;
+	int err;
+
+	err = import_ubuf(ITER_SOURCE, u64_to_user_ptr(buf), len, &iter);
+	if (err)
+		return err;
+
+	fuse_copy_init(&cs, 0, &iter);
+	return fuse_dev_do_write(fud, &cs, len);
+}
+
+static int fuse_dev_uring_cmd(struct io_uring_cmd *cmd,
+			      unsigned int issue_flags)
+{
+	const struct fuse_uring_cmd_req *req = io_uring_sqe_cmd(cmd->sqe);
+	struct fuse_uring_pdu *pdu = fuse_uring_pdu(cmd);
+	struct fuse_dev *fud = fuse_get_dev(cmd->file);
+	struct fuse_uring *ring;
+	u64 buf;
+	ssize_t ret;
+
+	if (!fud)
+		return -EPERM;
+
+	if (!(issue_flags & IO_URING_F_SQE128))
+		return -EINVAL;
+
+	ring = fuse_uring_get(fud->fc);
+	if (!ring)
+		return -ENOMEM;
+
+	buf = READ_ONCE(req->buf);
+	pdu->buf = u64_to_user_ptr(buf);
+	pdu->len = READ_ONCE(req->buf_len);
+	pdu->qid = READ_ONCE(req->qid);
+	if (pdu->qid >= ring->nr_queues)
+		return -EINVAL;
+
+	switch (cmd->cmd_op) {
+	case FUSE_IO_URING_CMD_COMMIT_AND_FETCH:
+		ret = fuse_uring_commit(fud, buf, READ_ONCE(req->reply_len));
+		if (ret < 0)
+			return ret;
+		break;
+	case FUSE_IO_URING_CMD_FETCH:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	INIT_LIST_HEAD(&pdu->list);
+	ret = fuse_uring_fetch(cmd, fud);
+	if (ret != -EAGAIN)
+		return ret;
+
+	fuse_uring_park(cmd, fud->fc);
+	return -EIOCBQUEUED;
+}
+
+/*
+ * Parked commands hold a reference on the file, so release() is not called
+ * while the server still has commands queued.  Unpark them when a
+ * descriptor is closed: on server exit they get cancelled, otherwise they
+ * simply park again.
+ */
+static int fuse_dev_flush(struct file *file, fl_owner_t id)
+{
+	struct fuse_dev *fud = fuse_get_dev(file);
+	struct fuse_iqueue *fiq;
+
+	if (!fud || !READ_ONCE(fud->fc->ring))
+		return 0;
+
+	fiq = &fud->fc->iq;
+	spin_lock(&fiq->lock);
+	fuse_uring_cancel(fud->fc, file);
+	spin_unlock(&fiq->lock);
+	return 0;
+}
+#endif
+
 const struct file_operations fuse_dev_operations = {
 	.owner		= THIS_MODULE,
 	.open		= fuse_dev_open,
@@ -2347,6 +2610,10 @@ const struct file_operations fuse_dev_operations = {
 	.fasync		= fuse_dev_fasync,
 	.unlocked_ioctl = fuse_dev_ioctl,
 	.compat_ioctl   = compat_ptr_ioctl,
+#ifdef CONFIG_FUSE_IO_URING
+	.uring_cmd	= fuse_dev_uring_cmd,
+	.flush		= fuse_dev_flush,
+#endif
 };
 EXPORT_SYMBOL_GPL(fuse_dev_operations);
 
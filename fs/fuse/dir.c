@@ -1585,12 +1585,18 @@ static int fuse_update_get_attr(struct inode *inode, struct file *file,
 #ifdef CONFIG_FUSE_BPF
 	struct fuse_err_ret fer;
 
-	fer = fuse_bpf_backing(inode, struct fuse_getattr_io,
-			       fuse_getattr_initialize,	fuse_getattr_backing,
-			       fuse_getattr_finalize,
-			       path->dentry, stat, request_mask, flags);
-	if (fer.ret)
-		return PTR_ERR(fer.result);
+	if (fuse_backing_attr_cached(inode, request_mask, flags)) {
+		/* attributes from the backing inode are still valid */
+		flags |= AT_STATX_DONT_SYNC;
+	} else {
+		fer = fuse_bpf_backing(inode, struct fuse_getattr_io,
+				       fuse_getattr_initialize,
+				       fuse_getattr_backing,
+				       fuse_getattr_finalize,
+				       path->dentry, stat, request_mask, flags);
+		if (fer.ret)
+			return PTR_ERR(fer.result);
+	}
 #endif
 
 	/* FUSE only supports basic stats and possibly btime */
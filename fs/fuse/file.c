@@ -233,6 +233,20 @@ void fuse_finish_open(struct inode *inode, struct file *file)
 		fuse_link_write_file(file);
 }
 
+/*
+ * With dir_cache, directory listings stay in the readdir cache across opens;
+ * staleness is caught by the mtime/i_version check in fuse_readdir_cached()
+ * and the daemon can drop it any time with FUSE_NOTIFY_INVAL_INODE.
+ */
+static void fuse_dir_cache_open(struct fuse_conn *fc, struct file *file,
+				bool isdir)
+{
+	struct fuse_file *ff = file->private_data;
+
+	if (isdir && fc->dir_cache && ff)
+		ff->open_flags |= FOPEN_CACHE_DIR | FOPEN_KEEP_CACHE;
+}
+
 int fuse_open_common(struct inode *inode, struct file *file, bool isdir)
 {
 	struct fuse_mount *fm = get_fuse_mount(inode);
@@ -260,8 +274,12 @@ int fuse_open_common(struct inode *inode, struct file *file, bool isdir)
 				       fuse_open_backing,
 				       fuse_open_finalize,
 				       inode, file, isdir);
-		if (fer.ret)
-			return PTR_ERR(fer.result);
+		if (fer.ret) {
+			err = PTR_ERR(fer.result);
+			if (!err)
+				fuse_dir_cache_open(fc, file, isdir);
+			return err;
+		}
 	}
 #endif
 
@@ -279,8 +297,10 @@ int fuse_open_common(struct inode *inode, struct file *file, bool isdir)
 		fuse_set_nowrite(inode);
 
 	err = fuse_do_open(fm, get_node_id(inode), file, isdir);
-	if (!err)
+	if (!err) {
+		fuse_dir_cache_open(fc, file, isdir);
 		fuse_finish_open(inode, file);
+	}
 
 	if (is_wb_truncate || dax_truncate)
 		fuse_release_nowrite(inode);
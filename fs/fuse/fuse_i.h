@@ -51,7 +51,23 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
+
+/** Opcodes counted individually in fuse_conn::bpf_backing_ops, others use 0 */
+#define FUSE_BPF_STAT_OPS 64
+
+#ifdef CONFIG_FUSE_IO_URING
+/** Per-cpu queue of io_uring commands waiting for a request */
+struct fuse_uring_queue {
+	/** Parked commands, protected by fuse_iqueue::lock */
+	struct list_head cmds;
+};
+
+struct fuse_uring {
+	unsigned int nr_queues;
+	struct fuse_uring_queue queues[];
+};
+#endif
 
 /** List of active connections */
 extern struct list_head fuse_conn_list;
@@ -617,6 +633,7 @@ struct fuse_fs_context {
 	bool legacy_opts_show:1;
 	enum fuse_dax_mode dax_mode;
 	bool no_daemon:1;
+	bool dir_cache:1;
 	unsigned int max_read;
 	unsigned int blksize;
 	const char *subtype;
@@ -910,6 +927,9 @@ struct fuse_conn {
 	/** BPF Only, no Daemon running */
 	unsigned int no_daemon:1;
 
+	/** Keep readdir caches of directories across opens */
+	unsigned int dir_cache:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
@@ -965,6 +985,16 @@ struct fuse_conn {
 
 	/** Protects passthrough_req */
 	spinlock_t passthrough_req_lock;
+
+#ifdef CONFIG_FUSE_IO_URING
+	/** io_uring transport, allocated on the first command */
+	struct fuse_uring *ring;
+#endif
+
+#ifdef CONFIG_FUSE_BPF
+	/** Requests served by the backing file without going to userspace */
+	atomic64_t bpf_backing_ops[FUSE_BPF_STAT_OPS];
+#endif
 };
 
 /*
@@ -1414,6 +1444,9 @@ int fuse_set_acl(struct mnt_idmap *, struct dentry *dentry,
 
 /* readdir.c */
 int fuse_readdir(struct file *file, struct dir_context *ctx);
+bool fuse_emit(struct file *file, struct dir_context *ctx,
+	       struct fuse_dirent *dirent);
+void fuse_readdir_cache_end(struct file *file, loff_t pos);
 
 /**
  * Return the number of bytes in an arguments list
@@ -1711,9 +1744,6 @@ void *fuse_file_write_iter_finalize(struct fuse_bpf_args *fa,
 ssize_t fuse_splice_read_backing(struct file *in, loff_t *ppos,
 		struct pipe_inode_info *pipe, size_t len, unsigned long flags);
 
-ssize_t fuse_splice_read_backing(struct file *in, loff_t *ppos,
-		struct pipe_inode_info *pipe, size_t len, unsigned long flags);
-
 long fuse_backing_ioctl(struct file *file, unsigned int command, unsigned long arg, int flags);
 
 int fuse_file_flock_backing(struct file *file, int cmd, struct file_lock *fl);
@@ -1967,6 +1997,15 @@ void __exit fuse_bpf_cleanup(void);
 
 ssize_t fuse_bpf_simple_request(struct fuse_mount *fm, struct fuse_bpf_args *args);
 
+bool fuse_backing_attr_cached(struct inode *inode, u32 request_mask,
+			      unsigned int flags);
+
+static inline void fuse_bpf_count_backing(struct fuse_conn *fc, u32 opcode)
+{
+	atomic64_inc(&fc->bpf_backing_ops[opcode < FUSE_BPF_STAT_OPS ?
+					  opcode : 0]);
+}
+
 static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
 {
 	int ret;
@@ -1988,6 +2027,9 @@ static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
  *	the backing io operation
  * void *finalize(struct fuse_bpf_args *, args...): function that performs any final
  *	work needed to commit the backing io
+ *
+ * Requests completed by the backing io without any userspace filter are
+ * accounted in fuse_conn::bpf_backing_ops.
  */
 #define fuse_bpf_backing(inode, io, initialize, backing, finalize,	\
 			 args...)					\
@@ -2003,6 +2045,7 @@ static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
 	void *err;							\
 	int i;								\
 	bool initialized = false;					\
+	bool backed = false, to_user = false;				\
 									\
 	do {								\
 		if (!fuse_inode || !fuse_inode->backing_inode)		\
@@ -2039,6 +2082,7 @@ static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
 		}							\
 									\
 		if (ext_flags & FUSE_BPF_USER_FILTER) {			\
+			to_user = true;					\
 			locked = fuse_lock_inode(inode);		\
 			res = fuse_bpf_simple_request(fm, &fa);		\
 			fuse_unlock_inode(inode, locked);		\
@@ -2071,6 +2115,7 @@ static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
 			ERR_PTR(backing(&fa, args)),			\
 			true,						\
 		};							\
+		backed = true;						\
 		if (IS_ERR(fer.result))					\
 			fa.error_in = PTR_ERR(fer.result);		\
 		if (!(ext_flags & FUSE_BPF_POST_FILTER))		\
@@ -2097,6 +2142,7 @@ static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
 		fa.out_args[0].size = fa_backup.out_args[0].size;	\
 		fa.out_args[1].size = fa_backup.out_args[1].size;	\
 		fa.out_numargs = fa_backup.out_numargs;			\
+		to_user = true;						\
 		locked = fuse_lock_inode(inode);			\
 		res = fuse_bpf_simple_request(fm, &fa);			\
 		fuse_unlock_inode(inode, locked);			\
@@ -2111,6 +2157,8 @@ static inline int fuse_bpf_run(struct bpf_prog *prog, struct fuse_bpf_args *fba)
 		if (err)						\
 			fer.result = err;				\
 	}								\
+	if (backed && !to_user)						\
+		fuse_bpf_count_backing(fm->fc, fa_backup.opcode);	\
 									\
 	fer;								\
 })
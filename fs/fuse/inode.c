@@ -854,6 +854,7 @@ enum {
 	OPT_ROOT_BPF,
 	OPT_ROOT_DIR,
 	OPT_NO_DAEMON,
+	OPT_DIR_CACHE,
 	OPT_ERR
 };
 
@@ -871,6 +872,7 @@ static const struct fs_parameter_spec fuse_fs_parameters[] = {
 	fsparam_u32	("root_bpf",		OPT_ROOT_BPF),
 	fsparam_u32	("root_dir",		OPT_ROOT_DIR),
 	fsparam_flag	("no_daemon",		OPT_NO_DAEMON),
+	fsparam_flag	("dir_cache",		OPT_DIR_CACHE),
 	{}
 };
 
@@ -974,6 +976,10 @@ static int fuse_parse_param(struct fs_context *fsc, struct fs_parameter *param)
 		ctx->fd_present = true;
 		break;
 
+	case OPT_DIR_CACHE:
+		ctx->dir_cache = true;
+		break;
+
 	default:
 		return -EINVAL;
 	}
@@ -1014,6 +1020,8 @@ static int fuse_show_options(struct seq_file *m, struct dentry *root)
 		if (sb->s_bdev && sb->s_blocksize != FUSE_DEFAULT_BLKSIZE)
 			seq_printf(m, ",blksize=%lu", sb->s_blocksize);
 	}
+	if (fc->dir_cache)
+		seq_puts(m, ",dir_cache");
 #ifdef CONFIG_FUSE_DAX
 	if (fc->dax_mode == FUSE_DAX_ALWAYS)
 		seq_puts(m, ",dax=always");
@@ -1102,6 +1110,9 @@ void fuse_conn_put(struct fuse_conn *fc)
 			fiq->ops->release(fiq);
 		put_pid_ns(fc->pid_ns);
 		put_user_ns(fc->user_ns);
+#ifdef CONFIG_FUSE_IO_URING
+		kfree(fc->ring);
+#endif
 		bucket = rcu_dereference_protected(fc->curr_bucket, 1);
 		if (bucket) {
 			WARN_ON(atomic_read(&bucket->count) != 1);
@@ -1853,6 +1864,7 @@ int fuse_fill_super_common(struct super_block *sb, struct fuse_fs_context *ctx)
 	fc->no_control = ctx->no_control;
 	fc->no_force_umount = ctx->no_force_umount;
 	fc->no_daemon = ctx->no_daemon;
+	fc->dir_cache = ctx->dir_cache;
 
 	err = -ENOMEM;
 	root = fuse_get_root_inode(sb, ctx->rootmode, ctx->root_bpf,
@@ -93,7 +93,7 @@ static void fuse_add_dirent_to_cache(struct file *file,
 	put_page(page);
 }
 
-static void fuse_readdir_cache_end(struct file *file, loff_t pos)
+void fuse_readdir_cache_end(struct file *file, loff_t pos)
 {
 	struct fuse_inode *fi = get_fuse_inode(file_inode(file));
 	loff_t end;
@@ -113,8 +113,8 @@ static void fuse_readdir_cache_end(struct file *file, loff_t pos)
 	truncate_inode_pages(file->f_mapping, end);
 }
 
-static bool fuse_emit(struct file *file, struct dir_context *ctx,
-		      struct fuse_dirent *dirent)
+bool fuse_emit(struct file *file, struct dir_context *ctx,
+	       struct fuse_dirent *dirent)
 {
 	struct fuse_file *ff = file->private_data;
 
@@ -443,12 +443,29 @@ static void fuse_rdc_reset(struct inode *inode)
 
 #define UNCACHED 1
 
+/*
+ * The inode whose mtime and i_version tell whether the readdir cache is
+ * stale: directories with a backing inode are checked against it directly,
+ * which also catches changes made on the backing filesystem itself.
+ */
+static struct inode *fuse_rdc_inode(struct inode *inode)
+{
+#ifdef CONFIG_FUSE_BPF
+	struct fuse_inode *fi = get_fuse_inode(inode);
+
+	if (fi->backing_inode)
+		return fi->backing_inode;
+#endif
+	return inode;
+}
+
 static int fuse_readdir_cached(struct file *file, struct dir_context *ctx)
 {
 	struct fuse_file *ff = file->private_data;
 	struct inode *inode = file_inode(file);
 	struct fuse_conn *fc = get_fuse_conn(inode);
 	struct fuse_inode *fi = get_fuse_inode(inode);
+	struct inode *vinode = fuse_rdc_inode(inode);
 	enum fuse_parse_result res;
 	pgoff_t index;
 	unsigned int size;
@@ -465,7 +482,8 @@ static int fuse_readdir_cached(struct file *file, struct dir_context *ctx)
 	 * We're just about to start reading into the cache or reading the
 	 * cache; both cases require an up-to-date mtime value.
 	 */
-	if (!ctx->pos && fc->auto_inval_data) {
+	if (!ctx->pos && vinode == inode &&
+	    (fc->auto_inval_data || fc->dir_cache)) {
 		int err = fuse_update_attributes(inode, file, STATX_MTIME);
 
 		if (err)
@@ -478,8 +496,8 @@ static int fuse_readdir_cached(struct file *file, struct dir_context *ctx)
 	if (!fi->rdc.cached) {
 		/* Starting cache? Set cache mtime. */
 		if (!ctx->pos && !fi->rdc.size) {
-			fi->rdc.mtime = inode->i_mtime;
-			fi->rdc.iversion = inode_query_iversion(inode);
+			fi->rdc.mtime = vinode->i_mtime;
+			fi->rdc.iversion = inode_query_iversion(vinode);
 		}
 		spin_unlock(&fi->rdc.lock);
 		return UNCACHED;
@@ -490,8 +508,8 @@ static int fuse_readdir_cached(struct file *file, struct dir_context *ctx)
 	 * changed, and reset the cache if so.
 	 */
 	if (!ctx->pos) {
-		if (inode_peek_iversion(inode) != fi->rdc.iversion ||
-		    !timespec64_equal(&fi->rdc.mtime, &inode->i_mtime)) {
+		if (inode_peek_iversion(vinode) != fi->rdc.iversion ||
+		    !timespec64_equal(&fi->rdc.mtime, &vinode->i_mtime)) {
 			fuse_rdc_reset(inode);
 			goto retry_locked;
 		}
@@ -595,6 +613,16 @@ int fuse_readdir(struct file *file, struct dir_context *ctx)
 	bool force_again = false;
 	bool is_continued = false;
 
+	if (get_fuse_inode(inode)->backing_inode &&
+	    !get_fuse_inode(inode)->bpf &&
+	    (ff->open_flags & FOPEN_CACHE_DIR)) {
+		mutex_lock(&ff->readdir.lock);
+		err = fuse_readdir_cached(file, ctx);
+		mutex_unlock(&ff->readdir.lock);
+		if (err != UNCACHED)
+			return err;
+	}
+
 again:
 	fer = fuse_bpf_backing(inode, struct fuse_read_io,
 			       fuse_readdir_initialize, fuse_readdir_backing,
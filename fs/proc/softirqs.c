@@ -26,12 +26,41 @@ static int show_softirqs(struct seq_file *p, void *v)
 	return 0;
 }
 
+#ifdef CONFIG_SOFTIRQ_TYPE_THREADS
+/*
+ * /proc/softirqs_time  ... display the time spent in softirqs, in usecs
+ */
+static int show_softirqs_time(struct seq_file *p, void *v)
+{
+	int i, j;
+
+	seq_puts(p, "                    ");
+	for_each_possible_cpu(i)
+		seq_printf(p, "CPU%-8d", i);
+	seq_putc(p, '\n');
+
+	for (i = 0; i < NR_SOFTIRQS; i++) {
+		seq_printf(p, "%12s:", softirq_to_name[i]);
+		for_each_possible_cpu(j)
+			seq_printf(p, " %10llu",
+				   div_u64(kstat_softirq_time_cpu(i, j),
+					   NSEC_PER_USEC));
+		seq_putc(p, '\n');
+	}
+	return 0;
+}
+#endif
+
 static int __init proc_softirqs_init(void)
 {
 	struct proc_dir_entry *pde;
 
 	pde = proc_create_single("softirqs", 0, NULL, show_softirqs);
 	pde_make_permanent(pde);
+#ifdef CONFIG_SOFTIRQ_TYPE_THREADS
+	pde = proc_create_single("softirqs_time", 0, NULL, show_softirqs_time);
+	pde_make_permanent(pde);
+#endif
 	return 0;
 }
 fs_initcall(proc_softirqs_init);
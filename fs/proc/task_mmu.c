@@ -904,6 +904,22 @@ static int show_smap(struct seq_file *m, void *v)
 	return 0;
 }
 
+/* Remember the sharing ratios of a full walk for smaps_rollup_fast */
+static void smaps_rollup_save_estimate(struct mm_struct *mm,
+				       const struct mem_size_stats *mss)
+{
+	struct mm_pss_estimate *est = &mm->pss_estimate;
+
+	WRITE_ONCE(est->rss_anon, mss->anonymous);
+	WRITE_ONCE(est->pss_anon, mss->pss_anon >> PSS_SHIFT);
+	WRITE_ONCE(est->rss_other, mss->resident - mss->anonymous);
+	WRITE_ONCE(est->pss_other,
+		   (mss->pss_file + mss->pss_shmem) >> PSS_SHIFT);
+	WRITE_ONCE(est->swap, mss->swap);
+	WRITE_ONCE(est->swap_pss, mss->swap_pss >> PSS_SHIFT);
+	WRITE_ONCE(est->stamp, jiffies);
+}
+
 static int show_smaps_rollup(struct seq_file *m, void *v)
 {
 	struct proc_maps_private *priv = m->private;
@@ -1010,6 +1026,7 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 	seq_puts(m, "[rollup]\n");
 
 	__show_smap(m, &mss, true);
+	smaps_rollup_save_estimate(mm, &mss);
 
 	release_task_mempolicy(priv);
 	mmap_read_unlock(mm);
@@ -1022,6 +1039,72 @@ static int show_smaps_rollup(struct seq_file *m, void *v)
 
 	return ret;
 }
+
+/*
+ * Scale a current rss counter by the pss/rss ratio the last full walk saw.
+ * Without a walk to go by, assume nothing is shared.
+ */
+static unsigned long pss_estimate(unsigned long rss, unsigned long pss,
+				  unsigned long walked_rss)
+{
+	if (!walked_rss || pss >= walked_rss)
+		return rss;
+	return mult_frac(rss, pss, walked_rss);
+}
+
+/*
+ * smaps_rollup_fast: the smaps_rollup totals that the mm keeps as counters,
+ * without taking mmap_lock or walking any page table.  Pss is estimated from
+ * the sharing ratios of the last smaps_rollup read; PssAge says how old
+ * those are, and is -1 if smaps_rollup has never been read for this mm.
+ */
+static int show_smaps_rollup_fast(struct seq_file *m, void *v)
+{
+	struct proc_maps_private *priv = m->private;
+	struct mm_struct *mm = priv->mm;
+	struct mm_pss_estimate *est;
+	unsigned long anon, file, shmem, swap;
+	unsigned long pss_anon, pss_file, pss_shmem, swap_pss;
+	unsigned long rss_other, pss_other, stamp;
+
+	if (!mm || !mmget_not_zero(mm))
+		return -ESRCH;
+
+	anon = get_mm_counter(mm, MM_ANONPAGES) << PAGE_SHIFT;
+	file = get_mm_counter(mm, MM_FILEPAGES) << PAGE_SHIFT;
+	shmem = get_mm_counter(mm, MM_SHMEMPAGES) << PAGE_SHIFT;
+	swap = get_mm_counter(mm, MM_SWAPENTS) << PAGE_SHIFT;
+
+	est = &mm->pss_estimate;
+	rss_other = READ_ONCE(est->rss_other);
+	pss_other = READ_ONCE(est->pss_other);
+	pss_anon = pss_estimate(anon, READ_ONCE(est->pss_anon),
+				READ_ONCE(est->rss_anon));
+	pss_file = pss_estimate(file, pss_other, rss_other);
+	pss_shmem = pss_estimate(shmem, pss_other, rss_other);
+	swap_pss = pss_estimate(swap, READ_ONCE(est->swap_pss),
+				READ_ONCE(est->swap));
+	stamp = READ_ONCE(est->stamp);
+	mmput(mm);
+
+	SEQ_PUT_DEC("Rss:            ", anon + file + shmem);
+	SEQ_PUT_DEC(" kB\nPss:            ", pss_anon + pss_file + pss_shmem);
+	SEQ_PUT_DEC(" kB\nPss_Anon:       ", pss_anon);
+	SEQ_PUT_DEC(" kB\nPss_File:       ", pss_file);
+	SEQ_PUT_DEC(" kB\nPss_Shmem:      ", pss_shmem);
+	SEQ_PUT_DEC(" kB\nAnonymous:      ", anon);
+	SEQ_PUT_DEC(" kB\nSwap:           ", swap);
+	SEQ_PUT_DEC(" kB\nSwapPss:        ", swap_pss);
+	seq_puts(m, " kB\nPssAge:         ");
+	if (stamp)
+		seq_put_decimal_ull_width(m, "",
+				jiffies_to_msecs(jiffies - stamp), 8);
+	else
+		seq_printf(m, "%8d", -1);
+	seq_puts(m, " ms\n");
+
+	return 0;
+}
 #undef SEQ_PUT_DEC
 
 static const struct seq_operations proc_pid_smaps_op = {
@@ -1036,7 +1119,8 @@ static int pid_smaps_open(struct inode *inode, struct file *file)
 	return do_maps_open(inode, file, &proc_pid_smaps_op);
 }
 
-static int smaps_rollup_open(struct inode *inode, struct file *file)
+static int __smaps_rollup_open(struct inode *inode, struct file *file,
+			       int (*show)(struct seq_file *, void *))
 {
 	int ret;
 	struct proc_maps_private *priv;
@@ -1045,7 +1129,7 @@ static int smaps_rollup_open(struct inode *inode, struct file *file)
 	if (!priv)
 		return -ENOMEM;
 
-	ret = single_open(file, show_smaps_rollup, priv);
+	ret = single_open(file, show, priv);
 	if (ret)
 		goto out_free;
 
@@ -1065,6 +1149,16 @@ static int smaps_rollup_open(struct inode *inode, struct file *file)
 	return ret;
 }
 
+static int smaps_rollup_open(struct inode *inode, struct file *file)
+{
+	return __smaps_rollup_open(inode, file, show_smaps_rollup);
+}
+
+static int smaps_rollup_fast_open(struct inode *inode, struct file *file)
+{
+	return __smaps_rollup_open(inode, file, show_smaps_rollup_fast);
+}
+
 static int smaps_rollup_release(struct inode *inode, struct file *file)
 {
 	struct seq_file *seq = file->private_data;
@@ -1091,6 +1185,13 @@ const struct file_operations proc_pid_smaps_rollup_operations = {
 	.release	= smaps_rollup_release,
 };
 
+const struct file_operations proc_pid_smaps_rollup_fast_operations = {
+	.open		= smaps_rollup_fast_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= smaps_rollup_release,
+};
+
 enum clear_refs_types {
 	CLEAR_REFS_ALL = 1,
 	CLEAR_REFS_ANON,
@@ -372,6 +372,7 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags,
 	spin_lock_init(&s->s_inode_list_lock);
 	INIT_LIST_HEAD(&s->s_inodes_wb);
 	spin_lock_init(&s->s_inode_wblist_lock);
+	INIT_WORK(&s->s_negative_dentry_work, prune_dcache_negative_work);
 
 	s->s_count = 1;
 	atomic_set(&s->s_active, 1);
@@ -714,6 +715,8 @@ void generic_shutdown_super(struct super_block *sb)
 			spin_unlock(&sb->s_inode_list_lock);
 		}
 	}
+	/* The negative dentries it would prune have been shrunk already. */
+	cancel_work_sync(&sb->s_negative_dentry_work);
 	/*
 	 * Broadcast to everyone that grabbed a temporary reference to this
 	 * superblock before we removed it from @fs_supers that the superblock
@@ -515,6 +515,8 @@ vm_fault_t handle_userfault(struct vm_fault *vmf, unsigned long reason)
 		must_wait = userfaultfd_huge_must_wait(ctx, vmf, reason);
 	if (is_vm_hugetlb_page(vma))
 		hugetlb_vma_unlock_read(vma);
+	if (vmf->flags & FAULT_FLAG_VMA_LOCK)
+		count_vm_vma_lock_event(VMA_LOCK_RETRY_UFFD);
 	release_fault_lock(vmf);
 
 	if (likely(must_wait && !READ_ONCE(ctx->released))) {
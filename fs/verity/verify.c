@@ -78,8 +78,81 @@ static bool is_hash_block_verified(struct fsverity_info *vi, struct page *hpage,
 	return verified;
 }
 
+/* A data block that has been hashed but whose Merkle tree path is unchecked */
+struct fsverity_pending_block {
+	const void *data;
+	u64 pos;
+	u8 real_hash[FS_VERITY_MAX_DIGEST_SIZE];
+};
+
+/*
+ * State for verifying a batch of data blocks, e.g. all blocks of a readahead
+ * bio: blocks are gathered so they can be hashed together, and the last
+ * verified level-0 hash block is kept so that neighbouring data blocks,
+ * which usually share it, don't look it up in the page cache again.
+ */
+struct fsverity_verification_context {
+	struct inode *inode;
+	struct fsverity_info *vi;
+	unsigned long max_ra_pages;
+	unsigned int max_pending;
+	unsigned int num_pending;
+	struct fsverity_pending_block pending_blocks[FS_VERITY_MAX_PENDING_DATA_BLOCKS];
+	/* Referenced, already verified level-0 hash page, or NULL */
+	struct page *hpage;
+	unsigned long hblock_idx;
+};
+
+static void
+fsverity_init_verification_context(struct fsverity_verification_context *ctx,
+				   struct inode *inode,
+				   unsigned long max_ra_pages)
+{
+	struct fsverity_info *vi = inode->i_verity_info;
+
+	ctx->inode = inode;
+	ctx->vi = vi;
+	ctx->max_ra_pages = max_ra_pages;
+	ctx->max_pending = vi->tree_params.hash_alg->mb_max_msgs;
+	ctx->num_pending = 0;
+	ctx->hpage = NULL;
+}
+
+/* Pending blocks must be unmapped in reverse order of mapping */
+static void
+fsverity_clear_pending_blocks(struct fsverity_verification_context *ctx)
+{
+	int i;
+
+	for (i = ctx->num_pending - 1; i >= 0; i--)
+		kunmap_local(ctx->pending_blocks[i].data);
+	ctx->num_pending = 0;
+}
+
+static void
+fsverity_finish_verification(struct fsverity_verification_context *ctx)
+{
+	fsverity_clear_pending_blocks(ctx);
+	if (ctx->hpage)
+		put_page(ctx->hpage);
+	ctx->hpage = NULL;
+}
+
+static void fsverity_cache_hash_page(struct fsverity_verification_context *ctx,
+				     struct page *hpage,
+				     unsigned long hblock_idx)
+{
+	if (ctx->hpage == hpage && ctx->hblock_idx == hblock_idx)
+		return;
+	get_page(hpage);
+	if (ctx->hpage)
+		put_page(ctx->hpage);
+	ctx->hpage = hpage;
+	ctx->hblock_idx = hblock_idx;
+}
+
 /*
- * Verify a single data block against the file's Merkle tree.
+ * Verify a single hashed data block against the file's Merkle tree.
  *
  * In principle, we need to verify the entire path to the root node.  However,
  * for efficiency the filesystem may cache the hash blocks.  Therefore we need
@@ -89,15 +162,19 @@ static bool is_hash_block_verified(struct fsverity_info *vi, struct page *hpage,
  * Return: %true if the data block is valid, else %false.
  */
 static bool
-verify_data_block(struct inode *inode, struct fsverity_info *vi,
-		  const void *data, u64 data_pos, unsigned long max_ra_pages)
+verify_data_block(struct fsverity_verification_context *ctx,
+		  const struct fsverity_pending_block *dblock)
 {
+	struct inode *inode = ctx->inode;
+	struct fsverity_info *vi = ctx->vi;
 	const struct merkle_tree_params *params = &vi->tree_params;
 	const unsigned int hsize = params->digest_size;
+	const u64 data_pos = dblock->pos;
 	int level;
 	u8 _want_hash[FS_VERITY_MAX_DIGEST_SIZE];
 	const u8 *want_hash;
-	u8 real_hash[FS_VERITY_MAX_DIGEST_SIZE];
+	u8 _real_hash[FS_VERITY_MAX_DIGEST_SIZE];
+	const u8 *real_hash = _real_hash;
 	/* The hash blocks that are traversed, indexed by level */
 	struct {
 		/* Page containing the hash block */
@@ -115,25 +192,12 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 	 */
 	u64 hidx = data_pos >> params->log_blocksize;
 
-	/* Up to 1 + FS_VERITY_MAX_LEVELS pages may be mapped at once */
-	BUILD_BUG_ON(1 + FS_VERITY_MAX_LEVELS > KM_MAX_IDX);
-
-	if (unlikely(data_pos >= inode->i_size)) {
-		/*
-		 * This can happen in the data page spanning EOF when the Merkle
-		 * tree block size is less than the page size.  The Merkle tree
-		 * doesn't cover data blocks fully past EOF.  But the entire
-		 * page spanning EOF can be visible to userspace via a mmap, and
-		 * any part past EOF should be all zeroes.  Therefore, we need
-		 * to verify that any data blocks fully past EOF are all zeroes.
-		 */
-		if (memchr_inv(data, 0, params->block_size)) {
-			fsverity_err(inode,
-				     "FILE CORRUPTED!  Data past EOF is not zeroed");
-			return false;
-		}
-		return true;
-	}
+	/*
+	 * Up to FS_VERITY_MAX_PENDING_DATA_BLOCKS + FS_VERITY_MAX_LEVELS pages
+	 * may be mapped at once.
+	 */
+	BUILD_BUG_ON(FS_VERITY_MAX_PENDING_DATA_BLOCKS +
+		     FS_VERITY_MAX_LEVELS > KM_MAX_IDX);
 
 	/*
 	 * Starting at the leaf level, ascend the tree saving hash blocks along
@@ -169,8 +233,22 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 		hoffset = (hidx << params->log_digestsize) &
 			  (params->block_size - 1);
 
+		/*
+		 * The leaf hash block shared with the previous data block of
+		 * this batch was verified while we held a reference to its
+		 * page, so it can't have been re-instantiated since.
+		 */
+		if (level == 0 && ctx->hpage && ctx->hblock_idx == hblock_idx) {
+			haddr = kmap_local_page(ctx->hpage) +
+				hblock_offset_in_page;
+			memcpy(_want_hash, haddr + hoffset, hsize);
+			want_hash = _want_hash;
+			kunmap_local(haddr);
+			goto descend;
+		}
+
 		hpage = inode->i_sb->s_vop->read_merkle_tree_page(inode,
-				hpage_idx, level == 0 ? min(max_ra_pages,
+				hpage_idx, level == 0 ? min(ctx->max_ra_pages,
 					params->tree_pages - hpage_idx) : 0);
 		if (IS_ERR(hpage)) {
 			fsverity_err(inode,
@@ -183,6 +261,9 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 			memcpy(_want_hash, haddr + hoffset, hsize);
 			want_hash = _want_hash;
 			kunmap_local(haddr);
+			if (level == 0)
+				fsverity_cache_hash_page(ctx, hpage,
+							 hblock_idx);
 			put_page(hpage);
 			goto descend;
 		}
@@ -202,9 +283,9 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 		unsigned long hblock_idx = hblocks[level - 1].index;
 		unsigned int hoffset = hblocks[level - 1].hoffset;
 
-		if (fsverity_hash_block(params, inode, haddr, real_hash) != 0)
+		if (fsverity_hash_block(params, inode, haddr, _real_hash) != 0)
 			goto error;
-		if (memcmp(want_hash, real_hash, hsize) != 0)
+		if (memcmp(want_hash, _real_hash, hsize) != 0)
 			goto corrupted;
 		/*
 		 * Mark the hash block as verified.  This must be atomic and
@@ -218,12 +299,13 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 		memcpy(_want_hash, haddr + hoffset, hsize);
 		want_hash = _want_hash;
 		kunmap_local(haddr);
+		if (level == 1)
+			fsverity_cache_hash_page(ctx, hpage, hblock_idx);
 		put_page(hpage);
 	}
 
-	/* Finally, verify the data block. */
-	if (fsverity_hash_block(params, inode, data, real_hash) != 0)
-		goto error;
+	/* Finally, verify the data block, which was hashed by the caller. */
+	real_hash = dblock->real_hash;
 	if (memcmp(want_hash, real_hash, hsize) != 0)
 		goto corrupted;
 	return true;
@@ -242,13 +324,46 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 	return false;
 }
 
+/*
+ * Hash all pending data blocks together, then check each one's hash against
+ * the Merkle tree.
+ */
 static bool
-verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
-		   unsigned long max_ra_pages)
+fsverity_verify_pending_blocks(struct fsverity_verification_context *ctx)
 {
-	struct inode *inode = data_folio->mapping->host;
-	struct fsverity_info *vi = inode->i_verity_info;
-	const unsigned int block_size = vi->tree_params.block_size;
+	const struct merkle_tree_params *params = &ctx->vi->tree_params;
+	const u8 *data[FS_VERITY_MAX_PENDING_DATA_BLOCKS];
+	u8 *outs[FS_VERITY_MAX_PENDING_DATA_BLOCKS];
+	unsigned int i;
+	bool valid = false;
+
+	if (!ctx->num_pending)
+		return true;
+
+	for (i = 0; i < ctx->num_pending; i++) {
+		data[i] = ctx->pending_blocks[i].data;
+		outs[i] = ctx->pending_blocks[i].real_hash;
+	}
+	if (fsverity_hash_blocks(params, ctx->inode, data, outs,
+				 ctx->num_pending) != 0)
+		goto out;
+
+	for (i = 0; i < ctx->num_pending; i++) {
+		if (!verify_data_block(ctx, &ctx->pending_blocks[i]))
+			goto out;
+	}
+	valid = true;
+out:
+	fsverity_clear_pending_blocks(ctx);
+	return valid;
+}
+
+static bool
+fsverity_add_data_blocks(struct fsverity_verification_context *ctx,
+			 struct folio *data_folio, size_t len, size_t offset)
+{
+	struct inode *inode = ctx->inode;
+	const unsigned int block_size = ctx->vi->tree_params.block_size;
 	u64 pos = (u64)data_folio->index << PAGE_SHIFT;
 
 	if (WARN_ON_ONCE(len <= 0 || !IS_ALIGNED(len | offset, block_size)))
@@ -257,15 +372,37 @@ verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
 			 folio_test_uptodate(data_folio)))
 		return false;
 	do {
+		struct fsverity_pending_block *dblock;
 		void *data;
-		bool valid;
 
 		data = kmap_local_folio(data_folio, offset);
-		valid = verify_data_block(inode, vi, data, pos + offset,
-					  max_ra_pages);
-		kunmap_local(data);
-		if (!valid)
-			return false;
+		if (unlikely(pos + offset >= inode->i_size)) {
+			/*
+			 * This can happen in the data page spanning EOF when
+			 * the Merkle tree block size is less than the page
+			 * size.  The Merkle tree doesn't cover data blocks
+			 * fully past EOF.  But the entire page spanning EOF
+			 * can be visible to userspace via a mmap, and any part
+			 * past EOF should be all zeroes.  Therefore, we need
+			 * to verify that any data blocks fully past EOF are all
+			 * zeroes.
+			 */
+			bool zeroed = !memchr_inv(data, 0, block_size);
+
+			kunmap_local(data);
+			if (!zeroed) {
+				fsverity_err(inode,
+					     "FILE CORRUPTED!  Data past EOF is not zeroed");
+				return false;
+			}
+		} else {
+			dblock = &ctx->pending_blocks[ctx->num_pending++];
+			dblock->data = data;
+			dblock->pos = pos + offset;
+			if (ctx->num_pending == ctx->max_pending &&
+			    !fsverity_verify_pending_blocks(ctx))
+				return false;
+		}
 		offset += block_size;
 		len -= block_size;
 	} while (len);
@@ -286,7 +423,15 @@ verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
  */
 bool fsverity_verify_blocks(struct folio *folio, size_t len, size_t offset)
 {
-	return verify_data_blocks(folio, len, offset, 0);
+	struct fsverity_verification_context ctx;
+	bool valid;
+
+	fsverity_init_verification_context(&ctx, folio->mapping->host, 0);
+
+	valid = fsverity_add_data_blocks(&ctx, folio, len, offset) &&
+		fsverity_verify_pending_blocks(&ctx);
+	fsverity_finish_verification(&ctx);
+	return valid;
 }
 EXPORT_SYMBOL_GPL(fsverity_verify_blocks);
 
@@ -299,6 +444,10 @@ EXPORT_SYMBOL_GPL(fsverity_verify_blocks);
  * must be aligned to the file's Merkle tree block size.  If any data fails
  * verification, then bio->bi_status is set to an error status.
  *
+ * The blocks of the whole bio are verified as one batch: they are hashed
+ * several at a time and hash blocks shared between them are only looked up
+ * and checked once.
+ *
  * This is a helper function for use by the ->readahead() method of filesystems
  * that issue bios to read data directly into the page cache.  Filesystems that
  * populate the page cache without issuing bios (e.g. non block-based
@@ -307,6 +456,8 @@ EXPORT_SYMBOL_GPL(fsverity_verify_blocks);
  */
 void fsverity_verify_bio(struct bio *bio)
 {
+	struct inode *inode = bio_first_folio_all(bio)->mapping->host;
+	struct fsverity_verification_context ctx;
 	struct folio_iter fi;
 	unsigned long max_ra_pages = 0;
 
@@ -323,13 +474,21 @@ void fsverity_verify_bio(struct bio *bio)
 		max_ra_pages = bio->bi_iter.bi_size >> (PAGE_SHIFT + 2);
 	}
 
+	fsverity_init_verification_context(&ctx, inode, max_ra_pages);
+
 	bio_for_each_folio_all(fi, bio) {
-		if (!verify_data_blocks(fi.folio, fi.length, fi.offset,
-					max_ra_pages)) {
-			bio->bi_status = BLK_STS_IOERR;
-			break;
-		}
+		if (!fsverity_add_data_blocks(&ctx, fi.folio, fi.length,
+					      fi.offset))
+			goto ioerr;
 	}
+	if (!fsverity_verify_pending_blocks(&ctx))
+		goto ioerr;
+	fsverity_finish_verification(&ctx);
+	return;
+
+ioerr:
+	fsverity_finish_verification(&ctx);
+	bio->bi_status = BLK_STS_IOERR;
 }
 EXPORT_SYMBOL_GPL(fsverity_verify_bio);
 #endif /* CONFIG_BLOCK */
@@ -242,8 +242,17 @@ struct shash_alg {
 
 	unsigned int descsize;
 
-	ANDROID_BACKPORT_RESERVE(1);
-	ANDROID_BACKPORT_RESERVE(2);
+	/*
+	 * Optional: finish up to @mb_max_msgs equal-length messages that
+	 * share the state in @desc at once, e.g. by interleaving them.
+	 * May return -EOPNOTSUPP to make the caller hash them one by one.
+	 */
+	ANDROID_BACKPORT_USE(1, int (*finup_mb)(struct shash_desc *desc,
+						const u8 * const data[],
+						unsigned int len,
+						u8 * const outs[],
+						unsigned int num_msgs));
+	ANDROID_BACKPORT_USE(2, unsigned int mb_max_msgs);
 
 	union {
 		struct HASH_ALG_COMMON;
@@ -851,6 +860,18 @@ static inline unsigned int crypto_shash_statesize(struct crypto_shash *tfm)
 	return crypto_shash_alg(tfm)->statesize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the multibuffer message limit
+ * @tfm: cipher handle
+ *
+ * Return: the number of messages crypto_shash_finup_mb() can process in one
+ *	   call more efficiently than one at a time; 1 if it has no fast path
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline u32 crypto_shash_get_flags(struct crypto_shash *tfm)
 {
 	return crypto_tfm_get_flags(crypto_shash_tfm(tfm));
@@ -1054,6 +1075,26 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - finish several messages from the same state
+ * @desc: operational state handle shared by all messages
+ * @data: the data of each message
+ * @len: the length of each message, the same for all of them
+ * @outs: the output buffer of each message's digest
+ * @num_msgs: number of messages
+ *
+ * Equivalent to calling crypto_shash_finup() on a copy of @desc for each
+ * message, but lets the algorithm hash the messages together when it has a
+ * multibuffer implementation.  The state in @desc is consumed.
+ *
+ * Context: Any context.
+ * Return: 0 if the message digest creation was successful; < 0 if an error
+ *	   occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
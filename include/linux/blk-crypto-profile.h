@@ -148,6 +148,20 @@ struct blk_crypto_profile {
 
 	/* Per-keyslot data */
 	struct blk_crypto_keyslot *slots;
+
+	/*
+	 * Keys that had to be programmed because they weren't in a keyslot,
+	 * and how many of those displaced another key.  Protected by 'lock'
+	 * held for write.
+	 */
+	unsigned long keyslot_misses;
+	unsigned long keyslot_evictions;
+
+	/*
+	 * Number of keyslots pinned by blk_crypto_pin_key().  Protected by
+	 * 'lock' held for write.
+	 */
+	unsigned int num_pinned_slots;
 };
 
 int blk_crypto_profile_init(struct blk_crypto_profile *profile,
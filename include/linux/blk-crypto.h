@@ -6,6 +6,7 @@
 #ifndef __LINUX_BLK_CRYPTO_H
 #define __LINUX_BLK_CRYPTO_H
 
+#include <linux/atomic.h>
 #include <linux/types.h>
 
 enum blk_crypto_mode_num {
@@ -86,6 +87,21 @@ struct blk_crypto_config {
 	enum blk_crypto_key_type key_type;
 };
 
+/**
+ * struct blk_crypto_key_stats - keyslot usage statistics of a blk_crypto_key
+ * @hits: number of times the key was already in a keyslot when needed
+ * @misses: number of times the key had to be programmed into a keyslot
+ * @evictions: number of times the key was displaced from its keyslot by
+ *	       another key
+ *
+ * These are summed over all the devices the key is used on.
+ */
+struct blk_crypto_key_stats {
+	atomic_long_t hits;
+	atomic_long_t misses;
+	atomic_long_t evictions;
+};
+
 /**
  * struct blk_crypto_key - an inline encryption key
  * @crypto_cfg: the crypto mode, data unit size, key type, and other
@@ -94,16 +110,23 @@ struct blk_crypto_config {
  * @size: size of this key in bytes.  The size of a standard key is fixed for a
  *	  given crypto mode, but the size of a hardware-wrapped key can vary.
  * @raw: the bytes of this key.  Only the first @size bytes are significant.
+ * @stats: keyslot usage statistics of this key
+ * @stats_ptr: points to @stats, so the block layer can update the statistics
+ *	       through the const pointers it gets the key by.  Set up by
+ *	       blk_crypto_init_key().
  *
- * A blk_crypto_key is immutable once created, and many bios can reference it at
- * the same time.  It must not be freed until all bios using it have completed
- * and it has been evicted from all devices on which it may have been used.
+ * A blk_crypto_key is immutable once created, apart from @stats, and many bios
+ * can reference it at the same time.  It must not be freed until all bios using
+ * it have completed and it has been evicted from all devices on which it may
+ * have been used.
  */
 struct blk_crypto_key {
 	struct blk_crypto_config crypto_cfg;
 	unsigned int data_unit_size_bits;
 	unsigned int size;
 	u8 raw[BLK_CRYPTO_MAX_ANY_KEY_SIZE];
+	struct blk_crypto_key_stats stats;
+	struct blk_crypto_key_stats *stats_ptr;
 };
 
 #define BLK_CRYPTO_MAX_IV_SIZE		32
@@ -154,6 +177,12 @@ int blk_crypto_start_using_key(struct block_device *bdev,
 void blk_crypto_evict_key(struct block_device *bdev,
 			  const struct blk_crypto_key *key);
 
+int blk_crypto_prime_key(struct block_device *bdev,
+			 const struct blk_crypto_key *key);
+
+int blk_crypto_pin_key(struct block_device *bdev,
+		       const struct blk_crypto_key *key);
+
 bool blk_crypto_config_supported_natively(struct block_device *bdev,
 					  const struct blk_crypto_config *cfg);
 bool blk_crypto_config_supported(struct block_device *bdev,
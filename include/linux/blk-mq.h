@@ -437,6 +437,19 @@ struct blk_mq_hw_ctx {
 	 */
 	struct list_head	hctx_list;
 
+	/**
+	 * @poll_issue_ns: Start time of the latest polled request, for hybrid
+	 * polling.
+	 */
+	u64			poll_issue_ns;
+	/** @poll_issued: Number of polled requests started. */
+	unsigned long		poll_issued;
+	/**
+	 * @poll_slept: Value of @poll_issued when hybrid polling last slept,
+	 * so that it sleeps at most once per request.
+	 */
+	unsigned long		poll_slept;
+
 	ANDROID_KABI_RESERVE(1);
 };
 
@@ -469,6 +469,11 @@ struct request_queue {
 
 	unsigned int		rq_timeout;
 
+	/* hybrid polling, see the io_poll_delay queue attribute */
+	int			poll_nsec;
+	struct blk_stat_callback	*poll_cb;
+	struct blk_rq_stat	poll_stat;
+
 	struct timer_list	timeout;
 	struct work_struct	timeout_work;
 
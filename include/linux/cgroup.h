@@ -10,6 +10,7 @@
  */
 
 #include <linux/sched.h>
+#include <linux/sched/jobctl.h>
 #include <linux/cpumask.h>
 #include <linux/nodemask.h>
 #include <linux/rculist.h>
@@ -615,6 +616,9 @@ static inline void pr_cont_cgroup_path(struct cgroup *cgrp)
 }
 
 bool cgroup_psi_enabled(void);
+void cgroup_subtree_for_each_task(struct cgroup *cgrp,
+				  void (*fn)(struct task_struct *, void *),
+				  void *data);
 
 static inline void cgroup_init_kthreadd(void)
 {
@@ -826,7 +830,7 @@ void cgroup_freezer_migrate_task(struct task_struct *task, struct cgroup *src,
 
 static inline bool cgroup_task_frozen(struct task_struct *task)
 {
-	return task->frozen;
+	return task->frozen || (task->jobctl & JOBCTL_FREEZE_LAZY);
 }
 
 #else /* !CONFIG_CGROUPS */
@@ -311,10 +311,22 @@ enum devfreq_parent_dev_type {
  *			If the devfreq device has the specific method to decide
  *			the next frequency, should use this callback.
  * @parent_type:	the parent type of the device.
+ * @mem_stall_mode:	for CPUFREQ_PARENT_DEV, also vote for a frequency
+ *			derived from the CPUs' memory stall ratio, see
+ *			devfreq_passive_set_mem_stall(). Can be changed at
+ *			run time through sysfs.
  * @this:		the devfreq instance of own device.
  * @nb:			the notifier block for DEVFREQ_TRANSITION_NOTIFIER or
  *			CPUFREQ_TRANSITION_NOTIFIER list.
  * @cpu_data_list:	the list of cpu frequency data for all cpufreq_policy.
+ * @mem_stall_node:	node in the list of passive devices fed stall ratios.
+ * @mem_stall_full_pct:	stall ratio (in %) at which the stall vote is the max
+ *			frequency.
+ * @mem_stall_vote:	the last frequency voted for by the stall ratio.
+ * @mem_stall_time:	time (in jiffies) the stall vote spent at each
+ *			frequency of the freq_table.
+ * @mem_stall_idx:	freq_table index of @mem_stall_vote.
+ * @mem_stall_last:	last time @mem_stall_time was updated.
  *
  * The devfreq_passive_data have to set the devfreq instance of parent
  * device with governors except for the passive governor. But, don't need to
@@ -331,12 +343,31 @@ struct devfreq_passive_data {
 	/* Should set the type of parent device */
 	enum devfreq_parent_dev_type parent_type;
 
+	/* Optional, use the memory stall ratio next to the CPU frequency */
+	bool mem_stall_mode;
+
 	/* For passive governor's internal use. Don't need to set them */
 	struct devfreq *this;
 	struct notifier_block nb;
 	struct list_head cpu_data_list;
+
+	struct list_head mem_stall_node;
+	unsigned int mem_stall_full_pct;
+	unsigned long mem_stall_vote;
+	u64 *mem_stall_time;
+	unsigned int mem_stall_idx;
+	u64 mem_stall_last;
 };
 
+#if IS_ENABLED(CONFIG_DEVFREQ_GOV_PASSIVE)
+void devfreq_passive_set_mem_stall(int cpu, unsigned int stall_pct);
+#else
+static inline void devfreq_passive_set_mem_stall(int cpu,
+						 unsigned int stall_pct)
+{
+}
+#endif
+
 #if !defined(CONFIG_PM_DEVFREQ)
 static inline struct devfreq *devfreq_add_device(struct device *dev,
 					struct devfreq_dev_profile *profile,
@@ -528,6 +528,15 @@ struct dma_buf {
 			struct work_struct sysfs_add_work;
 		};
 		struct dma_buf *dmabuf;
+		/**
+		 * @exporter: aggregated statistics of the exporter
+		 * @process: aggregated statistics of the exporting process
+		 * @size: size accounted to them, as @dmabuf may be gone
+		 *	  by the time the kobject is released
+		 */
+		struct dma_buf_stats_bucket *exporter;
+		struct dma_buf_stats_bucket *process;
+		size_t size;
 	} *sysfs_entry;
 #endif
 
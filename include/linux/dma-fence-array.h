@@ -80,6 +80,11 @@ struct dma_fence_array *dma_fence_array_create(int num_fences,
 					       struct dma_fence **fences,
 					       u64 context, unsigned seqno,
 					       bool signal_on_any);
+struct dma_fence_array *dma_fence_array_create_inline(int num_fences,
+						      struct dma_fence **fences,
+						      u64 context,
+						      unsigned seqno,
+						      bool signal_on_any);
 
 bool dma_fence_match_context(struct dma_fence *fence, u64 context);
 
@@ -48,6 +48,12 @@ struct dma_fence *dma_fence_unwrap_next(struct dma_fence_unwrap *cursor);
 	for (fence = dma_fence_unwrap_first(head, cursor); fence;	\
 	     fence = dma_fence_unwrap_next(cursor))
 
+/*
+ * Merges of up to this many unsignaled fences keep their fence pointers in
+ * the resulting dma_fence_array object instead of a separate allocation.
+ */
+#define DMA_FENCE_UNWRAP_INLINE	8
+
 struct dma_fence *__dma_fence_unwrap_merge(unsigned int num_fences,
 					   struct dma_fence **fences,
 					   struct dma_fence_unwrap *cursors);
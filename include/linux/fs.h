@@ -962,6 +962,9 @@ struct file_ra_state {
 	unsigned int ra_pages;
 	unsigned int mmap_miss;
 	loff_t prev_pos;
+#ifdef CONFIG_READAHEAD_HINTS
+	unsigned long hint_until;
+#endif
 };
 
 /*
@@ -1301,6 +1304,13 @@ struct super_block {
 	struct rcu_head		rcu;
 	struct work_struct	destroy_work;
 
+	/*
+	 * Unused negative dentries of this sb on s_dentry_lru, and the work
+	 * which trims them back when they exceed fs.negative-dentry-limit.
+	 */
+	atomic_long_t		s_nr_negative_dentry;
+	struct work_struct	s_negative_dentry_work;
+
 	struct mutex		s_sync_lock;	/* sync serialisation lock */
 
 	/*
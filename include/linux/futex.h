@@ -90,4 +90,19 @@ static inline long do_futex(u32 __user *uaddr, int op, u32 val,
 }
 #endif
 
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+void futex_private_hash_alloc(void);
+void futex_private_hash_free(struct mm_struct *mm);
+int futex_hash_prctl(unsigned long op, unsigned long arg);
+void futex_mm_init(struct mm_struct *mm);
+#else
+static inline void futex_private_hash_alloc(void) { }
+static inline void futex_private_hash_free(struct mm_struct *mm) { }
+static inline int futex_hash_prctl(unsigned long op, unsigned long arg)
+{
+	return -EINVAL;
+}
+static inline void futex_mm_init(struct mm_struct *mm) { }
+#endif
+
 #endif
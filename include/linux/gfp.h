@@ -344,6 +344,7 @@ extern void page_frag_free(void *addr);
 
 void page_alloc_init_cpuhp(void);
 void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp);
+bool decay_pcp_high(struct zone *zone, struct per_cpu_pages *pcp);
 void drain_all_pages(struct zone *zone);
 void drain_local_pages(struct zone *zone);
 
@@ -378,7 +379,21 @@ static inline bool gfp_compaction_allowed(gfp_t gfp_mask)
 extern gfp_t vma_thp_gfp_mask(struct vm_area_struct *vma);
 
 #ifdef CONFIG_CONTIG_ALLOC
+/*
+ * Pages that alloc_contig_range() could not migrate out of the range, by the
+ * likely reason.
+ */
+struct acr_info {
+	unsigned long nr_pinned;
+	unsigned long nr_writeback;
+	unsigned long nr_locked;
+	unsigned long nr_other;
+};
+
 /* The below functions must be run on a range from a single zone. */
+extern int __alloc_contig_range(unsigned long start, unsigned long end,
+				unsigned migratetype, gfp_t gfp_mask,
+				struct acr_info *info);
 extern int alloc_contig_range(unsigned long start, unsigned long end,
 			      unsigned migratetype, gfp_t gfp_mask);
 extern struct page *alloc_contig_pages(unsigned long nr_pages, gfp_t gfp_mask,
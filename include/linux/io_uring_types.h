@@ -193,6 +193,20 @@ struct io_alloc_cache {
 	size_t			elem_size;
 };
 
+struct io_op_stats;
+
+/* zerocopy send tuning and stats, see IORING_REGISTER_SEND_ZC */
+struct io_zc_tx {
+	/* notification shared by the open IORING_SEND_ZC_COALESCE batch */
+	struct io_kiocb		*notif;
+	unsigned int		notif_nr;
+	unsigned int		notif_batch;
+	unsigned int		copy_thresh;
+	unsigned long		nr_sends;
+	unsigned long		nr_notifs;
+	atomic_long_t		nr_copied;
+};
+
 struct io_ring_ctx {
 	/* const or read-mostly hot data */
 	struct {
@@ -256,6 +270,15 @@ struct io_ring_ctx {
 		struct io_alloc_cache	apoll_cache;
 		struct io_alloc_cache	netmsg_cache;
 
+		/* FUTEX_WAIT/FUTEX_WAITV and WAITID requests, for cancelation */
+		struct hlist_head	futex_list;
+		struct hlist_head	waitid_list;
+
+		struct io_zc_tx		zc_tx;
+
+		/* per-opcode array, IFF IORING_SETUP_OP_STATS */
+		struct io_op_stats __percpu *op_stats;
+
 		/*
 		 * ->iopoll_list is protected by the ctx->uring_lock for
 		 * io_uring instances that don't use IORING_SETUP_SQPOLL.
@@ -367,6 +390,9 @@ struct io_ring_ctx {
 	struct callback_head		poll_wq_task_work;
 	struct list_head		defer_list;
 	unsigned			sq_thread_idle;
+	/* IORING_SETUP_SQ_IDLE_ADAPTIVE, only used by the SQ thread */
+	u64				sq_last_submit_ns;
+	u64				sq_gap_ns;
 	/* protected by ->completion_lock */
 	unsigned			evfd_last_cq_tail;
 
@@ -590,6 +616,8 @@ struct io_kiocb {
 	/* custom credentials, valid IFF REQ_F_CREDS is set */
 	const struct cred		*creds;
 	struct io_wq_work		work;
+	/* submission time, valid IFF IORING_SETUP_OP_STATS is set */
+	u64				submit_ns;
 
 	struct {
 		u64			extra1;
@@ -18,6 +18,24 @@ struct irq_desc;
 struct irq_domain;
 struct pt_regs;
 
+#ifdef CONFIG_IRQ_CAPACITY_BALANCE
+/**
+ * struct irq_balance_stat - per interrupt state of the IRQ balancer
+ * @last_count:	interrupt count at the previous balancer pass
+ * @rate:	interrupts per second since the previous pass
+ * @moves:	number of times the balancer moved the interrupt
+ * @decision:	outcome of the last pass
+ * @last_move:	jiffies of the last move
+ */
+struct irq_balance_stat {
+	unsigned int		last_count;
+	unsigned int		rate;
+	unsigned int		moves;
+	unsigned int		decision;
+	unsigned long		last_move;
+};
+#endif
+
 /**
  * struct irq_desc - interrupt descriptor
  * @irq_common_data:	per irq and chip data passed down to chip functions
@@ -52,6 +70,7 @@ struct pt_regs;
  * @dir:		/proc/irq/ procfs entry
  * @debugfs_file:	dentry for the debugfs file
  * @name:		flow handler name for /proc/interrupts output
+ * @balance:		state of the capacity aware IRQ balancer
  */
 struct irq_desc {
 	struct irq_common_data	irq_common_data;
@@ -105,6 +124,9 @@ struct irq_desc {
 	const char		*name;
 #ifdef CONFIG_HARDIRQS_SW_RESEND
 	struct hlist_node	resend_node;
+#endif
+#ifdef CONFIG_IRQ_CAPACITY_BALANCE
+	struct irq_balance_stat	balance;
 #endif
 	ANDROID_VENDOR_DATA(1);
 } ____cacheline_internodealigned_in_smp;
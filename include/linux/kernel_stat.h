@@ -68,6 +68,10 @@ static inline unsigned int kstat_softirqs_cpu(unsigned int irq, int cpu)
        return kstat_cpu(cpu).softirqs[irq];
 }
 
+#ifdef CONFIG_SOFTIRQ_TYPE_THREADS
+extern u64 kstat_softirq_time_cpu(unsigned int irq, int cpu);
+#endif
+
 static inline unsigned int kstat_cpu_softirqs_sum(int cpu)
 {
 	int i;
@@ -102,6 +102,35 @@ bool list_lru_add(struct list_lru *lru, struct list_head *item);
  */
 bool list_lru_del(struct list_lru *lru, struct list_head *item);
 
+/**
+ * list_lru_add_memcg: add an element to a given node and cgroup of the lru
+ * @lru: the lru pointer
+ * @item: the item to be added.
+ * @nid: the node id of the sublist to add the item to.
+ * @memcg: the cgroup of the sublist to add the item to, %NULL for the root.
+ *
+ * Same as list_lru_add() for items which aren't slab objects or whose
+ * node and cgroup aren't those of the memory holding @item. The caller
+ * must have allocated the sublists of @memcg with memcg_list_lru_alloc()
+ * and has to pass the same @nid and @memcg to list_lru_del_memcg().
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+bool list_lru_add_memcg(struct list_lru *lru, struct list_head *item, int nid,
+			struct mem_cgroup *memcg);
+
+/**
+ * list_lru_del_memcg: delete an element added with list_lru_add_memcg()
+ * @lru: the lru pointer
+ * @item: the item to be deleted.
+ * @nid: the node id the item was added with.
+ * @memcg: the cgroup the item was added with.
+ *
+ * Return value: true if the list was updated, false otherwise
+ */
+bool list_lru_del_memcg(struct list_lru *lru, struct list_head *item, int nid,
+			struct mem_cgroup *memcg);
+
 /**
  * list_lru_count_one: return the number of objects currently held by @lru
  * @lru: the lru pointer.
@@ -203,6 +203,16 @@ struct obj_cgroup {
 	};
 };
 
+#define MEMCG_REFAULT_BUCKETS	12
+
+/* Per-cpu refault counters, see memory.refault_stat */
+struct memcg_refault_stat {
+	/* refaulted pages by refault distance bucket, [0] anon, [1] file */
+	unsigned long dist[2][MEMCG_REFAULT_BUCKETS];
+	/* refaulted pages within the launch window after going foreground */
+	unsigned long launch[2];
+};
+
 /*
  * The memory controller data structure. The memory controller controls both
  * page cache and RSS per cgroup. We would eventually like to provide
@@ -232,6 +242,8 @@ struct mem_cgroup {
 
 #if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
 	unsigned long zswap_max;
+	/* zswap compressor selected for this cgroup, NULL to inherit */
+	const char __rcu *zswap_compressor;
 #endif
 
 	unsigned long soft_limit;
@@ -334,8 +346,20 @@ struct mem_cgroup {
 #ifdef CONFIG_LRU_GEN
 	/* per-memcg mm_struct list */
 	struct lru_gen_mm_list mm_list;
+	/* LRU_GEN_HINT_* set via memory.lru_gen_hint */
+	int lru_gen_hint;
 #endif
 
+	struct memcg_refault_stat __percpu *refault_stat;
+	/* jiffies of the last foreground hint, 0 if none */
+	unsigned long fg_since;
+	unsigned int launch_window_ms;
+
+	/* Stale-ok stat reads set via memory.stat_stale_ms, 0 if disabled */
+	unsigned int stat_stale_ms;
+	/* jiffies of the last flush of this subtree */
+	unsigned long stats_flush_last;
+
 	// These must be before the flexible array member nodeinfo below
 	ANDROID_BACKPORT_RESERVE(1);
 	ANDROID_BACKPORT_RESERVE(2);
@@ -698,7 +722,10 @@ static inline int mem_cgroup_charge(struct folio *folio, struct mm_struct *mm,
 
 int mem_cgroup_swapin_charge_folio(struct folio *folio, struct mm_struct *mm,
 				  gfp_t gfp, swp_entry_t entry);
-void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry);
+void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry, unsigned int nr_pages);
+
+void mem_cgroup_account_refault(struct mem_cgroup *memcg, bool file,
+				unsigned int bucket, long nr);
 
 void __mem_cgroup_uncharge(struct folio *folio);
 
@@ -1267,7 +1294,14 @@ static inline int mem_cgroup_swapin_charge_folio(struct folio *folio,
 	return 0;
 }
 
-static inline void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry)
+static inline void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry,
+						    unsigned int nr_pages)
+{
+}
+
+static inline void mem_cgroup_account_refault(struct mem_cgroup *memcg,
+					      bool file, unsigned int bucket,
+					      long nr)
 {
 }
 
@@ -1894,11 +1928,18 @@ static inline void count_objcg_event(struct obj_cgroup *objcg,
 bool obj_cgroup_may_zswap(struct obj_cgroup *objcg);
 void obj_cgroup_charge_zswap(struct obj_cgroup *objcg, size_t size);
 void obj_cgroup_uncharge_zswap(struct obj_cgroup *objcg, size_t size);
+bool obj_cgroup_zswap_compressor(struct obj_cgroup *objcg, char *buf,
+				 size_t len);
 #else
 static inline bool obj_cgroup_may_zswap(struct obj_cgroup *objcg)
 {
 	return true;
 }
+static inline bool obj_cgroup_zswap_compressor(struct obj_cgroup *objcg,
+					       char *buf, size_t len)
+{
+	return false;
+}
 static inline void obj_cgroup_charge_zswap(struct obj_cgroup *objcg,
 					   size_t size)
 {
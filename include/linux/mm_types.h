@@ -706,6 +706,23 @@ struct mm_cid {
 };
 #endif
 
+#ifdef CONFIG_PROC_PAGE_MONITOR
+/*
+ * Resident and proportional sizes, in bytes, seen by the last full
+ * smaps_rollup walk of an mm.  smaps_rollup_fast scales the current rss
+ * counters by these ratios to estimate Pss without walking page tables.
+ */
+struct mm_pss_estimate {
+	unsigned long rss_anon;
+	unsigned long pss_anon;
+	unsigned long rss_other;
+	unsigned long pss_other;
+	unsigned long swap;
+	unsigned long swap_pss;
+	unsigned long stamp;		/* jiffies of the walk */
+};
+#endif
+
 struct kioctx_table;
 struct mm_struct {
 	struct {
@@ -850,6 +867,9 @@ struct mm_struct {
 		unsigned long saved_auxv[AT_VECTOR_SIZE]; /* for /proc/PID/auxv */
 
 		struct percpu_counter rss_stat[NR_MM_COUNTERS];
+#ifdef CONFIG_PROC_PAGE_MONITOR
+		struct mm_pss_estimate pss_estimate;
+#endif
 
 		struct linux_binfmt *binfmt;
 
@@ -921,6 +941,12 @@ struct mm_struct {
 #ifdef CONFIG_IOMMU_SVA
 		u32 pasid;
 #endif
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+		/* Private futex hash, see futex_private_hash_alloc() */
+		struct futex_private_hash *futex_phash;
+		/* Requested size of futex_phash, 0 for the default */
+		unsigned int futex_hash_slots;
+#endif
 #ifdef CONFIG_KSM
 		/*
 		 * Represent how many pages of this process are involved in KSM
@@ -540,7 +540,9 @@ void lru_gen_look_around(struct page_vma_mapped_walk *pvmw);
  *    threshold, which triggers MEMCG_LRU_YOUNG;
  * 5. Attempting to reclaim a memcg below min, which triggers MEMCG_LRU_YOUNG;
  * 6. Finishing the aging on the eviction path, which triggers MEMCG_LRU_YOUNG;
- * 7. Offlining a memcg, which triggers MEMCG_LRU_OLD.
+ * 7. Offlining a memcg, which triggers MEMCG_LRU_OLD;
+ * 8. Hinting a memcg as background, which ages it and triggers MEMCG_LRU_OLD;
+ * 9. Hinting a memcg as foreground, which triggers MEMCG_LRU_YOUNG.
  *
  * Notes:
  * 1. Memcg LRU only applies to global reclaim, and the round-robin incrementing
@@ -553,6 +555,17 @@ void lru_gen_look_around(struct page_vma_mapped_walk *pvmw);
 #define MEMCG_NR_GENS	3
 #define MEMCG_NR_BINS	8
 
+/*
+ * Aging hints set from userspace via memory.lru_gen_hint. A background memcg
+ * is aged ahead of time and evicted before others; a foreground memcg is
+ * skipped on the first attempt, like one below low.
+ */
+enum {
+	LRU_GEN_HINT_NONE,
+	LRU_GEN_HINT_FOREGROUND,
+	LRU_GEN_HINT_BACKGROUND,
+};
+
 struct lru_gen_memcg {
 	/* the per-node memcg generation counter */
 	unsigned long seq;
@@ -572,6 +585,7 @@ void lru_gen_online_memcg(struct mem_cgroup *memcg);
 void lru_gen_offline_memcg(struct mem_cgroup *memcg);
 void lru_gen_release_memcg(struct mem_cgroup *memcg);
 void lru_gen_soft_reclaim(struct mem_cgroup *memcg, int nid);
+void lru_gen_hint_memcg(struct mem_cgroup *memcg, int hint);
 
 #else /* !CONFIG_MEMCG */
 
@@ -626,6 +640,10 @@ static inline void lru_gen_soft_reclaim(struct mem_cgroup *memcg, int nid)
 {
 }
 
+static inline void lru_gen_hint_memcg(struct mem_cgroup *memcg, int hint)
+{
+}
+
 #endif /* CONFIG_MEMCG */
 
 #endif /* CONFIG_LRU_GEN */
@@ -699,8 +717,11 @@ struct per_cpu_pages {
 	spinlock_t lock;	/* Protects lists field */
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
+	int high_min;		/* min high watermark */
+	int high_max;		/* max high watermark */
 	int batch;		/* chunk size for buddy add/remove */
 	short free_factor;	/* batch scaling factor during free */
+	short alloc_factor;	/* batch scaling factor during allocate */
 #ifdef CONFIG_NUMA
 	short expire;		/* When 0, remote pagesets are drained */
 #endif
@@ -861,6 +882,7 @@ struct zone {
 	 * faster access
 	 */
 	int pageset_high;
+	int pageset_high_max;
 	int pageset_batch;
 
 #ifndef CONFIG_SPARSEMEM
@@ -1353,6 +1375,13 @@ typedef struct pglist_data {
 
 	int kswapd_failures;		/* Number of 'reclaimed == 0' runs */
 
+	/* Extra kswapd threads, see vm.kswapd_threads */
+	struct task_struct **kswapd_helpers;
+	wait_queue_head_t kswapd_helper_wait;
+	atomic_t kswapd_helpers_wanted;	/* Set by kswapd while it runs */
+	enum zone_type kswapd_helper_zoneidx;
+	atomic_long_t nr_direct_reclaim; /* Global direct reclaim passes */
+
 	ANDROID_OEM_DATA(1);
 #ifdef CONFIG_COMPACTION
 	int kcompactd_max_order;
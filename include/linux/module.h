@@ -381,6 +381,11 @@ struct mod_kallsyms {
 	unsigned int num_symtab;
 	char *strtab;
 	char *typetab;
+	/* symtab indexes sorted by name and by address, may be NULL */
+	unsigned int *name_index;
+	unsigned int *addr_index;
+	unsigned int num_name_index;
+	unsigned int num_addr_index;
 };
 
 #ifdef CONFIG_LIVEPATCH
@@ -400,6 +405,16 @@ struct klp_modinfo {
 };
 #endif
 
+/* Phases of loading a module, timed in struct module::load_time_us[] */
+enum mod_load_phase {
+	MOD_LOAD_READ,
+	MOD_LOAD_DECOMPRESS,
+	MOD_LOAD_SIG,
+	MOD_LOAD_LINK,
+	MOD_LOAD_INIT,
+	MOD_LOAD_PHASE_NR,
+};
+
 struct module {
 	enum module_state state;
 
@@ -588,7 +603,8 @@ struct module {
 	struct _ddebug_info dyndbg_info;
 #endif
 
-	ANDROID_KABI_RESERVE(1);
+	/* Time spent in each phase of loading, indexed by enum mod_load_phase */
+	ANDROID_KABI_USE(1, unsigned int *load_time_us);
 	ANDROID_KABI_RESERVE(2);
 	ANDROID_KABI_RESERVE(3);
 	ANDROID_KABI_RESERVE(4);
@@ -112,4 +112,12 @@ extern void oom_killer_enable(void);
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_PSI
+struct seq_file;
+
+extern void oom_candidates_get(void);
+extern void oom_candidates_put(void);
+extern void oom_candidates_show(struct seq_file *m);
+#endif
+
 #endif /* _INCLUDE_LINUX_OOM_H */
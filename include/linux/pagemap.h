@@ -1291,6 +1291,28 @@ struct readahead_control {
 
 #define VM_READAHEAD_PAGES	(SZ_128K / PAGE_SIZE)
 
+#ifdef CONFIG_READAHEAD_HINTS
+void readahead_hints_open(struct file *file);
+void readahead_hints_record(struct file *file, pgoff_t index,
+			    unsigned long nr);
+
+static inline void readahead_hints_miss(struct file *file, pgoff_t index,
+					unsigned long nr)
+{
+	if (file && unlikely(file->f_ra.hint_until))
+		readahead_hints_record(file, index, nr);
+}
+#else
+static inline void readahead_hints_open(struct file *file)
+{
+}
+
+static inline void readahead_hints_miss(struct file *file, pgoff_t index,
+					unsigned long nr)
+{
+}
+#endif
+
 void page_cache_ra_unbounded(struct readahead_control *,
 		unsigned long nr_to_read, unsigned long lookahead_count);
 void page_cache_sync_ra(struct readahead_control *, unsigned long req_count);
@@ -14,6 +14,8 @@ enum page_walk_lock {
 	PGWALK_WRLOCK = 1,
 	/* vma is expected to be already write-locked during the walk */
 	PGWALK_WRLOCK_VERIFY = 2,
+	/* vma is read-locked by the caller, mmap_lock may not be held */
+	PGWALK_VMA_RDLOCK_VERIFY = 3,
 };
 
 /**
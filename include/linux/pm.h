@@ -686,6 +686,9 @@ struct dev_pm_info {
 	bool			no_pm_callbacks:1;	/* Owned by the PM core */
 	unsigned int		must_resume:1;	/* Owned by the PM core */
 	unsigned int		may_skip_resume:1;	/* Set by subsystems */
+	bool			resumed_async:1;	/* Owned by the PM core */
+	u64			resume_wait_ns;		/* Ditto */
+	u64			resume_cb_ns;		/* Ditto */
 #else
 	unsigned int		should_wakeup:1;
 #endif
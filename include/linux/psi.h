@@ -40,7 +40,7 @@ static inline struct psi_group *cgroup_psi(struct cgroup *cgrp)
 int psi_cgroup_alloc(struct cgroup *cgrp);
 void psi_cgroup_free(struct cgroup *cgrp);
 void cgroup_move_task(struct task_struct *p, struct css_set *to);
-void psi_cgroup_restart(struct psi_group *group);
+void psi_cgroup_set_enabled(struct cgroup *cgrp, bool enable);
 #endif
 
 #else /* CONFIG_PSI */
@@ -62,7 +62,7 @@ static inline void cgroup_move_task(struct task_struct *p, struct css_set *to)
 {
 	rcu_assign_pointer(p->cgroups, to);
 }
-static inline void psi_cgroup_restart(struct psi_group *group) {}
+static inline void psi_cgroup_set_enabled(struct cgroup *cgrp, bool enable) {}
 #endif
 
 #endif /* CONFIG_PSI */
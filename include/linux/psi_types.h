@@ -93,6 +93,9 @@ struct psi_group_cpu {
 	/* Aggregate pressure state derived from the tasks */
 	u32 state_mask;
 
+	/* cgroup.pressure is 0: the task walks skip this group */
+	bool disabled;
+
 	/* Period time sampling buckets for each state of interest (ns) */
 	u32 times[NR_PSI_STATES];
 
@@ -111,11 +111,13 @@ static inline int rcu_preempt_depth(void)
 
 #ifdef CONFIG_RCU_LAZY
 void call_rcu_hurry(struct rcu_head *head, rcu_callback_t func);
+void rcu_lazy_set_screen_off(bool screen_off);
 #else
 static inline void call_rcu_hurry(struct rcu_head *head, rcu_callback_t func)
 {
 	call_rcu(head, func);
 }
+static inline void rcu_lazy_set_screen_off(bool screen_off) { }
 #endif
 
 /* Internal to kernel */
@@ -34,6 +34,9 @@
 #endif
 #include <linux/android_vendor.h>
 
+/* A power of two, readers are hashed to a slot */
+#define RWSEM_PI_NR_READERS	4
+
 /*
  * For an uncontended rwsem, count and owner are the only fields a task
  * needs to touch when acquiring the rwsem. So they are put next to each
@@ -64,6 +67,10 @@ struct rw_semaphore {
 #endif
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
+#endif
+#ifdef CONFIG_RWSEM_READER_PI
+	/* Readers that may be boosted by a waiter, see rwsem_boost_readers() */
+	struct task_struct *reader_owners[RWSEM_PI_NR_READERS];
 #endif
 	ANDROID_VENDOR_DATA(1);
 	ANDROID_OEM_DATA_ARRAY(1, 2);
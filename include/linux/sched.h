@@ -49,6 +49,7 @@ struct bpf_local_storage;
 struct bpf_run_ctx;
 struct capture_control;
 struct cfs_rq;
+struct cpufreq_task_times;
 struct fs_struct;
 struct futex_pi_state;
 struct io_context;
@@ -861,6 +862,11 @@ struct task_struct {
 #endif /* #ifdef CONFIG_TASKS_TRACE_RCU */
 
 	struct sched_info		sched_info;
+#ifdef CONFIG_LATENCY_HIST
+	/* When the task last became runnable, see trace_latency_hist.c */
+	u64				latency_hist_ts;
+	bool				latency_hist_woken;
+#endif
 
 	struct list_head		tasks;
 #ifdef CONFIG_SMP
@@ -1019,8 +1025,7 @@ struct task_struct {
 #endif
 	u64				gtime;
 #ifdef CONFIG_CPU_FREQ_TIMES
-	u64				*time_in_state;
-	unsigned int			max_state;
+	struct cpufreq_task_times __rcu	*time_in_state;
 #endif
 	struct prev_cputime		prev_cputime;
 #ifdef CONFIG_VIRT_CPU_ACCOUNTING_GEN
@@ -2318,6 +2323,15 @@ static inline bool vcpu_is_preempted(int cpu)
 extern long sched_setaffinity(pid_t pid, const struct cpumask *new_mask);
 extern long sched_getaffinity(pid_t pid, struct cpumask *mask);
 
+#ifdef CONFIG_CGROUP_SCHED
+extern u64 current_timer_slack_ns(void);
+#else
+static inline u64 current_timer_slack_ns(void)
+{
+	return current->timer_slack_ns;
+}
+#endif
+
 #ifndef TASK_SIZE_OF
 #define TASK_SIZE_OF(tsk)	TASK_SIZE
 #endif
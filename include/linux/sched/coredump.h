@@ -92,6 +92,7 @@ static inline int get_dumpable(struct mm_struct *mm)
 
 #define MMF_VM_MERGE_ANY	29
 #define MMF_HAS_MDWE_NO_INHERIT	30
+#define MMF_FORK_LAZY_PTES	31	/* fork() leaves page cache ptes to fault */
 
 static inline unsigned long mmf_init_flags(unsigned long flags)
 {
@@ -2,6 +2,7 @@
 #ifndef _LINUX_SCHED_CPUFREQ_H
 #define _LINUX_SCHED_CPUFREQ_H
 
+#include <linux/errno.h>
 #include <linux/types.h>
 
 /*
@@ -35,4 +36,32 @@ static inline unsigned long map_util_perf(unsigned long util)
 }
 #endif /* CONFIG_CPU_FREQ */
 
+/*
+ * Short-lived frequency floors requested from outside the scheduler, e.g.
+ * by an input-boost driver or by an ext scheduler anticipating load.
+ */
+enum sugov_boost_reason {
+	SUGOV_BOOST_INPUT,
+	SUGOV_BOOST_SCHED_EXT,
+	SUGOV_BOOST_DRIVER,
+	SUGOV_BOOST_NR_REASONS,
+};
+
+struct sugov_boost {
+	const char		*name;
+	enum sugov_boost_reason	reason;
+};
+
+#ifdef CONFIG_CPU_FREQ_GOV_SCHEDUTIL
+int sugov_boost_request(const struct sugov_boost *boost, int cpu,
+			unsigned long util, unsigned int duration_ms);
+#else
+static inline int sugov_boost_request(const struct sugov_boost *boost, int cpu,
+				      unsigned long util,
+				      unsigned int duration_ms)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
 #endif /* _LINUX_SCHED_CPUFREQ_H */
@@ -12,6 +12,7 @@
 #ifdef CONFIG_SCHED_CLASS_EXT
 
 #include <linux/llist.h>
+#include <linux/rhashtable-types.h>
 
 enum scx_consts {
 	SCX_OPS_NAME_LEN	= 128,
@@ -34,22 +35,27 @@ enum scx_consts {
  *
  * Built-in IDs:
  *
- *   Bits: [63] [62] [61..32] [31 ..  0]
- *         [ 1] [ L] [   R  ] [    V   ]
+ *   Bits: [63] [62] [61] [60..32] [31 ..  0]
+ *         [ 1] [ L] [ C] [   R  ] [    V   ]
  *
  *    1: 1 for built-in DSQs.
  *    L: 1 for LOCAL_ON DSQ IDs, 0 for others
- *    V: For LOCAL_ON DSQ IDs, a CPU number. For others, a pre-defined value.
+ *    C: 1 for CLUSTER DSQ IDs, 0 for others
+ *    V: For LOCAL_ON DSQ IDs, a CPU number. For CLUSTER DSQ IDs, a capacity
+ *       cluster index. For others, a pre-defined value.
  */
 enum scx_dsq_id_flags {
 	SCX_DSQ_FLAG_BUILTIN	= 1LLU << 63,
 	SCX_DSQ_FLAG_LOCAL_ON	= 1LLU << 62,
+	SCX_DSQ_FLAG_CLUSTER	= 1LLU << 61,
 
 	SCX_DSQ_INVALID		= SCX_DSQ_FLAG_BUILTIN | 0,
 	SCX_DSQ_GLOBAL		= SCX_DSQ_FLAG_BUILTIN | 1,
 	SCX_DSQ_LOCAL		= SCX_DSQ_FLAG_BUILTIN | 2,
 	SCX_DSQ_LOCAL_ON	= SCX_DSQ_FLAG_BUILTIN | SCX_DSQ_FLAG_LOCAL_ON,
 	SCX_DSQ_LOCAL_CPU_MASK	= 0xffffffffLLU,
+	SCX_DSQ_CLUSTER		= SCX_DSQ_FLAG_BUILTIN | SCX_DSQ_FLAG_CLUSTER,
+	SCX_DSQ_CLUSTER_MASK	= 0xffffffffLLU,
 };
 
 enum scx_exit_type {
@@ -506,8 +512,10 @@ struct scx_dispatch_q {
 	raw_spinlock_t		lock;
 	struct list_head	fifo;	/* processed in dispatching order */
 	struct rb_root_cached	priq;	/* processed in p->scx.dsq_vtime order */
+	struct llist_head	staged;	/* lockless FIFO enqueues, see dispatch_enqueue() */
 	u32			nr;
 	u64			id;
+	struct rhash_head	hash_node;
 	struct llist_node	free_node;
 	struct rcu_head		rcu;
 };
@@ -567,9 +575,27 @@ struct scx_sched_task_stats {
 
 	u32				demand;
 	u16				demand_scaled;
+	u8				top_bucket;	/* top_tasks[] bucket + 1, 0 if not counted */
 	void 			*sdsq;
 };
 
+#define SCX_TOP_TASK_BUCKETS	32
+
+struct scx_sched_rq_stats {
+	u64		window_start;
+	u32		window_size;
+	u64		latest_clock;
+	u32		prev_window_size;
+	u64		task_exec_scale;
+	u64		prev_runnable_sum;
+	u64		curr_runnable_sum;
+	int		*sched_ravg_window_ptr;
+
+	/* runnable ext tasks by demand_scaled, see scx_top_task_add() */
+	u32		top_tasks[SCX_TOP_TASK_BUCKETS];
+	u32		top_tasks_bitmap;
+};
+
 
 
 /*
@@ -581,10 +607,12 @@ struct sched_ext_entity {
 	struct {
 		struct list_head	fifo;	/* dispatch order */
 		struct rb_node		priq;	/* p->scx.dsq_vtime order */
+		struct llist_node	stage;	/* on dsq->staged */
 	} dsq_node;
 	struct list_head	watchdog_node;
 	u32			flags;		/* protected by rq lock */
 	u32			dsq_flags;	/* protected by dsq lock */
+	u8			dsq_dl_level;	/* priq order, see scx_dsq_priq_less() */
 	u32			weight;
 	s32			sticky_cpu;
 	s32			holding_cpu;
@@ -592,6 +620,12 @@ struct sched_ext_entity {
 	struct task_struct	*kf_tasks[2];	/* see SCX_CALL_OP_TASK() */
 	atomic64_t		ops_state;
 	unsigned long		runnable_at;
+	u64			runnable_at_ns;	/* rq clock, see scx_record_latency() */
+	u8			lat_src;	/* DSQ kind @p was consumed from */
+	u8			dsq_sync_ux;	/* DSQ_SYNC_* UX marks */
+	u8			ux_dl_level;	/* inherited deadline level */
+	s32			critical_affinity_cpu; /* preferred CPU while UX, -1 if none */
+	unsigned long		ux_expires;	/* jiffies, end of the inherited mark */
 #ifdef CONFIG_SCHED_CORE
 	u64			core_sched_at;	/* see scx_prio_less() */
 #endif
@@ -644,4 +678,39 @@ void sched_ext_free(struct task_struct *p);
 static inline void sched_ext_free(struct task_struct *p) {}
 
 #endif	/* CONFIG_SCHED_CLASS_EXT */
+
+/*
+ * Ext scheduler properties a synchronous IPC server takes over from its
+ * caller for the length of a call, see scx_sync_inherit_begin().
+ */
+struct scx_sync_prop {
+	u8			dsq_sync_ux;
+	u8			ux_dl_level;
+	s32			critical_affinity_cpu;
+};
+
+#ifdef CONFIG_SCHED_CLASS_EXT
+unsigned long scx_cpu_ext_util(int cpu);
+void scx_sync_prop_capture(struct task_struct *p, struct scx_sync_prop *prop);
+void scx_sync_inherit_begin(struct task_struct *p,
+			    const struct scx_sync_prop *prop,
+			    struct scx_sync_prop *saved);
+void scx_sync_inherit_end(struct task_struct *p,
+			  const struct scx_sync_prop *saved);
+#else
+static inline unsigned long scx_cpu_ext_util(int cpu)
+{
+	return 0;
+}
+static inline void scx_sync_prop_capture(struct task_struct *p,
+					 struct scx_sync_prop *prop)
+{
+	prop->dsq_sync_ux = 0;
+}
+static inline void scx_sync_inherit_begin(struct task_struct *p,
+					  const struct scx_sync_prop *prop,
+					  struct scx_sync_prop *saved) {}
+static inline void scx_sync_inherit_end(struct task_struct *p,
+					const struct scx_sync_prop *saved) {}
+#endif
 #endif	/* _LINUX_SCHED_EXT_H */
@@ -212,6 +212,7 @@ enum DSQ_SYNC_UX_FLAG {
 	DSQ_SYNC_UX_NONE = 0,
 	DSQ_SYNC_STATIC_UX = 1,
 	DSQ_SYNC_INHERIT_UX = 1 << 1,
+	DSQ_SYNC_BINDER_UX = 1 << 2,
 };
 
 #endif	/* _LINUX_SCHED_HMBIRD_H */
@@ -155,6 +155,16 @@
 #define SLAB_SKIP_KFENCE	0
 #endif
 
+/*
+ * Serve allocations and frees from a per-cpu array of objects (sheaf) that
+ * is refilled and drained in bulk, for hot caches (SLUB only).
+ */
+#ifndef CONFIG_SLUB_TINY
+#define SLAB_PCPU_SHEAVES	((slab_flags_t __force)0x40000000U)
+#else
+#define SLAB_PCPU_SHEAVES	0
+#endif
+
 /* The following flags affect the page allocator grouping pages by mobility */
 /* Objects are reclaimable */
 #ifndef CONFIG_SLUB_TINY
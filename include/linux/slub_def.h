@@ -39,6 +39,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	ALLOC_PCS,		/* Allocation from the cpu sheaf */
+	FREE_PCS,		/* Free to the cpu sheaf */
+	SHEAF_REFILL,		/* Cpu sheaf refilled by bulk allocation */
+	SHEAF_FLUSH,		/* Objects bulk freed from the cpu sheaf */
 	NR_SLUB_STAT_ITEMS
 };
 
@@ -98,6 +102,9 @@ struct kmem_cache_order_objects {
 struct kmem_cache {
 #ifndef CONFIG_SLUB_TINY
 	struct kmem_cache_cpu __percpu *cpu_slab;
+	/* Per cpu object arrays, only with SLAB_PCPU_SHEAVES */
+	struct slub_percpu_sheaves __percpu *cpu_sheaves;
+	unsigned int sheaf_capacity;
 #endif
 	/* Used for retrieving partial slabs, etc. */
 	slab_flags_t flags;
@@ -72,6 +72,8 @@ struct suspend_stats {
 	u64	last_hw_sleep;
 	u64	total_hw_sleep;
 	u64	max_hw_sleep;
+	u64	last_suspend_entry_us;
+	u64	last_resume_exit_us;
 	enum suspend_stat_step	failed_steps[REC_FAILED_NUM];
 };
 
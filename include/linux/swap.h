@@ -45,6 +45,7 @@ struct pagevec;
 				 SWAP_FLAG_MTHP_RESERVE_ORDER_MASK | \
 				 SWAP_FLAG_MTHP_RESERVE_PERCENT_MASK)
 #define SWAP_BATCH 64
+#define SWAP_BATCH_MAX (4 * SWAP_BATCH)
 
 static inline int current_is_kswapd(void)
 {
@@ -503,7 +504,7 @@ extern int get_swap_pages(int n, swp_entry_t swp_entries[], int order);
 extern int add_swap_count_continuation(swp_entry_t, gfp_t);
 extern void swap_shmem_alloc(swp_entry_t);
 extern int swap_duplicate(swp_entry_t);
-extern int swapcache_prepare(swp_entry_t);
+extern int swapcache_prepare(swp_entry_t entry, int nr);
 extern void swap_free_nr(swp_entry_t entry, int nr_pages);
 extern void swapcache_free_entries(swp_entry_t *entries, int n);
 extern void free_swap_and_cache_nr(swp_entry_t entry, int nr);
@@ -578,7 +579,7 @@ static inline int swap_duplicate(swp_entry_t swp)
 	return 0;
 }
 
-static inline int swapcache_prepare(swp_entry_t swp)
+static inline int swapcache_prepare(swp_entry_t swp, int nr)
 {
 	return 0;
 }
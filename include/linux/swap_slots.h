@@ -7,8 +7,10 @@
 #include <linux/mutex.h>
 
 #define SWAP_SLOTS_CACHE_SIZE			SWAP_BATCH
+#define SWAP_SLOTS_CACHE_MAX			SWAP_BATCH_MAX
 #define THRESHOLD_ACTIVATE_SWAP_SLOTS_CACHE	(5*SWAP_SLOTS_CACHE_SIZE)
 #define THRESHOLD_DEACTIVATE_SWAP_SLOTS_CACHE	(2*SWAP_SLOTS_CACHE_SIZE)
+#define THRESHOLD_GROW_SWAP_SLOTS_CACHE		(5*SWAP_SLOTS_CACHE_MAX)
 
 struct swap_slots_cache {
 	bool		lock_initialized;
@@ -16,6 +18,8 @@ struct swap_slots_cache {
 	swp_entry_t	*slots;
 	int		nr;
 	int		cur;
+	int		batch;	    /* slots taken per refill */
+	unsigned long	refill_time;
 	spinlock_t	free_lock;  /* protects slots_ret, n_ret */
 	swp_entry_t	*slots_ret;
 	int		n_ret;
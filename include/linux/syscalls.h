@@ -37,6 +37,7 @@ struct rlimit64;
 struct rusage;
 struct sched_param;
 struct sched_attr;
+struct module_batch_entry;
 struct sel_arg_struct;
 struct semaphore;
 struct sembuf;
@@ -550,6 +551,12 @@ asmlinkage long sys_set_robust_list(struct robust_list_head __user *head,
 asmlinkage long sys_futex_waitv(struct futex_waitv *waiters,
 				unsigned int nr_futexes, unsigned int flags,
 				struct __kernel_timespec __user *timeout, clockid_t clockid);
+
+asmlinkage long sys_futex_wake(void __user *uaddr, unsigned long mask, int nr, unsigned int flags);
+asmlinkage long sys_futex_wait(void __user *uaddr, unsigned long val, unsigned long mask,
+			       unsigned int flags, struct __kernel_timespec __user *timespec,
+			       clockid_t clockid);
+
 asmlinkage long sys_nanosleep(struct __kernel_timespec __user *rqtp,
 			      struct __kernel_timespec __user *rmtp);
 asmlinkage long sys_nanosleep_time32(struct old_timespec32 __user *rqtp,
@@ -873,6 +880,8 @@ asmlinkage long sys_process_vm_writev(pid_t pid,
 asmlinkage long sys_kcmp(pid_t pid1, pid_t pid2, int type,
 			 unsigned long idx1, unsigned long idx2);
 asmlinkage long sys_finit_module(int fd, const char __user *uargs, int flags);
+asmlinkage long sys_finit_module_batch(struct module_batch_entry __user *entries,
+				       unsigned int nr, int flags);
 asmlinkage long sys_sched_setattr(pid_t pid,
 					struct sched_attr __user *attr,
 					unsigned int flags);
@@ -285,6 +285,8 @@ struct tcp_sock {
 	u32	tcp_tx_delay;	/* delay (in usec) added to TX packets */
 	u64	tcp_wstamp_ns;	/* departure time for next sent data packet */
 	u64	tcp_clock_cache; /* cache last tcp_clock_ns() (see tcp_mstamp_refresh()) */
+	u64	pacing_burst_ns; /* start of the last burst pacing interval used */
+	u32	pacing_bursts;	/* Number of burst pacing intervals used */
 
 /* RTT measurement */
 	u64	tcp_mstamp;	/* most recent packet received/sent */
@@ -34,6 +34,7 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		FOR_ALL_ZONES(ALLOCSTALL)
 		FOR_ALL_ZONES(PGSCAN_SKIP)
 		PGFREE, PGACTIVATE, PGDEACTIVATE, PGLAZYFREE,
+		PCP_ALLOC_LOCK_AVOIDED, PCP_FREE_LOCK_AVOIDED,
 		PGFAULT, PGMAJFAULT,
 		PGLAZYFREED,
 		PGREFILL,
@@ -138,10 +139,17 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_SWAP
 		SWAP_RA,
 		SWAP_RA_HIT,
+		SWAP_SLOTS_REFILL,
+		SWAP_ALLOC_SCAN,
+		SWAP_LOCK_CONTENDED,
 #ifdef CONFIG_KSM
 		KSM_SWPIN_COPY,
 #endif
 #endif
+		PGSIZE_FIXUP_VMA,	/* anon VMAs filling compat mmap tails */
+		PGSIZE_FIXUP_PAGES,
+		PGSIZE_PAD_VMA,		/* ELF segment VMAs marked as padded */
+		PGSIZE_PAD_PAGES,
 #ifdef CONFIG_KSM
 		COW_KSM,
 #endif
@@ -158,6 +166,15 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		VMA_LOCK_ABORT,
 		VMA_LOCK_RETRY,
 		VMA_LOCK_MISS,
+		/* why a fault under the VMA lock had to retry under mmap_lock */
+		VMA_LOCK_RETRY_ANON_VMA,
+		VMA_LOCK_RETRY_FAULT,
+		VMA_LOCK_RETRY_DEVICE,
+		VMA_LOCK_RETRY_HUGETLB,
+		VMA_LOCK_RETRY_UFFD,
+		VMA_LOCK_RETRY_WAIT,
+		VMA_LOCK_MADVISE,
+		VMA_LOCK_MADVISE_FALLBACK,
 #endif
 		NR_VM_EVENT_ITEMS
 };
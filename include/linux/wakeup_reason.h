@@ -18,15 +18,39 @@
 #ifndef _LINUX_WAKEUP_REASON_H
 #define _LINUX_WAKEUP_REASON_H
 
+#include <linux/types.h>
+
 #define MAX_SUSPEND_ABORT_LEN 256
 
+/* Phases of a suspend/resume cycle, timed by log_suspend_phase_time() */
+enum suspend_phase {
+	SUSPEND_PHASE_FREEZE,
+	SUSPEND_PHASE_DEVICES,
+	SUSPEND_PHASE_LATE,
+	SUSPEND_PHASE_NOIRQ,
+	SUSPEND_PHASE_SYSCORE,
+	RESUME_PHASE_SYSCORE,
+	RESUME_PHASE_NOIRQ,
+	RESUME_PHASE_EARLY,
+	RESUME_PHASE_DEVICES,
+	RESUME_PHASE_THAW,
+	SUSPEND_PHASE_NR,
+};
+
 #ifdef CONFIG_SUSPEND
+void log_suspend_phase_time(enum suspend_phase phase, u64 start_ns);
+void log_suspend_phase_dev_time(enum suspend_phase phase, const char *name,
+				u64 ns);
 void log_irq_wakeup_reason(int irq);
 void log_threaded_irq_wakeup_reason(int irq, int parent_irq);
 void log_suspend_abort_reason(const char *fmt, ...);
 void log_abnormal_wakeup_reason(const char *fmt, ...);
 void clear_wakeup_reasons(void);
 #else
+static inline void log_suspend_phase_time(enum suspend_phase phase,
+					  u64 start_ns) { }
+static inline void log_suspend_phase_dev_time(enum suspend_phase phase,
+					      const char *name, u64 ns) { }
 static inline void log_irq_wakeup_reason(int irq) { }
 static inline void log_threaded_irq_wakeup_reason(int irq, int parent_irq) { }
 static inline void log_suspend_abort_reason(const char *fmt, ...) { }
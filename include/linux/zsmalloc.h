@@ -36,6 +36,9 @@ enum zs_mapmode {
 struct zs_pool_stats {
 	/* How many pages were migrated (freed) */
 	atomic_long_t pages_compacted;
+	/* Background compaction passes, and the bytes freed by the last one */
+	atomic_long_t bg_compactions;
+	atomic_long_t bg_last_bytes;
 };
 
 struct zs_pool;
@@ -12,9 +12,12 @@ extern atomic_t zswap_stored_pages;
 
 bool zswap_store(struct folio *folio);
 bool zswap_load(struct folio *folio);
+int zswap_entries_present(swp_entry_t swp, int nr);
 void zswap_invalidate(int type, pgoff_t offset);
 void zswap_swapon(int type);
 void zswap_swapoff(int type);
+int zswap_compressor_get(const char *compressor);
+void zswap_compressor_put(const char *compressor);
 
 #else
 
@@ -28,10 +31,22 @@ static inline bool zswap_load(struct folio *folio)
 	return false;
 }
 
+static inline int zswap_entries_present(swp_entry_t swp, int nr)
+{
+	return 0;
+}
+
 static inline void zswap_invalidate(int type, pgoff_t offset) {}
 static inline void zswap_swapon(int type) {}
 static inline void zswap_swapoff(int type) {}
 
+static inline int zswap_compressor_get(const char *compressor)
+{
+	return -ENODEV;
+}
+
+static inline void zswap_compressor_put(const char *compressor) {}
+
 #endif
 
 #endif /* _LINUX_ZSWAP_H */
@@ -328,6 +328,8 @@ struct kernel_param;
 
 int nf_conntrack_set_hashsize(const char *val, const struct kernel_param *kp);
 int nf_conntrack_hash_resize(unsigned int hashsize);
+void nf_conntrack_pcpu_cache_stat(int cpu, unsigned int *hit,
+				  unsigned int *miss);
 
 extern struct hlist_nulls_head *nf_conntrack_hash;
 extern unsigned int nf_conntrack_htable_size;
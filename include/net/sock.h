@@ -337,6 +337,7 @@ struct sk_filter;
   *	@sk_mark: generic packet mark
   *	@sk_cgrp_data: cgroup data for this cgroup
   *	@sk_memcg: this socket's memory cgroup association
+  *	@sk_memcg_reserve: pages charged to @sk_memcg ahead of use
   *	@sk_write_pending: a write to stream socket waits to start
   *	@sk_disconnects: number of disconnect operations performed on this sock
   *	@sk_state_change: callback to indicate change in the state of the sock
@@ -528,6 +529,7 @@ struct sock {
 #endif
 	struct sock_cgroup_data	sk_cgrp_data;
 	struct mem_cgroup	*sk_memcg;
+	int			sk_memcg_reserve;
 	void			(*sk_state_change)(struct sock *sk);
 	void			(*sk_data_ready)(struct sock *sk);
 	void			(*sk_write_space)(struct sock *sk);
@@ -1472,6 +1474,10 @@ sk_memory_allocated(const struct sock *sk)
 #define SK_MEMORY_PCPU_RESERVE (1 << (20 - PAGE_SHIFT))
 extern int sysctl_mem_pcpu_rsv;
 
+/* 64 KB per socket, in page units */
+#define SK_MEMCG_CHARGE_BATCH (1 << (16 - PAGE_SHIFT))
+extern int sysctl_mem_cgroup_charge_batch;
+
 static inline void proto_memory_pcpu_drain(struct proto *proto)
 {
 	int val = this_cpu_xchg(*proto->per_cpu_fw_alloc, 0);
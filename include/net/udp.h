@@ -102,6 +102,11 @@ DECLARE_PER_CPU(int, udp_memory_per_cpu_fw_alloc);
 extern long sysctl_udp_mem[3];
 extern int sysctl_udp_rmem_min;
 extern int sysctl_udp_wmem_min;
+extern int sysctl_udp_gro_auto;
+extern int sysctl_udp_gro_max_segs;
+
+/* Upper bound on the number of datagrams aggregated into one GRO packet */
+#define UDP_GRO_CNT_MAX 64
 
 struct sk_buff;
 
@@ -399,10 +404,18 @@ static inline int copy_linear_skb(struct sk_buff *skb, int len, int off,
 	if (is_udplite) __SNMP_INC_STATS((net)->mib.udplite_statistics, field);         \
 	else		__SNMP_INC_STATS((net)->mib.udp_statistics, field);    }  while(0)
 
+#define __UDP_ADD_STATS(net, field, val, is_udplite)	      do { \
+	if (is_udplite) __SNMP_ADD_STATS((net)->mib.udplite_statistics, field, val); \
+	else		__SNMP_ADD_STATS((net)->mib.udp_statistics, field, val); }  while(0)
+
 #define __UDP6_INC_STATS(net, field, is_udplite)	    do { \
 	if (is_udplite) __SNMP_INC_STATS((net)->mib.udplite_stats_in6, field);\
 	else		__SNMP_INC_STATS((net)->mib.udp_stats_in6, field);  \
 } while(0)
+#define __UDP6_ADD_STATS(net, field, val, is_udplite)	    do { \
+	if (is_udplite) __SNMP_ADD_STATS((net)->mib.udplite_stats_in6, field, val);\
+	else		__SNMP_ADD_STATS((net)->mib.udp_stats_in6, field, val);  \
+} while(0)
 #define UDP6_INC_STATS(net, field, __lite)		    do { \
 	if (__lite) SNMP_INC_STATS((net)->mib.udplite_stats_in6, field);  \
 	else	    SNMP_INC_STATS((net)->mib.udp_stats_in6, field);      \
@@ -348,6 +348,34 @@ DEFINE_EVENT(kcompactd_wake_template, mm_compaction_kcompactd_wake,
 
 	TP_ARGS(nid, order, highest_zoneidx)
 );
+
+TRACE_EVENT(mm_compaction_order_target_miss,
+
+	TP_PROTO(int nid, int order, unsigned long nr_free,
+		 unsigned int target),
+
+	TP_ARGS(nid, order, nr_free, target),
+
+	TP_STRUCT__entry(
+		__field(int, nid)
+		__field(int, order)
+		__field(unsigned long, nr_free)
+		__field(unsigned int, target)
+	),
+
+	TP_fast_assign(
+		__entry->nid = nid;
+		__entry->order = order;
+		__entry->nr_free = nr_free;
+		__entry->target = target;
+	),
+
+	TP_printk("nid=%d order=%d nr_free=%lu target=%u",
+		__entry->nid,
+		__entry->order,
+		__entry->nr_free,
+		__entry->target)
+);
 #endif
 
 #endif /* _TRACE_COMPACTION_H */
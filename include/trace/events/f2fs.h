@@ -114,7 +114,8 @@ TRACE_DEFINE_ENUM(EX_BLOCK_AGE);
 	__print_symbolic(type,						\
 		{ GC_GREEDY,	"Greedy" },				\
 		{ GC_CB,	"Cost-Benefit" },			\
-		{ GC_AT,	"Age-threshold" })
+		{ GC_AT,	"Age-threshold" },			\
+		{ GC_TA,	"Temperature-age" })
 
 #define show_cpreason(type)						\
 	__print_flags(type, "|",					\
@@ -6,6 +6,7 @@
 #define _TRACE_POWER_H
 
 #include <linux/cpufreq.h>
+#include <linux/sched/cpufreq.h>
 #include <linux/ktime.h>
 #include <linux/pm_qos.h>
 #include <linux/tracepoint.h>
@@ -195,6 +196,102 @@ TRACE_EVENT(cpu_frequency_limits,
 		  (unsigned long)__entry->cpu_id)
 );
 
+TRACE_EVENT(sugov_rate_limit,
+
+	TP_PROTO(unsigned int cpu, unsigned int cur_freq, unsigned int next_freq,
+		 s64 delta_ns, s64 delay_ns),
+
+	TP_ARGS(cpu, cur_freq, next_freq, delta_ns, delay_ns),
+
+	TP_STRUCT__entry(
+		__field(u32, cpu_id)
+		__field(u32, cur_freq)
+		__field(u32, next_freq)
+		__field(s64, delta_ns)
+		__field(s64, delay_ns)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu;
+		__entry->cur_freq = cur_freq;
+		__entry->next_freq = next_freq;
+		__entry->delta_ns = delta_ns;
+		__entry->delay_ns = delay_ns;
+	),
+
+	TP_printk("cpu_id=%lu %s cur=%lu next=%lu delta_ns=%lld delay_ns=%lld",
+		  (unsigned long)__entry->cpu_id,
+		  __entry->next_freq > __entry->cur_freq ? "up" : "down",
+		  (unsigned long)__entry->cur_freq,
+		  (unsigned long)__entry->next_freq,
+		  __entry->delta_ns, __entry->delay_ns)
+);
+
+TRACE_DEFINE_ENUM(SUGOV_BOOST_INPUT);
+TRACE_DEFINE_ENUM(SUGOV_BOOST_SCHED_EXT);
+TRACE_DEFINE_ENUM(SUGOV_BOOST_DRIVER);
+
+#define sugov_boost_reason_symbolic(reason)				\
+	__print_symbolic(reason,					\
+		{ SUGOV_BOOST_INPUT,		"input" },		\
+		{ SUGOV_BOOST_SCHED_EXT,	"sched_ext" },		\
+		{ SUGOV_BOOST_DRIVER,		"driver" })
+
+TRACE_EVENT(sugov_boost_request,
+
+	TP_PROTO(const char *name, int reason, unsigned int cpu,
+		 unsigned long util, unsigned int duration_ms),
+
+	TP_ARGS(name, reason, cpu, util, duration_ms),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(int, reason)
+		__field(u32, cpu_id)
+		__field(unsigned long, util)
+		__field(u32, duration_ms)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->reason = reason;
+		__entry->cpu_id = cpu;
+		__entry->util = util;
+		__entry->duration_ms = duration_ms;
+	),
+
+	TP_printk("name=%s reason=%s cpu_id=%lu util=%lu duration_ms=%lu",
+		  __get_str(name), sugov_boost_reason_symbolic(__entry->reason),
+		  (unsigned long)__entry->cpu_id, __entry->util,
+		  (unsigned long)__entry->duration_ms)
+);
+
+TRACE_EVENT(sugov_boost_apply,
+
+	TP_PROTO(int reason, unsigned int cpu, unsigned long util,
+		 unsigned long boost),
+
+	TP_ARGS(reason, cpu, util, boost),
+
+	TP_STRUCT__entry(
+		__field(int, reason)
+		__field(u32, cpu_id)
+		__field(unsigned long, util)
+		__field(unsigned long, boost)
+	),
+
+	TP_fast_assign(
+		__entry->reason = reason;
+		__entry->cpu_id = cpu;
+		__entry->util = util;
+		__entry->boost = boost;
+	),
+
+	TP_printk("reason=%s cpu_id=%lu util=%lu boost=%lu",
+		  sugov_boost_reason_symbolic(__entry->reason),
+		  (unsigned long)__entry->cpu_id, __entry->util, __entry->boost)
+);
+
 TRACE_EVENT(device_pm_callback_start,
 
 	TP_PROTO(struct device *dev, const char *pm_ops, int event),
@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sched_ext
+
+#if !defined(_TRACE_SCHED_EXT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_SCHED_EXT_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+/*
+ * Tracepoint for a task being queued on a non-local or local DSQ:
+ */
+TRACE_EVENT(sched_ext_dsq_enqueue,
+
+	TP_PROTO(struct task_struct *p, u64 dsq_id, u64 enq_flags, bool staged),
+
+	TP_ARGS(p, dsq_id, enq_flags, staged),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	u64,	dsq_id			)
+		__field(	u64,	enq_flags		)
+		__field(	bool,	staged			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->dsq_id		= dsq_id;
+		__entry->enq_flags	= enq_flags;
+		__entry->staged		= staged;
+	),
+
+	TP_printk("comm=%s pid=%d dsq_id=0x%llx enq_flags=0x%llx staged=%d",
+		  __entry->comm, __entry->pid, __entry->dsq_id,
+		  __entry->enq_flags, __entry->staged)
+);
+
+/*
+ * Tracepoint for a CPU moving a task from a non-local DSQ to its local DSQ:
+ */
+TRACE_EVENT(sched_ext_dsq_consume,
+
+	TP_PROTO(struct task_struct *p, u64 dsq_id, int cpu, bool steal),
+
+	TP_ARGS(p, dsq_id, cpu, steal),
+
+	TP_STRUCT__entry(
+		__array(	char,	comm,	TASK_COMM_LEN	)
+		__field(	pid_t,	pid			)
+		__field(	u64,	dsq_id			)
+		__field(	int,	cpu			)
+		__field(	int,	src_cpu			)
+		__field(	bool,	steal			)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+		__entry->pid		= p->pid;
+		__entry->dsq_id		= dsq_id;
+		__entry->cpu		= cpu;
+		__entry->src_cpu	= task_cpu(p);
+		__entry->steal		= steal;
+	),
+
+	TP_printk("comm=%s pid=%d dsq_id=0x%llx cpu=%d src_cpu=%d steal=%d",
+		  __entry->comm, __entry->pid, __entry->dsq_id,
+		  __entry->cpu, __entry->src_cpu, __entry->steal)
+);
+
+/*
+ * Tracepoint for the default CPU selection picking an idle CPU:
+ */
+TRACE_EVENT(sched_ext_select_cluster,
+
+	TP_PROTO(struct task_struct *p, int prev_cid, int cid, int cpu,
+		 unsigned long demand_scaled),
+
+	TP_ARGS(p, prev_cid, cid, cpu, demand_scaled),
+
+	TP_STRUCT__entry(
+		__field(	pid_t,		pid		)
+		__field(	int,		prev_cid	)
+		__field(	int,		cid		)
+		__field(	int,		cpu		)
+		__field(	unsigned long,	demand_scaled	)
+	),
+
+	TP_fast_assign(
+		__entry->pid		= p->pid;
+		__entry->prev_cid	= prev_cid;
+		__entry->cid		= cid;
+		__entry->cpu		= cpu;
+		__entry->demand_scaled	= demand_scaled;
+	),
+
+	TP_printk("pid=%d prev_cid=%d cid=%d cpu=%d demand_scaled=%lu",
+		  __entry->pid, __entry->prev_cid, __entry->cid,
+		  __entry->cpu, __entry->demand_scaled)
+);
+
+/*
+ * Tracepoint for a CPU starting a new load tracking window:
+ */
+TRACE_EVENT(sched_ext_window_rollover,
+
+	TP_PROTO(int cpu, u64 window_start, u32 window_size,
+		 u64 prev_runnable_sum),
+
+	TP_ARGS(cpu, window_start, window_size, prev_runnable_sum),
+
+	TP_STRUCT__entry(
+		__field(	int,	cpu			)
+		__field(	u64,	window_start		)
+		__field(	u32,	window_size		)
+		__field(	u64,	prev_runnable_sum	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu			= cpu;
+		__entry->window_start		= window_start;
+		__entry->window_size		= window_size;
+		__entry->prev_runnable_sum	= prev_runnable_sum;
+	),
+
+	TP_printk("cpu=%d window_start=%llu window_size=%u prev_runnable_sum=%llu",
+		  __entry->cpu, __entry->window_start, __entry->window_size,
+		  __entry->prev_runnable_sum)
+);
+
+/*
+ * Tracepoint for schedutil using the ext window utilization:
+ */
+TRACE_EVENT(sched_ext_gov_util,
+
+	TP_PROTO(int cpu, unsigned long scx_util, unsigned long util),
+
+	TP_ARGS(cpu, scx_util, util),
+
+	TP_STRUCT__entry(
+		__field(	int,		cpu		)
+		__field(	unsigned long,	scx_util	)
+		__field(	unsigned long,	util		)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->scx_util	= scx_util;
+		__entry->util		= util;
+	),
+
+	TP_printk("cpu=%d scx_util=%lu util=%lu",
+		  __entry->cpu, __entry->scx_util, __entry->util)
+);
+
+#endif /* _TRACE_SCHED_EXT_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -129,6 +129,34 @@ TRACE_EVENT(ufshcd_clk_scaling,
 		__entry->prev_state, __entry->curr_state)
 );
 
+TRACE_EVENT(ufshcd_clk_scaling_reason,
+
+	TP_PROTO(const char *dev_name, const char *state, const char *reason,
+		 int active_reqs, u64 read_bytes),
+
+	TP_ARGS(dev_name, state, reason, active_reqs, read_bytes),
+
+	TP_STRUCT__entry(
+		__string(dev_name, dev_name)
+		__string(state, state)
+		__string(reason, reason)
+		__field(int, active_reqs)
+		__field(u64, read_bytes)
+	),
+
+	TP_fast_assign(
+		__assign_str(dev_name, dev_name);
+		__assign_str(state, state);
+		__assign_str(reason, reason);
+		__entry->active_reqs = active_reqs;
+		__entry->read_bytes = read_bytes;
+	),
+
+	TP_printk("%s: %s: %s, active_reqs %d, read_bytes %llu",
+		__get_str(dev_name), __get_str(state), __get_str(reason),
+		__entry->active_reqs, __entry->read_bytes)
+);
+
 TRACE_EVENT(ufshcd_auto_bkops_state,
 
 	TP_PROTO(const char *dev_name, const char *state),
@@ -823,8 +823,23 @@ __SYSCALL(__NR_cachestat, sys_cachestat)
 #define __NR_fchmodat2 452
 __SYSCALL(__NR_fchmodat2, sys_fchmodat2)
 
+#define __NR_map_shadow_stack 453
+__SYSCALL(__NR_map_shadow_stack, sys_map_shadow_stack)
+
+#define __NR_futex_wake 454
+__SYSCALL(__NR_futex_wake, sys_futex_wake)
+#define __NR_futex_wait 455
+__SYSCALL(__NR_futex_wait, sys_futex_wait)
+
+/*
+ * Not an upstream syscall: kept well above the numbers upstream hands out
+ * in order, so that backported syscalls keep their upstream numbers.
+ */
+#define __NR_finit_module_batch 500
+__SYSCALL(__NR_finit_module_batch, sys_finit_module_batch)
+
 #undef __NR_syscalls
-#define __NR_syscalls 453
+#define __NR_syscalls 501
 
 /*
  * 32 bit systems traditionally used different
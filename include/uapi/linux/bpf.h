@@ -633,6 +633,19 @@ union bpf_iter_link_info {
  *			returning the lock. This must be specified if the
  *			elements contain a spinlock.
  *
+ *		For **BPF_MAP_TYPE_PERCPU_HASH** and
+ *		**BPF_MAP_TYPE_LRU_PERCPU_HASH** maps whose values are arrays
+ *		of u64 counters, the *flags* argument may be a combination of:
+ *
+ *		**BPF_F_BATCH_RESET**
+ *			Atomically exchange every counter with zero while
+ *			reading it, so that the keys stay in the map and no
+ *			concurrent atomic increment is lost.
+ *
+ *		**BPF_F_BATCH_AGGREGATE**
+ *			Return the sum over all CPUs for each key, i.e. one
+ *			value per key instead of one per possible CPU.
+ *
  *		On success, *count* elements from the map are copied into the
  *		user buffer, with the keys copied into *keys* and the values
  *		copied into the corresponding indices in *values*.
@@ -1276,6 +1289,12 @@ enum {
 	BPF_F_LOCK	= 4, /* spin_lock-ed map_lookup/map_update */
 };
 
+/* flags for BPF_MAP_LOOKUP_BATCH on per-CPU hash maps */
+enum {
+	BPF_F_BATCH_RESET	= (1U << 0), /* zero counters while reading */
+	BPF_F_BATCH_AGGREGATE	= (1U << 1), /* sum counters over all CPUs */
+};
+
 /* flags for BPF_MAP_CREATE command */
 enum {
 	BPF_F_NO_PREALLOC	= (1U << 0),
@@ -1320,6 +1339,11 @@ enum {
 
 /* Get path from provided FD in BPF_OBJ_PIN/BPF_OBJ_GET commands */
 	BPF_F_PATH_FD		= (1U << 14),
+
+/* Ring buffer overwrites its oldest records instead of dropping new ones.
+ * Bits 15 to 18 are taken by later upstream flags.
+ */
+	BPF_F_RB_OVERWRITE	= (1U << 19),
 };
 
 /* Flags for BPF_PROG_QUERY. */
@@ -4432,6 +4456,13 @@ union bpf_attr {
  *		* **BPF_RB_RING_SIZE**: The size of ring buffer.
  *		* **BPF_RB_CONS_POS**: Consumer position (can wrap around).
  *		* **BPF_RB_PROD_POS**: Producer(s) position (can wrap around).
+ *		* **BPF_RB_OVERWRITE_POS**: Position of the oldest record not
+ *		  yet overwritten (can wrap around). Only meaningful for ring
+ *		  buffers created with **BPF_F_RB_OVERWRITE**.
+ *		* **BPF_RB_DROPPED**: Number of records that could not be
+ *		  reserved because the ring buffer was full or contended.
+ *		* **BPF_RB_OVERWRITTEN**: Number of committed records that
+ *		  were overwritten before being consumed.
  *
  *		Data returned is just a momentary snapshot of actual values
  *		and could be inaccurate, so this facility should be used to
@@ -6026,6 +6057,9 @@ enum {
 	BPF_RB_RING_SIZE = 1,
 	BPF_RB_CONS_POS = 2,
 	BPF_RB_PROD_POS = 3,
+	BPF_RB_OVERWRITE_POS = 4,
+	BPF_RB_DROPPED = 5,
+	BPF_RB_OVERWRITTEN = 6,
 };
 
 /* BPF ring buffer constants */
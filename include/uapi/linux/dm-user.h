@@ -7,6 +7,7 @@
 #ifndef _LINUX_DM_USER_H
 #define _LINUX_DM_USER_H
 
+#include <linux/ioctl.h>
 #include <linux/types.h>
 
 /*
@@ -65,4 +66,66 @@ struct dm_user_message {
 	__u8 buf[];
 };
 
+/*
+ * Ring mode.  Instead of one message per read()/write(), a channel can set
+ * up a shared-memory ring with DM_USER_IOC_RING_SETUP and mmap() it (offset
+ * 0, mmap_size bytes).  The kernel posts requests at req_tail and userspace
+ * consumes them from req_head; userspace posts completions at cmp_tail and
+ * the kernel consumes them from cmp_head.  Indices are free-running and
+ * taken modulo nr_entries.
+ *
+ * Each request with data owns a contiguous part of the data area, starting
+ * data_off bytes into the mapping.  Write data is there when the request is
+ * posted; read data has to be there when the completion is posted.  The
+ * area is free again once the completion has been consumed.
+ *
+ * DM_USER_IOC_RING_ENTER consumes all posted completions, then posts as
+ * many new requests as fit, and returns how many it posted.  With
+ * DM_USER_RING_ENTER_WAIT it sleeps until at least one can be posted.  Once
+ * a ring is set up, read() and write() fail on that channel.
+ */
+struct dm_user_ring {
+	__u32 req_head;
+	__u32 req_tail;
+	__u32 cmp_head;
+	__u32 cmp_tail;
+	__u32 nr_entries;
+	__u32 nr_slots;
+	__u32 slot_size;
+	__u32 __pad;
+	__u64 req_off;
+	__u64 cmp_off;
+	__u64 data_off;
+};
+
+struct dm_user_ring_req {
+	__u64 seq;
+	__u64 type;
+	__u64 flags;
+	__u64 sector;
+	__u64 len;
+	__u64 data_off;
+};
+
+struct dm_user_ring_cmp {
+	__u64 seq;
+	__u64 result;	/* DM_USER_RESP_* */
+};
+
+struct dm_user_ring_setup {
+	__u32 nr_entries;	/* power of two */
+	__u32 nr_slots;		/* data area slots */
+	__u32 slot_size;	/* power of two, at least PAGE_SIZE */
+	__u32 flags;		/* must be 0 */
+	__u64 mmap_size;	/* out */
+};
+
+#define DM_USER_RING_ENTER_WAIT 0x1
+
+/* DM's ioctl type, above the numbers used by DM itself */
+#define DM_USER_IOC_MAGIC 0xfd
+#define DM_USER_IOC_RING_SETUP _IOWR(DM_USER_IOC_MAGIC, 0x80, struct dm_user_ring_setup)
+/* The argument is DM_USER_RING_ENTER_* flags, passed by value */
+#define DM_USER_IOC_RING_ENTER _IO(DM_USER_IOC_MAGIC, 0x81)
+
 #endif
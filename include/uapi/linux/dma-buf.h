@@ -167,6 +167,59 @@ struct dma_buf_import_sync_file {
 	__s32 fd;
 };
 
+/**
+ * DOC: DMA-BUF aggregated statistics
+ *
+ * ``/sys/kernel/dmabuf/stats`` is a binary snapshot of the live DMA-BUFs,
+ * summed per exporter and per exporting process. It is read in one go and
+ * consists of a &struct dma_buf_stats_header, immediately followed by
+ * @nr_exporters &struct dma_buf_stats_exporter records and @nr_processes
+ * &struct dma_buf_stats_process records.
+ */
+#define DMA_BUF_STATS_MAGIC	0x64627374	/* "dbst" */
+#define DMA_BUF_STATS_VERSION	1
+#define DMA_BUF_STATS_NAME_LEN	32
+
+/**
+ * struct dma_buf_stats_header - header of the aggregated statistics
+ */
+struct dma_buf_stats_header {
+	/** @magic: DMA_BUF_STATS_MAGIC */
+	__u32 magic;
+	/** @version: DMA_BUF_STATS_VERSION */
+	__u32 version;
+	/** @nr_exporters: number of exporter records */
+	__u32 nr_exporters;
+	/** @nr_processes: number of process records */
+	__u32 nr_processes;
+};
+
+/**
+ * struct dma_buf_stats_exporter - live buffers of one exporter
+ */
+struct dma_buf_stats_exporter {
+	/** @name: exporter name, NUL terminated and possibly truncated */
+	char name[DMA_BUF_STATS_NAME_LEN];
+	/** @count: number of buffers */
+	__u64 count;
+	/** @size: total size of the buffers in bytes */
+	__u64 size;
+};
+
+/**
+ * struct dma_buf_stats_process - live buffers exported by one process
+ */
+struct dma_buf_stats_process {
+	/** @tgid: thread group id of the process that exported the buffers */
+	__s32 tgid;
+	/** @pad: must be zero */
+	__u32 pad;
+	/** @count: number of buffers */
+	__u64 count;
+	/** @size: total size of the buffers in bytes */
+	__u64 size;
+};
+
 #define DMA_BUF_BASE		'b'
 #define DMA_BUF_IOCTL_SYNC	_IOW(DMA_BUF_BASE, 0, struct dma_buf_sync)
 
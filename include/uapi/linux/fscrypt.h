@@ -131,6 +131,7 @@ struct fscrypt_add_key_arg {
 	__u32 __reserved[7];
 	/* N.B.: "temporary" flag, not reserved upstream */
 #define __FSCRYPT_ADD_KEY_FLAG_HW_WRAPPED		0x00000001
+#define __FSCRYPT_ADD_KEY_FLAG_PIN_INLINE_KEYS		0x00000002
 	__u32 __flags;
 	__u8 raw[];
 };
@@ -1180,4 +1180,33 @@ struct fuse_supp_groups {
 	uint32_t	groups[];
 };
 
+/**
+ * enum fuse_uring_cmd - io_uring command opcodes on /dev/fuse
+ * @FUSE_IO_URING_CMD_FETCH: park the buffer until a request is available,
+ *	the CQE result is the request length as for read()
+ * @FUSE_IO_URING_CMD_COMMIT_AND_FETCH: send the reply held at the start of
+ *	the buffer as for write(), then reuse the buffer for the next request
+ */
+enum fuse_uring_cmd {
+	FUSE_IO_URING_CMD_INVALID		= 0,
+	FUSE_IO_URING_CMD_FETCH			= 1,
+	FUSE_IO_URING_CMD_COMMIT_AND_FETCH	= 2,
+};
+
+/**
+ * struct fuse_uring_cmd_req - payload of a 128 byte SQE for fuse commands
+ * @buf: address of the request/reply buffer
+ * @buf_len: size of the buffer
+ * @reply_len: length of the reply, for FUSE_IO_URING_CMD_COMMIT_AND_FETCH
+ * @qid: queue to park on, commands are handed requests from their own cpu
+ *	queue first
+ */
+struct fuse_uring_cmd_req {
+	uint64_t	buf;
+	uint32_t	buf_len;
+	uint32_t	reply_len;
+	uint16_t	qid;
+	uint16_t	padding[3];
+};
+
 #endif /* _LINUX_FUSE_H */
@@ -65,6 +65,8 @@ struct io_uring_sqe {
 		__u32		xattr_flags;
 		__u32		msg_ring_flags;
 		__u32		uring_cmd_flags;
+		__u32		waitid_flags;
+		__u32		futex_flags;
 	};
 	__u64	user_data;	/* data to be passed back at completion time */
 	/* pack this to avoid bogus arm OABI complaints */
@@ -190,6 +192,24 @@ enum {
  */
 #define IORING_SETUP_NO_SQARRAY		(1U << 16)
 
+/*
+ * SQPOLL: keep the SQ thread spinning for about twice the ring's average
+ * time between submissions, with sq_thread_idle as the upper bound.
+ */
+#define IORING_SETUP_SQ_IDLE_ADAPTIVE	(1U << 17)
+
+/*
+ * SQPOLL with SQ_AFF: share the SQ thread of sq_thread_cpu with the other
+ * rings the process has set up with this flag on that CPU.
+ */
+#define IORING_SETUP_SQ_SHARED		(1U << 18)
+
+/*
+ * Keep per-opcode submission, completion and latency statistics, shown in
+ * the ring's fdinfo.
+ */
+#define IORING_SETUP_OP_STATS		(1U << 19)
+
 enum io_uring_op {
 	IORING_OP_NOP,
 	IORING_OP_READV,
@@ -240,6 +260,10 @@ enum io_uring_op {
 	IORING_OP_URING_CMD,
 	IORING_OP_SEND_ZC,
 	IORING_OP_SENDMSG_ZC,
+	IORING_OP_WAITID,
+	IORING_OP_FUTEX_WAIT,
+	IORING_OP_FUTEX_WAKE,
+	IORING_OP_FUTEX_WAITV,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
@@ -336,11 +360,21 @@ enum io_uring_op {
  *				0 is reported if zerocopy was actually possible.
  *				IORING_NOTIF_USAGE_ZC_COPIED if data was copied
  *				(at least partially).
+ *
+ * IORING_SEND_ZC_COALESCE	If set, SEND[MSG]_ZC shares one notification
+ *				with the other coalesced sends of the ring.
+ *				The batch is closed by the first send issued
+ *				without this flag, or once it holds notif_batch
+ *				sends (see IORING_REGISTER_SEND_ZC). Only the
+ *				closing send sets IORING_CQE_F_MORE, and the
+ *				notification carries its user_data and covers
+ *				the buffers of every send in the batch.
  */
 #define IORING_RECVSEND_POLL_FIRST	(1U << 0)
 #define IORING_RECV_MULTISHOT		(1U << 1)
 #define IORING_RECVSEND_FIXED_BUF	(1U << 2)
 #define IORING_SEND_ZC_REPORT_USAGE	(1U << 3)
+#define IORING_SEND_ZC_COALESCE		(1U << 4)
 
 /*
  * cqe.res for IORING_CQE_F_NOTIF if
@@ -397,11 +431,16 @@ struct io_uring_cqe {
  * IORING_CQE_F_SOCK_NONEMPTY	If set, more data to read after socket recv
  * IORING_CQE_F_NOTIF	Set for notification CQEs. Can be used to distinct
  * 			them from sends.
+ * IORING_CQE_F_BUF_MORE	If set, the buffer ID set in the upper 16 bits
+ *			was only partly used and stays at the head of its
+ *			incrementally consumed buffer ring; the next
+ *			completion using it continues where this one ended.
  */
 #define IORING_CQE_F_BUFFER		(1U << 0)
 #define IORING_CQE_F_MORE		(1U << 1)
 #define IORING_CQE_F_SOCK_NONEMPTY	(1U << 2)
 #define IORING_CQE_F_NOTIF		(1U << 3)
+#define IORING_CQE_F_BUF_MORE		(1U << 4)
 
 enum {
 	IORING_CQE_BUFFER_SHIFT		= 16,
@@ -546,6 +585,12 @@ enum {
 	/* register a range of fixed file slots for automatic slot allocation */
 	IORING_REGISTER_FILE_ALLOC_RANGE	= 25,
 
+	/* set io-wq thread affinity policy */
+	IORING_REGISTER_IOWQ_AFF_POLICY		= 26,
+
+	/* zerocopy send copy threshold and notification batching */
+	IORING_REGISTER_SEND_ZC			= 27,
+
 	/* this goes last */
 	IORING_REGISTER_LAST,
 
@@ -559,6 +604,28 @@ enum {
 	IO_WQ_UNBOUND,
 };
 
+/* io-wq affinity policies, see struct io_uring_iowq_aff_policy */
+enum {
+	/* workers may run on the IORING_REGISTER_IOWQ_AFF mask, or anywhere */
+	IORING_IOWQ_AFF_NONE,
+	/* workers follow the cluster (CPUs of equal capacity) of the submitter */
+	IORING_IOWQ_AFF_SUBMITTER,
+	/* workers run on CPUs with at least min_capacity */
+	IORING_IOWQ_AFF_CAPACITY,
+};
+
+struct io_uring_iowq_aff_policy {
+	__u32	policy;
+	__u32	min_capacity;	/* IORING_IOWQ_AFF_CAPACITY, out of 1024 */
+	__u64	resv[2];
+};
+
+struct io_uring_send_zc_opts {
+	__u32	copy_thresh;	/* sends shorter than this are copied */
+	__u32	notif_batch;	/* max sends per coalesced notification */
+	__u64	resv[3];
+};
+
 /* deprecated, see struct io_uring_rsrc_update */
 struct io_uring_files_update {
 	__u32 offset;
@@ -658,9 +725,14 @@ struct io_uring_buf_ring {
  *			mmap(2) with the offset set as:
  *			IORING_OFF_PBUF_RING | (bgid << IORING_OFF_PBUF_SHIFT)
  *			to get a virtual mapping for the ring.
+ * IOU_PBUF_RING_INC:	If set, buffers are consumed incrementally: a
+ *			completion that uses only part of a buffer leaves the
+ *			rest of it at the head of the ring, with its addr and
+ *			len advanced, and sets IORING_CQE_F_BUF_MORE.
  */
 enum {
 	IOU_PBUF_RING_MMAP	= 1,
+	IOU_PBUF_RING_INC	= 2,
 };
 
 /* argument for IORING_(UN)REGISTER_PBUF_RING */
@@ -81,6 +81,31 @@ struct loop_config {
 	__u64			__reserved[8];
 };
 
+/**
+ * struct loop_batch_entry - One loop device in a LOOP_CTL_CONFIGURE_BATCH call.
+ * @index: loop device number, or -1 to use a free one. The number used is
+ *	   written back.
+ * @error: 0 or a negative errno, written back.
+ * @config: configuration to apply, as for LOOP_CONFIGURE.
+ */
+struct loop_batch_entry {
+	__s32			index;
+	__s32			error;
+	struct loop_config	config;
+};
+
+/**
+ * struct loop_batch - Argument of LOOP_CTL_CONFIGURE_BATCH.
+ * @nr: number of entries.
+ * @flags: must be 0.
+ * @entries: user pointer to an array of @nr struct loop_batch_entry.
+ */
+struct loop_batch {
+	__u32			nr;
+	__u32			flags;
+	__u64			entries;
+};
+
 /*
  * Loop filter types
  */
@@ -117,4 +142,5 @@ struct loop_config {
 #define LOOP_CTL_ADD		0x4C80
 #define LOOP_CTL_REMOVE		0x4C81
 #define LOOP_CTL_GET_FREE	0x4C82
+#define LOOP_CTL_CONFIGURE_BATCH	0x4C83
 #endif /* _UAPI_LINUX_LOOP_H */
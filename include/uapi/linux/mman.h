@@ -42,6 +42,17 @@
 #define MAP_HUGE_2GB	HUGETLB_FLAG_ENCODE_2GB
 #define MAP_HUGE_16GB	HUGETLB_FLAG_ENCODE_16GB
 
+/* process_madvise() flags */
+#define PMADV_ASYNC		0x01	/* queue the ranges, return an fd */
+
+/* Read from the fd returned by an async process_madvise() */
+struct pmadv_async_result {
+	__u64 nr_bytes;		/* length of the ranges that were handled */
+	__u64 nr_reclaimed;	/* bytes reclaimed by MADV_PAGEOUT */
+	__s32 error;		/* first error, or 0 */
+	__u32 __pad;
+};
+
 struct cachestat_range {
 	__u64 off;
 	__u64 len;
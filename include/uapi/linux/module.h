@@ -7,4 +7,17 @@
 #define MODULE_INIT_IGNORE_VERMAGIC	2
 #define MODULE_INIT_COMPRESSED_FILE	4
 
+#include <linux/types.h>
+
+/*
+ * One module of a sys_finit_module_batch() call. @uargs points to the
+ * module parameter string, which must be NUL terminated (it may be empty).
+ * @ret is filled in with the result of loading this module.
+ */
+struct module_batch_entry {
+	__s32	fd;
+	__s32	ret;
+	__u64	uargs;
+};
+
 #endif /* _UAPI_LINUX_MODULE_H */
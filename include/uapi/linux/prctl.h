@@ -306,4 +306,22 @@ struct prctl_mm_map {
 # define PR_RISCV_V_VSTATE_CTRL_NEXT_MASK	0xc
 # define PR_RISCV_V_VSTATE_CTRL_MASK		0x1f
 
+/*
+ * Leave page cache ptes of private file mappings unpopulated in fork()
+ * children. Vendor option: like PR_SET_VMA it uses an ASCII tag rather than
+ * the next upstream number, so that it can't collide with later upstream
+ * options.
+ */
+#define PR_SET_FORK_LAZY_PTES		0x534c5a50	/* "SLZP" */
+#define PR_GET_FORK_LAZY_PTES		0x474c5a50	/* "GLZP" */
+
+/*
+ * Size of the process private futex hash table. Vendor option with an ASCII
+ * tag, see PR_SET_FORK_LAZY_PTES; upstream assigns its own number to its
+ * PR_FUTEX_HASH.
+ */
+#define PR_FUTEX_HASH			0x46555448	/* "FUTH" */
+# define PR_FUTEX_HASH_SET_SLOTS	1
+# define PR_FUTEX_HASH_GET_SLOTS	2
+
 #endif /* _LINUX_PRCTL_H */
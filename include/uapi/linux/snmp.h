@@ -164,6 +164,8 @@ enum
 	UDP_MIB_CSUMERRORS,			/* InCsumErrors */
 	UDP_MIB_IGNOREDMULTI,			/* IgnoredMulti */
 	UDP_MIB_MEMERRORS,			/* MemErrors */
+	UDP_MIB_GROPKTS,			/* GroPkts */
+	UDP_MIB_GROSEGS,			/* GroSegs */
 	__UDP_MIB_MAX
 };
 
@@ -204,6 +204,25 @@ struct taskstats {
 	__u64    irq_delay_total;
 };
 
+/*
+ * Per-process memory snapshot, one for each live process named in a
+ * TASKSTATS_CMD_ATTR_TGID_LIST request, in request order.  Processes that
+ * have exited are left out.  Sizes are in bytes, times in nanoseconds, and
+ * memcg_ino is the cgroup inode number of the process's memory cgroup.
+ */
+struct taskstats_mem {
+	__u32	tgid;
+	__s16	oom_score_adj;
+	__u16	__pad;
+	__u64	rss_anon;
+	__u64	rss_file;
+	__u64	rss_shmem;
+	__u64	swap;
+	__u64	memcg_ino;
+	__u64	utime;
+	__u64	stime;
+};
+
 
 /*
  * Commands sent from userspace
@@ -228,6 +247,7 @@ enum {
 	TASKSTATS_TYPE_AGGR_PID,	/* contains pid + stats */
 	TASKSTATS_TYPE_AGGR_TGID,	/* contains tgid + stats */
 	TASKSTATS_TYPE_NULL,		/* contains nothing */
+	TASKSTATS_TYPE_MEM_LIST,	/* array of struct taskstats_mem */
 	__TASKSTATS_TYPE_MAX,
 };
 
@@ -239,6 +259,7 @@ enum {
 	TASKSTATS_CMD_ATTR_TGID,
 	TASKSTATS_CMD_ATTR_REGISTER_CPUMASK,
 	TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK,
+	TASKSTATS_CMD_ATTR_TGID_LIST,	/* array of __u32 tgids */
 	__TASKSTATS_CMD_ATTR_MAX,
 };
 
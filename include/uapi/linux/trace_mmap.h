@@ -23,4 +23,12 @@ struct ring_buffer_meta {
 	} reader_page;
 };
 
+/*
+ * Swap in the next reader page of a mapped trace_pipe_raw file, once the
+ * current one has been consumed. Blocks until data is available unless the
+ * file was opened with O_NONBLOCK. The new reader page ID is in
+ * ring_buffer_meta.reader_page.id.
+ */
+#define TRACE_MMAP_IOCTL_GET_READER		_IO('T', 0x1)
+
 #endif /* _UAPI_TRACE_MMAP_H_ */
@@ -84,6 +84,8 @@
 #define	UBLK_IO_FETCH_REQ		0x20
 #define	UBLK_IO_COMMIT_AND_FETCH_REQ	0x21
 #define	UBLK_IO_NEED_GET_DATA	0x22
+#define	UBLK_IO_REGISTER_IO_BUF		0x23
+#define	UBLK_IO_UNREGISTER_IO_BUF	0x24
 
 /* Any new IO command should encode by __IOWR() */
 #define	UBLK_U_IO_FETCH_REQ		\
@@ -92,6 +94,10 @@
 	_IOWR('u', UBLK_IO_COMMIT_AND_FETCH_REQ, struct ublksrv_io_cmd)
 #define	UBLK_U_IO_NEED_GET_DATA		\
 	_IOWR('u', UBLK_IO_NEED_GET_DATA, struct ublksrv_io_cmd)
+#define	UBLK_U_IO_REGISTER_IO_BUF	\
+	_IOWR('u', UBLK_IO_REGISTER_IO_BUF, struct ublksrv_io_cmd)
+#define	UBLK_U_IO_UNREGISTER_IO_BUF	\
+	_IOWR('u', UBLK_IO_UNREGISTER_IO_BUF, struct ublksrv_io_cmd)
 
 /* only ABORT means that no re-fetch */
 #define UBLK_IO_RES_OK			0
@@ -125,8 +131,12 @@
 #define UBLKSRV_IO_BUF_TOTAL_SIZE	(1ULL << UBLKSRV_IO_BUF_TOTAL_BITS)
 
 /*
- * zero copy requires 4k block size, and can remap ublk driver's io
- * request into ublksrv's vm space
+ * Zero copy: ublksrv doesn't provide io buffers. Instead it registers the
+ * pages of request @tag as fixed buffer @addr of its io_uring with
+ * UBLK_U_IO_REGISTER_IO_BUF, uses that buffer index for backing file or
+ * socket io, and drops it with UBLK_U_IO_UNREGISTER_IO_BUF. Data can
+ * still be copied with read()/write() on the char device as with
+ * UBLK_F_USER_COPY.
  */
 #define UBLK_F_SUPPORT_ZERO_COPY	(1ULL << 0)
 
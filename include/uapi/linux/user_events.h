@@ -67,6 +67,43 @@ struct user_unreg {
 	__u64	disable_addr;
 } __attribute__((__packed__));
 
+/*
+ * Describes a staging buffer, passed to the DIAG_IOCSSTAGE ioctl. Events are
+ * appended to the buffer without a syscall and the kernel writes them out
+ * on DIAG_IOCSFLUSH, on the next write() to the file and periodically.
+ */
+struct user_stage {
+	/* Input: Size of the user_stage structure being used */
+	__u32	size;
+
+	/* Input: Size of the buffer in bytes, a power of two of pages */
+	__u32	stage_size;
+
+	/* Input: Page aligned address of the buffer */
+	__u64	stage_addr;
+} __attribute__((__packed__));
+
+/*
+ * Start of a staging buffer, followed by the record area. head and tail are
+ * free running byte counts into the record area. Each record is a __u32
+ * length followed by that many bytes, laid out like a write() to the file
+ * (the write_index then the payload), padded to 8 bytes. A record never
+ * wraps; a zero length tells the kernel to skip to the start of the area.
+ */
+struct user_stage_header {
+	/* Written by user space after appending a record */
+	__u32	head;
+
+	/* Written by the kernel after writing out records */
+	__u32	tail;
+
+	/* Written by the kernel: records that could not be written */
+	__u32	dropped;
+
+	/* Reserved, set to 0 */
+	__u32	__reserved;
+};
+
 #define DIAG_IOC_MAGIC '*'
 
 /* Request to register a user_event */
@@ -78,4 +115,10 @@ struct user_unreg {
 /* Requests to unregister a user_event */
 #define DIAG_IOCSUNREG _IOW(DIAG_IOC_MAGIC, 2, struct user_unreg*)
 
+/* Request to register a staging buffer */
+#define DIAG_IOCSSTAGE _IOW(DIAG_IOC_MAGIC, 3, struct user_stage *)
+
+/* Request to write out all staging buffers of the file */
+#define DIAG_IOCSFLUSH _IO(DIAG_IOC_MAGIC, 4)
+
 #endif /* _UAPI_LINUX_USER_EVENTS_H */
@@ -14,6 +14,8 @@
 #include "fdinfo.h"
 #include "cancel.h"
 #include "rsrc.h"
+#include "tctx.h"
+#include "opdef.h"
 
 #ifdef CONFIG_PROC_FS
 static __cold int io_uring_show_cred(struct seq_file *m, unsigned int id,
@@ -46,6 +48,45 @@ static __cold int io_uring_show_cred(struct seq_file *m, unsigned int id,
 	return 0;
 }
 
+/*
+ * One line per opcode seen. lat_hist holds IO_OP_LAT_BUCKETS counts: below
+ * 1us, below 2us, below 4us, ... and the rest.
+ */
+static __cold void io_uring_show_op_stats(struct seq_file *m,
+					  struct io_ring_ctx *ctx)
+{
+	struct io_op_stats sum;
+	int op, cpu, b;
+
+	seq_puts(m, "OpStats:\n");
+	for (op = 0; op < IORING_OP_LAST; op++) {
+		memset(&sum, 0, sizeof(sum));
+		for_each_possible_cpu(cpu) {
+			struct io_op_stats *st = per_cpu_ptr(ctx->op_stats, cpu) + op;
+
+			sum.submitted += st->submitted;
+			sum.inline_done += st->inline_done;
+			sum.punted += st->punted;
+			sum.poll_armed += st->poll_armed;
+			sum.completed += st->completed;
+			sum.lat_sum_ns += st->lat_sum_ns;
+			for (b = 0; b < IO_OP_LAT_BUCKETS; b++)
+				sum.lat_hist[b] += st->lat_hist[b];
+		}
+		if (!sum.submitted)
+			continue;
+
+		seq_printf(m, "  %s: submitted=%llu inline=%llu punted=%llu poll=%llu completed=%llu avg_lat_us=%llu lat_hist=",
+			   io_uring_get_opcode(op), sum.submitted,
+			   sum.inline_done, sum.punted, sum.poll_armed,
+			   sum.completed, sum.completed ?
+			   div64_u64(sum.lat_sum_ns, sum.completed) / NSEC_PER_USEC : 0);
+		for (b = 0; b < IO_OP_LAT_BUCKETS; b++)
+			seq_printf(m, b ? ",%llu" : "%llu", sum.lat_hist[b]);
+		seq_putc(m, '\n');
+	}
+}
+
 /*
  * Caller holds a reference to the file already, we don't need to do
  * anything else to get an extra reference.
@@ -160,6 +201,10 @@ __cold void io_uring_show_fdinfo(struct seq_file *m, struct file *f)
 		else
 			seq_printf(m, "%5u: <none>\n", i);
 	}
+	seq_printf(m, "SendZc:\tsends=%lu notifs=%lu copied=%ld batch=%u copy_thresh=%u\n",
+		   ctx->zc_tx.nr_sends, ctx->zc_tx.nr_notifs,
+		   atomic_long_read(&ctx->zc_tx.nr_copied),
+		   ctx->zc_tx.notif_batch, READ_ONCE(ctx->zc_tx.copy_thresh));
 	seq_printf(m, "UserBufs:\t%u\n", ctx->nr_user_bufs);
 	for (i = 0; has_lock && i < ctx->nr_user_bufs; i++) {
 		struct io_mapped_ubuf *buf = ctx->user_bufs[i];
@@ -175,6 +220,16 @@ __cold void io_uring_show_fdinfo(struct seq_file *m, struct file *f)
 		xa_for_each(&ctx->personalities, index, cred)
 			io_uring_show_cred(m, index, cred);
 	}
+	if (has_lock) {
+		struct io_tctx_node *node;
+
+		list_for_each_entry(node, &ctx->tctx_list, ctx_node) {
+			struct io_uring_task *tctx = node->task->io_uring;
+
+			if (tctx && tctx->io_wq)
+				io_wq_show_fdinfo(m, tctx->io_wq);
+		}
+	}
 
 	seq_puts(m, "PollList:\n");
 	for (i = 0; i < (1U << ctx->cancel_table.hash_bits); i++) {
@@ -198,6 +253,9 @@ __cold void io_uring_show_fdinfo(struct seq_file *m, struct file *f)
 	if (has_lock)
 		mutex_unlock(&ctx->uring_lock);
 
+	if (ctx->flags & IORING_SETUP_OP_STATS)
+		io_uring_show_op_stats(m, ctx);
+
 	seq_puts(m, "CqOverflowList:\n");
 	spin_lock(&ctx->completion_lock);
 	list_for_each_entry(ocqe, &ctx->cq_overflow_list, list) {
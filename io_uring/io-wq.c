@@ -16,6 +16,8 @@
 #include <linux/task_work.h>
 #include <linux/audit.h>
 #include <linux/mmu_context.h>
+#include <linux/sched/topology.h>
+#include <linux/seq_file.h>
 #include <uapi/linux/io_uring.h>
 
 #include "io-wq.h"
@@ -60,6 +62,13 @@ struct io_worker {
 	struct callback_head create_work;
 	int create_index;
 
+	/* wq->aff_seq this worker last applied wq->cpu_mask for */
+	unsigned int aff_seq;
+
+	/* stats for fdinfo */
+	u64 nr_works;
+	u64 busy_ns;
+
 	union {
 		struct rcu_head rcu;
 		struct work_struct work;
@@ -121,6 +130,16 @@ struct io_wq {
 	struct io_wq_work *hash_tail[IO_WQ_NR_HASH_BUCKETS];
 
 	cpumask_var_t cpu_mask;
+
+	/*
+	 * IORING_IOWQ_AFF_* policy.  aff_capacity is the submitter's CPU
+	 * capacity for IORING_IOWQ_AFF_SUBMITTER and the minimum capacity for
+	 * IORING_IOWQ_AFF_CAPACITY.  aff_seq is bumped, with wq->lock held,
+	 * whenever cpu_mask is rebuilt, and running workers then move.
+	 */
+	unsigned int aff_policy;
+	unsigned long aff_capacity;
+	atomic_t aff_seq;
 };
 
 static enum cpuhp_state io_wq_online;
@@ -552,6 +571,7 @@ static void io_worker_handle_work(struct io_wq_acct *acct,
 {
 	struct io_wq *wq = worker->wq;
 	bool do_kill = test_bit(IO_WQ_BIT_EXIT, &wq->state);
+	u64 start;
 
 	do {
 		struct io_wq_work *work;
@@ -593,7 +613,10 @@ static void io_worker_handle_work(struct io_wq_acct *acct,
 
 			if (unlikely(do_kill) && (work->flags & IO_WQ_WORK_UNBOUND))
 				work->flags |= IO_WQ_WORK_CANCEL;
+			start = ktime_get_ns();
 			wq->do_work(work);
+			worker->busy_ns += ktime_get_ns() - start;
+			worker->nr_works++;
 			io_assign_current_work(worker, NULL);
 
 			linked = wq->free_work(work);
@@ -639,6 +662,12 @@ static int io_wq_worker(void *data)
 	while (!test_bit(IO_WQ_BIT_EXIT, &wq->state)) {
 		long ret;
 
+		/* Follow an affinity policy change without waiting to exit */
+		if (worker->aff_seq != atomic_read(&wq->aff_seq)) {
+			worker->aff_seq = atomic_read(&wq->aff_seq);
+			set_cpus_allowed_ptr(current, wq->cpu_mask);
+		}
+
 		set_current_state(TASK_INTERRUPTIBLE);
 
 		/*
@@ -727,6 +756,7 @@ static void io_init_new_worker(struct io_wq *wq, struct io_worker *worker,
 {
 	tsk->worker_private = worker;
 	worker->task = tsk;
+	worker->aff_seq = atomic_read(&wq->aff_seq);
 	set_cpus_allowed_ptr(tsk, wq->cpu_mask);
 
 	raw_spin_lock(&wq->lock);
@@ -921,6 +951,53 @@ static bool io_wq_work_match_item(struct io_wq_work *work, void *data)
 	return work == data;
 }
 
+static bool io_wq_aff_cpu_allowed(struct io_wq *wq, unsigned int cpu)
+{
+	switch (wq->aff_policy) {
+	case IORING_IOWQ_AFF_SUBMITTER:
+		return arch_scale_cpu_capacity(cpu) == wq->aff_capacity;
+	case IORING_IOWQ_AFF_CAPACITY:
+		return arch_scale_cpu_capacity(cpu) >= wq->aff_capacity;
+	default:
+		return true;
+	}
+}
+
+/*
+ * Rebuild wq->cpu_mask from the affinity policy, called with wq->lock held.
+ */
+static void __io_wq_aff_update(struct io_wq *wq)
+{
+	unsigned int cpu;
+
+	cpumask_clear(wq->cpu_mask);
+	for_each_online_cpu(cpu) {
+		if (io_wq_aff_cpu_allowed(wq, cpu))
+			cpumask_set_cpu(cpu, wq->cpu_mask);
+	}
+	atomic_inc(&wq->aff_seq);
+}
+
+/*
+ * Keep workers on the cluster of the task submitting work to them, so
+ * blocking work doesn't end up on CPUs much slower than the submitter.
+ */
+static void io_wq_aff_follow_submitter(struct io_wq *wq)
+{
+	unsigned long cap = arch_scale_cpu_capacity(raw_smp_processor_id());
+
+	if (likely(cap == READ_ONCE(wq->aff_capacity)))
+		return;
+
+	raw_spin_lock(&wq->lock);
+	if (wq->aff_policy == IORING_IOWQ_AFF_SUBMITTER &&
+	    wq->aff_capacity != cap) {
+		wq->aff_capacity = cap;
+		__io_wq_aff_update(wq);
+	}
+	raw_spin_unlock(&wq->lock);
+}
+
 void io_wq_enqueue(struct io_wq *wq, struct io_wq_work *work)
 {
 	struct io_wq_acct *acct = io_work_get_acct(wq, work);
@@ -928,6 +1005,11 @@ void io_wq_enqueue(struct io_wq *wq, struct io_wq_work *work)
 	unsigned work_flags = work->flags;
 	bool do_create;
 
+	/* Linked work queued by a worker says nothing about the submitter */
+	if (READ_ONCE(wq->aff_policy) == IORING_IOWQ_AFF_SUBMITTER &&
+	    !io_wq_current_is_worker())
+		io_wq_aff_follow_submitter(wq);
+
 	/*
 	 * If io-wq is exiting for this task, or if the request has explicitly
 	 * been marked as one that should not get executed, cancel it here.
@@ -1162,6 +1244,8 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 	if (!alloc_cpumask_var(&wq->cpu_mask, GFP_KERNEL))
 		goto err;
 	cpumask_copy(wq->cpu_mask, cpu_possible_mask);
+	wq->aff_policy = IORING_IOWQ_AFF_NONE;
+	atomic_set(&wq->aff_seq, 0);
 	wq->acct[IO_WQ_ACCT_BOUND].max_workers = bounded;
 	wq->acct[IO_WQ_ACCT_UNBOUND].max_workers =
 				task_rlimit(current, RLIMIT_NPROC);
@@ -1280,9 +1364,10 @@ static bool io_wq_worker_affinity(struct io_worker *worker, void *data)
 {
 	struct online_data *od = data;
 
-	if (od->online)
-		cpumask_set_cpu(od->cpu, worker->wq->cpu_mask);
-	else
+	if (od->online) {
+		if (io_wq_aff_cpu_allowed(worker->wq, od->cpu))
+			cpumask_set_cpu(od->cpu, worker->wq->cpu_mask);
+	} else
 		cpumask_clear_cpu(od->cpu, worker->wq->cpu_mask);
 	return false;
 }
@@ -1320,15 +1405,84 @@ int io_wq_cpu_affinity(struct io_uring_task *tctx, cpumask_var_t mask)
 		return -EINVAL;
 
 	rcu_read_lock();
+	raw_spin_lock(&tctx->io_wq->lock);
+	tctx->io_wq->aff_policy = IORING_IOWQ_AFF_NONE;
 	if (mask)
 		cpumask_copy(tctx->io_wq->cpu_mask, mask);
 	else
 		cpumask_copy(tctx->io_wq->cpu_mask, cpu_possible_mask);
+	atomic_inc(&tctx->io_wq->aff_seq);
+	raw_spin_unlock(&tctx->io_wq->lock);
 	rcu_read_unlock();
 
 	return 0;
 }
 
+int io_wq_aff_policy(struct io_uring_task *tctx, unsigned int policy,
+		     unsigned int min_capacity)
+{
+	struct io_wq *wq;
+	unsigned int cpu;
+	bool any = false;
+
+	if (!tctx || !tctx->io_wq)
+		return -EINVAL;
+	wq = tctx->io_wq;
+
+	switch (policy) {
+	case IORING_IOWQ_AFF_NONE:
+		return io_wq_cpu_affinity(tctx, NULL);
+	case IORING_IOWQ_AFF_SUBMITTER:
+		break;
+	case IORING_IOWQ_AFF_CAPACITY:
+		if (min_capacity > SCHED_CAPACITY_SCALE)
+			return -EINVAL;
+		cpus_read_lock();
+		for_each_online_cpu(cpu)
+			any |= arch_scale_cpu_capacity(cpu) >= min_capacity;
+		cpus_read_unlock();
+		if (!any)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	raw_spin_lock(&wq->lock);
+	wq->aff_policy = policy;
+	if (policy == IORING_IOWQ_AFF_SUBMITTER)
+		wq->aff_capacity = arch_scale_cpu_capacity(raw_smp_processor_id());
+	else
+		wq->aff_capacity = min_capacity;
+	__io_wq_aff_update(wq);
+	raw_spin_unlock(&wq->lock);
+
+	return 0;
+}
+
+static bool io_wq_worker_show(struct io_worker *worker, void *data)
+{
+	struct seq_file *m = data;
+
+	seq_printf(m, "  pid:%d %s cpu:%d works:%llu busy_us:%llu%s\n",
+		   task_pid_nr(worker->task),
+		   worker->flags & IO_WORKER_F_BOUND ? "bound" : "unbound",
+		   task_cpu(worker->task), worker->nr_works,
+		   div_u64(worker->busy_ns, NSEC_PER_USEC),
+		   worker->flags & IO_WORKER_F_FREE ? " idle" : "");
+	return false;
+}
+
+void io_wq_show_fdinfo(struct seq_file *m, struct io_wq *wq)
+{
+	seq_printf(m, "IoWq:\ttask:%d policy:%u cpus:%*pbl\n",
+		   wq->task ? task_pid_nr(wq->task) : -1, wq->aff_policy,
+		   cpumask_pr_args(wq->cpu_mask));
+	rcu_read_lock();
+	io_wq_for_each_worker(wq, io_wq_worker_show, m);
+	rcu_read_unlock();
+}
+
 /*
  * Set max number of unbounded workers, returns old value. If new_count is 0,
  * then just return the old value.
@@ -15,8 +15,6 @@
 #include "opdef.h"
 #include "kbuf.h"
 
-#define IO_BUFFER_LIST_BUF_PER_PAGE (PAGE_SIZE / sizeof(struct io_uring_buf))
-
 /* BIDs are addressed by a 16-bit field in a CQE */
 #define MAX_BIDS_PER_BGID (1 << 16)
 
@@ -90,7 +88,7 @@ void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags)
 	return;
 }
 
-unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags)
+unsigned int __io_put_kbuf(struct io_kiocb *req, int len, unsigned issue_flags)
 {
 	unsigned int cflags;
 
@@ -108,17 +106,17 @@ unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags)
 	 */
 	if (req->flags & REQ_F_BUFFER_RING) {
 		/* no buffers to recycle for this case */
-		cflags = __io_put_kbuf_list(req, NULL);
+		cflags = __io_put_kbuf_list(req, len, NULL);
 	} else if (issue_flags & IO_URING_F_UNLOCKED) {
 		struct io_ring_ctx *ctx = req->ctx;
 
 		spin_lock(&ctx->completion_lock);
-		cflags = __io_put_kbuf_list(req, &ctx->io_buffers_comp);
+		cflags = __io_put_kbuf_list(req, len, &ctx->io_buffers_comp);
 		spin_unlock(&ctx->completion_lock);
 	} else {
 		lockdep_assert_held(&req->ctx->uring_lock);
 
-		cflags = __io_put_kbuf_list(req, &req->ctx->io_buffers_cache);
+		cflags = __io_put_kbuf_list(req, len, &req->ctx->io_buffers_cache);
 	}
 	return cflags;
 }
@@ -152,18 +150,9 @@ static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
 	if (unlikely(smp_load_acquire(&br->tail) == head))
 		return NULL;
 
-	head &= bl->mask;
-	/* mmaped buffers are always contig */
-	if (bl->is_mmap || head < IO_BUFFER_LIST_BUF_PER_PAGE) {
-		buf = &br->bufs[head];
-	} else {
-		int off = head & (IO_BUFFER_LIST_BUF_PER_PAGE - 1);
-		int index = head / IO_BUFFER_LIST_BUF_PER_PAGE;
-		buf = page_address(bl->buf_pages[index]);
-		buf += off;
-	}
-	if (*len == 0 || *len > buf->len)
-		*len = buf->len;
+	buf = io_ring_head_to_buf(bl, head);
+	if (*len == 0 || *len > READ_ONCE(buf->len))
+		*len = READ_ONCE(buf->len);
 	req->flags |= REQ_F_BUFFER_RING;
 	req->buf_list = bl;
 	req->buf_index = buf->bid;
@@ -177,12 +166,13 @@ static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
 		 * io-wq context and there may be further retries in async hybrid
 		 * mode. For the locked case, the caller must call commit when
 		 * the transfer completes (or if we get -EAGAIN and must poll of
-		 * retry).
+		 * retry). As the amount used isn't known yet, an incrementally
+		 * consumed buffer is taken whole here too.
 		 */
 		req->buf_list = NULL;
 		bl->head++;
 	}
-	return u64_to_user_ptr(buf->addr);
+	return u64_to_user_ptr(READ_ONCE(buf->addr));
 }
 
 void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
@@ -497,6 +487,7 @@ static int io_pin_pbuf_ring(struct io_uring_buf_reg *reg,
 	struct io_uring_buf_ring *br;
 	struct page **pages;
 	int i, nr_pages;
+	bool contig = true;
 
 	pages = io_pin_pages(reg->ring_addr,
 			     flex_array_size(br, bufs, reg->ring_entries),
@@ -511,9 +502,13 @@ static int io_pin_pbuf_ring(struct io_uring_buf_reg *reg,
 	 * So just error out, returning -EINVAL just like we did on kernels
 	 * that didn't support mapped buffer rings.
 	 */
-	for (i = 0; i < nr_pages; i++)
+	for (i = 0; i < nr_pages; i++) {
 		if (PageHighMem(pages[i]))
 			goto error_unpin;
+		/* e.g. a ring placed in a huge page */
+		if (i && pages[i] != nth_page(pages[0], i))
+			contig = false;
+	}
 
 	br = page_address(pages[0]);
 #ifdef SHM_COLOUR
@@ -534,6 +529,7 @@ static int io_pin_pbuf_ring(struct io_uring_buf_reg *reg,
 	bl->buf_ring = br;
 	bl->is_mapped = 1;
 	bl->is_mmap = 0;
+	bl->is_contig = contig;
 	return 0;
 error_unpin:
 	for (i = 0; i < nr_pages; i++)
@@ -601,6 +597,8 @@ static int io_alloc_pbuf_ring(struct io_ring_ctx *ctx,
 	bl->buf_ring = ibf->mem;
 	bl->is_mapped = 1;
 	bl->is_mmap = 1;
+	/* mmaped buffers are always contig */
+	bl->is_contig = 1;
 	return 0;
 }
 
@@ -617,7 +615,7 @@ int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
 
 	if (reg.resv[0] || reg.resv[1] || reg.resv[2])
 		return -EINVAL;
-	if (reg.flags & ~IOU_PBUF_RING_MMAP)
+	if (reg.flags & ~(IOU_PBUF_RING_MMAP | IOU_PBUF_RING_INC))
 		return -EINVAL;
 	if (!(reg.flags & IOU_PBUF_RING_MMAP)) {
 		if (!reg.ring_addr)
@@ -655,6 +653,7 @@ int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
 	if (!ret) {
 		bl->nr_entries = reg.ring_entries;
 		bl->mask = reg.ring_entries - 1;
+		bl->is_inc = !!(reg.flags & IOU_PBUF_RING_INC);
 
 		io_buffer_add_list(ctx, bl, reg.bgid);
 		return 0;
@@ -31,6 +31,10 @@ struct io_buffer_list {
 	__u8 is_mapped;
 	/* ring mapped provided buffers, but mmap'ed by application */
 	__u8 is_mmap;
+	/* ring is virtually contiguous in the kernel, see io_ring_head_to_buf */
+	__u8 is_contig;
+	/* buffers are consumed incrementally, IOU_PBUF_RING_INC */
+	__u8 is_inc;
 };
 
 struct io_buffer {
@@ -56,7 +60,7 @@ int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg);
 
 void io_kbuf_mmap_list_free(struct io_ring_ctx *ctx);
 
-unsigned int __io_put_kbuf(struct io_kiocb *req, unsigned issue_flags);
+unsigned int __io_put_kbuf(struct io_kiocb *req, int len, unsigned issue_flags);
 
 void io_kbuf_recycle_legacy(struct io_kiocb *req, unsigned issue_flags);
 
@@ -64,6 +68,43 @@ void io_put_bl(struct io_ring_ctx *ctx, struct io_buffer_list *bl);
 struct io_buffer_list *io_pbuf_get_bl(struct io_ring_ctx *ctx,
 				      unsigned long bgid);
 
+#define IO_BUFFER_LIST_BUF_PER_PAGE (PAGE_SIZE / sizeof(struct io_uring_buf))
+
+static inline struct io_uring_buf *io_ring_head_to_buf(struct io_buffer_list *bl,
+						       __u16 head)
+{
+	head &= bl->mask;
+	if (bl->is_contig || head < IO_BUFFER_LIST_BUF_PER_PAGE)
+		return &bl->buf_ring->bufs[head];
+
+	return (struct io_uring_buf *)page_address(
+			bl->buf_pages[head / IO_BUFFER_LIST_BUF_PER_PAGE]) +
+		(head & (IO_BUFFER_LIST_BUF_PER_PAGE - 1));
+}
+
+/*
+ * Account len bytes used out of the buffer at the head of the ring. Returns
+ * false if an incrementally consumed buffer has room left, in which case it
+ * stays at the head with its addr and len moved past the used part.
+ */
+static inline bool io_kbuf_commit(struct io_buffer_list *bl, int len)
+{
+	if (bl->is_inc) {
+		struct io_uring_buf *buf = io_ring_head_to_buf(bl, bl->head);
+		__u32 buf_len = READ_ONCE(buf->len);
+
+		if (len <= 0)
+			return false;
+		if (len < buf_len) {
+			WRITE_ONCE(buf->addr, READ_ONCE(buf->addr) + len);
+			WRITE_ONCE(buf->len, buf_len - len);
+			return false;
+		}
+	}
+	bl->head++;
+	return true;
+}
+
 static inline void io_kbuf_recycle_ring(struct io_kiocb *req)
 {
 	/*
@@ -106,7 +147,7 @@ static inline void io_kbuf_recycle(struct io_kiocb *req, unsigned issue_flags)
 		io_kbuf_recycle_ring(req);
 }
 
-static inline unsigned int __io_put_kbuf_list(struct io_kiocb *req,
+static inline unsigned int __io_put_kbuf_list(struct io_kiocb *req, int len,
 					      struct list_head *list)
 {
 	unsigned int ret = IORING_CQE_F_BUFFER | (req->buf_index << IORING_CQE_BUFFER_SHIFT);
@@ -114,7 +155,8 @@ static inline unsigned int __io_put_kbuf_list(struct io_kiocb *req,
 	if (req->flags & REQ_F_BUFFER_RING) {
 		if (req->buf_list) {
 			req->buf_index = req->buf_list->bgid;
-			req->buf_list->head++;
+			if (!io_kbuf_commit(req->buf_list, len))
+				ret |= IORING_CQE_F_BUF_MORE;
 		}
 		req->flags &= ~REQ_F_BUFFER_RING;
 	} else {
@@ -132,15 +174,19 @@ static inline unsigned int io_put_kbuf_comp(struct io_kiocb *req)
 
 	if (!(req->flags & (REQ_F_BUFFER_SELECTED|REQ_F_BUFFER_RING)))
 		return 0;
-	return __io_put_kbuf_list(req, &req->ctx->io_buffers_comp);
+	return __io_put_kbuf_list(req, 0, &req->ctx->io_buffers_comp);
 }
 
-static inline unsigned int io_put_kbuf(struct io_kiocb *req,
+/*
+ * len is the number of bytes the request used of its buffer, it only
+ * matters for incrementally consumed buffer rings.
+ */
+static inline unsigned int io_put_kbuf(struct io_kiocb *req, int len,
 				       unsigned issue_flags)
 {
 
 	if (!(req->flags & (REQ_F_BUFFER_SELECTED|REQ_F_BUFFER_RING)))
 		return 0;
-	return __io_put_kbuf(req, issue_flags);
+	return __io_put_kbuf(req, len, issue_flags);
 }
 #endif
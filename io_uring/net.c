@@ -678,7 +678,7 @@ static inline bool io_recv_finish(struct io_kiocb *req, int *ret,
 {
 	unsigned int cflags;
 
-	cflags = io_put_kbuf(req, issue_flags);
+	cflags = io_put_kbuf(req, *ret, issue_flags);
 	if (msg->msg_inq && msg->msg_inq != -1)
 		cflags |= IORING_CQE_F_SOCK_NONEMPTY;
 
@@ -1030,13 +1030,43 @@ void io_send_zc_cleanup(struct io_kiocb *req)
 }
 
 #define IO_ZC_FLAGS_COMMON (IORING_RECVSEND_POLL_FIRST | IORING_RECVSEND_FIXED_BUF)
-#define IO_ZC_FLAGS_VALID  (IO_ZC_FLAGS_COMMON | IORING_SEND_ZC_REPORT_USAGE)
+#define IO_ZC_FLAGS_VALID  (IO_ZC_FLAGS_COMMON | IORING_SEND_ZC_REPORT_USAGE | \
+			    IORING_SEND_ZC_COALESCE)
+/* internal, this request posts the notification CQE */
+#define IO_ZC_NOTIF_CQE		(1U << 15)
+
+static inline unsigned io_send_zc_cflags(struct io_sr_msg *zc)
+{
+	return (zc->flags & IO_ZC_NOTIF_CQE) ? IORING_CQE_F_MORE : 0;
+}
+
+/*
+ * Sends shorter than the registered copy threshold don't amortise pinning
+ * and ubuf_info refcounting, copy them instead. The notification is still
+ * posted, it just completes as soon as the request drops its reference.
+ */
+static bool io_send_zc_copy(struct io_kiocb *req, struct io_sr_msg *zc,
+			    size_t len)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_notif_data *nd;
+
+	if (likely(len >= READ_ONCE(ctx->zc_tx.copy_thresh)))
+		return false;
+
+	nd = io_notif_to_data(zc->notif);
+	if (nd->zc_report)
+		WRITE_ONCE(nd->zc_copied, true);
+	atomic_long_inc(&ctx->zc_tx.nr_copied);
+	return true;
+}
 
 int io_send_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_sr_msg *zc = io_kiocb_to_cmd(req, struct io_sr_msg);
 	struct io_ring_ctx *ctx = req->ctx;
 	struct io_kiocb *notif;
+	bool notif_cqe = true;
 
 	if (unlikely(READ_ONCE(sqe->__pad2[0]) || READ_ONCE(sqe->addr3)))
 		return -EINVAL;
@@ -1044,22 +1074,35 @@ int io_send_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 	if (req->flags & REQ_F_CQE_SKIP)
 		return -EINVAL;
 
-	notif = zc->notif = io_alloc_notif(ctx);
-	if (!notif)
-		return -ENOMEM;
-	notif->cqe.user_data = req->cqe.user_data;
-	notif->cqe.res = 0;
-	notif->cqe.flags = IORING_CQE_F_NOTIF;
+	zc->flags = READ_ONCE(sqe->ioprio);
+	if (unlikely(zc->flags & ~IO_ZC_FLAGS_VALID))
+		return -EINVAL;
+
+	ctx->zc_tx.nr_sends++;
+	if ((zc->flags & IORING_SEND_ZC_COALESCE) || ctx->zc_tx.notif) {
+		/* a send without the flag closes the open batch */
+		notif = io_notif_coalesce(req,
+				!(zc->flags & IORING_SEND_ZC_COALESCE),
+				&notif_cqe);
+		zc->notif = notif;
+		if (!notif)
+			return -ENOMEM;
+	} else {
+		notif = zc->notif = io_alloc_notif(ctx);
+		if (!notif)
+			return -ENOMEM;
+		notif->cqe.user_data = req->cqe.user_data;
+		notif->cqe.res = 0;
+		notif->cqe.flags = IORING_CQE_F_NOTIF;
+		ctx->zc_tx.nr_notifs++;
+	}
 	req->flags |= REQ_F_NEED_CLEANUP;
+	if (notif_cqe)
+		zc->flags |= IO_ZC_NOTIF_CQE;
 
-	zc->flags = READ_ONCE(sqe->ioprio);
-	if (unlikely(zc->flags & ~IO_ZC_FLAGS_COMMON)) {
-		if (zc->flags & ~IO_ZC_FLAGS_VALID)
-			return -EINVAL;
-		if (zc->flags & IORING_SEND_ZC_REPORT_USAGE) {
-			io_notif_set_extended(notif);
-			io_notif_to_data(notif)->zc_report = true;
-		}
+	if (zc->flags & IORING_SEND_ZC_REPORT_USAGE) {
+		io_notif_set_extended(notif);
+		io_notif_to_data(notif)->zc_report = true;
 	}
 
 	if (zc->flags & IORING_RECVSEND_FIXED_BUF) {
@@ -1069,6 +1112,10 @@ int io_send_zc_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 			return -EFAULT;
 		idx = array_index_nospec(idx, ctx->nr_user_bufs);
 		req->imu = READ_ONCE(ctx->user_bufs[idx]);
+		/*
+		 * A shared notif keeps the node of its first fixed buffer
+		 * member, which is enough as nodes are retired in order.
+		 */
 		io_req_set_rsrc_node(notif, ctx, 0);
 	}
 
@@ -1164,6 +1211,7 @@ int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
 	struct msghdr msg;
 	struct socket *sock;
 	unsigned msg_flags;
+	bool copy;
 	int ret, min_ret = 0;
 
 	sock = sock_from_file(req->file);
@@ -1195,6 +1243,7 @@ int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
 	    (zc->flags & IORING_RECVSEND_POLL_FIRST))
 		return io_setup_async_addr(req, &__address, issue_flags);
 
+	copy = io_send_zc_copy(req, zc, zc->len);
 	if (zc->flags & IORING_RECVSEND_FIXED_BUF) {
 		ret = io_import_fixed(ITER_SOURCE, &msg.msg_iter, req->imu,
 					(u64)(uintptr_t)zc->buf, zc->len);
@@ -1206,13 +1255,22 @@ int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
 		ret = import_ubuf(ITER_SOURCE, zc->buf, zc->len, &msg.msg_iter);
 		if (unlikely(ret))
 			return ret;
-		ret = io_notif_account_mem(zc->notif, zc->len);
-		if (unlikely(ret))
-			return ret;
+		if (!copy) {
+			ret = io_notif_account_mem(zc->notif, zc->len);
+			if (unlikely(ret))
+				return ret;
+		}
 		msg.sg_from_iter = io_sg_from_iter_iovec;
 	}
 
-	msg_flags = zc->msg_flags | MSG_ZEROCOPY;
+	msg_flags = zc->msg_flags;
+	if (copy) {
+		msg.sg_from_iter = NULL;
+		msg.msg_ubuf = NULL;
+	} else {
+		msg_flags |= MSG_ZEROCOPY;
+		msg.msg_ubuf = &io_notif_to_data(zc->notif)->uarg;
+	}
 	if (issue_flags & IO_URING_F_NONBLOCK)
 		msg_flags |= MSG_DONTWAIT;
 	if (msg_flags & MSG_WAITALL)
@@ -1220,7 +1278,6 @@ int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
 	msg_flags &= ~MSG_INTERNAL_SENDMSG_FLAGS;
 
 	msg.msg_flags = msg_flags;
-	msg.msg_ubuf = &io_notif_to_data(zc->notif)->uarg;
 	ret = sock_sendmsg(sock, &msg);
 
 	if (unlikely(ret < min_ret)) {
@@ -1252,7 +1309,7 @@ int io_send_zc(struct io_kiocb *req, unsigned int issue_flags)
 		io_notif_flush(zc->notif);
 		req->flags &= ~REQ_F_NEED_CLEANUP;
 	}
-	io_req_set_res(req, ret, IORING_CQE_F_MORE);
+	io_req_set_res(req, ret, io_send_zc_cflags(zc));
 	return IOU_OK;
 }
 
@@ -1286,14 +1343,20 @@ int io_sendmsg_zc(struct io_kiocb *req, unsigned int issue_flags)
 	    (sr->flags & IORING_RECVSEND_POLL_FIRST))
 		return io_setup_async_msg(req, kmsg, issue_flags);
 
-	flags = sr->msg_flags | MSG_ZEROCOPY;
+	flags = sr->msg_flags;
+	if (io_send_zc_copy(req, sr, iov_iter_count(&kmsg->msg.msg_iter))) {
+		kmsg->msg.msg_ubuf = NULL;
+		kmsg->msg.sg_from_iter = NULL;
+	} else {
+		flags |= MSG_ZEROCOPY;
+		kmsg->msg.msg_ubuf = &io_notif_to_data(sr->notif)->uarg;
+		kmsg->msg.sg_from_iter = io_sg_from_iter_iovec;
+	}
 	if (issue_flags & IO_URING_F_NONBLOCK)
 		flags |= MSG_DONTWAIT;
 	if (flags & MSG_WAITALL)
 		min_ret = iov_iter_count(&kmsg->msg.msg_iter);
 
-	kmsg->msg.msg_ubuf = &io_notif_to_data(sr->notif)->uarg;
-	kmsg->msg.sg_from_iter = io_sg_from_iter_iovec;
 	ret = __sys_sendmsg_sock(sock, &kmsg->msg, flags);
 
 	if (unlikely(ret < min_ret)) {
@@ -1329,7 +1392,7 @@ int io_sendmsg_zc(struct io_kiocb *req, unsigned int issue_flags)
 		io_notif_flush(sr->notif);
 		req->flags &= ~REQ_F_NEED_CLEANUP;
 	}
-	io_req_set_res(req, ret, IORING_CQE_F_MORE);
+	io_req_set_res(req, ret, io_send_zc_cflags(sr));
 	return IOU_OK;
 }
 
@@ -1342,7 +1405,7 @@ void io_sendrecv_fail(struct io_kiocb *req)
 
 	if ((req->flags & REQ_F_NEED_CLEANUP) &&
 	    (req->opcode == IORING_OP_SEND_ZC || req->opcode == IORING_OP_SENDMSG_ZC))
-		req->cqe.flags |= IORING_CQE_F_MORE;
+		req->cqe.flags |= io_send_zc_cflags(sr);
 }
 
 int io_accept_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
@@ -17,10 +17,9 @@ static void io_notif_complete_tw_ext(struct io_kiocb *notif, struct io_tw_state
 	if (nd->zc_report && (nd->zc_copied || !nd->zc_used))
 		notif->cqe.res |= IORING_NOTIF_USAGE_ZC_COPIED;
 
-	if (nd->account_pages && ctx->user) {
-		__io_unaccount_mem(ctx->user, nd->account_pages);
-		nd->account_pages = 0;
-	}
+	if (atomic_long_read(&nd->account_pages) && ctx->user)
+		__io_unaccount_mem(ctx->user,
+				   atomic_long_xchg(&nd->account_pages, 0));
 	io_req_task_complete(notif, ts);
 }
 
@@ -53,7 +52,7 @@ void io_notif_set_extended(struct io_kiocb *notif)
 	struct io_notif_data *nd = io_notif_to_data(notif);
 
 	if (nd->uarg.callback != io_tx_ubuf_callback_ext) {
-		nd->account_pages = 0;
+		atomic_long_set(&nd->account_pages, 0);
 		nd->zc_report = false;
 		nd->zc_used = false;
 		nd->zc_copied = false;
@@ -84,3 +83,76 @@ struct io_kiocb *io_alloc_notif(struct io_ring_ctx *ctx)
 	refcount_set(&nd->uarg.refcnt, 1);
 	return notif;
 }
+
+/*
+ * Attach @req to the ring's open coalesced notification, opening a new one
+ * if needed. Each member holds a reference that it drops with
+ * io_notif_flush() once issued. The ring's own reference is handed over to
+ * the member closing the batch, *closed is set for it and the notification
+ * is posted once every member's skbs are gone.
+ */
+struct io_kiocb *io_notif_coalesce(struct io_kiocb *req, bool close,
+				   bool *closed)
+	__must_hold(&req->ctx->uring_lock)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_zc_tx *tx = &ctx->zc_tx;
+	struct io_kiocb *notif = tx->notif;
+
+	if (!notif) {
+		notif = io_alloc_notif(ctx);
+		if (!notif)
+			return NULL;
+		notif->cqe.res = 0;
+		notif->cqe.flags = IORING_CQE_F_NOTIF;
+		/*
+		 * Switch callbacks before any member can send, skbs of earlier
+		 * members may complete while later ones are being prepared.
+		 */
+		io_notif_set_extended(notif);
+		tx->notif = notif;
+		tx->notif_nr = 0;
+		tx->nr_notifs++;
+	}
+
+	notif->cqe.user_data = req->cqe.user_data;
+	if (close || ++tx->notif_nr >= tx->notif_batch) {
+		tx->notif = NULL;
+		*closed = true;
+		return notif;
+	}
+
+	refcount_inc(&io_notif_to_data(notif)->uarg.refcnt);
+	*closed = false;
+	return notif;
+}
+
+/*
+ * Close an open batch on ring exit or task cancelation, its CQE carries the
+ * last member.
+ */
+void io_notif_coalesce_flush(struct io_ring_ctx *ctx)
+	__must_hold(&ctx->uring_lock)
+{
+	if (ctx->zc_tx.notif) {
+		io_notif_flush(ctx->zc_tx.notif);
+		ctx->zc_tx.notif = NULL;
+	}
+}
+
+int io_register_send_zc(struct io_ring_ctx *ctx, void __user *arg)
+	__must_hold(&ctx->uring_lock)
+{
+	struct io_uring_send_zc_opts opts;
+
+	if (copy_from_user(&opts, arg, sizeof(opts)))
+		return -EFAULT;
+	if (opts.resv[0] || opts.resv[1] || opts.resv[2])
+		return -EINVAL;
+	if (opts.notif_batch > IO_NOTIF_COALESCE_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(ctx->zc_tx.copy_thresh, opts.copy_thresh);
+	ctx->zc_tx.notif_batch = opts.notif_batch ?: IO_NOTIF_COALESCE_BATCH;
+	return 0;
+}
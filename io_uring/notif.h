@@ -9,18 +9,24 @@
 
 #define IO_NOTIF_UBUF_FLAGS	(SKBFL_ZEROCOPY_FRAG | SKBFL_DONT_ORPHAN)
 #define IO_NOTIF_SPLICE_BATCH	32
+#define IO_NOTIF_COALESCE_BATCH	16
+#define IO_NOTIF_COALESCE_MAX	1024
 
 struct io_notif_data {
 	struct file		*file;
 	struct ubuf_info	uarg;
-	unsigned long		account_pages;
+	atomic_long_t		account_pages;
 	bool			zc_report;
 	bool			zc_used;
 	bool			zc_copied;
 };
 
 struct io_kiocb *io_alloc_notif(struct io_ring_ctx *ctx);
+struct io_kiocb *io_notif_coalesce(struct io_kiocb *req, bool close,
+				   bool *closed);
+void io_notif_coalesce_flush(struct io_ring_ctx *ctx);
 void io_notif_set_extended(struct io_kiocb *notif);
+int io_register_send_zc(struct io_ring_ctx *ctx, void __user *arg);
 
 static inline struct io_notif_data *io_notif_to_data(struct io_kiocb *notif)
 {
@@ -48,7 +54,7 @@ static inline int io_notif_account_mem(struct io_kiocb *notif, unsigned len)
 		ret = __io_account_mem(ctx->user, nr_pages);
 		if (ret)
 			return ret;
-		nd->account_pages += nr_pages;
+		atomic_long_add(nr_pages, &nd->account_pages);
 	}
 	return 0;
 }
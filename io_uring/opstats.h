@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef IOU_OPSTATS_H
+#define IOU_OPSTATS_H
+
+#include <linux/io_uring_types.h>
+#include <linux/percpu.h>
+#include <linux/log2.h>
+
+/*
+ * Per-opcode counters, only maintained for rings set up with
+ * IORING_SETUP_OP_STATS. Latency is measured from SQE consumption to CQE
+ * posting and kept as a log2 histogram in microseconds, the first bucket
+ * being below 1us and the last one open ended.
+ */
+#define IO_OP_LAT_BUCKETS	16
+
+struct io_op_stats {
+	u64	submitted;
+	/* completed from the issue attempt, no io-wq worker involved */
+	u64	inline_done;
+	u64	punted;
+	u64	poll_armed;
+	u64	completed;
+	u64	lat_sum_ns;
+	u64	lat_hist[IO_OP_LAT_BUCKETS];
+};
+
+#define io_op_stat_inc(req, field)					\
+do {									\
+	struct io_kiocb *__req = (req);					\
+									\
+	if (unlikely(__req->ctx->flags & IORING_SETUP_OP_STATS))	\
+		this_cpu_inc(__req->ctx->op_stats[__req->opcode].field);	\
+} while (0)
+
+static inline void io_op_stats_submit(struct io_kiocb *req)
+{
+	if (unlikely(req->ctx->flags & IORING_SETUP_OP_STATS)) {
+		req->submit_ns = ktime_get_ns();
+		this_cpu_inc(req->ctx->op_stats[req->opcode].submitted);
+	}
+}
+
+static inline void io_op_stats_complete(struct io_kiocb *req)
+{
+	struct io_op_stats __percpu *st;
+	u64 lat;
+	unsigned int bucket = 0;
+
+	if (likely(!(req->ctx->flags & IORING_SETUP_OP_STATS)))
+		return;
+	/* zerocopy notifications are never submitted, don't count them */
+	if (req->cqe.flags & IORING_CQE_F_NOTIF)
+		return;
+
+	st = &req->ctx->op_stats[req->opcode];
+	lat = ktime_get_ns() - req->submit_ns;
+	if (lat >= NSEC_PER_USEC)
+		bucket = min_t(unsigned int, ilog2(lat / NSEC_PER_USEC) + 1,
+			       IO_OP_LAT_BUCKETS - 1);
+
+	this_cpu_inc(st->completed);
+	this_cpu_add(st->lat_sum_ns, lat);
+	this_cpu_inc(st->lat_hist[bucket]);
+}
+
+#endif
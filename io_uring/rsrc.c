@@ -9,6 +9,7 @@
 #include <linux/hugetlb.h>
 #include <linux/compat.h>
 #include <linux/io_uring.h>
+#include <linux/blk-mq.h>
 
 #include <uapi/linux/io_uring.h>
 
@@ -138,6 +139,12 @@ static void io_buffer_unmap(struct io_ring_ctx *ctx, struct io_mapped_ubuf **slo
 	unsigned int i;
 
 	if (imu != &dummy_ubuf) {
+		if (imu->release) {
+			imu->release(imu->priv);
+			kvfree(imu);
+			*slot = NULL;
+			return;
+		}
 		for (i = 0; i < imu->nr_bvecs; i++)
 			unpin_user_page(imu->bvec[i].bv_page);
 		if (imu->acct_pages)
@@ -911,16 +918,120 @@ struct page **io_pin_pages(unsigned long ubuf, unsigned long len, int *npages)
 	return pages;
 }
 
+struct io_imu_folio_data {
+	/* head folio can be partially included in the fixed buf */
+	unsigned int	nr_pages_head;
+	/* index of the first pinned page within the head folio */
+	unsigned int	head_page_idx;
+	/* non-head/tail folios have to be fully included */
+	unsigned int	nr_pages_mid;
+	unsigned int	folio_shift;
+};
+
+/*
+ * Replace the per-page array with one head page per folio, dropping the
+ * extra pins on the tail pages. The folio stays pinned through its head.
+ */
+static bool io_do_coalesce_buffer(struct page ***pages, int *nr_pages,
+				  struct io_imu_folio_data *data, int nr_folios)
+{
+	struct page **page_array = *pages, **new_array;
+	int nr_pages_left = *nr_pages, i, j;
+
+	new_array = kvmalloc_array(nr_folios, sizeof(struct page *),
+				   GFP_KERNEL);
+	if (!new_array)
+		return false;
+
+	new_array[0] = compound_head(page_array[0]);
+	/*
+	 * The pages are bound to the folio, it doesn't actually unpin them
+	 * but drops all but one reference, which is usually put down by
+	 * io_buffer_unmap().
+	 */
+	if (data->nr_pages_head > 1)
+		unpin_user_pages(&page_array[1], data->nr_pages_head - 1);
+
+	j = data->nr_pages_head;
+	nr_pages_left -= data->nr_pages_head;
+	for (i = 1; i < nr_folios; i++) {
+		unsigned int nr_unpin;
+
+		new_array[i] = page_array[j];
+		nr_unpin = min_t(unsigned int, nr_pages_left - 1,
+				 data->nr_pages_mid - 1);
+		if (nr_unpin)
+			unpin_user_pages(&page_array[j + 1], nr_unpin);
+		j += data->nr_pages_mid;
+		nr_pages_left -= data->nr_pages_mid;
+	}
+	kvfree(page_array);
+	*pages = new_array;
+	*nr_pages = nr_folios;
+	return true;
+}
+
+/*
+ * Check whether the pinned pages are made of physically contiguous large
+ * folios of one size (THP or hugetlb), so that each folio can be described
+ * by a single bvec. Only the head and tail folio may be partially covered.
+ */
+static bool io_try_coalesce_buffer(struct page ***pages, int *nr_pages,
+				   struct io_imu_folio_data *data)
+{
+	struct page **page_array = *pages;
+	struct folio *folio = page_folio(page_array[0]);
+	unsigned int count = 1, nr_folios = 1;
+	int i;
+
+	data->nr_pages_mid = folio_nr_pages(folio);
+	if (data->nr_pages_mid == 1)
+		return false;
+
+	data->folio_shift = folio_shift(folio);
+	data->head_page_idx = folio_page_idx(folio, page_array[0]);
+	for (i = 1; i < *nr_pages; i++) {
+		if (page_folio(page_array[i]) == folio &&
+		    page_array[i] == page_array[i - 1] + 1) {
+			count++;
+			continue;
+		}
+
+		if (nr_folios == 1) {
+			if (folio_page_idx(folio, page_array[i - 1]) !=
+			    data->nr_pages_mid - 1)
+				return false;
+
+			data->nr_pages_head = count;
+		} else if (count != data->nr_pages_mid) {
+			return false;
+		}
+
+		folio = page_folio(page_array[i]);
+		if (folio_size(folio) != (1UL << data->folio_shift) ||
+		    folio_page_idx(folio, page_array[i]) != 0)
+			return false;
+
+		count = 1;
+		nr_folios++;
+	}
+	if (nr_folios == 1)
+		data->nr_pages_head = count;
+
+	return io_do_coalesce_buffer(pages, nr_pages, data, nr_folios);
+}
+
 static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 				  struct io_mapped_ubuf **pimu,
 				  struct page **last_hpage)
 {
 	struct io_mapped_ubuf *imu = NULL;
 	struct page **pages = NULL;
+	struct io_imu_folio_data data;
+	bool coalesced = false;
 	unsigned long off;
 	size_t size;
 	int ret, nr_pages, i;
-	struct folio *folio = NULL;
 
 	*pimu = (struct io_mapped_ubuf *)&dummy_ubuf;
 	if (!iov->iov_base)
@@ -935,31 +1046,9 @@ static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 		goto done;
 	}
 
-	/* If it's a huge page, try to coalesce them into a single bvec entry */
-	if (nr_pages > 1) {
-		folio = page_folio(pages[0]);
-		for (i = 1; i < nr_pages; i++) {
-			/*
-			 * Pages must be consecutive and on the same folio for
-			 * this to work
-			 */
-			if (page_folio(pages[i]) != folio ||
-			    pages[i] != pages[i - 1] + 1) {
-				folio = NULL;
-				break;
-			}
-		}
-		if (folio) {
-			/*
-			 * The pages are bound to the folio, it doesn't
-			 * actually unpin them but drops all but one reference,
-			 * which is usually put down by io_buffer_unmap().
-			 * Note, needs a better helper.
-			 */
-			unpin_user_pages(&pages[1], nr_pages - 1);
-			nr_pages = 1;
-		}
-	}
+	/* If it's huge page(s), try to coalesce them into fewer bvec entries */
+	if (nr_pages > 1 && io_try_coalesce_buffer(&pages, &nr_pages, &data))
+		coalesced = true;
 
 	imu = kvmalloc(struct_size(imu, bvec, nr_pages), GFP_KERNEL);
 	if (!imu)
@@ -971,23 +1060,28 @@ static int io_sqe_buffer_register(struct io_ring_ctx *ctx, struct iovec *iov,
 		goto done;
 	}
 
-	off = (unsigned long) iov->iov_base & ~PAGE_MASK;
 	size = iov->iov_len;
 	/* store original address for later verification */
 	imu->ubuf = (unsigned long) iov->iov_base;
 	imu->ubuf_end = imu->ubuf + iov->iov_len;
 	imu->nr_bvecs = nr_pages;
+	imu->folio_shift = PAGE_SHIFT;
+	imu->release = NULL;
+	imu->priv = NULL;
+	imu->dir = IO_IMU_DEST | IO_IMU_SOURCE;
 	*pimu = imu;
 	ret = 0;
 
-	if (folio) {
-		bvec_set_page(&imu->bvec[0], pages[0], size, off);
-		goto done;
+	off = (unsigned long) iov->iov_base & ~PAGE_MASK;
+	if (coalesced) {
+		imu->folio_shift = data.folio_shift;
+		off += (unsigned long) data.head_page_idx << PAGE_SHIFT;
 	}
+
 	for (i = 0; i < nr_pages; i++) {
 		size_t vec_len;
 
-		vec_len = min_t(size_t, size, PAGE_SIZE - off);
+		vec_len = min_t(size_t, size, (1UL << imu->folio_shift) - off);
 		bvec_set_page(&imu->bvec[i], pages[i], vec_len, off);
 		off = 0;
 		size -= vec_len;
@@ -1073,6 +1167,8 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 	/* not inside the mapped region */
 	if (unlikely(buf_addr < imu->ubuf || buf_end > imu->ubuf_end))
 		return -EFAULT;
+	if (unlikely(!(imu->dir & (1 << ddir))))
+		return -EFAULT;
 
 	/*
 	 * Might not be a start of buffer, set size appropriately
@@ -1081,6 +1177,12 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 	offset = buf_addr - imu->ubuf;
 	iov_iter_bvec(iter, ddir, imu->bvec, imu->nr_bvecs, offset + len);
 
+	/* Kernel buffers have arbitrary bvec sizes, take the slow path */
+	if (imu->release) {
+		iov_iter_advance(iter, offset);
+		return 0;
+	}
+
 	if (offset) {
 		/*
 		 * Don't use iov_iter_advance() here, as it's really slow for
@@ -1089,8 +1191,8 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 		 * we know that:
 		 *
 		 * 1) it's a BVEC iter, we set it up
-		 * 2) all bvecs are PAGE_SIZE in size, except potentially the
-		 *    first and last bvec
+		 * 2) all bvecs are the same size (1 << folio_shift), except
+		 *    potentially the first and last bvec
 		 *
 		 * So just find our index, and adjust the iterator afterwards.
 		 * If the offset is within the first bvec (or the whole first
@@ -1101,13 +1203,6 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 		const struct bio_vec *bvec = imu->bvec;
 
 		if (offset < bvec->bv_len) {
-			/*
-			 * Note, huge pages buffers consists of one large
-			 * bvec entry and should always go this way. The other
-			 * branch doesn't expect non PAGE_SIZE'd chunks.
-			 */
-			iter->bvec = bvec;
-			iter->nr_segs = bvec->bv_len;
 			iter->count -= offset;
 			iter->iov_offset = offset;
 		} else {
@@ -1115,14 +1210,115 @@ int io_import_fixed(int ddir, struct iov_iter *iter,
 
 			/* skip first vec */
 			offset -= bvec->bv_len;
-			seg_skip = 1 + (offset >> PAGE_SHIFT);
+			seg_skip = 1 + (offset >> imu->folio_shift);
 
 			iter->bvec = bvec + seg_skip;
 			iter->nr_segs -= seg_skip;
 			iter->count -= bvec->bv_len + offset;
-			iter->iov_offset = offset & ~PAGE_MASK;
+			iter->iov_offset = offset & ((1UL << imu->folio_shift) - 1);
 		}
 	}
 
 	return 0;
 }
+
+/**
+ * io_buffer_register_bvec - register a request's pages as a fixed buffer
+ * @ioucmd: uring command issued on the ring the buffer is registered with
+ * @rq: request whose pages back the buffer
+ * @release: called with @rq once the buffer is unregistered and no longer
+ *	     used by any in-flight io_uring request
+ * @index: empty slot in the ring's fixed buffer table
+ * @issue_flags: issue flags of @ioucmd
+ *
+ * Lets a driver hand block request pages to its userspace server without a
+ * copy: the server then uses @index with READ_FIXED/WRITE_FIXED or
+ * SEND_ZC, with buffer addresses starting at 0.
+ */
+int io_buffer_register_bvec(struct io_uring_cmd *ioucmd, struct request *rq,
+			    void (*release)(void *), unsigned int index,
+			    unsigned int issue_flags)
+{
+	struct io_ring_ctx *ctx = cmd_to_io_kiocb(ioucmd)->ctx;
+	struct io_mapped_ubuf *imu;
+	struct req_iterator iter;
+	struct bio_vec bv;
+	unsigned int nr_bvecs = 0;
+	int ret = 0;
+
+	io_ring_submit_lock(ctx, issue_flags);
+	if (!ctx->buf_data || index >= ctx->nr_user_bufs) {
+		ret = -EINVAL;
+		goto unlock;
+	}
+	index = array_index_nospec(index, ctx->nr_user_bufs);
+	if (ctx->user_bufs[index] != &dummy_ubuf) {
+		ret = -EBUSY;
+		goto unlock;
+	}
+
+	rq_for_each_bvec(bv, rq, iter)
+		nr_bvecs++;
+
+	imu = kvmalloc(struct_size(imu, bvec, nr_bvecs), GFP_KERNEL);
+	if (!imu) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	imu->ubuf = 0;
+	imu->ubuf_end = blk_rq_bytes(rq);
+	imu->nr_bvecs = nr_bvecs;
+	imu->folio_shift = PAGE_SHIFT;
+	imu->acct_pages = 0;
+	imu->release = release;
+	imu->priv = rq;
+	/*
+	 * The server may only fill the pages of a read and only send those of
+	 * a write: READ is ITER_DEST and WRITE is ITER_SOURCE.
+	 */
+	imu->dir = 1 << rq_data_dir(rq);
+
+	nr_bvecs = 0;
+	rq_for_each_bvec(bv, rq, iter)
+		imu->bvec[nr_bvecs++] = bv;
+
+	ctx->user_bufs[index] = imu;
+unlock:
+	io_ring_submit_unlock(ctx, issue_flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(io_buffer_register_bvec);
+
+/**
+ * io_buffer_unregister_bvec - drop a buffer added by io_buffer_register_bvec()
+ * @ioucmd: uring command issued on the ring the buffer was registered with
+ * @index: slot the buffer was registered at
+ * @issue_flags: issue flags of @ioucmd
+ *
+ * The slot is free on return; the release callback runs once io_uring
+ * requests still using the buffer have completed.
+ */
+int io_buffer_unregister_bvec(struct io_uring_cmd *ioucmd, unsigned int index,
+			      unsigned int issue_flags)
+{
+	struct io_ring_ctx *ctx = cmd_to_io_kiocb(ioucmd)->ctx;
+	struct io_mapped_ubuf *imu;
+	int ret = -EINVAL;
+
+	io_ring_submit_lock(ctx, issue_flags);
+	if (!ctx->buf_data || index >= ctx->nr_user_bufs)
+		goto unlock;
+	index = array_index_nospec(index, ctx->nr_user_bufs);
+	imu = ctx->user_bufs[index];
+	if (imu == &dummy_ubuf || !imu->release)
+		goto unlock;
+
+	ret = io_queue_rsrc_removal(ctx->buf_data, index, imu);
+	if (!ret)
+		ctx->user_bufs[index] = (struct io_mapped_ubuf *)&dummy_ubuf;
+unlock:
+	io_ring_submit_unlock(ctx, issue_flags);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(io_buffer_unregister_bvec);
@@ -49,11 +49,23 @@ struct io_rsrc_node {
 	struct io_rsrc_put		item;
 };
 
+/* io_mapped_ubuf.dir: the iov_iter directions a buffer may be imported for */
+enum {
+	IO_IMU_DEST	= 1 << ITER_DEST,
+	IO_IMU_SOURCE	= 1 << ITER_SOURCE,
+};
+
 struct io_mapped_ubuf {
 	u64		ubuf;
 	u64		ubuf_end;
 	unsigned int	nr_bvecs;
+	/* every bvec but the first and last spans 1 << folio_shift bytes */
+	unsigned int	folio_shift;
 	unsigned long	acct_pages;
+	u8		dir;
+	/* set for kernel buffers registered by io_buffer_register_bvec() */
+	void		(*release)(void *);
+	void		*priv;
 	struct bio_vec	bvec[] __counted_by(nr_bvecs);
 };
 
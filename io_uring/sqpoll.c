@@ -24,6 +24,10 @@ enum {
 	IO_SQ_THREAD_SHOULD_PARK,
 };
 
+/* SQ threads shared by IORING_SETUP_SQ_SHARED rings */
+static DEFINE_MUTEX(io_sq_shared_lock);
+static LIST_HEAD(io_sq_shared_list);
+
 void io_sq_thread_unpark(struct io_sq_data *sqd)
 	__releases(&sqd->lock)
 {
@@ -69,6 +73,12 @@ void io_put_sq_data(struct io_sq_data *sqd)
 	if (refcount_dec_and_test(&sqd->refs)) {
 		WARN_ON_ONCE(atomic_read(&sqd->park_pending));
 
+		if (sqd->shared) {
+			mutex_lock(&io_sq_shared_lock);
+			list_del(&sqd->shared_node);
+			mutex_unlock(&io_sq_shared_lock);
+		}
+
 		io_sq_thread_stop(sqd);
 		kfree(sqd);
 	}
@@ -78,10 +88,15 @@ static __cold void io_sqd_update_thread_idle(struct io_sq_data *sqd)
 {
 	struct io_ring_ctx *ctx;
 	unsigned sq_thread_idle = 0;
+	bool adaptive = false;
 
-	list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+	list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
 		sq_thread_idle = max(sq_thread_idle, ctx->sq_thread_idle);
+		if (ctx->flags & IORING_SETUP_SQ_IDLE_ADAPTIVE)
+			adaptive = true;
+	}
 	sqd->sq_thread_idle = sq_thread_idle;
+	sqd->sq_idle_adaptive = adaptive;
 }
 
 void io_sq_thread_finish(struct io_ring_ctx *ctx)
@@ -129,12 +144,49 @@ static struct io_sq_data *io_attach_sq_data(struct io_uring_params *p)
 	return sqd;
 }
 
+static struct io_sq_data *io_find_shared_sq_data(struct io_uring_params *p)
+{
+	struct io_sq_data *sqd;
+
+	mutex_lock(&io_sq_shared_lock);
+	list_for_each_entry(sqd, &io_sq_shared_list, shared_node) {
+		/*
+		 * Only within a process: the SQ thread submits with its own
+		 * mm and file table.
+		 */
+		if (sqd->shared_cpu == p->sq_thread_cpu &&
+		    sqd->task_tgid == current->tgid &&
+		    refcount_inc_not_zero(&sqd->refs)) {
+			mutex_unlock(&io_sq_shared_lock);
+			return sqd;
+		}
+	}
+	mutex_unlock(&io_sq_shared_lock);
+	return NULL;
+}
+
+static void io_add_shared_sq_data(struct io_sq_data *sqd)
+{
+	mutex_lock(&io_sq_shared_lock);
+	sqd->shared_cpu = sqd->sq_cpu;
+	sqd->shared = true;
+	list_add(&sqd->shared_node, &io_sq_shared_list);
+	mutex_unlock(&io_sq_shared_lock);
+}
+
 static struct io_sq_data *io_get_sq_data(struct io_uring_params *p,
 					 bool *attached)
 {
 	struct io_sq_data *sqd;
 
 	*attached = false;
+	if (p->flags & IORING_SETUP_SQ_SHARED) {
+		sqd = io_find_shared_sq_data(p);
+		if (sqd) {
+			*attached = true;
+			return sqd;
+		}
+	}
 	if (p->flags & IORING_SETUP_ATTACH_WQ) {
 		sqd = io_attach_sq_data(p);
 		if (!IS_ERR(sqd)) {
@@ -153,6 +205,7 @@ static struct io_sq_data *io_get_sq_data(struct io_uring_params *p,
 	atomic_set(&sqd->park_pending, 0);
 	refcount_set(&sqd->refs, 1);
 	INIT_LIST_HEAD(&sqd->ctx_list);
+	INIT_LIST_HEAD(&sqd->shared_node);
 	mutex_init(&sqd->lock);
 	init_waitqueue_head(&sqd->wait);
 	init_completion(&sqd->exited);
@@ -164,6 +217,49 @@ static inline bool io_sqd_events_pending(struct io_sq_data *sqd)
 	return READ_ONCE(sqd->state);
 }
 
+/*
+ * Track the average time between submissions of a ring, samples capped
+ * at its sq_thread_idle so one long pause doesn't dominate.
+ */
+static void io_sq_update_gap(struct io_ring_ctx *ctx)
+{
+	u64 now = ktime_get_ns();
+
+	if (ctx->sq_last_submit_ns) {
+		u64 gap = min_t(u64, now - ctx->sq_last_submit_ns,
+				jiffies_to_nsecs(ctx->sq_thread_idle));
+
+		ctx->sq_gap_ns = ctx->sq_gap_ns ?
+				 (ctx->sq_gap_ns * 7 + gap) >> 3 : gap;
+	}
+	ctx->sq_last_submit_ns = now;
+}
+
+static unsigned long io_sq_ctx_idle(struct io_ring_ctx *ctx)
+{
+	unsigned long idle;
+
+	if (!(ctx->flags & IORING_SETUP_SQ_IDLE_ADAPTIVE) || !ctx->sq_gap_ns)
+		return ctx->sq_thread_idle;
+
+	idle = nsecs_to_jiffies(2 * ctx->sq_gap_ns);
+	return clamp(idle, 1UL, (unsigned long)ctx->sq_thread_idle);
+}
+
+/* How long the SQ thread keeps spinning without finding work */
+static unsigned long io_sqd_thread_idle(struct io_sq_data *sqd)
+{
+	struct io_ring_ctx *ctx;
+	unsigned long idle = 0;
+
+	if (!sqd->sq_idle_adaptive)
+		return sqd->sq_thread_idle;
+
+	list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+		idle = max(idle, io_sq_ctx_idle(ctx));
+	return idle;
+}
+
 static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 {
 	unsigned int to_submit;
@@ -193,6 +289,9 @@ static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 			ret = io_submit_sqes(ctx, to_submit);
 		mutex_unlock(&ctx->uring_lock);
 
+		if (ret > 0 && (ctx->flags & IORING_SETUP_SQ_IDLE_ADAPTIVE))
+			io_sq_update_gap(ctx);
+
 		if (to_submit && wq_has_sleeper(&ctx->sqo_sq_wait))
 			wake_up(&ctx->sqo_sq_wait);
 		if (creds)
@@ -247,7 +346,7 @@ static int io_sq_thread(void *data)
 		if (io_sqd_events_pending(sqd) || signal_pending(current)) {
 			if (io_sqd_handle_event(sqd))
 				break;
-			timeout = jiffies + sqd->sq_thread_idle;
+			timeout = jiffies + io_sqd_thread_idle(sqd);
 		}
 
 		cap_entries = !list_is_singular(&sqd->ctx_list);
@@ -262,7 +361,7 @@ static int io_sq_thread(void *data)
 
 		if (sqt_spin || !time_after(jiffies, timeout)) {
 			if (sqt_spin)
-				timeout = jiffies + sqd->sq_thread_idle;
+				timeout = jiffies + io_sqd_thread_idle(sqd);
 			if (unlikely(need_resched())) {
 				mutex_unlock(&sqd->lock);
 				cond_resched();
@@ -309,7 +408,7 @@ static int io_sq_thread(void *data)
 		}
 
 		finish_wait(&sqd->wait, &wait);
-		timeout = jiffies + sqd->sq_thread_idle;
+		timeout = jiffies + io_sqd_thread_idle(sqd);
 	}
 
 	io_uring_cancel_generic(true, sqd);
@@ -345,6 +444,16 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 {
 	int ret;
 
+	if ((ctx->flags & (IORING_SETUP_SQ_IDLE_ADAPTIVE |
+			   IORING_SETUP_SQ_SHARED)) &&
+	    !(ctx->flags & IORING_SETUP_SQPOLL))
+		return -EINVAL;
+	/* A shared SQ thread is found by CPU, not by ring fd */
+	if ((ctx->flags & IORING_SETUP_SQ_SHARED) &&
+	    (ctx->flags & (IORING_SETUP_SQ_AFF | IORING_SETUP_ATTACH_WQ)) !=
+	    IORING_SETUP_SQ_AFF)
+		return -EINVAL;
+
 	/* Retain compatibility with failing for an invalid attach attempt */
 	if ((ctx->flags & (IORING_SETUP_ATTACH_WQ | IORING_SETUP_SQPOLL)) ==
 				IORING_SETUP_ATTACH_WQ) {
@@ -416,6 +525,8 @@ __cold int io_sq_offload_create(struct io_ring_ctx *ctx,
 		wake_up_new_task(tsk);
 		if (ret)
 			goto err;
+		if (p->flags & IORING_SETUP_SQ_SHARED)
+			io_add_shared_sq_data(sqd);
 	} else if (p->flags & IORING_SETUP_SQ_AFF) {
 		/* Can't have SQ_AFF without SQPOLL */
 		ret = -EINVAL;
@@ -446,3 +557,21 @@ __cold int io_sqpoll_wq_cpu_affinity(struct io_ring_ctx *ctx,
 
 	return ret;
 }
+
+__cold int io_sqpoll_wq_aff_policy(struct io_ring_ctx *ctx,
+				   unsigned int policy,
+				   unsigned int min_capacity)
+{
+	struct io_sq_data *sqd = ctx->sq_data;
+	int ret = -EINVAL;
+
+	if (sqd) {
+		io_sq_thread_park(sqd);
+		if (sqd->thread)
+			ret = io_wq_aff_policy(sqd->thread->io_uring, policy,
+					       min_capacity);
+		io_sq_thread_unpark(sqd);
+	}
+
+	return ret;
+}
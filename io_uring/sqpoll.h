@@ -12,12 +12,18 @@ struct io_sq_data {
 	struct wait_queue_head	wait;
 
 	unsigned		sq_thread_idle;
+	bool			sq_idle_adaptive;
 	int			sq_cpu;
 	pid_t			task_pid;
 	pid_t			task_tgid;
 
 	unsigned long		state;
 	struct completion	exited;
+
+	/* IORING_SETUP_SQ_SHARED, on io_sq_shared_list */
+	struct list_head	shared_node;
+	int			shared_cpu;
+	bool			shared;
 };
 
 int io_sq_offload_create(struct io_ring_ctx *ctx, struct io_uring_params *p);
@@ -28,3 +34,5 @@ void io_sq_thread_unpark(struct io_sq_data *sqd);
 void io_put_sq_data(struct io_sq_data *sqd);
 void io_sqpoll_wait_sq(struct io_ring_ctx *ctx);
 int io_sqpoll_wq_cpu_affinity(struct io_ring_ctx *ctx, cpumask_var_t mask);
+int io_sqpoll_wq_aff_policy(struct io_ring_ctx *ctx, unsigned int policy,
+			    unsigned int min_capacity);
@@ -1675,6 +1675,45 @@ static int htab_lru_percpu_map_lookup_and_delete_elem(struct bpf_map *map,
 						 flags);
 }
 
+/* Copy the per-CPU values of an element whose value is an array of u64
+ * counters. With BPF_F_BATCH_RESET each counter is atomically exchanged
+ * with zero, so that atomic increments done concurrently by programs are
+ * never lost. With BPF_F_BATCH_AGGREGATE the counters are summed over all
+ * CPUs instead of being returned per CPU.
+ */
+static void htab_percpu_copy_counters(const struct bpf_map *map,
+				      void __percpu *pptr, void *dst,
+				      u64 flags)
+{
+	u32 words = map->value_size / sizeof(u64);
+	u64 *out = dst;
+	int cpu, i;
+
+	if (flags & BPF_F_BATCH_AGGREGATE)
+		memset(out, 0, map->value_size);
+
+	for_each_possible_cpu(cpu) {
+		u64 *val = per_cpu_ptr(pptr, cpu);
+
+		for (i = 0; i < words; i++) {
+			u64 v;
+
+			if (flags & BPF_F_BATCH_RESET)
+				v = atomic64_xchg((atomic64_t *)&val[i], 0);
+			else
+				v = READ_ONCE(val[i]);
+
+			if (flags & BPF_F_BATCH_AGGREGATE)
+				out[i] += v;
+			else
+				out[i] = v;
+		}
+
+		if (!(flags & BPF_F_BATCH_AGGREGATE))
+			out += words;
+	}
+}
+
 static int
 __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 				   const union bpf_attr *attr,
@@ -1705,7 +1744,14 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 		return -EINVAL;
 
 	map_flags = attr->batch.flags;
-	if (map_flags)
+	if (map_flags & ~(BPF_F_BATCH_RESET | BPF_F_BATCH_AGGREGATE))
+		return -EINVAL;
+
+	/* Counter flags need plain u64 counters in a per-CPU map */
+	if (map_flags &&
+	    (!is_percpu || (map->value_size % sizeof(u64)) ||
+	     !IS_ERR_OR_NULL(map->record) ||
+	     (do_delete && (map_flags & BPF_F_BATCH_RESET))))
 		return -EINVAL;
 
 	max_count = attr->batch.count;
@@ -1726,7 +1772,7 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 	roundup_key_size = round_up(htab->map.key_size, 8);
 	value_size = htab->map.value_size;
 	size = round_up(value_size, 8);
-	if (is_percpu)
+	if (is_percpu && !(map_flags & BPF_F_BATCH_AGGREGATE))
 		value_size = size * num_possible_cpus();
 	total = 0;
 	/* while experimenting with hash tables with sizes ranging from 10 to
@@ -1809,10 +1855,15 @@ __htab_map_lookup_and_delete_batch(struct bpf_map *map,
 			void __percpu *pptr;
 
 			pptr = htab_elem_get_ptr(l, map->key_size);
-			for_each_possible_cpu(cpu) {
-				copy_map_value_long(&htab->map, dst_val + off, per_cpu_ptr(pptr, cpu));
-				check_and_init_map_value(&htab->map, dst_val + off);
-				off += size;
+			if (map_flags) {
+				htab_percpu_copy_counters(map, pptr, dst_val,
+							  map_flags);
+			} else {
+				for_each_possible_cpu(cpu) {
+					copy_map_value_long(&htab->map, dst_val + off, per_cpu_ptr(pptr, cpu));
+					check_and_init_map_value(&htab->map, dst_val + off);
+					off += size;
+				}
 			}
 		} else {
 			value = l->key + roundup_key_size;
@@ -12,7 +12,7 @@
 #include <uapi/linux/btf.h>
 #include <linux/btf_ids.h>
 
-#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE)
+#define RINGBUF_CREATE_FLAG_MASK (BPF_F_NUMA_NODE | BPF_F_RB_OVERWRITE)
 
 /* non-mmap()'able part of bpf_ringbuf (everything up to consumer page) */
 #define RINGBUF_PGOFF \
@@ -29,6 +29,7 @@ struct bpf_ringbuf {
 	u64 mask;
 	struct page **pages;
 	int nr_pages;
+	bool overwrite_mode;
 	spinlock_t spinlock ____cacheline_aligned_in_smp;
 	/* For user-space producer ring buffers, an atomic_t busy bit is used
 	 * to synchronize access to the ring buffers in the kernel, rather than
@@ -67,9 +68,18 @@ struct bpf_ringbuf {
 	 * communicate to the kernel, but the kernel must carefully check and
 	 * validate each sample to ensure that they're correctly formatted, and
 	 * fully contained within the ring buffer.
+	 *
+	 * The overwrite position and the loss counters share the producer
+	 * page, so a kernel-producer ring buffer exposes them r/o to
+	 * user-space. In overwrite mode, a consumer that finds overwrite_pos
+	 * ahead of its own position must skip forward to it: everything
+	 * before overwrite_pos may already have been reused.
 	 */
 	unsigned long consumer_pos __aligned(PAGE_SIZE);
 	unsigned long producer_pos __aligned(PAGE_SIZE);
+	unsigned long overwrite_pos;
+	atomic_long_t dropped;
+	unsigned long overwritten;
 	char data[] __aligned(PAGE_SIZE);
 };
 
@@ -179,6 +189,9 @@ static struct bpf_ringbuf *bpf_ringbuf_alloc(size_t data_sz, int numa_node)
 	rb->mask = data_sz - 1;
 	rb->consumer_pos = 0;
 	rb->producer_pos = 0;
+	rb->overwrite_pos = 0;
+	atomic_long_set(&rb->dropped, 0);
+	rb->overwritten = 0;
 
 	return rb;
 }
@@ -190,6 +203,11 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 	if (attr->map_flags & ~RINGBUF_CREATE_FLAG_MASK)
 		return ERR_PTR(-EINVAL);
 
+	/* only the kernel producer side knows how to overwrite records */
+	if ((attr->map_flags & BPF_F_RB_OVERWRITE) &&
+	    attr->map_type != BPF_MAP_TYPE_RINGBUF)
+		return ERR_PTR(-EINVAL);
+
 	if (attr->key_size || attr->value_size ||
 	    !is_power_of_2(attr->max_entries) ||
 	    !PAGE_ALIGNED(attr->max_entries))
@@ -206,6 +224,7 @@ static struct bpf_map *ringbuf_map_alloc(union bpf_attr *attr)
 		bpf_map_area_free(rb_map);
 		return ERR_PTR(-ENOMEM);
 	}
+	rb_map->rb->overwrite_mode = !!(attr->map_flags & BPF_F_RB_OVERWRITE);
 
 	return &rb_map->map;
 }
@@ -295,10 +314,15 @@ static int ringbuf_map_mmap_user(struct bpf_map *map, struct vm_area_struct *vma
 
 static unsigned long ringbuf_avail_data_sz(struct bpf_ringbuf *rb)
 {
-	unsigned long cons_pos, prod_pos;
+	unsigned long cons_pos, prod_pos, over_pos;
 
 	cons_pos = smp_load_acquire(&rb->consumer_pos);
 	prod_pos = smp_load_acquire(&rb->producer_pos);
+	if (rb->overwrite_mode) {
+		over_pos = smp_load_acquire(&rb->overwrite_pos);
+		if ((long)(over_pos - cons_pos) > 0)
+			cons_pos = over_pos;
+	}
 	return prod_pos - cons_pos;
 }
 
@@ -402,6 +426,48 @@ bpf_ringbuf_restore_from_rec(struct bpf_ringbuf_hdr *hdr)
 	return (void*)((addr & PAGE_MASK) - off);
 }
 
+/* Overwrite mode: make room for a record ending at new_prod_pos by moving
+ * overwrite_pos past the oldest committed records. A record that is still
+ * being written can't be reclaimed, in which case nothing is overwritten and
+ * the new record is dropped instead. Called with rb->spinlock held.
+ *
+ * The walk starts from overwrite_pos rather than from the user-writable
+ * consumer_pos: overwrite_pos only ever moves in kernel-written record
+ * steps, and every record between it and producer_pos is intact. The
+ * consumer position only decides which reclaimed records were unread.
+ */
+static bool bpf_ringbuf_overwrite_oldest(struct bpf_ringbuf *rb,
+					 unsigned long cons_pos,
+					 unsigned long prod_pos,
+					 unsigned long new_prod_pos)
+{
+	unsigned long over_pos = rb->overwrite_pos;
+	struct bpf_ringbuf_hdr *hdr;
+	unsigned long nr = 0;
+	u32 hdr_len;
+
+	while (new_prod_pos - over_pos > rb->mask) {
+		if ((long)(over_pos - prod_pos) >= 0)
+			return false;
+		hdr = (void *)rb->data + (over_pos & rb->mask);
+		hdr_len = READ_ONCE(hdr->len);
+		if (hdr_len & BPF_RINGBUF_BUSY_BIT)
+			return false;
+		/* records the consumer has read or that were discarded are free */
+		if ((long)(over_pos - cons_pos) >= 0 &&
+		    !(hdr_len & BPF_RINGBUF_DISCARD_BIT))
+			nr++;
+		over_pos += round_up((hdr_len & ~BPF_RINGBUF_DISCARD_BIT) +
+				     BPF_RINGBUF_HDR_SZ, 8);
+	}
+
+	if (nr)
+		WRITE_ONCE(rb->overwritten, rb->overwritten + nr);
+	/* pairs with consumer's smp_load_acquire() */
+	smp_store_release(&rb->overwrite_pos, over_pos);
+	return true;
+}
+
 static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 {
 	unsigned long cons_pos, prod_pos, new_prod_pos, flags;
@@ -413,13 +479,13 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 
 	len = round_up(size + BPF_RINGBUF_HDR_SZ, 8);
 	if (len > ringbuf_total_data_sz(rb))
-		return NULL;
+		goto drop;
 
 	cons_pos = smp_load_acquire(&rb->consumer_pos);
 
 	if (in_nmi()) {
 		if (!spin_trylock_irqsave(&rb->spinlock, flags))
-			return NULL;
+			goto drop;
 	} else {
 		spin_lock_irqsave(&rb->spinlock, flags);
 	}
@@ -430,9 +496,12 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 	/* check for out of ringbuf space by ensuring producer position
 	 * doesn't advance more than (ringbuf_size - 1) ahead
 	 */
-	if (new_prod_pos - cons_pos > rb->mask) {
-		spin_unlock_irqrestore(&rb->spinlock, flags);
-		return NULL;
+	if (rb->overwrite_mode) {
+		if (!bpf_ringbuf_overwrite_oldest(rb, cons_pos, prod_pos,
+						  new_prod_pos))
+			goto drop_unlock;
+	} else if (new_prod_pos - cons_pos > rb->mask) {
+		goto drop_unlock;
 	}
 
 	hdr = (void *)rb->data + (prod_pos & rb->mask);
@@ -446,6 +515,12 @@ static void *__bpf_ringbuf_reserve(struct bpf_ringbuf *rb, u64 size)
 	spin_unlock_irqrestore(&rb->spinlock, flags);
 
 	return (void *)hdr + BPF_RINGBUF_HDR_SZ;
+
+drop_unlock:
+	spin_unlock_irqrestore(&rb->spinlock, flags);
+drop:
+	atomic_long_inc(&rb->dropped);
+	return NULL;
 }
 
 BPF_CALL_3(bpf_ringbuf_reserve, struct bpf_map *, map, u64, size, u64, flags)
@@ -469,7 +544,7 @@ const struct bpf_func_proto bpf_ringbuf_reserve_proto = {
 
 static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 {
-	unsigned long rec_pos, cons_pos;
+	unsigned long rec_pos, cons_pos, over_pos;
 	struct bpf_ringbuf_hdr *hdr;
 	struct bpf_ringbuf *rb;
 	u32 new_len;
@@ -487,7 +562,14 @@ static void bpf_ringbuf_commit(void *sample, u64 flags, bool discard)
 	 * new data availability
 	 */
 	rec_pos = (void *)hdr - (void *)rb->data;
-	cons_pos = smp_load_acquire(&rb->consumer_pos) & rb->mask;
+	cons_pos = smp_load_acquire(&rb->consumer_pos);
+	if (rb->overwrite_mode) {
+		/* a lagging consumer resumes at the overwrite position */
+		over_pos = smp_load_acquire(&rb->overwrite_pos);
+		if ((long)(over_pos - cons_pos) > 0)
+			cons_pos = over_pos;
+	}
+	cons_pos &= rb->mask;
 
 	if (flags & BPF_RB_FORCE_WAKEUP)
 		irq_work_queue(&rb->work);
@@ -564,6 +646,12 @@ BPF_CALL_2(bpf_ringbuf_query, struct bpf_map *, map, u64, flags)
 		return smp_load_acquire(&rb->consumer_pos);
 	case BPF_RB_PROD_POS:
 		return smp_load_acquire(&rb->producer_pos);
+	case BPF_RB_OVERWRITE_POS:
+		return smp_load_acquire(&rb->overwrite_pos);
+	case BPF_RB_DROPPED:
+		return atomic_long_read(&rb->dropped);
+	case BPF_RB_OVERWRITTEN:
+		return READ_ONCE(rb->overwritten);
 	default:
 		return 0;
 	}
@@ -4923,7 +4923,8 @@ static int bpf_map_do_batch(const union bpf_attr *attr,
 {
 	bool has_read  = cmd == BPF_MAP_LOOKUP_BATCH ||
 			 cmd == BPF_MAP_LOOKUP_AND_DELETE_BATCH;
-	bool has_write = cmd != BPF_MAP_LOOKUP_BATCH;
+	bool has_write = cmd != BPF_MAP_LOOKUP_BATCH ||
+			 (attr->batch.flags & BPF_F_BATCH_RESET);
 	struct bpf_map *map;
 	int err, ufd;
 	struct fd f;
@@ -265,6 +265,11 @@ int cgroup_show_path(struct seq_file *sf, struct kernfs_node *kf_node,
 int __cgroup_task_count(const struct cgroup *cgrp);
 int cgroup_task_count(const struct cgroup *cgrp);
 
+/*
+ * freezer.c
+ */
+void cgroup_freezer_exit_task(struct task_struct *task);
+
 /*
  * rstat.c
  */
@@ -3823,6 +3823,43 @@ static ssize_t cgroup_irq_pressure_write(struct kernfs_open_file *of,
 }
 #endif
 
+/**
+ * cgroup_subtree_for_each_task - visit the tasks of a cgroup and descendants
+ * @cgrp: root of the subtree
+ * @fn: called for each task
+ * @data: passed to @fn
+ *
+ * Exiting tasks are visited too, they keep their cgroup until released.
+ * The caller holds cgroup_mutex and css_set_lock, so that no task can enter
+ * or leave the subtree meanwhile.
+ */
+void cgroup_subtree_for_each_task(struct cgroup *cgrp,
+				  void (*fn)(struct task_struct *, void *),
+				  void *data)
+{
+	struct cgroup_subsys_state *d_css;
+	struct cgrp_cset_link *link;
+	struct task_struct *task;
+
+	lockdep_assert_held(&cgroup_mutex);
+	lockdep_assert_held(&css_set_lock);
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(d_css, &cgrp->self) {
+		list_for_each_entry(link, &d_css->cgroup->cset_links, cset_link) {
+			struct css_set *cset = link->cset;
+
+			list_for_each_entry(task, &cset->tasks, cg_list)
+				fn(task, data);
+			list_for_each_entry(task, &cset->mg_tasks, cg_list)
+				fn(task, data);
+			list_for_each_entry(task, &cset->dying_tasks, cg_list)
+				fn(task, data);
+		}
+	}
+	rcu_read_unlock();
+}
+
 static int cgroup_pressure_show(struct seq_file *seq, void *v)
 {
 	struct cgroup *cgrp = seq_css(seq)->cgroup;
@@ -3861,9 +3898,7 @@ static ssize_t cgroup_pressure_write(struct kernfs_open_file *of,
 		for (i = 0; i < NR_PSI_RESOURCES; i++)
 			cgroup_file_show(&cgrp->psi_files[i], enable);
 
-		psi->enabled = enable;
-		if (enable)
-			psi_cgroup_restart(psi);
+		psi_cgroup_set_enabled(cgrp, enable);
 	}
 
 	cgroup_kn_unlock(of->kn);
@@ -6693,6 +6728,8 @@ void cgroup_exit(struct task_struct *tsk)
 	if (dl_task(tsk))
 		dec_dl_tasks_cs(tsk);
 
+	if (unlikely(tsk->jobctl & JOBCTL_FREEZE_LAZY))
+		cgroup_freezer_exit_task(tsk);
 	WARN_ON_ONCE(cgroup_task_frozen(tsk));
 	if (unlikely(!(tsk->flags & PF_KTHREAD) &&
 		     test_bit(CGRP_FREEZE, &task_dfl_cgroup(tsk)->flags)))
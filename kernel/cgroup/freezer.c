@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0
 #include <linux/cgroup.h>
+#include <linux/freezer.h>
 #include <linux/sched.h>
 #include <linux/sched/task.h>
 #include <linux/sched/signal.h>
+#include <linux/sched/wake_q.h>
 
 #include "cgroup-internal.h"
 
@@ -115,7 +117,14 @@ void cgroup_enter_frozen(void)
 	spin_lock_irq(&css_set_lock);
 	current->frozen = true;
 	cgrp = task_dfl_cgroup(current);
-	cgroup_inc_frozen_cnt(cgrp);
+	if (current->jobctl & JOBCTL_FREEZE_LAZY) {
+		/* Already counted by cgroup_freeze_task(), just take it over */
+		spin_lock(&current->sighand->siglock);
+		current->jobctl &= ~JOBCTL_FREEZE_LAZY;
+		spin_unlock(&current->sighand->siglock);
+	} else {
+		cgroup_inc_frozen_cnt(cgrp);
+	}
 	cgroup_update_frozen(cgrp);
 	spin_unlock_irq(&css_set_lock);
 }
@@ -138,8 +147,14 @@ void cgroup_leave_frozen(bool always_leave)
 	if (always_leave || !test_bit(CGRP_FREEZE, &cgrp->flags)) {
 		cgroup_dec_frozen_cnt(cgrp);
 		cgroup_update_frozen(cgrp);
-		WARN_ON_ONCE(!current->frozen);
-		current->frozen = false;
+		if (current->jobctl & JOBCTL_FREEZE_LAZY) {
+			spin_lock(&current->sighand->siglock);
+			current->jobctl &= ~JOBCTL_FREEZE_LAZY;
+			spin_unlock(&current->sighand->siglock);
+		} else {
+			WARN_ON_ONCE(!current->frozen);
+			current->frozen = false;
+		}
 	} else if (!(current->jobctl & JOBCTL_TRAP_FREEZE)) {
 		spin_lock(&current->sighand->siglock);
 		current->jobctl |= JOBCTL_TRAP_FREEZE;
@@ -149,28 +164,132 @@ void cgroup_leave_frozen(bool always_leave)
 	spin_unlock_irq(&css_set_lock);
 }
 
+/*
+ * A lazily frozen task can exit straight from the kernel without ever
+ * trapping, give its frozen count back.
+ */
+void cgroup_freezer_exit_task(struct task_struct *task)
+{
+	lockdep_assert_held(&css_set_lock);
+
+	spin_lock(&task->sighand->siglock);
+	if (task->jobctl & JOBCTL_FREEZE_LAZY) {
+		task->jobctl &= ~JOBCTL_FREEZE_LAZY;
+		cgroup_dec_frozen_cnt(task_dfl_cgroup(task));
+	}
+	spin_unlock(&task->sighand->siglock);
+}
+
+/*
+ * Try to freeze a blocked task without waking it up.
+ *
+ * A task that is blocked can only get back to userspace through get_signal(),
+ * where JOBCTL_TRAP_FREEZE makes it enter do_freezer_trap(). So it can be
+ * counted frozen right away and left asleep: it will trap on its own when
+ * something else wakes it up, and the cgroup reports "frozen" without having
+ * to wake every thread just to put it back to sleep. JOBCTL_FREEZE_LAZY marks
+ * the task as counted; cgroup_enter_frozen() takes the count over.
+ *
+ * Must be called with css_set_lock and the task's siglock held; the lazy bit
+ * is only changed under both, so either lock is enough to read it.
+ */
+static bool cgroup_freeze_task_lazy(struct task_struct *task)
+{
+	bool blocked;
+
+	/* rtlock waiters look blocked, but aren't sleeping where they seem */
+	if (IS_ENABLED(CONFIG_PREEMPT_RT))
+		return false;
+
+	/* io workers run queued work before checking for signals */
+	if (task->flags & (PF_EXITING | PF_IO_WORKER))
+		return false;
+
+	/* Already counted, e.g. when migrating between frozen cgroups */
+	if (task->jobctl & JOBCTL_FREEZE_LAZY)
+		return true;
+
+	/* Stopped, traced or already in the freezer trap */
+	if (cgroup_task_frozen(task))
+		return false;
+
+	/*
+	 * A wakeup takes ->pi_lock, so once it is dropped the waker is
+	 * guaranteed to see TIF_SIGPENDING and the task traps before it
+	 * returns to userspace.
+	 */
+	raw_spin_lock(&task->pi_lock);
+	blocked = READ_ONCE(task->__state) != TASK_RUNNING &&
+		  !READ_ONCE(task->on_rq);
+	if (blocked) {
+		task->jobctl |= JOBCTL_TRAP_FREEZE | JOBCTL_FREEZE_LAZY;
+		set_tsk_thread_flag(task, TIF_SIGPENDING);
+	}
+	raw_spin_unlock(&task->pi_lock);
+
+	if (blocked)
+		cgroup_inc_frozen_cnt(task_dfl_cgroup(task));
+
+	return blocked;
+}
+
 /*
  * Freeze or unfreeze the task by setting or clearing the JOBCTL_TRAP_FREEZE
- * jobctl bit.
+ * jobctl bit. Blocked tasks are frozen lazily, see cgroup_freeze_task_lazy().
+ *
+ * If @wake_q is given, wakeups of thawed tasks are queued on it so that the
+ * caller can issue them in one batch once it has walked all tasks.
  */
-static void cgroup_freeze_task(struct task_struct *task, bool freeze)
+static void cgroup_freeze_task(struct task_struct *task, bool freeze,
+			       struct wake_q_head *wake_q)
 {
 	unsigned long flags;
 	bool wake = true;
 
+	lockdep_assert_held(&css_set_lock);
+
 	/* If the task is about to die, don't bother with freezing it. */
 	if (!lock_task_sighand(task, &flags))
 		return;
 
 	trace_android_vh_freeze_whether_wake(task, &wake);
 	if (freeze) {
-		task->jobctl |= JOBCTL_TRAP_FREEZE;
-		if (wake)
-			signal_wake_up(task, false);
+		if (!cgroup_freeze_task_lazy(task)) {
+			task->jobctl |= JOBCTL_TRAP_FREEZE;
+			if (wake)
+				signal_wake_up(task, false);
+		}
 	} else {
 		task->jobctl &= ~JOBCTL_TRAP_FREEZE;
-		if (wake)
-			wake_up_process(task);
+		if (task->jobctl & JOBCTL_FREEZE_LAZY) {
+			task->jobctl &= ~JOBCTL_FREEZE_LAZY;
+			cgroup_dec_frozen_cnt(task_dfl_cgroup(task));
+			/*
+			 * Still blocked where it was frozen: it never saw the
+			 * trap and has nothing to get out of, so take back the
+			 * TIF_SIGPENDING cgroup_freeze_task_lazy() set, or its
+			 * wait would end early as if a signal had come in.
+			 * ->siglock keeps signals from being sent meanwhile,
+			 * ->pi_lock keeps it asleep. Otherwise it may be on
+			 * its way into do_freezer_trap(), kick it.
+			 */
+			raw_spin_lock(&task->pi_lock);
+			if (READ_ONCE(task->__state) != TASK_RUNNING &&
+			    !READ_ONCE(task->on_rq)) {
+				if (!recalc_sigpending_tsk(task) &&
+				    !freezing(task))
+					clear_tsk_thread_flag(task,
+							      TIF_SIGPENDING);
+				wake = false;
+			}
+			raw_spin_unlock(&task->pi_lock);
+		}
+		if (wake) {
+			if (wake_q)
+				wake_q_add(wake_q, task);
+			else
+				wake_up_process(task);
+		}
 	}
 
 	unlock_task_sighand(task, &flags);
@@ -183,6 +302,7 @@ static void cgroup_do_freeze(struct cgroup *cgrp, bool freeze)
 {
 	struct css_task_iter it;
 	struct task_struct *task;
+	DEFINE_WAKE_Q(wake_q);
 
 	lockdep_assert_held(&cgroup_mutex);
 
@@ -206,10 +326,15 @@ static void cgroup_do_freeze(struct cgroup *cgrp, bool freeze)
 		 */
 		if (task->flags & PF_KTHREAD)
 			continue;
-		cgroup_freeze_task(task, freeze);
+		spin_lock_irq(&css_set_lock);
+		cgroup_freeze_task(task, freeze, &wake_q);
+		spin_unlock_irq(&css_set_lock);
 	}
 	css_task_iter_end(&it);
 
+	/* Thaw: wake up everything that was trapped in one go */
+	wake_up_q(&wake_q);
+
 	/*
 	 * Cgroup state should be revisited here to cover empty leaf cgroups
 	 * and cgroups which descendants are already in the desired state.
@@ -241,7 +366,7 @@ void cgroup_freezer_migrate_task(struct task_struct *task,
 	 */
 	if (!test_bit(CGRP_FREEZE, &src->flags) &&
 	    !test_bit(CGRP_FREEZE, &dst->flags) &&
-	    !task->frozen)
+	    !cgroup_task_frozen(task))
 		return;
 
 	/*
@@ -249,17 +374,20 @@ void cgroup_freezer_migrate_task(struct task_struct *task,
 	 * Note, that if the task is frozen, but the destination cgroup is not
 	 * frozen, we bump both counters to keep them balanced.
 	 */
-	if (task->frozen) {
+	if (cgroup_task_frozen(task)) {
 		cgroup_inc_frozen_cnt(dst);
 		cgroup_dec_frozen_cnt(src);
 	}
-	cgroup_update_frozen(dst);
-	cgroup_update_frozen(src);
 
 	/*
-	 * Force the task to the desired state.
+	 * Force the task to the desired state. This can change the frozen
+	 * count of dst if the task gets frozen lazily, so do it before the
+	 * state of the cgroups is revisited.
 	 */
-	cgroup_freeze_task(task, test_bit(CGRP_FREEZE, &dst->flags));
+	cgroup_freeze_task(task, test_bit(CGRP_FREEZE, &dst->flags), NULL);
+
+	cgroup_update_frozen(dst);
+	cgroup_update_frozen(src);
 }
 
 void cgroup_freeze(struct cgroup *cgrp, bool freeze)
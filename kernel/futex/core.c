@@ -37,6 +37,7 @@
 #include <linux/memblock.h>
 #include <linux/fault-inject.h>
 #include <linux/slab.h>
+#include <linux/prctl.h>
 
 #include "futex.h"
 #include "../locking/rtmutex_common.h"
@@ -106,17 +107,145 @@ late_initcall(fail_futex_debugfs);
 
 #endif /* CONFIG_FAIL_FUTEX */
 
+/*
+ * Process private futex hash.
+ *
+ * Private futexes of a multi-threaded process are hashed into a table that
+ * belongs to its mm, so that busy processes do not collide with each other
+ * in the global hash. Bucket lock contention is bounded by the number of
+ * CPUs doing futex operations at the same time, so by default the table has
+ * four buckets per CPU; a process that expects many sleeping waiters can ask
+ * for more with prctl(PR_FUTEX_HASH).
+ *
+ * Waiters that are already queued are never moved between tables, so the
+ * table is only installed while nothing can be queued for the mm: when the
+ * first thread is created, with the parent as the only user of the mm, and
+ * before it could have left an asynchronous io_uring futex wait behind.
+ */
+struct futex_private_hash {
+	unsigned int			hash_mask;
+	struct futex_hash_bucket	queues[];
+};
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+#define FUTEX_PRIVATE_HASH_MIN	16
+
+static struct futex_private_hash *futex_private_hash(union futex_key *key)
+{
+	struct mm_struct *mm = key->private.mm;
+
+	if (key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))
+		return NULL;
+	if (!mm)
+		return NULL;
+
+	/* Pairs with the smp_store_release() in futex_private_hash_alloc() */
+	return smp_load_acquire(&mm->futex_phash);
+}
+
+static bool futex_private_hash_slots_valid(unsigned long slots)
+{
+	return is_power_of_2(slots) && slots >= FUTEX_PRIVATE_HASH_MIN &&
+	       slots <= futex_hashsize;
+}
+
+/**
+ * futex_private_hash_alloc - Give @current's mm a private futex hash
+ *
+ * Called from copy_process() before @current creates a thread. Failure is
+ * not fatal, the private futexes then keep using the global hash.
+ */
+void futex_private_hash_alloc(void)
+{
+	struct mm_struct *mm = current->mm;
+	struct futex_private_hash *fph;
+	unsigned int i, slots;
+
+	if (!mm || mm->futex_phash || atomic_read(&mm->mm_users) != 1)
+		return;
+#ifdef CONFIG_IO_URING
+	if (current->io_uring)
+		return;
+#endif
+
+	slots = mm->futex_hash_slots;
+	if (!slots)
+		slots = max_t(unsigned int, FUTEX_PRIVATE_HASH_MIN,
+			      roundup_pow_of_two(4 * num_possible_cpus()));
+	slots = min_t(unsigned int, slots, futex_hashsize);
+
+	fph = kvzalloc(struct_size(fph, queues, slots), GFP_KERNEL_ACCOUNT);
+	if (!fph)
+		return;
+
+	fph->hash_mask = slots - 1;
+	for (i = 0; i < slots; i++) {
+		atomic_set(&fph->queues[i].waiters, 0);
+		plist_head_init(&fph->queues[i].chain);
+		spin_lock_init(&fph->queues[i].lock);
+	}
+
+	smp_store_release(&mm->futex_phash, fph);
+}
+
+void futex_mm_init(struct mm_struct *mm)
+{
+	/* dup_mm() copied the parent's table, only the slots hint is inherited */
+	mm->futex_phash = NULL;
+}
+
+void futex_private_hash_free(struct mm_struct *mm)
+{
+	kvfree(mm->futex_phash);
+	mm->futex_phash = NULL;
+}
+
+int futex_hash_prctl(unsigned long op, unsigned long arg)
+{
+	struct mm_struct *mm = current->mm;
+
+	switch (op) {
+	case PR_FUTEX_HASH_SET_SLOTS:
+		if (arg && !futex_private_hash_slots_valid(arg))
+			return -EINVAL;
+		/* The size can only be chosen before the table exists */
+		if (READ_ONCE(mm->futex_phash))
+			return -EBUSY;
+		WRITE_ONCE(mm->futex_hash_slots, arg);
+		return 0;
+	case PR_FUTEX_HASH_GET_SLOTS:
+		if (arg)
+			return -EINVAL;
+		if (READ_ONCE(mm->futex_phash))
+			return mm->futex_phash->hash_mask + 1;
+		return 0;
+	}
+	return -EINVAL;
+}
+#else
+static inline struct futex_private_hash *
+futex_private_hash(union futex_key *key)
+{
+	return NULL;
+}
+#endif /* CONFIG_FUTEX_PRIVATE_HASH */
+
 /**
- * futex_hash - Return the hash bucket in the global hash
+ * futex_hash - Return the hash bucket for a futex key
  * @key:	Pointer to the futex key for which the hash is calculated
  *
  * We hash on the keys returned from get_futex_key (see below) and return the
- * corresponding hash bucket in the global hash.
+ * corresponding hash bucket in the process private hash, if the key is
+ * private and the process has one, or else in the global hash.
  */
 struct futex_hash_bucket *futex_hash(union futex_key *key)
 {
 	u32 hash = jhash2((u32 *)key, offsetof(typeof(*key), both.offset) / 4,
 			  key->both.offset);
+	struct futex_private_hash *fph = futex_private_hash(key);
+
+	if (fph)
+		return &fph->queues[hash & fph->hash_mask];
 
 	return &futex_queues[hash & (futex_hashsize - 1)];
 }
@@ -194,7 +323,7 @@ static u64 get_inode_sequence_number(struct inode *inode)
 /**
  * get_futex_key() - Get parameters which are the keys for a futex
  * @uaddr:	virtual address of the futex
- * @fshared:	false for a PROCESS_PRIVATE futex, true for PROCESS_SHARED
+ * @flags:	FLAGS_SHARED for a PROCESS_SHARED futex, and the futex size
  * @key:	address where result is stored.
  * @rw:		mapping needs to be read/write (values: FUTEX_READ,
  *              FUTEX_WRITE)
@@ -203,13 +332,13 @@ static u64 get_inode_sequence_number(struct inode *inode)
  *
  * The key words are stored in @key on success.
  *
- * For shared mappings (when @fshared), the key is:
+ * For shared mappings (when FLAGS_SHARED), the key is:
  *
  *   ( inode->i_sequence, page->index, offset_within_page )
  *
  * [ also see get_inode_sequence_number() ]
  *
- * For private mappings (or when !@fshared), the key is:
+ * For private mappings (or when !FLAGS_SHARED), the key is:
  *
  *   ( current->mm, address, 0 )
  *
@@ -218,24 +347,33 @@ static u64 get_inode_sequence_number(struct inode *inode)
  *
  * lock_page() might sleep, the caller should not hold a spinlock.
  */
-int get_futex_key(u32 __user *uaddr, bool fshared, union futex_key *key,
+int get_futex_key(void __user *uaddr, unsigned int flags, union futex_key *key,
 		  enum futex_access rw)
 {
 	unsigned long address = (unsigned long)uaddr;
 	struct mm_struct *mm = current->mm;
 	struct page *page, *tail;
 	struct address_space *mapping;
+	unsigned int size = futex_size(flags);
+	bool fshared = flags & FLAGS_SHARED;
+	unsigned int offset;
 	int err, ro = 0;
 
 	/*
 	 * The futex address must be "naturally" aligned.
 	 */
-	key->both.offset = address % PAGE_SIZE;
-	if (unlikely((address % sizeof(u32)) != 0))
+	offset = address % PAGE_SIZE;
+	if (unlikely((address % size) != 0))
 		return -EINVAL;
-	address -= key->both.offset;
+	address -= offset;
 
-	if (unlikely(!access_ok(uaddr, sizeof(u32))))
+	/*
+	 * The low two bits of the key offset hold FUT_OFF_*; keep the
+	 * offset of 8 and 16 bit futexes out of their way.
+	 */
+	key->both.offset = offset << 2;
+
+	if (unlikely(!access_ok(uaddr, size)))
 		return -EFAULT;
 
 	if (unlikely(should_fail_futex(fshared)))
@@ -470,6 +608,62 @@ int futex_get_value_locked(u32 *dest, u32 __user *from)
 	return ret ? -EFAULT : 0;
 }
 
+/**
+ * futex_get_value - Read a futex word of the size given in @flags
+ * @dest:	zero extended value
+ * @from:	futex address, validated by get_futex_key()
+ * @flags:	futex flags, only FLAGS_SIZE_* is used
+ */
+int futex_get_value(u64 *dest, void __user *from, unsigned int flags)
+{
+	int ret;
+
+	switch (flags & FLAGS_SIZE_MASK) {
+	case FLAGS_SIZE_8: {
+		u8 val;
+
+		ret = __get_user(val, (u8 __user *)from);
+		*dest = val;
+		break;
+	}
+	case FLAGS_SIZE_16: {
+		u16 val;
+
+		ret = __get_user(val, (u16 __user *)from);
+		*dest = val;
+		break;
+	}
+	case FLAGS_SIZE_32: {
+		u32 val;
+
+		ret = __get_user(val, (u32 __user *)from);
+		*dest = val;
+		break;
+	}
+#ifdef CONFIG_64BIT
+	case FLAGS_SIZE_64:
+		ret = __get_user(*dest, (u64 __user *)from);
+		break;
+#endif
+	default:
+		return -EINVAL;
+	}
+
+	return ret ? -EFAULT : 0;
+}
+
+int futex_get_value_sized_locked(u64 *dest, void __user *from,
+				 unsigned int flags)
+{
+	int ret;
+
+	pagefault_disable();
+	ret = futex_get_value(dest, from, flags);
+	pagefault_enable();
+
+	return ret;
+}
+
 /**
  * wait_for_owner_exiting - Block until the owner has exited
  * @ret: owner's current futex lock status
@@ -702,7 +896,8 @@ static int handle_futex_death(u32 __user *uaddr, struct task_struct *curr,
 	owner = uval & FUTEX_TID_MASK;
 
 	if (pending_op && !pi && !owner) {
-		futex_wake(uaddr, 1, 1, FUTEX_BITSET_MATCH_ANY);
+		futex_wake(uaddr, FLAGS_SIZE_32 | FLAGS_SHARED, 1,
+			   FUTEX_BITSET_MATCH_ANY);
 		return 0;
 	}
 
@@ -754,8 +949,10 @@ static int handle_futex_death(u32 __user *uaddr, struct task_struct *curr,
 	 * Wake robust non-PI futexes here. The wakeup of
 	 * PI futexes happens in exit_pi_state():
 	 */
-	if (!pi && (uval & FUTEX_WAITERS))
-		futex_wake(uaddr, 1, 1, FUTEX_BITSET_MATCH_ANY);
+	if (!pi && (uval & FUTEX_WAITERS)) {
+		futex_wake(uaddr, FLAGS_SIZE_32 | FLAGS_SHARED, 1,
+			   FUTEX_BITSET_MATCH_ANY);
+	}
 
 	return 0;
 }
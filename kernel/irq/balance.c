@@ -0,0 +1,340 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Capacity aware in-kernel IRQ balancer.
+ *
+ * Interrupt controllers like the GIC deliver an interrupt whose affinity
+ * spans several CPUs to the first one of them, so unless userspace pins
+ * everything by hand, all device interrupts end up on CPU0. This moves the
+ * effective affinity of high rate interrupts to CPUs which have spare
+ * capacity, within the affinity mask set by the user:
+ *
+ *  - Only interrupts above min_rate per second are considered, and each
+ *    one is left alone for hold_ms after it has been moved.
+ *  - Interrupts above big_rate per second are kept on the highest capacity
+ *    CPUs of their mask, the others prefer the lowest capacity CPUs which
+ *    are idle enough, to not wake up a big core for a touch panel.
+ *  - An interrupt is only moved off its CPU when that CPU is busy, or not
+ *    in the right capacity class, and the target is clearly less loaded.
+ *
+ * Managed, per CPU and IRQ_NO_BALANCING interrupts, and interrupts whose
+ * affinity mask is a single CPU, are never touched. smp_affinity keeps the
+ * user's mask, the balancer only changes effective_affinity.
+ */
+
+#include <linux/irq.h>
+#include <linux/interrupt.h>
+#include <linux/math64.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/sched/topology.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "internals.h"
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "irq_balance."
+
+enum irq_balance_decision {
+	IRQ_BAL_NONE,
+	IRQ_BAL_INELIGIBLE,
+	IRQ_BAL_LOW_RATE,
+	IRQ_BAL_HOLD,
+	IRQ_BAL_STAY,
+	IRQ_BAL_NO_TARGET,
+	IRQ_BAL_MOVED,
+	IRQ_BAL_FAILED,
+};
+
+static const char * const irq_balance_decision_names[] = {
+	[IRQ_BAL_NONE]		= "none",
+	[IRQ_BAL_INELIGIBLE]	= "ineligible",
+	[IRQ_BAL_LOW_RATE]	= "low-rate",
+	[IRQ_BAL_HOLD]		= "hold",
+	[IRQ_BAL_STAY]		= "stay",
+	[IRQ_BAL_NO_TARGET]	= "no-target",
+	[IRQ_BAL_MOVED]		= "moved",
+	[IRQ_BAL_FAILED]	= "failed",
+};
+
+static bool enabled = true;
+static unsigned int period_ms = 1000;
+static unsigned int hold_ms = 5000;
+static unsigned int min_rate = 1000;
+static unsigned int big_rate = 20000;
+/* In percent of the CPU's capacity */
+static unsigned int idle_pct = 30;
+static unsigned int busy_pct = 70;
+static unsigned int margin_pct = 20;
+
+module_param(period_ms, uint, 0644);
+module_param(hold_ms, uint, 0644);
+module_param(min_rate, uint, 0644);
+module_param(big_rate, uint, 0644);
+module_param(idle_pct, uint, 0644);
+module_param(busy_pct, uint, 0644);
+module_param(margin_pct, uint, 0644);
+
+static void irq_balance_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(irq_balance_work, irq_balance_fn);
+
+/* Serialized by the work item */
+static unsigned long irq_balance_last;
+static unsigned long *irq_balance_load;
+static struct cpumask irq_balance_saved;
+static struct cpumask irq_balance_cand;
+
+/*
+ * Each high rate interrupt that is placed on a CPU during a pass counts for
+ * this much load on it, so that one pass does not pile all of them onto the
+ * same idle CPU.
+ */
+#define IRQ_BAL_IRQ_LOAD	(SCHED_CAPACITY_SCALE / 16)
+
+static inline unsigned long irq_balance_pct(int cpu, unsigned int pct)
+{
+	return arch_scale_cpu_capacity(cpu) * pct / 100;
+}
+
+static unsigned int irq_balance_count(struct irq_desc *desc)
+{
+	unsigned int sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += irq_desc_kstat_cpu(desc, cpu);
+	return sum;
+}
+
+static bool irq_balance_eligible(struct irq_desc *desc)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+
+	if (!desc->action || !irqd_is_started(data))
+		return false;
+	if (irqd_is_per_cpu(data) || irqd_affinity_is_managed(data) ||
+	    !irqd_can_balance(data))
+		return false;
+	if (!irq_can_move_pcntxt(data) || irqd_is_setaffinity_pending(data))
+		return false;
+	/* A single CPU in the mask is an explicit choice, respect it */
+	return cpumask_weight(irq_data_get_affinity_mask(data)) > 1;
+}
+
+/*
+ * Restrict the candidates to the right capacity class: the biggest CPUs for
+ * heavy interrupts, otherwise leave them all and let the scoring below
+ * prefer small ones.
+ */
+static void irq_balance_candidates(struct irq_desc *desc, unsigned int rate)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	unsigned long cap, max_cap = 0;
+	int cpu;
+
+	cpumask_and(&irq_balance_cand, irq_data_get_affinity_mask(data),
+		    cpu_active_mask);
+
+	if (rate < big_rate)
+		return;
+
+	for_each_cpu(cpu, &irq_balance_cand)
+		max_cap = max(max_cap, arch_scale_cpu_capacity(cpu));
+	for_each_cpu(cpu, &irq_balance_cand) {
+		cap = arch_scale_cpu_capacity(cpu);
+		if (cap < max_cap)
+			__cpumask_clear_cpu(cpu, &irq_balance_cand);
+	}
+}
+
+static inline bool irq_balance_idle(int cpu)
+{
+	return irq_balance_load[cpu] <= irq_balance_pct(cpu, idle_pct);
+}
+
+/*
+ * The idle enough CPU with the smallest capacity, least loaded on ties, or
+ * failing that the CPU with the most spare capacity.
+ */
+static int irq_balance_pick(void)
+{
+	unsigned long cap, best_cap = ULONG_MAX, spare, best_spare = 0;
+	int cpu, idle = -1, fallback = -1;
+
+	for_each_cpu(cpu, &irq_balance_cand) {
+		cap = arch_scale_cpu_capacity(cpu);
+
+		if (irq_balance_idle(cpu) &&
+		    (cap < best_cap || (cap == best_cap &&
+		     irq_balance_load[cpu] < irq_balance_load[idle]))) {
+			idle = cpu;
+			best_cap = cap;
+		}
+
+		spare = cap > irq_balance_load[cpu] ?
+			cap - irq_balance_load[cpu] : 0;
+		if (fallback < 0 || spare > best_spare) {
+			fallback = cpu;
+			best_spare = spare;
+		}
+	}
+
+	return idle >= 0 ? idle : fallback;
+}
+
+static enum irq_balance_decision
+irq_balance_one(struct irq_desc *desc, int *where)
+{
+	struct irq_data *data = irq_desc_get_irq_data(desc);
+	struct irq_balance_stat *bs = &desc->balance;
+	int cur, target;
+
+	cur = cpumask_first_and(irq_data_get_effective_affinity_mask(data),
+				cpu_online_mask);
+	*where = cur;
+
+	if (bs->rate < min_rate)
+		return IRQ_BAL_LOW_RATE;
+
+	if (bs->moves &&
+	    time_before(jiffies, bs->last_move + msecs_to_jiffies(hold_ms)))
+		return IRQ_BAL_HOLD;
+
+	irq_balance_candidates(desc, bs->rate);
+	target = irq_balance_pick();
+	if (target < 0)
+		return IRQ_BAL_NO_TARGET;
+
+	/*
+	 * Hysteresis: stay if the current CPU is in the right class and not
+	 * busy, or if the target is not clearly better.
+	 */
+	if (cur < nr_cpu_ids && cpumask_test_cpu(cur, &irq_balance_cand)) {
+		if (target == cur ||
+		    irq_balance_load[cur] < irq_balance_pct(cur, busy_pct))
+			return IRQ_BAL_STAY;
+		if (irq_balance_load[target] + irq_balance_pct(target, margin_pct) >=
+		    irq_balance_load[cur])
+			return IRQ_BAL_STAY;
+	}
+
+	/*
+	 * Only the effective affinity changes: put the user's mask back so
+	 * that smp_affinity and CPU hotplug keep working from it.
+	 */
+	cpumask_copy(&irq_balance_saved, irq_data_get_affinity_mask(data));
+	if (irq_do_set_affinity(data, cpumask_of(target), false) < 0)
+		return IRQ_BAL_FAILED;
+	cpumask_copy(desc->irq_common_data.affinity, &irq_balance_saved);
+
+	*where = target;
+	bs->last_move = jiffies;
+	bs->moves++;
+	return IRQ_BAL_MOVED;
+}
+
+static void irq_balance_fn(struct work_struct *work)
+{
+	unsigned int period = max(period_ms, 100U);
+	unsigned long now = jiffies, elapsed;
+	unsigned int irq, count;
+	struct irq_desc *desc;
+	int cpu, where;
+
+	if (!READ_ONCE(enabled)) {
+		/* Start over with a fresh baseline when re-enabled */
+		irq_balance_last = 0;
+		return;
+	}
+
+	/* The work may run late, rates are over the time that really passed */
+	elapsed = irq_balance_last ? now - irq_balance_last : 0;
+	irq_balance_last = now ?: 1;
+
+	for_each_possible_cpu(cpu) {
+		if (!cpu_online(cpu)) {
+			irq_balance_load[cpu] = 0;
+			continue;
+		}
+		/* ext tasks are not in PELT, count their windowed busy time */
+		irq_balance_load[cpu] = max(sched_cpu_util(cpu),
+					    scx_cpu_ext_util(cpu));
+	}
+
+	irq_lock_sparse();
+	for_each_active_irq(irq) {
+		struct irq_balance_stat *bs;
+
+		desc = irq_to_desc(irq);
+		if (!desc)
+			continue;
+
+		raw_spin_lock_irq(&desc->lock);
+		bs = &desc->balance;
+		count = irq_balance_count(desc);
+		/* The first sample only sets the baseline */
+		if (bs->decision != IRQ_BAL_NONE && elapsed)
+			bs->rate = div_u64((u64)(count - bs->last_count) * HZ,
+					   elapsed);
+		bs->last_count = count;
+
+		if (!irq_balance_eligible(desc)) {
+			bs->decision = IRQ_BAL_INELIGIBLE;
+		} else {
+			where = nr_cpu_ids;
+			bs->decision = irq_balance_one(desc, &where);
+			if (bs->rate >= min_rate && where < nr_cpu_ids)
+				irq_balance_load[where] += IRQ_BAL_IRQ_LOAD;
+		}
+		raw_spin_unlock_irq(&desc->lock);
+
+		cond_resched();
+	}
+	irq_unlock_sparse();
+
+	queue_delayed_work(system_power_efficient_wq, &irq_balance_work,
+			   msecs_to_jiffies(period));
+}
+
+static int enabled_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (!ret && enabled && irq_balance_load)
+		mod_delayed_work(system_power_efficient_wq, &irq_balance_work, 0);
+	return ret;
+}
+
+static const struct kernel_param_ops enabled_ops = {
+	.set	= enabled_set,
+	.get	= param_get_bool,
+};
+module_param_cb(enabled, &enabled_ops, &enabled, 0644);
+
+void irq_balance_proc_show(struct seq_file *m, struct irq_desc *desc)
+{
+	struct irq_balance_stat *bs = &desc->balance;
+	unsigned int decision = READ_ONCE(bs->decision);
+
+	seq_printf(m, "rate %u\n" "moves %u\n" "last_move %u ms\n"
+		   "decision %s\n",
+		   READ_ONCE(bs->rate), READ_ONCE(bs->moves),
+		   bs->moves ? jiffies_to_msecs(jiffies - READ_ONCE(bs->last_move)) : 0,
+		   irq_balance_decision_names[decision]);
+}
+
+static int __init irq_balance_init(void)
+{
+	irq_balance_load = kcalloc(nr_cpu_ids, sizeof(*irq_balance_load),
+				   GFP_KERNEL);
+	if (!irq_balance_load)
+		return -ENOMEM;
+
+	queue_delayed_work(system_power_efficient_wq, &irq_balance_work,
+			   msecs_to_jiffies(period_ms));
+	return 0;
+}
+late_initcall(irq_balance_init);
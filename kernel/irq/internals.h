@@ -142,6 +142,10 @@ extern void irq_set_thread_affinity(struct irq_desc *desc);
 extern int irq_do_set_affinity(struct irq_data *data,
 			       const struct cpumask *dest, bool force);
 
+#ifdef CONFIG_IRQ_CAPACITY_BALANCE
+extern void irq_balance_proc_show(struct seq_file *m, struct irq_desc *desc);
+#endif
+
 #ifdef CONFIG_SMP
 extern int irq_setup_affinity(struct irq_desc *desc);
 #else
@@ -295,6 +295,16 @@ static int irq_spurious_proc_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+#ifdef CONFIG_IRQ_CAPACITY_BALANCE
+static int irq_balance_stats_proc_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc = irq_to_desc((long) m->private);
+
+	irq_balance_proc_show(m, desc);
+	return 0;
+}
+#endif
+
 #define MAX_NAMELEN 128
 
 static int name_unique(unsigned int irq, struct irqaction *new_action)
@@ -382,6 +392,10 @@ void register_irq_proc(unsigned int irq, struct irq_desc *desc)
 	proc_create_single_data("effective_affinity_list", 0444, desc->dir,
 			irq_effective_aff_list_proc_show, irqp);
 # endif
+# ifdef CONFIG_IRQ_CAPACITY_BALANCE
+	proc_create_single_data("effective_affinity_stats", 0444, desc->dir,
+			irq_balance_stats_proc_show, irqp);
+# endif
 #endif
 	proc_create_single_data("spurious", 0444, desc->dir,
 			irq_spurious_proc_show, (void *)(long)irq);
@@ -405,6 +419,9 @@ void unregister_irq_proc(unsigned int irq, struct irq_desc *desc)
 	remove_proc_entry("effective_affinity", desc->dir);
 	remove_proc_entry("effective_affinity_list", desc->dir);
 # endif
+# ifdef CONFIG_IRQ_CAPACITY_BALANCE
+	remove_proc_entry("effective_affinity_stats", desc->dir);
+# endif
 #endif
 	remove_proc_entry("spurious", desc->dir);
 
@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per call site contention accounting for mutexes and rwsems.
+ *
+ * Every contended acquisition is charged to the first return address on the
+ * stack that is not in the locking or scheduler text, in the same way that
+ * get_wchan() picks the interesting frame of a blocked task. Each lock type
+ * has a small open-addressed table of call sites, filled locklessly. When it
+ * is full, further call sites are only counted as dropped.
+ *
+ * debugfs interface, in /sys/kernel/debug/lock_contention/:
+ *
+ *  enable	RW bool	: turn the accounting on or off
+ *  reset	WO	: clear the tables; only allowed while disabled
+ *  top		RO	: the most contended call sites, by total wait time
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/mutex.h>
+#include <linux/sched/debug.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/stacktrace.h>
+#include <linux/uaccess.h>
+
+#include "lock_contention.h"
+
+#define LOCK_CSTAT_BITS		9
+#define LOCK_CSTAT_SIZE		(1 << LOCK_CSTAT_BITS)
+#define LOCK_CSTAT_PROBES	16
+#define LOCK_CSTAT_DEPTH	8
+#define LOCK_CSTAT_TOP		32
+/* Frames of lock_cstat_caller() and __lock_cstat_record() */
+#define LOCK_CSTAT_SKIP		2
+
+struct lock_cstat {
+	unsigned long	ip;		/* call site, 0 if the slot is free */
+	atomic_long_t	count[LOCK_CSTAT_NR_OUTCOMES];
+	atomic64_t	wait_ns;
+	atomic64_t	max_ns;
+};
+
+DEFINE_STATIC_KEY_FALSE(lock_cstat_enabled);
+
+static struct lock_cstat lock_cstats[LOCK_CSTAT_NR_TYPES][LOCK_CSTAT_SIZE];
+static atomic_long_t lock_cstat_dropped;
+static DEFINE_MUTEX(lock_cstat_mutex);
+
+static const char * const lock_cstat_type_names[LOCK_CSTAT_NR_TYPES] = {
+	[LOCK_CSTAT_MUTEX]		= "mutex",
+	[LOCK_CSTAT_RWSEM_READ]		= "rwsem-r",
+	[LOCK_CSTAT_RWSEM_WRITE]	= "rwsem-w",
+};
+
+/*
+ * Both this and __lock_cstat_record() are noinline, so that exactly their
+ * frames are skipped whatever the compiler decides to inline; the walk then
+ * starts in the lock slowpath.
+ */
+static noinline unsigned long lock_cstat_caller(void)
+{
+	unsigned long entries[LOCK_CSTAT_DEPTH];
+	unsigned int i, nr;
+
+	nr = stack_trace_save(entries, ARRAY_SIZE(entries), LOCK_CSTAT_SKIP);
+	for (i = 0; i < nr; i++) {
+		if (!in_sched_functions(entries[i]))
+			return entries[i];
+	}
+	return 0;
+}
+
+static struct lock_cstat *lock_cstat_lookup(enum lock_cstat_type type,
+					    unsigned long ip)
+{
+	struct lock_cstat *table = lock_cstats[type];
+	unsigned int i, idx = hash_long(ip, LOCK_CSTAT_BITS);
+
+	for (i = 0; i < LOCK_CSTAT_PROBES; i++) {
+		struct lock_cstat *cs = &table[(idx + i) & (LOCK_CSTAT_SIZE - 1)];
+		unsigned long cur = READ_ONCE(cs->ip);
+
+		if (!cur)
+			cur = cmpxchg(&cs->ip, 0, ip) ? : ip;
+		if (cur == ip)
+			return cs;
+	}
+	return NULL;
+}
+
+noinline void __lock_cstat_record(enum lock_cstat_type type,
+				  enum lock_cstat_outcome outcome, u64 start)
+{
+	u64 delta = local_clock() - start;
+	struct lock_cstat *cs;
+	unsigned long ip;
+	s64 max;
+
+	ip = lock_cstat_caller();
+	if (!ip)
+		return;
+
+	cs = lock_cstat_lookup(type, ip);
+	if (!cs) {
+		atomic_long_inc(&lock_cstat_dropped);
+		return;
+	}
+
+	atomic_long_inc(&cs->count[outcome]);
+	atomic64_add(delta, &cs->wait_ns);
+	max = atomic64_read(&cs->max_ns);
+	while ((s64)delta > max) {
+		if (atomic64_try_cmpxchg(&cs->max_ns, &max, delta))
+			break;
+	}
+}
+
+struct lock_cstat_entry {
+	unsigned long	ip;
+	enum lock_cstat_type type;
+	unsigned long	count[LOCK_CSTAT_NR_OUTCOMES];
+	u64		wait_ns;
+	u64		max_ns;
+};
+
+static int lock_cstat_cmp(const void *a, const void *b)
+{
+	const struct lock_cstat_entry *ea = a, *eb = b;
+
+	if (ea->wait_ns != eb->wait_ns)
+		return ea->wait_ns < eb->wait_ns ? 1 : -1;
+	return 0;
+}
+
+static int lock_cstat_top_show(struct seq_file *m, void *v)
+{
+	struct lock_cstat_entry *entries;
+	unsigned int i, nr = 0;
+	int type, o;
+
+	entries = kvcalloc(LOCK_CSTAT_NR_TYPES * LOCK_CSTAT_SIZE,
+			   sizeof(*entries), GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+
+	for (type = 0; type < LOCK_CSTAT_NR_TYPES; type++) {
+		for (i = 0; i < LOCK_CSTAT_SIZE; i++) {
+			struct lock_cstat *cs = &lock_cstats[type][i];
+			struct lock_cstat_entry *e = &entries[nr];
+
+			e->ip = READ_ONCE(cs->ip);
+			if (!e->ip)
+				continue;
+			e->type = type;
+			for (o = 0; o < LOCK_CSTAT_NR_OUTCOMES; o++)
+				e->count[o] = atomic_long_read(&cs->count[o]);
+			e->wait_ns = atomic64_read(&cs->wait_ns);
+			e->max_ns = atomic64_read(&cs->max_ns);
+			nr++;
+		}
+	}
+
+	sort(entries, nr, sizeof(*entries), lock_cstat_cmp, NULL);
+
+	seq_printf(m, "%-8s %10s %10s %10s %10s %14s %12s  %s\n",
+		   "type", "spun", "slept", "handoff", "failed",
+		   "wait_us", "max_us", "call site");
+	for (i = 0; i < min(nr, LOCK_CSTAT_TOP); i++) {
+		struct lock_cstat_entry *e = &entries[i];
+
+		seq_printf(m, "%-8s %10lu %10lu %10lu %10lu %14llu %12llu  %pS\n",
+			   lock_cstat_type_names[e->type],
+			   e->count[LOCK_CSTAT_SPUN],
+			   e->count[LOCK_CSTAT_SLEPT],
+			   e->count[LOCK_CSTAT_HANDOFF],
+			   e->count[LOCK_CSTAT_FAILED],
+			   div_u64(e->wait_ns, NSEC_PER_USEC),
+			   div_u64(e->max_ns, NSEC_PER_USEC),
+			   (void *)e->ip);
+	}
+	seq_printf(m, "dropped %lu\n", atomic_long_read(&lock_cstat_dropped));
+
+	kvfree(entries);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lock_cstat_top);
+
+static ssize_t lock_cstat_enable_read(struct file *file, char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	char buf[3];
+
+	buf[0] = static_key_enabled(&lock_cstat_enabled) ? 'Y' : 'N';
+	buf[1] = '\n';
+	buf[2] = '\0';
+	return simple_read_from_buffer(ubuf, count, ppos, buf, 2);
+}
+
+static ssize_t lock_cstat_enable_write(struct file *file,
+				       const char __user *ubuf,
+				       size_t count, loff_t *ppos)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&lock_cstat_mutex);
+	if (enable)
+		static_branch_enable(&lock_cstat_enabled);
+	else
+		static_branch_disable(&lock_cstat_enabled);
+	mutex_unlock(&lock_cstat_mutex);
+
+	return count;
+}
+
+static const struct file_operations lock_cstat_enable_fops = {
+	.read	= lock_cstat_enable_read,
+	.write	= lock_cstat_enable_write,
+	.llseek	= default_llseek,
+};
+
+static ssize_t lock_cstat_reset_write(struct file *file,
+				      const char __user *ubuf,
+				      size_t count, loff_t *ppos)
+{
+	ssize_t ret = count;
+
+	mutex_lock(&lock_cstat_mutex);
+	if (static_key_enabled(&lock_cstat_enabled)) {
+		ret = -EBUSY;
+	} else {
+		/*
+		 * A slowpath that saw the key enabled may still be updating an
+		 * entry; that only skews its counts, the entry stays valid.
+		 */
+		memset(lock_cstats, 0, sizeof(lock_cstats));
+		atomic_long_set(&lock_cstat_dropped, 0);
+	}
+	mutex_unlock(&lock_cstat_mutex);
+
+	return ret;
+}
+
+static const struct file_operations lock_cstat_reset_fops = {
+	.write	= lock_cstat_reset_write,
+	.llseek	= noop_llseek,
+};
+
+static int __init lock_cstat_init(void)
+{
+	struct dentry *d_dir = debugfs_create_dir("lock_contention", NULL);
+
+	debugfs_create_file("enable", 0600, d_dir, NULL,
+			    &lock_cstat_enable_fops);
+	debugfs_create_file("reset", 0200, d_dir, NULL,
+			    &lock_cstat_reset_fops);
+	debugfs_create_file("top", 0400, d_dir, NULL, &lock_cstat_top_fops);
+
+	return 0;
+}
+fs_initcall(lock_cstat_init);
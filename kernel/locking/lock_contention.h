@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Lightweight contention accounting for sleeping locks.
+ *
+ * Unlike CONFIG_LOCK_STAT this needs neither lockdep nor lock classes: a
+ * contended acquisition is attributed to the first caller outside of the
+ * locking and scheduler code, and the accounting is patched in with a static
+ * key so that it can stay built in on production kernels.
+ */
+
+#ifndef __LOCKING_LOCK_CONTENTION_H
+#define __LOCKING_LOCK_CONTENTION_H
+
+#include <linux/jump_label.h>
+#include <linux/sched/clock.h>
+
+enum lock_cstat_type {
+	LOCK_CSTAT_MUTEX,
+	LOCK_CSTAT_RWSEM_READ,
+	LOCK_CSTAT_RWSEM_WRITE,
+	LOCK_CSTAT_NR_TYPES,
+};
+
+/* How a contended acquisition ended */
+enum lock_cstat_outcome {
+	LOCK_CSTAT_SPUN,	/* acquired without sleeping */
+	LOCK_CSTAT_SLEPT,	/* acquired after sleeping */
+	LOCK_CSTAT_HANDOFF,	/* acquired after sleeping and asking for handoff */
+	LOCK_CSTAT_FAILED,	/* interrupted by a signal */
+	LOCK_CSTAT_NR_OUTCOMES,
+};
+
+#ifdef CONFIG_LOCK_CONTENTION_STATS
+
+DECLARE_STATIC_KEY_FALSE(lock_cstat_enabled);
+
+void __lock_cstat_record(enum lock_cstat_type type,
+			 enum lock_cstat_outcome outcome, u64 start);
+
+/*
+ * Called on entry to a slowpath. Returns the timestamp to pass to
+ * lock_cstat_record(), or 0 if accounting is off.
+ */
+static __always_inline u64 lock_cstat_start(void)
+{
+	if (static_branch_unlikely(&lock_cstat_enabled))
+		return local_clock() ? : 1;
+	return 0;
+}
+
+static __always_inline void lock_cstat_record(enum lock_cstat_type type,
+					      enum lock_cstat_outcome outcome,
+					      u64 start)
+{
+	if (static_branch_unlikely(&lock_cstat_enabled) && start)
+		__lock_cstat_record(type, outcome, start);
+}
+
+#else /* CONFIG_LOCK_CONTENTION_STATS */
+
+static inline u64 lock_cstat_start(void) { return 0; }
+static inline void lock_cstat_record(enum lock_cstat_type type,
+				     enum lock_cstat_outcome outcome,
+				     u64 start) { }
+
+#endif /* CONFIG_LOCK_CONTENTION_STATS */
+
+#endif /* __LOCKING_LOCK_CONTENTION_H */
@@ -67,3 +67,6 @@ LOCK_EVENT(rwsem_rlock_handoff)	/* # of read lock handoffs		*/
 LOCK_EVENT(rwsem_wlock)		/* # of write locks acquired		*/
 LOCK_EVENT(rwsem_wlock_fail)	/* # of failed write lock acquisitions	*/
 LOCK_EVENT(rwsem_wlock_handoff)	/* # of write lock handoffs		*/
+LOCK_EVENT(rwsem_rpi_boost)	/* # of waiters that boosted readers	*/
+LOCK_EVENT(rwsem_rpi_boosted)	/* # of reader owners boosted		*/
+LOCK_EVENT(rwsem_rpi_untracked)	/* # of readers beyond the tracked ones	*/
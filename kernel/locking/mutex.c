@@ -38,6 +38,7 @@
 
 #ifndef CONFIG_PREEMPT_RT
 #include "mutex.h"
+#include "lock_contention.h"
 
 #ifdef CONFIG_DEBUG_MUTEXES
 # define MUTEX_WARN_ON(cond) DEBUG_LOCKS_WARN_ON(cond)
@@ -592,8 +593,10 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 		    struct lockdep_map *nest_lock, unsigned long ip,
 		    struct ww_acquire_ctx *ww_ctx, const bool use_ww_ctx)
 {
+	enum lock_cstat_outcome cstat = LOCK_CSTAT_SPUN;
 	struct mutex_waiter waiter;
 	struct ww_mutex *ww;
+	u64 cstat_start;
 	int ret;
 
 	if (!use_ww_ctx)
@@ -624,6 +627,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	preempt_disable();
 	mutex_acquire_nest(&lock->dep_map, subclass, 0, nest_lock, ip);
 
+	cstat_start = lock_cstat_start();
 	trace_contention_begin(lock, LCB_F_MUTEX | LCB_F_SPIN);
 	if (__mutex_trylock(lock) ||
 	    mutex_optimistic_spin(lock, ww_ctx, NULL)) {
@@ -634,6 +638,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 		trace_contention_end(lock, 0);
 		trace_android_vh_record_mutex_lock_starttime(lock, jiffies);
 		preempt_enable();
+		lock_cstat_record(LOCK_CSTAT_MUTEX, cstat, cstat_start);
 		return 0;
 	}
 
@@ -671,6 +676,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	trace_android_vh_mutex_wait_start(lock);
 	set_current_state(state);
 	trace_contention_begin(lock, LCB_F_MUTEX);
+	cstat = LOCK_CSTAT_SLEPT;
 	for (;;) {
 		bool first;
 
@@ -714,6 +720,8 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 			break;
 
 		if (first) {
+			/* __mutex_trylock_or_handoff() has set HANDOFF */
+			cstat = LOCK_CSTAT_HANDOFF;
 			trace_contention_begin(lock, LCB_F_MUTEX | LCB_F_SPIN);
 			if (mutex_optimistic_spin(lock, ww_ctx, &waiter))
 				break;
@@ -752,6 +760,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	raw_spin_unlock(&lock->wait_lock);
 	preempt_enable();
 	trace_android_vh_record_mutex_lock_starttime(lock, jiffies);
+	lock_cstat_record(LOCK_CSTAT_MUTEX, cstat, cstat_start);
 	return 0;
 
 err:
@@ -764,6 +773,7 @@ __mutex_lock_common(struct mutex *lock, unsigned int state, unsigned int subclas
 	debug_mutex_free_waiter(&waiter);
 	mutex_release(&lock->dep_map, ip);
 	preempt_enable();
+	lock_cstat_record(LOCK_CSTAT_MUTEX, LOCK_CSTAT_FAILED, cstat_start);
 	return ret;
 }
 
@@ -27,10 +27,13 @@
 #include <linux/export.h>
 #include <linux/rwsem.h>
 #include <linux/atomic.h>
+#include <linux/hash.h>
 #include <trace/events/lock.h>
 
 #ifndef CONFIG_PREEMPT_RT
 #include "lock_events.h"
+#include "lock_contention.h"
+#include "rtmutex_common.h"
 #include <trace/hooks/dtask.h>
 #include <trace/hooks/rwsem.h>
 
@@ -180,9 +183,46 @@ static inline void __rwsem_set_reader_owned(struct rw_semaphore *sem,
 	atomic_long_set(&sem->owner, val);
 }
 
+#ifdef CONFIG_RWSEM_READER_PI
+/*
+ * Unlike the owner field, which only remembers the most recent reader, up to
+ * RWSEM_PI_NR_READERS concurrent readers are recorded in ->reader_owners[] so
+ * that a high priority waiter can boost them. Each task only ever uses the
+ * slot its task_struct hashes to, which keeps the read fast path at a single
+ * cmpxchg; a reader whose slot is taken is simply not tracked. A slot is only
+ * cleared by the task stored in it, so a reader can release its slot without
+ * atomics.
+ */
+static inline struct task_struct **rwsem_reader_slot(struct rw_semaphore *sem)
+{
+	return &sem->reader_owners[hash_ptr(current,
+					    ilog2(RWSEM_PI_NR_READERS))];
+}
+
+static inline void rwsem_track_reader(struct rw_semaphore *sem)
+{
+	struct task_struct **slot = rwsem_reader_slot(sem);
+
+	if (READ_ONCE(*slot) || cmpxchg(slot, NULL, current))
+		lockevent_inc(rwsem_rpi_untracked);
+}
+
+static inline void rwsem_untrack_reader(struct rw_semaphore *sem)
+{
+	struct task_struct **slot = rwsem_reader_slot(sem);
+
+	if (READ_ONCE(*slot) == current)
+		WRITE_ONCE(*slot, NULL);
+}
+#else
+static inline void rwsem_track_reader(struct rw_semaphore *sem) { }
+static inline void rwsem_untrack_reader(struct rw_semaphore *sem) { }
+#endif
+
 static inline void rwsem_set_reader_owned(struct rw_semaphore *sem)
 {
 	__rwsem_set_reader_owned(sem, current);
+	rwsem_track_reader(sem);
 	trace_android_vh_record_rwsem_reader_owned(sem, NULL);
 }
 
@@ -345,6 +385,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 #ifdef CONFIG_RWSEM_SPIN_ON_OWNER
 	osq_lock_init(&sem->osq);
 #endif
+#ifdef CONFIG_RWSEM_READER_PI
+	memset(sem->reader_owners, 0, sizeof(sem->reader_owners));
+#endif
 #ifdef CONFIG_ANDROID_VENDOR_OEM_DATA
 	sem->android_vendor_data1 = 0;
 #endif
@@ -363,6 +406,12 @@ struct rwsem_waiter {
 	enum rwsem_waiter_type type;
 	unsigned long timeout;
 	bool handoff_set;
+#ifdef CONFIG_RWSEM_READER_PI
+	int nr_boosted;
+	bool ux_lent;
+	struct task_struct *boosted[RWSEM_PI_NR_READERS];
+	struct scx_sync_prop scx_saved[RWSEM_PI_NR_READERS];
+#endif
 };
 #define rwsem_first_waiter(sem) \
 	list_first_entry(&sem->wait_list, struct rwsem_waiter, list)
@@ -1007,6 +1056,105 @@ rwsem_spin_on_owner(struct rw_semaphore *sem)
 
  * This is being called from both reader and writer slow paths.
  */
+#ifdef CONFIG_RWSEM_READER_PI
+/*
+ * Reader priority inheritance.
+ *
+ * Before an RT or deadline waiter goes to sleep on a reader-owned rwsem, lend
+ * its priority to the tracked reader owners with rt_mutex_setprio(), the way
+ * an rt_mutex waiter boosts the lock owner. The boost is dropped once the
+ * waiter gets the lock or gives up, unless an rt_mutex donor has taken over
+ * in the meantime.
+ *
+ * A CFS or sched_ext waiter that is UX lends its UX mark and deadline level
+ * instead, with scx_sync_inherit_begin() as binder does for the length of a
+ * call, and takes them back with scx_sync_inherit_end().
+ *
+ * Only up to RWSEM_PI_NR_READERS readers are known, so this is best effort
+ * for heavily shared locks.
+ */
+static void rwsem_boost_readers(struct rw_semaphore *sem,
+				struct rwsem_waiter *waiter)
+{
+	int i, nr = waiter->nr_boosted;
+	struct scx_sync_prop prop;
+	bool rt = rt_task(current);
+
+	if (nr || !is_rwsem_reader_owned(sem))
+		return;
+
+	scx_sync_prop_capture(current, &prop);
+	waiter->ux_lent = !rt && prop.dsq_sync_ux;
+	if (!rt && !waiter->ux_lent)
+		return;
+
+	rcu_read_lock();
+	for (i = 0; i < RWSEM_PI_NR_READERS; i++) {
+		struct task_struct *p = READ_ONCE(sem->reader_owners[i]);
+		unsigned long flags;
+
+		if (!p || p == current || (rt && p->prio <= current->prio))
+			continue;
+
+		/*
+		 * @p was a reader owner after we went into the slowpath, so
+		 * it could not have been freed before rcu_read_lock().
+		 */
+		get_task_struct(p);
+		if (rt) {
+			raw_spin_lock_irqsave(&p->pi_lock, flags);
+			if (!p->pi_top_task ||
+			    p->pi_top_task->prio > current->prio)
+				rt_mutex_setprio(p, current);
+			raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+		} else {
+			scx_sync_inherit_begin(p, &prop,
+					       &waiter->scx_saved[nr]);
+		}
+		waiter->boosted[nr++] = p;
+	}
+	rcu_read_unlock();
+
+	if (nr) {
+		waiter->nr_boosted = nr;
+		lockevent_inc(rwsem_rpi_boost);
+		lockevent_add(rwsem_rpi_boosted, nr);
+	}
+}
+
+static void rwsem_unboost_readers(struct rwsem_waiter *waiter)
+{
+	int i;
+
+	for (i = 0; i < waiter->nr_boosted; i++) {
+		struct task_struct *p = waiter->boosted[i];
+		unsigned long flags;
+
+		if (waiter->ux_lent) {
+			scx_sync_inherit_end(p, &waiter->scx_saved[i]);
+		} else {
+			raw_spin_lock_irqsave(&p->pi_lock, flags);
+			if (p->pi_top_task == current)
+				rt_mutex_setprio(p, task_has_pi_waiters(p) ?
+						 task_top_pi_waiter(p)->task : NULL);
+			raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+		}
+		put_task_struct(p);
+	}
+	waiter->nr_boosted = 0;
+}
+
+static inline void rwsem_init_pi_waiter(struct rwsem_waiter *waiter)
+{
+	waiter->nr_boosted = 0;
+}
+#else
+static inline void rwsem_boost_readers(struct rw_semaphore *sem,
+				       struct rwsem_waiter *waiter) { }
+static inline void rwsem_unboost_readers(struct rwsem_waiter *waiter) { }
+static inline void rwsem_init_pi_waiter(struct rwsem_waiter *waiter) { }
+#endif
+
 static inline void rwsem_cond_wake_waiter(struct rw_semaphore *sem, long count,
 					  struct wake_q_head *wake_q)
 {
@@ -1037,6 +1185,7 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 	bool already_on_list = false;
 	bool steal = true;
 	bool rspin = false;
+	u64 cstat_start = lock_cstat_start();
 
 	/*
 	 * To prevent a constant stream of readers from starving a sleeping
@@ -1069,6 +1218,8 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 			wake_up_q(&wake_q);
 		}
 		trace_android_vh_record_rwsem_lock_starttime(sem, jiffies);
+		lock_cstat_record(LOCK_CSTAT_RWSEM_READ, LOCK_CSTAT_SPUN,
+				  cstat_start);
 		return sem;
 	}
 	/*
@@ -1083,6 +1234,7 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 	waiter.type = RWSEM_WAITING_FOR_READ;
 	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 	waiter.handoff_set = false;
+	rwsem_init_pi_waiter(&waiter);
 
 	raw_spin_lock_irq(&sem->wait_lock);
 	if (list_empty(&sem->wait_list)) {
@@ -1098,6 +1250,8 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 			raw_spin_unlock_irq(&sem->wait_lock);
 			rwsem_set_reader_owned(sem);
 			lockevent_inc(rwsem_rlock_fast);
+			lock_cstat_record(LOCK_CSTAT_RWSEM_READ,
+					  LOCK_CSTAT_SPUN, cstat_start);
 			return sem;
 		}
 		adjustment += RWSEM_FLAG_WAITERS;
@@ -1136,23 +1290,30 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 			/* Ordered by sem->wait_lock against rwsem_mark_wake(). */
 			break;
 		}
+		rwsem_boost_readers(sem, &waiter);
 		schedule_preempt_disabled();
 		lockevent_inc(rwsem_sleep_reader);
 	}
 
 	__set_current_state(TASK_RUNNING);
+	rwsem_unboost_readers(&waiter);
+	/* The lock was handed to us by rwsem_mark_wake() */
+	rwsem_track_reader(sem);
 	trace_android_vh_rwsem_read_wait_finish(sem);
 	lockevent_inc(rwsem_rlock);
 	trace_contention_end(sem, 0);
 	trace_android_vh_record_rwsem_lock_starttime(sem, jiffies);
+	lock_cstat_record(LOCK_CSTAT_RWSEM_READ, LOCK_CSTAT_SLEPT, cstat_start);
 	return sem;
 
 out_nolock:
 	rwsem_del_wake_waiter(sem, &waiter, &wake_q);
 	__set_current_state(TASK_RUNNING);
+	rwsem_unboost_readers(&waiter);
 	trace_android_vh_rwsem_read_wait_finish(sem);
 	lockevent_inc(rwsem_rlock_fail);
 	trace_contention_end(sem, -EINTR);
+	lock_cstat_record(LOCK_CSTAT_RWSEM_READ, LOCK_CSTAT_FAILED, cstat_start);
 	return ERR_PTR(-EINTR);
 }
 
@@ -1165,11 +1326,14 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 	struct rwsem_waiter waiter;
 	DEFINE_WAKE_Q(wake_q);
 	bool already_on_list = false;
+	u64 cstat_start = lock_cstat_start();
 
 	/* do optimistic spinning and steal lock if possible */
 	if (rwsem_can_spin_on_owner(sem) && rwsem_optimistic_spin(sem)) {
 		/* rwsem_optimistic_spin() implies ACQUIRE on success */
 		trace_android_vh_record_rwsem_lock_starttime(sem, jiffies);
+		lock_cstat_record(LOCK_CSTAT_RWSEM_WRITE, LOCK_CSTAT_SPUN,
+				  cstat_start);
 		return sem;
 	}
 
@@ -1181,6 +1345,7 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
 	waiter.timeout = jiffies + RWSEM_WAIT_TIMEOUT;
 	waiter.handoff_set = false;
+	rwsem_init_pi_waiter(&waiter);
 
 	raw_spin_lock_irq(&sem->wait_lock);
 	trace_android_vh_alter_rwsem_list_add(
@@ -1239,6 +1404,7 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 				goto trylock_again;
 		}
 
+		rwsem_boost_readers(sem, &waiter);
 		schedule_preempt_disabled();
 		lockevent_inc(rwsem_sleep_writer);
 		set_current_state(state);
@@ -1248,18 +1414,24 @@ rwsem_down_write_slowpath(struct rw_semaphore *sem, int state)
 	__set_current_state(TASK_RUNNING);
 	trace_android_vh_rwsem_write_wait_finish(sem);
 	raw_spin_unlock_irq(&sem->wait_lock);
+	rwsem_unboost_readers(&waiter);
 	lockevent_inc(rwsem_wlock);
 	trace_contention_end(sem, 0);
 	trace_android_vh_record_rwsem_lock_starttime(sem, jiffies);
+	lock_cstat_record(LOCK_CSTAT_RWSEM_WRITE,
+			  waiter.handoff_set ? LOCK_CSTAT_HANDOFF : LOCK_CSTAT_SLEPT,
+			  cstat_start);
 	return sem;
 
 out_nolock:
 	__set_current_state(TASK_RUNNING);
+	rwsem_unboost_readers(&waiter);
 	trace_android_vh_rwsem_write_wait_finish(sem);
 	raw_spin_lock_irq(&sem->wait_lock);
 	rwsem_del_wake_waiter(sem, &waiter, &wake_q);
 	lockevent_inc(rwsem_wlock_fail);
 	trace_contention_end(sem, -EINTR);
+	lock_cstat_record(LOCK_CSTAT_RWSEM_WRITE, LOCK_CSTAT_FAILED, cstat_start);
 	return ERR_PTR(-EINTR);
 }
 
@@ -1424,6 +1596,7 @@ static inline void __up_read(struct rw_semaphore *sem)
 
 	preempt_disable();
 	rwsem_clear_reader_owned(sem);
+	rwsem_untrack_reader(sem);
 	tmp = atomic_long_add_return_release(-RWSEM_READER_BIAS, &sem->count);
 	DEBUG_RWSEMS_WARN_ON(tmp < 0, sem);
 	if (unlikely((tmp & (RWSEM_LOCK_MASK|RWSEM_FLAG_WAITERS)) ==
@@ -1584,6 +1757,10 @@ static inline void __rwsem_set_reader_owned(struct rw_semaphore *sem,
 {
 }
 
+static inline void rwsem_untrack_reader(struct rw_semaphore *sem)
+{
+}
+
 static inline bool is_rwsem_reader_owned(struct rw_semaphore *sem)
 {
 	int count = atomic_read(&sem->rwbase.readers);
@@ -1764,6 +1941,8 @@ void down_read_non_owner(struct rw_semaphore *sem)
 	 * context here.
 	 */
 	__rwsem_set_reader_owned(sem, NULL);
+	/* up_read_non_owner() may come from another task */
+	rwsem_untrack_reader(sem);
 }
 EXPORT_SYMBOL(down_read_non_owner);
 
@@ -68,6 +68,10 @@ struct load_info {
 	char *secstrings, *strtab;
 	unsigned long symoffs, stroffs, init_typeoffs, core_typeoffs;
 	bool sig_ok;
+	/* finit_module_batch() already ran module_sig_verify(), see sig_err */
+	bool sig_checked;
+	int sig_err;
+	u64 load_ns[MOD_LOAD_PHASE_NR];
 #ifdef CONFIG_KALLSYMS
 	unsigned long mod_kallsyms_init_off;
 #endif
@@ -329,8 +333,18 @@ int module_enforce_rwx_sections(Elf_Ehdr *hdr, Elf_Shdr *sechdrs,
 				char *secstrings, struct module *mod);
 
 #ifdef CONFIG_MODULE_SIG
+int module_sig_verify(struct load_info *info, int flags);
+int module_sig_allowed(int err);
 int module_sig_check(struct load_info *info, int flags);
 #else /* !CONFIG_MODULE_SIG */
+static inline int module_sig_verify(struct load_info *info, int flags)
+{
+	return 0;
+}
+static inline int module_sig_allowed(int err)
+{
+	return 0;
+}
 static inline int module_sig_check(struct load_info *info, int flags)
 {
 	return 0;
@@ -348,6 +362,7 @@ static inline void kmemleak_load_module(const struct module *mod,
 void init_build_id(struct module *mod, const struct load_info *info);
 void layout_symtab(struct module *mod, struct load_info *info);
 void add_kallsyms(struct module *mod, const struct load_info *info);
+void free_kallsyms_index(struct module *mod);
 
 static inline bool sect_empty(const Elf_Shdr *sect)
 {
@@ -357,6 +372,7 @@ static inline bool sect_empty(const Elf_Shdr *sect)
 static inline void init_build_id(struct module *mod, const struct load_info *info) { }
 static inline void layout_symtab(struct module *mod, struct load_info *info) { }
 static inline void add_kallsyms(struct module *mod, const struct load_info *info) { }
+static inline void free_kallsyms_index(struct module *mod) { }
 #endif /* CONFIG_KALLSYMS */
 
 #ifdef CONFIG_SYSFS
@@ -10,6 +10,7 @@
 #include <linux/kallsyms.h>
 #include <linux/buildid.h>
 #include <linux/bsearch.h>
+#include <linux/sort.h>
 #include "internal.h"
 
 /* Lookup exported symbol in given range of kernel_symbols */
@@ -162,6 +163,90 @@ void layout_symtab(struct module *mod, struct load_info *info)
 	mod_mem_init_data->size += nsrc * sizeof(char);
 }
 
+static const char *kallsyms_symbol_name(const struct mod_kallsyms *kallsyms,
+					unsigned int symnum)
+{
+	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+}
+
+static unsigned long kallsyms_index_value(const struct mod_kallsyms *kallsyms,
+					  unsigned int pos)
+{
+	return kallsyms_symbol_value(&kallsyms->symtab[kallsyms->addr_index[pos]]);
+}
+
+/* Ties are broken by symtab order, so lookups match a linear scan. */
+static int cmp_kallsyms_name(const void *a, const void *b, const void *priv)
+{
+	const struct mod_kallsyms *kallsyms = priv;
+	unsigned int ia = *(const unsigned int *)a;
+	unsigned int ib = *(const unsigned int *)b;
+	int ret;
+
+	ret = strcmp(kallsyms_symbol_name(kallsyms, ia),
+		     kallsyms_symbol_name(kallsyms, ib));
+	if (ret)
+		return ret;
+	return ia < ib ? -1 : ia > ib;
+}
+
+static int cmp_kallsyms_addr(const void *a, const void *b, const void *priv)
+{
+	const struct mod_kallsyms *kallsyms = priv;
+	unsigned int ia = *(const unsigned int *)a;
+	unsigned int ib = *(const unsigned int *)b;
+	unsigned long va = kallsyms_symbol_value(&kallsyms->symtab[ia]);
+	unsigned long vb = kallsyms_symbol_value(&kallsyms->symtab[ib]);
+
+	if (va != vb)
+		return va < vb ? -1 : 1;
+	return ia < ib ? -1 : ia > ib;
+}
+
+/*
+ * Sort the defined symbols of the core symtab by name and by address, so
+ * that lookups in a module are a binary search rather than a scan of all its
+ * symbols. Without memory for the index, lookups fall back to scanning.
+ */
+static void build_kallsyms_index(struct mod_kallsyms *kallsyms)
+{
+	unsigned int *name_index, *addr_index;
+	unsigned int i, nname = 0, naddr = 0;
+
+	name_index = kvmalloc_array(kallsyms->num_symtab, sizeof(*name_index),
+				    GFP_KERNEL);
+	addr_index = kvmalloc_array(kallsyms->num_symtab, sizeof(*addr_index),
+				    GFP_KERNEL);
+	if (!name_index || !addr_index) {
+		kvfree(name_index);
+		kvfree(addr_index);
+		return;
+	}
+
+	for (i = 1; i < kallsyms->num_symtab; i++) {
+		const char *name = kallsyms_symbol_name(kallsyms, i);
+
+		if (kallsyms->symtab[i].st_shndx == SHN_UNDEF)
+			continue;
+		name_index[nname++] = i;
+
+		/* Same filter as find_kallsyms_symbol() */
+		if (*name == '\0' || is_mapping_symbol(name))
+			continue;
+		addr_index[naddr++] = i;
+	}
+
+	sort_r(name_index, nname, sizeof(*name_index), cmp_kallsyms_name, NULL,
+	       kallsyms);
+	sort_r(addr_index, naddr, sizeof(*addr_index), cmp_kallsyms_addr, NULL,
+	       kallsyms);
+
+	kallsyms->name_index = name_index;
+	kallsyms->num_name_index = nname;
+	kallsyms->addr_index = addr_index;
+	kallsyms->num_addr_index = naddr;
+}
+
 /*
  * We use the full symtab and strtab which layout_symtab arranged to
  * be appended to the init section.  Later we switch to the cut-down
@@ -222,6 +307,16 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	}
 	rcu_read_unlock();
 	mod->core_kallsyms.num_symtab = ndst;
+
+	build_kallsyms_index(&mod->core_kallsyms);
+}
+
+void free_kallsyms_index(struct module *mod)
+{
+	kvfree(mod->core_kallsyms.name_index);
+	kvfree(mod->core_kallsyms.addr_index);
+	mod->core_kallsyms.name_index = NULL;
+	mod->core_kallsyms.addr_index = NULL;
 }
 
 #if IS_ENABLED(CONFIG_STACKTRACE_BUILD_ID)
@@ -244,10 +339,6 @@ void init_build_id(struct module *mod, const struct load_info *info)
 }
 #endif
 
-static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
-{
-	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
-}
 
 /*
  * Given a module and address, find the corresponding symbol and return its name
@@ -273,6 +364,33 @@ static const char *find_kallsyms_symbol(struct module *mod,
 
 	bestval = kallsyms_symbol_value(&kallsyms->symtab[best]);
 
+	if (kallsyms->addr_index) {
+		unsigned int lo = 0, hi = kallsyms->num_addr_index, mid;
+
+		/* Find the first symbol above addr */
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (kallsyms_index_value(kallsyms, mid) <= addr)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < kallsyms->num_addr_index &&
+		    kallsyms_index_value(kallsyms, lo) < nextval)
+			nextval = kallsyms_index_value(kallsyms, lo);
+		if (!lo || kallsyms_index_value(kallsyms, lo - 1) <= bestval)
+			return NULL;
+
+		/* Of several symbols at the same address, use the first one */
+		mid = lo - 1;
+		while (mid && kallsyms_index_value(kallsyms, mid - 1) ==
+			      kallsyms_index_value(kallsyms, mid))
+			mid--;
+		best = kallsyms->addr_index[mid];
+		bestval = kallsyms_index_value(kallsyms, mid);
+		goto found;
+	}
+
 	/*
 	 * Scan for closest preceding symbol, and next symbol. (ELF
 	 * starts real symbols at 1).
@@ -303,6 +421,7 @@ static const char *find_kallsyms_symbol(struct module *mod,
 	if (!best)
 		return NULL;
 
+found:
 	if (size)
 		*size = nextval - bestval;
 	if (offset)
@@ -416,6 +535,26 @@ static unsigned long __find_kallsyms_symbol_value(struct module *mod, const char
 	unsigned int i;
 	struct mod_kallsyms *kallsyms = rcu_dereference_sched(mod->kallsyms);
 
+	if (kallsyms->name_index) {
+		unsigned int lo = 0, hi = kallsyms->num_name_index, mid;
+
+		/* Find the first symbol not sorting before name */
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			i = kallsyms->name_index[mid];
+			if (strcmp(kallsyms_symbol_name(kallsyms, i), name) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == kallsyms->num_name_index)
+			return 0;
+		i = kallsyms->name_index[lo];
+		if (strcmp(kallsyms_symbol_name(kallsyms, i), name))
+			return 0;
+		return kallsyms_symbol_value(&kallsyms->symtab[i]);
+	}
+
 	for (i = 0; i < kallsyms->num_symtab; i++) {
 		const Elf_Sym *sym = &kallsyms->symtab[i];
 
@@ -977,6 +977,34 @@ static ssize_t show_taint(struct module_attribute *mattr,
 static struct module_attribute modinfo_taint =
 	__ATTR(taint, 0444, show_taint, NULL);
 
+static const char * const mod_load_phase_names[MOD_LOAD_PHASE_NR] = {
+	[MOD_LOAD_READ]		= "read",
+	[MOD_LOAD_DECOMPRESS]	= "decompress",
+	[MOD_LOAD_SIG]		= "signature",
+	[MOD_LOAD_LINK]		= "link",
+	[MOD_LOAD_INIT]		= "init",
+};
+
+static ssize_t show_load_times(struct module_attribute *mattr,
+			       struct module_kobject *mk, char *buffer)
+{
+	unsigned int *load_time_us = smp_load_acquire(&mk->mod->load_time_us);
+	ssize_t len = 0;
+	int i;
+
+	if (!load_time_us)
+		return 0;
+
+	for (i = 0; i < MOD_LOAD_PHASE_NR; i++)
+		len += sysfs_emit_at(buffer, len, "%s %u\n",
+				     mod_load_phase_names[i],
+				     READ_ONCE(load_time_us[i]));
+	return len;
+}
+
+static struct module_attribute modinfo_load_times =
+	__ATTR(load_times, 0444, show_load_times, NULL);
+
 struct module_attribute *modinfo_attrs[] = {
 	&module_uevent,
 	&modinfo_version,
@@ -989,6 +1017,7 @@ struct module_attribute *modinfo_attrs[] = {
 #endif
 	&modinfo_initsize,
 	&modinfo_taint,
+	&modinfo_load_times,
 #ifdef CONFIG_MODULE_UNLOAD
 	&modinfo_refcnt,
 #endif
@@ -1242,6 +1271,8 @@ static void module_memory_free(void *ptr, enum mod_mem_type type)
 
 static void free_mod_mem(struct module *mod)
 {
+	free_kallsyms_index(mod);
+
 	for_each_mod_mem_type(type) {
 		struct module_memory *mod_mem = &mod->mem[type];
 
@@ -1303,6 +1334,7 @@ static void free_module(struct module *mod)
 	/* This may be empty, but that's OK */
 	module_arch_freeing_init(mod);
 	kfree(mod->args);
+	kfree(mod->load_time_us);
 	percpu_modfree(mod);
 
 	free_mod_mem(mod);
@@ -2545,6 +2577,7 @@ static noinline int do_init_module(struct module *mod)
 {
 	int ret = 0;
 	struct mod_initfree *freeinit;
+	u64 start;
 #if defined(CONFIG_MODULE_STATS)
 	unsigned int text_size = 0, total_size = 0;
 
@@ -2567,10 +2600,14 @@ static noinline int do_init_module(struct module *mod)
 	freeinit->init_data = mod->mem[MOD_INIT_DATA].base;
 	freeinit->init_rodata = mod->mem[MOD_INIT_RODATA].base;
 
+	start = ktime_get_ns();
 	do_mod_ctors(mod);
 	/* Start the module */
 	if (mod->init != NULL)
 		ret = do_one_initcall(mod->init);
+	if (mod->load_time_us)
+		WRITE_ONCE(mod->load_time_us[MOD_LOAD_INIT],
+			   div_u64(ktime_get_ns() - start, NSEC_PER_USEC));
 	if (ret < 0) {
 		goto fail_free_freeinit;
 	}
@@ -2875,6 +2912,9 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	bool module_allocated = false;
 	long err = 0;
 	char *after_dashes;
+	u64 start = ktime_get_ns();
+	unsigned int *load_time_us;
+	int i;
 
 	/*
 	 * Do the signature check (if any) first. All that
@@ -2887,8 +2927,18 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	 * The check will also adjust info->len by stripping
 	 * off the sig length at the end of the module, making
 	 * checks against info->len more correct.
+	 *
+	 * finit_module_batch() has already verified the signature in
+	 * parallel, which leaves deciding whether a module without a valid
+	 * one may be loaded, in the context of the loading task.
 	 */
-	err = module_sig_check(info, flags);
+	if (info->sig_checked) {
+		err = module_sig_allowed(info->sig_err);
+	} else {
+		err = module_sig_check(info, flags);
+		info->load_ns[MOD_LOAD_SIG] = ktime_get_ns() - start;
+		start += info->load_ns[MOD_LOAD_SIG];
+	}
 	if (err)
 		goto free_copy;
 
@@ -3018,6 +3068,17 @@ static int load_module(struct load_info *info, const char __user *uargs,
 	/* Get rid of temporary copy. */
 	free_copy(info, flags);
 
+	info->load_ns[MOD_LOAD_LINK] = ktime_get_ns() - start;
+	load_time_us = kcalloc(MOD_LOAD_PHASE_NR, sizeof(*load_time_us),
+			       GFP_KERNEL);
+	if (load_time_us) {
+		for (i = 0; i < MOD_LOAD_INIT; i++)
+			load_time_us[i] = div_u64(info->load_ns[i],
+						  NSEC_PER_USEC);
+		/* Pairs with show_load_times() */
+		smp_store_release(&mod->load_time_us, load_time_us);
+	}
+
 	/* Done! */
 	trace_module_load(mod);
 
@@ -3163,31 +3224,62 @@ static int idempotent_complete(struct idempotent *u, int ret)
 	return ret;
 }
 
-static int init_module_from_file(struct file *f, const char __user * uargs, int flags)
+static int read_module_file(struct load_info *info, struct file *f,
+			    void **buf)
 {
-	struct load_info info = { };
-	void *buf = NULL;
+	u64 start = ktime_get_ns();
 	int len;
 
-	len = kernel_read_file(f, 0, &buf, INT_MAX, NULL, READING_MODULE);
+	len = kernel_read_file(f, 0, buf, INT_MAX, NULL, READING_MODULE);
 	if (len < 0) {
 		mod_stat_inc(&failed_kreads);
 		return len;
 	}
 
-	if (flags & MODULE_INIT_COMPRESSED_FILE) {
-		int err = module_decompress(&info, buf, len);
-		vfree(buf); /* compressed data is no longer needed */
-		if (err) {
-			mod_stat_inc(&failed_decompress);
-			mod_stat_add_long(len, &invalid_decompress_bytes);
-			return err;
-		}
-	} else {
-		info.hdr = buf;
-		info.len = len;
+	info->load_ns[MOD_LOAD_READ] = ktime_get_ns() - start;
+	return len;
+}
+
+/* Set up @info from the image read by read_module_file(), consuming @buf */
+static int setup_module_image(struct load_info *info, void *buf, int len,
+			      int flags)
+{
+	u64 start;
+	int err;
+
+	if (!(flags & MODULE_INIT_COMPRESSED_FILE)) {
+		info->hdr = buf;
+		info->len = len;
+		return 0;
+	}
+
+	start = ktime_get_ns();
+	err = module_decompress(info, buf, len);
+	vfree(buf); /* compressed data is no longer needed */
+	if (err) {
+		mod_stat_inc(&failed_decompress);
+		mod_stat_add_long(len, &invalid_decompress_bytes);
+		return err;
 	}
 
+	info->load_ns[MOD_LOAD_DECOMPRESS] = ktime_get_ns() - start;
+	return 0;
+}
+
+static int init_module_from_file(struct file *f, const char __user * uargs, int flags)
+{
+	struct load_info info = { };
+	void *buf = NULL;
+	int len, err;
+
+	len = read_module_file(&info, f, &buf);
+	if (len < 0)
+		return len;
+
+	err = setup_module_image(&info, buf, len, flags);
+	if (err)
+		return err;
+
 	return load_module(&info, uargs, flags);
 }
 
@@ -3231,6 +3323,195 @@ SYSCALL_DEFINE3(finit_module, int, fd, const char __user *, uargs, int, flags)
 	return err;
 }
 
+/* Upper bound on the number of modules in one finit_module_batch() call */
+#define MODULE_BATCH_MAX	1024
+
+struct module_batch {
+	struct load_info info;
+	const char __user *uargs;
+	void *buf;
+	int len;
+	int flags;
+	/* Valid until the module is loaded, they point into its image */
+	const char *name;
+	const char *depends;
+	bool done;
+	int ret;
+};
+
+/*
+ * Decompress, verify the signature of and validate the ELF image of one
+ * module. None of this touches global module state or depends on the
+ * loading task, so all images of a batch are prepared in parallel.
+ */
+static void module_batch_prepare(void *data, async_cookie_t cookie)
+{
+	struct module_batch *b = data;
+	struct load_info *info = &b->info;
+	u64 start;
+	int err;
+
+	err = setup_module_image(info, b->buf, b->len, b->flags);
+	if (err)
+		goto fail;
+
+	/* load_module() applies the signature policy, see module_sig_allowed() */
+	start = ktime_get_ns();
+	info->sig_err = module_sig_verify(info, b->flags);
+	info->load_ns[MOD_LOAD_SIG] = ktime_get_ns() - start;
+	info->sig_checked = true;
+
+	err = elf_validity_cache_copy(info, b->flags);
+	if (err)
+		goto free;
+
+	b->name = info->name;
+	b->depends = get_modinfo(info, "depends");
+	return;
+
+free:
+	mod_stat_bump_becoming(info, b->flags);
+	free_copy(info, b->flags);
+fail:
+	b->ret = err;
+	b->done = true;
+}
+
+/*
+ * A module can be linked once all modules it depends on that are part of the
+ * same batch are done, so that their symbols are available.
+ */
+static bool module_batch_deps_done(struct module_batch *batch, unsigned int nr,
+				   const struct module_batch *b)
+{
+	const char *dep = b->depends;
+	unsigned int i;
+	size_t len;
+
+	while (dep && *dep) {
+		len = strcspn(dep, ",");
+		for (i = 0; i < nr; i++) {
+			if (batch[i].done)
+				continue;
+			if (strlen(batch[i].name) == len &&
+			    !strncmp(batch[i].name, dep, len))
+				return false;
+		}
+		dep += len;
+		if (*dep == ',')
+			dep++;
+	}
+
+	return true;
+}
+
+static void module_batch_load(struct module_batch *b)
+{
+	b->ret = load_module(&b->info, b->uargs, b->flags);
+	b->name = b->depends = NULL;
+	b->done = true;
+}
+
+static void module_batch_link(struct module_batch *batch, unsigned int nr)
+{
+	bool progress;
+	unsigned int i;
+
+	do {
+		progress = false;
+		for (i = 0; i < nr; i++) {
+			if (batch[i].done ||
+			    !module_batch_deps_done(batch, nr, &batch[i]))
+				continue;
+			module_batch_load(&batch[i]);
+			progress = true;
+		}
+	} while (progress);
+
+	/* Dependency cycle: let load_module() sort out the unknown symbols */
+	for (i = 0; i < nr; i++)
+		if (!batch[i].done)
+			module_batch_load(&batch[i]);
+}
+
+/*
+ * Load several modules at once. The images are read in the order given, then
+ * decompressed and signature checked concurrently, and finally linked and
+ * initialized one by one, each after the modules of the batch it depends on.
+ * Returns the number of modules loaded; the result of each load is reported
+ * in its entry.
+ */
+SYSCALL_DEFINE3(finit_module_batch, struct module_batch_entry __user *, uentries,
+		unsigned int, nr, int, flags)
+{
+	ASYNC_DOMAIN_EXCLUSIVE(domain);
+	struct module_batch_entry *entries;
+	struct module_batch *batch;
+	unsigned int i, loaded = 0;
+	struct fd f;
+	int err;
+
+	err = may_init_module();
+	if (err)
+		return err;
+
+	if (flags & ~(MODULE_INIT_IGNORE_MODVERSIONS
+		      |MODULE_INIT_IGNORE_VERMAGIC
+		      |MODULE_INIT_COMPRESSED_FILE))
+		return -EINVAL;
+
+	if (!nr || nr > MODULE_BATCH_MAX)
+		return -EINVAL;
+
+	entries = vmemdup_array_user(uentries, nr, sizeof(*entries));
+	if (IS_ERR(entries))
+		return PTR_ERR(entries);
+
+	batch = kvcalloc(nr, sizeof(*batch), GFP_KERNEL);
+	if (!batch) {
+		kvfree(entries);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct module_batch *b = &batch[i];
+
+		b->uargs = u64_to_user_ptr(entries[i].uargs);
+		b->flags = flags;
+
+		f = fdget(entries[i].fd);
+		if (!f.file || !(f.file->f_mode & FMODE_READ))
+			b->len = -EBADF;
+		else
+			b->len = read_module_file(&b->info, f.file, &b->buf);
+		fdput(f);
+		if (b->len < 0) {
+			b->ret = b->len;
+			b->done = true;
+			continue;
+		}
+
+		async_schedule_domain(module_batch_prepare, b, &domain);
+	}
+	async_synchronize_full_domain(&domain);
+
+	module_batch_link(batch, nr);
+
+	for (i = 0; i < nr; i++) {
+		entries[i].ret = batch[i].ret;
+		if (!batch[i].ret)
+			loaded++;
+	}
+
+	err = loaded;
+	if (copy_to_user(uentries, entries, array_size(nr, sizeof(*entries))))
+		err = -EFAULT;
+
+	kvfree(batch);
+	kvfree(entries);
+	return err;
+}
+
 /* Keep in sync with MODULE_FLAGS_BUF_SIZE !!! */
 char *module_flags(struct module *mod, char *buf, bool show_state)
 {
@@ -74,11 +74,15 @@ int mod_verify_sig(const void *mod, struct load_info *info)
 				      NULL, NULL);
 }
 
-int module_sig_check(struct load_info *info, int flags)
+/*
+ * Check the signature appended to the module, if any. Returns 0 if it is
+ * valid and the reason it is not otherwise. This only looks at the image;
+ * whether the module may be loaded anyway is up to module_sig_allowed().
+ */
+int module_sig_verify(struct load_info *info, int flags)
 {
 	int err = -ENODATA;
 	const unsigned long markerlen = sizeof(MODULE_SIG_STRING) - 1;
-	const char *reason;
 	const void *mod = info->hdr;
 	bool mangled_module = flags & (MODULE_INIT_IGNORE_MODVERSIONS |
 				       MODULE_INIT_IGNORE_VERMAGIC);
@@ -92,12 +96,25 @@ int module_sig_check(struct load_info *info, int flags)
 		/* We truncate the module to discard the signature */
 		info->len -= markerlen;
 		err = mod_verify_sig(mod, info);
-		if (!err) {
+		if (!err)
 			info->sig_ok = true;
-			return 0;
-		}
 	}
 
+	return err;
+}
+
+/*
+ * Decide whether a module that failed module_sig_verify() with @err may be
+ * loaded. This asks the LSMs about lockdown, so it has to be called by the
+ * task loading the module.
+ */
+int module_sig_allowed(int err)
+{
+	const char *reason;
+
+	if (!err)
+		return 0;
+
 	/*
 	 * We don't permit modules to be loaded into the trusted kernels
 	 * without a valid signature on them, but if we're not enforcing,
@@ -138,3 +155,8 @@ int module_sig_check(struct load_info *info, int flags)
 	return 0;
 #endif
 }
+
+int module_sig_check(struct load_info *info, int flags)
+{
+	return module_sig_allowed(module_sig_verify(info, flags));
+}
@@ -25,11 +25,13 @@
 #include <linux/nmi.h>
 #include <linux/console.h>
 #include <linux/cpu.h>
+#include <linux/crypto.h>
 #include <linux/freezer.h>
 #include <linux/gfp.h>
 #include <linux/syscore_ops.h>
 #include <linux/ctype.h>
 #include <linux/ktime.h>
+#include <linux/moduleparam.h>
 #include <linux/security.h>
 #include <linux/secretmem.h>
 #include <trace/events/power.h>
@@ -38,6 +40,10 @@
 
 
 static int nocompress;
+/* Crypto API compressor for the image: "lzo", "lz4" or "zstd" */
+char hib_comp_algo[CRYPTO_MAX_ALG_NAME] = "lzo";
+/* Number of compression threads, 0 to pick one from the number of CPUs */
+unsigned int hib_comp_threads;
 static int noresume;
 static int nohibernate;
 static int resume_wait;
@@ -764,6 +770,10 @@ int hibernate(void)
 			flags |= SF_NOCOMPRESS_MODE;
 		else
 		        flags |= SF_CRC32_MODE;
+		if (!strcmp(hib_comp_algo, "lz4"))
+			flags |= SF_COMPRESSION_ALG_LZ4;
+		else if (!strcmp(hib_comp_algo, "zstd"))
+			flags |= SF_COMPRESSION_ALG_ZSTD;
 
 		pm_pr_dbg("Writing hibernation image.\n");
 		error = swsusp_write(flags);
@@ -1364,6 +1374,38 @@ static int __init nohibernate_setup(char *str)
 	return 1;
 }
 
+static int hibernate_compressor_set(const char *val,
+				    const struct kernel_param *kp)
+{
+	char name[CRYPTO_MAX_ALG_NAME];
+
+	strscpy(name, val, sizeof(name));
+	strim(name);
+	if (strcmp(name, "lzo") && strcmp(name, "lz4") && strcmp(name, "zstd"))
+		return -EINVAL;
+
+	/* Only the resume side would notice, when it is too late */
+	if (slab_is_available() && !crypto_has_comp(name, 0, 0))
+		return -ENOENT;
+
+	strscpy(hib_comp_algo, name, CRYPTO_MAX_ALG_NAME);
+	return 0;
+}
+
+static const struct kernel_param_ops hibernate_compressor_ops = {
+	.set	= hibernate_compressor_set,
+	.get	= param_get_string,
+};
+
+static struct kparam_string hibernate_compressor = {
+	.maxlen	= CRYPTO_MAX_ALG_NAME,
+	.string	= hib_comp_algo,
+};
+
+module_param_cb(compressor, &hibernate_compressor_ops, &hibernate_compressor,
+		0644);
+module_param_named(compression_threads, hib_comp_threads, uint, 0644);
+
 __setup("noresume", noresume_setup);
 __setup("resume_offset=", resume_offset_setup);
 __setup("resume=", resume_setup);
@@ -166,8 +166,13 @@ extern int swsusp_swap_in_use(void);
 #define SF_NOCOMPRESS_MODE	2
 #define SF_CRC32_MODE	        4
 #define SF_HW_SIG		8
+/* Compressor of the image, LZO if neither is set */
+#define SF_COMPRESSION_ALG_LZ4	16
+#define SF_COMPRESSION_ALG_ZSTD	32
 
 /* kernel/power/hibernate.c */
+extern char hib_comp_algo[];
+extern unsigned int hib_comp_threads;
 int swsusp_check(bool exclusive);
 extern void swsusp_free(void);
 extern int swsusp_read(unsigned int *flags_p);
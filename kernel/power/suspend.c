@@ -31,6 +31,7 @@
 #include <linux/compiler.h>
 #include <linux/moduleparam.h>
 #include <linux/wakeup_reason.h>
+#include <linux/sched/clock.h>
 #include <trace/hooks/suspend.h>
 
 #include "power.h"
@@ -361,6 +362,7 @@ static int suspend_test(int level)
  */
 static int suspend_prepare(suspend_state_t state)
 {
+	u64 start;
 	int error;
 
 	if (!sleep_state_supported(state))
@@ -373,7 +375,9 @@ static int suspend_prepare(suspend_state_t state)
 		goto Restore;
 
 	trace_suspend_resume(TPS("freeze_processes"), 0, true);
+	start = local_clock();
 	error = suspend_freeze_processes();
+	log_suspend_phase_time(SUSPEND_PHASE_FREEZE, start);
 	trace_suspend_resume(TPS("freeze_processes"), 0, false);
 	if (!error)
 		return 0;
@@ -409,6 +413,7 @@ void __weak arch_suspend_enable_irqs(void)
 static int suspend_enter(suspend_state_t state, bool *wakeup)
 {
 	int error, last_dev;
+	u64 start;
 
 	error = platform_suspend_prepare(state);
 	if (error)
@@ -459,7 +464,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 
 	system_state = SYSTEM_SUSPEND;
 
+	start = local_clock();
 	error = syscore_suspend();
+	log_suspend_phase_time(SUSPEND_PHASE_SYSCORE, start);
 	if (!error) {
 		*wakeup = pm_wakeup_pending();
 		if (!(suspend_test(TEST_CORE) || *wakeup)) {
@@ -472,7 +479,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 		} else if (*wakeup) {
 			error = -EBUSY;
 		}
+		start = local_clock();
 		syscore_resume();
+		log_suspend_phase_time(RESUME_PHASE_SYSCORE, start);
 	}
 
 	system_state = SYSTEM_RUNNING;
@@ -564,7 +573,10 @@ int suspend_devices_and_enter(suspend_state_t state)
  */
 static void suspend_finish(void)
 {
+	u64 start = local_clock();
+
 	suspend_thaw_processes();
+	log_suspend_phase_time(RESUME_PHASE_THAW, start);
 	pm_notifier_call_chain(PM_POST_SUSPEND);
 	pm_restore_console();
 }
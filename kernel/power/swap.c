@@ -23,12 +23,12 @@
 #include <linux/swapops.h>
 #include <linux/pm.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/vmalloc.h>
 #include <linux/cpumask.h>
 #include <linux/atomic.h>
 #include <linux/kthread.h>
 #include <linux/crc32.h>
+#include <linux/crypto.h>
 #include <linux/ktime.h>
 
 #include "power.h"
@@ -223,11 +223,17 @@ int swsusp_swap_in_use(void)
 static unsigned short root_swap = 0xffff;
 static struct block_device *hib_resume_bdev;
 
+/*
+ * Pages for consecutive swap offsets are gathered into one bio of up to
+ * BIO_MAX_VECS pages, which is only submitted when the next page does not
+ * follow, or when waiting for the batch.
+ */
 struct hib_bio_batch {
 	atomic_t		count;
 	wait_queue_head_t	wait;
 	blk_status_t		error;
 	struct blk_plug		plug;
+	struct bio		*bio;		/* not submitted yet */
 };
 
 static void hib_init_batch(struct hib_bio_batch *hb)
@@ -235,18 +241,15 @@ static void hib_init_batch(struct hib_bio_batch *hb)
 	atomic_set(&hb->count, 0);
 	init_waitqueue_head(&hb->wait);
 	hb->error = BLK_STS_OK;
+	hb->bio = NULL;
 	blk_start_plug(&hb->plug);
 }
 
-static void hib_finish_batch(struct hib_bio_batch *hb)
-{
-	blk_finish_plug(&hb->plug);
-}
-
 static void hib_end_io(struct bio *bio)
 {
 	struct hib_bio_batch *hb = bio->bi_private;
-	struct page *page = bio_first_page_all(bio);
+	struct bvec_iter_all iter_all;
+	struct bio_vec *bvec;
 
 	if (bio->bi_status) {
 		pr_alert("Read-error on swap-device (%u:%u:%Lu)\n",
@@ -254,11 +257,15 @@ static void hib_end_io(struct bio *bio)
 			 (unsigned long long)bio->bi_iter.bi_sector);
 	}
 
-	if (bio_data_dir(bio) == WRITE)
-		put_page(page);
-	else if (clean_pages_on_read)
-		flush_icache_range((unsigned long)page_address(page),
-				   (unsigned long)page_address(page) + PAGE_SIZE);
+	bio_for_each_segment_all(bvec, bio, iter_all) {
+		struct page *page = bvec->bv_page;
+
+		if (bio_data_dir(bio) == WRITE)
+			put_page(page);
+		else if (clean_pages_on_read)
+			flush_icache_range((unsigned long)page_address(page),
+					   (unsigned long)page_address(page) + PAGE_SIZE);
+	}
 
 	if (bio->bi_status && !hb->error)
 		hb->error = bio->bi_status;
@@ -268,15 +275,39 @@ static void hib_end_io(struct bio *bio)
 	bio_put(bio);
 }
 
+static void hib_submit_batch_bio(struct hib_bio_batch *hb)
+{
+	struct bio *bio = hb->bio;
+
+	if (!bio)
+		return;
+
+	hb->bio = NULL;
+	bio->bi_end_io = hib_end_io;
+	bio->bi_private = hb;
+	atomic_inc(&hb->count);
+	submit_bio(bio);
+}
+
 static int hib_submit_io(blk_opf_t opf, pgoff_t page_off, void *addr,
 			 struct hib_bio_batch *hb)
 {
 	struct page *page = virt_to_page(addr);
+	sector_t sector = page_off * (PAGE_SIZE >> 9);
 	struct bio *bio;
 	int error = 0;
 
-	bio = bio_alloc(hib_resume_bdev, 1, opf, GFP_NOIO | __GFP_HIGH);
-	bio->bi_iter.bi_sector = page_off * (PAGE_SIZE >> 9);
+	if (hb && hb->bio) {
+		bio = hb->bio;
+		if (bio->bi_opf == opf && bio_end_sector(bio) == sector &&
+		    bio_add_page(bio, page, PAGE_SIZE, 0) == PAGE_SIZE)
+			return 0;
+		hib_submit_batch_bio(hb);
+	}
+
+	bio = bio_alloc(hib_resume_bdev, hb ? BIO_MAX_VECS : 1, opf,
+			GFP_NOIO | __GFP_HIGH);
+	bio->bi_iter.bi_sector = sector;
 
 	if (bio_add_page(bio, page, PAGE_SIZE, 0) < PAGE_SIZE) {
 		pr_err("Adding page to bio failed at %llu\n",
@@ -286,10 +317,7 @@ static int hib_submit_io(blk_opf_t opf, pgoff_t page_off, void *addr,
 	}
 
 	if (hb) {
-		bio->bi_end_io = hib_end_io;
-		bio->bi_private = hb;
-		atomic_inc(&hb->count);
-		submit_bio(bio);
+		hb->bio = bio;
 	} else {
 		error = submit_bio_wait(bio);
 		bio_put(bio);
@@ -300,6 +328,7 @@ static int hib_submit_io(blk_opf_t opf, pgoff_t page_off, void *addr,
 
 static int hib_wait_io(struct hib_bio_batch *hb)
 {
+	hib_submit_batch_bio(hb);
 	/*
 	 * We are relying on the behavior of blk_plug that a thread with
 	 * a plug will flush the plug list before sleeping.
@@ -308,6 +337,13 @@ static int hib_wait_io(struct hib_bio_batch *hb)
 	return blk_status_to_errno(hb->error);
 }
 
+static void hib_finish_batch(struct hib_bio_batch *hb)
+{
+	/* Error paths may still have I/O to buffers that are about to go */
+	hib_wait_io(hb);
+	blk_finish_plug(&hb->plug);
+}
+
 /*
  * Saving part
  */
@@ -513,23 +549,54 @@ static int swap_writer_finish(struct swap_map_handle *handle,
 }
 
 /* We need to remember how much compressed data we need to read. */
-#define LZO_HEADER	sizeof(size_t)
+#define CMP_HEADER	sizeof(size_t)
 
 /* Number of pages/bytes we'll compress at one time. */
-#define LZO_UNC_PAGES	32
-#define LZO_UNC_SIZE	(LZO_UNC_PAGES * PAGE_SIZE)
+#define UNC_PAGES	32
+#define UNC_SIZE	(UNC_PAGES * PAGE_SIZE)
+
+/*
+ * Worst case compressed size. This is LZO's bound, which is above the
+ * LZ4 and zstd ones for UNC_SIZE.
+ */
+#define bytes_worst_compress(x)	((x) + ((x) / 16) + 64 + 3)
 
 /* Number of pages/bytes we need for compressed data (worst case). */
-#define LZO_CMP_PAGES	DIV_ROUND_UP(lzo1x_worst_compress(LZO_UNC_SIZE) + \
-			             LZO_HEADER, PAGE_SIZE)
-#define LZO_CMP_SIZE	(LZO_CMP_PAGES * PAGE_SIZE)
+#define CMP_PAGES	DIV_ROUND_UP(bytes_worst_compress(UNC_SIZE) + \
+			             CMP_HEADER, PAGE_SIZE)
+#define CMP_SIZE	(CMP_PAGES * PAGE_SIZE)
 
-/* Maximum number of threads for compression/decompression. */
-#define LZO_THREADS	3
+/* Default and maximum number of threads for compression/decompression. */
+#define CMP_THREADS	3
+#define CMP_MAX_THREADS	16
 
 /* Minimum/maximum number of pages for read buffering. */
-#define LZO_MIN_RD_PAGES	1024
-#define LZO_MAX_RD_PAGES	8192
+#define CMP_MIN_RD_PAGES	1024
+#define CMP_MAX_RD_PAGES	8192
+
+/*
+ * Number of compression threads: hibernate.compression_threads if set,
+ * otherwise one per spare CPU, limited to keep the memory footprint down.
+ */
+static unsigned int hib_nr_threads(void)
+{
+	unsigned int nr_threads = READ_ONCE(hib_comp_threads);
+
+	if (nr_threads)
+		return clamp_val(nr_threads, 1, CMP_MAX_THREADS);
+
+	return clamp_val(num_online_cpus() - 1, 1, CMP_THREADS);
+}
+
+/* Crypto name of the compressor an image with @flags was written with. */
+static const char *hib_comp_name(unsigned int flags)
+{
+	if (flags & SF_COMPRESSION_ALG_ZSTD)
+		return "zstd";
+	if (flags & SF_COMPRESSION_ALG_LZ4)
+		return "lz4";
+	return "lzo";
+}
 
 
 /**
@@ -581,52 +648,11 @@ static int save_image(struct swap_map_handle *handle,
 }
 
 /*
- * Structure used for CRC32.
- */
-struct crc_data {
-	struct task_struct *thr;                  /* thread */
-	atomic_t ready;                           /* ready to start flag */
-	atomic_t stop;                            /* ready to stop flag */
-	unsigned run_threads;                     /* nr current threads */
-	wait_queue_head_t go;                     /* start crc update */
-	wait_queue_head_t done;                   /* crc update done */
-	u32 *crc32;                               /* points to handle's crc32 */
-	size_t *unc_len[LZO_THREADS];             /* uncompressed lengths */
-	unsigned char *unc[LZO_THREADS];          /* uncompressed data */
-};
-
-/*
- * CRC32 update function that runs in its own thread.
- */
-static int crc32_threadfn(void *data)
-{
-	struct crc_data *d = data;
-	unsigned i;
-
-	while (1) {
-		wait_event(d->go, atomic_read_acquire(&d->ready) ||
-		                  kthread_should_stop());
-		if (kthread_should_stop()) {
-			d->thr = NULL;
-			atomic_set_release(&d->stop, 1);
-			wake_up(&d->done);
-			break;
-		}
-		atomic_set(&d->ready, 0);
-
-		for (i = 0; i < d->run_threads; i++)
-			*d->crc32 = crc32_le(*d->crc32,
-			                     d->unc[i], *d->unc_len[i]);
-		atomic_set_release(&d->stop, 1);
-		wake_up(&d->done);
-	}
-	return 0;
-}
-/*
- * Structure used for LZO data compression.
+ * Structure used for data compression.
  */
 struct cmp_data {
 	struct task_struct *thr;                  /* thread */
+	struct crypto_comp *cc;                   /* crypto compressor */
 	atomic_t ready;                           /* ready to start flag */
 	atomic_t stop;                            /* ready to stop flag */
 	int ret;                                  /* return code */
@@ -634,17 +660,19 @@ struct cmp_data {
 	wait_queue_head_t done;                   /* compression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
-	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
-	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
-	unsigned char wrk[LZO1X_1_MEM_COMPRESS];  /* compression workspace */
+	u32 crc32;                                /* CRC32 of unc, seed 0 */
+	unsigned char unc[UNC_SIZE];              /* uncompressed buffer */
+	unsigned char cmp[CMP_SIZE];              /* compressed buffer */
 };
 
 /*
- * Compression function that runs in its own thread.
+ * Compression function that runs in its own thread. The CRC32 of the
+ * uncompressed data is computed here too, the main thread combines them.
  */
-static int lzo_compress_threadfn(void *data)
+static int compress_threadfn(void *data)
 {
 	struct cmp_data *d = data;
+	unsigned int cmp_len;
 
 	while (1) {
 		wait_event(d->go, atomic_read_acquire(&d->ready) ||
@@ -658,9 +686,11 @@ static int lzo_compress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->ret = lzo1x_1_compress(d->unc, d->unc_len,
-		                          d->cmp + LZO_HEADER, &d->cmp_len,
-		                          d->wrk);
+		d->crc32 = crc32_le(0, d->unc, d->unc_len);
+		cmp_len = CMP_SIZE - CMP_HEADER;
+		d->ret = crypto_comp_compress(d->cc, d->unc, d->unc_len,
+		                              d->cmp + CMP_HEADER, &cmp_len);
+		d->cmp_len = cmp_len;
 		atomic_set_release(&d->stop, 1);
 		wake_up(&d->done);
 	}
@@ -668,14 +698,16 @@ static int lzo_compress_threadfn(void *data)
 }
 
 /**
- * save_image_lzo - Save the suspend image data compressed with LZO.
+ * save_compressed_image - Save the suspend image data after compression.
  * @handle: Swap map handle to use for saving the image.
  * @snapshot: Image to read data from.
  * @nr_to_write: Number of pages to save.
+ * @algo: Crypto name of the compressor.
  */
-static int save_image_lzo(struct swap_map_handle *handle,
-                          struct snapshot_handle *snapshot,
-                          unsigned int nr_to_write)
+static int save_compressed_image(struct swap_map_handle *handle,
+                                 struct snapshot_handle *snapshot,
+                                 unsigned int nr_to_write,
+                                 const char *algo)
 {
 	unsigned int m;
 	int ret = 0;
@@ -684,38 +716,27 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	struct hib_bio_batch hb;
 	ktime_t start;
 	ktime_t stop;
+	ktime_t t;
+	s64 copy_ns = 0, cmp_ns = 0, io_ns = 0;
 	size_t off;
 	unsigned thr, run_threads, nr_threads;
 	unsigned char *page = NULL;
 	struct cmp_data *data = NULL;
-	struct crc_data *crc = NULL;
 
 	hib_init_batch(&hb);
 
-	/*
-	 * We'll limit the number of threads for compression to limit memory
-	 * footprint.
-	 */
-	nr_threads = num_online_cpus() - 1;
-	nr_threads = clamp_val(nr_threads, 1, LZO_THREADS);
+	nr_threads = hib_nr_threads();
 
 	page = (void *)__get_free_page(GFP_NOIO | __GFP_HIGH);
 	if (!page) {
-		pr_err("Failed to allocate LZO page\n");
+		pr_err("Failed to allocate %s page\n", algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
 
 	data = vzalloc(array_size(nr_threads, sizeof(*data)));
 	if (!data) {
-		pr_err("Failed to allocate LZO data\n");
-		ret = -ENOMEM;
-		goto out_clean;
-	}
-
-	crc = kzalloc(sizeof(*crc), GFP_KERNEL);
-	if (!crc) {
-		pr_err("Failed to allocate crc\n");
+		pr_err("Failed to allocate %s data\n", algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
@@ -727,7 +748,15 @@ static int save_image_lzo(struct swap_map_handle *handle,
 		init_waitqueue_head(&data[thr].go);
 		init_waitqueue_head(&data[thr].done);
 
-		data[thr].thr = kthread_run(lzo_compress_threadfn,
+		data[thr].cc = crypto_alloc_comp(algo, 0, 0);
+		if (IS_ERR(data[thr].cc)) {
+			pr_err("Could not allocate %s compressor\n", algo);
+			ret = PTR_ERR(data[thr].cc);
+			data[thr].cc = NULL;
+			goto out_clean;
+		}
+
+		data[thr].thr = kthread_run(compress_threadfn,
 		                            &data[thr],
 		                            "image_compress/%u", thr);
 		if (IS_ERR(data[thr].thr)) {
@@ -738,26 +767,7 @@ static int save_image_lzo(struct swap_map_handle *handle,
 		}
 	}
 
-	/*
-	 * Start the CRC32 thread.
-	 */
-	init_waitqueue_head(&crc->go);
-	init_waitqueue_head(&crc->done);
-
 	handle->crc32 = 0;
-	crc->crc32 = &handle->crc32;
-	for (thr = 0; thr < nr_threads; thr++) {
-		crc->unc[thr] = data[thr].unc;
-		crc->unc_len[thr] = &data[thr].unc_len;
-	}
-
-	crc->thr = kthread_run(crc32_threadfn, crc, "image_crc32");
-	if (IS_ERR(crc->thr)) {
-		crc->thr = NULL;
-		pr_err("Cannot start CRC32 thread\n");
-		ret = -ENOMEM;
-		goto out_clean;
-	}
 
 	/*
 	 * Adjust the number of required free pages after all allocations have
@@ -765,7 +775,7 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	 */
 	handle->reqd_free_pages = reqd_free_pages();
 
-	pr_info("Using %u thread(s) for compression\n", nr_threads);
+	pr_info("Using %u thread(s) for %s compression\n", nr_threads, algo);
 	pr_info("Compressing and saving image data (%u pages)...\n",
 		nr_to_write);
 	m = nr_to_write / 10;
@@ -774,8 +784,9 @@ static int save_image_lzo(struct swap_map_handle *handle,
 	nr_pages = 0;
 	start = ktime_get();
 	for (;;) {
+		t = ktime_get();
 		for (thr = 0; thr < nr_threads; thr++) {
-			for (off = 0; off < LZO_UNC_SIZE; off += PAGE_SIZE) {
+			for (off = 0; off < UNC_SIZE; off += PAGE_SIZE) {
 				ret = snapshot_read_next(snapshot);
 				if (ret < 0)
 					goto out_finish;
@@ -799,34 +810,38 @@ static int save_image_lzo(struct swap_map_handle *handle,
 			atomic_set_release(&data[thr].ready, 1);
 			wake_up(&data[thr].go);
 		}
+		copy_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 
 		if (!thr)
 			break;
 
-		crc->run_threads = thr;
-		atomic_set_release(&crc->ready, 1);
-		wake_up(&crc->go);
-
 		for (run_threads = thr, thr = 0; thr < run_threads; thr++) {
+			t = ktime_get();
 			wait_event(data[thr].done,
 				atomic_read_acquire(&data[thr].stop));
 			atomic_set(&data[thr].stop, 0);
+			cmp_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 
 			ret = data[thr].ret;
 
 			if (ret < 0) {
-				pr_err("LZO compression failed\n");
+				pr_err("%s compression failed\n", algo);
 				goto out_finish;
 			}
 
 			if (unlikely(!data[thr].cmp_len ||
 			             data[thr].cmp_len >
-			             lzo1x_worst_compress(data[thr].unc_len))) {
-				pr_err("Invalid LZO compressed length\n");
+			             bytes_worst_compress(data[thr].unc_len))) {
+				pr_err("Invalid %s compressed length\n", algo);
 				ret = -1;
 				goto out_finish;
 			}
 
+			/* Same value as a single crc32_le() over the image. */
+			handle->crc32 = crc32_le_combine(handle->crc32,
+			                                 data[thr].crc32,
+			                                 data[thr].unc_len);
+
 			*(size_t *)data[thr].cmp = data[thr].cmp_len;
 
 			/*
@@ -837,8 +852,9 @@ static int save_image_lzo(struct swap_map_handle *handle,
 			 * any garbage at the end will be discarded when we
 			 * read it.
 			 */
+			t = ktime_get();
 			for (off = 0;
-			     off < LZO_HEADER + data[thr].cmp_len;
+			     off < CMP_HEADER + data[thr].cmp_len;
 			     off += PAGE_SIZE) {
 				memcpy(page, data[thr].cmp + off, PAGE_SIZE);
 
@@ -846,31 +862,32 @@ static int save_image_lzo(struct swap_map_handle *handle,
 				if (ret)
 					goto out_finish;
 			}
+			io_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 		}
-
-		wait_event(crc->done, atomic_read_acquire(&crc->stop));
-		atomic_set(&crc->stop, 0);
 	}
 
 out_finish:
+	t = ktime_get();
 	err2 = hib_wait_io(&hb);
 	stop = ktime_get();
+	io_ns += ktime_to_ns(ktime_sub(stop, t));
 	if (!ret)
 		ret = err2;
 	if (!ret)
 		pr_info("Image saving done\n");
 	swsusp_show_speed(start, stop, nr_to_write, "Wrote");
+	pr_info("Image saving time: snapshot copy %lld ms, compression wait %lld ms, I/O %lld ms\n",
+		copy_ns / NSEC_PER_MSEC, cmp_ns / NSEC_PER_MSEC,
+		io_ns / NSEC_PER_MSEC);
 out_clean:
 	hib_finish_batch(&hb);
-	if (crc) {
-		if (crc->thr)
-			kthread_stop(crc->thr);
-		kfree(crc);
-	}
 	if (data) {
-		for (thr = 0; thr < nr_threads; thr++)
+		for (thr = 0; thr < nr_threads; thr++) {
 			if (data[thr].thr)
 				kthread_stop(data[thr].thr);
+			if (data[thr].cc)
+				crypto_free_comp(data[thr].cc);
+		}
 		vfree(data);
 	}
 	if (page) free_page((unsigned long)page);
@@ -940,7 +957,8 @@ int swsusp_write(unsigned int flags)
 	if (!error) {
 		error = (flags & SF_NOCOMPRESS_MODE) ?
 			save_image(&handle, &snapshot, pages - 1) :
-			save_image_lzo(&handle, &snapshot, pages - 1);
+			save_compressed_image(&handle, &snapshot, pages - 1,
+					      hib_comp_name(flags));
 	}
 out_finish:
 	error = swap_writer_finish(&handle, flags, error);
@@ -1107,10 +1125,11 @@ static int load_image(struct swap_map_handle *handle,
 }
 
 /*
- * Structure used for LZO data decompression.
+ * Structure used for data decompression.
  */
 struct dec_data {
 	struct task_struct *thr;                  /* thread */
+	struct crypto_comp *cc;                   /* crypto compressor */
 	atomic_t ready;                           /* ready to start flag */
 	atomic_t stop;                            /* ready to stop flag */
 	int ret;                                  /* return code */
@@ -1118,16 +1137,18 @@ struct dec_data {
 	wait_queue_head_t done;                   /* decompression done */
 	size_t unc_len;                           /* uncompressed length */
 	size_t cmp_len;                           /* compressed length */
-	unsigned char unc[LZO_UNC_SIZE];          /* uncompressed buffer */
-	unsigned char cmp[LZO_CMP_SIZE];          /* compressed buffer */
+	u32 crc32;                                /* CRC32 of unc, seed 0 */
+	unsigned char unc[UNC_SIZE];              /* uncompressed buffer */
+	unsigned char cmp[CMP_SIZE];              /* compressed buffer */
 };
 
 /*
  * Decompression function that runs in its own thread.
  */
-static int lzo_decompress_threadfn(void *data)
+static int decompress_threadfn(void *data)
 {
 	struct dec_data *d = data;
+	unsigned int unc_len;
 
 	while (1) {
 		wait_event(d->go, atomic_read_acquire(&d->ready) ||
@@ -1141,9 +1162,12 @@ static int lzo_decompress_threadfn(void *data)
 		}
 		atomic_set(&d->ready, 0);
 
-		d->unc_len = LZO_UNC_SIZE;
-		d->ret = lzo1x_decompress_safe(d->cmp + LZO_HEADER, d->cmp_len,
-		                               d->unc, &d->unc_len);
+		unc_len = UNC_SIZE;
+		d->ret = crypto_comp_decompress(d->cc, d->cmp + CMP_HEADER,
+		                                d->cmp_len, d->unc, &unc_len);
+		d->unc_len = unc_len;
+		if (!d->ret)
+			d->crc32 = crc32_le(0, d->unc, d->unc_len);
 		if (clean_pages_on_decompress)
 			flush_icache_range((unsigned long)d->unc,
 					   (unsigned long)d->unc + d->unc_len);
@@ -1155,14 +1179,16 @@ static int lzo_decompress_threadfn(void *data)
 }
 
 /**
- * load_image_lzo - Load compressed image data and decompress them with LZO.
+ * load_compressed_image - Load compressed image data and decompress it.
  * @handle: Swap map handle to use for loading data.
  * @snapshot: Image to copy uncompressed data into.
  * @nr_to_read: Number of pages to load.
+ * @algo: Crypto name of the compressor the image was saved with.
  */
-static int load_image_lzo(struct swap_map_handle *handle,
-                          struct snapshot_handle *snapshot,
-                          unsigned int nr_to_read)
+static int load_compressed_image(struct swap_map_handle *handle,
+                                 struct snapshot_handle *snapshot,
+                                 unsigned int nr_to_read,
+                                 const char *algo)
 {
 	unsigned int m;
 	int ret = 0;
@@ -1170,6 +1196,8 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	struct hib_bio_batch hb;
 	ktime_t start;
 	ktime_t stop;
+	ktime_t t;
+	s64 io_ns = 0, dec_ns = 0, copy_ns = 0;
 	unsigned nr_pages;
 	size_t off;
 	unsigned i, thr, run_threads, nr_threads;
@@ -1178,34 +1206,21 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	unsigned long read_pages = 0;
 	unsigned char **page = NULL;
 	struct dec_data *data = NULL;
-	struct crc_data *crc = NULL;
 
 	hib_init_batch(&hb);
 
-	/*
-	 * We'll limit the number of threads for decompression to limit memory
-	 * footprint.
-	 */
-	nr_threads = num_online_cpus() - 1;
-	nr_threads = clamp_val(nr_threads, 1, LZO_THREADS);
+	nr_threads = hib_nr_threads();
 
-	page = vmalloc(array_size(LZO_MAX_RD_PAGES, sizeof(*page)));
+	page = vmalloc(array_size(CMP_MAX_RD_PAGES, sizeof(*page)));
 	if (!page) {
-		pr_err("Failed to allocate LZO page\n");
+		pr_err("Failed to allocate %s page\n", algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
 
 	data = vzalloc(array_size(nr_threads, sizeof(*data)));
 	if (!data) {
-		pr_err("Failed to allocate LZO data\n");
-		ret = -ENOMEM;
-		goto out_clean;
-	}
-
-	crc = kzalloc(sizeof(*crc), GFP_KERNEL);
-	if (!crc) {
-		pr_err("Failed to allocate crc\n");
+		pr_err("Failed to allocate %s data\n", algo);
 		ret = -ENOMEM;
 		goto out_clean;
 	}
@@ -1219,7 +1234,15 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		init_waitqueue_head(&data[thr].go);
 		init_waitqueue_head(&data[thr].done);
 
-		data[thr].thr = kthread_run(lzo_decompress_threadfn,
+		data[thr].cc = crypto_alloc_comp(algo, 0, 0);
+		if (IS_ERR(data[thr].cc)) {
+			pr_err("Could not allocate %s decompressor\n", algo);
+			ret = PTR_ERR(data[thr].cc);
+			data[thr].cc = NULL;
+			goto out_clean;
+		}
+
+		data[thr].thr = kthread_run(decompress_threadfn,
 		                            &data[thr],
 		                            "image_decompress/%u", thr);
 		if (IS_ERR(data[thr].thr)) {
@@ -1230,26 +1253,7 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		}
 	}
 
-	/*
-	 * Start the CRC32 thread.
-	 */
-	init_waitqueue_head(&crc->go);
-	init_waitqueue_head(&crc->done);
-
 	handle->crc32 = 0;
-	crc->crc32 = &handle->crc32;
-	for (thr = 0; thr < nr_threads; thr++) {
-		crc->unc[thr] = data[thr].unc;
-		crc->unc_len[thr] = &data[thr].unc_len;
-	}
-
-	crc->thr = kthread_run(crc32_threadfn, crc, "image_crc32");
-	if (IS_ERR(crc->thr)) {
-		crc->thr = NULL;
-		pr_err("Cannot start CRC32 thread\n");
-		ret = -ENOMEM;
-		goto out_clean;
-	}
 
 	/*
 	 * Set the number of pages for read buffering.
@@ -1260,18 +1264,18 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	 */
 	if (low_free_pages() > snapshot_get_image_size())
 		read_pages = (low_free_pages() - snapshot_get_image_size()) / 2;
-	read_pages = clamp_val(read_pages, LZO_MIN_RD_PAGES, LZO_MAX_RD_PAGES);
+	read_pages = clamp_val(read_pages, CMP_MIN_RD_PAGES, CMP_MAX_RD_PAGES);
 
 	for (i = 0; i < read_pages; i++) {
-		page[i] = (void *)__get_free_page(i < LZO_CMP_PAGES ?
+		page[i] = (void *)__get_free_page(i < CMP_PAGES ?
 						  GFP_NOIO | __GFP_HIGH :
 						  GFP_NOIO | __GFP_NOWARN |
 						  __GFP_NORETRY);
 
 		if (!page[i]) {
-			if (i < LZO_CMP_PAGES) {
+			if (i < CMP_PAGES) {
 				ring_size = i;
-				pr_err("Failed to allocate LZO pages\n");
+				pr_err("Failed to allocate %s pages\n", algo);
 				ret = -ENOMEM;
 				goto out_clean;
 			} else {
@@ -1281,7 +1285,7 @@ static int load_image_lzo(struct swap_map_handle *handle,
 	}
 	want = ring_size = i;
 
-	pr_info("Using %u thread(s) for decompression\n", nr_threads);
+	pr_info("Using %u thread(s) for %s decompression\n", nr_threads, algo);
 	pr_info("Loading and decompressing image data (%u pages)...\n",
 		nr_to_read);
 	m = nr_to_read / 10;
@@ -1323,7 +1327,9 @@ static int load_image_lzo(struct swap_map_handle *handle,
 			if (!asked)
 				break;
 
+			t = ktime_get();
 			ret = hib_wait_io(&hb);
+			io_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 			if (ret)
 				goto out_finish;
 			have += asked;
@@ -1332,23 +1338,17 @@ static int load_image_lzo(struct swap_map_handle *handle,
 				eof = 2;
 		}
 
-		if (crc->run_threads) {
-			wait_event(crc->done, atomic_read_acquire(&crc->stop));
-			atomic_set(&crc->stop, 0);
-			crc->run_threads = 0;
-		}
-
 		for (thr = 0; have && thr < nr_threads; thr++) {
 			data[thr].cmp_len = *(size_t *)page[pg];
 			if (unlikely(!data[thr].cmp_len ||
 			             data[thr].cmp_len >
-			             lzo1x_worst_compress(LZO_UNC_SIZE))) {
-				pr_err("Invalid LZO compressed length\n");
+			             bytes_worst_compress(UNC_SIZE))) {
+				pr_err("Invalid %s compressed length\n", algo);
 				ret = -1;
 				goto out_finish;
 			}
 
-			need = DIV_ROUND_UP(data[thr].cmp_len + LZO_HEADER,
+			need = DIV_ROUND_UP(data[thr].cmp_len + CMP_HEADER,
 			                    PAGE_SIZE);
 			if (need > have) {
 				if (eof > 1) {
@@ -1359,7 +1359,7 @@ static int load_image_lzo(struct swap_map_handle *handle,
 			}
 
 			for (off = 0;
-			     off < LZO_HEADER + data[thr].cmp_len;
+			     off < CMP_HEADER + data[thr].cmp_len;
 			     off += PAGE_SIZE) {
 				memcpy(data[thr].cmp + off,
 				       page[pg], PAGE_SIZE);
@@ -1376,8 +1376,10 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		/*
 		 * Wait for more data while we are decompressing.
 		 */
-		if (have < LZO_CMP_PAGES && asked) {
+		if (have < CMP_PAGES && asked) {
+			t = ktime_get();
 			ret = hib_wait_io(&hb);
+			io_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 			if (ret)
 				goto out_finish;
 			have += asked;
@@ -1387,25 +1389,33 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		}
 
 		for (run_threads = thr, thr = 0; thr < run_threads; thr++) {
+			t = ktime_get();
 			wait_event(data[thr].done,
 				atomic_read_acquire(&data[thr].stop));
 			atomic_set(&data[thr].stop, 0);
+			dec_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 
 			ret = data[thr].ret;
 
 			if (ret < 0) {
-				pr_err("LZO decompression failed\n");
+				pr_err("%s decompression failed\n", algo);
 				goto out_finish;
 			}
 
 			if (unlikely(!data[thr].unc_len ||
-			             data[thr].unc_len > LZO_UNC_SIZE ||
+			             data[thr].unc_len > UNC_SIZE ||
 			             data[thr].unc_len & (PAGE_SIZE - 1))) {
-				pr_err("Invalid LZO uncompressed length\n");
+				pr_err("Invalid %s uncompressed length\n", algo);
 				ret = -1;
 				goto out_finish;
 			}
 
+			/* Same value as a single crc32_le() over the image. */
+			handle->crc32 = crc32_le_combine(handle->crc32,
+			                                 data[thr].crc32,
+			                                 data[thr].unc_len);
+
+			t = ktime_get();
 			for (off = 0;
 			     off < data[thr].unc_len; off += PAGE_SIZE) {
 				memcpy(data_of(*snapshot),
@@ -1418,24 +1428,15 @@ static int load_image_lzo(struct swap_map_handle *handle,
 
 				ret = snapshot_write_next(snapshot);
 				if (ret <= 0) {
-					crc->run_threads = thr + 1;
-					atomic_set_release(&crc->ready, 1);
-					wake_up(&crc->go);
+					copy_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 					goto out_finish;
 				}
 			}
+			copy_ns += ktime_to_ns(ktime_sub(ktime_get(), t));
 		}
-
-		crc->run_threads = thr;
-		atomic_set_release(&crc->ready, 1);
-		wake_up(&crc->go);
 	}
 
 out_finish:
-	if (crc->run_threads) {
-		wait_event(crc->done, atomic_read_acquire(&crc->stop));
-		atomic_set(&crc->stop, 0);
-	}
 	stop = ktime_get();
 	if (!ret) {
 		pr_info("Image loading done\n");
@@ -1452,19 +1453,20 @@ static int load_image_lzo(struct swap_map_handle *handle,
 		}
 	}
 	swsusp_show_speed(start, stop, nr_to_read, "Read");
+	pr_info("Image loading time: I/O wait %lld ms, decompression wait %lld ms, snapshot copy %lld ms\n",
+		io_ns / NSEC_PER_MSEC, dec_ns / NSEC_PER_MSEC,
+		copy_ns / NSEC_PER_MSEC);
 out_clean:
 	hib_finish_batch(&hb);
 	for (i = 0; i < ring_size; i++)
 		free_page((unsigned long)page[i]);
-	if (crc) {
-		if (crc->thr)
-			kthread_stop(crc->thr);
-		kfree(crc);
-	}
 	if (data) {
-		for (thr = 0; thr < nr_threads; thr++)
+		for (thr = 0; thr < nr_threads; thr++) {
 			if (data[thr].thr)
 				kthread_stop(data[thr].thr);
+			if (data[thr].cc)
+				crypto_free_comp(data[thr].cc);
+		}
 		vfree(data);
 	}
 	vfree(page);
@@ -1498,7 +1500,9 @@ int swsusp_read(unsigned int *flags_p)
 	if (!error) {
 		error = (*flags_p & SF_NOCOMPRESS_MODE) ?
 			load_image(&handle, &snapshot, header->pages - 1) :
-			load_image_lzo(&handle, &snapshot, header->pages - 1);
+			load_compressed_image(&handle, &snapshot,
+					      header->pages - 1,
+					      hib_comp_name(*flags_p));
 	}
 	swap_reader_finish(&handle);
 end:
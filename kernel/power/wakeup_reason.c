@@ -27,6 +27,44 @@
 #include <linux/notifier.h>
 #include <linux/suspend.h>
 #include <linux/slab.h>
+#include <linux/sched/clock.h>
+
+#define SUSPEND_PHASE_CYCLES	8
+#define SUSPEND_PHASE_TOP_DEVS	3
+
+static const char * const suspend_phase_names[SUSPEND_PHASE_NR] = {
+	[SUSPEND_PHASE_FREEZE]		= "freeze",
+	[SUSPEND_PHASE_DEVICES]		= "suspend",
+	[SUSPEND_PHASE_LATE]		= "suspend_late",
+	[SUSPEND_PHASE_NOIRQ]		= "suspend_noirq",
+	[SUSPEND_PHASE_SYSCORE]		= "syscore_suspend",
+	[RESUME_PHASE_SYSCORE]		= "syscore_resume",
+	[RESUME_PHASE_NOIRQ]		= "resume_noirq",
+	[RESUME_PHASE_EARLY]		= "resume_early",
+	[RESUME_PHASE_DEVICES]		= "resume",
+	[RESUME_PHASE_THAW]		= "thaw",
+};
+
+struct suspend_phase_dev {
+	char name[40];
+	u64 ns;
+};
+
+/*
+ * struct suspend_phase_cycle - timings of one suspend/resume cycle
+ * @seq       - cycle number, 0 if the slot is unused
+ * @phase_ns  - time spent in each phase
+ * @top       - slowest device callbacks of each phase, slowest first
+ */
+struct suspend_phase_cycle {
+	unsigned int seq;
+	u64 phase_ns[SUSPEND_PHASE_NR];
+	struct suspend_phase_dev top[SUSPEND_PHASE_NR][SUSPEND_PHASE_TOP_DEVS];
+};
+
+static DEFINE_SPINLOCK(suspend_phase_lock);
+static struct suspend_phase_cycle suspend_phase_cycles[SUSPEND_PHASE_CYCLES];
+static unsigned int suspend_phase_seq;
 
 /*
  * struct wakeup_irq_node - stores data and relationships for IRQs logged as
@@ -148,6 +186,95 @@ static struct wakeup_irq_node *find_node_in_list(struct list_head *head,
 	return NULL;
 }
 
+static struct suspend_phase_cycle *current_phase_cycle(void)
+{
+	return &suspend_phase_cycles[suspend_phase_seq % SUSPEND_PHASE_CYCLES];
+}
+
+static void start_suspend_phase_cycle(void)
+{
+	struct suspend_phase_cycle *cycle;
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_phase_lock, flags);
+	suspend_phase_seq++;
+	cycle = current_phase_cycle();
+	memset(cycle, 0, sizeof(*cycle));
+	cycle->seq = suspend_phase_seq;
+	spin_unlock_irqrestore(&suspend_phase_lock, flags);
+}
+
+/* Sum up the entry and exit latencies of the last cycle into suspend_stats. */
+static void finish_suspend_phase_cycle(void)
+{
+	struct suspend_phase_cycle *cycle;
+	u64 entry = 0, exit = 0;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&suspend_phase_lock, flags);
+	cycle = current_phase_cycle();
+	for (i = 0; i < SUSPEND_PHASE_NR; i++) {
+		if (i <= SUSPEND_PHASE_SYSCORE)
+			entry += cycle->phase_ns[i];
+		else
+			exit += cycle->phase_ns[i];
+	}
+	spin_unlock_irqrestore(&suspend_phase_lock, flags);
+
+	suspend_stats.last_suspend_entry_us = div_u64(entry, NSEC_PER_USEC);
+	suspend_stats.last_resume_exit_us = div_u64(exit, NSEC_PER_USEC);
+}
+
+/**
+ * log_suspend_phase_time - account a suspend/resume phase to the current cycle
+ * @phase: the phase that just ended
+ * @start_ns: local_clock() when it started
+ *
+ * local_clock() is used because ktime_get() may not be called once
+ * timekeeping is suspended. It is not a suspend-aware clock either: the
+ * generic sched_clock is itself frozen by a syscore op, so the syscore
+ * phases only account the callbacks that run while it is still ticking.
+ */
+void log_suspend_phase_time(enum suspend_phase phase, u64 start_ns)
+{
+	u64 now = local_clock();
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_phase_lock, flags);
+	current_phase_cycle()->phase_ns[phase] += now - start_ns;
+	spin_unlock_irqrestore(&suspend_phase_lock, flags);
+}
+
+/**
+ * log_suspend_phase_dev_time - record a device callback duration
+ * @phase: the phase the callback ran in
+ * @name: device name
+ * @ns: how long the callback took
+ *
+ * Only the slowest SUSPEND_PHASE_TOP_DEVS callbacks of each phase are kept.
+ */
+void log_suspend_phase_dev_time(enum suspend_phase phase, const char *name,
+				u64 ns)
+{
+	struct suspend_phase_dev *top;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&suspend_phase_lock, flags);
+	top = current_phase_cycle()->top[phase];
+	for (i = 0; i < SUSPEND_PHASE_TOP_DEVS; i++)
+		if (ns > top[i].ns)
+			break;
+	if (i < SUSPEND_PHASE_TOP_DEVS) {
+		memmove(&top[i + 1], &top[i],
+			(SUSPEND_PHASE_TOP_DEVS - i - 1) * sizeof(*top));
+		strscpy(top[i].name, name, sizeof(top[i].name));
+		top[i].ns = ns;
+	}
+	spin_unlock_irqrestore(&suspend_phase_lock, flags);
+}
+
 void log_irq_wakeup_reason(int irq)
 {
 	unsigned long flags;
@@ -358,12 +485,63 @@ static ssize_t last_suspend_time_show(struct kobject *kobj,
 		       sleep_time.tv_nsec);
 }
 
+/*
+ * Lists the phase timings of the last SUSPEND_PHASE_CYCLES cycles, newest
+ * first, in microseconds, each phase followed by its slowest devices. Older
+ * cycles that do not fit in the page are left out rather than cut short.
+ */
+static ssize_t suspend_phase_times_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct suspend_phase_cycle *cycle;
+	unsigned long flags;
+	ssize_t len = 0, prev;
+	int c, i, j;
+
+	spin_lock_irqsave(&suspend_phase_lock, flags);
+	for (c = 0; c < SUSPEND_PHASE_CYCLES; c++) {
+		cycle = &suspend_phase_cycles[(suspend_phase_seq - c) %
+					      SUSPEND_PHASE_CYCLES];
+		if (!cycle->seq)
+			break;
+
+		prev = len;
+		len += scnprintf(buf + len, PAGE_SIZE - len, "cycle %u\n",
+				 cycle->seq);
+		for (i = 0; i < SUSPEND_PHASE_NR; i++) {
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%s %llu",
+					 suspend_phase_names[i],
+					 div_u64(cycle->phase_ns[i],
+						 NSEC_PER_USEC));
+			for (j = 0; j < SUSPEND_PHASE_TOP_DEVS; j++) {
+				struct suspend_phase_dev *d = &cycle->top[i][j];
+
+				if (!d->ns)
+					break;
+				len += scnprintf(buf + len, PAGE_SIZE - len,
+						 " %s:%llu", d->name,
+						 div_u64(d->ns, NSEC_PER_USEC));
+			}
+			len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+		}
+		if (len >= PAGE_SIZE - 1) {
+			len = prev;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&suspend_phase_lock, flags);
+
+	return len;
+}
+
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
 static struct kobj_attribute suspend_time = __ATTR_RO(last_suspend_time);
+static struct kobj_attribute phase_times = __ATTR_RO(suspend_phase_times);
 
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
 	&suspend_time.attr,
+	&phase_times.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -381,6 +559,7 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		/* monotonic time since boot including the time spent in suspend */
 		last_stime = ktime_get_boottime();
 		clear_wakeup_reasons();
+		start_suspend_phase_cycle();
 		break;
 	case PM_POST_SUSPEND:
 		/* monotonic time since boot */
@@ -388,6 +567,11 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		/* monotonic time since boot including the time spent in suspend */
 		curr_stime = ktime_get_boottime();
 		print_wakeup_sources();
+		finish_suspend_phase_cycle();
+		break;
+	case PM_HIBERNATION_PREPARE:
+		/* Keep the hibernation phases out of the last suspend cycle */
+		start_suspend_phase_cycle();
 		break;
 	default:
 		break;
@@ -2713,6 +2713,12 @@ __call_rcu_common(struct rcu_head *head, rcu_callback_t func, bool lazy_in)
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(&rcu_data);
 	lazy = lazy_in && !rcu_async_should_hurry();
+	if (IS_ENABLED(CONFIG_RCU_LAZY) && rcu_rdp_is_offloaded(rdp)) {
+		if (lazy)
+			rdp->lazy_batched++;
+		else
+			rdp->lazy_hurried++;
+	}
 
 	/* Add the callback to our list. */
 	if (unlikely(!rcu_segcblist_is_enabled(&rdp->cblist))) {
@@ -283,6 +283,8 @@ struct rcu_data {
 					    /* the first RCU stall timeout */
 
 	long lazy_len;			/* Length of buffered lazy callbacks. */
+	unsigned long lazy_batched;	/* Callbacks queued lazily. */
+	unsigned long lazy_hurried;	/* Callbacks queued non-lazily. */
 	int cpu;
 };
 
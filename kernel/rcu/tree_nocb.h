@@ -267,6 +267,43 @@ static bool wake_nocb_gp(struct rcu_data *rdp, bool force)
 static unsigned long jiffies_till_flush = LAZY_FLUSH_JIFFIES;
 
 #ifdef CONFIG_RCU_LAZY
+/*
+ * The flush interval adapts to the state of the device: while the screen is
+ * off it is stretched to jiffies_till_idle_flush, so that deep idle is not
+ * broken up by grace periods, and for LAZY_PRESSURE_JIFFIES after the lazy
+ * shrinker ran it shrinks to jiffies_till_pressure_flush, so that memory
+ * waiting on lazy callbacks comes back quickly.
+ */
+#define LAZY_IDLE_FLUSH_JIFFIES		(60 * HZ)
+#define LAZY_PRESSURE_FLUSH_JIFFIES	HZ
+#define LAZY_PRESSURE_JIFFIES		(5 * HZ)
+static unsigned long jiffies_till_idle_flush = LAZY_IDLE_FLUSH_JIFFIES;
+static unsigned long jiffies_till_pressure_flush = LAZY_PRESSURE_FLUSH_JIFFIES;
+static unsigned long lazy_pressure_until;
+static bool lazy_screen_off;
+static atomic_long_t lazy_pressure_flushed;
+
+static unsigned long rcu_lazy_flush_jiffies(void)
+{
+	if (time_before(jiffies, READ_ONCE(lazy_pressure_until)))
+		return READ_ONCE(jiffies_till_pressure_flush);
+	if (READ_ONCE(lazy_screen_off))
+		return READ_ONCE(jiffies_till_idle_flush);
+	return READ_ONCE(jiffies_till_flush);
+}
+
+/**
+ * rcu_lazy_set_screen_off - tell lazy RCU whether the device is screen-off
+ * @screen_off: true when the screen went off, false when it came back on
+ *
+ * Lazy callbacks are flushed less often while the screen is off.
+ */
+void rcu_lazy_set_screen_off(bool screen_off)
+{
+	WRITE_ONCE(lazy_screen_off, screen_off);
+}
+EXPORT_SYMBOL_GPL(rcu_lazy_set_screen_off);
+
 // To be called only from test code.
 void rcu_lazy_set_jiffies_till_flush(unsigned long jif)
 {
@@ -279,6 +316,11 @@ unsigned long rcu_lazy_get_jiffies_till_flush(void)
 	return jiffies_till_flush;
 }
 EXPORT_SYMBOL(rcu_lazy_get_jiffies_till_flush);
+#else
+static unsigned long rcu_lazy_flush_jiffies(void)
+{
+	return jiffies_till_flush;
+}
 #endif
 
 /*
@@ -299,7 +341,7 @@ static void wake_nocb_gp_defer(struct rcu_data *rdp, int waketype,
 	 */
 	if (waketype == RCU_NOCB_WAKE_LAZY &&
 	    rdp->nocb_defer_wakeup == RCU_NOCB_WAKE_NOT) {
-		mod_timer(&rdp_gp->nocb_timer, jiffies + jiffies_till_flush);
+		mod_timer(&rdp_gp->nocb_timer, jiffies + rcu_lazy_flush_jiffies());
 		WRITE_ONCE(rdp_gp->nocb_defer_wakeup, waketype);
 	} else if (waketype == RCU_NOCB_WAKE_BYPASS) {
 		mod_timer(&rdp_gp->nocb_timer, jiffies + 2);
@@ -482,7 +524,7 @@ static bool rcu_nocb_try_bypass(struct rcu_data *rdp, struct rcu_head *rhp,
 	// flush ->nocb_bypass to ->cblist.
 	if ((ncbs && !bypass_is_lazy && j != READ_ONCE(rdp->nocb_bypass_first)) ||
 	    (ncbs &&  bypass_is_lazy &&
-	     (time_after(j, READ_ONCE(rdp->nocb_bypass_first) + jiffies_till_flush))) ||
+	     (time_after(j, READ_ONCE(rdp->nocb_bypass_first) + rcu_lazy_flush_jiffies()))) ||
 	    ncbs >= qhimark) {
 		rcu_nocb_lock(rdp);
 		*was_alldone = !rcu_segcblist_pend_cbs(&rdp->cblist);
@@ -723,7 +765,7 @@ static void nocb_gp_wait(struct rcu_data *my_rdp)
 		lazy_ncbs = READ_ONCE(rdp->lazy_len);
 
 		if (bypass_ncbs && (lazy_ncbs == bypass_ncbs) &&
-		    (time_after(j, READ_ONCE(rdp->nocb_bypass_first) + jiffies_till_flush) ||
+		    (time_after(j, READ_ONCE(rdp->nocb_bypass_first) + rcu_lazy_flush_jiffies()) ||
 		     bypass_ncbs > 2 * qhimark)) {
 			flush_bypass = true;
 		} else if (bypass_ncbs && (lazy_ncbs != bypass_ncbs) &&
@@ -1347,6 +1389,10 @@ lazy_rcu_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 
 	if (WARN_ON_ONCE(!cpumask_available(rcu_nocb_mask)))
 		return 0;
+
+	/* Keep flushing early for a while, the pressure is unlikely to be over */
+	WRITE_ONCE(lazy_pressure_until, jiffies + LAZY_PRESSURE_JIFFIES);
+
 	/*
 	 * Protect against concurrent (de-)offloading. Otherwise nocb locking
 	 * may be ignored or imbalanced.
@@ -1394,6 +1440,8 @@ lazy_rcu_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 
 	mutex_unlock(&rcu_state.barrier_mutex);
 
+	atomic_long_add(count, &lazy_pressure_flushed);
+
 	return count ? count : SHRINK_STOP;
 }
 
@@ -1403,6 +1451,106 @@ static struct shrinker lazy_rcu_shrinker = {
 	.batch = 0,
 	.seeks = DEFAULT_SEEKS,
 };
+
+/*
+ * /sys/kernel/rcu_lazy: the flush intervals in milliseconds, the screen-off
+ * hint for user space power management, and callback statistics.
+ */
+#define RCU_LAZY_MS_ATTR(_name, _var)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sysfs_emit(buf, "%u\n", jiffies_to_msecs(READ_ONCE(_var)));	\
+}									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+			     struct kobj_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	unsigned int ms;						\
+									\
+	if (kstrtouint(buf, 0, &ms) || !ms)				\
+		return -EINVAL;						\
+	WRITE_ONCE(_var, msecs_to_jiffies(ms));				\
+	return count;							\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RW(_name)
+
+RCU_LAZY_MS_ATTR(flush_ms, jiffies_till_flush);
+RCU_LAZY_MS_ATTR(idle_flush_ms, jiffies_till_idle_flush);
+RCU_LAZY_MS_ATTR(pressure_flush_ms, jiffies_till_pressure_flush);
+
+static ssize_t screen_off_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%d\n", READ_ONCE(lazy_screen_off));
+}
+
+static ssize_t screen_off_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	bool screen_off;
+
+	if (kstrtobool(buf, &screen_off))
+		return -EINVAL;
+	rcu_lazy_set_screen_off(screen_off);
+	return count;
+}
+static struct kobj_attribute screen_off_attr = __ATTR_RW(screen_off);
+
+static ssize_t stats_show(struct kobject *kobj, struct kobj_attribute *attr,
+			  char *buf)
+{
+	unsigned long batched = 0, hurried = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
+
+		batched += READ_ONCE(rdp->lazy_batched);
+		hurried += READ_ONCE(rdp->lazy_hurried);
+	}
+
+	return sysfs_emit(buf,
+			  "batched %lu\nhurried %lu\npressure_flushed %lu\nflush_ms %u\n",
+			  batched, hurried,
+			  atomic_long_read(&lazy_pressure_flushed),
+			  jiffies_to_msecs(rcu_lazy_flush_jiffies()));
+}
+static struct kobj_attribute stats_attr = __ATTR_RO(stats);
+
+static struct attribute *rcu_lazy_attrs[] = {
+	&flush_ms_attr.attr,
+	&idle_flush_ms_attr.attr,
+	&pressure_flush_ms_attr.attr,
+	&screen_off_attr.attr,
+	&stats_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group rcu_lazy_attr_group = {
+	.attrs = rcu_lazy_attrs,
+};
+
+static int __init rcu_lazy_sysfs_init(void)
+{
+	struct kobject *kobj;
+
+	if (!rcu_state.nocb_is_setup)
+		return 0;
+
+	kobj = kobject_create_and_add("rcu_lazy", kernel_kobj);
+	if (!kobj)
+		return -ENOMEM;
+
+	if (sysfs_create_group(kobj, &rcu_lazy_attr_group)) {
+		kobject_put(kobj);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+late_initcall(rcu_lazy_sysfs_init);
 #endif // #ifdef CONFIG_RCU_LAZY
 
 void __init rcu_init_nohz(void)
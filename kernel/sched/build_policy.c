@@ -15,6 +15,7 @@
 /* Headers: */
 #include <linux/sched/clock.h>
 #include <linux/sched/cputime.h>
+#include <linux/sched/hmbird.h>
 #include <linux/sched/hotplug.h>
 #include <linux/sched/posix-timers.h>
 #include <linux/sched/rt.h>
@@ -23,6 +24,7 @@
 #include <linux/jiffies.h>
 #include <linux/livepatch.h>
 #include <linux/psi.h>
+#include <linux/rhashtable.h>
 #include <linux/seqlock_api.h>
 #include <linux/slab.h>
 #include <linux/suspend.h>
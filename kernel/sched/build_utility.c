@@ -32,6 +32,7 @@
 #include <linux/mempolicy.h>
 #include <linux/nmi.h>
 #include <linux/nospec.h>
+#include <linux/oom.h>
 #include <linux/proc_fs.h>
 #include <linux/psi.h>
 #include <linux/psi.h>
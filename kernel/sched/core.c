@@ -10651,6 +10651,7 @@ static void sched_free_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+	free_percpu(tg->timer_slack_raised);
 	kmem_cache_free(task_group_cache, tg);
 }
 
@@ -10685,7 +10686,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+	tg->timer_slack_raised = alloc_percpu(unsigned long);
+	if (!tg->timer_slack_raised)
+		goto err;
+
 	alloc_uclamp_sched_group(tg, parent);
+	tg->timer_slack_eff = READ_ONCE(parent->timer_slack_eff);
 
 	return tg;
 
@@ -10823,6 +10829,87 @@ static inline struct task_group *css_tg(struct cgroup_subsys_state *css)
 	return css ? container_of(css, struct task_group, css) : NULL;
 }
 
+/*
+ * Timer slack of the current task's hrtimers and poll timeouts: the task's
+ * own timer_slack_ns, raised to the cpu.timer_slack_ns floor of its cgroup
+ * so that the timers of background groups get coalesced. Callers still
+ * give no slack to realtime tasks.
+ */
+u64 current_timer_slack_ns(void)
+{
+	u64 slack = current->timer_slack_ns;
+	struct task_group *tg;
+	u64 floor;
+
+	rcu_read_lock();
+	tg = task_group(current);
+	floor = READ_ONCE(tg->timer_slack_eff);
+	/* The root group has no floor, so no counter either */
+	if (floor > slack) {
+		slack = floor;
+		this_cpu_inc(*tg->timer_slack_raised);
+	}
+	rcu_read_unlock();
+
+	return slack;
+}
+
+/* Serializes updates of timer_slack_eff down the hierarchy */
+static DEFINE_MUTEX(timer_slack_mutex);
+
+static void cpu_timer_slack_update_eff(struct cgroup_subsys_state *css)
+{
+	struct cgroup_subsys_state *pos;
+	struct task_group *tg;
+	u64 eff;
+
+	lockdep_assert_held(&timer_slack_mutex);
+
+	rcu_read_lock();
+	css_for_each_descendant_pre(pos, css) {
+		tg = css_tg(pos);
+		eff = tg->timer_slack_ns;
+		if (pos->parent)
+			eff = max(eff, css_tg(pos->parent)->timer_slack_eff);
+		WRITE_ONCE(tg->timer_slack_eff, eff);
+	}
+	rcu_read_unlock();
+}
+
+static u64 cpu_timer_slack_read_u64(struct cgroup_subsys_state *css,
+				    struct cftype *cft)
+{
+	return css_tg(css)->timer_slack_ns;
+}
+
+static int cpu_timer_slack_write_u64(struct cgroup_subsys_state *css,
+				     struct cftype *cft, u64 slack)
+{
+	if (slack > NSEC_PER_SEC)
+		return -EINVAL;
+
+	mutex_lock(&timer_slack_mutex);
+	css_tg(css)->timer_slack_ns = slack;
+	cpu_timer_slack_update_eff(css);
+	mutex_unlock(&timer_slack_mutex);
+
+	return 0;
+}
+
+static int cpu_timer_slack_stat_show(struct seq_file *sf, void *v)
+{
+	struct task_group *tg = css_tg(seq_css(sf));
+	unsigned long raised = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		raised += *per_cpu_ptr(tg->timer_slack_raised, cpu);
+
+	seq_printf(sf, "effective_ns %llu\n", READ_ONCE(tg->timer_slack_eff));
+	seq_printf(sf, "raised %lu\n", raised);
+	return 0;
+}
+
 static struct cgroup_subsys_state *
 cpu_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 {
@@ -10862,6 +10949,10 @@ static int cpu_cgroup_css_online(struct cgroup_subsys_state *css)
 	mutex_unlock(&uclamp_mutex);
 #endif
 
+	mutex_lock(&timer_slack_mutex);
+	cpu_timer_slack_update_eff(css);
+	mutex_unlock(&timer_slack_mutex);
+
 	trace_android_rvh_cpu_cgroup_online(css);
 	return 0;
 }
@@ -11588,6 +11679,18 @@ static struct cftype cpu_legacy_files[] = {
 	},
 #endif
 
+	{
+		.name = "timer_slack_ns",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_timer_slack_read_u64,
+		.write_u64 = cpu_timer_slack_write_u64,
+	},
+	{
+		.name = "timer_slack_stat",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_timer_slack_stat_show,
+	},
+
 	{ }	/* Terminate */
 };
 
@@ -11811,6 +11914,17 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_uclamp_ls_write_u64,
 	},
 #endif
+	{
+		.name = "timer_slack_ns",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = cpu_timer_slack_read_u64,
+		.write_u64 = cpu_timer_slack_write_u64,
+	},
+	{
+		.name = "timer_slack_stat",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = cpu_timer_slack_stat_show,
+	},
 	{ }	/* terminate */
 };
 
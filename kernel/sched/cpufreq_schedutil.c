@@ -7,12 +7,17 @@
  */
 
 #include <trace/hooks/sched.h>
+#include <trace/events/sched_ext.h>
+#include <trace/events/power.h>
 
 #define IOWAIT_BOOST_MIN	(SCHED_CAPACITY_SCALE / 8)
+#define SUGOV_BOOST_MAX_MS	1000
 
 struct sugov_tunables {
 	struct gov_attr_set	attr_set;
-	unsigned int		rate_limit_us;
+	unsigned int		up_rate_limit_us;
+	unsigned int		down_rate_limit_us;
+	bool			shared_util_filter;
 };
 
 struct sugov_policy {
@@ -24,6 +29,8 @@ struct sugov_policy {
 	raw_spinlock_t		update_lock;
 	u64			last_freq_update_time;
 	s64			freq_update_delay_ns;
+	s64			up_rate_delay_ns;
+	s64			down_rate_delay_ns;
 	unsigned int		next_freq;
 	unsigned int		cached_raw_freq;
 
@@ -51,6 +58,9 @@ struct sugov_cpu {
 	unsigned long		util;
 	unsigned long		bw_dl;
 
+	/* Decayed utilization history, for shared policies only: */
+	unsigned long		util_decayed;
+
 	/* The field below is for single-CPU policies only: */
 #ifdef CONFIG_NO_HZ_COMMON
 	unsigned long		saved_idle_calls;
@@ -59,6 +69,15 @@ struct sugov_cpu {
 
 static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
 
+/* Outstanding boost requests, kept across governor restarts. */
+struct sugov_boost_slot {
+	unsigned long		util;
+	unsigned long		expires;
+};
+
+static DEFINE_PER_CPU(struct sugov_boost_slot [SUGOV_BOOST_NR_REASONS],
+		      sugov_boost_slots);
+
 /************************ Governor internals ***********************/
 
 static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
@@ -94,13 +113,42 @@ static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 	return delta_ns >= sg_policy->freq_update_delay_ns;
 }
 
+/*
+ * freq_update_delay_ns is the shorter of the two rate limits, so that
+ * sugov_should_update_freq() lets through every update that may be allowed;
+ * the direction specific limit is applied once the next frequency is known.
+ */
+static bool sugov_up_down_rate_limit(struct sugov_policy *sg_policy, u64 time,
+				     unsigned int next_freq)
+{
+	s64 delta_ns = time - sg_policy->last_freq_update_time;
+	s64 delay_ns;
+
+	if (next_freq > sg_policy->next_freq)
+		delay_ns = sg_policy->up_rate_delay_ns;
+	else
+		delay_ns = sg_policy->down_rate_delay_ns;
+
+	if (delta_ns >= delay_ns)
+		return false;
+
+	trace_sugov_rate_limit(sg_policy->policy->cpu, sg_policy->next_freq,
+			       next_freq, delta_ns, delay_ns);
+	return true;
+}
+
 static bool sugov_update_next_freq(struct sugov_policy *sg_policy, u64 time,
 				   unsigned int next_freq)
 {
-	if (sg_policy->need_freq_update)
+	if (sg_policy->need_freq_update) {
 		sg_policy->need_freq_update = cpufreq_driver_test_flags(CPUFREQ_NEED_UPDATE_LIMITS);
-	else if (sg_policy->next_freq == next_freq)
+	} else if (sg_policy->next_freq == next_freq) {
+		return false;
+	} else if (sugov_up_down_rate_limit(sg_policy, time, next_freq)) {
+		/* Reset cached freq as next_freq isn't changed */
+		sg_policy->cached_raw_freq = 0;
 		return false;
+	}
 
 	sg_policy->next_freq = next_freq;
 	sg_policy->last_freq_update_time = time;
@@ -161,14 +209,108 @@ static unsigned int get_next_freq(struct sugov_policy *sg_policy,
 	return cpufreq_driver_resolve_freq(policy, freq);
 }
 
+/*
+ * Raise @util to the highest boost floor still in effect on @cpu. The slots
+ * are written locklessly by sugov_boost_request(); a torn read can only
+ * apply or miss a boost for one update.
+ */
+static unsigned long sugov_boost_util(int cpu, unsigned long util)
+{
+	struct sugov_boost_slot *slots = per_cpu(sugov_boost_slots, cpu);
+	int reason;
+
+	for (reason = 0; reason < SUGOV_BOOST_NR_REASONS; reason++) {
+		unsigned long expires = smp_load_acquire(&slots[reason].expires);
+		unsigned long boost;
+
+		if (!time_before(jiffies, expires))
+			continue;
+
+		boost = READ_ONCE(slots[reason].util);
+		if (boost > util) {
+			trace_sugov_boost_apply(reason, cpu, util, boost);
+			util = boost;
+		}
+	}
+
+	return util;
+}
+
+/**
+ * sugov_boost_request - Raise the frequency floor of a CPU for a while.
+ * @boost: requester, identifying it in traces and selecting the boost slot.
+ * @cpu: target CPU.
+ * @util: utilization floor, in capacity units; 0 cancels the boost.
+ * @duration_ms: how long the floor holds, capped at SUGOV_BOOST_MAX_MS.
+ *
+ * The floor is applied to the utilization schedutil computes for @cpu on its
+ * next frequency evaluation, without touching uclamp of any task. Requests
+ * for the same reason and CPU are merged, keeping the highest floor and the
+ * latest expiry.
+ */
+int sugov_boost_request(const struct sugov_boost *boost, int cpu,
+			unsigned long util, unsigned int duration_ms)
+{
+	struct sugov_boost_slot *slot;
+	unsigned long expires, now = jiffies;
+
+	if (boost->reason >= SUGOV_BOOST_NR_REASONS || !cpu_possible(cpu))
+		return -EINVAL;
+
+	util = min_t(unsigned long, util, arch_scale_cpu_capacity(cpu));
+	duration_ms = min_t(unsigned int, duration_ms, SUGOV_BOOST_MAX_MS);
+	trace_sugov_boost_request(boost->name, boost->reason, cpu, util,
+				  duration_ms);
+
+	slot = &per_cpu(sugov_boost_slots, cpu)[boost->reason];
+	if (!util || !duration_ms) {
+		smp_store_release(&slot->expires, now);
+		return 0;
+	}
+
+	expires = now + msecs_to_jiffies(duration_ms);
+	if (time_before(now, READ_ONCE(slot->expires))) {
+		util = max(util, READ_ONCE(slot->util));
+		if (time_before(expires, READ_ONCE(slot->expires)))
+			expires = READ_ONCE(slot->expires);
+	}
+
+	WRITE_ONCE(slot->util, util);
+	/* pairs with smp_load_acquire() in sugov_boost_util() */
+	smp_store_release(&slot->expires, expires);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sugov_boost_request);
+
 static void sugov_get_util(struct sugov_cpu *sg_cpu)
 {
 	unsigned long util = cpu_util_cfs_boost(sg_cpu->cpu);
 	struct rq *rq = cpu_rq(sg_cpu->cpu);
 
+	/*
+	 * ext tasks aren't tracked by PELT, use their windowed busy time. If
+	 * only some tasks are on ext, CFS may still be the bigger consumer.
+	 * The heaviest runnable task's demand is a floor so that a heavy
+	 * thread which just arrived gets its frequency before the CPU's
+	 * windows catch up. While handing over between the two, follow
+	 * whichever is higher so that neither side's cold start dips the
+	 * frequency.
+	 */
+	if (scx_gov_util_enabled() || scx_gov_in_handover()) {
+		unsigned long scx_util = max(scx_cpu_util(sg_cpu->cpu),
+					     scx_cpu_top_util(sg_cpu->cpu));
+
+		if (scx_switched_all() && !scx_gov_in_handover())
+			util = scx_util;
+		else
+			util = max(util, scx_util);
+		trace_sched_ext_gov_util(sg_cpu->cpu, scx_util, util);
+	}
+
 	sg_cpu->bw_dl = cpu_bw_dl(rq);
 	sg_cpu->util = effective_cpu_util(sg_cpu->cpu, util,
 					  FREQUENCY_UTIL, NULL);
+	sg_cpu->util = sugov_boost_util(sg_cpu->cpu, sg_cpu->util);
 }
 
 /**
@@ -421,11 +563,67 @@ static void sugov_update_single_perf(struct update_util_data *hook, u64 time,
 	sg_cpu->sg_policy->last_freq_update_time = time;
 }
 
+#ifdef CONFIG_ENERGY_MODEL
+/* Cost coefficient of the performance state that would serve @util. */
+static unsigned long sugov_em_cost(struct em_perf_domain *pd, unsigned long util)
+{
+	struct em_perf_table *em_table = rcu_dereference(pd->em_table);
+	int i;
+
+	i = em_pd_get_efficient_state(em_table->state, pd->nr_perf_states,
+				      map_util_perf(util), pd->flags,
+				      pd->min_ps, pd->max_ps);
+	return em_table->state[i].cost;
+}
+#else
+static inline unsigned long sugov_em_cost(struct em_perf_domain *pd,
+					  unsigned long util)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Filtered aggregation for shared policies. A lone CPU whose utilization
+ * jumped well above its own decayed history is taken to be ramping briefly,
+ * and the policy follows the second busiest CPU, or the spiking CPU's
+ * history, instead. The spike is only ignored if following it would land on
+ * a noticeably costlier performance state according to the Energy Model;
+ * otherwise there's nothing to save by lagging behind it.
+ */
+static unsigned long sugov_filter_shared_util(struct sugov_policy *sg_policy,
+					      struct sugov_cpu *top,
+					      unsigned long util,
+					      unsigned long second)
+{
+	unsigned long floor = max(second, top->util_decayed);
+	unsigned long cost_hi = 0, cost_lo = 0;
+	struct em_perf_domain *pd;
+
+	if (util <= floor + (floor >> 2))
+		return util;
+
+	rcu_read_lock();
+	pd = em_cpu_get(sg_policy->policy->cpu);
+	if (pd) {
+		cost_hi = sugov_em_cost(pd, util);
+		cost_lo = sugov_em_cost(pd, floor);
+	}
+	rcu_read_unlock();
+
+	if (pd && cost_hi <= cost_lo + (cost_lo >> 3))
+		return util;
+
+	return floor;
+}
+
 static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
 {
 	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
 	struct cpufreq_policy *policy = sg_policy->policy;
-	unsigned long util = 0, max_cap;
+	bool filter = READ_ONCE(sg_policy->tunables->shared_util_filter);
+	unsigned long util = 0, second = 0, max_cap;
+	struct sugov_cpu *top = NULL;
 	unsigned int j;
 
 	max_cap = arch_scale_cpu_capacity(sg_cpu->cpu);
@@ -436,7 +634,28 @@ static unsigned int sugov_next_freq_shared(struct sugov_cpu *sg_cpu, u64 time)
 		sugov_get_util(j_sg_cpu);
 		sugov_iowait_apply(j_sg_cpu, time, max_cap);
 
-		util = max(j_sg_cpu->util, util);
+		if (j_sg_cpu->util > util) {
+			second = util;
+			util = j_sg_cpu->util;
+			top = j_sg_cpu;
+		} else {
+			second = max(j_sg_cpu->util, second);
+		}
+	}
+
+	if (filter && top) {
+		unsigned long raw = util;
+
+		util = sugov_filter_shared_util(sg_policy, top, util, second);
+
+		/* Update the history only after it has been used above. */
+		for_each_cpu(j, policy->cpus) {
+			struct sugov_cpu *j_sg_cpu = &per_cpu(sugov_cpu, j);
+			unsigned long j_util = j_sg_cpu == top ? raw : j_sg_cpu->util;
+
+			j_sg_cpu->util_decayed = (3 * j_sg_cpu->util_decayed +
+						  j_util) >> 2;
+		}
 	}
 
 	return get_next_freq(sg_policy, util, max_cap);
@@ -516,15 +735,41 @@ static inline struct sugov_tunables *to_sugov_tunables(struct gov_attr_set *attr
 	return container_of(attr_set, struct sugov_tunables, attr_set);
 }
 
+static void sugov_update_rate_limits(struct sugov_policy *sg_policy)
+{
+	struct sugov_tunables *tunables = sg_policy->tunables;
+
+	sg_policy->up_rate_delay_ns = tunables->up_rate_limit_us * NSEC_PER_USEC;
+	sg_policy->down_rate_delay_ns = tunables->down_rate_limit_us * NSEC_PER_USEC;
+	sg_policy->freq_update_delay_ns = min(sg_policy->up_rate_delay_ns,
+					      sg_policy->down_rate_delay_ns);
+}
+
 static ssize_t rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
 {
 	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
 
-	return sprintf(buf, "%u\n", tunables->rate_limit_us);
+	return sprintf(buf, "%u\n", min(tunables->up_rate_limit_us,
+					tunables->down_rate_limit_us));
 }
 
-static ssize_t
-rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+static ssize_t up_rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->up_rate_limit_us);
+}
+
+static ssize_t down_rate_limit_us_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->down_rate_limit_us);
+}
+
+static ssize_t sugov_rate_limit_store(struct gov_attr_set *attr_set,
+				      const char *buf, size_t count,
+				      bool up, bool down)
 {
 	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
 	struct sugov_policy *sg_policy;
@@ -533,18 +778,67 @@ rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count
 	if (kstrtouint(buf, 10, &rate_limit_us))
 		return -EINVAL;
 
-	tunables->rate_limit_us = rate_limit_us;
+	if (up)
+		tunables->up_rate_limit_us = rate_limit_us;
+	if (down)
+		tunables->down_rate_limit_us = rate_limit_us;
 
 	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook)
-		sg_policy->freq_update_delay_ns = rate_limit_us * NSEC_PER_USEC;
+		sugov_update_rate_limits(sg_policy);
+
+	return count;
+}
+
+/* The legacy knob sets both directions at once. */
+static ssize_t
+rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	return sugov_rate_limit_store(attr_set, buf, count, true, true);
+}
+
+static ssize_t
+up_rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	return sugov_rate_limit_store(attr_set, buf, count, true, false);
+}
+
+static ssize_t
+down_rate_limit_us_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	return sugov_rate_limit_store(attr_set, buf, count, false, true);
+}
+
+static ssize_t shared_util_filter_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->shared_util_filter);
+}
+
+static ssize_t
+shared_util_filter_store(struct gov_attr_set *attr_set, const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	bool enable;
+
+	if (kstrtobool(buf, &enable))
+		return -EINVAL;
+
+	WRITE_ONCE(tunables->shared_util_filter, enable);
 
 	return count;
 }
 
 static struct governor_attr rate_limit_us = __ATTR_RW(rate_limit_us);
+static struct governor_attr up_rate_limit_us = __ATTR_RW(up_rate_limit_us);
+static struct governor_attr down_rate_limit_us = __ATTR_RW(down_rate_limit_us);
+static struct governor_attr shared_util_filter = __ATTR_RW(shared_util_filter);
 
 static struct attribute *sugov_attrs[] = {
 	&rate_limit_us.attr,
+	&up_rate_limit_us.attr,
+	&down_rate_limit_us.attr,
+	&shared_util_filter.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(sugov);
@@ -708,7 +1002,8 @@ static int sugov_init(struct cpufreq_policy *policy)
 		goto stop_kthread;
 	}
 
-	tunables->rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->up_rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->down_rate_limit_us = tunables->up_rate_limit_us;
 
 	policy->governor_data = sg_policy;
 	sg_policy->tunables = tunables;
@@ -768,7 +1063,7 @@ static int sugov_start(struct cpufreq_policy *policy)
 	void (*uu)(struct update_util_data *data, u64 time, unsigned int flags);
 	unsigned int cpu;
 
-	sg_policy->freq_update_delay_ns	= sg_policy->tunables->rate_limit_us * NSEC_PER_USEC;
+	sugov_update_rate_limits(sg_policy);
 	sg_policy->last_freq_update_time	= 0;
 	sg_policy->next_freq			= 0;
 	sg_policy->work_in_progress		= false;
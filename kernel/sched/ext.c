@@ -6,6 +6,9 @@
  * Copyright (c) 2022 Tejun Heo <tj@kernel.org>
  * Copyright (c) 2022 David Vernet <dvernet@meta.com>
  */
+#define CREATE_TRACE_POINTS
+#include <trace/events/sched_ext.h>
+
 #define SCX_OP_IDX(op)		(offsetof(struct sched_ext_ops, op) / sizeof(void (*)(void)))
 
 enum scx_internal_consts {
@@ -149,8 +152,56 @@ static DEFINE_PER_CPU(struct task_struct *, direct_dispatch_task);
 /* dispatch queues */
 static struct scx_dispatch_q __cacheline_aligned_in_smp scx_dsq_global;
 
+static const struct rhashtable_params dsq_hash_params = {
+	.key_len		= 8,
+	.key_offset		= offsetof(struct scx_dispatch_q, id),
+	.head_offset		= offsetof(struct scx_dispatch_q, hash_node),
+};
+
+static struct rhashtable dsq_hash;
 static LLIST_HEAD(dsqs_to_free);
 
+/*
+ * CPUs grouped by arch_scale_cpu_capacity() in ascending capacity order. On
+ * asymmetric systems, each group matches a physical cluster. Rebuilt whenever
+ * the BPF scheduler is enabled, see scx_build_clusters().
+ *
+ * Each cluster has a built-in DSQ, %SCX_DSQ_CLUSTER | cluster index, which is
+ * the default destination for tasks enqueued on the cluster's CPUs. A CPU
+ * consumes its own cluster DSQ first and steals from the others only after
+ * the global DSQ turns out empty. See consume_builtin_dsqs().
+ */
+#define SCX_MAX_CLUSTERS	8
+
+struct scx_cluster {
+	struct scx_dispatch_q	dsq;
+	cpumask_var_t		cpus;
+	cpumask_var_t		idle;	/* idle_masks.cpu & cpus, also racy */
+	unsigned long		capacity;
+};
+
+static struct scx_cluster scx_clusters[SCX_MAX_CLUSTERS];
+static int scx_nr_clusters;
+static DEFINE_PER_CPU_READ_MOSTLY(int, scx_cpu_cluster);
+
+/* clusters and CPUs isolated by the isolation controller, see scx_iso_update() */
+static unsigned long scx_isolated_clusters;
+static struct cpumask scx_isolated_cpus;
+
+static void scx_iso_set(int cid, bool isolate);
+static void scx_iso_update(struct rq *rq);
+
+static bool scx_cpu_isolated(int cpu)
+{
+	return cpumask_test_cpu(cpu, &scx_isolated_cpus);
+}
+
+/* rescue tasks whose affinity allows only isolated CPUs */
+static bool task_needs_iso_rescue(const struct task_struct *p)
+{
+	return cpumask_subset(p->cpus_ptr, &scx_isolated_cpus);
+}
+
 /* dispatch buf */
 struct scx_dsp_buf_ent {
 	struct task_struct	*task;
@@ -167,19 +218,35 @@ struct scx_dsp_ctx {
 	struct rq_flags		*rf;
 	u32			buf_cursor;
 	u32			nr_tasks;
+	u32			batch;		/* see scx_dsp_adapt_batch() */
 };
 
 static DEFINE_PER_CPU(struct scx_dsp_ctx, scx_dsp_ctx);
 
+struct scx_dsp_stat {
+	u64	rounds;		/* ops.dispatch() calls from balance_one() */
+	u64	batch_full;	/* rounds which used up the batch */
+	u64	loops_exhausted; /* balance_one() hitting SCX_DSP_MAX_LOOPS */
+};
+
+static DEFINE_PER_CPU(struct scx_dsp_stat, scx_dsp_stat);
+
 void scx_bpf_dispatch(struct task_struct *p, u64 dsq_id, u64 slice,
 		      u64 enq_flags);
 void scx_bpf_kick_cpu(s32 cpu, u64 flags);
 
+/*
+ * scx_task_iter drops scx_tasks_lock every SCX_TASK_ITER_BATCH visits so that
+ * switching a large number of tasks doesn't keep IRQs disabled for long.
+ */
+#define SCX_TASK_ITER_BATCH	32
+
 struct scx_task_iter {
 	struct sched_ext_entity		cursor;
 	struct task_struct		*locked;
 	struct rq			*rq;
 	struct rq_flags			rf;
+	u32				cnt;
 };
 
 #define SCX_HAS_OP(op)	static_branch_likely(&scx_has_op[SCX_OP_IDX(op)])
@@ -284,7 +351,7 @@ do {										\
 	__ret;									\
 })
 
-//#include "./slim_walt.c"
+#include "slim_walt.c"
 
 /* @mask is constant, always inline to cull unnecessary branches */
 static __always_inline bool scx_kf_allowed(u32 mask)
@@ -361,6 +428,7 @@ static void scx_task_iter_init(struct scx_task_iter *iter)
 	iter->cursor = (struct sched_ext_entity){ .flags = SCX_TASK_CURSOR };
 	list_add(&iter->cursor.tasks_node, &scx_tasks);
 	iter->locked = NULL;
+	iter->cnt = 0;
 }
 
 /**
@@ -392,7 +460,9 @@ static void scx_task_iter_exit(struct scx_task_iter *iter)
  * scx_task_iter_next - Next task
  * @iter: iterator to walk
  *
- * Visit the next task. See scx_task_iter_init() for details.
+ * Visit the next task. See scx_task_iter_init() for details. Every
+ * %SCX_TASK_ITER_BATCH visits, scx_tasks_lock is released and re-acquired to
+ * let IRQs and, if allowed, other tasks in. The cursor keeps our position.
  */
 static struct task_struct *scx_task_iter_next(struct scx_task_iter *iter)
 {
@@ -401,6 +471,15 @@ static struct task_struct *scx_task_iter_next(struct scx_task_iter *iter)
 
 	lockdep_assert_held(&scx_tasks_lock);
 
+	if (!(++iter->cnt % SCX_TASK_ITER_BATCH)) {
+		/* the _locked variant has already dropped the rq lock */
+		WARN_ON_ONCE(iter->locked);
+		spin_unlock_irq(&scx_tasks_lock);
+		if (preemptible())
+			cond_resched();
+		spin_lock_irq(&scx_tasks_lock);
+	}
+
 	list_for_each_entry(pos, cursor, tasks_node) {
 		if (&pos->tasks_node == &scx_tasks)
 			return NULL;
@@ -597,6 +676,266 @@ static void update_curr_scx(struct rq *rq)
 	}
 }
 
+#ifdef CONFIG_SCHED_HRTICK
+/*
+ * Slices shorter than a tick would otherwise overrun by up to a tick. With
+ * highres_tick_ctrl set, arm the rq's hrtick for the remaining slice. The
+ * hrtick calls task_tick_scx() with @queued set, which then expires the
+ * slice. The counters are kept when highres_tick_ctrl_dbg is set and shown
+ * in /proc/hmbird_sched/hmbird_stats.
+ */
+struct scx_hrtick_stat {
+	u64	armed;
+	u64	fired;
+	u64	early;		/* task stopped running before the hrtick */
+};
+
+static DEFINE_PER_CPU(struct scx_hrtick_stat, scx_hrtick_stat);
+
+#define scx_hrtick_stat_inc(rq, field)					\
+do {									\
+	if (unlikely(READ_ONCE(highres_tick_ctrl_dbg)))			\
+		per_cpu_ptr(&scx_hrtick_stat, cpu_of(rq))->field++;	\
+} while (0)
+
+static void scx_hrtick_start(struct rq *rq, struct task_struct *p)
+{
+	u64 slice = p->scx->slice;
+
+	if (!READ_ONCE(highres_tick_ctrl) || !hrtick_enabled(rq) ||
+	    slice == SCX_SLICE_INF || !slice || slice >= TICK_NSEC)
+		return;
+
+	hrtick_start(rq, slice);
+	rq->scx->flags |= SCX_RQ_HRTICK_ARMED;
+	scx_hrtick_stat_inc(rq, armed);
+}
+
+static void scx_hrtick_fired(struct rq *rq)
+{
+	rq->scx->flags &= ~SCX_RQ_HRTICK_ARMED;
+	scx_hrtick_stat_inc(rq, fired);
+}
+
+static void scx_hrtick_cancel(struct rq *rq)
+{
+	if (!(rq->scx->flags & SCX_RQ_HRTICK_ARMED))
+		return;
+
+	rq->scx->flags &= ~SCX_RQ_HRTICK_ARMED;
+	if (hrtimer_try_to_cancel(&rq->hrtick_timer) == 1)
+		scx_hrtick_stat_inc(rq, early);
+}
+
+static void scx_show_hrtick_stat(struct seq_file *m)
+{
+	u64 armed = 0, fired = 0, early = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct scx_hrtick_stat *stat = per_cpu_ptr(&scx_hrtick_stat, cpu);
+
+		armed += READ_ONCE(stat->armed);
+		fired += READ_ONCE(stat->fired);
+		early += READ_ONCE(stat->early);
+	}
+
+	seq_printf(m, "hrtick armed=%llu fired=%llu early=%llu\n",
+		   armed, fired, early);
+}
+#else	/* CONFIG_SCHED_HRTICK */
+static void scx_hrtick_start(struct rq *rq, struct task_struct *p) {}
+static void scx_hrtick_fired(struct rq *rq) {}
+static void scx_hrtick_cancel(struct rq *rq) {}
+static void scx_show_hrtick_stat(struct seq_file *m) {}
+#endif	/* CONFIG_SCHED_HRTICK */
+
+#define SCX_NR_DL_LEVELS	(SCHED_PROP_DEADLINE_LEVEL9 + 1)
+
+/*
+ * UX tasks are the ones with a user-aware deadline level and the ones marked
+ * DSQ_SYNC_STATIC_UX. When one wakes another task, e.g. a binder caller its
+ * server or a futex waker its waiter, the wakee inherits the mark and the
+ * waker's deadline level for ux_inherit_ms. A wakee woken by an inheriting
+ * task takes over the waker's expiry rather than a fresh one so that a chain
+ * can't keep itself boosted forever.
+ */
+static bool task_static_ux(const struct task_struct *p)
+{
+	unsigned long level = p->sched_prop & SCHED_PROP_DEADLINE_MASK;
+
+	return (p->scx->dsq_sync_ux & DSQ_SYNC_STATIC_UX) ||
+		(level >= SCHED_PROP_DEADLINE_LEVEL1 &&
+		 level <= SCHED_PROP_DEADLINE_LEVEL5);
+}
+
+static bool task_inherited_ux(const struct task_struct *p)
+{
+	u8 ux = READ_ONCE(p->scx->dsq_sync_ux);
+
+	return (ux & DSQ_SYNC_BINDER_UX) ||
+		((ux & DSQ_SYNC_INHERIT_UX) &&
+		 time_before(jiffies, READ_ONCE(p->scx->ux_expires)));
+}
+
+static bool task_is_ux(const struct task_struct *p)
+{
+	return task_static_ux(p) || task_inherited_ux(p);
+}
+
+static int task_deadline_level(const struct task_struct *p)
+{
+	int level = min_t(int, p->sched_prop & SCHED_PROP_DEADLINE_MASK,
+			  SCHED_PROP_DEADLINE_LEVEL9);
+
+	if (task_inherited_ux(p) &&
+	    (level == SCHED_PROP_DEADLINE_LEVEL0 || p->scx->ux_dl_level < level))
+		level = p->scx->ux_dl_level;
+
+	return level;
+}
+
+/* called on ttwu of @p by current with @p->pi_lock held */
+static void scx_ux_inherit(struct task_struct *p, int wake_flags)
+{
+	struct task_struct *waker = current;
+	unsigned int ms = READ_ONCE(ux_inherit_ms);
+	unsigned long expires;
+
+	if (!ms || !(wake_flags & SCX_WAKE_TTWU) || !in_task() ||
+	    !waker->scx || waker == p)
+		return;
+
+	if (task_static_ux(waker) ||
+	    (READ_ONCE(waker->scx->dsq_sync_ux) & DSQ_SYNC_BINDER_UX))
+		expires = jiffies + msecs_to_jiffies(ms);
+	else if (task_inherited_ux(waker))
+		expires = READ_ONCE(waker->scx->ux_expires);
+	else
+		return;
+
+	if (task_static_ux(p) ||
+	    (READ_ONCE(p->scx->dsq_sync_ux) & DSQ_SYNC_BINDER_UX) ||
+	    (task_inherited_ux(p) && !time_after(expires, p->scx->ux_expires)))
+		return;
+
+	p->scx->ux_dl_level = task_deadline_level(waker);
+	p->scx->critical_affinity_cpu = waker->scx->critical_affinity_cpu;
+	WRITE_ONCE(p->scx->ux_expires, expires);
+	WRITE_ONCE(p->scx->dsq_sync_ux,
+		   p->scx->dsq_sync_ux | DSQ_SYNC_INHERIT_UX);
+}
+
+/*
+ * ext tasks aren't tracked by PELT, so sched_cpu_util() misses them. For
+ * users outside the scheduler that want to know how busy a CPU is, this is
+ * their windowed busy time while an ext scheduler is loaded, 0 otherwise.
+ */
+unsigned long scx_cpu_ext_util(int cpu)
+{
+	return scx_enabled() ? scx_cpu_util(cpu) : 0;
+}
+
+/*
+ * Synchronous IPC, i.e. binder, hands the caller's UX mark and deadline level
+ * to the server thread for as long as it works on the call instead of for
+ * ux_inherit_ms. The caller's properties are captured when the call is sent,
+ * applied when a server thread takes it and restored on reply, nesting like
+ * the transaction stack does.
+ *
+ * @p may be another task, woken concurrently by scx_ux_inherit(), so the
+ * marks are updated under @p->pi_lock like scx_ux_inherit() does.
+ */
+void scx_sync_prop_capture(struct task_struct *p, struct scx_sync_prop *prop)
+{
+	prop->dsq_sync_ux = DSQ_SYNC_UX_NONE;
+	if (!p->scx || !task_is_ux(p))
+		return;
+
+	prop->dsq_sync_ux = DSQ_SYNC_BINDER_UX;
+	prop->ux_dl_level = task_deadline_level(p);
+	prop->critical_affinity_cpu = p->scx->critical_affinity_cpu;
+}
+
+void scx_sync_inherit_begin(struct task_struct *p,
+			    const struct scx_sync_prop *prop,
+			    struct scx_sync_prop *saved)
+{
+	unsigned long flags;
+
+	if (!p->scx)
+		return;
+
+	raw_spin_lock_irqsave(&p->pi_lock, flags);
+	saved->dsq_sync_ux = p->scx->dsq_sync_ux;
+	saved->ux_dl_level = p->scx->ux_dl_level;
+	saved->critical_affinity_cpu = p->scx->critical_affinity_cpu;
+
+	if (!(prop->dsq_sync_ux & DSQ_SYNC_BINDER_UX) || task_static_ux(p) ||
+	    (task_inherited_ux(p) && p->scx->ux_dl_level <= prop->ux_dl_level))
+		goto out;
+
+	p->scx->ux_dl_level = prop->ux_dl_level;
+	p->scx->critical_affinity_cpu = prop->critical_affinity_cpu;
+	WRITE_ONCE(p->scx->dsq_sync_ux,
+		   saved->dsq_sync_ux | DSQ_SYNC_BINDER_UX);
+out:
+	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+}
+
+/* @saved NULL drops the mark, e.g. when the thread goes back to its pool */
+void scx_sync_inherit_end(struct task_struct *p,
+			  const struct scx_sync_prop *saved)
+{
+	unsigned long flags;
+	u8 ux;
+
+	if (!p->scx || !(READ_ONCE(p->scx->dsq_sync_ux) & DSQ_SYNC_BINDER_UX))
+		return;
+
+	raw_spin_lock_irqsave(&p->pi_lock, flags);
+	ux = p->scx->dsq_sync_ux;
+	if (saved) {
+		p->scx->ux_dl_level = saved->ux_dl_level;
+		p->scx->critical_affinity_cpu = saved->critical_affinity_cpu;
+		if (saved->dsq_sync_ux & DSQ_SYNC_BINDER_UX)
+			goto out;
+	}
+	WRITE_ONCE(p->scx->dsq_sync_ux, ux & ~DSQ_SYNC_BINDER_UX);
+out:
+	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
+}
+
+/*
+ * With dl_priq_ctrl set, priority queues are ordered by SCHED_PROP_DEADLINE
+ * level first and dsq_vtime within a level, and the built-in enqueue path
+ * refills slices per level. Tight levels get short slices so that they don't
+ * delay each other, batch levels long ones for throughput.
+ */
+static const u64 scx_dl_level_slice[SCX_NR_DL_LEVELS] = {
+	2 * NSEC_PER_MSEC,	2 * NSEC_PER_MSEC,
+	3 * NSEC_PER_MSEC,	3 * NSEC_PER_MSEC,
+	4 * NSEC_PER_MSEC,	4 * NSEC_PER_MSEC,
+	8 * NSEC_PER_MSEC,	12 * NSEC_PER_MSEC,
+	16 * NSEC_PER_MSEC,	SCX_SLICE_DFL,
+};
+
+static bool scx_dl_priq_enabled(void)
+{
+	return READ_ONCE(dl_priq_ctrl);
+}
+
+static u64 scx_dfl_slice(const struct task_struct *p)
+{
+	if (scx_dl_priq_enabled())
+		return scx_dl_level_slice[task_deadline_level(p)];
+	return SCX_SLICE_DFL;
+}
+
+/*
+ * The level is snapshotted into ->dsq_dl_level when @p is queued so that
+ * changing sched_prop or dl_priq_ctrl never reorders an existing tree.
+ */
 static bool scx_dsq_priq_less(struct rb_node *node_a,
 			      const struct rb_node *node_b)
 {
@@ -605,9 +944,54 @@ static bool scx_dsq_priq_less(struct rb_node *node_a,
 	const struct sched_ext_entity *b =
 		container_of(node_b, struct sched_ext_entity, dsq_node.priq);
 
+	if (a->dsq_dl_level != b->dsq_dl_level)
+		return a->dsq_dl_level < b->dsq_dl_level;
+
 	return time_before64(a->dsq_vtime, b->dsq_vtime);
 }
 
+/*
+ * Plain FIFO enqueues on the built-in global and cluster DSQs, which are
+ * shared by many CPUs and never destroyed, skip @dsq->lock and push @p onto
+ * @dsq->staged instead. Whoever takes @dsq->lock next splices the staged
+ * tasks onto @dsq->fifo in enqueue order before looking at the DSQ.
+ *
+ * Staging requires @p's rq to be locked so that dispatch_dequeue() can't run
+ * between @p->scx->dsq being set and @p becoming visible on @dsq->staged.
+ * finish_dispatch() only holds the dispatching CPU's rq and passes
+ * %SCX_ENQ_NO_STAGE.
+ */
+static bool dsq_can_stage(struct scx_dispatch_q *dsq, u64 enq_flags)
+{
+	return (dsq->id & SCX_DSQ_FLAG_BUILTIN) && dsq->id != SCX_DSQ_LOCAL &&
+		!(enq_flags & (SCX_ENQ_HEAD | SCX_ENQ_PREEMPT |
+			       SCX_ENQ_DSQ_PRIQ | SCX_ENQ_NO_STAGE));
+}
+
+static void dsq_drain_staged(struct scx_dispatch_q *dsq)
+{
+	struct sched_ext_entity *entity, *tmp;
+	struct llist_node *node;
+
+	lockdep_assert_held(&dsq->lock);
+
+	node = llist_del_all(&dsq->staged);
+	if (!node)
+		return;
+
+	node = llist_reverse_order(node);
+	llist_for_each_entry_safe(entity, tmp, node, dsq_node.stage) {
+		list_add_tail(&entity->dsq_node.fifo, &dsq->fifo);
+		dsq->nr++;
+	}
+}
+
+static bool dsq_has_tasks(struct scx_dispatch_q *dsq)
+{
+	return !list_empty(&dsq->fifo) || rb_first_cached(&dsq->priq) ||
+		!llist_empty(&dsq->staged);
+}
+
 static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
 			     u64 enq_flags)
 {
@@ -617,6 +1001,16 @@ static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
 	WARN_ON_ONCE((p->scx->dsq_flags & SCX_TASK_DSQ_ON_PRIQ) ||
 		     !RB_EMPTY_NODE(&p->scx->dsq_node.priq));
 
+	if (dsq_can_stage(dsq, enq_flags)) {
+		p->scx->dsq = dsq;
+		trace_sched_ext_dsq_enqueue(p, dsq->id, enq_flags, true);
+		p->scx->lat_src = dsq_lat_src(dsq);
+		if (enq_flags & SCX_ENQ_CLEAR_OPSS)
+			atomic64_set_release(&p->scx->ops_state, SCX_OPSS_NONE);
+		llist_add(&p->scx->dsq_node.stage, &dsq->staged);
+		return;
+	}
+
 	if (!is_local) {
 		raw_spin_lock(&dsq->lock);
 		if (unlikely(dsq->id == SCX_DSQ_INVALID)) {
@@ -626,9 +1020,17 @@ static void dispatch_enqueue(struct scx_dispatch_q *dsq, struct task_struct *p,
 			dsq = &scx_dsq_global;
 			raw_spin_lock(&dsq->lock);
 		}
+		/* keep FIFO order against earlier staged enqueues */
+		dsq_drain_staged(dsq);
 	}
 
+	trace_sched_ext_dsq_enqueue(p, dsq->id, enq_flags, false);
+	if (!is_local)
+		p->scx->lat_src = dsq_lat_src(dsq);
+
 	if (enq_flags & SCX_ENQ_DSQ_PRIQ) {
+		p->scx->dsq_dl_level = scx_dl_priq_enabled() ?
+			task_deadline_level(p) : 0;
 		p->scx->dsq_flags |= SCX_TASK_DSQ_ON_PRIQ;
 		rb_add_cached(&p->scx->dsq_node.priq, &dsq->priq,
 			      scx_dsq_priq_less);
@@ -704,8 +1106,11 @@ static void dispatch_dequeue(struct scx_rq *scx_rq, struct task_struct *p)
 		return;
 	}
 
-	if (!is_local)
+	if (!is_local) {
 		raw_spin_lock(&dsq->lock);
+		/* @p may still be on @dsq->staged */
+		dsq_drain_staged(dsq);
+	}
 
 	/*
 	 * Now that we hold @dsq->lock, @p->holding_cpu and @p->scx->dsq_node
@@ -732,11 +1137,85 @@ static void dispatch_dequeue(struct scx_rq *scx_rq, struct task_struct *p)
 		raw_spin_unlock(&dsq->lock);
 }
 
+static struct scx_dispatch_q *find_user_dsq(u64 dsq_id)
+{
+	return rhashtable_lookup_fast(&dsq_hash, &dsq_id, dsq_hash_params);
+}
+
+static struct scx_dispatch_q *find_cluster_dsq(u64 dsq_id)
+{
+	u64 cid = dsq_id & SCX_DSQ_CLUSTER_MASK;
+
+	if ((dsq_id & ~SCX_DSQ_CLUSTER_MASK) != SCX_DSQ_CLUSTER ||
+	    cid >= scx_nr_clusters)
+		return NULL;
+
+	return &scx_clusters[cid].dsq;
+}
+
 static struct scx_dispatch_q *find_non_local_dsq(u64 dsq_id)
 {
 	lockdep_assert(rcu_read_lock_any_held());
 
-	return &scx_dsq_global;
+	if (dsq_id == SCX_DSQ_GLOBAL)
+		return &scx_dsq_global;
+	else if (dsq_id & SCX_DSQ_FLAG_BUILTIN)
+		return find_cluster_dsq(dsq_id);
+	else
+		return find_user_dsq(dsq_id);
+}
+
+/*
+ * @p fits @cid if its windowed demand stays below misfit_ds percent of the
+ * cluster's capacity. The biggest cluster always fits.
+ */
+static bool task_fits_cluster(struct task_struct *p, int cid)
+{
+	if (cid == scx_nr_clusters - 1)
+		return true;
+
+	return (u64)p->scx->sts.demand_scaled * 100 <
+		(u64)scx_clusters[cid].capacity * READ_ONCE(misfit_ds);
+}
+
+static bool task_fits_rq(struct task_struct *p, struct rq *rq)
+{
+	return task_fits_cluster(p, per_cpu(scx_cpu_cluster, cpu_of(rq)));
+}
+
+/*
+ * CFS and RT tasks, e.g. with partial_enable or RT audio, share the CPUs but
+ * aren't on any DSQ. As ext sits below fair, any of them runnable on a CPU
+ * delays the ext tasks there. Their PELT utilization tells how much of the
+ * CPU they have been taking recently.
+ */
+static unsigned int scx_rq_foreign_nr(struct rq *rq)
+{
+	return READ_ONCE(rq->rt.rt_nr_running) + READ_ONCE(rq->cfs.h_nr_running);
+}
+
+#ifdef CONFIG_SMP
+static unsigned long scx_rq_foreign_util(struct rq *rq)
+{
+	return cpu_util_cfs(cpu_of(rq)) + cpu_util_rt(rq);
+}
+#else
+static unsigned long scx_rq_foreign_util(struct rq *rq) { return 0; }
+#endif
+
+static bool scx_rq_contended(struct rq *rq)
+{
+	return scx_rq_foreign_nr(rq) ||
+		scx_rq_foreign_util(rq) * 2 > arch_scale_cpu_capacity(cpu_of(rq));
+}
+
+/* default non-local DSQ for tasks enqueued on @rq */
+static struct scx_dispatch_q *dfl_dsq_for_rq(struct rq *rq)
+{
+	if (unlikely(!scx_nr_clusters))
+		return &scx_dsq_global;
+
+	return &scx_clusters[per_cpu(scx_cpu_cluster, cpu_of(rq))].dsq;
 }
 
 static struct scx_dispatch_q *find_dsq_for_dispatch(struct rq *rq, u64 dsq_id,
@@ -842,7 +1321,8 @@ static void do_enqueue_task(struct rq *rq, struct task_struct *p, u64 enq_flags,
 		goto local;
 
 	if (!SCX_HAS_OP(enqueue)) {
-		if (enq_flags & SCX_ENQ_LOCAL)
+		/* UX tasks run where select_task_rq_scx() put them */
+		if ((enq_flags & SCX_ENQ_LOCAL) || task_is_ux(p))
 			goto local;
 		else
 			goto global;
@@ -876,15 +1356,136 @@ static void do_enqueue_task(struct rq *rq, struct task_struct *p, u64 enq_flags,
 	 * higher priority it becomes from scx_prio_less()'s POV.
 	 */
 	touch_core_sched(rq, p);
-	p->scx->slice = SCX_SLICE_DFL;
+	p->scx->slice = scx_dfl_slice(p);
 local_norefill:
 	dispatch_enqueue(&rq->scx->local_dsq, p, enq_flags);
 	return;
 
 global:
 	touch_core_sched(rq, p);	/* see the comment in local: */
-	p->scx->slice = SCX_SLICE_DFL;
-	dispatch_enqueue(&scx_dsq_global, p, enq_flags);
+	p->scx->slice = scx_dfl_slice(p);
+
+	/*
+	 * The built-in DSQs are FIFO. To keep tight deadline levels from
+	 * queueing behind batch work, order them by level and enqueue time
+	 * instead. The kernel picked the DSQ, so @p's vtime isn't the BPF
+	 * scheduler's here.
+	 */
+	if (scx_dl_priq_enabled() && !(enq_flags & SCX_ENQ_HEAD)) {
+		p->scx->dsq_vtime = rq_clock(rq);
+		enq_flags |= SCX_ENQ_DSQ_PRIQ;
+	}
+	dispatch_enqueue(dfl_dsq_for_rq(rq), p, enq_flags);
+}
+
+/*
+ * Wakeup-to-run latency histograms, recorded while slim_stats is set and
+ * shown in /proc/hmbird_sched/sched_latency. Each CPU's counters are updated
+ * under its rq lock. Bucket 0 counts latencies below 1us, bucket i those in
+ * [2^(i-1), 2^i) us and the last bucket everything above.
+ */
+enum scx_lat_src {
+	SCX_LAT_LOCAL,		/* dispatched straight to a local DSQ */
+	SCX_LAT_GLOBAL,
+	SCX_LAT_CLUSTER,
+	SCX_LAT_USER,
+	SCX_NR_LAT_SRCS,
+};
+
+#define SCX_LAT_NR_BUCKETS	16
+
+struct scx_lat_hist {
+	u32	src[SCX_NR_LAT_SRCS][SCX_LAT_NR_BUCKETS];
+	u32	dl[SCX_NR_DL_LEVELS][SCX_LAT_NR_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct scx_lat_hist, scx_lat_hist);
+
+static const char *scx_lat_src_names[SCX_NR_LAT_SRCS] = {
+	[SCX_LAT_LOCAL]		= "local",
+	[SCX_LAT_GLOBAL]	= "global",
+	[SCX_LAT_CLUSTER]	= "cluster",
+	[SCX_LAT_USER]		= "user",
+};
+
+static u8 dsq_lat_src(struct scx_dispatch_q *dsq)
+{
+	if (dsq->id == SCX_DSQ_GLOBAL)
+		return SCX_LAT_GLOBAL;
+	if (!(dsq->id & SCX_DSQ_FLAG_BUILTIN))
+		return SCX_LAT_USER;
+	if ((dsq->id & ~SCX_DSQ_CLUSTER_MASK) == SCX_DSQ_CLUSTER)
+		return SCX_LAT_CLUSTER;
+	return SCX_LAT_LOCAL;
+}
+
+static void scx_record_latency(struct rq *rq, struct task_struct *p)
+{
+	struct scx_lat_hist *hist = per_cpu_ptr(&scx_lat_hist, cpu_of(rq));
+	u64 now = rq_clock(rq);
+	int bucket;
+
+	if (!p->scx->runnable_at_ns || now < p->scx->runnable_at_ns)
+		return;
+
+	bucket = min_t(int, fls64(div_u64(now - p->scx->runnable_at_ns,
+					  NSEC_PER_USEC)),
+		       SCX_LAT_NR_BUCKETS - 1);
+	p->scx->runnable_at_ns = 0;
+
+	hist->src[p->scx->lat_src][bucket]++;
+	hist->dl[task_deadline_level(p)][bucket]++;
+}
+
+static void scx_show_latency_hist(struct seq_file *m)
+{
+	struct scx_lat_hist *sum;
+	int cpu, i, b;
+
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct scx_lat_hist *hist = per_cpu_ptr(&scx_lat_hist, cpu);
+
+		for (b = 0; b < SCX_LAT_NR_BUCKETS; b++) {
+			for (i = 0; i < SCX_NR_LAT_SRCS; i++)
+				sum->src[i][b] += READ_ONCE(hist->src[i][b]);
+			for (i = 0; i < SCX_NR_DL_LEVELS; i++)
+				sum->dl[i][b] += READ_ONCE(hist->dl[i][b]);
+		}
+	}
+
+	seq_printf(m, "%-8s", "us<");
+	for (b = 0; b < SCX_LAT_NR_BUCKETS - 1; b++)
+		seq_printf(m, " %8u", 1U << b);
+	seq_printf(m, " %8s\n", "inf");
+
+	for (i = 0; i < SCX_NR_LAT_SRCS; i++) {
+		seq_printf(m, "%-8s", scx_lat_src_names[i]);
+		for (b = 0; b < SCX_LAT_NR_BUCKETS; b++)
+			seq_printf(m, " %8u", sum->src[i][b]);
+		seq_putc(m, '\n');
+	}
+
+	for (i = 0; i < SCX_NR_DL_LEVELS; i++) {
+		seq_printf(m, "dl%-6d", i);
+		for (b = 0; b < SCX_LAT_NR_BUCKETS; b++)
+			seq_printf(m, " %8u", sum->dl[i][b]);
+		seq_putc(m, '\n');
+	}
+
+	kfree(sum);
+}
+
+static void scx_reset_latency_hist(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&scx_lat_hist, cpu), 0,
+		       sizeof(struct scx_lat_hist));
 }
 
 static bool watchdog_task_watched(const struct task_struct *p)
@@ -892,13 +1493,31 @@ static bool watchdog_task_watched(const struct task_struct *p)
 	return !list_empty(&p->scx->watchdog_node);
 }
 
+/*
+ * @rq->scx->watchdog_list is kept in runnable_at order so that the watchdog
+ * only needs to look at its head. A reset stamps the current jiffies and goes
+ * to the tail. Tasks re-queued without a reset, e.g. on migration, keep their
+ * older runnable_at and are inserted walking back from the tail.
+ */
 static void watchdog_watch_task(struct rq *rq, struct task_struct *p)
 {
+	struct list_head *list = &rq->scx->watchdog_list;
+	struct sched_ext_entity *pos;
+
 	lockdep_assert_rq_held(rq);
-	if (p->scx->flags & SCX_TASK_WATCHDOG_RESET)
+	if (p->scx->flags & SCX_TASK_WATCHDOG_RESET) {
 		p->scx->runnable_at = jiffies;
-	p->scx->flags &= ~SCX_TASK_WATCHDOG_RESET;
-	list_add_tail(&p->scx->watchdog_node, &rq->scx->watchdog_list);
+		p->scx->runnable_at_ns = rq_clock(rq);
+		p->scx->lat_src = SCX_LAT_LOCAL;
+		p->scx->flags &= ~SCX_TASK_WATCHDOG_RESET;
+		list_add_tail(&p->scx->watchdog_node, list);
+		return;
+	}
+
+	list_for_each_entry_reverse(pos, list, watchdog_node)
+		if (!time_before(p->scx->runnable_at, pos->runnable_at))
+			break;
+	list_add(&p->scx->watchdog_node, &pos->watchdog_node);
 }
 
 static void watchdog_unwatch_task(struct task_struct *p, bool reset_timeout)
@@ -935,6 +1554,7 @@ static void enqueue_task_scx(struct rq *rq, struct task_struct *p, int enq_flags
 	p->scx->flags |= SCX_TASK_QUEUED;
 	rq->scx->nr_running++;
 	add_nr_running(rq, 1);
+	scx_top_task_add(rq, p);
 
 	if (SCX_HAS_OP(runnable))
 		SCX_CALL_OP_TASK(SCX_KF_REST, runnable, p, enq_flags);
@@ -1019,8 +1639,8 @@ static void dequeue_task_scx(struct rq *rq, struct task_struct *p, int deq_flags
 		SCX_CALL_OP_TASK(SCX_KF_REST, stopping, p, false);
 	}
 
-	//if(task_current(rq, p))
-	//	scx_update_task_ravg(p, rq, PUT_PREV_TASK, rq->clock);
+	if (task_current(rq, p))
+		scx_update_task_ravg(p, rq, PUT_PREV_TASK, rq->clock);
 
 	if (SCX_HAS_OP(quiescent))
 		SCX_CALL_OP_TASK(SCX_KF_REST, quiescent, p, deq_flags);
@@ -1034,6 +1654,7 @@ static void dequeue_task_scx(struct rq *rq, struct task_struct *p, int deq_flags
 	BUG_ON(!scx_rq->nr_running);
 	scx_rq->nr_running--;
 	sub_nr_running(rq, 1);
+	scx_top_task_del(rq, p);
 
 	dispatch_dequeue(scx_rq, p);
 }
@@ -1193,27 +1814,33 @@ static bool task_can_run_on_rq(struct task_struct *p, struct rq *rq)
 		cpumask_test_cpu(cpu_of(rq), p->cpus_ptr);
 }
 
-static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
-			       struct scx_dispatch_q *dsq)
+static bool __consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
+				 struct scx_dispatch_q *dsq, bool steal)
 {
 	struct scx_rq *scx_rq = rq->scx;
 	struct sched_ext_entity *entity;
 	struct task_struct *p;
 	struct rb_node *rb_node;
 	struct rq *task_rq;
+	bool isolated = scx_cpu_isolated(cpu_of(rq));
+	/* leave UX tasks in other clusters to CPUs without foreign load */
+	bool contended = steal && scx_rq_contended(rq);
 	bool moved = false;
 retry:
-	if (list_empty(&dsq->fifo) && !rb_first_cached(&dsq->priq))
+	if (!dsq_has_tasks(dsq))
 		return false;
 
 	raw_spin_lock(&dsq->lock);
+	dsq_drain_staged(dsq);
 
 	list_for_each_entry(entity, &dsq->fifo, dsq_node.fifo) {
 		p = entity->task;
 		task_rq = task_rq(p);
 		if (rq == task_rq)
 			goto this_rq;
-		if (task_can_run_on_rq(p, rq))
+		if (task_can_run_on_rq(p, rq) && (!steal || task_fits_rq(p, rq)) &&
+		    (!isolated || task_needs_iso_rescue(p)) &&
+		    !(steal && contended && task_is_ux(p)))
 			goto remote_rq;
 	}
 
@@ -1224,7 +1851,9 @@ static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
 		task_rq = task_rq(p);
 		if (rq == task_rq)
 			goto this_rq;
-		if (task_can_run_on_rq(p, rq))
+		if (task_can_run_on_rq(p, rq) && (!steal || task_fits_rq(p, rq)) &&
+		    (!isolated || task_needs_iso_rescue(p)) &&
+		    !(steal && contended && task_is_ux(p)))
 			goto remote_rq;
 	}
 
@@ -1233,6 +1862,7 @@ static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
 
 this_rq:
 	/* @dsq is locked and @p is on this rq */
+	trace_sched_ext_dsq_consume(p, dsq->id, cpu_of(rq), steal);
 	WARN_ON_ONCE(p->scx->holding_cpu >= 0);
 	task_unlink_from_dsq(p, dsq);
 	list_add_tail(&p->scx->dsq_node.fifo, &scx_rq->local_dsq.fifo);
@@ -1251,6 +1881,9 @@ static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
 	 * rq lock or fail, do a little dancing from our side. See
 	 * move_task_to_local_dsq().
 	 */
+	trace_sched_ext_dsq_consume(p, dsq->id, cpu_of(rq), steal);
+	if (isolated && READ_ONCE(iso_free_rescue))
+		scx_iso_set(per_cpu(scx_cpu_cluster, cpu_of(rq)), false);
 	WARN_ON_ONCE(p->scx->holding_cpu >= 0);
 	task_unlink_from_dsq(p, dsq);
 	dsq->nr--;
@@ -1270,6 +1903,48 @@ static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
 	goto retry;
 }
 
+static bool consume_dispatch_q(struct rq *rq, struct rq_flags *rf,
+			       struct scx_dispatch_q *dsq)
+{
+	return __consume_dispatch_q(rq, rf, dsq, false);
+}
+
+/**
+ * consume_builtin_dsqs - Consume the built-in DSQs in locality order
+ * @rq: rq to consume into
+ * @rf: rq_flags to use when unlocking @rq
+ *
+ * Consume @rq's cluster DSQ, then the global DSQ and finally steal from the
+ * other clusters, nearest capacity first. Only tasks which fit @rq's cluster
+ * are stolen so that little CPUs don't pull heavy tasks off big ones.
+ */
+static bool consume_builtin_dsqs(struct rq *rq, struct rq_flags *rf)
+{
+	int cid = per_cpu(scx_cpu_cluster, cpu_of(rq));
+	int dist;
+
+	if (likely(scx_nr_clusters) &&
+	    consume_dispatch_q(rq, rf, &scx_clusters[cid].dsq))
+		return true;
+
+	if (consume_dispatch_q(rq, rf, &scx_dsq_global))
+		return true;
+
+	/* isolated clusters don't consume their own DSQs, drain them freely */
+	for (dist = 1; dist < scx_nr_clusters; dist++) {
+		if (cid + dist < scx_nr_clusters &&
+		    __consume_dispatch_q(rq, rf, &scx_clusters[cid + dist].dsq,
+					 !test_bit(cid + dist, &scx_isolated_clusters)))
+			return true;
+		if (cid - dist >= 0 &&
+		    __consume_dispatch_q(rq, rf, &scx_clusters[cid - dist].dsq,
+					 !test_bit(cid - dist, &scx_isolated_clusters)))
+			return true;
+	}
+
+	return false;
+}
+
 enum dispatch_to_local_dsq_ret {
 	DTL_DISPATCHED,		/* successfully dispatched */
 	DTL_LOST,		/* lost race to dequeue */
@@ -1475,7 +2150,8 @@ static void finish_dispatch(struct rq *rq, struct rq_flags *rf,
 	case DTL_NOT_LOCAL:
 		dsq = find_dsq_for_dispatch(cpu_rq(raw_smp_processor_id()),
 					    dsq_id, p);
-		dispatch_enqueue(dsq, p, enq_flags | SCX_ENQ_CLEAR_OPSS);
+		dispatch_enqueue(dsq, p, enq_flags | SCX_ENQ_CLEAR_OPSS |
+				 SCX_ENQ_NO_STAGE);
 		break;
 	}
 }
@@ -1496,6 +2172,44 @@ static void flush_dispatch_buf(struct rq *rq, struct rq_flags *rf)
 	dspc->buf_cursor = 0;
 }
 
+/*
+ * scx_bpf_dispatch_nr_slots() advertises @dspc->batch rather than the whole
+ * buffer. A round which fills the batch means there's more backlog, so
+ * double it for the next round and save a lock drop and retake in
+ * flush_dispatch_buf(). A round which dispatches less than a quarter halves
+ * it so that a CPU doesn't pull in tasks which other CPUs could run sooner.
+ * A BPF scheduler which ignores the hint can still use the whole buffer.
+ */
+static void scx_dsp_adapt_batch(struct scx_dsp_ctx *dspc)
+{
+	struct scx_dsp_stat *stat = this_cpu_ptr(&scx_dsp_stat);
+
+	stat->rounds++;
+	if (dspc->nr_tasks >= dspc->batch) {
+		stat->batch_full++;
+		dspc->batch = min(dspc->batch * 2, scx_dsp_max_batch);
+	} else if (dspc->nr_tasks * 4 < dspc->batch) {
+		dspc->batch = max(dspc->batch / 2, 1U);
+	}
+}
+
+static void scx_show_dsp_stat(struct seq_file *m)
+{
+	u64 rounds = 0, batch_full = 0, loops_exhausted = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct scx_dsp_stat *stat = per_cpu_ptr(&scx_dsp_stat, cpu);
+
+		rounds += READ_ONCE(stat->rounds);
+		batch_full += READ_ONCE(stat->batch_full);
+		loops_exhausted += READ_ONCE(stat->loops_exhausted);
+	}
+
+	seq_printf(m, "dispatch rounds=%llu batch_full=%llu loops_exhausted=%llu\n",
+		   rounds, batch_full, loops_exhausted);
+}
+
 static int balance_one(struct rq *rq, struct task_struct *prev,
 		       struct rq_flags *rf, bool local)
 {
@@ -1551,7 +2265,7 @@ static int balance_one(struct rq *rq, struct task_struct *prev,
 	if (scx_rq->local_dsq.nr)
 		return 1;
 
-	if (consume_dispatch_q(rq, rf, &scx_dsq_global))
+	if (consume_builtin_dsqs(rq, rf))
 		return 1;
 
 	if (!SCX_HAS_OP(dispatch))
@@ -1574,10 +2288,11 @@ static int balance_one(struct rq *rq, struct task_struct *prev,
 			    prev_on_scx ? prev : NULL);
 
 		flush_dispatch_buf(rq, rf);
+		scx_dsp_adapt_batch(dspc);
 
 		if (scx_rq->local_dsq.nr)
 			return 1;
-		if (consume_dispatch_q(rq, rf, &scx_dsq_global))
+		if (consume_builtin_dsqs(rq, rf))
 			return 1;
 
 		/*
@@ -1590,6 +2305,7 @@ static int balance_one(struct rq *rq, struct task_struct *prev,
 		 * scx_bpf_kick_cpu() for deferred kicking.
 		 */
 		if (unlikely(!--nr_loops)) {
+			this_cpu_inc(scx_dsp_stat.loops_exhausted);
 			scx_bpf_kick_cpu(cpu_of(rq), 0);
 			break;
 		}
@@ -1656,10 +2372,14 @@ static void set_next_task_scx(struct rq *rq, struct task_struct *p, bool first)
 	if (SCX_HAS_OP(running) && (p->scx->flags & SCX_TASK_QUEUED))
 		SCX_CALL_OP_TASK(SCX_KF_REST, running, p);
 
-	//if(p->scx->flags & SCX_TASK_QUEUED)
-	//	scx_update_task_ravg(p, rq, PICK_NEXT_TASK, rq->clock);
+	if (p->scx->flags & SCX_TASK_QUEUED) {
+		scx_update_task_ravg(p, rq, PICK_NEXT_TASK, rq->clock);
+		if (READ_ONCE(slim_stats))
+			scx_record_latency(rq, p);
+	}
 
 	watchdog_unwatch_task(p, true);
+	scx_hrtick_start(rq, p);
 
 	/*
 	 * @p is getting newly scheduled or got kicked after someone updated its
@@ -1710,13 +2430,14 @@ static void put_prev_task_scx(struct rq *rq, struct task_struct *p)
 #endif
 
 	update_curr_scx(rq);
+	scx_hrtick_cancel(rq);
 
 	/* see dequeue_task_scx() on why we skip when !QUEUED */
 	if (SCX_HAS_OP(stopping) && (p->scx->flags & SCX_TASK_QUEUED))
 		SCX_CALL_OP_TASK(SCX_KF_REST, stopping, p, true);
 
-	//if(p->scx->flags & SCX_TASK_QUEUED)
-	//	scx_update_task_ravg(p, rq, PUT_PREV_TASK, rq->clock);
+	if (p->scx->flags & SCX_TASK_QUEUED)
+		scx_update_task_ravg(p, rq, PUT_PREV_TASK, rq->clock);
 
 
 	/*
@@ -1941,6 +2662,8 @@ void __scx_notify_pick_next_task(struct rq *rq, struct task_struct *task,
 
 static bool test_and_clear_cpu_idle(int cpu)
 {
+	cpumask_clear_cpu(cpu, scx_clusters[per_cpu(scx_cpu_cluster, cpu)].idle);
+
 	if (cpumask_test_and_clear_cpu(cpu, idle_masks.cpu)) {
 		if (cpumask_empty(idle_masks.cpu))
 			scx_has_idle_cpus = false;
@@ -1979,8 +2702,172 @@ static s32 scx_pick_idle_cpu(const struct cpumask *cpus_allowed)
 	return cpu;
 }
 
+/**
+ * scx_build_clusters - Group CPUs into capacity clusters
+ *
+ * Group possible CPUs by arch_scale_cpu_capacity() and sort the groups in
+ * ascending capacity order. If there are more distinct capacities than
+ * %SCX_MAX_CLUSTERS, the CPUs with the extra capacities are folded into the
+ * closest smaller cluster. Must be called with cpus_read_lock() held and before
+ * the built-in idle tracking is enabled.
+ */
+static void scx_build_clusters(void)
+{
+	unsigned long cap;
+	int cpu, i, j, nr = 0;
+
+	for (i = 0; i < SCX_MAX_CLUSTERS; i++) {
+		cpumask_clear(scx_clusters[i].cpus);
+		cpumask_clear(scx_clusters[i].idle);
+		scx_clusters[i].capacity = 0;
+	}
+
+	for_each_possible_cpu(cpu) {
+		cap = arch_scale_cpu_capacity(cpu);
+
+		for (i = 0; i < nr && scx_clusters[i].capacity < cap; i++)
+			;
+		if (i < nr && scx_clusters[i].capacity == cap)
+			continue;
+		if (nr == SCX_MAX_CLUSTERS)
+			continue;
+
+		for (j = nr; j > i; j--)
+			scx_clusters[j].capacity = scx_clusters[j - 1].capacity;
+		scx_clusters[i].capacity = cap;
+		nr++;
+	}
+
+	for_each_possible_cpu(cpu) {
+		cap = arch_scale_cpu_capacity(cpu);
+
+		for (i = nr - 1; i > 0 && scx_clusters[i].capacity > cap; i--)
+			;
+		cpumask_set_cpu(cpu, scx_clusters[i].cpus);
+		per_cpu(scx_cpu_cluster, cpu) = i;
+	}
+
+	scx_nr_clusters = nr;
+	scx_isolated_clusters = 0;
+	cpumask_clear(&scx_isolated_cpus);
+}
+
+static s32 scx_pick_idle_cpu_in_cluster(int cid, const struct cpumask *cpus_allowed)
+{
+	int cpu;
+
+	/* test_and_clear_cpu_idle() clears @cpu from the cluster mask */
+	do {
+		cpu = cpumask_any_and_distribute(scx_clusters[cid].idle,
+						 cpus_allowed);
+		if (cpu >= nr_cpu_ids)
+			return -EBUSY;
+	} while (!test_and_clear_cpu_idle(cpu));
+
+	return cpu;
+}
+
+/**
+ * scx_pick_idle_cpu_fit - Pick an idle CPU whose capacity fits a task
+ * @p: task to pick a CPU for
+ * @prev_cid: cluster of @p's previous CPU
+ *
+ * Try @prev_cid first to keep the cache footprint and avoid waking up another
+ * cluster, then the remaining clusters which @p fits from the smallest one up
+ * so that small tasks don't wake up big cores. If no fitting CPU is idle, fall
+ * back to any idle CPU.
+ */
+static s32 scx_pick_idle_cpu_fit(struct task_struct *p, int prev_cid)
+{
+	s32 cpu;
+	int cid;
+
+	if (task_fits_cluster(p, prev_cid)) {
+		cpu = scx_pick_idle_cpu_in_cluster(prev_cid, p->cpus_ptr);
+		if (cpu >= 0) {
+			cid = prev_cid;
+			goto found;
+		}
+	}
+
+	for (cid = 0; cid < scx_nr_clusters; cid++) {
+		if (cid == prev_cid || !task_fits_cluster(p, cid))
+			continue;
+
+		cpu = scx_pick_idle_cpu_in_cluster(cid, p->cpus_ptr);
+		if (cpu >= 0)
+			goto found;
+	}
+
+	cpu = scx_pick_idle_cpu(p->cpus_ptr);
+	if (cpu < 0)
+		return cpu;
+	cid = per_cpu(scx_cpu_cluster, cpu);
+found:
+	trace_sched_ext_select_cluster(p, prev_cid, cid, cpu,
+				       p->scx->sts.demand_scaled);
+	return cpu;
+}
+
+/*
+ * No CPU is idle and @p's previous one is busy with CFS or RT work. Pick the
+ * fitting CPU with the fewest runnable foreign tasks, then the least foreign
+ * utilization, so that @p isn't stuck behind e.g. an RT audio thread.
+ */
+static s32 scx_pick_uncontended_cpu(struct task_struct *p)
+{
+	unsigned long best_util = ULONG_MAX;
+	unsigned int best_nr = UINT_MAX;
+	s32 cpu, best = -EBUSY;
+
+	for_each_cpu_and(cpu, p->cpus_ptr, cpu_active_mask) {
+		struct rq *rq = cpu_rq(cpu);
+		unsigned int nr = scx_rq_foreign_nr(rq);
+		unsigned long util = scx_rq_foreign_util(rq);
+
+		if (scx_cpu_isolated(cpu) ||
+		    !task_fits_cluster(p, per_cpu(scx_cpu_cluster, cpu)))
+			continue;
+
+		if (nr < best_nr || (nr == best_nr && util < best_util)) {
+			best = cpu;
+			best_nr = nr;
+			best_util = util;
+		}
+	}
+
+	return best;
+}
+
+/* keep @p off isolated CPUs unless its affinity leaves no choice */
+static s32 scx_iso_redirect(struct task_struct *p, s32 cpu)
+{
+	s32 alt;
+	int cid;
+
+	if (likely(!scx_cpu_isolated(cpu)))
+		return cpu;
+
+	for (cid = 0; cid < scx_nr_clusters; cid++) {
+		if (test_bit(cid, &scx_isolated_clusters) ||
+		    !task_fits_cluster(p, cid))
+			continue;
+		alt = cpumask_any_and_distribute(scx_clusters[cid].cpus,
+						 p->cpus_ptr);
+		if (alt < nr_cpu_ids && cpu_active(alt))
+			return alt;
+	}
+
+	for_each_cpu_andnot(alt, p->cpus_ptr, &scx_isolated_cpus)
+		if (cpu_active(alt))
+			return alt;
+
+	return cpu;
+}
+
 static s32 scx_select_cpu_dfl(struct task_struct *p, s32 prev_cpu, u64 wake_flags)
 {
+	int prev_cid = per_cpu(scx_cpu_cluster, prev_cpu);
 	s32 cpu;
 
 	if (!static_branch_likely(&scx_builtin_idle_enabled)) {
@@ -1988,39 +2875,61 @@ static s32 scx_select_cpu_dfl(struct task_struct *p, s32 prev_cpu, u64 wake_flag
 		return prev_cpu;
 	}
 
+	/* a UX task with a critical CPU goes straight to its local DSQ */
+	cpu = p->scx->critical_affinity_cpu;
+	if (cpu >= 0 && task_is_ux(p) && cpumask_test_cpu(cpu, p->cpus_ptr) &&
+	    cpu_active(cpu) && !scx_cpu_isolated(cpu)) {
+		p->scx->flags |= SCX_TASK_ENQ_LOCAL;
+		return cpu;
+	}
+
 	/*
 	 * If WAKE_SYNC and the machine isn't fully saturated, wake up @p to the
-	 * local DSQ of the waker.
+	 * local DSQ of the waker if @p fits there and the waker's CPU isn't
+	 * isolated.
 	 */
 	if ((wake_flags & SCX_WAKE_SYNC) && p->nr_cpus_allowed > 1 &&
 	    scx_has_idle_cpus && !(current->flags & PF_EXITING)) {
 		cpu = smp_processor_id();
-		if (cpumask_test_cpu(cpu, p->cpus_ptr)) {
+		if (cpumask_test_cpu(cpu, p->cpus_ptr) && !scx_cpu_isolated(cpu) &&
+		    task_fits_cluster(p, per_cpu(scx_cpu_cluster, cpu)) &&
+		    scx_rq_foreign_nr(cpu_rq(cpu)) <= !task_on_scx(current)) {
 			p->scx->flags |= SCX_TASK_ENQ_LOCAL;
 			return cpu;
 		}
 	}
 
-	/* if the previous CPU is idle, dispatch directly to it */
-	if (test_and_clear_cpu_idle(prev_cpu)) {
-		p->scx->flags |= SCX_TASK_ENQ_LOCAL;
+	if (p->nr_cpus_allowed == 1) {
+		if (test_and_clear_cpu_idle(prev_cpu))
+			p->scx->flags |= SCX_TASK_ENQ_LOCAL;
 		return prev_cpu;
 	}
 
-	if (p->nr_cpus_allowed == 1)
+	/* if the previous CPU is idle and @p still fits it, dispatch to it */
+	if (task_fits_cluster(p, prev_cid) && test_and_clear_cpu_idle(prev_cpu)) {
+		p->scx->flags |= SCX_TASK_ENQ_LOCAL;
 		return prev_cpu;
+	}
 
-	cpu = scx_pick_idle_cpu(p->cpus_ptr);
+	cpu = scx_pick_idle_cpu_fit(p, prev_cid);
 	if (cpu >= 0) {
 		p->scx->flags |= SCX_TASK_ENQ_LOCAL;
 		return cpu;
 	}
 
-	return prev_cpu;
+	if (scx_rq_contended(cpu_rq(prev_cpu))) {
+		cpu = scx_pick_uncontended_cpu(p);
+		if (cpu >= 0)
+			return cpu;
+	}
+
+	return scx_iso_redirect(p, prev_cpu);
 }
 
 static int select_task_rq_scx(struct task_struct *p, int prev_cpu, int wake_flags)
 {
+	scx_ux_inherit(p, wake_flags);
+
 	if (SCX_HAS_OP(select_cpu)) {
 		s32 cpu;
 
@@ -2056,9 +2965,13 @@ static void set_cpus_allowed_scx(struct task_struct *p, struct affinity_context
 
 static void reset_idle_masks(void)
 {
+	int cid;
+
 	/* consider all cpus idle, should converge to the actual state quickly */
 	cpumask_setall(idle_masks.cpu);
 	cpumask_setall(idle_masks.smt);
+	for (cid = 0; cid < scx_nr_clusters; cid++)
+		cpumask_copy(scx_clusters[cid].idle, scx_clusters[cid].cpus);
 	scx_has_idle_cpus = true;
 }
 
@@ -2074,7 +2987,12 @@ void __scx_update_idle(struct rq *rq, bool idle)
 	}
 
 	if (idle) {
+		/* isolated CPUs are hidden from the idle picker */
+		if (scx_cpu_isolated(cpu))
+			return;
+
 		cpumask_set_cpu(cpu, idle_masks.cpu);
+		cpumask_set_cpu(cpu, scx_clusters[per_cpu(scx_cpu_cluster, cpu)].idle);
 		if (!scx_has_idle_cpus)
 			scx_has_idle_cpus = true;
 
@@ -2089,6 +3007,7 @@ void __scx_update_idle(struct rq *rq, bool idle)
 		cpumask_or(idle_masks.smt, idle_masks.smt, sib_mask);
 	} else {
 		cpumask_clear_cpu(cpu, idle_masks.cpu);
+		cpumask_clear_cpu(cpu, scx_clusters[per_cpu(scx_cpu_cluster, cpu)].idle);
 		if (scx_has_idle_cpus && cpumask_empty(idle_masks.cpu))
 			scx_has_idle_cpus = false;
 
@@ -2096,43 +3015,227 @@ void __scx_update_idle(struct rq *rq, bool idle)
 	}
 }
 
+/*
+ * Isolation controller.
+ *
+ * While isolate_ctrl is set, each cluster above the smallest one is isolated
+ * when the load of it and the clusters below it would stay under
+ * isoctrl_low_ratio percent of the capacity of the clusters below, and
+ * released when that ratio rises above isoctrl_high_ratio. An isolated
+ * cluster's CPUs are hidden from the idle picker, scx_select_cpu_dfl() steers
+ * wakeups away from them and they only consume tasks whose affinity allows
+ * nothing else. Other clusters drain their cluster DSQ. With iso_free_rescue
+ * set, such a rescue releases the cluster.
+ *
+ * This saves power on light scenes without the latency of CPU hotplug. It's
+ * evaluated once per window from whichever CPU rolls its window over first.
+ */
+static void scx_iso_set(int cid, bool isolate)
+{
+	struct scx_cluster *cl = &scx_clusters[cid];
+	int cpu;
+
+	if (isolate) {
+		if (test_and_set_bit(cid, &scx_isolated_clusters))
+			return;
+		for_each_cpu(cpu, cl->cpus) {
+			cpumask_set_cpu(cpu, &scx_isolated_cpus);
+			test_and_clear_cpu_idle(cpu);
+		}
+	} else {
+		if (!test_and_clear_bit(cid, &scx_isolated_clusters))
+			return;
+		for_each_cpu(cpu, cl->cpus) {
+			cpumask_clear_cpu(cpu, &scx_isolated_cpus);
+			/* racy like the rest of idle tracking, self-correcting */
+			if (idle_cpu(cpu)) {
+				cpumask_set_cpu(cpu, idle_masks.cpu);
+				cpumask_set_cpu(cpu, cl->idle);
+				scx_has_idle_cpus = true;
+			}
+		}
+	}
+}
+
+static void scx_iso_update(struct rq *rq)
+{
+	static u64 last_window_start;
+	u64 window_start = rq->scx->srq.window_start;
+	u64 util = 0, cap = 0, last;
+	int cid, cpu, ratio;
+
+	if (!READ_ONCE(isolate_ctrl)) {
+		for (cid = 1; cid < scx_nr_clusters; cid++)
+			scx_iso_set(cid, false);
+		return;
+	}
+
+	last = READ_ONCE(last_window_start);
+	if (window_start <= last ||
+	    cmpxchg64(&last_window_start, last, window_start) != last)
+		return;
+
+	for (cid = 0; cid < scx_nr_clusters; cid++) {
+		struct scx_cluster *cl = &scx_clusters[cid];
+
+		for_each_cpu(cpu, cl->cpus)
+			util += scx_cpu_util(cpu);
+
+		if (cid && cap) {
+			ratio = div64_u64(util * 100, cap);
+			if (ratio < READ_ONCE(isoctrl_low_ratio))
+				scx_iso_set(cid, true);
+			else if (ratio > READ_ONCE(isoctrl_high_ratio))
+				scx_iso_set(cid, false);
+		}
+
+		cap += (u64)cl->capacity * cpumask_weight(cl->cpus);
+	}
+}
+
 #else /* !CONFIG_SMP */
 
+static void scx_iso_set(int cid, bool isolate) {}
+static void scx_iso_update(struct rq *rq) {}
 static bool test_and_clear_cpu_idle(int cpu) { return false; }
 static s32 scx_pick_idle_cpu(const struct cpumask *cpus_allowed) { return -EBUSY; }
+static void scx_build_clusters(void) {}
 static void reset_idle_masks(void) {}
 
 #endif /* CONFIG_SMP */
 
-static bool check_rq_for_timeouts(struct rq *rq)
+/* the watchdog list is in runnable_at order, only the head can be stalled */
+static bool check_rq_head_for_timeout(struct rq *rq)
 {
 	struct sched_ext_entity *entity;
 	struct task_struct *p;
+	unsigned long last_runnable;
+	u32 dur_ms;
+
+	lockdep_assert_rq_held(rq);
+
+	entity = list_first_entry_or_null(&rq->scx->watchdog_list,
+					  struct sched_ext_entity, watchdog_node);
+	if (!entity)
+		return false;
+
+	p = entity->task;
+	last_runnable = p->scx->runnable_at;
+
+	if (likely(!time_after(jiffies, last_runnable + scx_watchdog_timeout)))
+		return false;
+
+	dur_ms = jiffies_to_msecs(jiffies - last_runnable);
+	scx_ops_error_type(SCX_EXIT_ERROR_STALL,
+			   "%s[%d] failed to run for %u.%03us",
+			   p->comm, p->pid, dur_ms / 1000, dur_ms % 1000);
+	return true;
+}
+
+static bool check_rq_for_timeouts(struct rq *rq)
+{
 	struct rq_flags rf;
-	bool timed_out = false;
+	bool timed_out;
 
 	rq_lock_irqsave(rq, &rf);
-	list_for_each_entry(entity, &rq->scx->watchdog_list, watchdog_node) {
-		unsigned long last_runnable;
+	timed_out = check_rq_head_for_timeout(rq);
+	rq_unlock_irqrestore(rq, &rf);
 
-		p = entity->task;
-		last_runnable = p->scx->runnable_at;
+	return timed_out;
+}
 
-		if (unlikely(time_after(jiffies,
-					last_runnable + scx_watchdog_timeout))) {
-			u32 dur_ms = jiffies_to_msecs(jiffies - last_runnable);
+/*
+ * Look at the front of @dsq's fifo and priq. HEAD enqueues and vtime ordering
+ * mean this isn't strictly the oldest task but it's the one which is
+ * consumed next and thus where a stall shows up first.
+ */
+static bool dsq_front_runnable_at(struct scx_dispatch_q *dsq,
+				  unsigned long *runnable_at)
+{
+	struct sched_ext_entity *entity;
+	struct rb_node *rb_node;
+	bool found = false;
 
-			scx_ops_error_type(SCX_EXIT_ERROR_STALL,
-					   "%s[%d] failed to run for %u.%03us",
-					   p->comm, p->pid,
-					   dur_ms / 1000, dur_ms % 1000);
-			timed_out = true;
-			break;
-		}
+	entity = list_first_entry_or_null(&dsq->fifo, struct sched_ext_entity,
+					  dsq_node.fifo);
+	if (entity) {
+		*runnable_at = entity->runnable_at;
+		found = true;
 	}
-	rq_unlock_irqrestore(rq, &rf);
 
-	return timed_out;
+	rb_node = rb_first_cached(&dsq->priq);
+	if (rb_node) {
+		entity = container_of(rb_node, struct sched_ext_entity,
+				      dsq_node.priq);
+		if (!found || time_before(entity->runnable_at, *runnable_at))
+			*runnable_at = entity->runnable_at;
+		found = true;
+	}
+
+	return found;
+}
+
+static void show_dsq_stall_age(struct seq_file *m, const char *name, u64 id,
+			       struct scx_dispatch_q *dsq)
+{
+	unsigned long runnable_at;
+	unsigned long flags;
+	u32 nr;
+	bool found;
+
+	raw_spin_lock_irqsave(&dsq->lock, flags);
+	dsq_drain_staged(dsq);
+	nr = dsq->nr;
+	found = dsq_front_runnable_at(dsq, &runnable_at);
+	raw_spin_unlock_irqrestore(&dsq->lock, flags);
+
+	seq_printf(m, "%-8s 0x%016llx nr=%u age_ms=%u\n", name, id, nr,
+		   found ? jiffies_to_msecs(jiffies - runnable_at) : 0);
+}
+
+/* oldest runnable age per DSQ, see /proc/hmbird_sched/dsq_stall_age */
+static void scx_show_dsq_stall_ages(struct seq_file *m)
+{
+	struct rhashtable_iter rht_iter;
+	struct scx_dispatch_q *dsq;
+	struct rq_flags rf;
+	int cpu, i;
+
+	if (!scx_enabled())
+		return;
+
+	show_dsq_stall_age(m, "global", SCX_DSQ_GLOBAL, &scx_dsq_global);
+
+	for (i = 0; i < scx_nr_clusters; i++)
+		show_dsq_stall_age(m, "cluster", scx_clusters[i].dsq.id,
+				   &scx_clusters[i].dsq);
+
+	rhashtable_walk_enter(&dsq_hash, &rht_iter);
+	do {
+		rhashtable_walk_start(&rht_iter);
+
+		while ((dsq = rhashtable_walk_next(&rht_iter)) && !IS_ERR(dsq))
+			show_dsq_stall_age(m, "user", dsq->id, dsq);
+
+		rhashtable_walk_stop(&rht_iter);
+	} while (dsq == ERR_PTR(-EAGAIN));
+	rhashtable_walk_exit(&rht_iter);
+
+	for_each_online_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+		unsigned long runnable_at;
+		bool found;
+		u32 nr;
+
+		rq_lock_irqsave(rq, &rf);
+		nr = rq->scx->local_dsq.nr;
+		found = dsq_front_runnable_at(&rq->scx->local_dsq, &runnable_at);
+		rq_unlock_irqrestore(rq, &rf);
+
+		seq_printf(m, "%-8s 0x%016llx nr=%u age_ms=%u\n", "local",
+			   SCX_DSQ_LOCAL_ON | cpu, nr,
+			   found ? jiffies_to_msecs(jiffies - runnable_at) : 0);
+	}
 }
 
 static void scx_watchdog_workfn(struct work_struct *work)
@@ -2154,7 +3257,11 @@ static void scx_watchdog_workfn(struct work_struct *work)
 static void task_tick_scx(struct rq *rq, struct task_struct *curr, int queued)
 {
 	update_curr_scx(rq);
-	//scx_update_task_ravg(curr, rq, TASK_UPDATE, rq->clock);
+	scx_update_task_ravg(curr, rq, TASK_UPDATE, rq->clock);
+
+	/* per-CPU stall check, catches stalls well before scx_watchdog_work */
+	if (READ_ONCE(watchdog_enable))
+		check_rq_head_for_timeout(rq);
 	/*
 	 * While disabling, always resched and refresh core-sched timestamp as
 	 * we can't trust the slice management or ops.core_sched_before().
@@ -2164,8 +3271,14 @@ static void task_tick_scx(struct rq *rq, struct task_struct *curr, int queued)
 		touch_core_sched(rq, curr);
 	}
 
+	/* @queued is set when called from the hrtick */
+	if (queued)
+		scx_hrtick_fired(rq);
+
 	if (!curr->scx->slice)
 		resched_curr(rq);
+	else if (!(rq->scx->flags & SCX_RQ_HRTICK_ARMED))
+		scx_hrtick_start(rq, curr);	/* re-arm on refill */
 }
 
 #define SCX_ENABLE_ARGS_INIT_CGROUP(tg)
@@ -2189,7 +3302,7 @@ static int scx_ops_prepare_task(struct task_struct *p, struct task_group *tg)
 			return ret;
 		}
 	}
-	//scx_sched_init_task(p);
+	scx_sched_init_task(p);
 
 	if (p->scx->disallow) {
 		struct rq *rq;
@@ -2294,6 +3407,8 @@ void scx_pre_fork(struct task_struct *p)
 	atomic64_set(&p->scx->ops_state, 0);
 	p->scx->runnable_at = INITIAL_JIFFIES;
 	p->scx->slice = SCX_SLICE_DFL;
+	p->scx->dsq_sync_ux = DSQ_SYNC_UX_NONE;
+	p->scx->critical_affinity_cpu = -1;
 	p->scx->task = p;
 	p->sched_prop = 0;
 
@@ -2471,12 +3586,14 @@ static void init_dsq(struct scx_dispatch_q *dsq, u64 dsq_id)
 
 	raw_spin_lock_init(&dsq->lock);
 	INIT_LIST_HEAD(&dsq->fifo);
+	init_llist_head(&dsq->staged);
 	dsq->id = dsq_id;
 }
 
 static struct scx_dispatch_q *create_dsq(u64 dsq_id, int node)
 {
 	struct scx_dispatch_q *dsq;
+	int ret;
 
 	if (dsq_id & SCX_DSQ_FLAG_BUILTIN)
 		return ERR_PTR(-EINVAL);
@@ -2487,6 +3604,12 @@ static struct scx_dispatch_q *create_dsq(u64 dsq_id, int node)
 
 	init_dsq(dsq, dsq_id);
 
+	ret = rhashtable_insert_fast(&dsq_hash, &dsq->hash_node,
+				     dsq_hash_params);
+	if (ret) {
+		kfree(dsq);
+		return ERR_PTR(ret);
+	}
 	return dsq;
 }
 
@@ -2503,6 +3626,40 @@ static DEFINE_IRQ_WORK(free_dsq_irq_work, free_dsq_irq_workfn);
 
 static void destroy_dsq(u64 dsq_id)
 {
+	struct scx_dispatch_q *dsq;
+	unsigned long flags;
+
+	rcu_read_lock();
+
+	dsq = find_user_dsq(dsq_id);
+	if (!dsq)
+		goto out_unlock_rcu;
+
+	raw_spin_lock_irqsave(&dsq->lock, flags);
+
+	if (dsq->nr) {
+		scx_ops_error("attempting to destroy in-use dsq 0x%016llx (nr=%u)",
+			      dsq->id, dsq->nr);
+		goto out_unlock_dsq;
+	}
+
+	if (rhashtable_remove_fast(&dsq_hash, &dsq->hash_node, dsq_hash_params))
+		goto out_unlock_dsq;
+
+	/*
+	 * Mark dead by invalidating ->id to prevent dispatch_enqueue() from
+	 * queueing more tasks. As this function can be called from anywhere,
+	 * freeing is bounced through an irq work to avoid nesting RCU
+	 * operations inside scheduler locks.
+	 */
+	dsq->id = SCX_DSQ_INVALID;
+	llist_add(&dsq->free_node, &dsqs_to_free);
+	irq_work_queue(&free_dsq_irq_work);
+
+out_unlock_dsq:
+	raw_spin_unlock_irqrestore(&dsq->lock, flags);
+out_unlock_rcu:
+	rcu_read_unlock();
 }
 
 static void scx_cgroup_exit(void) {}
@@ -2532,11 +3689,27 @@ static void scx_ops_fallback_enqueue(struct task_struct *p, u64 enq_flags)
 
 static void scx_ops_fallback_dispatch(s32 cpu, struct task_struct *prev) {}
 
+unsigned long scx_gov_handover_end;
+
+/*
+ * Called when tasks are about to move between ext and CFS. The side taking
+ * over starts cold, slim_walt.c windows on enable and PELT of the returning
+ * tasks on disable. Two windows cover the first complete window of the new
+ * side.
+ */
+static void scx_gov_start_handover(void)
+{
+	WRITE_ONCE(scx_gov_handover_end,
+		   jiffies + nsecs_to_jiffies(2ULL * sched_ravg_window) + 1);
+}
+
 static void scx_ops_disable_workfn(struct kthread_work *work)
 {
 	struct scx_exit_info *ei = &scx_exit_info;
 	struct scx_task_iter sti;
 	struct task_struct *p;
+	struct rhashtable_iter rht_iter;
+	struct scx_dispatch_q *dsq;
 	const char *reason;
 	int i, cpu, type;
 
@@ -2649,6 +3822,7 @@ static void scx_ops_disable_workfn(struct kthread_work *work)
 	 */
 	mutex_lock(&scx_ops_enable_mutex);
 
+	scx_gov_start_handover();
 	static_branch_disable(&__scx_switched_all);
 	WRITE_ONCE(scx_switching_all, false);
 
@@ -2691,6 +3865,17 @@ static void scx_ops_disable_workfn(struct kthread_work *work)
 	static_branch_disable_cpuslocked(&scx_builtin_idle_enabled);
 	synchronize_rcu();
 
+	rhashtable_walk_enter(&dsq_hash, &rht_iter);
+	do {
+		rhashtable_walk_start(&rht_iter);
+
+		while ((dsq = rhashtable_walk_next(&rht_iter)) && !IS_ERR(dsq))
+			destroy_dsq(dsq->id);
+
+		rhashtable_walk_stop(&rht_iter);
+	} while (dsq == ERR_PTR(-EAGAIN));
+	rhashtable_walk_exit(&rht_iter);
+
 	scx_cgroup_exit();
 
 	scx_cgroup_unlock();
@@ -2812,7 +3997,7 @@ static int scx_ops_enable(struct sched_ext_ops *ops)
 		goto err_unlock;
 	}
 
-	//slim_walt_enable(true);
+	slim_walt_enable(true);
 
 	/*
 	 * Set scx_ops, transition to PREPPING and clear exit info to arm the
@@ -2863,6 +4048,8 @@ static int scx_ops_enable(struct sched_ext_ops *ops)
 		ret = -ENOMEM;
 		goto err_disable;
 	}
+	for_each_possible_cpu(i)
+		per_cpu_ptr(&scx_dsp_ctx, i)->batch = scx_dsp_max_batch;
 
 	scx_watchdog_timeout = SCX_WATCHDOG_MAX_TIMEOUT;
 	if (ops->timeout_ms)
@@ -2891,6 +4078,8 @@ static int scx_ops_enable(struct sched_ext_ops *ops)
 	if (scx_ops.cpu_acquire || scx_ops.cpu_release)
 		static_branch_enable_cpuslocked(&scx_ops_cpu_preempt);
 
+	scx_build_clusters();
+
 	if (!ops->update_idle || (ops->flags & SCX_OPS_KEEP_BUILTIN_IDLE)) {
 		reset_idle_masks();
 		static_branch_enable_cpuslocked(&scx_builtin_idle_enabled);
@@ -2960,7 +4149,8 @@ static int scx_ops_enable(struct sched_ext_ops *ops)
 	/*
 	 * We're fully committed and can't fail. The PREPPED -> ENABLED
 	 * transitions here are synchronized against sched_ext_free() through
-	 * scx_tasks_lock.
+	 * scx_tasks_lock. The iterator drops the lock between batches of tasks
+	 * but never while a task is being switched.
 	 */
 	WRITE_ONCE(scx_switching_all, scx_switch_all_req);
 	start = sched_clock();
@@ -2998,6 +4188,7 @@ static int scx_ops_enable(struct sched_ext_ops *ops)
 		goto err_disable;
 	}
 
+	scx_gov_start_handover();
 	if (scx_switch_all_req)
 		static_branch_enable_cpuslocked(&__scx_switched_all);
 
@@ -3282,10 +4473,17 @@ void __init init_sched_ext_class(void)
 	WRITE_ONCE(v, SCX_WAKE_EXEC | SCX_ENQ_WAKEUP | SCX_DEQ_SLEEP |
 		   SCX_TG_ONLINE | SCX_KICK_PREEMPT);
 
+	BUG_ON(rhashtable_init(&dsq_hash, &dsq_hash_params));
 	init_dsq(&scx_dsq_global, SCX_DSQ_GLOBAL);
+	for (cpu = 0; cpu < SCX_MAX_CLUSTERS; cpu++)
+		init_dsq(&scx_clusters[cpu].dsq, SCX_DSQ_CLUSTER | cpu);
 #ifdef CONFIG_SMP
 	BUG_ON(!alloc_cpumask_var(&idle_masks.cpu, GFP_KERNEL));
 	BUG_ON(!alloc_cpumask_var(&idle_masks.smt, GFP_KERNEL));
+	for (cpu = 0; cpu < SCX_MAX_CLUSTERS; cpu++) {
+		BUG_ON(!zalloc_cpumask_var(&scx_clusters[cpu].cpus, GFP_KERNEL));
+		BUG_ON(!zalloc_cpumask_var(&scx_clusters[cpu].idle, GFP_KERNEL));
+	}
 #endif
 	scx_kick_cpus_pnt_seqs =
 		__alloc_percpu(sizeof(scx_kick_cpus_pnt_seqs[0]) *
@@ -3296,7 +4494,7 @@ void __init init_sched_ext_class(void)
 	for_each_possible_cpu(cpu) {
 		struct rq *rq = cpu_rq(cpu);
 
-		rq->scx = kmalloc(sizeof(struct scx_rq), GFP_KERNEL);
+		rq->scx = kzalloc(sizeof(struct scx_rq), GFP_KERNEL);
 		if (rq->scx)
 			rq->scx->rq = rq;
 		else
@@ -3519,10 +4717,13 @@ static const struct btf_kfunc_id_set scx_kfunc_set_enqueue_dispatch = {
  */
 u32 scx_bpf_dispatch_nr_slots(void)
 {
+	u32 batch = __this_cpu_read(scx_dsp_ctx.batch);
+	u32 cursor = __this_cpu_read(scx_dsp_ctx.buf_cursor);
+
 	if (!scx_kf_allowed(SCX_KF_DISPATCH))
 		return 0;
 
-	return scx_dsp_max_batch - __this_cpu_read(scx_dsp_ctx.buf_cursor);
+	return batch > cursor ? batch - cursor : 0;
 }
 
 /**
@@ -3690,8 +4891,16 @@ s32 scx_bpf_dsq_nr_queued(u64 dsq_id)
 			return cpu_rq(cpu)->scx->local_dsq.nr;
 	} else {
 		dsq = find_non_local_dsq(dsq_id);
-		if (dsq)
+		if (dsq) {
+			if (!llist_empty(&dsq->staged)) {
+				unsigned long flags;
+
+				raw_spin_lock_irqsave(&dsq->lock, flags);
+				dsq_drain_staged(dsq);
+				raw_spin_unlock_irqrestore(&dsq->lock, flags);
+			}
 			return dsq->nr;
+		}
 	}
 	return -ENOENT;
 }
@@ -76,6 +76,7 @@ enum scx_enq_flags {
 
 	SCX_ENQ_CLEAR_OPSS	= 1LLU << 56,
 	SCX_ENQ_DSQ_PRIQ	= 1LLU << 57,
+	SCX_ENQ_NO_STAGE	= 1LLU << 58, /* @p's rq isn't locked, see dispatch_enqueue() */
 };
 
 enum scx_deq_flags {
@@ -116,6 +117,47 @@ DECLARE_STATIC_KEY_FALSE(__scx_switched_all);
 
 DECLARE_STATIC_KEY_FALSE(scx_ops_cpu_preempt);
 
+/* hmbird_sched tunables, see hmbird_sched_proc_main.c */
+extern int misfit_ds;
+extern int slim_walt_ctrl;
+extern int slim_walt_policy;
+extern int sched_ravg_window_frame_per_sec;
+extern int scx_gov_ctrl;
+extern int watchdog_enable;
+extern int slim_stats;
+extern int dl_priq_ctrl;
+extern int ux_inherit_ms;
+extern int save_gov;
+extern int isolate_ctrl;
+extern int isoctrl_high_ratio;
+extern int isoctrl_low_ratio;
+extern int iso_free_rescue;
+extern unsigned int highres_tick_ctrl;
+extern unsigned int highres_tick_ctrl_dbg;
+
+unsigned long scx_cpu_util(int cpu);
+unsigned long scx_cpu_top_util(int cpu);
+
+/* whether schedutil should follow the windowed utilization of slim_walt.c */
+static inline bool scx_gov_util_enabled(void)
+{
+	return scx_enabled() && READ_ONCE(scx_gov_ctrl) &&
+		READ_ONCE(slim_walt_ctrl);
+}
+
+extern unsigned long scx_gov_handover_end;
+
+/*
+ * With save_gov set, schedutil keeps running across ext enable and disable
+ * and takes the max of both utilization sources for a couple of windows
+ * instead of the governor being switched, see scx_gov_start_handover().
+ */
+static inline bool scx_gov_in_handover(void)
+{
+	return READ_ONCE(save_gov) &&
+		time_before(jiffies, READ_ONCE(scx_gov_handover_end));
+}
+
 bool task_on_scx(struct task_struct *p);
 void scx_pre_fork(struct task_struct *p);
 int scx_fork(struct task_struct *p);
@@ -218,6 +260,10 @@ static inline void scx_notify_pick_next_task(struct rq *rq,
 					     const struct task_struct *p,
 					     const struct sched_class *active) {}
 static inline void scx_notify_sched_tick(void) {}
+static inline bool scx_gov_util_enabled(void) { return false; }
+static inline bool scx_gov_in_handover(void) { return false; }
+static inline unsigned long scx_cpu_util(int cpu) { return 0; }
+static inline unsigned long scx_cpu_top_util(int cpu) { return 0; }
 
 #define for_each_active_class		for_each_class
 #define for_balance_class_range		for_class_range
@@ -45,9 +45,12 @@ int heartbeat;
 int heartbeat_enable;
 int watchdog_enable;
 int save_gov;
+int dl_priq_ctrl;
+int ux_inherit_ms = 8;
 unsigned int cpu_cluster_masks;
 
-char saved_gov[NR_CPUS][16];
+/* governor of each CPU's policy when save_gov was last set */
+static DEFINE_PER_CPU(char [CPUFREQ_NAME_LEN], saved_gov);
 
 static int set_proc_buf_val(struct file *file, const char __user *buf, size_t count, int *val)
 {
@@ -116,8 +119,15 @@ HMBIRD_PROC_OPS(scx_enable, hmbird_common_open, scx_enable_proc_write);
 static int hmbird_stats_proc_show(struct seq_file *m, void *v)
 {
 	char buf[MAX_STATS_BUF] = {0};
+	int cpu;
 
 	seq_printf(m, "%s\n", buf);
+	scx_show_hrtick_stat(m);
+	scx_show_dsp_stat(m);
+	for_each_present_cpu(cpu)
+		if (per_cpu(saved_gov, cpu)[0])
+			seq_printf(m, "cpu%d saved_gov=%s\n", cpu,
+				   per_cpu(saved_gov, cpu));
 	return 0;
 }
 
@@ -128,31 +138,371 @@ static int hmbird_stats_proc_open(struct inode *inode, struct file *file)
 HMBIRD_PROC_OPS(hmbird_stats, hmbird_stats_proc_open, NULL);
 /* hmbird_stats ops end */
 
+/* sched_latency ops begin */
+static ssize_t sched_latency_proc_write(struct file *file, const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	/* any write resets the histograms */
+	scx_reset_latency_hist();
+	return count;
+}
+
+static int sched_latency_proc_show(struct seq_file *m, void *v)
+{
+	scx_show_latency_hist(m);
+	return 0;
+}
+
+static int sched_latency_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sched_latency_proc_show, inode);
+}
+HMBIRD_PROC_OPS(sched_latency, sched_latency_proc_open, sched_latency_proc_write);
+/* sched_latency ops end */
+
+/* dsq_stall_age ops begin */
+static int dsq_stall_age_proc_show(struct seq_file *m, void *v)
+{
+	scx_show_dsq_stall_ages(m);
+	return 0;
+}
+
+static int dsq_stall_age_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dsq_stall_age_proc_show, inode);
+}
+HMBIRD_PROC_OPS(dsq_stall_age, dsq_stall_age_proc_open, NULL);
+/* dsq_stall_age ops end */
+
 /* sched_ravg_window_frame_per_sec ops begin */
 static ssize_t sched_ravg_window_frame_per_sec_proc_write(struct file *file,
 			const char __user *buf, size_t count, loff_t *ppos)
 {
 	int *pval = (int *)pde_data(file_inode(file));
+	int val;
 
-	if (set_proc_buf_val(file, buf, count, pval))
+	if (set_proc_buf_val(file, buf, count, &val))
 		return -EFAULT;
 
+	if (val < SCX_RAVG_MIN_FPS || val > SCX_RAVG_MAX_FPS)
+		return -EINVAL;
+
+	/* resize windows from the next boundary, see rollover_rq_window() */
+	WRITE_ONCE(*pval, val);
+	scx_set_ravg_window_fps(val);
+
 	return count;
 }
 HMBIRD_PROC_OPS(sched_ravg_window_frame_per_sec, hmbird_common_open,
 			sched_ravg_window_frame_per_sec_proc_write);
 /* sched_ravg_window_frame_per_sec ops end */
 
+/* config & profile ops begin */
+/*
+ * /proc/hmbird_sched/config takes "name=value" lines, one per tunable, and
+ * applies them all or none: every line is parsed and range checked before any
+ * tunable is written. Reading it dumps every tunable in the same format.
+ *
+ * /proc/hmbird_sched/profile holds up to HMBIRD_MAX_PROFILES named tunable
+ * sets. Writing a name followed by "name=value" lines registers or replaces
+ * that profile, writing a bare name applies it. Reading it lists the
+ * registered profiles, the active one marked with '*'.
+ */
+#define HMBIRD_MAX_PROFILES	8
+#define HMBIRD_PROFILE_NAME_LEN	16
+
+struct hmbird_tunable {
+	const char	*name;
+	int		*val;
+	int		min;
+	int		max;
+	void		(*apply)(int val);
+};
+
+static void hmbird_apply_frame_per_sec(int val)
+{
+	scx_set_ravg_window_fps(val);
+}
+
+static const struct hmbird_tunable hmbird_tunables[] = {
+	{ "cpuctrl_high",		&cpuctrl_high_ratio,	0, 100 },
+	{ "cpuctrl_low",		&cpuctrl_low_ratio,	0, 100 },
+	{ "slim_stats",			&slim_stats,		0, 1 },
+	{ "hmbirdcore_debug",		&hmbirdcore_debug,	0, INT_MAX },
+	{ "slim_for_app",		&slim_for_app,		0, INT_MAX },
+	{ "misfit_ds",			&misfit_ds,		0, 100 },
+	{ "scx_shadow_tick_enable",	(int *)&highres_tick_ctrl, 0, 1 },
+	{ "highres_tick_ctrl_dbg",	(int *)&highres_tick_ctrl_dbg, 0, 1 },
+	{ "cpu7_tl",			&cpu7_tl,		0, 100 },
+	{ "heartbeat_enable",		&heartbeat_enable,	0, 1 },
+	{ "watchdog_enable",		&watchdog_enable,	0, 1 },
+	{ "isolate_ctrl",		&isolate_ctrl,		0, 1 },
+	{ "parctrl_high_ratio",		&parctrl_high_ratio,	0, 100 },
+	{ "parctrl_low_ratio",		&parctrl_low_ratio,	0, 100 },
+	{ "parctrl_high_ratio_l",	&parctrl_high_ratio_l,	0, 100 },
+	{ "parctrl_low_ratio_l",	&parctrl_low_ratio_l,	0, 100 },
+	{ "isoctrl_high_ratio",		&isoctrl_high_ratio,	0, 100 },
+	{ "isoctrl_low_ratio",		&isoctrl_low_ratio,	0, 100 },
+	{ "iso_free_rescue",		&iso_free_rescue,	0, 1 },
+	{ "slim_walt_ctrl",		&slim_walt_ctrl,	0, 1 },
+	{ "slim_walt_dump",		&slim_walt_dump,	0, 1 },
+	{ "slim_walt_policy",		&slim_walt_policy,	0, 3 },
+	{ "frame_per_sec",		&sched_ravg_window_frame_per_sec,
+		SCX_RAVG_MIN_FPS, SCX_RAVG_MAX_FPS, hmbird_apply_frame_per_sec },
+	{ "slim_gov_debug",		&slim_gov_debug,	0, 1 },
+	{ "scx_gov_ctrl",		&scx_gov_ctrl,		0, 1 },
+	{ "dl_priq_ctrl",		&dl_priq_ctrl,		0, 1 },
+	{ "ux_inherit_ms",		&ux_inherit_ms,		0, 100 },
+};
+
+#define HMBIRD_NR_TUNABLES	ARRAY_SIZE(hmbird_tunables)
+
+struct hmbird_config {
+	int		val[HMBIRD_NR_TUNABLES];
+	unsigned long	set[BITS_TO_LONGS(HMBIRD_NR_TUNABLES)];
+};
+
+struct hmbird_profile {
+	char			name[HMBIRD_PROFILE_NAME_LEN];
+	struct hmbird_config	cfg;
+};
+
+static DEFINE_MUTEX(hmbird_config_mutex);
+static struct hmbird_profile hmbird_profiles[HMBIRD_MAX_PROFILES];
+static int hmbird_active_profile = -1;
+
+static int hmbird_find_tunable(const char *name)
+{
+	int i;
+
+	for (i = 0; i < HMBIRD_NR_TUNABLES; i++)
+		if (!strcmp(hmbird_tunables[i].name, name))
+			return i;
+	return -ENOENT;
+}
+
+/* parse "name=value" lines from @lines into @cfg, nothing is applied */
+static int hmbird_parse_config(char *lines, struct hmbird_config *cfg)
+{
+	char *line, *eq;
+	int idx, val, err;
+
+	memset(cfg, 0, sizeof(*cfg));
+
+	while ((line = strsep(&lines, "\n"))) {
+		line = strstrip(line);
+		if (!*line)
+			continue;
+
+		eq = strchr(line, '=');
+		if (!eq)
+			return -EINVAL;
+		*eq = '\0';
+
+		idx = hmbird_find_tunable(strstrip(line));
+		if (idx < 0)
+			return idx;
+
+		err = kstrtoint(strstrip(eq + 1), 0, &val);
+		if (err)
+			return err;
+
+		if (val < hmbird_tunables[idx].min ||
+		    val > hmbird_tunables[idx].max)
+			return -ERANGE;
+
+		cfg->val[idx] = val;
+		__set_bit(idx, cfg->set);
+	}
+
+	return 0;
+}
+
+static void hmbird_apply_config(const struct hmbird_config *cfg)
+{
+	int i;
+
+	lockdep_assert_held(&hmbird_config_mutex);
+
+	for_each_set_bit(i, cfg->set, HMBIRD_NR_TUNABLES) {
+		WRITE_ONCE(*hmbird_tunables[i].val, cfg->val[i]);
+		if (hmbird_tunables[i].apply)
+			hmbird_tunables[i].apply(cfg->val[i]);
+	}
+}
+
+static ssize_t hmbird_config_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct hmbird_config *cfg;
+	char *kbuf;
+	int err;
+
+	if (count >= PAGE_SIZE)
+		return -E2BIG;
+
+	kbuf = memdup_user_nul(buf, count);
+	if (IS_ERR(kbuf))
+		return PTR_ERR(kbuf);
+
+	cfg = kmalloc(sizeof(*cfg), GFP_KERNEL);
+	if (!cfg) {
+		kfree(kbuf);
+		return -ENOMEM;
+	}
+
+	err = hmbird_parse_config(kbuf, cfg);
+	if (!err) {
+		mutex_lock(&hmbird_config_mutex);
+		hmbird_apply_config(cfg);
+		hmbird_active_profile = -1;
+		mutex_unlock(&hmbird_config_mutex);
+	}
+
+	kfree(cfg);
+	kfree(kbuf);
+	return err ? err : count;
+}
+
+static int hmbird_config_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	for (i = 0; i < HMBIRD_NR_TUNABLES; i++)
+		seq_printf(m, "%s=%d\n", hmbird_tunables[i].name,
+			   READ_ONCE(*hmbird_tunables[i].val));
+	return 0;
+}
+
+static int hmbird_config_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hmbird_config_show, inode);
+}
+HMBIRD_PROC_OPS(hmbird_config, hmbird_config_open, hmbird_config_write);
+
+static int hmbird_find_profile(const char *name)
+{
+	int i;
+
+	for (i = 0; i < HMBIRD_MAX_PROFILES; i++)
+		if (!strcmp(hmbird_profiles[i].name, name))
+			return i;
+	return -ENOENT;
+}
+
+static ssize_t hmbird_profile_write(struct file *file, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct hmbird_config *cfg = NULL;
+	char *kbuf, *lines, *name;
+	int idx, err = 0;
+
+	if (count >= PAGE_SIZE)
+		return -E2BIG;
+
+	kbuf = memdup_user_nul(buf, count);
+	if (IS_ERR(kbuf))
+		return PTR_ERR(kbuf);
+
+	lines = kbuf;
+	name = strstrip(strsep(&lines, "\n"));
+	if (!*name || strlen(name) >= HMBIRD_PROFILE_NAME_LEN) {
+		err = -EINVAL;
+		goto out_free;
+	}
+
+	/* register if any "name=value" lines follow */
+	if (lines && *strstrip(lines)) {
+		cfg = kmalloc(sizeof(*cfg), GFP_KERNEL);
+		if (!cfg) {
+			err = -ENOMEM;
+			goto out_free;
+		}
+		err = hmbird_parse_config(lines, cfg);
+		if (err)
+			goto out_free;
+	}
+
+	mutex_lock(&hmbird_config_mutex);
+
+	idx = hmbird_find_profile(name);
+	if (cfg) {
+		if (idx < 0)
+			idx = hmbird_find_profile("");
+		if (idx < 0) {
+			err = -ENOSPC;
+		} else {
+			strscpy(hmbird_profiles[idx].name, name,
+				HMBIRD_PROFILE_NAME_LEN);
+			hmbird_profiles[idx].cfg = *cfg;
+			if (idx == hmbird_active_profile)
+				hmbird_apply_config(cfg);
+		}
+	} else if (idx < 0) {
+		err = idx;
+	} else {
+		hmbird_apply_config(&hmbird_profiles[idx].cfg);
+		hmbird_active_profile = idx;
+	}
+
+	mutex_unlock(&hmbird_config_mutex);
+out_free:
+	kfree(cfg);
+	kfree(kbuf);
+	return err ? err : count;
+}
+
+static int hmbird_profile_show(struct seq_file *m, void *v)
+{
+	int i;
+
+	mutex_lock(&hmbird_config_mutex);
+	for (i = 0; i < HMBIRD_MAX_PROFILES; i++) {
+		if (!hmbird_profiles[i].name[0])
+			continue;
+		seq_printf(m, "%c%s\n", i == hmbird_active_profile ? '*' : ' ',
+			   hmbird_profiles[i].name);
+	}
+	mutex_unlock(&hmbird_config_mutex);
+	return 0;
+}
+
+static int hmbird_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hmbird_profile_show, inode);
+}
+HMBIRD_PROC_OPS(hmbird_profile, hmbird_profile_open, hmbird_profile_write);
+/* config & profile ops end */
+
+/*
+ * Setting save_gov records each policy's governor and keeps it running
+ * across ext enable and disable, see scx_gov_in_handover(). Userspace no
+ * longer needs to switch governors on scene changes, which stops and
+ * restarts the governor and dips the frequency meanwhile.
+ */
 static ssize_t save_gov_str(struct file *file, const char __user *buf,
 					size_t count, loff_t *ppos)
 {
-	int cpu;
 	struct cpufreq_policy *policy;
+	int cpu, i;
+
+	if (set_proc_buf_val(file, buf, count, &save_gov))
+		return -EFAULT;
 
 	for_each_present_cpu(cpu) {
 		policy = cpufreq_cpu_get(cpu);
-		if (cpu != policy->cpu)
+		if (!policy)
 			continue;
+		if (cpu == policy->cpu) {
+			down_read(&policy->rwsem);
+			for_each_cpu(i, policy->related_cpus)
+				strscpy(per_cpu(saved_gov, i),
+					save_gov && policy->governor ?
+					policy->governor->name : "",
+					CPUFREQ_NAME_LEN);
+			up_read(&policy->rwsem);
+		}
+		cpufreq_cpu_put(policy);
 	}
 	return count;
 }
@@ -322,6 +672,32 @@ static int hmbird_proc_init(void)
 	HMBIRD_CREATE_PROC_ENTRY("hmbird_stats", HMBIRD_PROC_PERMISSION,
 					hmbird_dir,
 					&hmbird_stats_proc_ops);
+
+	HMBIRD_CREATE_PROC_ENTRY_DATA("dl_priq_ctrl", HMBIRD_PROC_PERMISSION,
+					hmbird_dir,
+					&hmbird_common_proc_ops,
+					&dl_priq_ctrl);
+
+	HMBIRD_CREATE_PROC_ENTRY_DATA("ux_inherit_ms", HMBIRD_PROC_PERMISSION,
+					hmbird_dir,
+					&hmbird_common_proc_ops,
+					&ux_inherit_ms);
+
+	HMBIRD_CREATE_PROC_ENTRY("config", HMBIRD_PROC_PERMISSION,
+					hmbird_dir,
+					&hmbird_config_proc_ops);
+
+	HMBIRD_CREATE_PROC_ENTRY("profile", HMBIRD_PROC_PERMISSION,
+					hmbird_dir,
+					&hmbird_profile_proc_ops);
+
+	HMBIRD_CREATE_PROC_ENTRY("sched_latency", HMBIRD_PROC_PERMISSION,
+					hmbird_dir,
+					&sched_latency_proc_ops);
+
+	HMBIRD_CREATE_PROC_ENTRY("dsq_stall_age", 0444,
+					hmbird_dir,
+					&dsq_stall_age_proc_ops);
 	/* /proc/hmbird_sched--end */
 
 	/* mkdir /proc/hmbird_sched/slim_walt */
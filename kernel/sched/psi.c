@@ -191,7 +191,11 @@ static void group_init(struct psi_group *group)
 	/* Init avg trigger-related members */
 	INIT_LIST_HEAD(&group->avg_triggers);
 	memset(group->avg_nr_triggers, 0, sizeof(group->avg_nr_triggers));
-	INIT_DELAYED_WORK(&group->avgs_work, psi_avgs_work);
+	/*
+	 * Averaging does not wake idle CPUs: missed periods are caught up
+	 * by the next run, or by psi_show() when somebody reads them.
+	 */
+	INIT_DEFERRABLE_WORK(&group->avgs_work, psi_avgs_work);
 
 	/* Init rtpoll trigger-related members */
 	atomic_set(&group->rtpoll_scheduled, 0);
@@ -794,6 +798,10 @@ static void psi_group_change(struct psi_group *group, int cpu,
 	lockdep_assert_rq_held(cpu_rq(cpu));
 	groupc = per_cpu_ptr(group->pcpu, cpu);
 
+	/* Groups with cgroup.pressure=0 don't track their tasks at all */
+	if (groupc->disabled)
+		return;
+
 	/*
 	 * First we update the task counts according to the state
 	 * change requested through the @clear and @set bits.
@@ -1215,35 +1223,85 @@ void cgroup_move_task(struct task_struct *task, struct css_set *to)
 	task_rq_unlock(rq, task, &rf);
 }
 
-void psi_cgroup_restart(struct psi_group *group)
-{
+struct psi_recount {
+	struct psi_group_cpu *groupc;
 	int cpu;
+	bool oncpu;
+};
 
-	/*
-	 * After we disable psi_group->enabled, we don't actually
-	 * stop percpu tasks accounting in each psi_group_cpu,
-	 * instead only stop test_state() loop, record_times()
-	 * and averaging worker, see psi_group_change() for details.
-	 *
-	 * When disable cgroup PSI, this function has nothing to sync
-	 * since cgroup pressure files are hidden and percpu psi_group_cpu
-	 * would see !psi_group->enabled and only do task accounting.
-	 *
-	 * When re-enable cgroup PSI, this function use psi_group_change()
-	 * to get correct state mask from test_state() loop on tasks[],
-	 * and restart groupc->state_start from now, use .clear = .set = 0
-	 * here since no task status really changed.
-	 */
-	if (!group->enabled)
+static void psi_recount_task(struct task_struct *task, void *data)
+{
+	struct psi_recount *rc = data;
+	unsigned int t;
+
+	if (!task->pid || task_cpu(task) != rc->cpu)
 		return;
 
+	for (t = 0; t < NR_PSI_TASK_COUNTS; t++)
+		if (task->psi_flags & (1 << t))
+			rc->groupc->tasks[t]++;
+	if (task->psi_flags & TSK_ONCPU)
+		rc->oncpu = true;
+}
+
+/**
+ * psi_cgroup_set_enabled - switch the pressure tracking of a cgroup
+ * @cgrp: the cgroup, with cgroup_mutex held
+ * @enable: new cgroup.pressure value
+ *
+ * A disabled group is skipped by the task state walks up the hierarchy,
+ * so that deep hierarchies only pay for the groups somebody watches. Its
+ * per-cpu task counts are dropped, and rebuilt from the tasks of the
+ * subtree when it is enabled again.
+ *
+ * Each CPU is switched with its rq lock held, which serializes against
+ * the walks for the tasks on that CPU, and with css_set_lock held, which
+ * keeps tasks from entering or leaving the subtree meanwhile. Both are
+ * dropped between CPUs, so that IRQs are not kept off for a walk of the
+ * subtree per CPU in one go: a task that migrates, or moves between
+ * cgroups, between a switched and a not yet switched CPU is accounted by
+ * its own dequeue and enqueue, or by cgroup_move_task(), like any other.
+ */
+void psi_cgroup_set_enabled(struct cgroup *cgrp, bool enable)
+{
+	struct psi_group *group = cgroup_psi(cgrp);
+	int cpu;
+
+	/* Stops time accounting and averaging before the counts go away */
+	group->enabled = enable;
+
 	for_each_possible_cpu(cpu) {
+		struct psi_group_cpu *groupc = per_cpu_ptr(group->pcpu, cpu);
 		struct rq *rq = cpu_rq(cpu);
 		struct rq_flags rf;
 
-		rq_lock_irq(rq, &rf);
-		psi_group_change(group, cpu, 0, 0, true);
-		rq_unlock_irq(rq, &rf);
+		spin_lock_irq(&css_set_lock);
+		rq_lock(rq, &rf);
+		if (enable) {
+			struct psi_recount rc = {
+				.groupc = groupc,
+				.cpu = cpu,
+			};
+
+			memset(groupc->tasks, 0, sizeof(groupc->tasks));
+			cgroup_subtree_for_each_task(cgrp, psi_recount_task, &rc);
+			groupc->disabled = false;
+			/* Rebuild state_mask and restart state_start */
+			psi_group_change(group, cpu, 0, rc.oncpu ? TSK_ONCPU : 0,
+					 true);
+		} else {
+			write_seqcount_begin(&groupc->seq);
+			if (groupc->state_mask & (1 << PSI_NONIDLE))
+				record_times(groupc, cpu_clock(cpu));
+			memset(groupc->tasks, 0, sizeof(groupc->tasks));
+			groupc->state_mask = 0;
+			groupc->disabled = true;
+			write_seqcount_end(&groupc->seq);
+		}
+		rq_unlock(rq, &rf);
+		spin_unlock_irq(&css_set_lock);
+
+		cond_resched();
 	}
 }
 #endif /* CONFIG_CGROUPS */
@@ -1537,6 +1595,33 @@ static int psi_cpu_open(struct inode *inode, struct file *file)
 	return single_open(file, psi_cpu_show, NULL);
 }
 
+/*
+ * Same as pressure/memory, with the kill candidates ranked by the oom killer
+ * appended, so that a reader woken by a trigger has them at hand.
+ */
+static int psi_memory_candidates_show(struct seq_file *m, void *v)
+{
+	int ret;
+
+	ret = psi_show(m, &psi_system, PSI_MEM);
+	if (!ret)
+		oom_candidates_show(m);
+	return ret;
+}
+
+static int psi_memory_candidates_open(struct inode *inode, struct file *file)
+{
+	int ret;
+
+	if (!capable(CAP_KILL))
+		return -EPERM;
+
+	ret = single_open(file, psi_memory_candidates_show, NULL);
+	if (!ret)
+		oom_candidates_get();
+	return ret;
+}
+
 static ssize_t psi_write(struct file *file, const char __user *user_buf,
 			 size_t nbytes, enum psi_res res)
 {
@@ -1631,6 +1716,21 @@ static const struct proc_ops psi_memory_proc_ops = {
 	.proc_release	= psi_fop_release,
 };
 
+static int psi_memory_candidates_release(struct inode *inode, struct file *file)
+{
+	oom_candidates_put();
+	return psi_fop_release(inode, file);
+}
+
+static const struct proc_ops psi_memory_candidates_proc_ops = {
+	.proc_open	= psi_memory_candidates_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_write	= psi_memory_write,
+	.proc_poll	= psi_fop_poll,
+	.proc_release	= psi_memory_candidates_release,
+};
+
 static const struct proc_ops psi_cpu_proc_ops = {
 	.proc_open	= psi_cpu_open,
 	.proc_read	= seq_read,
@@ -1673,6 +1773,8 @@ static int __init psi_proc_init(void)
 		proc_mkdir("pressure", NULL);
 		proc_create("pressure/io", 0, NULL, &psi_io_proc_ops);
 		proc_create("pressure/memory", 0, NULL, &psi_memory_proc_ops);
+		proc_create("pressure/memory_candidates", 0, NULL,
+			    &psi_memory_candidates_proc_ops);
 		proc_create("pressure/cpu", 0, NULL, &psi_cpu_proc_ops);
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
 		proc_create("pressure/irq", 0, NULL, &psi_irq_proc_ops);
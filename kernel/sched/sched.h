@@ -436,6 +436,13 @@ struct task_group {
 
 	struct cfs_bandwidth	cfs_bandwidth;
 
+	/* Timer slack floor requested for the group's tasks, 0 for none */
+	u64			timer_slack_ns;
+	/* Largest timer_slack_ns of the group and its ancestors */
+	u64			timer_slack_eff;
+	/* Timers whose slack was raised to timer_slack_eff, per CPU */
+	unsigned long __percpu	*timer_slack_raised;
+
 #ifdef CONFIG_UCLAMP_TASK_GROUP
 	/* The two decimal precision [%] value requested from user-space */
 	unsigned int		uclamp_pct[UCLAMP_CNT];
@@ -704,6 +711,7 @@ struct cfs_rq {
 /* scx_rq->flags, protected by the rq lock */
 enum scx_rq_flags {
 	SCX_RQ_CAN_STOP_TICK	= 1 << 0,
+	SCX_RQ_HRTICK_ARMED	= 1 << 1, /* see scx_hrtick_start() */
 };
 
 struct scx_rq {
@@ -720,6 +728,7 @@ struct scx_rq {
 	u64			pnt_seq;
 	struct irq_work		kick_cpus_irq_work;
 	struct rq               *rq;
+	struct scx_sched_rq_stats srq;		/* see slim_walt.c */
 };
 #endif /* CONFIG_SCHED_CLASS_EXT */
 
@@ -4,7 +4,5 @@
 extern unsigned int highres_tick_ctrl;
 extern unsigned int highres_tick_ctrl_dbg;
 
-extern noinline int tracing_mark_write(const char *buf);
-
 
 #endif
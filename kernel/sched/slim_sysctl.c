@@ -11,13 +11,6 @@ unsigned int highres_tick_ctrl_dbg;
 #define SLIM_SCHED_DIR		"slim_sched"
 
 
-noinline int tracing_mark_write(const char *buf)
-{
-        trace_printk(buf);
-        return 0;
-}
-
-
 static char *files_name[] = {
 	HIGHRES_TICK_CTRL,
 	HIGHRES_TICK_CTRL_DBG,
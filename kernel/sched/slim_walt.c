@@ -0,0 +1,488 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Windowed load tracking for the ext scheduler class.
+ *
+ * PELT decays too slowly for frame-driven workloads. Instead, execution time is
+ * accumulated over fixed windows derived from sched_ravg_window_frame_per_sec
+ * and a task's demand is computed from its last RAVG_HIST_SIZE windows
+ * following slim_walt_policy. Each rq also keeps the busy time of its current
+ * and previous windows in curr/prev_runnable_sum.
+ *
+ * All busy time is normalized to the capacity of the biggest CPU running at its
+ * maximum frequency so that demand can be compared across clusters.
+ *
+ * Included from ext.c. Everything is protected by the rq lock.
+ */
+
+enum task_event {
+	PUT_PREV_TASK	= 0,
+	PICK_NEXT_TASK	= 1,
+	TASK_WAKE	= 2,
+	TASK_MIGRATE	= 3,
+	TASK_UPDATE	= 4,
+	IRQ_UPDATE	= 5,
+};
+
+/* slim_walt_policy */
+enum {
+	WINDOW_STATS_RECENT		= 0,
+	WINDOW_STATS_MAX		= 1,
+	WINDOW_STATS_MAX_RECENT_AVG	= 2,
+	WINDOW_STATS_AVG		= 3,
+	WINDOW_STATS_INVALID_POLICY,
+};
+
+#define SCX_RAVG_MIN_FPS	30
+#define SCX_RAVG_MAX_FPS	240
+
+/*
+ * Window boundaries are at scx_ravg_epoch + N * sched_ravg_window for all rqs.
+ * When the window size changes, the new size takes effect at the next window
+ * boundary, which becomes the new epoch. Each rq switches over on its first
+ * rollover after the epoch, so per-rq stats never straddle two window sizes.
+ */
+static u32 sched_ravg_window = NSEC_PER_SEC / 125;
+static u64 scx_ravg_epoch;
+static DEFINE_RAW_SPINLOCK(scx_ravg_window_lock);
+static seqcount_raw_spinlock_t scx_ravg_window_seq =
+	SEQCNT_RAW_SPINLOCK_ZERO(scx_ravg_window_seq, &scx_ravg_window_lock);
+
+static u32 scx_ravg_window_from_fps(int fps)
+{
+	return NSEC_PER_SEC / clamp(fps, SCX_RAVG_MIN_FPS, SCX_RAVG_MAX_FPS);
+}
+
+static void scx_ravg_window_read(u64 *epoch, u32 *window)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqcount_begin(&scx_ravg_window_seq);
+		*epoch = scx_ravg_epoch;
+		*window = sched_ravg_window;
+	} while (read_seqcount_retry(&scx_ravg_window_seq, seq));
+}
+
+/**
+ * scx_set_ravg_window_fps - Change the window size at runtime
+ * @fps: frame rate the windows should follow
+ *
+ * Windows are resized to 1/@fps seconds starting from the next window boundary
+ * so that windows stay aligned with frames across all CPUs.
+ */
+static void scx_set_ravg_window_fps(int fps)
+{
+	u32 window = scx_ravg_window_from_fps(fps);
+	unsigned long flags;
+	u64 now;
+
+	raw_spin_lock_irqsave(&scx_ravg_window_lock, flags);
+	write_seqcount_begin(&scx_ravg_window_seq);
+
+	now = sched_clock();
+	if (now >= scx_ravg_epoch)
+		scx_ravg_epoch += (div64_u64(now - scx_ravg_epoch,
+					     sched_ravg_window) + 1) *
+				  sched_ravg_window;
+	sched_ravg_window = window;
+
+	write_seqcount_end(&scx_ravg_window_seq);
+	raw_spin_unlock_irqrestore(&scx_ravg_window_lock, flags);
+}
+
+static inline bool slim_walt_enabled(void)
+{
+	return READ_ONCE(slim_walt_ctrl);
+}
+
+/* scale @delta by the current capacity and frequency of @rq's CPU */
+static u64 scale_exec_time(u64 delta, struct rq *rq)
+{
+	return (delta * rq->scx->srq.task_exec_scale) >> SCHED_CAPACITY_SHIFT;
+}
+
+static void update_task_exec_scale(struct rq *rq)
+{
+	int cpu = cpu_of(rq);
+
+	rq->scx->srq.task_exec_scale =
+		(arch_scale_cpu_capacity(cpu) * arch_scale_freq_capacity(cpu)) >>
+		SCHED_CAPACITY_SHIFT;
+}
+
+/**
+ * rollover_rq_window - Advance @rq's window if @wallclock went past it
+ * @rq: rq to update
+ * @wallclock: current time
+ *
+ * The busy time of the window that just ended moves to prev_runnable_sum. If
+ * more than one window elapsed, the CPU didn't run any ext task in the last one
+ * and prev_runnable_sum is cleared. A pending window size change is applied
+ * here once @wallclock reaches its epoch.
+ *
+ * Returns %true if a new window was started.
+ */
+static bool rollover_rq_window(struct rq *rq, u64 wallclock)
+{
+	struct scx_sched_rq_stats *srq = &rq->scx->srq;
+	u64 epoch, window_start;
+	u32 window;
+
+	if (unlikely(wallclock < srq->window_start))
+		return false;
+
+	scx_ravg_window_read(&epoch, &window);
+
+	if (wallclock >= epoch) {
+		window_start = epoch + window * div64_u64(wallclock - epoch, window);
+	} else {
+		window = srq->window_size;
+		window_start = srq->window_start +
+			window * div64_u64(wallclock - srq->window_start, window);
+	}
+
+	if (window_start <= srq->window_start)
+		return false;
+
+	if (srq->window_start + srq->window_size == window_start)
+		srq->prev_runnable_sum = srq->curr_runnable_sum;
+	else
+		srq->prev_runnable_sum = 0;
+	srq->curr_runnable_sum = 0;
+	srq->prev_window_size = window_start - srq->window_start > srq->window_size ?
+				window : srq->window_size;
+	srq->window_size = window;
+	srq->window_start = window_start;
+
+	return true;
+}
+
+static u32 task_demand_from_history(struct scx_sched_task_stats *sts)
+{
+	u32 max = 0, avg, sum = 0;
+	int i;
+
+	for (i = 0; i < RAVG_HIST_SIZE; i++) {
+		sum += sts->sum_history[i];
+		max = max(max, sts->sum_history[i]);
+	}
+	avg = sum / RAVG_HIST_SIZE;
+
+	switch (READ_ONCE(slim_walt_policy)) {
+	case WINDOW_STATS_RECENT:
+		return sts->sum_history[0];
+	case WINDOW_STATS_MAX:
+		return max;
+	case WINDOW_STATS_AVG:
+		return avg;
+	case WINDOW_STATS_MAX_RECENT_AVG:
+	default:
+		return max(avg, sts->sum_history[0]);
+	}
+}
+
+/*
+ * Each rq counts its runnable ext tasks in SCX_TOP_TASK_BUCKETS buckets of
+ * demand_scaled so that the heaviest one can be found in O(1) from the bitmap
+ * of non-empty buckets. A task is counted while it's queued on the rq and
+ * moves between buckets as its demand changes at window rollovers.
+ */
+static int top_task_bucket(u16 demand_scaled)
+{
+	return min_t(int, (demand_scaled * SCX_TOP_TASK_BUCKETS) >>
+		     SCHED_CAPACITY_SHIFT, SCX_TOP_TASK_BUCKETS - 1);
+}
+
+static void scx_top_task_add(struct rq *rq, struct task_struct *p)
+{
+	struct scx_sched_rq_stats *srq = &rq->scx->srq;
+	int bucket = top_task_bucket(p->scx->sts.demand_scaled);
+
+	lockdep_assert_rq_held(rq);
+
+	if (WARN_ON_ONCE(p->scx->sts.top_bucket))
+		return;
+
+	if (!srq->top_tasks[bucket]++)
+		srq->top_tasks_bitmap |= 1U << bucket;
+	p->scx->sts.top_bucket = bucket + 1;
+}
+
+static void scx_top_task_del(struct rq *rq, struct task_struct *p)
+{
+	struct scx_sched_rq_stats *srq = &rq->scx->srq;
+	int bucket = p->scx->sts.top_bucket - 1;
+
+	lockdep_assert_rq_held(rq);
+
+	if (bucket < 0)
+		return;
+
+	if (!WARN_ON_ONCE(!srq->top_tasks[bucket]) && !--srq->top_tasks[bucket])
+		srq->top_tasks_bitmap &= ~(1U << bucket);
+	p->scx->sts.top_bucket = 0;
+}
+
+/**
+ * scx_cpu_top_util - Demand of the heaviest runnable ext task on a CPU
+ * @cpu: CPU of interest
+ *
+ * Return the upper edge of the highest non-empty top-task bucket in capacity
+ * units, 0 if no ext task is runnable. Racy read of a single word.
+ */
+unsigned long scx_cpu_top_util(int cpu)
+{
+	u32 bitmap = READ_ONCE(cpu_rq(cpu)->scx->srq.top_tasks_bitmap);
+
+	if (!bitmap)
+		return 0;
+
+	return min_t(unsigned long,
+		     (fls(bitmap) << SCHED_CAPACITY_SHIFT) / SCX_TOP_TASK_BUCKETS,
+		     arch_scale_cpu_capacity(cpu));
+}
+
+/* push @samples windows worth of @runtime into @p's history */
+static void update_history(struct task_struct *p, struct rq *rq,
+			   u32 runtime, int samples)
+{
+	struct scx_sched_task_stats *sts = &p->scx->sts;
+	u32 *hist = sts->sum_history;
+	int i;
+
+	if (!samples)
+		return;
+
+	samples = min(samples, RAVG_HIST_SIZE);
+	for (i = RAVG_HIST_SIZE - 1; i >= samples; i--)
+		hist[i] = hist[i - samples];
+	for (i = 0; i < samples; i++)
+		hist[i] = runtime;
+
+	sts->demand = task_demand_from_history(sts);
+	sts->demand_scaled = min_t(u64, SCHED_CAPACITY_SCALE,
+				   div64_u64((u64)sts->demand << SCHED_CAPACITY_SHIFT,
+					     rq->scx->srq.window_size));
+
+	if (sts->top_bucket &&
+	    sts->top_bucket - 1 != top_task_bucket(sts->demand_scaled)) {
+		scx_top_task_del(rq, p);
+		scx_top_task_add(rq, p);
+	}
+}
+
+static bool account_busy_for_task_demand(struct task_struct *p,
+					 struct rq *rq, int event)
+{
+	/* time since the last update was spent waiting or sleeping */
+	if (event == PICK_NEXT_TASK || event == TASK_WAKE)
+		return false;
+
+	return task_current(rq, p);
+}
+
+/**
+ * update_task_demand - Account @p's busy time since its last update
+ * @p: task to update
+ * @rq: rq @p is on
+ * @event: TASK_* event triggering the update
+ * @wallclock: current time
+ *
+ * Split the time between @p's mark_start and @wallclock at window boundaries.
+ * Completed windows are pushed into @p's history. A task which wasn't running
+ * only closes its partial window so that sleeping doesn't decay its demand.
+ */
+static void update_task_demand(struct task_struct *p, struct rq *rq,
+			       int event, u64 wallclock)
+{
+	struct scx_sched_task_stats *sts = &p->scx->sts;
+	struct scx_sched_rq_stats *srq = &rq->scx->srq;
+	u64 mark_start = sts->mark_start;
+	u64 window_start = srq->window_start;
+	u32 window = srq->window_size;
+	bool busy = account_busy_for_task_demand(p, rq, event);
+	u64 nr_full_windows, window_end;
+
+	/* a freshly migrated task may carry a window of a CPU running ahead */
+	if (unlikely(sts->window_start > window_start))
+		sts->window_start = window_start;
+
+	/* still within the same window */
+	if (sts->window_start == window_start) {
+		if (busy)
+			sts->sum += scale_exec_time(wallclock - mark_start, rq);
+		return;
+	}
+
+	if (!busy) {
+		update_history(p, rq, sts->sum, 1);
+		sts->sum = 0;
+		sts->window_start = window_start;
+		return;
+	}
+
+	/*
+	 * Close the window which contained mark_start. It may have had the
+	 * previous window size if the size was changed in between.
+	 */
+	window_end = sts->window_start + srq->prev_window_size;
+	if (window_end > window_start || window_end < mark_start)
+		window_end = window_start;
+	sts->sum += scale_exec_time(window_end - mark_start, rq);
+	update_history(p, rq, sts->sum, 1);
+
+	/* fully busy windows in between */
+	nr_full_windows = div64_u64(window_start - window_end, window);
+	if (nr_full_windows)
+		update_history(p, rq, scale_exec_time(window, rq),
+			       min_t(u64, nr_full_windows, RAVG_HIST_SIZE));
+
+	/* and the head of the current one */
+	sts->sum = scale_exec_time(wallclock - window_start, rq);
+	sts->window_start = window_start;
+}
+
+/* account @p's busy time since mark_start to @rq's prev and curr windows */
+static void update_cpu_busy_time(struct task_struct *p, struct rq *rq,
+				 int event, u64 wallclock)
+{
+	struct scx_sched_rq_stats *srq = &rq->scx->srq;
+	u64 mark_start = p->scx->sts.mark_start;
+	u64 window_start = srq->window_start;
+	u64 prev_window_start = window_start > srq->prev_window_size ?
+				window_start - srq->prev_window_size : 0;
+
+	if (!account_busy_for_task_demand(p, rq, event))
+		return;
+
+	if (mark_start < window_start)
+		srq->prev_runnable_sum +=
+			scale_exec_time(window_start -
+					max(mark_start, prev_window_start), rq);
+
+	srq->curr_runnable_sum +=
+		scale_exec_time(wallclock - max(mark_start, window_start), rq);
+}
+
+/**
+ * scx_update_task_ravg - Update windowed load statistics of a task and its rq
+ * @p: task to update
+ * @rq: rq @p is on, must be locked
+ * @event: TASK_* event triggering the update
+ * @wallclock: current rq clock
+ */
+static void scx_update_task_ravg(struct task_struct *p, struct rq *rq,
+				 int event, u64 wallclock)
+{
+	struct scx_sched_rq_stats *srq = &rq->scx->srq;
+
+	lockdep_assert_rq_held(rq);
+
+	if (!slim_walt_enabled() || is_idle_task(p))
+		return;
+
+	/* the rq clock can be observed going backwards across CPUs */
+	if (unlikely(wallclock < srq->latest_clock))
+		wallclock = srq->latest_clock;
+	srq->latest_clock = wallclock;
+
+	if (unlikely(!p->scx->sts.mark_start)) {
+		p->scx->sts.mark_start = wallclock;
+		p->scx->sts.window_start = srq->window_start;
+		return;
+	}
+
+	if (rollover_rq_window(rq, wallclock)) {
+		trace_sched_ext_window_rollover(cpu_of(rq), srq->window_start,
+						srq->window_size,
+						srq->prev_runnable_sum);
+		/* let the governor see the completed window right away */
+		if (scx_gov_util_enabled())
+			cpufreq_update_util(rq, 0);
+		scx_iso_update(rq);
+	}
+	update_task_exec_scale(rq);
+
+	if (unlikely(wallclock <= p->scx->sts.mark_start ||
+		     wallclock < srq->window_start))
+		goto done;
+
+	update_cpu_busy_time(p, rq, event, wallclock);
+	update_task_demand(p, rq, event, wallclock);
+done:
+	p->scx->sts.mark_start = wallclock;
+}
+
+static void scx_sched_init_task(struct task_struct *p)
+{
+	memset(&p->scx->sts, 0, sizeof(p->scx->sts));
+}
+
+/**
+ * scx_cpu_util - Windowed utilization of a CPU for frequency selection
+ * @cpu: CPU of interest
+ *
+ * Return the busy time of @cpu's last complete window, or of the current one
+ * if it's already larger, in capacity units. Used by schedutil in place of the
+ * CFS utilization if scx_gov_ctrl is set. Reads are racy but self-correcting.
+ */
+unsigned long scx_cpu_util(int cpu)
+{
+	struct scx_sched_rq_stats *srq = &cpu_rq(cpu)->scx->srq;
+	u32 window = READ_ONCE(srq->window_size);
+	u64 busy;
+
+	if (unlikely(!window))
+		return 0;
+
+	/* the CPU has been idle since a whole window, nothing to report */
+	if (sched_clock() > READ_ONCE(srq->window_start) + 2 * (u64)window)
+		return 0;
+
+	busy = max(READ_ONCE(srq->prev_runnable_sum),
+		   READ_ONCE(srq->curr_runnable_sum));
+
+	return min_t(u64, div64_u64(busy << SCHED_CAPACITY_SHIFT, window),
+		     arch_scale_cpu_capacity(cpu));
+}
+
+/**
+ * slim_walt_enable - Reset windowed load tracking
+ * @enable: whether the BPF scheduler is being enabled
+ *
+ * Align the window of every rq to the current time and clear the accumulated
+ * busy time. Called from the enable path before tasks are switched.
+ */
+static void slim_walt_enable(bool enable)
+{
+	unsigned long flags;
+	u64 now;
+	int cpu;
+
+	if (!enable)
+		return;
+
+	raw_spin_lock_irqsave(&scx_ravg_window_lock, flags);
+	write_seqcount_begin(&scx_ravg_window_seq);
+	now = sched_clock();
+	scx_ravg_epoch = now;
+	sched_ravg_window =
+		scx_ravg_window_from_fps(READ_ONCE(sched_ravg_window_frame_per_sec));
+	write_seqcount_end(&scx_ravg_window_seq);
+	raw_spin_unlock_irqrestore(&scx_ravg_window_lock, flags);
+
+	for_each_possible_cpu(cpu) {
+		struct rq *rq = cpu_rq(cpu);
+		struct scx_sched_rq_stats *srq = &rq->scx->srq;
+
+		raw_spin_rq_lock_irqsave(rq, flags);
+		srq->window_start = now;
+		srq->window_size = sched_ravg_window;
+		srq->prev_window_size = sched_ravg_window;
+		srq->latest_clock = 0;
+		srq->prev_runnable_sum = 0;
+		srq->curr_runnable_sum = 0;
+		update_task_exec_scale(rq);
+		raw_spin_rq_unlock_irqrestore(rq, flags);
+	}
+}
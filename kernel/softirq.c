@@ -27,6 +27,8 @@
 #include <linux/tick.h>
 #include <linux/irq.h>
 #include <linux/wait_bit.h>
+#include <linux/sched/clock.h>
+#include <linux/ctype.h>
 
 #include <asm/softirq_stack.h>
 
@@ -545,6 +547,87 @@ static __u32 softirq_deferred_for_rt(__u32 *pending)
 #define softirq_deferred_for_rt(x) (0)
 #endif
 
+#ifdef CONFIG_SOFTIRQ_TYPE_THREADS
+/*
+ * Softirq types selected with softirq_threads= do not run from
+ * __do_softirq() at all. Their pending bit is moved to a per CPU mask and
+ * they run in a dedicated per CPU thread, one per type, which is an ordinary
+ * SCHED_NORMAL task the scheduler can place and weigh against everything
+ * else. This keeps, e.g., a NET_RX flood from delaying BLOCK completions
+ * behind it on the same CPU.
+ */
+struct softirq_type_threads {
+	struct task_struct	*tsk[NR_SOFTIRQS];
+	u32			pending;
+};
+
+static DEFINE_PER_CPU(struct softirq_type_threads, softirq_type_threads);
+static DEFINE_PER_CPU(u64 [NR_SOFTIRQS], softirq_time);
+
+/* Types the user asked for, and the ones which actually have threads */
+static u32 softirq_threads_requested __initdata;
+static u32 softirq_threaded_mask __read_mostly;
+static int softirq_type_nice[NR_SOFTIRQS];
+
+/*
+ * Divert the threaded types out of @pending to their threads. Must be
+ * called with interrupts disabled. Returns what is left for the caller.
+ */
+static u32 softirq_divert_threaded(u32 pending)
+{
+	struct softirq_type_threads *st;
+	u32 threaded, new;
+	unsigned int nr;
+
+	threaded = pending & READ_ONCE(softirq_threaded_mask);
+	if (likely(!threaded))
+		return pending;
+
+	set_softirq_pending(local_softirq_pending() & ~threaded);
+
+	st = this_cpu_ptr(&softirq_type_threads);
+	new = threaded & ~st->pending;
+	st->pending |= threaded;
+
+	while ((nr = ffs(new))) {
+		nr--;
+		new &= ~BIT(nr);
+		/* Not spawned yet on this CPU, it runs the work once it is */
+		if (st->tsk[nr])
+			wake_up_process(st->tsk[nr]);
+	}
+
+	return pending & ~threaded;
+}
+
+static inline u64 softirq_time_start(void)
+{
+	return local_clock();
+}
+
+static inline void softirq_time_account(unsigned int nr, u64 start)
+{
+	__this_cpu_add(softirq_time[nr], local_clock() - start);
+}
+
+u64 kstat_softirq_time_cpu(unsigned int irq, int cpu)
+{
+	return per_cpu(softirq_time, cpu)[irq];
+}
+#else
+static inline u32 softirq_divert_threaded(u32 pending)
+{
+	return pending;
+}
+
+static inline u64 softirq_time_start(void)
+{
+	return 0;
+}
+
+static inline void softirq_time_account(unsigned int nr, u64 start) { }
+#endif /* CONFIG_SOFTIRQ_TYPE_THREADS */
+
 asmlinkage __visible void __softirq_entry __do_softirq(void)
 {
 	unsigned long end = jiffies + MAX_SOFTIRQ_TIME;
@@ -565,6 +648,7 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 
 	pending = local_softirq_pending();
 	deferred = softirq_deferred_for_rt(&pending);
+	pending = softirq_divert_threaded(pending);
 
 	softirq_handle_begin();
 
@@ -583,6 +667,7 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 	while ((softirq_bit = ffs(pending))) {
 		unsigned int vec_nr;
 		int prev_count;
+		u64 start;
 
 		h += softirq_bit - 1;
 
@@ -591,9 +676,11 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 
 		kstat_incr_softirqs_this_cpu(vec_nr);
 
+		start = softirq_time_start();
 		trace_softirq_entry(vec_nr);
 		h->action(h);
 		trace_softirq_exit(vec_nr);
+		softirq_time_account(vec_nr, start);
 		if (unlikely(prev_count != preempt_count())) {
 			pr_err("huh, entered softirq %u %s %p with preempt_count %08x, exited with %08x?\n",
 			       vec_nr, softirq_to_name[vec_nr], h->action,
@@ -613,6 +700,7 @@ asmlinkage __visible void __softirq_entry __do_softirq(void)
 
 	pending = local_softirq_pending();
 	deferred = softirq_deferred_for_rt(&pending);
+	pending = softirq_divert_threaded(pending);
 
 	if (pending) {
 		if (time_before(jiffies, end) && !need_resched() &&
@@ -972,6 +1060,154 @@ static void run_ksoftirqd(unsigned int cpu)
 	ksoftirqd_run_end();
 }
 
+#ifdef CONFIG_SOFTIRQ_TYPE_THREADS
+/*
+ * softirq_threads=NET_RX,BLOCK:-5 moves NET_RX and BLOCK processing into
+ * per CPU threads, the BLOCK ones at nice -5.
+ */
+static int __init softirq_threads_setup(char *str)
+{
+	char *tok, *name;
+	unsigned int nr;
+	int nice;
+
+	while ((tok = strsep(&str, ","))) {
+		name = strsep(&tok, ":");
+		for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+			if (!strcasecmp(name, softirq_to_name[nr]))
+				break;
+		}
+		if (nr == NR_SOFTIRQS) {
+			pr_warn("softirq_threads: unknown type '%s'\n", name);
+			continue;
+		}
+
+		nice = 0;
+		if (tok && kstrtoint(tok, 0, &nice))
+			pr_warn("softirq_threads: bad nice value for %s\n", name);
+		softirq_type_nice[nr] = clamp(nice, MIN_NICE, MAX_NICE);
+		softirq_threads_requested |= BIT(nr);
+	}
+	return 1;
+}
+__setup("softirq_threads=", softirq_threads_setup);
+
+static unsigned int softirq_type_current(void)
+{
+	struct softirq_type_threads *st = this_cpu_ptr(&softirq_type_threads);
+	unsigned int nr;
+
+	for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+		if (st->tsk[nr] == current)
+			break;
+	}
+	WARN_ON_ONCE(nr == NR_SOFTIRQS);
+	return nr;
+}
+
+static int softirq_type_should_run(unsigned int cpu)
+{
+	return __this_cpu_read(softirq_type_threads.pending) &
+	       BIT(softirq_type_current());
+}
+
+static void softirq_type_setup(unsigned int cpu)
+{
+	set_user_nice(current, softirq_type_nice[softirq_type_current()]);
+}
+
+static void run_softirq_type(unsigned int cpu)
+{
+	unsigned int nr = softirq_type_current();
+	unsigned long old_flags = current->flags;
+	struct softirq_action *h = &softirq_vec[nr];
+	bool in_hardirq;
+	u64 start;
+
+	local_irq_disable();
+	if (!(__this_cpu_read(softirq_type_threads.pending) & BIT(nr))) {
+		local_irq_enable();
+		return;
+	}
+	__this_cpu_and(softirq_type_threads.pending, ~BIT(nr));
+
+	current->flags &= ~PF_MEMALLOC;
+	softirq_handle_begin();
+	in_hardirq = lockdep_softirq_start();
+	local_irq_enable();
+
+	kstat_incr_softirqs_this_cpu(nr);
+	start = softirq_time_start();
+	trace_softirq_entry(nr);
+	h->action(h);
+	trace_softirq_exit(nr);
+	softirq_time_account(nr, start);
+	rcu_softirq_qs();
+
+	local_irq_disable();
+	lockdep_softirq_end(in_hardirq);
+	softirq_handle_end();
+	local_irq_enable();
+	current_restore_flags(old_flags, PF_MEMALLOC);
+
+	/* The handler may have raised other types, or re-raised its own */
+	if (local_softirq_pending())
+		do_softirq();
+
+	cond_resched();
+}
+
+static struct smp_hotplug_thread softirq_type_hp_threads[NR_SOFTIRQS];
+static char softirq_type_comm[NR_SOFTIRQS][TASK_COMM_LEN];
+
+static __init void spawn_softirq_type_threads(void)
+{
+	struct smp_hotplug_thread *ht;
+	unsigned int nr;
+	char *p;
+
+	for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+		if (!(softirq_threads_requested & BIT(nr)))
+			continue;
+
+		snprintf(softirq_type_comm[nr], TASK_COMM_LEN, "sirq-%s/%%u",
+			 softirq_to_name[nr]);
+		for (p = softirq_type_comm[nr]; *p; p++)
+			*p = tolower(*p);
+
+		ht = &softirq_type_hp_threads[nr];
+		ht->store		= &softirq_type_threads.tsk[nr];
+		ht->thread_should_run	= softirq_type_should_run;
+		ht->thread_fn		= run_softirq_type;
+		ht->setup		= softirq_type_setup;
+		ht->thread_comm		= softirq_type_comm[nr];
+
+		if (smpboot_register_percpu_thread(ht)) {
+			pr_err("failed to spawn %s threads\n", softirq_to_name[nr]);
+			continue;
+		}
+		softirq_threaded_mask |= BIT(nr);
+	}
+}
+
+/* Hand the threaded work of a dead CPU back to this one */
+static void takeover_softirq_types(unsigned int cpu)
+{
+	u32 pending = per_cpu(softirq_type_threads.pending, cpu);
+	unsigned int nr;
+
+	per_cpu(softirq_type_threads.pending, cpu) = 0;
+	while ((nr = ffs(pending))) {
+		nr--;
+		pending &= ~BIT(nr);
+		raise_softirq_irqoff(nr);
+	}
+}
+#else
+static inline void spawn_softirq_type_threads(void) { }
+static inline void takeover_softirq_types(unsigned int cpu) { }
+#endif /* CONFIG_SOFTIRQ_TYPE_THREADS */
+
 #ifdef CONFIG_HOTPLUG_CPU
 static int takeover_tasklets(unsigned int cpu)
 {
@@ -995,6 +1231,8 @@ static int takeover_tasklets(unsigned int cpu)
 	}
 	raise_softirq_irqoff(HI_SOFTIRQ);
 
+	takeover_softirq_types(cpu);
+
 	local_irq_enable();
 	return 0;
 }
@@ -1014,6 +1252,7 @@ static __init int spawn_ksoftirqd(void)
 	cpuhp_setup_state_nocalls(CPUHP_SOFTIRQ_DEAD, "softirq:dead", NULL,
 				  takeover_tasklets);
 	BUG_ON(smpboot_register_percpu_thread(&softirq_threads));
+	spawn_softirq_type_threads();
 
 	return 0;
 }
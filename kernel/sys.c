@@ -38,6 +38,7 @@
 #include <linux/personality.h>
 #include <linux/ptrace.h>
 #include <linux/fs_struct.h>
+#include <linux/futex.h>
 #include <linux/file.h>
 #include <linux/mount.h>
 #include <linux/gfp.h>
@@ -2745,6 +2746,27 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 		error = !!test_bit(MMF_VM_MERGE_ANY, &me->mm->flags);
 		break;
 #endif
+	case PR_FUTEX_HASH:
+		if (arg4 || arg5)
+			return -EINVAL;
+		error = futex_hash_prctl(arg2, arg3);
+		break;
+	case PR_SET_FORK_LAZY_PTES:
+		if (arg3 || arg4 || arg5)
+			return -EINVAL;
+		if (mmap_write_lock_killable(me->mm))
+			return -EINTR;
+		if (arg2)
+			set_bit(MMF_FORK_LAZY_PTES, &me->mm->flags);
+		else
+			clear_bit(MMF_FORK_LAZY_PTES, &me->mm->flags);
+		mmap_write_unlock(me->mm);
+		break;
+	case PR_GET_FORK_LAZY_PTES:
+		if (arg2 || arg3 || arg4 || arg5)
+			return -EINVAL;
+		error = !!test_bit(MMF_FORK_LAZY_PTES, &me->mm->flags);
+		break;
 	case PR_RISCV_V_SET_CONTROL:
 		error = RISCV_V_SET_CONTROL(arg2);
 		break;
@@ -87,6 +87,8 @@ COND_SYSCALL_COMPAT(set_robust_list);
 COND_SYSCALL(get_robust_list);
 COND_SYSCALL_COMPAT(get_robust_list);
 COND_SYSCALL(futex_waitv);
+COND_SYSCALL(futex_wake);
+COND_SYSCALL(futex_wait);
 COND_SYSCALL(kexec_load);
 COND_SYSCALL_COMPAT(kexec_load);
 COND_SYSCALL(init_module);
@@ -238,6 +240,7 @@ COND_SYSCALL_COMPAT(process_vm_writev);
 COND_SYSCALL(kcmp);
 
 COND_SYSCALL(finit_module);
+COND_SYSCALL(finit_module_batch);
 
 /* operate on Secure Computing state */
 COND_SYSCALL(seccomp);
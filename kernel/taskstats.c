@@ -22,6 +22,8 @@
 #include <net/genetlink.h>
 #include <linux/atomic.h>
 #include <linux/sched/cputime.h>
+#include <linux/sched/mm.h>
+#include <linux/memcontrol.h>
 
 /*
  * Maximum length of a cpumask that can be specified in
@@ -29,6 +31,11 @@
  */
 #define TASKSTATS_CPUMASK_MAXLEN	(100+6*NR_CPUS)
 
+/*
+ * Maximum number of processes in one TASKSTATS_CMD_ATTR_TGID_LIST request
+ */
+#define TASKSTATS_TGID_LIST_MAX		512
+
 static DEFINE_PER_CPU(__u32, taskstats_seqnum);
 static int family_registered;
 struct kmem_cache *taskstats_cache;
@@ -39,7 +46,9 @@ static const struct nla_policy taskstats_cmd_get_policy[] = {
 	[TASKSTATS_CMD_ATTR_PID]  = { .type = NLA_U32 },
 	[TASKSTATS_CMD_ATTR_TGID] = { .type = NLA_U32 },
 	[TASKSTATS_CMD_ATTR_REGISTER_CPUMASK] = { .type = NLA_STRING },
-	[TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK] = { .type = NLA_STRING },};
+	[TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK] = { .type = NLA_STRING },
+	[TASKSTATS_CMD_ATTR_TGID_LIST] = { .type = NLA_BINARY,
+		.len = TASKSTATS_TGID_LIST_MAX * sizeof(u32) },};
 
 static const struct nla_policy cgroupstats_cmd_get_policy[] = {
 	[CGROUPSTATS_CMD_ATTR_FD] = { .type = NLA_U32 },
@@ -555,6 +564,92 @@ static int cmd_attr_tgid(struct genl_info *info)
 	return rc;
 }
 
+static void fill_mem_stats(struct task_struct *tsk, struct taskstats_mem *ms)
+{
+	struct mm_struct *mm;
+	u64 utime, stime;
+
+	ms->tgid = task_tgid_vnr(tsk);
+	ms->oom_score_adj = READ_ONCE(tsk->signal->oom_score_adj);
+
+	mm = get_task_mm(tsk);
+	if (mm) {
+		ms->rss_anon = get_mm_counter(mm, MM_ANONPAGES) << PAGE_SHIFT;
+		ms->rss_file = get_mm_counter(mm, MM_FILEPAGES) << PAGE_SHIFT;
+		ms->rss_shmem = get_mm_counter(mm, MM_SHMEMPAGES) << PAGE_SHIFT;
+		ms->swap = get_mm_counter(mm, MM_SWAPENTS) << PAGE_SHIFT;
+		mmput(mm);
+	}
+
+#ifdef CONFIG_MEMCG
+	if (!mem_cgroup_disabled()) {
+		struct mem_cgroup *memcg;
+
+		rcu_read_lock();
+		memcg = mem_cgroup_from_task(tsk);
+		if (memcg)
+			ms->memcg_ino = cgroup_ino(memcg->css.cgroup);
+		rcu_read_unlock();
+	}
+#endif
+
+	thread_group_cputime_adjusted(tsk, &utime, &stime);
+	ms->utime = utime;
+	ms->stime = stime;
+}
+
+/*
+ * Answer a whole list of processes with one fixed-size record each, for
+ * memory monitors that would otherwise read status, statm and oom_score_adj
+ * of every process in turn.
+ */
+static int cmd_attr_tgid_list(struct genl_info *info)
+{
+	struct nlattr *na = info->attrs[TASKSTATS_CMD_ATTR_TGID_LIST];
+	struct taskstats_mem *buf;
+	struct task_struct *tsk;
+	struct sk_buff *rep_skb;
+	const u32 *tgids;
+	int i, n, nr = 0;
+	int rc;
+
+	if (nla_len(na) % sizeof(u32))
+		return -EINVAL;
+	n = nla_len(na) / sizeof(u32);
+	if (!n)
+		return -EINVAL;
+
+	buf = kvcalloc(n, sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	tgids = nla_data(na);
+	for (i = 0; i < n; i++) {
+		tsk = find_get_task_by_vpid(tgids[i]);
+		if (!tsk)
+			continue;
+		if (!(tsk->flags & PF_EXITING))
+			fill_mem_stats(tsk, &buf[nr++]);
+		put_task_struct(tsk);
+	}
+
+	rc = prepare_reply(info, TASKSTATS_CMD_NEW, &rep_skb,
+			   nla_total_size_64bit(nr * sizeof(*buf)));
+	if (rc < 0)
+		goto out;
+
+	rc = nla_put_64bit(rep_skb, TASKSTATS_TYPE_MEM_LIST, nr * sizeof(*buf),
+			   buf, TASKSTATS_TYPE_NULL);
+	if (rc < 0) {
+		nlmsg_free(rep_skb);
+		goto out;
+	}
+	rc = send_reply(rep_skb, info);
+out:
+	kvfree(buf);
+	return rc;
+}
+
 static int taskstats_user_cmd(struct sk_buff *skb, struct genl_info *info)
 {
 	if (info->attrs[TASKSTATS_CMD_ATTR_REGISTER_CPUMASK])
@@ -565,6 +660,8 @@ static int taskstats_user_cmd(struct sk_buff *skb, struct genl_info *info)
 		return cmd_attr_pid(info);
 	else if (info->attrs[TASKSTATS_CMD_ATTR_TGID])
 		return cmd_attr_tgid(info);
+	else if (info->attrs[TASKSTATS_CMD_ATTR_TGID_LIST])
+		return cmd_attr_tgid_list(info);
 	else
 		return -EINVAL;
 }
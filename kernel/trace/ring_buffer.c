@@ -6098,7 +6098,7 @@ int ring_buffer_map(struct trace_buffer *buffer, int cpu)
 	unsigned long flags, *page_ids;
 	int err = 0;
 
-	if (!cpumask_test_cpu(cpu, buffer->cpumask) || buffer->writer)
+	if (!cpumask_test_cpu(cpu, buffer->cpumask))
 		return -EINVAL;
 
 	cpu_buffer = buffer->buffers[cpu];
@@ -6110,6 +6110,18 @@ int ring_buffer_map(struct trace_buffer *buffer, int cpu)
 		goto unlock;
 	}
 
+	/*
+	 * The meta-page and data pages of a buffer fed by a writer already
+	 * describe it, and the writer keeps them up to date.
+	 */
+	if (cpu_buffer->writer) {
+		WRITE_ONCE(cpu_buffer->meta_page->meta_page_size, PAGE_SIZE);
+		WRITE_ONCE(cpu_buffer->meta_page->nr_data_pages,
+			   cpu_buffer->nr_pages + 1);
+		WRITE_ONCE(cpu_buffer->mapped, 1);
+		goto unlock;
+	}
+
 	/* prevent another thread from changing buffer sizes */
 	mutex_lock(&buffer->mutex);
 	atomic_inc(&cpu_buffer->resize_disabled);
@@ -6180,7 +6192,7 @@ int ring_buffer_unmap(struct trace_buffer *buffer, int cpu)
 	}
 
 	WRITE_ONCE(cpu_buffer->mapped, cpu_buffer->mapped - 1);
-	if (!cpu_buffer->mapped) {
+	if (!cpu_buffer->mapped && !cpu_buffer->writer) {
 		/* Wait the writer and readers to observe !mapped */
 		synchronize_rcu();
 
@@ -6229,6 +6241,8 @@ int ring_buffer_map_get_reader_page(struct trace_buffer *buffer, int cpu)
 		return (int)PTR_ERR(cpu_buffer);
 
 	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+	if (cpu_buffer->writer)
+		rb_read_writer_meta_page(cpu_buffer);
 consume:
 	if (rb_per_cpu_empty(cpu_buffer))
 		goto out;
@@ -1267,6 +1267,9 @@ int tracing_alloc_snapshot_instance(struct trace_array *tr)
 	int ret;
 
 	if (!tr->allocated_snapshot) {
+		/* Swapping buffers would pull pages from under the mappings */
+		if (tr->mapped)
+			return -EBUSY;
 
 		/* allocate spare buffer */
 		ret = resize_buffer_duplicate_size(&tr->max_buffer,
@@ -8572,11 +8575,28 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	return ret;
 }
 
-/* An ioctl call with cmd 0 to the ring buffer file will wake up all waiters */
+/*
+ * An ioctl call with cmd 0 to the ring buffer file will wake up all waiters.
+ * TRACE_MMAP_IOCTL_GET_READER advances the reader page of a mapped buffer.
+ */
 static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
 	struct ftrace_buffer_info *info = file->private_data;
 	struct trace_iterator *iter = &info->iter;
+	int err;
+
+	if (cmd == TRACE_MMAP_IOCTL_GET_READER) {
+		if (!(file->f_flags & O_NONBLOCK)) {
+			err = ring_buffer_wait(iter->array_buffer->buffer,
+					       iter->cpu_file,
+					       iter->tr->buffer_percent);
+			if (err)
+				return err;
+		}
+
+		return ring_buffer_map_get_reader_page(iter->array_buffer->buffer,
+						       iter->cpu_file);
+	}
 
 	if (cmd)
 		return -ENOIOCTLCMD;
@@ -8593,6 +8613,101 @@ static long tracing_buffers_ioctl(struct file *file, unsigned int cmd, unsigned
 	return 0;
 }
 
+static vm_fault_t tracing_buffers_mmap_fault(struct vm_fault *vmf)
+{
+	struct ftrace_buffer_info *info = vmf->vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+	struct page *page;
+
+	page = ring_buffer_map_fault(iter->array_buffer->buffer, iter->cpu_file,
+				     vmf->pgoff);
+	if (!page)
+		return VM_FAULT_SIGBUS;
+
+	get_page(page);
+	page->mapping = vmf->vma->vm_file->f_mapping;
+	page->index = vmf->pgoff;
+	vmf->page = page;
+
+	return 0;
+}
+
+static int tracing_buffers_map(struct trace_iterator *iter)
+{
+	struct trace_array *tr = iter->tr;
+	int ret;
+
+	mutex_lock(&trace_types_lock);
+#ifdef CONFIG_TRACER_MAX_TRACE
+	/* A snapshot swaps the buffer pages out from under the reader */
+	if (tr->allocated_snapshot) {
+		ret = -EBUSY;
+		goto out;
+	}
+#endif
+	ret = ring_buffer_map(iter->array_buffer->buffer, iter->cpu_file);
+	if (!ret)
+		tr->mapped++;
+#ifdef CONFIG_TRACER_MAX_TRACE
+ out:
+#endif
+	mutex_unlock(&trace_types_lock);
+
+	return ret;
+}
+
+static void tracing_buffers_mmap_open(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+
+	WARN_ON(tracing_buffers_map(&info->iter));
+}
+
+static void tracing_buffers_mmap_close(struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = vma->vm_file->private_data;
+	struct trace_iterator *iter = &info->iter;
+
+	mutex_lock(&trace_types_lock);
+	if (!WARN_ON(ring_buffer_unmap(iter->array_buffer->buffer,
+				       iter->cpu_file)))
+		iter->tr->mapped--;
+	mutex_unlock(&trace_types_lock);
+}
+
+static const struct vm_operations_struct tracing_buffers_vmops = {
+	.open		= tracing_buffers_mmap_open,
+	.close		= tracing_buffers_mmap_close,
+	.fault		= tracing_buffers_mmap_fault,
+};
+
+/*
+ * Map the meta page followed by the data pages of a per-CPU ring buffer
+ * read-only, see ring_buffer_map_fault() for the layout. The reader consumes
+ * events in place and swaps in a new reader page with
+ * TRACE_MMAP_IOCTL_GET_READER, so no data is ever copied.
+ */
+static int tracing_buffers_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct ftrace_buffer_info *info = filp->private_data;
+	int ret;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (info->iter.cpu_file == RING_BUFFER_ALL_CPUS)
+		return -EINVAL;
+
+	ret = tracing_buffers_map(&info->iter);
+	if (ret)
+		return ret;
+
+	vm_flags_mod(vma, VM_DONTCOPY | VM_DONTDUMP, VM_MAYWRITE);
+	vma->vm_ops = &tracing_buffers_vmops;
+
+	return 0;
+}
+
 static const struct file_operations tracing_buffers_fops = {
 	.open		= tracing_buffers_open,
 	.read		= tracing_buffers_read,
@@ -8601,6 +8716,7 @@ static const struct file_operations tracing_buffers_fops = {
 	.flush		= tracing_buffers_flush,
 	.splice_read	= tracing_buffers_splice_read,
 	.unlocked_ioctl = tracing_buffers_ioctl,
+	.mmap		= tracing_buffers_mmap,
 	.llseek		= no_llseek,
 };
 
@@ -14,13 +14,18 @@
 #include <linux/uio.h>
 #include <linux/ioctl.h>
 #include <linux/jhash.h>
+#include <linux/log2.h>
 #include <linux/refcount.h>
+#include <linux/sizes.h>
 #include <linux/trace_events.h>
 #include <linux/tracefs.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
 #include <linux/highmem.h>
 #include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 #include <linux/user_events.h>
 #include "trace_dynevent.h"
 #include "trace_output.h"
@@ -168,6 +173,30 @@ struct user_event_refs {
 struct user_event_file_info {
 	struct user_event_group	*group;
 	struct user_event_refs	*refs;
+	struct mutex		stage_mutex;
+	struct list_head	stages;
+	unsigned int		nr_stages;
+	struct delayed_work	stage_work;
+};
+
+/* Staging buffers are written out at least this often */
+#define USER_STAGE_DRAIN_MS	10
+#define USER_STAGE_MAX_SIZE	SZ_1M
+#define USER_STAGE_MAX		256
+
+/*
+ * A staging buffer registered with DIAG_IOCSSTAGE. Its pages are pinned and
+ * mapped into the kernel, so it can be drained from any context.
+ */
+struct user_event_stage {
+	struct list_head	link;
+	struct page		**pages;
+	int			nr_pages;
+	/* The pinned pages are charged to its locked_vm */
+	struct mm_struct	*mm;
+	struct user_stage_header *header;
+	void			*data;
+	u32			data_size;
 };
 
 #define VALIDATOR_ENSURE_NULL (1 << 0)
@@ -2068,9 +2097,9 @@ static int delete_user_event(struct user_event_group *group, char *name)
 /*
  * Validates the user payload and writes via iterator.
  */
-static ssize_t user_events_write_core(struct file *file, struct iov_iter *i)
+static ssize_t user_events_write_core(struct user_event_file_info *info,
+				      struct iov_iter *i)
 {
-	struct user_event_file_info *info = file->private_data;
 	struct user_event_refs *refs;
 	struct user_event *user = NULL;
 	struct tracepoint *tp;
@@ -2144,6 +2173,237 @@ static ssize_t user_events_write_core(struct file *file, struct iov_iter *i)
 	return ret;
 }
 
+/*
+ * Writes out the complete records of a staging buffer. User space may change
+ * the buffer under us, but each record is copied into the trace buffers and
+ * validated there, just like a write() would.
+ */
+static void user_event_stage_drain(struct user_event_file_info *info,
+				   struct user_event_stage *stage)
+{
+	struct user_stage_header *header = stage->header;
+	u32 head, tail, pos, len, rec;
+	struct iov_iter i;
+	struct kvec kv;
+	ssize_t ret;
+
+	head = smp_load_acquire(&header->head);
+	tail = READ_ONCE(header->tail);
+
+	while (tail != head) {
+		if (head - tail > stage->data_size)
+			goto corrupt;
+
+		pos = tail & (stage->data_size - 1);
+		if (!IS_ALIGNED(pos, 8))
+			goto corrupt;
+
+		len = READ_ONCE(*(u32 *)(stage->data + pos));
+
+		if (!len) {
+			tail += stage->data_size - pos;
+			continue;
+		}
+
+		/* Bound len before aligning it, so that rec cannot wrap */
+		if (len < sizeof(int) ||
+		    len > stage->data_size - pos - sizeof(u32))
+			goto corrupt;
+
+		rec = ALIGN(sizeof(u32) + len, 8);
+		if (rec > head - tail)
+			goto corrupt;
+
+		kv.iov_base = stage->data + pos + sizeof(u32);
+		kv.iov_len = len;
+		iov_iter_kvec(&i, ITER_SOURCE, &kv, 1, len);
+
+		/* A disabled event is not an error, the record is just skipped */
+		ret = user_events_write_core(info, &i);
+		if (ret < 0 && ret != -EBADF)
+			WRITE_ONCE(header->dropped, header->dropped + 1);
+
+		tail += rec;
+	}
+
+	smp_store_release(&header->tail, tail);
+	return;
+
+corrupt:
+	/* Give up on what is in the buffer rather than misparse it */
+	WRITE_ONCE(header->dropped, header->dropped + 1);
+	smp_store_release(&header->tail, head);
+}
+
+static void user_events_stage_drain_all(struct user_event_file_info *info)
+{
+	struct user_event_stage *stage;
+
+	mutex_lock(&info->stage_mutex);
+	list_for_each_entry(stage, &info->stages, link)
+		user_event_stage_drain(info, stage);
+	mutex_unlock(&info->stage_mutex);
+}
+
+static void user_events_stage_work(struct work_struct *work)
+{
+	struct user_event_file_info *info = container_of(to_delayed_work(work),
+					struct user_event_file_info, stage_work);
+
+	user_events_stage_drain_all(info);
+	schedule_delayed_work(&info->stage_work,
+			      msecs_to_jiffies(USER_STAGE_DRAIN_MS));
+}
+
+static void user_event_stage_free(struct user_event_stage *stage)
+{
+	vunmap(stage->header);
+	unpin_user_pages_dirty_lock(stage->pages, stage->nr_pages, true);
+	account_locked_vm(stage->mm, stage->nr_pages, false);
+	mmdrop(stage->mm);
+	kvfree(stage->pages);
+	kfree(stage);
+}
+
+static long user_stage_get(struct user_stage __user *ustage,
+			   struct user_stage *kstage)
+{
+	u32 size;
+	long ret;
+
+	ret = get_user(size, &ustage->size);
+
+	if (ret)
+		return ret;
+
+	if (size > PAGE_SIZE)
+		return -E2BIG;
+
+	if (size < offsetofend(struct user_stage, stage_addr))
+		return -EINVAL;
+
+	ret = copy_struct_from_user(kstage, sizeof(*kstage), ustage, size);
+
+	if (ret)
+		return ret;
+
+	if (kstage->stage_size < PAGE_SIZE ||
+	    kstage->stage_size > USER_STAGE_MAX_SIZE ||
+	    !is_power_of_2(kstage->stage_size))
+		return -EINVAL;
+
+	if (!PAGE_ALIGNED(kstage->stage_addr))
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Registers a staging buffer of the calling thread with this file.
+ */
+static long user_events_ioctl_stage(struct user_event_file_info *info,
+				    unsigned long uarg)
+{
+	struct user_stage __user *ustage = (struct user_stage __user *)uarg;
+	struct user_event_stage *stage;
+	struct user_stage kstage;
+	int pinned;
+	long ret;
+
+	ret = user_stage_get(ustage, &kstage);
+
+	if (ret)
+		return ret;
+
+	stage = kzalloc(sizeof(*stage), GFP_KERNEL_ACCOUNT);
+
+	if (!stage)
+		return -ENOMEM;
+
+	stage->nr_pages = kstage.stage_size >> PAGE_SHIFT;
+	stage->pages = kvcalloc(stage->nr_pages, sizeof(*stage->pages),
+				GFP_KERNEL_ACCOUNT);
+
+	if (!stage->pages) {
+		ret = -ENOMEM;
+		goto free_stage;
+	}
+
+	/* Long term pins are held against RLIMIT_MEMLOCK */
+	ret = account_locked_vm(current->mm, stage->nr_pages, true);
+
+	if (ret)
+		goto free_pages;
+
+	pinned = pin_user_pages_fast(kstage.stage_addr, stage->nr_pages,
+				     FOLL_WRITE | FOLL_LONGTERM, stage->pages);
+
+	if (pinned != stage->nr_pages) {
+		ret = pinned < 0 ? pinned : -EFAULT;
+		if (pinned > 0)
+			unpin_user_pages(stage->pages, pinned);
+		goto unaccount;
+	}
+
+	stage->header = vmap(stage->pages, stage->nr_pages, VM_MAP, PAGE_KERNEL);
+
+	if (!stage->header) {
+		unpin_user_pages(stage->pages, stage->nr_pages);
+		ret = -ENOMEM;
+		goto unaccount;
+	}
+
+	stage->mm = current->mm;
+	mmgrab(stage->mm);
+
+	/* The record area must stay a power of two for the offset masking */
+	stage->data = (void *)stage->header + sizeof(*stage->header);
+	stage->data_size = rounddown_pow_of_two(kstage.stage_size -
+						sizeof(*stage->header));
+
+	mutex_lock(&info->stage_mutex);
+
+	if (info->nr_stages >= USER_STAGE_MAX) {
+		mutex_unlock(&info->stage_mutex);
+		user_event_stage_free(stage);
+		return -EMFILE;
+	}
+
+	list_add_tail(&stage->link, &info->stages);
+	if (!info->nr_stages++)
+		schedule_delayed_work(&info->stage_work,
+				      msecs_to_jiffies(USER_STAGE_DRAIN_MS));
+
+	mutex_unlock(&info->stage_mutex);
+
+	return 0;
+
+unaccount:
+	account_locked_vm(current->mm, stage->nr_pages, false);
+free_pages:
+	kvfree(stage->pages);
+free_stage:
+	kfree(stage);
+
+	return ret;
+}
+
+static void user_events_stage_release(struct user_event_file_info *info)
+{
+	struct user_event_stage *stage, *next;
+
+	if (list_empty(&info->stages))
+		return;
+
+	cancel_delayed_work_sync(&info->stage_work);
+
+	list_for_each_entry_safe(stage, next, &info->stages, link) {
+		user_event_stage_drain(info, stage);
+		list_del(&stage->link);
+		user_event_stage_free(stage);
+	}
+}
+
 static int user_events_open(struct inode *node, struct file *file)
 {
 	struct user_event_group *group;
@@ -2160,14 +2420,27 @@ static int user_events_open(struct inode *node, struct file *file)
 		return -ENOMEM;
 
 	info->group = group;
+	mutex_init(&info->stage_mutex);
+	INIT_LIST_HEAD(&info->stages);
+	INIT_DELAYED_WORK(&info->stage_work, user_events_stage_work);
 
 	file->private_data = info;
 
 	return 0;
 }
 
-static ssize_t user_events_write(struct file *file, const char __user *ubuf,
-				 size_t count, loff_t *ppos)
+static ssize_t user_events_write(struct user_event_file_info *info,
+				 struct iov_iter *i)
+{
+	/* Keep staged events ahead of ones written directly */
+	if (unlikely(!list_empty(&info->stages)))
+		user_events_stage_drain_all(info);
+
+	return user_events_write_core(info, i);
+}
+
+static ssize_t user_events_write_file(struct file *file, const char __user *ubuf,
+				      size_t count, loff_t *ppos)
 {
 	struct iovec iov;
 	struct iov_iter i;
@@ -2179,12 +2452,12 @@ static ssize_t user_events_write(struct file *file, const char __user *ubuf,
 					 count, &iov, &i)))
 		return -EFAULT;
 
-	return user_events_write_core(file, &i);
+	return user_events_write(file->private_data, &i);
 }
 
 static ssize_t user_events_write_iter(struct kiocb *kp, struct iov_iter *i)
 {
-	return user_events_write_core(kp->ki_filp, i);
+	return user_events_write(kp->ki_filp->private_data, i);
 }
 
 static int user_events_ref_add(struct user_event_file_info *info,
@@ -2531,6 +2804,15 @@ static long user_events_ioctl(struct file *file, unsigned int cmd,
 		ret = user_events_ioctl_unreg(uarg);
 		mutex_unlock(&group->reg_mutex);
 		break;
+
+	case DIAG_IOCSSTAGE:
+		ret = user_events_ioctl_stage(info, uarg);
+		break;
+
+	case DIAG_IOCSFLUSH:
+		user_events_stage_drain_all(info);
+		ret = 0;
+		break;
 	}
 
 	return ret;
@@ -2551,6 +2833,9 @@ static int user_events_release(struct inode *node, struct file *file)
 
 	group = info->group;
 
+	/* Write out what is staged while the events are still referenced */
+	user_events_stage_release(info);
+
 	/*
 	 * Ensure refs cannot change under any situation by taking the
 	 * register mutex during the final freeing of the references.
@@ -2583,7 +2868,7 @@ static int user_events_release(struct inode *node, struct file *file)
 
 static const struct file_operations user_data_fops = {
 	.open		= user_events_open,
-	.write		= user_events_write,
+	.write		= user_events_write_file,
 	.write_iter	= user_events_write_iter,
 	.unlocked_ioctl	= user_events_ioctl,
 	.release	= user_events_release,
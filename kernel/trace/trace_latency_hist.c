@@ -0,0 +1,351 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Always-on latency histograms
+ *
+ * Wakeup latency, runqueue wait and interrupts-off durations are accounted
+ * in per-CPU log2 buckets straight from the tracepoint probes. Unlike hist
+ * triggers there is no ring buffer and no tracing_map involved, so an event
+ * costs a clock read and a per-CPU increment.
+ */
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/security.h>
+#include <linux/tracefs.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/log2.h>
+#include <linux/fs.h>
+
+#include <trace/events/sched.h>
+#ifdef CONFIG_PREEMPTIRQ_TRACEPOINTS
+#include <trace/events/preemptirq.h>
+#endif
+
+#include "trace.h"
+
+#if defined(CONFIG_PREEMPTIRQ_TRACEPOINTS) && defined(CONFIG_TRACE_IRQFLAGS)
+#define LATENCY_HIST_IRQSOFF
+#endif
+
+enum latency_hist_type {
+	LATENCY_HIST_WAKEUP,
+	LATENCY_HIST_RUNQ,
+#ifdef LATENCY_HIST_IRQSOFF
+	LATENCY_HIST_IRQSOFF,
+#endif
+	LATENCY_HIST_NR,
+};
+
+static const char * const latency_hist_names[LATENCY_HIST_NR] = {
+	[LATENCY_HIST_WAKEUP]	= "wakeup",
+	[LATENCY_HIST_RUNQ]	= "runqueue_wait",
+#ifdef LATENCY_HIST_IRQSOFF
+	[LATENCY_HIST_IRQSOFF]	= "irqsoff",
+#endif
+};
+
+/* Bucket n counts latencies of [2^(n-1), 2^n) nanoseconds */
+#define LATENCY_HIST_BUCKETS	64
+
+struct latency_hist {
+	u64	buckets[LATENCY_HIST_BUCKETS];
+	u64	max_ns;
+};
+
+static DEFINE_PER_CPU(struct latency_hist, latency_hists[LATENCY_HIST_NR]);
+
+static DEFINE_MUTEX(latency_hist_lock);
+static bool latency_hist_enabled;
+
+static __always_inline void latency_hist_add(enum latency_hist_type type, u64 ns)
+{
+	this_cpu_inc(latency_hists[type].buckets[fls64(ns)]);
+	if (ns > this_cpu_read(latency_hists[type].max_ns))
+		this_cpu_write(latency_hists[type].max_ns, ns);
+}
+
+static void probe_sched_wakeup(void *ignore, struct task_struct *p)
+{
+	p->latency_hist_ts = local_clock();
+	p->latency_hist_woken = true;
+}
+
+static void probe_sched_switch(void *ignore, bool preempt,
+			       struct task_struct *prev,
+			       struct task_struct *next,
+			       unsigned int prev_state)
+{
+	u64 now = local_clock();
+	u64 ts = next->latency_hist_ts;
+
+	/* A preempted task goes straight back to waiting on the runqueue */
+	if (preempt || prev_state == TASK_RUNNING) {
+		prev->latency_hist_ts = now;
+		prev->latency_hist_woken = false;
+	}
+
+	if (!ts)
+		return;
+	next->latency_hist_ts = 0;
+
+	/* local_clock() is not synchronized across CPUs */
+	if (now < ts)
+		return;
+
+	latency_hist_add(LATENCY_HIST_RUNQ, now - ts);
+	if (next->latency_hist_woken)
+		latency_hist_add(LATENCY_HIST_WAKEUP, now - ts);
+}
+
+#ifdef LATENCY_HIST_IRQSOFF
+static DEFINE_PER_CPU(u64, irqsoff_start);
+
+static void probe_irq_disable(void *ignore, unsigned long ip,
+			      unsigned long parent_ip)
+{
+	if (in_nmi())
+		return;
+	this_cpu_write(irqsoff_start, local_clock());
+}
+
+static void probe_irq_enable(void *ignore, unsigned long ip,
+			     unsigned long parent_ip)
+{
+	u64 start;
+
+	if (in_nmi())
+		return;
+
+	start = this_cpu_read(irqsoff_start);
+	if (!start)
+		return;
+	this_cpu_write(irqsoff_start, 0);
+	latency_hist_add(LATENCY_HIST_IRQSOFF, local_clock() - start);
+}
+
+static int register_irqsoff_probes(void)
+{
+	int ret;
+
+	ret = register_trace_irq_disable(probe_irq_disable, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_irq_enable(probe_irq_enable, NULL);
+	if (ret)
+		unregister_trace_irq_disable(probe_irq_disable, NULL);
+
+	return ret;
+}
+
+static void unregister_irqsoff_probes(void)
+{
+	unregister_trace_irq_enable(probe_irq_enable, NULL);
+	unregister_trace_irq_disable(probe_irq_disable, NULL);
+}
+#else
+static inline int register_irqsoff_probes(void) { return 0; }
+static inline void unregister_irqsoff_probes(void) { }
+#endif
+
+static int latency_hist_register(void)
+{
+	int ret;
+
+	ret = register_trace_sched_wakeup(probe_sched_wakeup, NULL);
+	if (ret)
+		return ret;
+
+	ret = register_trace_sched_wakeup_new(probe_sched_wakeup, NULL);
+	if (ret)
+		goto fail_wakeup_new;
+
+	ret = register_trace_sched_switch(probe_sched_switch, NULL);
+	if (ret)
+		goto fail_switch;
+
+	ret = register_irqsoff_probes();
+	if (ret)
+		goto fail_irqsoff;
+
+	return 0;
+
+fail_irqsoff:
+	unregister_trace_sched_switch(probe_sched_switch, NULL);
+fail_switch:
+	unregister_trace_sched_wakeup_new(probe_sched_wakeup, NULL);
+fail_wakeup_new:
+	unregister_trace_sched_wakeup(probe_sched_wakeup, NULL);
+	return ret;
+}
+
+static void latency_hist_unregister(void)
+{
+	unregister_irqsoff_probes();
+	unregister_trace_sched_switch(probe_sched_switch, NULL);
+	unregister_trace_sched_wakeup_new(probe_sched_wakeup, NULL);
+	unregister_trace_sched_wakeup(probe_sched_wakeup, NULL);
+}
+
+static int latency_hist_set_enabled(bool enable)
+{
+	int ret = 0;
+
+	mutex_lock(&latency_hist_lock);
+	if (enable == latency_hist_enabled)
+		goto out;
+
+	if (enable) {
+		ret = latency_hist_register();
+	} else {
+		latency_hist_unregister();
+		tracepoint_synchronize_unregister();
+	}
+	if (!ret)
+		latency_hist_enabled = enable;
+ out:
+	mutex_unlock(&latency_hist_lock);
+
+	return ret;
+}
+
+static void latency_hist_reset(enum latency_hist_type type)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(&latency_hists[type], cpu), 0,
+		       sizeof(struct latency_hist));
+}
+
+static int latency_hist_show(struct seq_file *m, void *v)
+{
+	enum latency_hist_type type = (unsigned long)m->private;
+	u64 buckets[LATENCY_HIST_BUCKETS] = { };
+	u64 max_ns = 0;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct latency_hist *hist = per_cpu_ptr(&latency_hists[type], cpu);
+
+		for (i = 0; i < LATENCY_HIST_BUCKETS; i++)
+			buckets[i] += READ_ONCE(hist->buckets[i]);
+		max_ns = max(max_ns, READ_ONCE(hist->max_ns));
+	}
+
+	seq_puts(m, "# nsecs from - to : count\n");
+	for (i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+		if (!buckets[i])
+			continue;
+		seq_printf(m, "%llu - %llu : %llu\n",
+			   i ? 1ULL << (i - 1) : 0,
+			   i ? (1ULL << i) - 1 : 0, buckets[i]);
+	}
+	seq_printf(m, "# max: %llu\n", max_ns);
+
+	return 0;
+}
+
+/* Opening a histogram for write with O_TRUNC clears it */
+static int latency_hist_open(struct inode *inode, struct file *file)
+{
+	enum latency_hist_type type = (unsigned long)inode->i_private;
+	int ret;
+
+	ret = security_locked_down(LOCKDOWN_TRACEFS);
+	if (ret)
+		return ret;
+
+	if ((file->f_mode & FMODE_WRITE) && (file->f_flags & O_TRUNC))
+		latency_hist_reset(type);
+
+	if (file->f_mode & FMODE_READ)
+		return single_open(file, latency_hist_show, inode->i_private);
+
+	return 0;
+}
+
+static ssize_t latency_hist_write(struct file *file, const char __user *buffer,
+				  size_t count, loff_t *ppos)
+{
+	return count;
+}
+
+static int latency_hist_release(struct inode *inode, struct file *file)
+{
+	if (file->f_mode & FMODE_READ)
+		return single_release(inode, file);
+	return 0;
+}
+
+static const struct file_operations latency_hist_fops = {
+	.open		= latency_hist_open,
+	.write		= latency_hist_write,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= latency_hist_release,
+};
+
+static ssize_t latency_hist_enable_read(struct file *filp, char __user *ubuf,
+					size_t cnt, loff_t *ppos)
+{
+	char buf[3];
+	int r;
+
+	r = sprintf(buf, "%d\n", READ_ONCE(latency_hist_enabled));
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t latency_hist_enable_write(struct file *filp,
+					 const char __user *ubuf,
+					 size_t cnt, loff_t *ppos)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, cnt, &enable);
+	if (ret)
+		return ret;
+
+	ret = latency_hist_set_enabled(enable);
+	if (ret)
+		return ret;
+
+	*ppos += cnt;
+	return cnt;
+}
+
+static const struct file_operations latency_hist_enable_fops = {
+	.open		= tracing_open_generic,
+	.read		= latency_hist_enable_read,
+	.write		= latency_hist_enable_write,
+	.llseek		= generic_file_llseek,
+};
+
+static __init int init_latency_hist(void)
+{
+	struct dentry *dir;
+	int ret, i;
+
+	ret = tracing_init_dentry();
+	if (ret)
+		return 0;
+
+	dir = tracefs_create_dir("latency_hist", NULL);
+	if (!dir) {
+		pr_warn("Could not create tracefs 'latency_hist' directory\n");
+		return 0;
+	}
+
+	trace_create_file("enable", TRACE_MODE_WRITE, dir, NULL,
+			  &latency_hist_enable_fops);
+	for (i = 0; i < LATENCY_HIST_NR; i++)
+		trace_create_file(latency_hist_names[i], TRACE_MODE_WRITE, dir,
+				  (void *)(unsigned long)i, &latency_hist_fops);
+
+	if (latency_hist_set_enabled(true))
+		pr_warn("Could not register latency histogram probes\n");
+
+	return 0;
+}
+fs_initcall(init_latency_hist);
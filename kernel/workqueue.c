@@ -349,6 +349,7 @@ static const char *wq_affn_names[WQ_AFFN_NR_TYPES] = {
 	[WQ_AFFN_DFL]			= "default",
 	[WQ_AFFN_CPU]			= "cpu",
 	[WQ_AFFN_SMT]			= "smt",
+	[WQ_AFFN_CLUSTER]		= "cluster",
 	[WQ_AFFN_CACHE]			= "cache",
 	[WQ_AFFN_NUMA]			= "numa",
 	[WQ_AFFN_SYSTEM]		= "system",
@@ -5947,7 +5948,8 @@ module_param_cb(default_affinity_scope, &wq_affn_dfl_ops, NULL, 0644);
  *
  *  nice		RW int	: nice value of the workers
  *  cpumask		RW mask	: bitmask of allowed CPUs for the workers
- *  affinity_scope	RW str  : worker CPU affinity scope (cache, numa, none)
+ *  affinity_scope	RW str  : worker CPU affinity scope (cpu, smt, cluster,
+ *				  cache, numa, system)
  *  affinity_strict	RW bool : worker CPU affinity is strict
  */
 struct wq_device {
@@ -6794,6 +6796,16 @@ static bool __init cpus_share_smt(int cpu0, int cpu1)
 #endif
 }
 
+/*
+ * On big.LITTLE systems the LLC is usually shared by all clusters, so the
+ * cache scope spans every CPU. Cluster pods keep unbound work on the CPU type
+ * it was queued from.
+ */
+static bool __init cpus_share_cluster(int cpu0, int cpu1)
+{
+	return cpumask_test_cpu(cpu0, topology_cluster_cpumask(cpu1));
+}
+
 static bool __init cpus_share_numa(int cpu0, int cpu1)
 {
 	return cpu_to_node(cpu0) == cpu_to_node(cpu1);
@@ -6813,6 +6825,7 @@ void __init workqueue_init_topology(void)
 
 	init_pod_type(&wq_pod_types[WQ_AFFN_CPU], cpus_dont_share);
 	init_pod_type(&wq_pod_types[WQ_AFFN_SMT], cpus_share_smt);
+	init_pod_type(&wq_pod_types[WQ_AFFN_CLUSTER], cpus_share_cluster);
 	init_pod_type(&wq_pod_types[WQ_AFFN_CACHE], cpus_share_cache);
 	init_pod_type(&wq_pod_types[WQ_AFFN_NUMA], cpus_share_numa);
 
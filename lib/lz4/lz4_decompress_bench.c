@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * LZ4 decompression throughput, by block size.
+ *
+ * Compares the generic C decoder with LZ4_decompress_safe(), which runs the
+ * architecture specific build of the decoder when there is one, on text
+ * like data compressed at the block sizes used by zram and EROFS.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/lz4.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/printk.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/sizes.h>
+#include <linux/vmalloc.h>
+
+#include "lz4_decompress_generic.h"
+
+#define BENCH_MAX_BLOCK	SZ_128K
+/* Decompressed bytes per run, whatever the block size */
+#define BENCH_BYTES	SZ_64M
+
+static const unsigned int block_sizes[] __initconst = {
+	SZ_4K, SZ_16K, SZ_64K, SZ_128K,
+};
+
+static const char * const words[] __initconst = {
+	"the ", "kernel ", "page ", "cache ", "struct ", "return ",
+	"0xffffffc0", "    ", "\n", "android.", "com.", "/system/",
+};
+
+typedef int (*lz4_dec_fn)(const char *src, char *dst, int slen, int dlen);
+
+static int __init lz4_bench_generic(const char *src, char *dst,
+				    int slen, int dlen)
+{
+	return LZ4_decompress_generic(src, dst, slen, dlen,
+				      endOnInputSize, decode_full_block,
+				      noDict, (BYTE *)dst, NULL, 0);
+}
+
+static void __init lz4_bench_fill(char *buf, unsigned int size)
+{
+	unsigned int off = 0, n, r;
+
+	while (off < size) {
+		r = get_random_u32_below(ARRAY_SIZE(words) + 1);
+		if (r == ARRAY_SIZE(words)) {
+			/* Runs of zeroes, as in anonymous memory */
+			n = min(64U, size - off);
+			memset(buf + off, 0, n);
+		} else {
+			n = min_t(unsigned int, strlen(words[r]), size - off);
+			memcpy(buf + off, words[r], n);
+		}
+		off += n;
+	}
+}
+
+/* Returns MB/s, or 0 if the output is wrong */
+static u64 __init lz4_bench_run(lz4_dec_fn fn, const char *cmp, int clen,
+				const char *ref, char *out, unsigned int size)
+{
+	unsigned int i, loops = BENCH_BYTES / size;
+	ktime_t start;
+	u64 ns;
+
+	memset(out, 0, size);
+	start = ktime_get();
+	for (i = 0; i < loops; i++) {
+		if (fn(cmp, out, clen, size) != size)
+			return 0;
+		if (!(i % 256))
+			cond_resched();
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (memcmp(out, ref, size))
+		return 0;
+
+	return div64_u64((u64)loops * size * NSEC_PER_SEC, ns ?: 1) >> 20;
+}
+
+static int __init lz4_bench_init(void)
+{
+	char *src, *cmp, *out;
+	void *wrkmem;
+	u64 generic, arch;
+	unsigned int i, size;
+	int clen, ret = -ENOMEM;
+
+	src = vmalloc(BENCH_MAX_BLOCK);
+	cmp = vmalloc(LZ4_COMPRESSBOUND(BENCH_MAX_BLOCK));
+	out = vmalloc(BENCH_MAX_BLOCK);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	if (!src || !cmp || !out || !wrkmem)
+		goto out;
+
+	lz4_bench_fill(src, BENCH_MAX_BLOCK);
+
+	for (i = 0; i < ARRAY_SIZE(block_sizes); i++) {
+		size = block_sizes[i];
+		clen = LZ4_compress_default(src, cmp, size,
+					    LZ4_COMPRESSBOUND(size), wrkmem);
+		if (clen <= 0) {
+			pr_err("compression of %u bytes failed\n", size);
+			ret = -EINVAL;
+			goto out;
+		}
+
+		generic = lz4_bench_run(lz4_bench_generic, cmp, clen,
+					src, out, size);
+		arch = lz4_bench_run(LZ4_decompress_safe, cmp, clen,
+				     src, out, size);
+		if (!generic || !arch) {
+			pr_err("wrong output for %u bytes\n", size);
+			ret = -EINVAL;
+			goto out;
+		}
+
+		pr_info("%6u bytes, ratio %3u%%: generic %llu MB/s, LZ4_decompress_safe %llu MB/s\n",
+			size, clen * 100 / size, generic, arch);
+	}
+
+	/*
+	 * Everything is OK. Return error just to let user run benchmark
+	 * again without annoying rmmod.
+	 */
+	ret = -EINVAL;
+out:
+	vfree(wrkmem);
+	vfree(out);
+	vfree(cmp);
+	vfree(src);
+	return ret;
+}
+module_init(lz4_bench_init);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 decompression benchmark");
@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * Glue for the NEON build of the LZ4 decompressor in
+ * lz4_decompress_neon_inner.c. Like everything outside that file, this is
+ * built with -mgeneral-regs-only, so that the compiler cannot spill to or
+ * use FP/SIMD registers outside kernel_neon_begin()/kernel_neon_end().
+ */
+
+#include <linux/init.h>
+#include <linux/jump_label.h>
+#include <linux/module.h>
+#include <asm/cpufeature.h>
+#include <asm/neon.h>
+
+#include "lz4defs.h"
+
+DEFINE_STATIC_KEY_FALSE(lz4_neon);
+EXPORT_SYMBOL_GPL(lz4_neon);
+
+int LZ4_decompress_safe_neon(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize)
+{
+	int ret;
+
+	kernel_neon_begin();
+	ret = LZ4_decompress_safe_neon_inner(source, dest, compressedSize,
+					     maxDecompressedSize);
+	kernel_neon_end();
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(LZ4_decompress_safe_neon);
+
+int LZ4_decompress_safe_partial_neon(const char *src, char *dst,
+	int compressedSize, int dstCapacity)
+{
+	int ret;
+
+	kernel_neon_begin();
+	ret = LZ4_decompress_safe_partial_neon_inner(src, dst, compressedSize,
+						     dstCapacity);
+	kernel_neon_end();
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(LZ4_decompress_safe_partial_neon);
+
+static bool neon = true;
+module_param(neon, bool, 0444);
+MODULE_PARM_DESC(neon, "Use NEON for LZ4 decompression when available");
+
+static int __init lz4_neon_init(void)
+{
+	if (neon && cpu_have_named_feature(ASIMD))
+		static_branch_enable(&lz4_neon);
+	return 0;
+}
+subsys_initcall(lz4_neon_init);
+
+static void __exit lz4_neon_exit(void)
+{
+}
+module_exit(lz4_neon_exit);
+
+MODULE_LICENSE("Dual BSD/GPL");
+MODULE_DESCRIPTION("LZ4 decompressor, NEON build");
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0 OR BSD-2-Clause
+/*
+ * LZ4 decompressor for arm64, using NEON for the literal and match copies.
+ *
+ * The generic decoder copies 8 bytes at a time. This build copies 16 bytes
+ * per step with NEON loads and stores, but still overruns the end of a
+ * copy by at most WILDCOPYLENGTH - 1 bytes, so all the bounds checks of
+ * LZ4_decompress_generic() hold unchanged. Matches closer than 16 bytes
+ * overlap the bytes being written and keep using 8 byte copies.
+ *
+ * This file is built without -mgeneral-regs-only and must only be called
+ * between kernel_neon_begin() and kernel_neon_end(), see
+ * lz4_decompress_neon.c.
+ */
+
+#include <asm/neon-intrinsics.h>
+
+#include "lz4defs.h"
+
+static FORCE_INLINE void LZ4_copy16(void *dst, const void *src)
+{
+	vst1q_u8(dst, vld1q_u8(src));
+}
+
+static FORCE_INLINE void LZ4_wildCopy_neon(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+	BYTE *d = (BYTE *)dstPtr;
+	const BYTE *s = (const BYTE *)srcPtr;
+	BYTE *const e = (BYTE *)dstEnd;
+
+	do {
+		if (e - d > 8) {
+			LZ4_copy16(d, s);
+			d += 16;
+			s += 16;
+		} else {
+			LZ4_copy8(d, s);
+			d += 8;
+			s += 8;
+		}
+	} while (d < e);
+}
+
+static FORCE_INLINE void LZ4_matchCopy_neon(void *dstPtr,
+	const void *srcPtr, void *dstEnd)
+{
+	if ((const BYTE *)dstPtr - (const BYTE *)srcPtr >= 16)
+		LZ4_wildCopy_neon(dstPtr, srcPtr, dstEnd);
+	else
+		LZ4_wildCopy(dstPtr, srcPtr, dstEnd);
+}
+
+#define LZ4_DEC_WILDCOPY(d, s, e)	LZ4_wildCopy_neon(d, s, e)
+#define LZ4_DEC_MATCHCOPY(d, s, e)	LZ4_matchCopy_neon(d, s, e)
+#include "lz4_decompress_generic.h"
+
+int LZ4_decompress_safe_neon_inner(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize)
+{
+	return LZ4_decompress_generic(source, dest,
+				      compressedSize, maxDecompressedSize,
+				      endOnInputSize, decode_full_block,
+				      noDict, (BYTE *)dest, NULL, 0);
+}
+
+int LZ4_decompress_safe_partial_neon_inner(const char *src, char *dst,
+	int compressedSize, int dstCapacity)
+{
+	return LZ4_decompress_generic(src, dst, compressedSize, dstCapacity,
+				      endOnInputSize, partial_decode,
+				      noDict, (BYTE *)dst, NULL, 0);
+}
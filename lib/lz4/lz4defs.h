@@ -244,4 +244,42 @@ typedef enum { decode_full_block = 0, partial_decode = 1 } earlyEnd_directive;
 
 #define LZ4_STATIC_ASSERT(c)	BUILD_BUG_ON(!(c))
 
+#if defined(CONFIG_LZ4_DECOMPRESS_NEON) && !defined(PREBOOT)
+#include <linux/jump_label.h>
+#include <asm/simd.h>
+
+DECLARE_STATIC_KEY_FALSE(lz4_neon);
+
+/*
+ * Largest output decoded with NEON. The decoder cannot be suspended in the
+ * middle of a block, and preemption is off between kernel_neon_begin() and
+ * kernel_neon_end(), so bigger blocks, like 1MB EROFS pclusters, are left to
+ * the generic decoder.
+ */
+#define LZ4_NEON_MAX_OUTPUT	(64 * KB)
+
+/* lz4_decompress_neon.c, callers must check LZ4_neon_usable() first */
+int LZ4_decompress_safe_neon(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize);
+int LZ4_decompress_safe_partial_neon(const char *src, char *dst,
+	int compressedSize, int dstCapacity);
+
+/* lz4_decompress_neon_inner.c, only between kernel_neon_begin()/end() */
+int LZ4_decompress_safe_neon_inner(const char *source, char *dest,
+	int compressedSize, int maxDecompressedSize);
+int LZ4_decompress_safe_partial_neon_inner(const char *src, char *dst,
+	int compressedSize, int dstCapacity);
+
+static FORCE_INLINE bool LZ4_neon_usable(int outputSize)
+{
+	return static_branch_likely(&lz4_neon) &&
+	       outputSize <= LZ4_NEON_MAX_OUTPUT && may_use_simd();
+}
+#else
+static FORCE_INLINE bool LZ4_neon_usable(int outputSize)
+{
+	return false;
+}
+#endif
+
 #endif
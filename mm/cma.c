@@ -34,6 +34,7 @@
 #include <linux/kmemleak.h>
 #include <linux/sched.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <trace/events/cma.h>
 
 #include "internal.h"
@@ -443,6 +444,9 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 	int ret = -ENOMEM;
 	int num_attempts = 0;
 	int max_retries = 5;
+	unsigned long busy_retries = 0;
+	struct acr_info info = {};
+	ktime_t start_ts = ktime_get();
 
 	if (WARN_ON_ONCE((gfp_mask & GFP_KERNEL) == 0 ||
 		(gfp_mask & ~(GFP_KERNEL|__GFP_NOWARN|__GFP_NORETRY)) != 0))
@@ -507,7 +511,8 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 
 		pfn = cma->base_pfn + (bitmap_no << cma->order_per_bit);
 		mutex_lock(&cma_mutex);
-		ret = alloc_contig_range(pfn, pfn + count, MIGRATE_CMA, gfp_mask);
+		ret = __alloc_contig_range(pfn, pfn + count, MIGRATE_CMA,
+					   gfp_mask, &info);
 		mutex_unlock(&cma_mutex);
 		if (ret == 0) {
 			page = pfn_to_page(pfn);
@@ -523,6 +528,7 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 
 		trace_cma_alloc_busy_retry(cma->name, pfn, pfn_to_page(pfn),
 					   count, align);
+		busy_retries++;
 		/* try again with a bit different memory target */
 		start = bitmap_no + mask + 1;
 	}
@@ -555,6 +561,9 @@ struct page *__cma_alloc(struct cma *cma, unsigned long count,
 		if (cma)
 			cma_sysfs_account_fail_pages(cma, count);
 	}
+	if (cma)
+		cma_sysfs_account_alloc(cma, ktime_to_ns(ktime_sub(ktime_get(), start_ts)),
+					busy_retries, num_attempts, &info);
 
 	return page;
 }
@@ -3,8 +3,12 @@
 #define __MM_CMA_H__
 
 #include <linux/debugfs.h>
+#include <linux/gfp.h>
 #include <linux/kobject.h>
 
+/* cma_alloc() latency buckets: < 1ms, < 2ms, ..., < 512ms, and the rest */
+#define CMA_NR_LATENCY_BUCKETS	11
+
 struct cma_kobject {
 	struct kobject kobj;
 	struct cma *cma;
@@ -27,6 +31,17 @@ struct cma {
 	atomic64_t nr_pages_succeeded;
 	/* the number of CMA page allocation failures */
 	atomic64_t nr_pages_failed;
+	/* the number of retries on a different range after -EBUSY */
+	atomic64_t nr_busy_retries;
+	/* the number of 100ms sleeps before rescanning the whole area */
+	atomic64_t nr_sleep_retries;
+	/* the number of pages that failed migration, by reason */
+	atomic64_t nr_migrate_fail_pinned;
+	atomic64_t nr_migrate_fail_writeback;
+	atomic64_t nr_migrate_fail_locked;
+	atomic64_t nr_migrate_fail_other;
+	/* cma_alloc() latency histogram */
+	atomic64_t latency_hist[CMA_NR_LATENCY_BUCKETS];
 	/* kobject requires dynamic object */
 	struct cma_kobject *cma_kobj;
 #endif
@@ -44,10 +59,18 @@ static inline unsigned long cma_bitmap_maxno(struct cma *cma)
 #ifdef CONFIG_CMA_SYSFS
 void cma_sysfs_account_success_pages(struct cma *cma, unsigned long nr_pages);
 void cma_sysfs_account_fail_pages(struct cma *cma, unsigned long nr_pages);
+void cma_sysfs_account_alloc(struct cma *cma, u64 latency_ns,
+			     unsigned long busy_retries,
+			     unsigned long sleep_retries,
+			     struct acr_info *info);
 #else
 static inline void cma_sysfs_account_success_pages(struct cma *cma,
 						   unsigned long nr_pages) {};
 static inline void cma_sysfs_account_fail_pages(struct cma *cma,
 						unsigned long nr_pages) {};
+static inline void cma_sysfs_account_alloc(struct cma *cma, u64 latency_ns,
+					   unsigned long busy_retries,
+					   unsigned long sleep_retries,
+					   struct acr_info *info) {};
 #endif
 #endif
@@ -7,6 +7,7 @@
 
 #include <linux/cma.h>
 #include <linux/kernel.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
 
 #include "cma.h"
@@ -24,6 +25,29 @@ void cma_sysfs_account_fail_pages(struct cma *cma, unsigned long nr_pages)
 	atomic64_add(nr_pages, &cma->nr_pages_failed);
 }
 
+void cma_sysfs_account_alloc(struct cma *cma, u64 latency_ns,
+			     unsigned long busy_retries,
+			     unsigned long sleep_retries,
+			     struct acr_info *info)
+{
+	unsigned long ms = div_u64(latency_ns, NSEC_PER_MSEC);
+	int bucket = ms ? min(ilog2(ms) + 1, CMA_NR_LATENCY_BUCKETS - 1) : 0;
+
+	atomic64_inc(&cma->latency_hist[bucket]);
+	if (busy_retries)
+		atomic64_add(busy_retries, &cma->nr_busy_retries);
+	if (sleep_retries)
+		atomic64_add(sleep_retries, &cma->nr_sleep_retries);
+	if (info->nr_pinned)
+		atomic64_add(info->nr_pinned, &cma->nr_migrate_fail_pinned);
+	if (info->nr_writeback)
+		atomic64_add(info->nr_writeback, &cma->nr_migrate_fail_writeback);
+	if (info->nr_locked)
+		atomic64_add(info->nr_locked, &cma->nr_migrate_fail_locked);
+	if (info->nr_other)
+		atomic64_add(info->nr_other, &cma->nr_migrate_fail_other);
+}
+
 static inline struct cma *cma_from_kobj(struct kobject *kobj)
 {
 	return container_of(kobj, struct cma_kobject, kobj)->cma;
@@ -48,6 +72,40 @@ static ssize_t alloc_pages_fail_show(struct kobject *kobj,
 }
 CMA_ATTR_RO(alloc_pages_fail);
 
+#define CMA_ATTR_COUNTER(_name, _field)					\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	struct cma *cma = cma_from_kobj(kobj);				\
+									\
+	return sysfs_emit(buf, "%llu\n", atomic64_read(&cma->_field));	\
+}									\
+CMA_ATTR_RO(_name)
+
+CMA_ATTR_COUNTER(alloc_busy_retries, nr_busy_retries);
+CMA_ATTR_COUNTER(alloc_sleep_retries, nr_sleep_retries);
+CMA_ATTR_COUNTER(migrate_fail_pinned, nr_migrate_fail_pinned);
+CMA_ATTR_COUNTER(migrate_fail_writeback, nr_migrate_fail_writeback);
+CMA_ATTR_COUNTER(migrate_fail_locked, nr_migrate_fail_locked);
+CMA_ATTR_COUNTER(migrate_fail_other, nr_migrate_fail_other);
+
+/* one "<upper bound in ms> <count>" line per bucket, the last unbounded */
+static ssize_t alloc_latency_hist_show(struct kobject *kobj,
+				       struct kobj_attribute *attr, char *buf)
+{
+	struct cma *cma = cma_from_kobj(kobj);
+	int len = 0;
+	int i;
+
+	for (i = 0; i < CMA_NR_LATENCY_BUCKETS - 1; i++)
+		len += sysfs_emit_at(buf, len, "%lu %llu\n", 1UL << i,
+				     atomic64_read(&cma->latency_hist[i]));
+	len += sysfs_emit_at(buf, len, "inf %llu\n",
+			     atomic64_read(&cma->latency_hist[i]));
+	return len;
+}
+CMA_ATTR_RO(alloc_latency_hist);
+
 static void cma_kobj_release(struct kobject *kobj)
 {
 	struct cma *cma = cma_from_kobj(kobj);
@@ -60,6 +118,13 @@ static void cma_kobj_release(struct kobject *kobj)
 static struct attribute *cma_attrs[] = {
 	&alloc_pages_success_attr.attr,
 	&alloc_pages_fail_attr.attr,
+	&alloc_busy_retries_attr.attr,
+	&alloc_sleep_retries_attr.attr,
+	&alloc_latency_hist_attr.attr,
+	&migrate_fail_pinned_attr.attr,
+	&migrate_fail_writeback_attr.attr,
+	&migrate_fail_locked_attr.attr,
+	&migrate_fail_other_attr.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(cma);
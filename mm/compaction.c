@@ -1837,6 +1837,12 @@ static int sysctl_compact_unevictable_allowed __read_mostly = CONFIG_COMPACT_UNE
  * background. It takes values in the range [0, 100].
  */
 static unsigned int __read_mostly sysctl_compaction_proactiveness = 20;
+/*
+ * Per-order targets for the number of free blocks of at least that order on
+ * each node, e.g., for the high-order pools of dma-buf heaps. kcompactd
+ * compacts in the background towards them. Zero disables the order.
+ */
+static unsigned int __read_mostly sysctl_compaction_order_targets[NR_PAGE_ORDERS];
 static int sysctl_extfrag_threshold = 500;
 static int __read_mostly sysctl_compact_memory;
 
@@ -2118,6 +2124,25 @@ static bool kswapd_is_running(pg_data_t *pgdat)
 	return running;
 }
 
+/* Free blocks of at least @order on @pgdat, in units of @order */
+static unsigned long node_free_blocks(pg_data_t *pgdat, int order)
+{
+	unsigned long nr = 0;
+	int zoneid, o;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+
+		if (!populated_zone(zone))
+			continue;
+
+		for (o = order; o < NR_PAGE_ORDERS; o++)
+			nr += READ_ONCE(zone->free_area[o].nr_free) << (o - order);
+	}
+
+	return nr;
+}
+
 /*
  * A zone's fragmentation score is the external fragmentation wrt to the
  * COMPACTION_HPAGE_ORDER. It returns a value in the range [0, 100].
@@ -2241,6 +2266,24 @@ static enum compact_result __compact_finished(struct compact_control *cc)
 	if (is_via_compact_memory(cc->order))
 		return COMPACT_CONTINUE;
 
+	/* kcompactd order target: continue until enough blocks are free */
+	if (cc->order_target) {
+		pg_data_t *pgdat = cc->zone->zone_pgdat;
+
+		if (kswapd_is_running(pgdat))
+			return COMPACT_PARTIAL_SKIPPED;
+
+		if (!pageblock_aligned(cc->migrate_pfn))
+			return COMPACT_CONTINUE;
+
+		if (node_free_blocks(pgdat, cc->order) < cc->order_target)
+			ret = COMPACT_CONTINUE;
+		else
+			ret = COMPACT_SUCCESS;
+
+		goto out;
+	}
+
 	/*
 	 * Always finish scanning a pageblock to reduce the possibility of
 	 * fallbacks in the future. This is particularly important when
@@ -2434,7 +2477,8 @@ compact_zone(struct compact_control *cc, struct capture_control *capc)
 		/* Allocation can already succeed, nothing to do */
 		watermark = wmark_pages(cc->zone,
 					cc->alloc_flags & ALLOC_WMARK_MASK);
-		if (zone_watermark_ok(cc->zone, cc->order, watermark,
+		if (!cc->order_target &&
+		    zone_watermark_ok(cc->zone, cc->order, watermark,
 				      cc->highest_zoneidx, cc->alloc_flags))
 			return COMPACT_SUCCESS;
 
@@ -3074,6 +3118,86 @@ void wakeup_kcompactd(pg_data_t *pgdat, int order, int highest_zoneidx)
 	wake_up_interruptible(&pgdat->kcompactd_wait);
 }
 
+static bool compaction_order_targets_set(void)
+{
+	int order;
+
+	for (order = 1; order < NR_PAGE_ORDERS; order++)
+		if (READ_ONCE(sysctl_compaction_order_targets[order]))
+			return true;
+
+	return false;
+}
+
+/*
+ * Compact the zones of @pgdat, highest order first, until each order meets
+ * its target in sysctl_compaction_order_targets or compaction gets deferred.
+ */
+static void order_target_compact_node(pg_data_t *pgdat)
+{
+	int order;
+
+	for (order = NR_PAGE_ORDERS - 1; order > 0; order--) {
+		unsigned int target = READ_ONCE(sysctl_compaction_order_targets[order]);
+		unsigned long nr_free;
+		int zoneid;
+
+		if (!target)
+			continue;
+
+		nr_free = node_free_blocks(pgdat, order);
+		if (nr_free >= target)
+			continue;
+
+		trace_mm_compaction_order_target_miss(pgdat->node_id, order,
+						      nr_free, target);
+
+		if (kswapd_is_running(pgdat))
+			return;
+
+		for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+			struct zone *zone = &pgdat->node_zones[zoneid];
+			struct compact_control cc = {
+				.order = order,
+				.search_order = order,
+				.highest_zoneidx = zoneid,
+				.mode = MIGRATE_SYNC_LIGHT,
+				.gfp_mask = GFP_KERNEL,
+				.order_target = target,
+				.zone = zone,
+			};
+			int status;
+
+			if (!populated_zone(zone) || !zone_can_frag(zone))
+				continue;
+
+			if (kthread_should_stop())
+				return;
+
+			if (node_free_blocks(pgdat, order) >= target)
+				break;
+
+			if (compaction_deferred(zone, order))
+				continue;
+
+			status = compact_zone(&cc, NULL);
+			if (status == COMPACT_SUCCESS) {
+				compaction_defer_reset(zone, order, false);
+			} else if (status == COMPACT_PARTIAL_SKIPPED ||
+				   status == COMPACT_COMPLETE) {
+				/* see kcompactd_do_work() */
+				drain_all_pages(zone);
+				defer_compaction(zone, order);
+			}
+
+			count_compact_events(KCOMPACTD_MIGRATE_SCANNED,
+					     cc.total_migrate_scanned);
+			count_compact_events(KCOMPACTD_FREE_SCANNED,
+					     cc.total_free_scanned);
+		}
+	}
+}
+
 /*
  * The background compaction daemon, started as a kernel thread
  * from the init process.
@@ -3102,7 +3226,8 @@ static int kcompactd(void *p)
 		 * Avoid the unnecessary wakeup for proactive compaction
 		 * when it is disabled.
 		 */
-		if (!sysctl_compaction_proactiveness)
+		if (!sysctl_compaction_proactiveness &&
+		    !compaction_order_targets_set())
 			timeout = MAX_SCHEDULE_TIMEOUT;
 		trace_mm_compaction_kcompactd_sleep(pgdat->node_id);
 		if (wait_event_freezable_timeout(pgdat->kcompactd_wait,
@@ -3142,6 +3267,8 @@ static int kcompactd(void *p)
 				timeout =
 				   default_timeout << COMPACT_MAX_DEFER_SHIFT;
 		}
+		if (compaction_order_targets_set())
+			order_target_compact_node(pgdat);
 		if (unlikely(pgdat->proactive_compact_trigger))
 			pgdat->proactive_compact_trigger = false;
 	}
@@ -3241,6 +3368,13 @@ static struct ctl_table vm_compaction[] = {
 		.extra1		= SYSCTL_ZERO,
 		.extra2		= SYSCTL_ONE_HUNDRED,
 	},
+	{
+		.procname	= "compaction_order_targets",
+		.data		= &sysctl_compaction_order_targets,
+		.maxlen		= sizeof(sysctl_compaction_order_targets),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec,
+	},
 	{
 		.procname	= "extfrag_threshold",
 		.data		= &sysctl_extfrag_threshold,
@@ -10,6 +10,8 @@
 #include <linux/damon.h>
 #include <linux/kstrtox.h>
 #include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 
 #include "modules-common.h"
 
@@ -107,6 +109,24 @@ module_param(monitor_region_end, ulong, 0600);
 static bool skip_anon __read_mostly;
 module_param(skip_anon, bool, 0600);
 
+/*
+ * Per-memcg reclamation schemes.
+ *
+ * If this parameter is not empty, DAMON_RECLAIM reclaims cold pages of only
+ * the listed memory cgroups, each under its own aggressiveness, instead of
+ * those of the whole system.  Each entry is
+ * ``<memcg path> <min age in microseconds> <size quota in bytes>``, and
+ * entries are separated by ``;``, e.g.,
+ * ``/apps/cached 5000000 268435456;/apps/bg 30000000 67108864``.  A zero min
+ * age or size quota means ``min_age`` or ``quota_sz``, respectively.  Other
+ * quota and watermarks parameters are shared by all entries.  Memory of
+ * cgroups that are not listed, e.g., that of the foreground app, is left
+ * alone.  By default, empty.
+ */
+static char memcg_schemes[512] __read_mostly;
+module_param_string(memcg_schemes, memcg_schemes, sizeof(memcg_schemes),
+		0600);
+
 /*
  * PID of the DAMON thread
  *
@@ -123,7 +143,11 @@ DEFINE_DAMON_MODULES_DAMOS_STATS_PARAMS(damon_reclaim_stat,
 static struct damon_ctx *ctx;
 static struct damon_target *target;
 
-static struct damos *damon_reclaim_new_scheme(void)
+/* Maximum number of entries in memcg_schemes */
+#define DAMON_RECLAIM_MAX_MEMCGS	8
+
+static struct damos *damon_reclaim_new_scheme(unsigned long age,
+		struct damos_quota *quota)
 {
 	struct damos_access_pattern pattern = {
 		/* Find regions having PAGE_SIZE or larger size */
@@ -132,8 +156,8 @@ static struct damos *damon_reclaim_new_scheme(void)
 		/* and not accessed at all */
 		.min_nr_accesses = 0,
 		.max_nr_accesses = 0,
-		/* for min_age or more micro-seconds */
-		.min_age_region = min_age /
+		/* for age or more micro-seconds */
+		.min_age_region = age /
 			damon_reclaim_mon_attrs.aggr_interval,
 		.max_age_region = UINT_MAX,
 	};
@@ -143,11 +167,93 @@ static struct damos *damon_reclaim_new_scheme(void)
 			/* page out those, as soon as found */
 			DAMOS_PAGEOUT,
 			/* under the quota. */
-			&damon_reclaim_quota,
+			quota,
 			/* (De)activate this according to the watermarks. */
 			&damon_reclaim_wmarks);
 }
 
+static int damon_reclaim_add_filters(struct damos *scheme, bool memcg,
+		unsigned short memcg_id)
+{
+	struct damos_filter *filter;
+
+	if (skip_anon) {
+		filter = damos_new_filter(DAMOS_FILTER_TYPE_ANON, true);
+		if (!filter)
+			return -ENOMEM;
+		damos_add_filter(scheme, filter);
+	}
+	if (memcg) {
+		/* filter out pages that are not of the memcg */
+		filter = damos_new_filter(DAMOS_FILTER_TYPE_MEMCG, false);
+		if (!filter)
+			return -ENOMEM;
+		filter->memcg_id = memcg_id;
+		damos_add_filter(scheme, filter);
+	}
+	return 0;
+}
+
+/*
+ * Parse memcg_schemes into @schemes.  Returns the number of the schemes, or a
+ * negative error code.
+ */
+static int damon_reclaim_new_memcg_schemes(struct damos **schemes)
+{
+	char *buf, *next, *cur;
+	int nr = 0, err = 0;
+
+	buf = kstrdup(memcg_schemes, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	next = buf;
+	while ((cur = strsep(&next, ";\n"))) {
+		struct damos_quota quota = damon_reclaim_quota;
+		unsigned long age, sz;
+		unsigned short memcg_id;
+		char *path;
+		int end = 0;
+
+		cur = skip_spaces(cur);
+		if (!*cur)
+			continue;
+
+		path = strsep(&cur, " \t");
+		if (!cur || sscanf(cur, "%lu %lu %n", &age, &sz, &end) != 2 ||
+				cur[end]) {
+			err = -EINVAL;
+			break;
+		}
+		if (nr == DAMON_RECLAIM_MAX_MEMCGS) {
+			err = -E2BIG;
+			break;
+		}
+		err = damos_memcg_path_to_id(path, &memcg_id);
+		if (err)
+			break;
+
+		if (sz)
+			quota.sz = sz;
+		schemes[nr] = damon_reclaim_new_scheme(age ? : min_age, &quota);
+		if (!schemes[nr]) {
+			err = -ENOMEM;
+			break;
+		}
+		err = damon_reclaim_add_filters(schemes[nr++], true, memcg_id);
+		if (err)
+			break;
+	}
+	kfree(buf);
+
+	if (err) {
+		while (nr--)
+			damon_destroy_scheme(schemes[nr]);
+		return err;
+	}
+	return nr;
+}
+
 static void damon_reclaim_copy_quota_status(struct damos_quota *dst,
 		struct damos_quota *src)
 {
@@ -161,8 +267,9 @@ static void damon_reclaim_copy_quota_status(struct damos_quota *dst,
 
 static int damon_reclaim_apply_parameters(void)
 {
-	struct damos *scheme, *old_scheme;
-	struct damos_filter *filter;
+	struct damos *schemes[DAMON_RECLAIM_MAX_MEMCGS];
+	struct damos *old_scheme;
+	int nr, i = 0;
 	int err = 0;
 
 	err = damon_set_attrs(ctx, &damon_reclaim_mon_attrs);
@@ -170,24 +277,29 @@ static int damon_reclaim_apply_parameters(void)
 		return err;
 
 	/* Will be freed by next 'damon_set_schemes()' below */
-	scheme = damon_reclaim_new_scheme();
-	if (!scheme)
-		return -ENOMEM;
-	if (!list_empty(&ctx->schemes)) {
-		damon_for_each_scheme(old_scheme, ctx)
-			damon_reclaim_copy_quota_status(&scheme->quota,
-					&old_scheme->quota);
-	}
-	if (skip_anon) {
-		filter = damos_new_filter(DAMOS_FILTER_TYPE_ANON, true);
-		if (!filter) {
-			/* Will be freed by next 'damon_set_schemes()' below */
-			damon_destroy_scheme(scheme);
+	nr = damon_reclaim_new_memcg_schemes(schemes);
+	if (nr < 0)
+		return nr;
+	if (!nr) {
+		schemes[0] = damon_reclaim_new_scheme(min_age,
+				&damon_reclaim_quota);
+		if (!schemes[0])
 			return -ENOMEM;
+		nr = 1;
+		err = damon_reclaim_add_filters(schemes[0], false, 0);
+		if (err) {
+			damon_destroy_scheme(schemes[0]);
+			return err;
 		}
-		damos_add_filter(scheme, filter);
 	}
-	damon_set_schemes(ctx, &scheme, 1);
+	/* entries keep their quota charges across updates, by position */
+	damon_for_each_scheme(old_scheme, ctx) {
+		if (i == nr)
+			break;
+		damon_reclaim_copy_quota_status(&schemes[i++]->quota,
+				&old_scheme->quota);
+	}
+	damon_set_schemes(ctx, schemes, nr);
 
 	return damon_set_region_biggest_system_ram_default(target,
 					&monitor_region_start,
@@ -266,11 +378,18 @@ static int damon_reclaim_handle_commit_inputs(void)
 
 static int damon_reclaim_after_aggregation(struct damon_ctx *c)
 {
+	struct damos_stat stat = {};
 	struct damos *s;
 
-	/* update the stats parameter */
-	damon_for_each_scheme(s, c)
-		damon_reclaim_stat = s->stat;
+	/* update the stats parameter, summing those of per-memcg schemes */
+	damon_for_each_scheme(s, c) {
+		stat.nr_tried += s->stat.nr_tried;
+		stat.sz_tried += s->stat.sz_tried;
+		stat.nr_applied += s->stat.nr_applied;
+		stat.sz_applied += s->stat.sz_applied;
+		stat.qt_exceeds += s->stat.qt_exceeds;
+	}
+	damon_reclaim_stat = stat;
 
 	return damon_reclaim_handle_commit_inputs();
 }
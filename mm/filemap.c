@@ -1705,6 +1705,8 @@ vm_fault_t __folio_lock_or_retry(struct folio *folio, struct vm_fault *vmf)
 		if (flags & FAULT_FLAG_RETRY_NOWAIT)
 			return VM_FAULT_RETRY;
 
+		if (flags & FAULT_FLAG_VMA_LOCK)
+			count_vm_vma_lock_event(VMA_LOCK_RETRY_WAIT);
 		release_fault_lock(vmf);
 		if (flags & FAULT_FLAG_KILLABLE)
 			folio_wait_locked_killable(folio);
@@ -3181,6 +3183,8 @@ static struct file *do_sync_mmap_readahead(struct vm_fault *vmf)
 	unsigned long vm_flags = vmf->vma->vm_flags;
 	unsigned int mmap_miss;
 
+	readahead_hints_miss(file, vmf->pgoff, 1);
+
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	/* Use the readahead code, even if readahead is disabled */
 	if (vm_flags & VM_HUGEPAGE) {
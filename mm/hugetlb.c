@@ -6089,6 +6089,7 @@ vm_fault_t hugetlb_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	/* TODO: Handle faults under the VMA lock */
 	if (flags & FAULT_FLAG_VMA_LOCK) {
 		vma_end_read(vma);
+		count_vm_vma_lock_event(VMA_LOCK_RETRY_HUGETLB);
 		return VM_FAULT_RETRY;
 	}
 
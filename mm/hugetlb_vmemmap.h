@@ -28,6 +28,11 @@ static inline unsigned int hugetlb_vmemmap_size(const struct hstate *h)
 /*
  * Return how many vmemmap size associated with a HugeTLB page that can be
  * optimized and can be freed to the buddy allocator.
+ *
+ * Sizes whose struct pages do not fill more than the reserved vmemmap page,
+ * such as the contiguous-PTE sizes on arm64 (64K with 4K base pages, 2M with
+ * 16K or 64K base pages), return 0: their vmemmap page is shared with the
+ * neighbouring HugeTLB pages' struct pages, so there is nothing to free.
  */
 static inline unsigned int hugetlb_vmemmap_optimizable_size(const struct hstate *h)
 {
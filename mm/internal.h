@@ -706,6 +706,7 @@ struct compact_control {
 	bool ignore_block_suitable;	/* Scan blocks considered unsuitable */
 	bool direct_compaction;		/* False from kcompactd or /proc/... */
 	bool proactive_compaction;	/* kcompactd proactive compaction */
+	unsigned int order_target;	/* kcompactd free blocks of order target */
 	bool whole_zone;		/* Whole zone should/has been scanned */
 	bool contended;			/* Signal lock contention */
 	bool finish_pageblock;		/* Scan the remainder of a pageblock. Used
@@ -714,6 +715,8 @@ struct compact_control {
 					 * ensure forward progress.
 					 */
 	bool alloc_contig;		/* alloc_contig_range allocation */
+	struct acr_info *acr_info;	/* alloc_contig_range failure reasons */
+	bool *acr_cancel;		/* alloc_contig_range abandoned */
 };
 
 /*
@@ -1064,6 +1067,15 @@ extern void set_pageblock_order(void);
 unsigned long reclaim_pages(struct list_head *folio_list, bool ignore_references);
 unsigned int reclaim_clean_pages_from_list(struct zone *zone,
 					    struct list_head *folio_list);
+#ifdef CONFIG_LRU_GEN
+unsigned long lru_gen_demote_anon(int nid, unsigned long nr_to_reclaim);
+#else
+static inline unsigned long lru_gen_demote_anon(int nid,
+						unsigned long nr_to_reclaim)
+{
+	return 0;
+}
+#endif
 /* The ALLOC_WMARK bits are used as an index to zone->watermark */
 #define ALLOC_WMARK_MIN		WMARK_MIN
 #define ALLOC_WMARK_LOW		WMARK_LOW
@@ -205,6 +205,8 @@ struct ksm_rmap_item {
 	struct mm_struct *mm;
 	unsigned long address;		/* + low bits used for flags below */
 	unsigned int oldchecksum;	/* when unstable */
+	u8 volatility;			/* scans in a row the page changed */
+	u8 remaining_skips;		/* scans left to skip it for */
 	union {
 		struct rb_node node;	/* when node of unstable tree */
 		struct {		/* when listed from stable tree */
@@ -275,6 +277,22 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Skip pages that keep changing for more scans the longer they do so */
+static bool ksm_smart_scan = true;
+
+/* The number of pages skipped as volatile */
+static unsigned long ksm_pages_skipped;
+
+/*
+ * Share of one CPU, in percent, that ksmd should spend scanning; when
+ * non-zero, pages_to_scan is retuned after every batch to meet it.
+ */
+static unsigned int ksm_advisor_cpu_percent;
+
+#define KSM_VOLATILITY_MAX		4
+#define KSM_ADVISOR_MIN_PAGES		64
+#define KSM_ADVISOR_MAX_PAGES		30000
+
 /* Checksum of an empty (zeroed) page */
 static unsigned int zero_checksum __read_mostly;
 
@@ -2182,9 +2200,15 @@ static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_ite
 	 */
 	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
+		/* A zero oldchecksum is a new rmap_item seen the first time */
+		if (rmap_item->oldchecksum &&
+		    rmap_item->volatility < KSM_VOLATILITY_MAX)
+			rmap_item->volatility++;
+		rmap_item->remaining_skips = (1U << rmap_item->volatility) - 1;
 		rmap_item->oldchecksum = checksum;
 		return;
 	}
+	rmap_item->volatility = 0;
 
 	/*
 	 * Same checksum as an empty page. We attempt to merge it with the
@@ -2308,6 +2332,28 @@ static struct ksm_rmap_item *get_next_rmap_item(struct ksm_mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * A page whose checksum changed on each of its last scans is unlikely to be
+ * stable by the next one, so comparing it again is wasted work: skip it for
+ * 2^volatility - 1 scans, which cmp_and_merge_page() sets when it sees the
+ * change, and go back to scanning it every time once it holds still.
+ */
+static bool should_skip_rmap_item(struct page *page,
+				  struct ksm_rmap_item *rmap_item)
+{
+	if (!ksm_smart_scan || !rmap_item->remaining_skips)
+		return false;
+
+	/* KSM pages need their stable tree checks on every scan */
+	if (PageKsm(page))
+		return false;
+
+	rmap_item->remaining_skips--;
+	remove_rmap_item_from_tree(rmap_item);
+	ksm_pages_skipped++;
+	return true;
+}
+
 static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -2412,6 +2458,8 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 				if (rmap_item) {
 					ksm_scan.rmap_list =
 							&rmap_item->rmap_list;
+					if (should_skip_rmap_item(*page, rmap_item))
+						goto next_page;
 					ksm_scan.address += PAGE_SIZE;
 				} else
 					put_page(*page);
@@ -2503,6 +2551,28 @@ static void ksm_do_scan(unsigned int scan_npages)
 	ksm_pages_scanned += scan_npages - npages;
 }
 
+/*
+ * Retune pages_to_scan so that ksmd's busy share of each scan-and-sleep
+ * period approaches ksm_advisor_cpu_percent.  Batch times are noisy, so
+ * move only a quarter of the way to the new target each time.
+ */
+static void ksm_advisor_tune(u64 scan_ns, unsigned int sleep_ms)
+{
+	unsigned int budget = READ_ONCE(ksm_advisor_cpu_percent);
+	u64 period_ns = scan_ns + (u64)sleep_ms * NSEC_PER_MSEC;
+	unsigned long pages = ksm_thread_pages_to_scan;
+	u64 target;
+
+	if (!budget || !scan_ns)
+		return;
+
+	target = div64_u64((u64)pages * budget * period_ns, 100 * scan_ns);
+	pages = pages - pages / 4 + min_t(u64, target, KSM_ADVISOR_MAX_PAGES) / 4;
+	ksm_thread_pages_to_scan = clamp_t(unsigned long, pages,
+					   KSM_ADVISOR_MIN_PAGES,
+					   KSM_ADVISOR_MAX_PAGES);
+}
+
 static int ksmd_should_run(void)
 {
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.slot.mm_node);
@@ -2516,10 +2586,18 @@ static int ksm_scan_thread(void *nothing)
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
+		u64 scan_ns = 0;
+
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
+			u64 start = ktime_get_ns();
+
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			scan_ns = ktime_get_ns() - start;
+			ksm_advisor_tune(scan_ns,
+					 READ_ONCE(ksm_thread_sleep_millisecs));
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
@@ -3303,6 +3381,54 @@ static ssize_t use_zero_pages_store(struct kobject *kobj,
 }
 KSM_ATTR(use_zero_pages);
 
+static ssize_t smart_scan_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_smart_scan);
+}
+
+static ssize_t smart_scan_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	int err;
+	bool value;
+
+	err = kstrtobool(buf, &value);
+	if (err)
+		return -EINVAL;
+
+	ksm_smart_scan = value;
+
+	return count;
+}
+KSM_ATTR(smart_scan);
+
+static ssize_t advisor_cpu_percent_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_advisor_cpu_percent);
+}
+
+static ssize_t advisor_cpu_percent_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned int percent;
+	int err;
+
+	err = kstrtouint(buf, 10, &percent);
+	if (err)
+		return -EINVAL;
+	if (percent > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(ksm_advisor_cpu_percent, percent);
+
+	return count;
+}
+KSM_ATTR(advisor_cpu_percent);
+
 static ssize_t max_page_sharing_show(struct kobject *kobj,
 				     struct kobj_attribute *attr, char *buf)
 {
@@ -3351,6 +3477,13 @@ static ssize_t pages_scanned_show(struct kobject *kobj,
 }
 KSM_ATTR_RO(pages_scanned);
 
+static ssize_t pages_skipped_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%lu\n", ksm_pages_skipped);
+}
+KSM_ATTR_RO(pages_skipped);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
@@ -3475,6 +3608,9 @@ static struct attribute *ksm_attrs[] = {
 	&stable_node_chains_prune_millisecs_attr.attr,
 	&use_zero_pages_attr.attr,
 	&general_profit_attr.attr,
+	&smart_scan_attr.attr,
+	&pages_skipped_attr.attr,
+	&advisor_cpu_percent_attr.attr,
 	NULL,
 };
 
@@ -81,6 +81,16 @@ list_lru_from_kmem(struct list_lru *lru, int nid, void *ptr,
 		*memcg_ptr = memcg;
 	return l;
 }
+
+static inline struct list_lru_one *
+list_lru_from_memcg(struct list_lru *lru, int nid, struct mem_cgroup *memcg)
+{
+	struct list_lru_one *l = NULL;
+
+	if (memcg && list_lru_memcg_aware(lru))
+		l = list_lru_from_memcg_idx(lru, nid, memcg_kmem_id(memcg));
+	return l ?: &lru->node[nid].lru;
+}
 #else
 static void list_lru_register(struct list_lru *lru)
 {
@@ -114,6 +124,12 @@ list_lru_from_kmem(struct list_lru *lru, int nid, void *ptr,
 		*memcg_ptr = NULL;
 	return &lru->node[nid].lru;
 }
+
+static inline struct list_lru_one *
+list_lru_from_memcg(struct list_lru *lru, int nid, struct mem_cgroup *memcg)
+{
+	return &lru->node[nid].lru;
+}
 #endif /* CONFIG_MEMCG_KMEM */
 
 bool list_lru_add(struct list_lru *lru, struct list_head *item)
@@ -160,6 +176,48 @@ bool list_lru_del(struct list_lru *lru, struct list_head *item)
 }
 EXPORT_SYMBOL_GPL(list_lru_del);
 
+bool list_lru_add_memcg(struct list_lru *lru, struct list_head *item, int nid,
+			struct mem_cgroup *memcg)
+{
+	struct list_lru_node *nlru = &lru->node[nid];
+	struct list_lru_one *l;
+
+	spin_lock(&nlru->lock);
+	if (list_empty(item)) {
+		l = list_lru_from_memcg(lru, nid, memcg);
+		list_add_tail(item, &l->list);
+		/* Set shrinker bit if the first element was added */
+		if (!l->nr_items++)
+			set_shrinker_bit(memcg, nid, lru_shrinker_id(lru));
+		nlru->nr_items++;
+		spin_unlock(&nlru->lock);
+		return true;
+	}
+	spin_unlock(&nlru->lock);
+	return false;
+}
+EXPORT_SYMBOL_GPL(list_lru_add_memcg);
+
+bool list_lru_del_memcg(struct list_lru *lru, struct list_head *item, int nid,
+			struct mem_cgroup *memcg)
+{
+	struct list_lru_node *nlru = &lru->node[nid];
+	struct list_lru_one *l;
+
+	spin_lock(&nlru->lock);
+	if (!list_empty(item)) {
+		l = list_lru_from_memcg(lru, nid, memcg);
+		list_del_init(item);
+		l->nr_items--;
+		nlru->nr_items--;
+		spin_unlock(&nlru->lock);
+		return true;
+	}
+	spin_unlock(&nlru->lock);
+	return false;
+}
+EXPORT_SYMBOL_GPL(list_lru_del_memcg);
+
 void list_lru_isolate(struct list_lru_one *list, struct list_head *item)
 {
 	list_del_init(item);
@@ -33,6 +33,9 @@
 #include <linux/swapops.h>
 #include <linux/shmem_fs.h>
 #include <linux/mmu_notifier.h>
+#include <linux/anon_inodes.h>
+#include <linux/poll.h>
+#include <linux/workqueue.h>
 #include <trace/hooks/mm.h>
 
 #include <asm/tlb.h>
@@ -45,6 +48,7 @@
 struct madvise_walk_private {
 	struct mmu_gather *tlb;
 	bool pageout;
+	unsigned long nr_reclaimed;
 };
 
 /*
@@ -447,7 +451,7 @@ static int madvise_cold_or_pageout_pte_range(pmd_t *pmd,
 huge_unlock:
 		spin_unlock(ptl);
 		if (pageout)
-			reclaim_pages(&folio_list, true);
+			private->nr_reclaimed += reclaim_pages(&folio_list, true);
 		return 0;
 	}
 
@@ -567,7 +571,7 @@ static int madvise_cold_or_pageout_pte_range(pmd_t *pmd,
 		pte_unmap_unlock(start_pte, ptl);
 	}
 	if (pageout)
-		reclaim_pages(&folio_list, true);
+		private->nr_reclaimed += reclaim_pages(&folio_list, true);
 	cond_resched();
 
 	return 0;
@@ -578,6 +582,11 @@ static const struct mm_walk_ops cold_walk_ops = {
 	.walk_lock = PGWALK_RDLOCK,
 };
 
+static const struct mm_walk_ops cold_vma_walk_ops = {
+	.pmd_entry = madvise_cold_or_pageout_pte_range,
+	.walk_lock = PGWALK_VMA_RDLOCK_VERIFY,
+};
+
 static void madvise_cold_page_range(struct mmu_gather *tlb,
 			     struct vm_area_struct *vma,
 			     unsigned long addr, unsigned long end)
@@ -809,8 +818,14 @@ static const struct mm_walk_ops madvise_free_walk_ops = {
 	.walk_lock		= PGWALK_RDLOCK,
 };
 
+static const struct mm_walk_ops madvise_free_vma_walk_ops = {
+	.pmd_entry		= madvise_free_pte_range,
+	.walk_lock		= PGWALK_VMA_RDLOCK_VERIFY,
+};
+
 static int madvise_free_single_vma(struct vm_area_struct *vma,
-			unsigned long start_addr, unsigned long end_addr)
+			unsigned long start_addr, unsigned long end_addr,
+			const struct mm_walk_ops *ops)
 {
 	struct mm_struct *mm = vma->vm_mm;
 	struct mmu_notifier_range range;
@@ -835,8 +850,7 @@ static int madvise_free_single_vma(struct vm_area_struct *vma,
 
 	mmu_notifier_invalidate_range_start(&range);
 	tlb_start_vma(&tlb, vma);
-	walk_page_range(vma->vm_mm, range.start, range.end,
-			&madvise_free_walk_ops, &tlb);
+	walk_page_range_vma(vma, range.start, range.end, ops, &tlb);
 	tlb_end_vma(&tlb, vma);
 	mmu_notifier_invalidate_range_end(&range);
 	tlb_finish_mmu(&tlb);
@@ -951,11 +965,65 @@ static long madvise_dontneed_free(struct vm_area_struct *vma,
 	if (behavior == MADV_DONTNEED || behavior == MADV_DONTNEED_LOCKED)
 		return madvise_dontneed_single_vma(vma, start, end);
 	else if (behavior == MADV_FREE)
-		return madvise_free_single_vma(vma, start, end);
+		return madvise_free_single_vma(vma, start, end,
+					       &madvise_free_walk_ops);
 	else
 		return -EINVAL;
 }
 
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * MADV_DONTNEED and MADV_FREE of an anonymous range within one VMA only need
+ * that VMA to be stable, so try them under the per-VMA lock: a GC releasing
+ * its heap then doesn't queue behind, or hold up, mmap_lock users.  Anything
+ * else - several VMAs, file or hugetlb mappings, userfaultfd - goes through
+ * the mmap_lock path as before.
+ *
+ * Returns -EAGAIN if the caller must fall back to mmap_lock.
+ */
+static int madvise_dontneed_free_vma_locked(struct mm_struct *mm,
+					    unsigned long start,
+					    unsigned long end, int behavior)
+{
+	struct vm_area_struct *vma;
+	int error = 0;
+
+	if (behavior != MADV_DONTNEED && behavior != MADV_DONTNEED_LOCKED &&
+	    behavior != MADV_FREE)
+		return -EAGAIN;
+
+	vma = lock_vma_under_rcu(mm, start);
+	if (!vma)
+		return -EAGAIN;
+
+	if (end > vma->vm_end || !vma_is_anonymous(vma) ||
+	    is_vm_hugetlb_page(vma) || userfaultfd_armed(vma)) {
+		vma_end_read(vma);
+		count_vm_vma_lock_event(VMA_LOCK_MADVISE_FALLBACK);
+		return -EAGAIN;
+	}
+
+	if (!madvise_dontneed_free_valid_vma(vma, start, &end, behavior))
+		error = -EINVAL;
+	else if (behavior == MADV_FREE)
+		error = madvise_free_single_vma(vma, start, end,
+						&madvise_free_vma_walk_ops);
+	else
+		zap_page_range_single(vma, start, end - start, NULL);
+	vma_end_read(vma);
+	count_vm_vma_lock_event(VMA_LOCK_MADVISE);
+
+	return error;
+}
+#else
+static int madvise_dontneed_free_vma_locked(struct mm_struct *mm,
+					    unsigned long start,
+					    unsigned long end, int behavior)
+{
+	return -EAGAIN;
+}
+#endif /* CONFIG_PER_VMA_LOCK */
+
 static long madvise_populate(struct vm_area_struct *vma,
 			     struct vm_area_struct **prev,
 			     unsigned long start, unsigned long end,
@@ -1469,6 +1537,14 @@ int do_madvise(struct mm_struct *mm, unsigned long start, size_t len_in, int beh
 		return madvise_inject_error(behavior, start, start + len_in);
 #endif
 
+	if (mm == current->mm) {
+		error = madvise_dontneed_free_vma_locked(mm,
+				untagged_addr(start), untagged_addr(start) + len,
+				behavior);
+		if (error != -EAGAIN)
+			return error;
+	}
+
 	write = madvise_need_mmap_write(behavior);
 	if (write) {
 		if (mmap_write_lock_killable(mm))
@@ -1497,6 +1573,265 @@ SYSCALL_DEFINE3(madvise, unsigned long, start, size_t, len_in, int, behavior)
 	return do_madvise(current->mm, start, len_in, behavior);
 }
 
+/*
+ * Asynchronous process_madvise(PMADV_ASYNC) for MADV_COLD and MADV_PAGEOUT.
+ *
+ * The ranges are copied and handed to a worker on the target task's node, and
+ * the caller gets back an fd which becomes readable, returning a struct
+ * pmadv_async_result, once all of them have been handled.  The worker takes
+ * the per-VMA lock where it can, so faults of the target on other VMAs are not
+ * held up behind mmap_lock for the duration of the walk; closing the fd stops
+ * it at the next VMA.
+ */
+struct madvise_async_req {
+	struct work_struct work;
+	struct mm_struct *mm;
+	const struct cred *cred;
+	int behavior;
+	unsigned long nr_vecs;
+	struct iovec *vec;
+
+	struct pmadv_async_result result;
+	bool done;
+	bool cancelled;
+	wait_queue_head_t wait;
+	refcount_t ref;
+};
+
+static struct workqueue_struct *madvise_async_wq;
+
+static void madvise_async_put(struct madvise_async_req *req)
+{
+	if (refcount_dec_and_test(&req->ref)) {
+		put_cred(req->cred);
+		kfree(req->vec);
+		kfree(req);
+	}
+}
+
+static int madvise_async_vma(struct madvise_async_req *req,
+			     struct vm_area_struct *vma, unsigned long start,
+			     unsigned long end, const struct mm_walk_ops *ops)
+{
+	struct madvise_walk_private walk_private = {
+		.pageout = req->behavior == MADV_PAGEOUT,
+	};
+	struct mmu_gather tlb;
+
+	if (!can_madv_lru_vma(vma))
+		return -EINVAL;
+
+	/* see madvise_pageout() */
+	if (walk_private.pageout && !vma_is_anonymous(vma) &&
+	    !can_do_file_pageout(vma) && (vma->vm_flags & VM_MAYSHARE))
+		return 0;
+
+	lru_add_drain();
+	tlb_gather_mmu(&tlb, req->mm);
+	walk_private.tlb = &tlb;
+	tlb_start_vma(&tlb, vma);
+	walk_page_range_vma(vma, start, end, ops, &walk_private);
+	tlb_end_vma(&tlb, vma);
+	tlb_finish_mmu(&tlb);
+
+	req->result.nr_reclaimed += walk_private.nr_reclaimed << PAGE_SHIFT;
+	return 0;
+}
+
+static int madvise_async_range(struct madvise_async_req *req,
+			       unsigned long start, unsigned long end)
+{
+	struct mm_struct *mm = req->mm;
+	struct vm_area_struct *vma;
+	unsigned long next;
+	int unmapped_error = 0;
+	int error;
+
+	while (start < end) {
+		if (READ_ONCE(req->cancelled))
+			return -EINTR;
+
+		vma = lock_vma_under_rcu(mm, start);
+		if (vma) {
+			next = min(end, vma->vm_end);
+			error = madvise_async_vma(req, vma, start, next,
+						  &cold_vma_walk_ops);
+			vma_end_read(vma);
+		} else {
+			mmap_read_lock(mm);
+			vma = find_vma(mm, start);
+			if (!vma || vma->vm_start >= end) {
+				mmap_read_unlock(mm);
+				return -ENOMEM;
+			}
+			if (start < vma->vm_start) {
+				unmapped_error = -ENOMEM;
+				start = vma->vm_start;
+			}
+			next = min(end, vma->vm_end);
+			error = madvise_async_vma(req, vma, start, next,
+						  &cold_walk_ops);
+			mmap_read_unlock(mm);
+		}
+		if (error)
+			return error;
+
+		req->result.nr_bytes += next - start;
+		start = next;
+		cond_resched();
+	}
+
+	return unmapped_error;
+}
+
+static void madvise_async_workfn(struct work_struct *work)
+{
+	struct madvise_async_req *req = container_of(work,
+					struct madvise_async_req, work);
+	const struct cred *old_cred;
+	unsigned long i, start, len;
+	int error = 0;
+
+	/* can_do_file_pageout() checks the credentials of the caller */
+	old_cred = override_creds(req->cred);
+	for (i = 0; i < req->nr_vecs && !error; i++) {
+		start = (unsigned long)req->vec[i].iov_base;
+		len = __PAGE_ALIGN(req->vec[i].iov_len);
+
+		if (!__PAGE_ALIGNED(start) || (req->vec[i].iov_len && !len) ||
+		    start + len < start)
+			error = -EINVAL;
+		else
+			error = madvise_async_range(req, start, start + len);
+	}
+	revert_creds(old_cred);
+
+	mmput(req->mm);
+	req->mm = NULL;
+
+	req->result.error = error;
+	/* publish the result before done, see madvise_async_read() */
+	smp_store_release(&req->done, true);
+	wake_up_all(&req->wait);
+	madvise_async_put(req);
+}
+
+static ssize_t madvise_async_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct madvise_async_req *req = file->private_data;
+	int ret;
+
+	if (count < sizeof(req->result))
+		return -EINVAL;
+
+	if (!smp_load_acquire(&req->done)) {
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(req->wait,
+					       smp_load_acquire(&req->done));
+		if (ret)
+			return ret;
+	}
+
+	if (copy_to_user(buf, &req->result, sizeof(req->result)))
+		return -EFAULT;
+
+	return sizeof(req->result);
+}
+
+static __poll_t madvise_async_poll(struct file *file, poll_table *wait)
+{
+	struct madvise_async_req *req = file->private_data;
+
+	poll_wait(file, &req->wait, wait);
+
+	return smp_load_acquire(&req->done) ? EPOLLIN | EPOLLRDNORM : 0;
+}
+
+static int madvise_async_release(struct inode *inode, struct file *file)
+{
+	struct madvise_async_req *req = file->private_data;
+
+	WRITE_ONCE(req->cancelled, true);
+	madvise_async_put(req);
+	return 0;
+}
+
+static const struct file_operations madvise_async_fops = {
+	.read		= madvise_async_read,
+	.poll		= madvise_async_poll,
+	.release	= madvise_async_release,
+	.llseek		= noop_llseek,
+};
+
+/*
+ * On success the request takes over the mm reference and the fd is returned,
+ * on failure the caller still owns @mm.
+ */
+static int process_madvise_async(struct task_struct *task,
+				 struct mm_struct *mm, struct iov_iter *iter,
+				 int behavior)
+{
+	struct madvise_async_req *req;
+	unsigned long i;
+	int fd;
+
+	if (behavior != MADV_COLD && behavior != MADV_PAGEOUT)
+		return -EINVAL;
+	if (!madvise_async_wq)
+		return -ENOMEM;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+
+	req->nr_vecs = iter->nr_segs;
+	req->vec = kmemdup(iter_iov(iter), req->nr_vecs * sizeof(struct iovec),
+			   GFP_KERNEL);
+	if (!req->vec) {
+		kfree(req);
+		return -ENOMEM;
+	}
+
+	/* untagging needs the mm of the target, do it while we are here */
+	mmap_read_lock(mm);
+	for (i = 0; i < req->nr_vecs; i++)
+		req->vec[i].iov_base = (void __user *)untagged_addr_remote(mm,
+				(unsigned long)req->vec[i].iov_base);
+	mmap_read_unlock(mm);
+
+	req->behavior = behavior;
+	req->cred = get_current_cred();
+	init_waitqueue_head(&req->wait);
+	INIT_WORK(&req->work, madvise_async_workfn);
+	/* one for the fd and one for the work */
+	refcount_set(&req->ref, 2);
+
+	fd = anon_inode_getfd("[process_madvise]", &madvise_async_fops, req,
+			      O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		put_cred(req->cred);
+		kfree(req->vec);
+		kfree(req);
+		return fd;
+	}
+
+	req->mm = mm;
+	queue_work_node(cpu_to_node(task_cpu(task)), madvise_async_wq,
+			&req->work);
+
+	return fd;
+}
+
+static int __init madvise_async_init(void)
+{
+	madvise_async_wq = alloc_workqueue("madvise_async",
+					   WQ_UNBOUND | WQ_FREEZABLE, 0);
+	return madvise_async_wq ? 0 : -ENOMEM;
+}
+subsys_initcall(madvise_async_init);
+
 SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
 		size_t, vlen, int, behavior, unsigned int, flags)
 {
@@ -1509,7 +1844,7 @@ SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
 	size_t total_len;
 	unsigned int f_flags;
 
-	if (flags != 0) {
+	if (flags & ~PMADV_ASYNC) {
 		ret = -EINVAL;
 		goto out;
 	}
@@ -1545,6 +1880,13 @@ SYSCALL_DEFINE5(process_madvise, int, pidfd, const struct iovec __user *, vec,
 		goto release_mm;
 	}
 
+	if (flags & PMADV_ASYNC) {
+		ret = process_madvise_async(task, mm, &iter, behavior);
+		if (ret < 0)
+			goto release_mm;
+		goto release_task;
+	}
+
 	total_len = iov_iter_count(&iter);
 
 	while (iov_iter_count(&iter)) {
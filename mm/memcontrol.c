@@ -64,6 +64,7 @@
 #include <linux/psi.h>
 #include <linux/seq_buf.h>
 #include <linux/sched/isolation.h>
+#include <linux/zswap.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
@@ -735,6 +736,8 @@ static void do_flush_stats(struct mem_cgroup *memcg)
 {
 	if (mem_cgroup_is_root(memcg))
 		WRITE_ONCE(flush_last_time, jiffies_64);
+	else
+		WRITE_ONCE(memcg->stats_flush_last, jiffies);
 
 	cgroup_rstat_flush(memcg->css.cgroup);
 }
@@ -760,6 +763,24 @@ void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
 		do_flush_stats(memcg);
 }
 
+#define MEMCG_STAT_STALE_MAX_MS	60000
+
+static u64 mem_cgroup_stat_stale_read(struct cgroup_subsys_state *css,
+				      struct cftype *cft)
+{
+	return READ_ONCE(mem_cgroup_from_css(css)->stat_stale_ms);
+}
+
+static int mem_cgroup_stat_stale_write(struct cgroup_subsys_state *css,
+				       struct cftype *cft, u64 val)
+{
+	if (val > MEMCG_STAT_STALE_MAX_MS)
+		return -EINVAL;
+
+	WRITE_ONCE(mem_cgroup_from_css(css)->stat_stale_ms, val);
+	return 0;
+}
+
 void mem_cgroup_flush_stats_ratelimited(struct mem_cgroup *memcg)
 {
 	/* Only flush if the periodic flusher is one full cycle late */
@@ -767,6 +788,26 @@ void mem_cgroup_flush_stats_ratelimited(struct mem_cgroup *memcg)
 		mem_cgroup_flush_stats(memcg);
 }
 
+/*
+ * Flush before a userspace stat read. A group that opted into stale reads
+ * through memory.stat_stale_ms is not flushed again if its subtree, or the
+ * whole tree by the periodic flusher, was flushed within that window.
+ */
+static void mem_cgroup_flush_stats_read(struct mem_cgroup *memcg)
+{
+	unsigned int stale_ms = READ_ONCE(memcg->stat_stale_ms);
+
+	if (stale_ms) {
+		unsigned long window = msecs_to_jiffies(stale_ms);
+
+		if (time_before64(jiffies_64, READ_ONCE(flush_last_time) + window) ||
+		    time_before(jiffies, READ_ONCE(memcg->stats_flush_last) + window))
+			return;
+	}
+
+	mem_cgroup_flush_stats(memcg);
+}
+
 static void flush_memcg_stats_dwork(struct work_struct *w)
 {
 	/*
@@ -1623,8 +1664,6 @@ static void memcg_stat_format(struct mem_cgroup *memcg, struct seq_buf *s)
 	 *
 	 * Current memory state:
 	 */
-	mem_cgroup_flush_stats(memcg);
-
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		u64 size;
 
@@ -1664,6 +1703,7 @@ static void memcg_stat_format(struct mem_cgroup *memcg, struct seq_buf *s)
 
 static void memcg1_stat_format(struct mem_cgroup *memcg, struct seq_buf *s);
 
+/* The caller is expected to have flushed the stats of @memcg */
 static void memory_stat_format(struct mem_cgroup *memcg, struct seq_buf *s)
 {
 	if (cgroup_subsys_on_dfl(memory_cgrp_subsys))
@@ -1731,6 +1771,7 @@ void mem_cgroup_print_oom_meminfo(struct mem_cgroup *memcg)
 	pr_cont_cgroup_path(memcg->css.cgroup);
 	pr_cont(":");
 	seq_buf_init(&s, buf, sizeof(buf));
+	mem_cgroup_flush_stats(memcg);
 	memory_stat_format(memcg, &s);
 	seq_buf_do_printk(&s, KERN_INFO);
 }
@@ -4120,7 +4161,7 @@ static int memcg_numa_stat_show(struct seq_file *m, void *v)
 	int nid;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats(memcg);
+	mem_cgroup_flush_stats_read(memcg);
 
 	for (stat = stats; stat < stats + ARRAY_SIZE(stats); stat++) {
 		seq_printf(m, "%s=%lu", stat->name,
@@ -4195,8 +4236,6 @@ static void memcg1_stat_format(struct mem_cgroup *memcg, struct seq_buf *s)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 
-	mem_cgroup_flush_stats(memcg);
-
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		unsigned long nr;
 
@@ -5140,6 +5179,11 @@ static struct cftype mem_cgroup_legacy_files[] = {
 		.name = "stat",
 		.seq_show = memory_stat_show,
 	},
+	{
+		.name = "stat_stale_ms",
+		.read_u64 = mem_cgroup_stat_stale_read,
+		.write_u64 = mem_cgroup_stat_stale_write,
+	},
 	{
 		.name = "force_empty",
 		.write = mem_cgroup_force_empty_write,
@@ -5370,6 +5414,7 @@ static void __mem_cgroup_free(struct mem_cgroup *memcg)
 		free_mem_cgroup_per_node_info(memcg, node);
 	kfree(memcg->vmstats);
 	free_percpu(memcg->vmstats_percpu);
+	free_percpu(memcg->refault_stat);
 	kfree(memcg);
 }
 
@@ -5408,6 +5453,12 @@ static struct mem_cgroup *mem_cgroup_alloc(struct mem_cgroup *parent)
 	if (!memcg->vmstats_percpu)
 		goto fail;
 
+	memcg->refault_stat = alloc_percpu_gfp(struct memcg_refault_stat,
+					       GFP_KERNEL_ACCOUNT);
+	if (!memcg->refault_stat)
+		goto fail;
+	memcg->launch_window_ms = 5000;
+
 	for_each_possible_cpu(cpu) {
 		if (parent)
 			pstatc = per_cpu_ptr(parent->vmstats_percpu, cpu);
@@ -5608,6 +5659,16 @@ static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
 #endif
 
 	vmpressure_cleanup(&memcg->vmpressure);
+
+#if defined(CONFIG_MEMCG_KMEM) && defined(CONFIG_ZSWAP)
+	if (rcu_access_pointer(memcg->zswap_compressor)) {
+		const char *name = rcu_dereference_protected(
+					memcg->zswap_compressor, true);
+
+		zswap_compressor_put(name);
+		kfree(name);
+	}
+#endif
 	cancel_work_sync(&memcg->high_work);
 	mem_cgroup_remove_from_trees(memcg);
 	free_shrinker_info(memcg);
@@ -6730,6 +6791,7 @@ static int memory_stat_show(struct seq_file *m, void *v)
 	if (!buf)
 		return -ENOMEM;
 	seq_buf_init(&s, buf, PAGE_SIZE);
+	mem_cgroup_flush_stats_read(memcg);
 	memory_stat_format(memcg, &s);
 	seq_puts(m, buf);
 	kfree(buf);
@@ -6748,7 +6810,7 @@ static int memory_numa_stat_show(struct seq_file *m, void *v)
 	int i;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats(memcg);
+	mem_cgroup_flush_stats_read(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		int nid;
@@ -6804,6 +6866,116 @@ static ssize_t memory_oom_group_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+#ifdef CONFIG_LRU_GEN
+static const char *const lru_gen_hint_names[] = {
+	[LRU_GEN_HINT_NONE] = "default",
+	[LRU_GEN_HINT_FOREGROUND] = "foreground",
+	[LRU_GEN_HINT_BACKGROUND] = "background",
+};
+
+static int memory_lru_gen_hint_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+
+	seq_printf(m, "%s\n", lru_gen_hint_names[READ_ONCE(memcg->lru_gen_hint)]);
+
+	return 0;
+}
+
+static ssize_t memory_lru_gen_hint_write(struct kernfs_open_file *of,
+					 char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	int hint;
+
+	hint = sysfs_match_string(lru_gen_hint_names, strstrip(buf));
+	if (hint < 0)
+		return hint;
+
+	lru_gen_hint_memcg(memcg, hint);
+	if (hint == LRU_GEN_HINT_FOREGROUND)
+		WRITE_ONCE(memcg->fg_since, jiffies ?: 1);
+
+	return nbytes;
+}
+#endif
+
+/*
+ * Refaults are bucketed by their refault distance: with the multi-gen LRU by
+ * how many generations old the evicted folio was, otherwise by the log2 of
+ * the nonresident age in steps of 256 pages.
+ */
+void mem_cgroup_account_refault(struct mem_cgroup *memcg, bool file,
+				unsigned int bucket, long nr)
+{
+	struct memcg_refault_stat *stat;
+	unsigned long since;
+
+	if (mem_cgroup_disabled() || !memcg)
+		return;
+
+	bucket = min_t(unsigned int, bucket, MEMCG_REFAULT_BUCKETS - 1);
+	stat = get_cpu_ptr(memcg->refault_stat);
+	stat->dist[file][bucket] += nr;
+	since = READ_ONCE(memcg->fg_since);
+	if (since && time_before(jiffies, since +
+			msecs_to_jiffies(READ_ONCE(memcg->launch_window_ms))))
+		stat->launch[file] += nr;
+	put_cpu_ptr(memcg->refault_stat);
+}
+
+static int memory_refault_stat_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	unsigned long dist[2][MEMCG_REFAULT_BUCKETS] = {};
+	unsigned long launch[2] = {};
+	struct memcg_refault_stat *stat;
+	int cpu, type, i;
+
+	for_each_possible_cpu(cpu) {
+		stat = per_cpu_ptr(memcg->refault_stat, cpu);
+		for (type = 0; type < 2; type++) {
+			for (i = 0; i < MEMCG_REFAULT_BUCKETS; i++)
+				dist[type][i] += READ_ONCE(stat->dist[type][i]);
+			launch[type] += READ_ONCE(stat->launch[type]);
+		}
+	}
+
+	for (type = 0; type < 2; type++) {
+		seq_printf(m, "%s_distance", type ? "file" : "anon");
+		for (i = 0; i < MEMCG_REFAULT_BUCKETS; i++)
+			seq_printf(m, " %lu", dist[type][i]);
+		seq_putc(m, '\n');
+	}
+	seq_printf(m, "anon_launch %lu\n", launch[0]);
+	seq_printf(m, "file_launch %lu\n", launch[1]);
+	seq_printf(m, "launch_window_ms %u\n", READ_ONCE(memcg->launch_window_ms));
+
+	return 0;
+}
+
+/* "reset" clears the counters, a number sets the launch window and resets */
+static ssize_t memory_refault_stat_write(struct kernfs_open_file *of,
+					 char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int window_ms;
+	int cpu;
+
+	buf = strstrip(buf);
+	if (strcmp(buf, "reset")) {
+		if (kstrtouint(buf, 10, &window_ms))
+			return -EINVAL;
+		WRITE_ONCE(memcg->launch_window_ms, window_ms);
+	}
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(memcg->refault_stat, cpu), 0,
+		       sizeof(struct memcg_refault_stat));
+
+	return nbytes;
+}
+
 static ssize_t memory_reclaim(struct kernfs_open_file *of, char *buf,
 			      size_t nbytes, loff_t off)
 {
@@ -6898,6 +7070,12 @@ static struct cftype memory_files[] = {
 		.name = "stat",
 		.seq_show = memory_stat_show,
 	},
+	{
+		.name = "stat_stale_ms",
+		.flags = CFTYPE_NS_DELEGATABLE,
+		.read_u64 = mem_cgroup_stat_stale_read,
+		.write_u64 = mem_cgroup_stat_stale_write,
+	},
 #ifdef CONFIG_NUMA
 	{
 		.name = "numa_stat",
@@ -6910,6 +7088,20 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_oom_group_show,
 		.write = memory_oom_group_write,
 	},
+#ifdef CONFIG_LRU_GEN
+	{
+		.name = "lru_gen_hint",
+		.flags = CFTYPE_NOT_ON_ROOT | CFTYPE_NS_DELEGATABLE,
+		.seq_show = memory_lru_gen_hint_show,
+		.write = memory_lru_gen_hint_write,
+	},
+#endif
+	{
+		.name = "refault_stat",
+		.flags = CFTYPE_NOT_ON_ROOT | CFTYPE_NS_DELEGATABLE,
+		.seq_show = memory_refault_stat_show,
+		.write = memory_refault_stat_write,
+	},
 	{
 		.name = "reclaim",
 		.flags = CFTYPE_NS_DELEGATABLE,
@@ -7175,15 +7367,14 @@ int mem_cgroup_swapin_charge_folio(struct folio *folio, struct mm_struct *mm,
 }
 
 /*
- * mem_cgroup_swapin_uncharge_swap - uncharge swap slot
- * @entry: swap entry for which the page is charged
+ * mem_cgroup_swapin_uncharge_swap - uncharge swap slots
+ * @entry: the first swap entry for which the folio is charged
+ * @nr_pages: number of pages which will be uncharged
  *
- * Call this function after successfully adding the charged page to swapcache.
- *
- * Note: This function assumes the page for which swap slot is being uncharged
- * is order 0 page.
+ * Call this function after successfully adding the charged folio to
+ * swapcache, or after reading it in without the swapcache.
  */
-void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry)
+void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry, unsigned int nr_pages)
 {
 	/*
 	 * Cgroup1's unified memory+swap counter has been charged with the
@@ -7203,7 +7394,7 @@ void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry)
 		 * let's not wait for it.  The page already received a
 		 * memory+swap charge, drop the swap entry duplicate.
 		 */
-		mem_cgroup_uncharge_swap(entry, 1);
+		mem_cgroup_uncharge_swap(entry, nr_pages);
 	}
 }
 
@@ -7926,6 +8117,40 @@ bool obj_cgroup_may_zswap(struct obj_cgroup *objcg)
 	return ret;
 }
 
+/**
+ * obj_cgroup_zswap_compressor - get the zswap compressor for a cgroup
+ * @objcg: the object cgroup
+ * @buf: buffer for the compressor name
+ * @len: size of @buf
+ *
+ * Look up the compressor selected through memory.zswap.compressor by the
+ * cgroup or its closest ancestor that has one. Returns false if none of
+ * them did, in which case zswap uses its global compressor.
+ */
+bool obj_cgroup_zswap_compressor(struct obj_cgroup *objcg, char *buf,
+				 size_t len)
+{
+	struct mem_cgroup *memcg, *original_memcg;
+	const char *name = NULL;
+
+	if (!cgroup_subsys_on_dfl(memory_cgrp_subsys))
+		return false;
+
+	original_memcg = get_mem_cgroup_from_objcg(objcg);
+	rcu_read_lock();
+	for (memcg = original_memcg; !mem_cgroup_is_root(memcg);
+	     memcg = parent_mem_cgroup(memcg)) {
+		name = rcu_dereference(memcg->zswap_compressor);
+		if (name) {
+			strscpy(buf, name, len);
+			break;
+		}
+	}
+	rcu_read_unlock();
+	mem_cgroup_put(original_memcg);
+	return name;
+}
+
 /**
  * obj_cgroup_charge_zswap - charge compression backend memory
  * @objcg: the object cgroup
@@ -8009,6 +8234,59 @@ static ssize_t zswap_max_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+static DEFINE_MUTEX(zswap_compressor_lock);
+
+static int zswap_compressor_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	const char *name;
+
+	rcu_read_lock();
+	name = rcu_dereference(memcg->zswap_compressor);
+	seq_printf(m, "%s\n", name ?: "default");
+	rcu_read_unlock();
+
+	return 0;
+}
+
+static ssize_t zswap_compressor_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	const char *old;
+	char *name = NULL;
+	int err;
+
+	buf = strstrip(buf);
+	if (!*buf)
+		return -EINVAL;
+
+	if (strcmp(buf, "default")) {
+		name = kstrdup(buf, GFP_KERNEL);
+		if (!name)
+			return -ENOMEM;
+		/* makes sure a pool for the compressor exists */
+		err = zswap_compressor_get(name);
+		if (err) {
+			kfree(name);
+			return err;
+		}
+	}
+
+	mutex_lock(&zswap_compressor_lock);
+	old = rcu_replace_pointer(memcg->zswap_compressor, name,
+				  lockdep_is_held(&zswap_compressor_lock));
+	mutex_unlock(&zswap_compressor_lock);
+
+	if (old) {
+		synchronize_rcu();
+		zswap_compressor_put(old);
+		kfree(old);
+	}
+
+	return nbytes;
+}
+
 static struct cftype zswap_files[] = {
 	{
 		.name = "zswap.current",
@@ -8021,6 +8299,12 @@ static struct cftype zswap_files[] = {
 		.seq_show = zswap_max_show,
 		.write = zswap_max_write,
 	},
+	{
+		.name = "zswap.compressor",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = zswap_compressor_show,
+		.write = zswap_compressor_write,
+	},
 	{ }	/* terminate */
 };
 #endif /* CONFIG_MEMCG_KMEM && CONFIG_ZSWAP */
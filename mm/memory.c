@@ -64,6 +64,7 @@
 #include <linux/memcontrol.h>
 #include <linux/mmu_notifier.h>
 #include <linux/swapops.h>
+#include <linux/zswap.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
 #include <linux/migrate.h>
@@ -1069,6 +1070,26 @@ static inline struct folio *folio_prealloc(struct mm_struct *src_mm,
 	return new_folio;
 }
 
+/*
+ * With MMF_FORK_LAZY_PTES, a private file mapping that has been written to
+ * (and so has an anon_vma, failing the vma_needs_copy() shortcut) only gets
+ * its anonymous ptes copied.  Ptes mapping page cache are left empty in the
+ * child, which faults them back from the page cache on first access, so
+ * fork() no longer pays the rmap and refcount updates for every file page a
+ * large parent such as zygote has mapped.
+ */
+static bool
+vma_lazy_file_ptes(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma)
+{
+	if (likely(!test_bit(MMF_FORK_LAZY_PTES, &src_vma->vm_mm->flags)))
+		return false;
+	if (!src_vma->vm_file || (src_vma->vm_flags & VM_SHARED))
+		return false;
+	if (src_vma->vm_flags & (VM_PFNMAP | VM_MIXEDMAP))
+		return false;
+	return !userfaultfd_wp(dst_vma);
+}
+
 static int
 copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	       pmd_t *dst_pmd, pmd_t *src_pmd, unsigned long addr,
@@ -1084,6 +1105,7 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 	int rss[NR_MM_COUNTERS];
 	swp_entry_t entry = (swp_entry_t){0};
 	struct folio *prealloc = NULL;
+	bool lazy_file = vma_lazy_file_ptes(dst_vma, src_vma);
 	int nr;
 
 again:
@@ -1155,6 +1177,14 @@ copy_pte_range(struct vm_area_struct *dst_vma, struct vm_area_struct *src_vma,
 			 */
 			WARN_ON_ONCE(ret != -ENOENT);
 		}
+		if (lazy_file) {
+			struct page *page = vm_normal_page(src_vma, addr, ptent);
+
+			if (page && !PageAnon(page)) {
+				progress++;
+				continue;
+			}
+		}
 		/* copy_present_ptes() will clear `*prealloc' if consumed */
 		max_nr = (end - addr) / PAGE_SIZE;
 		ret = copy_present_ptes(dst_vma, src_vma, dst_pte, src_pte,
@@ -3214,6 +3244,7 @@ static inline vm_fault_t vmf_can_call_fault(const struct vm_fault *vmf)
 	if (vma->vm_ops->map_pages || !(vmf->flags & FAULT_FLAG_VMA_LOCK))
 		return 0;
 	vma_end_read(vma);
+	count_vm_vma_lock_event(VMA_LOCK_RETRY_FAULT);
 	return VM_FAULT_RETRY;
 }
 
@@ -3242,6 +3273,7 @@ vm_fault_t vmf_anon_prepare(struct vm_fault *vmf)
 	if (vmf->flags & FAULT_FLAG_VMA_LOCK) {
 		if (!mmap_read_trylock(vma->vm_mm)) {
 			vma_end_read(vma);
+			count_vm_vma_lock_event(VMA_LOCK_RETRY_ANON_VMA);
 			return VM_FAULT_RETRY;
 		}
 	}
@@ -3933,6 +3965,252 @@ static vm_fault_t handle_pte_marker(struct vm_fault *vmf)
 	return VM_FAULT_SIGBUS;
 }
 
+static struct folio *__alloc_swap_folio(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	struct folio *folio;
+	swp_entry_t entry;
+
+	folio = vma_alloc_folio(GFP_HIGHUSER_MOVABLE|__GFP_CMA, 0, vma,
+				vmf->address, false);
+	if (!folio)
+		return NULL;
+
+	entry = pte_to_swp_entry(vmf->orig_pte);
+	if (mem_cgroup_swapin_charge_folio(folio, vma->vm_mm,
+					   GFP_KERNEL, entry)) {
+		folio_put(folio);
+		return NULL;
+	}
+
+	return folio;
+}
+
+/*
+ * zswap_load() only fills a large folio when all of its entries are in
+ * zswap, and the backing device only holds the ones zswap rejected.
+ */
+static bool swap_range_zswap_all_or_none(swp_entry_t entry, int nr_pages)
+{
+	int nr = zswap_entries_present(entry, nr_pages);
+
+	return nr == 0 || nr == nr_pages;
+}
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Check whether the nr_pages swap ptes at @ptep, which cover the naturally
+ * aligned range around the faulting address, can be read into one folio.
+ */
+static bool can_swapin_thp(struct vm_fault *vmf, pte_t *ptep, int nr_pages)
+{
+	struct swap_info_struct *si;
+	unsigned long addr;
+	swp_entry_t entry;
+	pgoff_t offset;
+	int idx, i;
+	pte_t pte;
+
+	addr = ALIGN_DOWN(vmf->address, nr_pages * PAGE_SIZE);
+	idx = (vmf->address - addr) / PAGE_SIZE;
+	pte = ptep_get(ptep);
+
+	if (!pte_same(pte, pte_move_swp_offset(vmf->orig_pte, -idx)))
+		return false;
+	if (swap_pte_batch(ptep, nr_pages, pte) != nr_pages)
+		return false;
+
+	entry = pte_to_swp_entry(pte);
+	offset = swp_offset(entry);
+	si = swp_swap_info(entry);
+	for (i = 0; i < nr_pages; i++) {
+		if (READ_ONCE(si->swap_map[offset + i]) & SWAP_HAS_CACHE)
+			return false;
+	}
+
+	/*
+	 * Unpinned, the entries may still be stored or invalidated, so this is
+	 * checked again once swapcache_prepare() succeeded.
+	 */
+	return swap_range_zswap_all_or_none(entry, nr_pages);
+}
+
+static inline unsigned long thp_swap_suitable_orders(pgoff_t swp_offset,
+		unsigned long addr, unsigned long orders)
+{
+	int order, nr;
+
+	order = highest_order(orders);
+
+	/*
+	 * To swap in a THP with nr pages, we require that its first swap_offset
+	 * is aligned with that number, as it was when the THP was swapped out.
+	 * This helps filter out most invalid entries.
+	 */
+	while (orders) {
+		nr = 1 << order;
+		if ((addr >> PAGE_SHIFT) % nr == swp_offset % nr)
+			break;
+		order = next_order(&orders, order);
+	}
+
+	return orders;
+}
+
+/*
+ * Allocate and charge a large folio for the naturally aligned swap range
+ * around the fault, or return NULL if no enabled order fits that range.
+ */
+static struct folio *alloc_large_swap_folio(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long orders;
+	struct folio *folio;
+	unsigned long addr;
+	swp_entry_t entry;
+	spinlock_t *ptl;
+	pte_t *pte;
+	gfp_t gfp;
+	int order;
+
+	/*
+	 * If uffd is active for the vma we need per-page fault fidelity to
+	 * maintain the uffd semantics.
+	 */
+	if (unlikely(userfaultfd_armed(vma)))
+		return NULL;
+
+	entry = pte_to_swp_entry(vmf->orig_pte);
+	/*
+	 * Get a list of all the (large) orders below PMD_ORDER that are enabled
+	 * and suitable for swapping THP.
+	 */
+	orders = thp_vma_allowable_orders(vma, vma->vm_flags, false, true, true,
+					  BIT(PMD_ORDER) - 1);
+	orders = thp_vma_suitable_orders(vma, vmf->address, orders);
+	orders = thp_swap_suitable_orders(swp_offset(entry),
+					  vmf->address, orders);
+
+	if (!orders)
+		return NULL;
+
+	pte = pte_offset_map_lock(vmf->vma->vm_mm, vmf->pmd,
+				  vmf->address & PMD_MASK, &ptl);
+	if (unlikely(!pte))
+		return NULL;
+
+	/*
+	 * For do_swap_page, find the highest order where the aligned range is
+	 * completely swap entries with contiguous swap offsets.
+	 */
+	order = highest_order(orders);
+	while (orders) {
+		addr = ALIGN_DOWN(vmf->address, PAGE_SIZE << order);
+		if (can_swapin_thp(vmf, pte + pte_index(addr), 1 << order))
+			break;
+		order = next_order(&orders, order);
+	}
+
+	pte_unmap_unlock(pte, ptl);
+
+	/* Try allocating the highest of the remaining orders. */
+	gfp = vma_thp_gfp_mask(vma);
+	while (orders) {
+		addr = ALIGN_DOWN(vmf->address, PAGE_SIZE << order);
+		folio = vma_alloc_folio(gfp, order, vma, addr, true);
+		if (folio) {
+			if (!mem_cgroup_swapin_charge_folio(folio, vma->vm_mm,
+							    gfp, entry))
+				return folio;
+			count_mthp_stat(order, MTHP_STAT_SWPIN_FALLBACK_CHARGE);
+			folio_put(folio);
+		}
+		count_mthp_stat(order, MTHP_STAT_SWPIN_FALLBACK);
+		order = next_order(&orders, order);
+	}
+
+	return NULL;
+}
+
+static struct folio *alloc_swap_folio(struct vm_fault *vmf)
+{
+	struct folio *folio;
+
+	folio = alloc_large_swap_folio(vmf);
+	if (folio)
+		return folio;
+	return __alloc_swap_folio(vmf);
+}
+
+/*
+ * Swap in the aligned range around the fault as one large folio through the
+ * swap cache, for devices that go through swap readahead.  This is used when
+ * the entries were written out together from one large folio.  The fault
+ * then maps the whole range at once and zswap or zram decompress it in a
+ * single call, instead of readahead bringing in each entry as its own order-0
+ * folio.  Returns NULL, having left no trace, if the range can't be read as a
+ * whole.  The caller then falls back to swapin_readahead().
+ */
+static struct folio *swapin_large_folio(struct vm_fault *vmf,
+					swp_entry_t entry)
+{
+	struct folio *folio;
+	void *shadow = NULL;
+	int nr_pages;
+
+	folio = alloc_large_swap_folio(vmf);
+	if (!folio)
+		return NULL;
+
+	nr_pages = folio_nr_pages(folio);
+	entry.val = ALIGN_DOWN(entry.val, nr_pages);
+	/*
+	 * Somebody else owns the swap cache for part of the range, or it has
+	 * been freed meanwhile: let readahead sort it out one page at a time.
+	 */
+	if (swapcache_prepare(entry, nr_pages)) {
+		folio_put(folio);
+		return NULL;
+	}
+	if (!swap_range_zswap_all_or_none(entry, nr_pages)) {
+		swapcache_clear(swp_swap_info(entry), entry, nr_pages);
+		folio_put(folio);
+		return NULL;
+	}
+
+	__folio_set_locked(folio);
+	__folio_set_swapbacked(folio);
+
+	/* May fail (-ENOMEM) if XArray node allocation failed. */
+	if (add_to_swap_cache(folio, entry, GFP_KERNEL, &shadow)) {
+		put_swap_folio(folio, entry);
+		folio_unlock(folio);
+		folio_put(folio);
+		return NULL;
+	}
+
+	mem_cgroup_swapin_uncharge_swap(entry, nr_pages);
+
+	if (shadow)
+		workingset_refault(folio, shadow);
+
+	folio_add_lru(folio);
+	swap_readpage(&folio->page, false, NULL);
+	return folio;
+}
+#else /* !CONFIG_TRANSPARENT_HUGEPAGE */
+static struct folio *alloc_swap_folio(struct vm_fault *vmf)
+{
+	return __alloc_swap_folio(vmf);
+}
+
+static struct folio *swapin_large_folio(struct vm_fault *vmf,
+					swp_entry_t entry)
+{
+	return NULL;
+}
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 /*
  * We enter with non-exclusive mmap_lock (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
@@ -3954,7 +4232,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	pte_t pte;
 	vm_fault_t ret = 0;
 	void *shadow = NULL;
-	int nr_pages;
+	int nr_pages = 1;
 	unsigned long page_idx;
 	unsigned long address;
 	pte_t *ptep;
@@ -3977,6 +4255,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 				 * under VMA lock.
 				 */
 				vma_end_read(vma);
+				count_vm_vma_lock_event(VMA_LOCK_RETRY_DEVICE);
 				ret = VM_FAULT_RETRY;
 				goto out;
 			}
@@ -4021,35 +4300,39 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	if (!folio) {
 		if (data_race(si->flags & SWP_SYNCHRONOUS_IO) &&
 		    __swap_count(entry) == 1) {
-			/*
-			 * Prevent parallel swapin from proceeding with
-			 * the cache flag. Otherwise, another thread may
-			 * finish swapin first, free the entry, and swapout
-			 * reusing the same entry. It's undetectable as
-			 * pte_same() returns true due to entry reuse.
-			 */
-			if (swapcache_prepare(entry)) {
-				/* Relax a bit to prevent rapid repeated page faults */
-				schedule_timeout_uninterruptible(1);
-				goto out;
-			}
-			need_clear_cache = true;
-
 			/* skip swapcache */
-			folio = vma_alloc_folio(GFP_HIGHUSER_MOVABLE|__GFP_CMA,
-						0, vma, vmf->address, false);
+			folio = alloc_swap_folio(vmf);
 			page = &folio->page;
 			if (folio) {
 				__folio_set_locked(folio);
 				__folio_set_swapbacked(folio);
 
-				if (mem_cgroup_swapin_charge_folio(folio,
-							vma->vm_mm, GFP_KERNEL,
-							entry)) {
-					ret = VM_FAULT_OOM;
+				nr_pages = folio_nr_pages(folio);
+				if (folio_test_large(folio))
+					entry.val = ALIGN_DOWN(entry.val, nr_pages);
+				/*
+				 * Prevent parallel swapin from proceeding with
+				 * the cache flag. Otherwise, another thread may
+				 * finish swapin first, free the entry, and swapout
+				 * reusing the same entry. It's undetectable as
+				 * pte_same() returns true due to entry reuse.
+				 */
+				if (swapcache_prepare(entry, nr_pages)) {
+					/* Relax a bit to prevent rapid repeated page faults */
+					schedule_timeout_uninterruptible(1);
 					goto out_page;
 				}
-				mem_cgroup_swapin_uncharge_swap(entry);
+				need_clear_cache = true;
+
+				/*
+				 * The range changed in zswap before it was
+				 * pinned, refault to read it page by page.
+				 */
+				if (folio_test_large(folio) &&
+				    !swap_range_zswap_all_or_none(entry, nr_pages))
+					goto out_page;
+
+				mem_cgroup_swapin_uncharge_swap(entry, nr_pages);
 
 				shadow = get_shadow_from_swap_cache(entry);
 				if (shadow)
@@ -4063,11 +4346,16 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 				folio->private = NULL;
 			}
 		} else {
-			page = swapin_readahead(entry,
+			folio = swapin_large_folio(vmf, entry);
+			if (folio) {
+				page = folio_file_page(folio, swp_offset(entry));
+			} else {
+				page = swapin_readahead(entry,
 						GFP_HIGHUSER_MOVABLE|__GFP_CMA,
 						vmf);
-			if (page)
-				folio = page_folio(page);
+				if (page)
+					folio = page_folio(page);
+			}
 			swapcache = folio;
 		}
 
@@ -4158,6 +4446,25 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	page_idx = 0;
 	address = vmf->address;
 	ptep = vmf->pte;
+	/* allocated large folios for SWP_SYNCHRONOUS_IO */
+	if (folio_test_large(folio) && !folio_test_swapcache(folio)) {
+		int nr = folio_nr_pages(folio);
+		unsigned long folio_start = ALIGN_DOWN(vmf->address, nr * PAGE_SIZE);
+		unsigned long idx = (vmf->address - folio_start) / PAGE_SIZE;
+		pte_t *folio_ptep = vmf->pte - idx;
+		pte_t folio_pte = ptep_get(folio_ptep);
+
+		/* the swap cache pin covers the whole folio */
+		nr_pages = nr;
+		if (!pte_same(folio_pte, pte_move_swp_offset(vmf->orig_pte, -idx)) ||
+		    swap_pte_batch(folio_ptep, nr, folio_pte) != nr)
+			goto out_nomap;
+
+		page_idx = idx;
+		address = folio_start;
+		ptep = folio_ptep;
+		goto check_folio;
+	}
 	if (folio_test_large(folio) && folio_test_swapcache(folio)) {
 		int nr = folio_nr_pages(folio);
 		unsigned long idx = folio_page_idx(folio, page);
@@ -4284,6 +4591,10 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	if (unlikely(folio != swapcache && swapcache)) {
 		folio_add_new_anon_rmap(folio, vma, address);
 		folio_add_lru_vma(folio, vma);
+	} else if (!folio_test_anon(folio) && folio_test_large(folio)) {
+		/* a freshly allocated large folio, certainly exclusive */
+		VM_WARN_ON_ONCE(folio_nr_pages(folio) != nr_pages);
+		folio_add_new_anon_rmap(folio, vma, address);
 	} else {
 		folio_add_anon_rmap_ptes(folio, page, nr_pages, vma, address,
 					rmap_flags);
@@ -4324,7 +4635,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 out:
 	/* Clear the swap cache pin for direct swapin after PTL unlock */
 	if (need_clear_cache)
-		swapcache_clear(si, entry);
+		swapcache_clear(si, entry, nr_pages);
 	if (si)
 		put_swap_device(si);
 	return ret;
@@ -4340,7 +4651,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 		folio_put(swapcache);
 	}
 	if (need_clear_cache)
-		swapcache_clear(si, entry);
+		swapcache_clear(si, entry, nr_pages);
 	if (si)
 		put_swap_device(si);
 	return ret;
@@ -4921,6 +5232,74 @@ static vm_fault_t do_fault_around(struct vm_fault *vmf)
 	return ret;
 }
 
+/**
+ * vma_map_cached_pages - map the cached pages of a file range up front
+ * @vma: file backed vma, with the mmap lock held
+ * @start: first address to map
+ * @end: end of the range to map
+ *
+ * Map the uptodate page cache pages backing @start to @end, one page table
+ * at a time, the same way fault-around does. Nothing is read from storage:
+ * pages which are not cached are left to fault in later.
+ */
+void vma_map_cached_pages(struct vm_area_struct *vma, unsigned long start,
+			  unsigned long end)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long next;
+	pgd_t *pgd;
+	p4d_t *p4d;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	mmap_assert_locked(mm);
+
+	if (!vma->vm_ops || !vma->vm_ops->map_pages ||
+	    uffd_disable_fault_around(vma))
+		return;
+
+	start = max(PAGE_ALIGN_DOWN(start), vma->vm_start);
+	end = min(PAGE_ALIGN(end), vma->vm_end);
+
+	for (; start < end; start = next) {
+		struct vm_fault vmf = {
+			.vma = vma,
+			.address = start,
+			.real_address = start,
+			.pgoff = linear_page_index(vma, start),
+			.gfp_mask = __get_fault_gfp_mask(vma),
+		};
+
+		next = pmd_addr_end(start, end);
+
+		pgd = pgd_offset(mm, start);
+		p4d = p4d_alloc(mm, pgd, start);
+		if (!p4d)
+			return;
+		pud = pud_alloc(mm, p4d, start);
+		if (!pud)
+			return;
+		pmd = pmd_alloc(mm, pud, start);
+		if (!pmd)
+			return;
+
+		vmf.pmd = pmd;
+		if (pmd_none(*pmd)) {
+			vmf.prealloc_pte = pte_alloc_one(mm);
+			if (!vmf.prealloc_pte)
+				return;
+		}
+
+		rcu_read_lock();
+		vma->vm_ops->map_pages(&vmf, vmf.pgoff,
+				       linear_page_index(vma, next) - 1);
+		rcu_read_unlock();
+
+		if (vmf.prealloc_pte)
+			pte_free(mm, vmf.prealloc_pte);
+	}
+}
+
 /* Return true if we should do read fault-around, false otherwise */
 static inline bool should_fault_around(struct vm_fault *vmf)
 {
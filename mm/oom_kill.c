@@ -45,6 +45,7 @@
 #include <linux/init.h>
 #include <linux/mmu_notifier.h>
 #include <linux/cred.h>
+#include <linux/seq_file.h>
 
 #include <asm/tlb.h>
 #include "internal.h"
@@ -1263,3 +1264,249 @@ SYSCALL_DEFINE2(process_mrelease, int, pidfd, unsigned int, flags)
 	return -ENOSYS;
 #endif /* CONFIG_MMU */
 }
+
+#ifdef CONFIG_PSI
+/*
+ * Ranked kill candidates for /proc/pressure/memory_candidates. While the
+ * file is open the list is refreshed in the background, so a reader woken
+ * by a memory pressure trigger gets it without walking /proc under
+ * pressure itself.
+ */
+#define OOM_CANDIDATE_TASKS	32
+#define OOM_CANDIDATE_MEMCGS	16
+#define OOM_CANDIDATES_PERIOD	HZ
+
+struct oom_candidate_task {
+	pid_t pid;
+	uid_t uid;
+	short adj;
+	unsigned long rss;
+	unsigned long swap;
+	unsigned long cgroup_ino;
+	char comm[TASK_COMM_LEN];
+};
+
+struct oom_candidate_memcg {
+	unsigned long ino;
+	unsigned long usage;
+	unsigned long anon;
+	unsigned long swap;
+};
+
+struct oom_candidates {
+	unsigned long updated;
+	unsigned int nr_tasks;
+	unsigned int nr_memcgs;
+	struct oom_candidate_task tasks[OOM_CANDIDATE_TASKS];
+	struct oom_candidate_memcg memcgs[OOM_CANDIDATE_MEMCGS];
+};
+
+/* Readers use oom_candidates_cur, the refresh fills the other buffer */
+static struct oom_candidates oom_candidates_buf[2];
+static struct oom_candidates *oom_candidates_cur;
+static DEFINE_MUTEX(oom_candidates_lock);
+static DEFINE_MUTEX(oom_candidates_refresh_lock);
+static int oom_candidates_users;
+
+static void oom_candidates_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(oom_candidates_work, oom_candidates_workfn);
+
+/* Highest oom_score_adj first, then the largest footprint */
+static bool oom_candidate_before(const struct oom_candidate_task *a,
+				 const struct oom_candidate_task *b)
+{
+	if (a->adj != b->adj)
+		return a->adj > b->adj;
+	return a->rss + a->swap > b->rss + b->swap;
+}
+
+static void oom_candidate_insert(struct oom_candidates *c,
+				 const struct oom_candidate_task *cand)
+{
+	unsigned int i = c->nr_tasks;
+
+	if (i == OOM_CANDIDATE_TASKS) {
+		if (!oom_candidate_before(cand, &c->tasks[i - 1]))
+			return;
+		i--;
+	} else {
+		c->nr_tasks++;
+	}
+
+	for (; i && oom_candidate_before(cand, &c->tasks[i - 1]); i--)
+		c->tasks[i] = c->tasks[i - 1];
+	c->tasks[i] = *cand;
+}
+
+static unsigned long oom_task_cgroup_ino(struct task_struct *p)
+{
+#ifdef CONFIG_MEMCG
+	struct mem_cgroup *memcg;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	memcg = mem_cgroup_from_task(p);
+	if (memcg)
+		return cgroup_ino(memcg->css.cgroup);
+#endif
+	return 0;
+}
+
+static void oom_candidates_collect_tasks(struct oom_candidates *c)
+{
+	struct oom_candidate_task cand;
+	struct task_struct *p, *t;
+
+	c->nr_tasks = 0;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (oom_unkillable_task(p))
+			continue;
+
+		t = find_lock_task_mm(p);
+		if (!t)
+			continue;
+
+		cand.adj = t->signal->oom_score_adj;
+		if (cand.adj == OOM_SCORE_ADJ_MIN ||
+		    test_bit(MMF_OOM_SKIP, &t->mm->flags) || in_vfork(t)) {
+			task_unlock(t);
+			continue;
+		}
+		cand.rss = get_mm_rss(t->mm);
+		cand.swap = get_mm_counter(t->mm, MM_SWAPENTS);
+		task_unlock(t);
+
+		cand.pid = task_tgid_nr(p);
+		cand.uid = from_kuid(&init_user_ns, task_uid(p));
+		cand.cgroup_ino = oom_task_cgroup_ino(p);
+		strscpy(cand.comm, p->comm, sizeof(cand.comm));
+		oom_candidate_insert(c, &cand);
+	}
+	rcu_read_unlock();
+}
+
+static void oom_candidates_collect_memcgs(struct oom_candidates *c)
+{
+#ifdef CONFIG_MEMCG
+	struct oom_candidate_memcg cand;
+	struct mem_cgroup *memcg;
+	unsigned int i;
+
+	c->nr_memcgs = 0;
+	if (mem_cgroup_disabled())
+		return;
+
+	mem_cgroup_flush_stats(NULL);
+
+	for (memcg = mem_cgroup_iter(NULL, NULL, NULL); memcg;
+	     memcg = mem_cgroup_iter(NULL, memcg, NULL)) {
+		if (mem_cgroup_is_root(memcg))
+			continue;
+
+		cand.usage = page_counter_read(&memcg->memory);
+		i = c->nr_memcgs;
+		if (i == OOM_CANDIDATE_MEMCGS) {
+			if (cand.usage <= c->memcgs[i - 1].usage)
+				continue;
+			i--;
+		} else {
+			c->nr_memcgs++;
+		}
+
+		cand.ino = cgroup_ino(memcg->css.cgroup);
+		cand.anon = memcg_page_state(memcg, NR_ANON_MAPPED);
+		cand.swap = memcg_page_state(memcg, MEMCG_SWAP);
+		for (; i && cand.usage > c->memcgs[i - 1].usage; i--)
+			c->memcgs[i] = c->memcgs[i - 1];
+		c->memcgs[i] = cand;
+	}
+#else
+	c->nr_memcgs = 0;
+#endif
+}
+
+static void oom_candidates_refresh(void)
+{
+	struct oom_candidates *next;
+
+	mutex_lock(&oom_candidates_refresh_lock);
+	next = oom_candidates_cur == &oom_candidates_buf[0] ?
+		&oom_candidates_buf[1] : &oom_candidates_buf[0];
+
+	oom_candidates_collect_tasks(next);
+	oom_candidates_collect_memcgs(next);
+	next->updated = jiffies;
+
+	mutex_lock(&oom_candidates_lock);
+	oom_candidates_cur = next;
+	mutex_unlock(&oom_candidates_lock);
+	mutex_unlock(&oom_candidates_refresh_lock);
+}
+
+static void oom_candidates_workfn(struct work_struct *work)
+{
+	oom_candidates_refresh();
+
+	mutex_lock(&oom_candidates_lock);
+	if (oom_candidates_users)
+		queue_delayed_work(system_unbound_wq, &oom_candidates_work,
+				   OOM_CANDIDATES_PERIOD);
+	mutex_unlock(&oom_candidates_lock);
+}
+
+/* Start maintaining the candidate list, refreshing it right away */
+void oom_candidates_get(void)
+{
+	bool first;
+
+	mutex_lock(&oom_candidates_lock);
+	first = !oom_candidates_users++;
+	mutex_unlock(&oom_candidates_lock);
+
+	if (first) {
+		oom_candidates_refresh();
+		queue_delayed_work(system_unbound_wq, &oom_candidates_work,
+				   OOM_CANDIDATES_PERIOD);
+	}
+}
+
+/* The background refresh stops once the last user is gone */
+void oom_candidates_put(void)
+{
+	mutex_lock(&oom_candidates_lock);
+	oom_candidates_users--;
+	mutex_unlock(&oom_candidates_lock);
+}
+
+void oom_candidates_show(struct seq_file *m)
+{
+	struct oom_candidates *c;
+	unsigned int i;
+
+	mutex_lock(&oom_candidates_lock);
+	c = oom_candidates_cur;
+	if (!c)
+		goto unlock;
+
+	seq_printf(m, "candidates age_ms=%u\n",
+		   jiffies_to_msecs(jiffies - c->updated));
+	for (i = 0; i < c->nr_tasks; i++) {
+		struct oom_candidate_task *t = &c->tasks[i];
+
+		seq_printf(m, "task pid=%d uid=%u adj=%hd rss_kb=%lu swap_kb=%lu cgroup=%lu comm=%s\n",
+			   t->pid, t->uid, t->adj, K(t->rss), K(t->swap),
+			   t->cgroup_ino, t->comm);
+	}
+	for (i = 0; i < c->nr_memcgs; i++) {
+		struct oom_candidate_memcg *mc = &c->memcgs[i];
+
+		seq_printf(m, "cgroup ino=%lu usage_kb=%lu anon_kb=%lu swap_kb=%lu\n",
+			   mc->ino, K(mc->usage), K(mc->anon), K(mc->swap));
+	}
+unlock:
+	mutex_unlock(&oom_candidates_lock);
+}
+#endif /* CONFIG_PSI */
@@ -53,6 +53,7 @@
 #include <linux/psi.h>
 #include <linux/khugepaged.h>
 #include <linux/delayacct.h>
+#include <linux/workqueue.h>
 #include <trace/hooks/vmscan.h>
 #include <trace/hooks/mm.h>
 #include <asm/div64.h>
@@ -2272,6 +2273,41 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 	return i;
 }
 
+/*
+ * Called from the vmstat counter updater to decay the PCP high while the
+ * CPU is idle, returning the pages above it to the buddy allocator.
+ * Return whether there is additional work to do.
+ */
+bool decay_pcp_high(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int high_min, to_drain, batch;
+	bool todo = false;
+
+	high_min = READ_ONCE(pcp->high_min);
+	batch = READ_ONCE(pcp->batch);
+	/*
+	 * Decrease pcp->high periodically to try to free possible idle PCP
+	 * pages. And, avoid freeing too many pages at once to control
+	 * latency. This caps the pcp->high decrement too.
+	 */
+	if (pcp->high > high_min) {
+		pcp->high = max3(pcp->count - (batch << CONFIG_PCP_BATCH_SCALE_MAX),
+				 pcp->high - (pcp->high >> 3), high_min);
+		if (pcp->high > high_min)
+			todo = true;
+	}
+
+	to_drain = pcp->count - pcp->high;
+	if (to_drain > 0) {
+		spin_lock(&pcp->lock);
+		free_pcppages_bulk(zone, to_drain, pcp, 0);
+		spin_unlock(&pcp->lock);
+		todo = true;
+	}
+
+	return todo;
+}
+
 #ifdef CONFIG_NUMA
 /*
  * Called from the vmstat counter updater to drain pagesets of this
@@ -2462,22 +2498,69 @@ static int nr_pcp_free(struct per_cpu_pages *pcp, int high, bool free_high)
 	return batch;
 }
 
+/*
+ * The zone is short of free pages, so pcp->high should not grow beyond
+ * pcp->high_min and any growth should be given back.
+ */
+static inline bool pcp_zone_pressure(struct zone *zone)
+{
+	return test_bit(ZONE_RECLAIM_ACTIVE, &zone->flags) ||
+	       zone_page_state(zone, NR_FREE_PAGES) < high_wmark_pages(zone);
+}
+
 static int nr_pcp_high(struct per_cpu_pages *pcp, struct zone *zone,
 		       bool free_high)
 {
-	int high = READ_ONCE(pcp->high);
+	int high, high_min, high_max, batch;
+
+	high_min = READ_ONCE(pcp->high_min);
+	high_max = READ_ONCE(pcp->high_max);
+	high = pcp->high = clamp(pcp->high, high_min, high_max);
 
-	if (unlikely(!high || free_high))
+	if (unlikely(!high))
+		return 0;
+
+	batch = READ_ONCE(pcp->batch);
+	if (unlikely(free_high)) {
+		pcp->high = max(high - (batch << CONFIG_PCP_BATCH_SCALE_MAX),
+				high_min);
 		return 0;
+	}
 
-	if (!test_bit(ZONE_RECLAIM_ACTIVE, &zone->flags))
+	if (high_min == high_max || !pcp_zone_pressure(zone))
 		return high;
 
+	/* Shrink back towards high_min while the zone is under pressure */
+	pcp->high = max(high - (batch << pcp->free_factor), high_min);
+	high = max(pcp->count, high_min);
+
 	/*
 	 * If reclaim is active, limit the number of pages that can be
 	 * stored on pcp lists
 	 */
-	return min(READ_ONCE(pcp->batch) << 2, high);
+	if (test_bit(ZONE_RECLAIM_ACTIVE, &zone->flags))
+		return min(batch << 2, high);
+
+	return high;
+}
+
+/*
+ * Estimate the zone->lock round trips saved by pcp->high having grown above
+ * pcp->high_min: with a static high, every batch of pages stored above
+ * high_min would have been bulk freed to the buddy allocator.
+ */
+static inline void pcp_count_free_avoided(struct per_cpu_pages *pcp, int nr)
+{
+	int high_min = READ_ONCE(pcp->high_min);
+	int batch = READ_ONCE(pcp->batch);
+	int old = pcp->count - nr;
+
+	if (pcp->count < high_min || batch <= 1)
+		return;
+
+	if (old < high_min ||
+	    (old - high_min) / batch != (pcp->count - high_min) / batch)
+		__count_vm_events(PCP_FREE_LOCK_AVOIDED, 1);
 }
 
 static void free_unref_page_commit(struct zone *zone, struct per_cpu_pages *pcp,
@@ -2493,6 +2576,13 @@ static void free_unref_page_commit(struct zone *zone, struct per_cpu_pages *pcp,
 	list_add(&page->pcp_list, &pcp->lists[pindex]);
 	pcp->count += 1 << order;
 
+	/*
+	 * On freeing, reduce the number of pages that are batch allocated.
+	 * See nr_pcp_alloc() where alloc_factor is increased for subsequent
+	 * allocations.
+	 */
+	pcp->alloc_factor >>= 1;
+
 	/*
 	 * As high-order pages other than THP's stored on PCP can contribute
 	 * to fragmentation, limit the number stored when PCP is heavily
@@ -2504,6 +2594,8 @@ static void free_unref_page_commit(struct zone *zone, struct per_cpu_pages *pcp,
 	high = nr_pcp_high(pcp, zone, free_high);
 	if (pcp->count >= high) {
 		free_pcppages_bulk(zone, nr_pcp_free(pcp, high, free_high), pcp, pindex);
+	} else {
+		pcp_count_free_avoided(pcp, 1 << order);
 	}
 }
 
@@ -2804,6 +2896,57 @@ struct page *rmqueue_buddy(struct zone *preferred_zone, struct zone *zone,
 	return page;
 }
 
+static int nr_pcp_alloc(struct per_cpu_pages *pcp, struct zone *zone, int order)
+{
+	int high, base_batch, batch, max_nr_alloc;
+	int high_max, high_min;
+
+	base_batch = READ_ONCE(pcp->batch);
+	high_min = READ_ONCE(pcp->high_min);
+	high_max = READ_ONCE(pcp->high_max);
+	high = pcp->high = clamp(pcp->high, high_min, high_max);
+
+	/* Check for PCP disabled or boot pageset */
+	if (unlikely(high < base_batch))
+		return 1;
+
+	if (order)
+		batch = base_batch;
+	else
+		batch = (base_batch << pcp->alloc_factor);
+
+	/*
+	 * The CPU is in an allocation burst: with a larger pcp->high the
+	 * refill would not have been needed, so grow it unless the zone is
+	 * short of free pages.
+	 */
+	if (high_min != high_max && !pcp_zone_pressure(zone))
+		high = pcp->high = min(high + batch, high_max);
+
+	if (!order) {
+		max_nr_alloc = max(high - pcp->count - base_batch, base_batch);
+		/*
+		 * Double the number of pages allocated each time there is
+		 * subsequent allocation of order-0 pages without any freeing.
+		 */
+		if (batch <= max_nr_alloc &&
+		    pcp->alloc_factor < CONFIG_PCP_BATCH_SCALE_MAX)
+			pcp->alloc_factor++;
+		batch = min(batch, max_nr_alloc);
+	}
+
+	/*
+	 * Scale batch relative to order if batch implies free pages
+	 * can be stored on the PCP. Batch can be 1 for small zones or
+	 * for boot pagesets which should never store free pages as
+	 * the pages may belong to arbitrary zones.
+	 */
+	if (batch > 1)
+		batch = max(batch >> order, 2);
+
+	return batch;
+}
+
 /* Remove page from the per-cpu list, caller must protect the list */
 static inline
 struct page *___rmqueue_pcplist(struct zone *zone, unsigned int order,
@@ -2816,26 +2959,23 @@ struct page *___rmqueue_pcplist(struct zone *zone, unsigned int order,
 
 	do {
 		if (list_empty(list)) {
-			int batch = READ_ONCE(pcp->batch);
+			int base_batch = READ_ONCE(pcp->batch);
+			int batch;
 			int alloced;
 
 			trace_android_vh_rmqueue_bulk_bypass(order, pcp, migratetype, list);
 			if (!list_empty(list))
 				goto get_list;
-			/*
-			 * Scale batch relative to order if batch implies
-			 * free pages can be stored on the PCP. Batch can
-			 * be 1 for small zones or for boot pagesets which
-			 * should never store free pages as the pages may
-			 * belong to arbitrary zones.
-			 */
-			if (batch > 1)
-				batch = max(batch >> order, 2);
+			batch = nr_pcp_alloc(pcp, zone, order);
 			alloced = rmqueue_bulk(zone, order,
 					batch, list,
 					migratetype, alloc_flags);
 
 			pcp->count += alloced << order;
+			/* Refills a static batch would have needed */
+			if (base_batch > 1 && alloced > base_batch)
+				__count_vm_events(PCP_ALLOC_LOCK_AVOIDED,
+						  alloced / base_batch - 1);
 			if (unlikely(list_empty(list)))
 				return NULL;
 		}
@@ -5484,14 +5624,15 @@ static int zone_batchsize(struct zone *zone)
 }
 
 static int percpu_pagelist_high_fraction;
-static int zone_highsize(struct zone *zone, int batch, int cpu_online)
+static int zone_highsize(struct zone *zone, int batch, int cpu_online,
+			 int high_fraction)
 {
 #ifdef CONFIG_MMU
 	int high;
 	int nr_split_cpus;
 	unsigned long total_pages;
 
-	if (!percpu_pagelist_high_fraction) {
+	if (!high_fraction) {
 		/*
 		 * By default, the high value of the pcp is based on the zone
 		 * low watermark so that if they are full then background
@@ -5500,11 +5641,11 @@ static int zone_highsize(struct zone *zone, int batch, int cpu_online)
 		total_pages = low_wmark_pages(zone);
 	} else {
 		/*
-		 * If percpu_pagelist_high_fraction is configured, the high
-		 * value is based on a fraction of the managed pages in the
-		 * zone.
+		 * If percpu_pagelist_high_fraction is configured, or for the
+		 * auto-tuned upper bound, the high value is based on a
+		 * fraction of the managed pages in the zone.
 		 */
-		total_pages = zone_managed_pages(zone) / percpu_pagelist_high_fraction;
+		total_pages = zone_managed_pages(zone) / high_fraction;
 	}
 
 	/*
@@ -5548,11 +5689,13 @@ static int zone_highsize(struct zone *zone, int batch, int cpu_online)
  * outside of boot time (or some other assurance that no concurrent updaters
  * exist).
  */
-static void pageset_update(struct per_cpu_pages *pcp, unsigned long high,
-		unsigned long batch)
+static void pageset_update(struct per_cpu_pages *pcp, unsigned long high_min,
+		unsigned long high_max, unsigned long batch)
 {
 	WRITE_ONCE(pcp->batch, batch);
-	WRITE_ONCE(pcp->high, high);
+	WRITE_ONCE(pcp->high_min, high_min);
+	WRITE_ONCE(pcp->high_max, high_max);
+	WRITE_ONCE(pcp->high, high_min);
 }
 
 static void per_cpu_pages_init(struct per_cpu_pages *pcp, struct per_cpu_zonestat *pzstats)
@@ -5573,19 +5716,22 @@ static void per_cpu_pages_init(struct per_cpu_pages *pcp, struct per_cpu_zonesta
 	 * pageset yet.
 	 */
 	pcp->high = BOOT_PAGESET_HIGH;
+	pcp->high_min = BOOT_PAGESET_HIGH;
+	pcp->high_max = BOOT_PAGESET_HIGH;
 	pcp->batch = BOOT_PAGESET_BATCH;
 	pcp->free_factor = 0;
+	pcp->alloc_factor = 0;
 }
 
-static void __zone_set_pageset_high_and_batch(struct zone *zone, unsigned long high,
-		unsigned long batch)
+static void __zone_set_pageset_high_and_batch(struct zone *zone, unsigned long high_min,
+		unsigned long high_max, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int cpu;
 
 	for_each_possible_cpu(cpu) {
 		pcp = per_cpu_ptr(zone->per_cpu_pageset, cpu);
-		pageset_update(pcp, high, batch);
+		pageset_update(pcp, high_min, high_max, batch);
 	}
 }
 
@@ -5595,19 +5741,35 @@ static void __zone_set_pageset_high_and_batch(struct zone *zone, unsigned long h
  */
 static void zone_set_pageset_high_and_batch(struct zone *zone, int cpu_online)
 {
-	int new_high, new_batch;
+	int new_high_min, new_high_max, new_batch;
 
 	new_batch = max(1, zone_batchsize(zone));
-	new_high = zone_highsize(zone, new_batch, cpu_online);
+	if (percpu_pagelist_high_fraction) {
+		new_high_min = zone_highsize(zone, new_batch, cpu_online,
+					     percpu_pagelist_high_fraction);
+		/*
+		 * PCP high is tuned manually, disable auto-tuning via
+		 * setting high_min and high_max to the manual value.
+		 */
+		new_high_max = new_high_min;
+	} else {
+		new_high_min = zone_highsize(zone, new_batch, cpu_online, 0);
+		new_high_max = zone_highsize(zone, new_batch, cpu_online,
+					     MIN_PERCPU_PAGELIST_HIGH_FRACTION);
+		new_high_max = max(new_high_max, new_high_min);
+	}
 
-	if (zone->pageset_high == new_high &&
+	if (zone->pageset_high == new_high_min &&
+	    zone->pageset_high_max == new_high_max &&
 	    zone->pageset_batch == new_batch)
 		return;
 
-	zone->pageset_high = new_high;
+	zone->pageset_high = new_high_min;
+	zone->pageset_high_max = new_high_max;
 	zone->pageset_batch = new_batch;
 
-	__zone_set_pageset_high_and_batch(zone, new_high, new_batch);
+	__zone_set_pageset_high_and_batch(zone, new_high_min, new_high_max,
+					  new_batch);
 }
 
 void __meminit setup_zone_pageset(struct zone *zone)
@@ -6255,6 +6417,41 @@ static void alloc_contig_dump_pages(struct list_head *page_list)
 	}
 }
 
+/*
+ * Attribute the pages left on cc->migratepages to the most likely reason for
+ * their migration failure.  Pages with extra references are reported to
+ * page_pinner too, even for __GFP_NOWARN allocations, so long-term pinners
+ * of CMA pages can be found.
+ */
+static void alloc_contig_account_failure(struct compact_control *cc)
+{
+	struct acr_info *info = cc->acr_info;
+	struct page *page;
+
+	if (!info)
+		return;
+
+	list_for_each_entry(page, &cc->migratepages, lru) {
+		struct folio *folio = page_folio(page);
+		long nr = folio_nr_pages(folio);
+		/* references from isolation, mappings and the page cache */
+		long expected = 1 + folio_mapcount(folio) +
+			(folio_mapping(folio) ? nr + folio_test_private(folio) : 0);
+
+		if (folio_test_writeback(folio)) {
+			info->nr_writeback += nr;
+		} else if (folio_test_locked(folio)) {
+			info->nr_locked += nr;
+		} else if (folio_maybe_dma_pinned(folio) ||
+			   folio_ref_count(folio) > expected) {
+			info->nr_pinned += nr;
+			page_pinner_failure_detect(page);
+		} else {
+			info->nr_other += nr;
+		}
+	}
+}
+
 /* [start, end) must belong to a single zone. */
 int __alloc_contig_migrate_range(struct compact_control *cc,
 					unsigned long start, unsigned long end)
@@ -6276,7 +6473,8 @@ int __alloc_contig_migrate_range(struct compact_control *cc,
 	lru_cache_disable();
 
 	while (pfn < end || !list_empty(&cc->migratepages)) {
-		if (fatal_signal_pending(current)) {
+		if (fatal_signal_pending(current) ||
+		    (cc->acr_cancel && READ_ONCE(*cc->acr_cancel))) {
 			ret = -EINTR;
 			break;
 		}
@@ -6310,6 +6508,8 @@ int __alloc_contig_migrate_range(struct compact_control *cc,
 
 	lru_cache_enable();
 	if (ret < 0) {
+		if (ret == -EBUSY)
+			alloc_contig_account_failure(cc);
 		if (!(cc->gfp_mask & __GFP_NOWARN) && ret == -EBUSY) {
 			struct page *page;
 
@@ -6327,8 +6527,117 @@ int __alloc_contig_migrate_range(struct compact_control *cc,
 	return 0;
 }
 
+/*
+ * Ranges of at least ACR_PARALLEL_MIN_PAGES are migrated by up to
+ * ACR_PARALLEL_MAX_WORKERS unbound workers, each on its own pageblock aligned
+ * chunk, while the caller waits.
+ */
+#define ACR_PARALLEL_MIN_PAGES		(SZ_32M >> PAGE_SHIFT)
+#define ACR_PARALLEL_MAX_WORKERS	8
+
+struct acr_parallel {
+	atomic_t pending;
+	struct completion done;
+	bool cancel;
+};
+
+struct acr_chunk {
+	struct work_struct work;
+	struct compact_control cc;
+	struct acr_info info;
+	struct acr_parallel *par;
+	unsigned long start;
+	unsigned long end;
+	int ret;
+};
+
+static void alloc_contig_migrate_workfn(struct work_struct *work)
+{
+	struct acr_chunk *chunk = container_of(work, struct acr_chunk, work);
+	struct acr_parallel *par = chunk->par;
+
+	chunk->ret = __alloc_contig_migrate_range(&chunk->cc, chunk->start,
+						  chunk->end);
+	if (atomic_dec_and_test(&par->pending))
+		complete(&par->done);
+}
+
+static int alloc_contig_migrate_range(struct compact_control *cc,
+				      unsigned long start, unsigned long end)
+{
+	struct acr_parallel par;
+	struct acr_chunk *chunks;
+	unsigned long nr_pages = end - start;
+	unsigned long size;
+	int nr, i, ret = 0;
+
+	nr = min3(num_online_cpus(), ACR_PARALLEL_MAX_WORKERS,
+		  (int)DIV_ROUND_UP(nr_pages, pageblock_nr_pages));
+	if (nr_pages < ACR_PARALLEL_MIN_PAGES || nr < 2 ||
+	    (cc->gfp_mask & __GFP_NORETRY))
+		return __alloc_contig_migrate_range(cc, start, end);
+
+	chunks = kcalloc(nr, sizeof(*chunks), GFP_KERNEL | __GFP_NOWARN);
+	if (!chunks)
+		return __alloc_contig_migrate_range(cc, start, end);
+
+	atomic_set(&par.pending, nr);
+	init_completion(&par.done);
+	par.cancel = false;
+
+	size = ALIGN(DIV_ROUND_UP(nr_pages, nr), pageblock_nr_pages);
+	for (i = 0; i < nr; i++) {
+		struct acr_chunk *chunk = &chunks[i];
+
+		chunk->start = i ? ALIGN_DOWN(start + i * size, pageblock_nr_pages) : start;
+		chunk->end = i < nr - 1 ?
+			     ALIGN_DOWN(start + (i + 1) * size, pageblock_nr_pages) : end;
+		chunk->end = clamp(chunk->end, chunk->start, end);
+		chunk->par = &par;
+		chunk->cc = (struct compact_control) {
+			.order = -1,
+			.zone = cc->zone,
+			.mode = cc->mode,
+			.ignore_skip_hint = true,
+			.no_set_skip_hint = true,
+			.gfp_mask = cc->gfp_mask,
+			.alloc_contig = true,
+			.acr_info = cc->acr_info ? &chunk->info : NULL,
+			.acr_cancel = &par.cancel,
+		};
+		INIT_LIST_HEAD(&chunk->cc.migratepages);
+		INIT_WORK(&chunk->work, alloc_contig_migrate_workfn);
+		queue_work(system_unbound_wq, &chunk->work);
+	}
+
+	/* workers hold the isolated range, so wait for them even if killed */
+	if (wait_for_completion_killable(&par.done)) {
+		WRITE_ONCE(par.cancel, true);
+		wait_for_completion(&par.done);
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct acr_chunk *chunk = &chunks[i];
+
+		/* report errors other than -EBUSY first */
+		if (chunk->ret && (!ret || ret == -EBUSY))
+			ret = chunk->ret;
+		if (cc->acr_info) {
+			cc->acr_info->nr_pinned += chunk->info.nr_pinned;
+			cc->acr_info->nr_writeback += chunk->info.nr_writeback;
+			cc->acr_info->nr_locked += chunk->info.nr_locked;
+			cc->acr_info->nr_other += chunk->info.nr_other;
+		}
+	}
+	if (READ_ONCE(par.cancel))
+		ret = -EINTR;
+
+	kfree(chunks);
+	return ret;
+}
+
 /**
- * alloc_contig_range() -- tries to allocate given range of pages
+ * __alloc_contig_range() -- tries to allocate given range of pages
  * @start:	start PFN to allocate
  * @end:	one-past-the-last PFN to allocate
  * @migratetype:	migratetype of the underlying pageblocks (either
@@ -6336,6 +6645,7 @@ int __alloc_contig_migrate_range(struct compact_control *cc,
  *			in range must have the same migratetype and it must
  *			be either of the two.
  * @gfp_mask:	GFP mask to use during compaction
+ * @info:	if not NULL, incremented by the pages that failed migration
  *
  * The PFN range does not have to be pageblock aligned. The PFN range must
  * belong to a single zone.
@@ -6348,8 +6658,9 @@ int __alloc_contig_migrate_range(struct compact_control *cc,
  * pages which PFN is in [start, end) are allocated for the caller and
  * need to be freed with free_contig_range().
  */
-int alloc_contig_range(unsigned long start, unsigned long end,
-		       unsigned migratetype, gfp_t gfp_mask)
+int __alloc_contig_range(unsigned long start, unsigned long end,
+			 unsigned migratetype, gfp_t gfp_mask,
+			 struct acr_info *info)
 {
 	unsigned long outer_start, outer_end;
 	int order;
@@ -6368,6 +6679,7 @@ int alloc_contig_range(unsigned long start, unsigned long end,
 		.no_set_skip_hint = true,
 		.gfp_mask = current_gfp_context(gfp_mask),
 		.alloc_contig = true,
+		.acr_info = info,
 	};
 	INIT_LIST_HEAD(&cc.migratepages);
 
@@ -6408,7 +6720,7 @@ int alloc_contig_range(unsigned long start, unsigned long end,
 	 * allocated.  So, if we fall through be sure to clear ret so that
 	 * -EBUSY is not accidentally used or returned to caller.
 	 */
-	ret = __alloc_contig_migrate_range(&cc, start, end);
+	ret = alloc_contig_migrate_range(&cc, start, end);
 	if (ret && (ret != -EBUSY || (gfp_mask & __GFP_NORETRY)))
 		goto done;
 	ret = 0;
@@ -6476,6 +6788,13 @@ int alloc_contig_range(unsigned long start, unsigned long end,
 	undo_isolate_page_range(start, end, migratetype);
 	return ret;
 }
+EXPORT_SYMBOL(__alloc_contig_range);
+
+int alloc_contig_range(unsigned long start, unsigned long end,
+		       unsigned migratetype, gfp_t gfp_mask)
+{
+	return __alloc_contig_range(start, end, migratetype, gfp_mask, NULL);
+}
 EXPORT_SYMBOL(alloc_contig_range);
 
 static int __alloc_contig_pages(unsigned long start_pfn,
@@ -6602,13 +6921,14 @@ EXPORT_SYMBOL(free_contig_range);
 void zone_pcp_disable(struct zone *zone)
 {
 	mutex_lock(&pcp_batch_high_lock);
-	__zone_set_pageset_high_and_batch(zone, 0, 1);
+	__zone_set_pageset_high_and_batch(zone, 0, 0, 1);
 	__drain_all_pages(zone, true);
 }
 
 void zone_pcp_enable(struct zone *zone)
 {
-	__zone_set_pageset_high_and_batch(zone, zone->pageset_high, zone->pageset_batch);
+	__zone_set_pageset_high_and_batch(zone, zone->pageset_high,
+					  zone->pageset_high_max, zone->pageset_batch);
 	mutex_unlock(&pcp_batch_high_lock);
 }
 
@@ -514,6 +514,9 @@ void swap_readpage(struct page *page, bool synchronous, struct swap_iocb **plug)
 	}
 	delayacct_swapin_start();
 
+	if (folio_test_large(folio))
+		count_mthp_stat(folio_order(folio), MTHP_STAT_SWPIN);
+
 	if (zswap_load(folio)) {
 		folio_mark_uptodate(folio);
 		folio_unlock(folio);
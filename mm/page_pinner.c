@@ -11,12 +11,23 @@
 #include <linux/stackdepot.h>
 #include <linux/seq_file.h>
 #include <linux/sched/clock.h>
+#include <linux/hash.h>
+#include <linux/percpu.h>
 
 #include "internal.h"
 
 #define PAGE_PINNER_STACK_DEPTH 16
 static unsigned long pp_buf_size = 4096;
 
+/* record one in pp_sample_rate puts of pages that failed migration */
+static unsigned long pp_sample_rate = 1;
+/* and only those pinned for at least pp_threshold_usec */
+static u64 pp_threshold_usec;
+static DEFINE_PER_CPU(unsigned long, pp_sample_count);
+
+#define PP_STACK_HASH_BITS 9
+#define PP_STACK_HASH_SIZE (1 << PP_STACK_HASH_BITS)
+
 struct page_pinner {
 	depot_stack_handle_t handle;
 	u64 ts_usec;
@@ -54,6 +65,23 @@ struct page_pinner_buffer {
 /* alloc_contig failed pinner */
 static struct page_pinner_buffer pp_buffer;
 
+/* per stack aggregate of the records, which outlives the ring buffer */
+struct pp_stack_stat {
+	depot_stack_handle_t handle;
+	enum pp_state state;
+	unsigned long count;
+	u64 total_usec;
+	u64 max_usec;
+};
+
+struct pp_stack_table {
+	spinlock_t lock;
+	unsigned long dropped;
+	struct pp_stack_stat *slots;
+};
+
+static struct pp_stack_table pp_stacks;
+
 static bool page_pinner_enabled;
 DEFINE_STATIC_KEY_FALSE(page_pinner_inited);
 EXPORT_SYMBOL_GPL(page_pinner_inited);
@@ -98,6 +126,16 @@ static void init_page_pinner(void)
 	spin_lock_init(&pp_buffer.lock);
 	pp_buffer.index = 0;
 
+	pp_stacks.slots = kvcalloc(PP_STACK_HASH_SIZE, sizeof(*pp_stacks.slots),
+				   GFP_KERNEL);
+	if (!pp_stacks.slots) {
+		kvfree(pp_buffer.buffer);
+		pp_buffer.buffer = NULL;
+		pr_info("page_pinner disabled due to failure of stack table allocation\n");
+		return;
+	}
+	spin_lock_init(&pp_stacks.lock);
+
 	register_failure_stack();
 	static_branch_enable(&page_pinner_inited);
 }
@@ -137,6 +175,37 @@ static void capture_page_state(struct page *page,
 	record->mapcount = page_mapcount(page);
 }
 
+static void account_record(struct captured_pinner *record)
+{
+	u64 elapsed = record->state == PP_PUT ? record->elapsed : 0;
+	u32 key = record->handle ^ record->state;
+	unsigned long flags;
+	unsigned int i, idx;
+
+	spin_lock_irqsave(&pp_stacks.lock, flags);
+	/* open addressing, linear probing */
+	for (i = 0; i < PP_STACK_HASH_SIZE; i++) {
+		struct pp_stack_stat *stat;
+
+		idx = (hash_32(key, PP_STACK_HASH_BITS) + i) % PP_STACK_HASH_SIZE;
+		stat = &pp_stacks.slots[idx];
+		if (!stat->handle) {
+			stat->handle = record->handle;
+			stat->state = record->state;
+		} else if (stat->handle != record->handle ||
+			   stat->state != record->state) {
+			continue;
+		}
+		stat->count++;
+		stat->total_usec += elapsed;
+		stat->max_usec = max(stat->max_usec, elapsed);
+		goto unlock;
+	}
+	pp_stacks.dropped++;
+unlock:
+	spin_unlock_irqrestore(&pp_stacks.lock, flags);
+}
+
 static void add_record(struct page_pinner_buffer *pp_buf,
 		       struct captured_pinner *record)
 {
@@ -148,6 +217,25 @@ static void add_record(struct page_pinner_buffer *pp_buf,
 	pp_buf->index %= pp_buf_size;
 	pp_buf->buffer[idx] = *record;
 	spin_unlock_irqrestore(&pp_buf->lock, flags);
+
+	account_record(record);
+}
+
+/*
+ * Decide whether to record a put of a page pinned for @elapsed us, before
+ * paying for the stack trace.
+ */
+static bool sample_put(u64 elapsed)
+{
+	unsigned long rate = READ_ONCE(pp_sample_rate);
+
+	if (elapsed < READ_ONCE(pp_threshold_usec))
+		return false;
+
+	if (rate <= 1)
+		return true;
+
+	return this_cpu_inc_return(pp_sample_count) % rate == 0;
 }
 
 void __free_page_pinner(struct page *page, unsigned int order)
@@ -304,7 +392,6 @@ void __page_pinner_put_page(struct page *page)
 	}
 
 	page_pinner = get_page_pinner(page_ext);
-	record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
 	now = (u64)ktime_to_us(ktime_get_boottime());
 	ts_usec = page_pinner->ts_usec;
 
@@ -312,6 +399,13 @@ void __page_pinner_put_page(struct page *page)
 		record.elapsed = now - ts_usec;
 	else
 		record.elapsed = 0;
+
+	if (!sample_put(record.elapsed)) {
+		page_ext_put(page_ext);
+		return;
+	}
+
+	record.handle = save_stack(GFP_NOWAIT|__GFP_NOWARN);
 	record.state = PP_PUT;
 	capture_page_state(page, &record);
 
@@ -357,6 +451,74 @@ static const struct file_operations proc_buffer_operations = {
 	.read		= read_buffer,
 };
 
+static int stacks_show(struct seq_file *m, void *v)
+{
+	static const char * const state_names[] = {
+		[PP_PUT] = "put",
+		[PP_FREE] = "free",
+		[PP_FAIL_DETECTED] = "fail",
+	};
+	struct pp_stack_stat stat;
+	unsigned long *entries;
+	unsigned int nr_entries;
+	unsigned long flags;
+	char *kbuf;
+	int i;
+
+	kbuf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!kbuf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&pp_stacks.lock, flags);
+	seq_printf(m, "dropped %lu\n\n", pp_stacks.dropped);
+	spin_unlock_irqrestore(&pp_stacks.lock, flags);
+
+	for (i = 0; i < PP_STACK_HASH_SIZE; i++) {
+		spin_lock_irqsave(&pp_stacks.lock, flags);
+		stat = pp_stacks.slots[i];
+		spin_unlock_irqrestore(&pp_stacks.lock, flags);
+		if (!stat.handle)
+			continue;
+
+		seq_printf(m, "%s count %lu total %llu us max %llu us\n",
+			   state_names[stat.state], stat.count,
+			   stat.total_usec, stat.max_usec);
+		nr_entries = stack_depot_fetch(stat.handle, &entries);
+		stack_trace_snprint(kbuf, PAGE_SIZE, entries, nr_entries, 0);
+		seq_printf(m, "%s\n", kbuf);
+		cond_resched();
+	}
+	kfree(kbuf);
+	return 0;
+}
+
+static int stacks_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stacks_show, NULL);
+}
+
+/* any write resets the table */
+static ssize_t stacks_write(struct file *file, const char __user *buf,
+			    size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pp_stacks.lock, flags);
+	memset(pp_stacks.slots, 0, PP_STACK_HASH_SIZE * sizeof(*pp_stacks.slots));
+	pp_stacks.dropped = 0;
+	spin_unlock_irqrestore(&pp_stacks.lock, flags);
+
+	return count;
+}
+
+static const struct file_operations stacks_operations = {
+	.open		= stacks_open,
+	.read		= seq_read,
+	.write		= stacks_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int failure_tracking_set(void *data, u64 val)
 {
 	bool on;
@@ -407,6 +569,39 @@ DEFINE_DEBUGFS_ATTRIBUTE(buffer_size_fops,
 			 buffer_size_get,
 			 buffer_size_set, "%llu\n");
 
+static int sample_rate_set(void *data, u64 val)
+{
+	if (!val)
+		return -EINVAL;
+
+	WRITE_ONCE(pp_sample_rate, val);
+	return 0;
+}
+
+static int sample_rate_get(void *data, u64 *val)
+{
+	*val = READ_ONCE(pp_sample_rate);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(sample_rate_fops,
+			 sample_rate_get,
+			 sample_rate_set, "%llu\n");
+
+static int threshold_set(void *data, u64 val)
+{
+	WRITE_ONCE(pp_threshold_usec, val);
+	return 0;
+}
+
+static int threshold_get(void *data, u64 *val)
+{
+	*val = READ_ONCE(pp_threshold_usec);
+	return 0;
+}
+DEFINE_DEBUGFS_ATTRIBUTE(threshold_fops,
+			 threshold_get,
+			 threshold_set, "%llu\n");
+
 static int __init page_pinner_init(void)
 {
 	struct dentry *pp_debugfs_root;
@@ -429,6 +624,18 @@ static int __init page_pinner_init(void)
 	debugfs_create_file("buffer_size", 0644,
 			    pp_debugfs_root, NULL,
 			    &buffer_size_fops);
+
+	debugfs_create_file("stacks", 0644,
+			    pp_debugfs_root, NULL,
+			    &stacks_operations);
+
+	debugfs_create_file("sample_rate", 0644,
+			    pp_debugfs_root, NULL,
+			    &sample_rate_fops);
+
+	debugfs_create_file("threshold_us", 0644,
+			    pp_debugfs_root, NULL,
+			    &threshold_fops);
 	return 0;
 }
 late_initcall(page_pinner_init)
@@ -11,6 +11,7 @@
 #include <linux/kstrtox.h>
 #include <linux/mm.h>
 #include <linux/page_size_compat.h>
+#include <linux/vmstat.h>
 
 #define MIN_PAGE_SHIFT_COMPAT (PAGE_SHIFT + 1)
 #define MAX_PAGE_SHIFT_COMPAT 16 /* Max of 64KB */
@@ -137,4 +138,8 @@ void ___filemap_fixup(unsigned long addr, unsigned long prot, unsigned long old_
 	anon_addr = do_mmap(NULL, anon_addr, anon_len, prot,
 					MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED|__MAP_NO_COMPAT,
 					0, 0, &populate, NULL);
+	if (!IS_ERR_VALUE(anon_addr)) {
+		count_vm_event(PGSIZE_FIXUP_VMA);
+		count_vm_events(PGSIZE_FIXUP_PAGES, anon_len >> PAGE_SHIFT);
+	}
 }
@@ -198,6 +198,32 @@ static DECLARE_WORK(pcpu_balance_work, pcpu_balance_workfn);
 static bool pcpu_async_enabled __read_mostly;
 static bool pcpu_atomic_alloc_failed;
 
+/*
+ * Small areas freed by free_percpu() are parked in a per-size cache while
+ * still allocated in their chunk, so that the next allocation of the same
+ * size can be served without pcpu_alloc_mutex, pcpu_lock and the chunk
+ * bitmap search.  Cached areas are returned to their chunks by the balance
+ * work.  Lock order is pcpu_lock -> pcpu_area_cache.lock.
+ */
+#define PCPU_CACHE_MIN_SHIFT		3	/* 8 bytes */
+#define PCPU_CACHE_NR_SIZES		4	/* 8, 16, 32 and 64 bytes */
+#define PCPU_CACHE_DEPTH		32
+
+struct pcpu_area_cache {
+	spinlock_t		lock;
+	int			nr;
+	struct {
+		struct pcpu_chunk	*chunk;
+		int			off;
+	} areas[PCPU_CACHE_DEPTH];
+};
+
+static struct pcpu_area_cache pcpu_area_cache[PCPU_CACHE_NR_SIZES] = {
+	[0 ... PCPU_CACHE_NR_SIZES - 1] = {
+		.lock = __SPIN_LOCK_UNLOCKED(pcpu_area_cache.lock),
+	},
+};
+
 static void pcpu_schedule_balance_work(void)
 {
 	if (pcpu_async_enabled)
@@ -1701,6 +1727,117 @@ static void pcpu_memcg_free_hook(struct pcpu_chunk *chunk, int off, size_t size)
 }
 #endif /* CONFIG_MEMCG_KMEM */
 
+static struct pcpu_area_cache *pcpu_area_cache_for(size_t size)
+{
+	if (!is_power_of_2(size) || size < (1 << PCPU_CACHE_MIN_SHIFT) ||
+	    size > (1 << (PCPU_CACHE_MIN_SHIFT + PCPU_CACHE_NR_SIZES - 1)))
+		return NULL;
+
+	return &pcpu_area_cache[ilog2(size) - PCPU_CACHE_MIN_SHIFT];
+}
+
+/**
+ * pcpu_area_cache_get - take a cached area of @size bytes
+ * @size: aligned size of the area
+ * @align: required alignment
+ * @chunkp: out param for the chunk the area belongs to
+ * @offp: out param for the offset of the area in the chunk
+ *
+ * RETURNS:
+ * %true if an area was taken from the cache, %false otherwise.
+ */
+static bool pcpu_area_cache_get(size_t size, size_t align,
+				struct pcpu_chunk **chunkp, int *offp)
+{
+	struct pcpu_area_cache *cache = pcpu_area_cache_for(size);
+	unsigned long flags;
+	bool found = false;
+
+	if (!cache || !READ_ONCE(cache->nr))
+		return false;
+
+	spin_lock_irqsave(&cache->lock, flags);
+	if (cache->nr && IS_ALIGNED(cache->areas[cache->nr - 1].off, align)) {
+		cache->nr--;
+		*chunkp = cache->areas[cache->nr].chunk;
+		*offp = cache->areas[cache->nr].off;
+		found = true;
+	}
+	spin_unlock_irqrestore(&cache->lock, flags);
+
+	return found;
+}
+
+/**
+ * pcpu_area_cache_put - park a freed area in the cache
+ * @chunk: chunk of interest
+ * @off: addr offset into chunk
+ *
+ * The area stays allocated in @chunk.  Areas of the reserved chunk are
+ * never cached as they must only serve reserved allocations.
+ *
+ * CONTEXT:
+ * pcpu_lock.
+ *
+ * RETURNS:
+ * Size of the cached area, 0 if it wasn't cached.
+ */
+static int pcpu_area_cache_put(struct pcpu_chunk *chunk, int off)
+{
+	struct pcpu_area_cache *cache;
+	int bit_off, size;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	if (chunk == pcpu_reserved_chunk || chunk->isolated)
+		return 0;
+
+	bit_off = off / PCPU_MIN_ALLOC_SIZE;
+	size = (find_next_bit(chunk->bound_map, pcpu_chunk_map_bits(chunk),
+			      bit_off + 1) - bit_off) * PCPU_MIN_ALLOC_SIZE;
+
+	cache = pcpu_area_cache_for(size);
+	if (!cache)
+		return 0;
+
+	spin_lock(&cache->lock);
+	if (cache->nr == PCPU_CACHE_DEPTH) {
+		size = 0;
+	} else {
+		cache->areas[cache->nr].chunk = chunk;
+		cache->areas[cache->nr].off = off;
+		cache->nr++;
+	}
+	spin_unlock(&cache->lock);
+
+	return size;
+}
+
+/**
+ * pcpu_area_cache_drain - return all cached areas to their chunks
+ *
+ * CONTEXT:
+ * pcpu_lock.
+ */
+static void pcpu_area_cache_drain(void)
+{
+	int i;
+
+	lockdep_assert_held(&pcpu_lock);
+
+	for (i = 0; i < PCPU_CACHE_NR_SIZES; i++) {
+		struct pcpu_area_cache *cache = &pcpu_area_cache[i];
+
+		spin_lock(&cache->lock);
+		while (cache->nr) {
+			cache->nr--;
+			pcpu_free_area(cache->areas[cache->nr].chunk,
+				       cache->areas[cache->nr].off);
+		}
+		spin_unlock(&cache->lock);
+	}
+}
+
 /**
  * pcpu_alloc - the percpu allocator
  * @size: size of area to allocate in bytes
@@ -1760,6 +1897,10 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 	if (unlikely(!pcpu_memcg_pre_alloc_hook(size, gfp, &objcg)))
 		return NULL;
 
+	/* cached areas are populated, so atomic allocations can use them too */
+	if (!reserved && pcpu_area_cache_get(size, align, &chunk, &off))
+		goto area_cached;
+
 	if (!is_atomic) {
 		/*
 		 * pcpu_balance_workfn() allocates memory under this mutex,
@@ -1870,6 +2011,7 @@ static void __percpu *pcpu_alloc(size_t size, size_t align, bool reserved,
 	if (pcpu_nr_empty_pop_pages < PCPU_EMPTY_POP_PAGES_LOW)
 		pcpu_schedule_balance_work();
 
+area_cached:
 	/* clear the areas and return address relative to base address */
 	for_each_possible_cpu(cpu)
 		memset((void *)pcpu_chunk_addr(chunk, cpu, 0) + off, 0, size);
@@ -2235,6 +2377,7 @@ static void pcpu_balance_workfn(struct work_struct *work)
 	mutex_lock(&pcpu_alloc_mutex);
 	spin_lock_irq(&pcpu_lock);
 
+	pcpu_area_cache_drain();
 	pcpu_balance_free(false);
 	pcpu_reclaim_populated();
 	pcpu_balance_populated();
@@ -2273,6 +2416,14 @@ void free_percpu(void __percpu *ptr)
 	chunk = pcpu_chunk_addr_search(addr);
 	off = addr - chunk->base_addr;
 
+	size = pcpu_area_cache_put(chunk, off);
+	if (size) {
+		pcpu_memcg_free_hook(chunk, off, size);
+		trace_percpu_free_percpu(chunk->base_addr, off, ptr);
+		spin_unlock_irqrestore(&pcpu_lock, flags);
+		return;
+	}
+
 	size = pcpu_free_area(chunk, off);
 
 	pcpu_memcg_free_hook(chunk, off, size);
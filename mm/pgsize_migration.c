@@ -12,6 +12,7 @@
 
 #include <linux/pgsize_migration.h>
 
+#include <linux/dcache.h>
 #include <linux/init.h>
 #include <linux/jump_label.h>
 #include <linux/kobject.h>
@@ -20,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/sysfs.h>
+#include <linux/vmstat.h>
 
 typedef void (*show_pad_maps_fn)	(struct seq_file *m, struct vm_area_struct *vma);
 typedef int  (*show_pad_smaps_fn)	(struct seq_file *m, void *v);
@@ -174,8 +176,10 @@ static inline bool linker_ctx(void)
 {
 	struct pt_regs *regs = task_pt_regs(current);
 	struct mm_struct *mm = current->mm;
+	struct name_snapshot name;
 	struct vm_area_struct *vma;
 	struct file *file;
+	bool ret;
 
 	if (!regs)
 		return false;
@@ -189,27 +193,25 @@ static inline bool linker_ctx(void)
 	if (!file)
 		return false;
 
-	if ((vma->vm_flags & VM_EXEC)) {
-		char buf[64];
-		const int bufsize = sizeof(buf);
-		char *path;
-
-		memset(buf, 0, bufsize);
-		path = d_path(&file->f_path, buf, bufsize);
-
-		/*
-		 * Depending on interpreter requested, valid paths could be any of:
-		 *   1. /system/bin/bootstrap/linker64
-		 *   2. /system/bin/linker64
-		 *   3. /apex/com.android.runtime/bin/linker64
-		 *
-		 * Check the base name (linker64).
-		 */
-		if (!strcmp(kbasename(path), "linker64"))
-			return true;
-	}
+	/*
+	 * Depending on interpreter requested, valid paths could be any of:
+	 *   1. /system/bin/bootstrap/linker64
+	 *   2. /system/bin/linker64
+	 *   3. /apex/com.android.runtime/bin/linker64
+	 *
+	 * Only the base name (linker64) is checked, and that is the name of the
+	 * mapped file's dentry, so there is no need to build the whole path with
+	 * d_path() on every padding hint. A concurrent rename can change the
+	 * dentry's name, so compare against a stable snapshot of it.
+	 */
+	if (!(vma->vm_flags & VM_EXEC))
+		return false;
+
+	take_dentry_name_snapshot(&name, file->f_path.dentry);
+	ret = !strcmp(name.name.name, "linker64");
+	release_dentry_name_snapshot(&name);
 
-	return false;
+	return ret;
 }
 
 /*
@@ -259,6 +261,8 @@ void madvise_vma_pad_pages(struct vm_area_struct *vma,
 		return;
 
 	vma_set_pad_pages(vma, nr_pad_pages);
+	count_vm_event(PGSIZE_PAD_VMA);
+	count_vm_events(PGSIZE_PAD_PAGES, nr_pad_pages);
 }
 
 static const char *pad_vma_name(struct vm_area_struct *vma)
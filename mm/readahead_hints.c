@@ -0,0 +1,453 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Learned readahead hints
+ *
+ * Applications read the same ranges of the same files (APKs, oat and vdex
+ * files, shared libraries) in roughly the same order on every cold start.
+ * For a while after a file is opened, the page cache misses on it are
+ * recorded against the inode; later opens of the same inode issue the
+ * recorded ranges as one batch of readahead, before the application faults
+ * on them one by one.
+ *
+ * The store is keyed by device, inode number and generation, holds at most
+ * max_entries inodes, evicting the least recently opened one when full, and
+ * can be saved to and reloaded from /proc/readahead_hints so that it survives
+ * reboots.  Each line is "<major>:<minor> <ino> <generation> <start>+<nr>..."
+ * with the ranges in pages.  Writing "clear" empties the store.
+ */
+
+#define pr_fmt(fmt) "readahead_hints: " fmt
+
+#include <linux/fs.h>
+#include <linux/hashtable.h>
+#include <linux/jiffies.h>
+#include <linux/kdev_t.h>
+#include <linux/module.h>
+#include <linux/pagemap.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "readahead_hints."
+
+/* Ranges at most this many pages apart are recorded as one */
+#define RA_HINT_MERGE_GAP	16
+#define RA_HINT_MAX_RANGES	64
+#define RA_HINT_HASH_BITS	10
+/* Hard limit on max_entries, each hint takes about 1KB */
+#define RA_HINT_MAX_ENTRIES	16384
+
+static bool enabled __read_mostly = true;
+module_param(enabled, bool, 0644);
+
+/* How long after an open page cache misses are recorded */
+static unsigned int window_ms __read_mostly = 2000;
+module_param(window_ms, uint, 0644);
+
+static unsigned int max_entries __read_mostly = 1024;
+module_param(max_entries, uint, 0644);
+
+struct ra_hint_range {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_hint {
+	struct hlist_node node;
+	struct list_head lru;
+	dev_t dev;
+	unsigned long ino;
+	u32 gen;
+	/* jiffies until which misses are recorded, 0 once loaded */
+	unsigned long record_until;
+	unsigned int nr_ranges;
+	struct ra_hint_range ranges[RA_HINT_MAX_RANGES];
+};
+
+static DEFINE_HASHTABLE(ra_hints, RA_HINT_HASH_BITS);
+/* most recently opened first */
+static LIST_HEAD(ra_hints_lru);
+static DEFINE_SPINLOCK(ra_hints_lock);
+static unsigned int nr_ra_hints;
+
+static u32 ra_hint_hash(dev_t dev, unsigned long ino)
+{
+	return hash_long(ino ^ ((unsigned long)dev << 7), RA_HINT_HASH_BITS);
+}
+
+static struct ra_hint *ra_hint_find(dev_t dev, unsigned long ino, u32 gen)
+{
+	struct ra_hint *hint;
+
+	lockdep_assert_held(&ra_hints_lock);
+
+	hash_for_each_possible(ra_hints, hint, node, ra_hint_hash(dev, ino))
+		if (hint->dev == dev && hint->ino == ino && hint->gen == gen)
+			return hint;
+
+	return NULL;
+}
+
+static void ra_hint_del(struct ra_hint *hint)
+{
+	lockdep_assert_held(&ra_hints_lock);
+
+	hash_del(&hint->node);
+	list_del(&hint->lru);
+	nr_ra_hints--;
+}
+
+/* Add @new, evicting the least recently opened hints to make room */
+static struct ra_hint *ra_hint_insert(struct ra_hint *new)
+{
+	unsigned int limit = min(READ_ONCE(max_entries), RA_HINT_MAX_ENTRIES);
+	struct ra_hint *old;
+
+	lockdep_assert_held(&ra_hints_lock);
+
+	if (!limit)
+		return NULL;
+
+	while (nr_ra_hints >= limit) {
+		old = list_last_entry(&ra_hints_lru, struct ra_hint, lru);
+		ra_hint_del(old);
+		kfree(old);
+	}
+
+	hash_add(ra_hints, &new->node, ra_hint_hash(new->dev, new->ino));
+	list_add(&new->lru, &ra_hints_lru);
+	nr_ra_hints++;
+	return new;
+}
+
+static bool ra_hint_recording(struct ra_hint *hint)
+{
+	return hint->record_until && time_before(jiffies, hint->record_until);
+}
+
+static void ra_hint_add_range(struct ra_hint *hint, pgoff_t start,
+			      unsigned long nr)
+{
+	struct ra_hint_range *range;
+	unsigned int i;
+
+	for (i = 0; i < hint->nr_ranges; i++) {
+		range = &hint->ranges[i];
+
+		if (start + nr + RA_HINT_MERGE_GAP < range->start ||
+		    start > range->start + range->nr + RA_HINT_MERGE_GAP)
+			continue;
+
+		if (start < range->start) {
+			range->nr += range->start - start;
+			range->start = start;
+		}
+		if (start + nr > range->start + range->nr)
+			range->nr = start + nr - range->start;
+		return;
+	}
+
+	if (hint->nr_ranges < RA_HINT_MAX_RANGES) {
+		range = &hint->ranges[hint->nr_ranges++];
+		range->start = start;
+		range->nr = nr;
+	}
+}
+
+static void ra_hint_replay(struct file *file, struct ra_hint_range *ranges,
+			   unsigned int nr_ranges)
+{
+	struct address_space *mapping = file->f_mapping;
+	pgoff_t end_index;
+	unsigned long nr;
+	struct blk_plug plug;
+	unsigned int i;
+
+	end_index = DIV_ROUND_UP(i_size_read(mapping->host), PAGE_SIZE);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr_ranges; i++) {
+		DEFINE_READAHEAD(ractl, file, &file->f_ra, mapping,
+				 ranges[i].start);
+
+		if (ranges[i].start >= end_index)
+			continue;
+		nr = min(ranges[i].nr, end_index - ranges[i].start);
+		page_cache_ra_unbounded(&ractl, nr, 0);
+	}
+	blk_finish_plug(&plug);
+}
+
+void readahead_hints_open(struct file *file)
+{
+	struct inode *inode = file_inode(file);
+	dev_t dev = inode->i_sb->s_dev;
+	struct ra_hint_range *ranges = NULL;
+	struct ra_hint *hint, *new;
+	unsigned int nr_ranges = 0;
+	bool cached = true;
+	void *entry;
+
+	if (!READ_ONCE(enabled) || !S_ISREG(inode->i_mode) ||
+	    !(file->f_mode & FMODE_READ) || (file->f_flags & O_DIRECT) ||
+	    !file->f_mapping->a_ops->read_folio)
+		return;
+
+	spin_lock(&ra_hints_lock);
+	hint = ra_hint_find(dev, inode->i_ino, inode->i_generation);
+	if (hint) {
+		list_move(&hint->lru, &ra_hints_lru);
+		/*
+		 * Only replay when the file is not in the page cache already,
+		 * a shadow entry of an evicted folio counts as not cached.
+		 */
+		if (!ra_hint_recording(hint) && hint->nr_ranges) {
+			entry = xa_load(&file->f_mapping->i_pages,
+					hint->ranges[0].start);
+			cached = entry && !xa_is_value(entry);
+		}
+		if (!cached) {
+			nr_ranges = hint->nr_ranges;
+			ranges = kmemdup(hint->ranges,
+					 nr_ranges * sizeof(*ranges),
+					 GFP_ATOMIC);
+		}
+	}
+	spin_unlock(&ra_hints_lock);
+
+	if (ranges) {
+		ra_hint_replay(file, ranges, nr_ranges);
+		kfree(ranges);
+		return;
+	}
+	if (hint)
+		return;
+
+	/* first open: record what it misses on */
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return;
+	new->dev = dev;
+	new->ino = inode->i_ino;
+	new->gen = inode->i_generation;
+	new->record_until = jiffies + msecs_to_jiffies(READ_ONCE(window_ms)) ?: 1;
+
+	spin_lock(&ra_hints_lock);
+	if (!ra_hint_find(dev, inode->i_ino, inode->i_generation) &&
+	    ra_hint_insert(new)) {
+		file->f_ra.hint_until = new->record_until;
+		new = NULL;
+	}
+	spin_unlock(&ra_hints_lock);
+	kfree(new);
+}
+
+void readahead_hints_record(struct file *file, pgoff_t index,
+			    unsigned long nr)
+{
+	struct inode *inode = file_inode(file);
+	struct ra_hint *hint;
+
+	if (time_after_eq(jiffies, file->f_ra.hint_until)) {
+		file->f_ra.hint_until = 0;
+		return;
+	}
+
+	spin_lock(&ra_hints_lock);
+	hint = ra_hint_find(inode->i_sb->s_dev, inode->i_ino,
+			    inode->i_generation);
+	if (hint && ra_hint_recording(hint))
+		ra_hint_add_range(hint, index, nr);
+	spin_unlock(&ra_hints_lock);
+}
+
+static void *ra_hints_seq_start(struct seq_file *m, loff_t *pos)
+	__acquires(&ra_hints_lock)
+{
+	struct ra_hint *hint;
+	loff_t n = *pos;
+	int bkt;
+
+	spin_lock(&ra_hints_lock);
+	hash_for_each(ra_hints, bkt, hint, node)
+		if (!n--)
+			return hint;
+
+	return NULL;
+}
+
+static void *ra_hints_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	struct ra_hint *hint = v;
+	struct hlist_node *next;
+	u32 bkt;
+
+	++*pos;
+	next = hint->node.next;
+	if (next)
+		return hlist_entry(next, struct ra_hint, node);
+
+	for (bkt = ra_hint_hash(hint->dev, hint->ino) + 1;
+	     bkt < HASH_SIZE(ra_hints); bkt++) {
+		if (!hlist_empty(&ra_hints[bkt]))
+			return hlist_entry(ra_hints[bkt].first, struct ra_hint,
+					   node);
+	}
+
+	return NULL;
+}
+
+static void ra_hints_seq_stop(struct seq_file *m, void *v)
+	__releases(&ra_hints_lock)
+{
+	spin_unlock(&ra_hints_lock);
+}
+
+static int ra_hints_seq_show(struct seq_file *m, void *v)
+{
+	struct ra_hint *hint = v;
+	unsigned int i;
+
+	/* nothing worth saving yet */
+	if (ra_hint_recording(hint) || !hint->nr_ranges)
+		return 0;
+
+	seq_printf(m, "%u:%u %lu %u", MAJOR(hint->dev), MINOR(hint->dev),
+		   hint->ino, hint->gen);
+	for (i = 0; i < hint->nr_ranges; i++)
+		seq_printf(m, " %lu+%lu", hint->ranges[i].start,
+			   hint->ranges[i].nr);
+	seq_putc(m, '\n');
+
+	return 0;
+}
+
+static const struct seq_operations ra_hints_seq_ops = {
+	.start	= ra_hints_seq_start,
+	.next	= ra_hints_seq_next,
+	.stop	= ra_hints_seq_stop,
+	.show	= ra_hints_seq_show,
+};
+
+static int ra_hints_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &ra_hints_seq_ops);
+}
+
+static void ra_hints_clear(void)
+{
+	struct hlist_node *tmp;
+	struct ra_hint *hint;
+	HLIST_HEAD(freelist);
+	int bkt;
+
+	spin_lock(&ra_hints_lock);
+	hash_for_each_safe(ra_hints, bkt, tmp, hint, node) {
+		ra_hint_del(hint);
+		hlist_add_head(&hint->node, &freelist);
+	}
+	spin_unlock(&ra_hints_lock);
+
+	hlist_for_each_entry_safe(hint, tmp, &freelist, node)
+		kfree(hint);
+}
+
+/* Parse one saved line, see the format at the top of this file */
+static int ra_hints_load_line(char *line)
+{
+	unsigned int major, minor, gen;
+	unsigned long ino, start, nr;
+	struct ra_hint *hint, *old;
+	char *tok;
+	int ret = -EINVAL;
+
+	tok = strsep(&line, " ");
+	if (!tok || sscanf(tok, "%u:%u", &major, &minor) != 2)
+		return -EINVAL;
+	tok = strsep(&line, " ");
+	if (!tok || kstrtoul(tok, 10, &ino))
+		return -EINVAL;
+	tok = strsep(&line, " ");
+	if (!tok || kstrtouint(tok, 10, &gen))
+		return -EINVAL;
+
+	hint = kzalloc(sizeof(*hint), GFP_KERNEL);
+	if (!hint)
+		return -ENOMEM;
+	hint->dev = MKDEV(major, minor);
+	hint->ino = ino;
+	hint->gen = gen;
+
+	while ((tok = strsep(&line, " ")) != NULL) {
+		if (!*tok)
+			continue;
+		if (sscanf(tok, "%lu+%lu", &start, &nr) != 2 || !nr)
+			goto free;
+		ra_hint_add_range(hint, start, nr);
+	}
+
+	spin_lock(&ra_hints_lock);
+	old = ra_hint_find(hint->dev, hint->ino, hint->gen);
+	if (old)
+		ra_hint_del(old);
+	if (ra_hint_insert(hint)) {
+		hint = NULL;
+		ret = 0;
+	} else {
+		ret = -ENOSPC;
+	}
+	spin_unlock(&ra_hints_lock);
+	kfree(old);
+free:
+	kfree(hint);
+	return ret;
+}
+
+/* Each write must consist of whole lines */
+static ssize_t ra_hints_write(struct file *file, const char __user *ubuf,
+			      size_t count, loff_t *ppos)
+{
+	char *buf, *pos, *line;
+	int ret = 0;
+
+	if (count > PAGE_SIZE * 4)
+		return -E2BIG;
+
+	buf = memdup_user_nul(ubuf, count);
+	if (IS_ERR(buf))
+		return PTR_ERR(buf);
+
+	pos = buf;
+	while (!ret && (line = strsep(&pos, "\n")) != NULL) {
+		line = strim(line);
+		if (!*line)
+			continue;
+		if (!strcmp(line, "clear"))
+			ra_hints_clear();
+		else
+			ret = ra_hints_load_line(line);
+	}
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+static const struct proc_ops ra_hints_proc_ops = {
+	.proc_open	= ra_hints_open,
+	.proc_read	= seq_read,
+	.proc_write	= ra_hints_write,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= seq_release,
+};
+
+static int __init readahead_hints_init(void)
+{
+	if (!proc_create("readahead_hints", 0600, NULL, &ra_hints_proc_ops))
+		pr_warn("failed to create /proc/readahead_hints\n");
+	return 0;
+}
+late_initcall(readahead_hints_init);
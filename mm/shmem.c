@@ -123,6 +123,7 @@ struct shmem_options {
 	umode_t mode;
 	bool full_inums;
 	int huge;
+	unsigned char large_order;
 	int seen;
 	bool noswap;
 	unsigned short quota_types;
@@ -133,6 +134,7 @@ struct shmem_options {
 #define SHMEM_SEEN_INUMS 8
 #define SHMEM_SEEN_NOSWAP 16
 #define SHMEM_SEEN_QUOTA 32
+#define SHMEM_SEEN_LARGE_ORDER 64
 };
 
 #ifdef CONFIG_TMPFS
@@ -1644,26 +1646,50 @@ static gfp_t limit_gfp_mask(gfp_t huge_gfp, gfp_t limit_gfp)
 }
 
 static struct folio *shmem_alloc_hugefolio(gfp_t gfp,
-		struct shmem_inode_info *info, pgoff_t index)
+		struct shmem_inode_info *info, pgoff_t index, int order)
 {
 	struct vm_area_struct pvma;
 	struct address_space *mapping = info->vfs_inode.i_mapping;
 	pgoff_t hindex;
 	struct folio *folio;
+	long nr = 1L << order;
 
-	hindex = round_down(index, HPAGE_PMD_NR);
-	if (xa_find(&mapping->i_pages, &hindex, hindex + HPAGE_PMD_NR - 1,
+	hindex = round_down(index, nr);
+	if (xa_find(&mapping->i_pages, &hindex, hindex + nr - 1,
 								XA_PRESENT))
 		return NULL;
 
 	shmem_pseudo_vma_init(&pvma, info, hindex);
-	folio = vma_alloc_folio(gfp, HPAGE_PMD_ORDER, &pvma, 0, true);
+	folio = vma_alloc_folio(gfp, order, &pvma, 0, true);
 	shmem_pseudo_vma_destroy(&pvma);
-	if (!folio)
+	if (!folio && order == HPAGE_PMD_ORDER)
 		count_vm_event(THP_FILE_FALLBACK);
 	return folio;
 }
 
+/*
+ * The order of the sub-PMD folio to try at @index when a PMD-sized one was
+ * not wanted or could not be had, or 0.  Unlike PMD-sized folios these are
+ * not queued for the shrinker, so they are kept within i_size.
+ */
+static int shmem_large_order(struct inode *inode, pgoff_t index)
+{
+	int order = SHMEM_SB(inode->i_sb)->large_order;
+	pgoff_t end;
+
+	if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) ||
+	    shmem_huge == SHMEM_HUGE_DENY)
+		return 0;
+
+	end = DIV_ROUND_UP(i_size_read(inode), PAGE_SIZE);
+	for (; order > 1; order--) {
+		if (round_down(index, 1UL << order) + (1UL << order) <= end)
+			return order;
+	}
+
+	return 0;
+}
+
 static struct folio *shmem_alloc_folio(gfp_t gfp,
 			struct shmem_inode_info *info, pgoff_t index)
 {
@@ -1682,7 +1708,7 @@ static struct folio *shmem_alloc_folio(gfp_t gfp,
 }
 
 static struct folio *shmem_alloc_and_acct_folio(gfp_t gfp, struct inode *inode,
-		pgoff_t index, bool huge)
+		pgoff_t index, int order)
 {
 	struct shmem_inode_info *info = SHMEM_I(inode);
 	struct folio *folio;
@@ -1690,15 +1716,15 @@ static struct folio *shmem_alloc_and_acct_folio(gfp_t gfp, struct inode *inode,
 	int err;
 
 	if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
-		huge = false;
-	nr = huge ? HPAGE_PMD_NR : 1;
+		order = 0;
+	nr = 1 << order;
 
 	err = shmem_inode_acct_block(inode, nr);
 	if (err)
 		goto failed;
 
-	if (huge)
-		folio = shmem_alloc_hugefolio(gfp, info, index);
+	if (order)
+		folio = shmem_alloc_hugefolio(gfp, info, index, order);
 	else
 		folio = shmem_alloc_folio(gfp, info, index);
 	if (folio) {
@@ -1957,6 +1983,7 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 	struct folio *folio;
 	pgoff_t hindex;
 	gfp_t huge_gfp;
+	int order;
 	int error;
 	int once = 0;
 	int alloced = 0;
@@ -2029,16 +2056,25 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 		return 0;
 	}
 
+	huge_gfp = vma_thp_gfp_mask(vma);
+	huge_gfp = limit_gfp_mask(huge_gfp, gfp);
 	if (!shmem_is_huge(inode, index, false,
 			   vma ? vma->vm_mm : NULL, vma ? vma->vm_flags : 0))
-		goto alloc_nohuge;
+		goto alloc_large;
 
-	huge_gfp = vma_thp_gfp_mask(vma);
-	huge_gfp = limit_gfp_mask(huge_gfp, gfp);
-	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, true);
+	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index,
+					   HPAGE_PMD_ORDER);
+	if (IS_ERR(folio)) {
+alloc_large:
+		folio = ERR_PTR(-ENOMEM);
+		order = shmem_large_order(inode, index);
+		if (order)
+			folio = shmem_alloc_and_acct_folio(huge_gfp, inode,
+							   index, order);
+	}
 	if (IS_ERR(folio)) {
 alloc_nohuge:
-		folio = shmem_alloc_and_acct_folio(gfp, inode, index, false);
+		folio = shmem_alloc_and_acct_folio(gfp, inode, index, 0);
 	}
 	if (IS_ERR(folio)) {
 		int retry = 5;
@@ -3852,6 +3888,7 @@ static const struct export_operations shmem_export_ops = {
 enum shmem_param {
 	Opt_gid,
 	Opt_huge,
+	Opt_huge_order,
 	Opt_mode,
 	Opt_mpol,
 	Opt_nr_blocks,
@@ -3881,6 +3918,7 @@ static const struct constant_table shmem_param_enums_huge[] = {
 const struct fs_parameter_spec shmem_fs_parameters[] = {
 	fsparam_u32   ("gid",		Opt_gid),
 	fsparam_enum  ("huge",		Opt_huge,  shmem_param_enums_huge),
+	fsparam_u32   ("huge_order",	Opt_huge_order),
 	fsparam_u32oct("mode",		Opt_mode),
 	fsparam_string("mpol",		Opt_mpol),
 	fsparam_string("nr_blocks",	Opt_nr_blocks),
@@ -3981,6 +4019,16 @@ static int shmem_parse_one(struct fs_context *fc, struct fs_parameter *param)
 			goto unsupported_parameter;
 		ctx->seen |= SHMEM_SEEN_HUGE;
 		break;
+	case Opt_huge_order:
+		if (result.uint_32 &&
+		    !(IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) &&
+		      has_transparent_hugepage()))
+			goto unsupported_parameter;
+		if (result.uint_32 == 1 || result.uint_32 >= HPAGE_PMD_ORDER)
+			goto bad_value;
+		ctx->large_order = result.uint_32;
+		ctx->seen |= SHMEM_SEEN_LARGE_ORDER;
+		break;
 	case Opt_mpol:
 		if (IS_ENABLED(CONFIG_NUMA)) {
 			mpol_put(ctx->mpol);
@@ -4187,6 +4235,8 @@ static int shmem_reconfigure(struct fs_context *fc)
 
 	if (ctx->seen & SHMEM_SEEN_HUGE)
 		sbinfo->huge = ctx->huge;
+	if (ctx->seen & SHMEM_SEEN_LARGE_ORDER)
+		sbinfo->large_order = ctx->large_order;
 	if (ctx->seen & SHMEM_SEEN_INUMS)
 		sbinfo->full_inums = ctx->full_inums;
 	if (ctx->seen & SHMEM_SEEN_BLOCKS)
@@ -4260,6 +4310,8 @@ static int shmem_show_options(struct seq_file *seq, struct dentry *root)
 	/* Rightly or wrongly, show huge mount option unmasked by shmem_huge */
 	if (sbinfo->huge)
 		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+	if (sbinfo->large_order)
+		seq_printf(seq, ",huge_order=%u", sbinfo->large_order);
 #endif
 	mpol = shmem_get_sbmpol(sbinfo);
 	shmem_show_mpol(seq, mpol);
@@ -4335,6 +4387,7 @@ static int shmem_fill_super(struct super_block *sb, struct fs_context *fc)
 	sbinfo->full_inums = ctx->full_inums;
 	sbinfo->mode = ctx->mode;
 	sbinfo->huge = ctx->huge;
+	sbinfo->large_order = ctx->large_order;
 	sbinfo->mpol = ctx->mpol;
 	ctx->mpol = NULL;
 
@@ -4714,6 +4767,36 @@ static ssize_t shmem_enabled_store(struct kobject *kobj,
 }
 
 struct kobj_attribute shmem_enabled_attr = __ATTR_RW(shmem_enabled);
+
+/*
+ * huge_order of the internal mount, which backs memfd, SysV shm and shared
+ * anonymous mappings.
+ */
+static ssize_t shmem_large_order_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", SHMEM_SB(shm_mnt->mnt_sb)->large_order);
+}
+
+static ssize_t shmem_large_order_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	unsigned int order;
+	int err;
+
+	err = kstrtouint(buf, 10, &order);
+	if (err)
+		return err;
+	if (order && !has_transparent_hugepage())
+		return -EINVAL;
+	if (order == 1 || order >= HPAGE_PMD_ORDER)
+		return -EINVAL;
+
+	SHMEM_SB(shm_mnt->mnt_sb)->large_order = order;
+	return count;
+}
+
+struct kobj_attribute shmem_large_order_attr = __ATTR_RW(shmem_large_order);
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE && CONFIG_SYSFS */
 
 #else /* !CONFIG_SHMEM */
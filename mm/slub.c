@@ -326,6 +326,39 @@ static inline void stat(const struct kmem_cache *s, enum stat_item si)
 #endif
 }
 
+#ifndef CONFIG_SLUB_TINY
+/*
+ * Per cpu array of free objects for caches created with SLAB_PCPU_SHEAVES.
+ * Objects in a sheaf have already been through the free hooks, and are
+ * handed out again without touching the cpu slab or the node lists. An
+ * empty sheaf is refilled and a full one is drained half way in bulk.
+ */
+struct slub_percpu_sheaves {
+	local_lock_t lock;
+	unsigned int size;
+	void *objects[];
+};
+
+#define SLUB_SHEAF_MAX		64
+#define SLUB_SHEAF_BATCH	(SLUB_SHEAF_MAX / 2)
+
+static inline bool slab_has_sheaves(struct kmem_cache *s)
+{
+	return s->cpu_sheaves;
+}
+
+static void *alloc_from_pcs_refill(struct kmem_cache *s, gfp_t gfp);
+static void free_to_pcs_flush(struct kmem_cache *s, void *object,
+			      unsigned long flags);
+static void pcs_flush_local(struct kmem_cache *s);
+static void pcs_flush_cpu(struct kmem_cache *s, int cpu);
+#else
+static inline bool slab_has_sheaves(struct kmem_cache *s)
+{
+	return false;
+}
+#endif
+
 /*
  * Tracks for which NUMA nodes we have kmem_cache_nodes allocated.
  * Corresponds to node_state[N_NORMAL_MEMORY], but can temporarily
@@ -2825,6 +2858,9 @@ static void flush_cpu_slab(struct work_struct *w)
 	sfw = container_of(w, struct slub_flush_work, work);
 
 	s = sfw->s;
+	if (slab_has_sheaves(s))
+		pcs_flush_local(s);
+
 	c = this_cpu_ptr(s->cpu_slab);
 
 	if (c->slab)
@@ -2837,6 +2873,9 @@ static bool has_cpu_slab(int cpu, struct kmem_cache *s)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (slab_has_sheaves(s) && per_cpu_ptr(s->cpu_sheaves, cpu)->size)
+		return true;
+
 	return c->slab || slub_percpu_partial(c);
 }
 
@@ -2889,8 +2928,11 @@ static int slub_cpu_dead(unsigned int cpu)
 	struct kmem_cache *s;
 
 	mutex_lock(&slab_mutex);
-	list_for_each_entry(s, &slab_caches, list)
+	list_for_each_entry(s, &slab_caches, list) {
+		if (slab_has_sheaves(s))
+			pcs_flush_cpu(s, cpu);
 		__flush_cpu_slab(s, cpu);
+	}
 	mutex_unlock(&slab_mutex);
 	return 0;
 }
@@ -3463,6 +3505,52 @@ static __always_inline void maybe_wipe_obj_freeptr(struct kmem_cache *s,
 			0, sizeof(void *));
 }
 
+#ifndef CONFIG_SLUB_TINY
+static __fastpath_inline void *alloc_from_pcs(struct kmem_cache *s, gfp_t gfp)
+{
+	struct slub_percpu_sheaves *pcs;
+	unsigned long flags;
+	void *object;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	if (unlikely(!pcs->size)) {
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+		return alloc_from_pcs_refill(s, gfp);
+	}
+	object = pcs->objects[--pcs->size];
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	stat(s, ALLOC_PCS);
+	return object;
+}
+
+static __fastpath_inline void free_to_pcs(struct kmem_cache *s, void *object)
+{
+	struct slub_percpu_sheaves *pcs;
+	unsigned long flags;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	if (unlikely(pcs->size == s->sheaf_capacity)) {
+		/* Drops the lock */
+		free_to_pcs_flush(s, object, flags);
+		return;
+	}
+	pcs->objects[pcs->size++] = object;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	stat(s, FREE_PCS);
+}
+#else /* CONFIG_SLUB_TINY */
+static inline void *alloc_from_pcs(struct kmem_cache *s, gfp_t gfp)
+{
+	return NULL;
+}
+
+static inline void free_to_pcs(struct kmem_cache *s, void *object) { }
+#endif /* CONFIG_SLUB_TINY */
+
 /*
  * Inlined fastpath so that allocation functions (kmalloc, kmem_cache_alloc)
  * have the fastpath folded into their functions. So no function call
@@ -3488,7 +3576,11 @@ static __fastpath_inline void *slab_alloc_node(struct kmem_cache *s, struct list
 	if (unlikely(object))
 		goto out;
 
-	object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
+	if (slab_has_sheaves(s) &&
+	    (node == NUMA_NO_NODE || node == numa_mem_id()))
+		object = alloc_from_pcs(s, gfpflags);
+	if (!object)
+		object = __slab_alloc_node(s, gfpflags, node, addr, orig_size);
 
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
@@ -3827,6 +3919,16 @@ static __fastpath_inline void slab_free(struct kmem_cache *s, struct slab *slab,
 				      unsigned long addr)
 {
 	memcg_slab_free_hook(s, slab, p, cnt);
+
+	if (slab_has_sheaves(s) && !tail && !is_kfence_address(head) &&
+	    slab_nid(slab) == numa_mem_id()) {
+		/* KASAN might put the object into quarantine instead */
+		if (!slab_free_hook(s, head, slab_want_init_on_free(s)))
+			free_to_pcs(s, head);
+		trace_android_vh_slab_free(addr, s);
+		return;
+	}
+
 	/*
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
@@ -4087,6 +4189,109 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 }
 EXPORT_SYMBOL(kmem_cache_alloc_bulk);
 
+#ifndef CONFIG_SLUB_TINY
+/*
+ * Return objects that have already been through the free hooks to their
+ * slabs, one detached freelist at a time.
+ */
+static void sheaf_flush_objects(struct kmem_cache *s, void **p, size_t size)
+{
+	stat(s, SHEAF_FLUSH);
+
+	do {
+		struct detached_freelist df;
+
+		size = build_detached_freelist(s, size, p, &df);
+		if (!df.slab)
+			continue;
+
+		do_slab_free(df.s, df.slab, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	} while (likely(size));
+}
+
+/* Called with an empty sheaf, refills it through the bulk allocator */
+static noinline void *alloc_from_pcs_refill(struct kmem_cache *s, gfp_t gfp)
+{
+	struct slub_percpu_sheaves *pcs;
+	void *batch[SLUB_SHEAF_BATCH];
+	unsigned int filled, nr;
+	unsigned long flags;
+
+	filled = __kmem_cache_alloc_bulk(s, gfp, s->sheaf_capacity / 2, batch,
+					 NULL);
+	if (unlikely(!filled))
+		return NULL;
+	stat(s, SHEAF_REFILL);
+
+	/* batch[0] goes to the caller, the rest to whatever room is left */
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	pcs = this_cpu_ptr(s->cpu_sheaves);
+	nr = min(filled - 1, s->sheaf_capacity - pcs->size);
+	memcpy(pcs->objects + pcs->size, batch + 1, nr * sizeof(void *));
+	pcs->size += nr;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (unlikely(filled - 1 > nr))
+		sheaf_flush_objects(s, batch + 1 + nr, filled - 1 - nr);
+
+	return batch[0];
+}
+
+/*
+ * Called with a full sheaf and the sheaf lock held: make room for @object
+ * by returning the older half of the sheaf to the slabs.
+ */
+static noinline void free_to_pcs_flush(struct kmem_cache *s, void *object,
+				       unsigned long flags)
+{
+	struct slub_percpu_sheaves *pcs = this_cpu_ptr(s->cpu_sheaves);
+	void *batch[SLUB_SHEAF_BATCH];
+	unsigned int nr = pcs->size / 2;
+
+	memcpy(batch, pcs->objects, nr * sizeof(void *));
+	pcs->size -= nr;
+	memmove(pcs->objects, pcs->objects + nr, pcs->size * sizeof(void *));
+	pcs->objects[pcs->size++] = object;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	stat(s, FREE_PCS);
+	sheaf_flush_objects(s, batch, nr);
+}
+
+/* Empty the sheaf of the current cpu, from the flush work */
+static void pcs_flush_local(struct kmem_cache *s)
+{
+	struct slub_percpu_sheaves *pcs;
+	void *batch[SLUB_SHEAF_BATCH];
+	unsigned long flags;
+	unsigned int nr;
+
+	for (;;) {
+		local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+		pcs = this_cpu_ptr(s->cpu_sheaves);
+		nr = min_t(unsigned int, pcs->size, SLUB_SHEAF_BATCH);
+		pcs->size -= nr;
+		memcpy(batch, pcs->objects + pcs->size, nr * sizeof(void *));
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+		if (!nr)
+			break;
+		sheaf_flush_objects(s, batch, nr);
+	}
+}
+
+/* Empty the sheaf of a cpu that went offline */
+static void pcs_flush_cpu(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaves *pcs = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+	if (pcs->size)
+		sheaf_flush_objects(s, pcs->objects, pcs->size);
+	pcs->size = 0;
+}
+#endif /* CONFIG_SLUB_TINY */
+
 
 /*
  * Object placement in a slab is made very easy because we always start at
@@ -4261,11 +4466,48 @@ static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 
 	return 1;
 }
+
+static unsigned int calculate_sheaf_capacity(struct kmem_cache *s)
+{
+	if (s->size >= PAGE_SIZE)
+		return 8;
+	else if (s->size >= 1024)
+		return 16;
+	else if (s->size >= 256)
+		return 32;
+	return SLUB_SHEAF_MAX;
+}
+
+static inline int alloc_kmem_cache_sheaves(struct kmem_cache *s)
+{
+	int cpu;
+
+	/* Debugging needs every object to go through the slab paths */
+	if (!(s->flags & SLAB_PCPU_SHEAVES) || kmem_cache_debug(s))
+		return 1;
+
+	s->sheaf_capacity = calculate_sheaf_capacity(s);
+	s->cpu_sheaves = __alloc_percpu(struct_size_t(struct slub_percpu_sheaves,
+					objects, s->sheaf_capacity),
+					sizeof(void *));
+	if (!s->cpu_sheaves)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		local_lock_init(&per_cpu_ptr(s->cpu_sheaves, cpu)->lock);
+
+	return 1;
+}
 #else
 static inline int alloc_kmem_cache_cpus(struct kmem_cache *s)
 {
 	return 1;
 }
+
+static inline int alloc_kmem_cache_sheaves(struct kmem_cache *s)
+{
+	return 1;
+}
 #endif /* CONFIG_SLUB_TINY */
 
 static struct kmem_cache *kmem_cache_node;
@@ -4330,6 +4572,7 @@ void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
 #ifndef CONFIG_SLUB_TINY
+	free_percpu(s->cpu_sheaves);
 	free_percpu(s->cpu_slab);
 #endif
 	free_kmem_cache_nodes(s);
@@ -4585,7 +4828,7 @@ static int kmem_cache_open(struct kmem_cache *s, slab_flags_t flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s) && alloc_kmem_cache_sheaves(s))
 		return 0;
 
 error:
@@ -5636,6 +5879,12 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", s->cpu_sheaves ? s->sheaf_capacity : 0);
+}
+SLAB_ATTR_RO(sheaf_capacity);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5961,6 +6210,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(ALLOC_PCS, alloc_cpu_sheaf);
+STAT_ATTR(FREE_PCS, free_cpu_sheaf);
+STAT_ATTR(SHEAF_REFILL, sheaf_refill);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 #ifdef CONFIG_KFENCE
@@ -5993,6 +6246,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
 	&cpu_slabs_attr.attr,
@@ -6048,6 +6302,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&alloc_cpu_sheaf_attr.attr,
+	&free_cpu_sheaf_attr.attr,
+	&sheaf_refill_attr.attr,
+	&sheaf_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
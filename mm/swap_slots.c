@@ -120,7 +120,7 @@ static int alloc_swap_slot_cache(unsigned int cpu)
 	 * as kvzalloc could trigger reclaim and folio_alloc_swap,
 	 * which can lock swap_slots_cache_mutex.
 	 */
-	slots = kvcalloc(SWAP_SLOTS_CACHE_SIZE, sizeof(swp_entry_t),
+	slots = kvcalloc(SWAP_SLOTS_CACHE_MAX, sizeof(swp_entry_t),
 			 GFP_KERNEL);
 	if (!slots)
 		return -ENOMEM;
@@ -151,6 +151,8 @@ static int alloc_swap_slot_cache(unsigned int cpu)
 	}
 	cache->nr = 0;
 	cache->cur = 0;
+	cache->batch = SWAP_SLOTS_CACHE_SIZE;
+	cache->refill_time = jiffies;
 	cache->n_ret = 0;
 	/*
 	 * We initialized alloc_lock and free_lock earlier.  We use
@@ -255,6 +257,29 @@ void enable_swap_slots_cache(void)
 	mutex_unlock(&swap_slots_cache_enable_mutex);
 }
 
+/*
+ * Size the next refill to how fast the cache is being drained.  A cache
+ * emptied within a tick belongs to a CPU swapping out in bulk, and a larger
+ * batch lets it take si->lock less often.  A cache that sat for a second
+ * shrinks back, so free swap space isn't stranded in per-cpu caches, and
+ * growth stops while free swap is too low to fill every CPU's cache.
+ */
+static void swap_slots_cache_adjust_batch(struct swap_slots_cache *cache)
+{
+	unsigned long now = jiffies;
+
+	if (time_before_eq(now, cache->refill_time + 1)) {
+		if (cache->batch < SWAP_SLOTS_CACHE_MAX &&
+		    get_nr_swap_pages() > num_online_cpus() *
+		    THRESHOLD_GROW_SWAP_SLOTS_CACHE)
+			cache->batch *= 2;
+	} else if (time_after(now, cache->refill_time + HZ)) {
+		if (cache->batch > SWAP_SLOTS_CACHE_SIZE)
+			cache->batch /= 2;
+	}
+	cache->refill_time = now;
+}
+
 /* called with swap slot cache's alloc lock held */
 static int refill_swap_slots_cache(struct swap_slots_cache *cache)
 {
@@ -262,9 +287,11 @@ static int refill_swap_slots_cache(struct swap_slots_cache *cache)
 		return 0;
 
 	cache->cur = 0;
-	if (swap_slot_cache_active)
-		cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE,
-					   cache->slots, 0);
+	if (swap_slot_cache_active) {
+		swap_slots_cache_adjust_batch(cache);
+		cache->nr = get_swap_pages(cache->batch, cache->slots, 0);
+		count_vm_event(SWAP_SLOTS_REFILL);
+	}
 
 	return cache->nr;
 }
@@ -340,6 +340,18 @@ static inline struct swap_cluster_info *lock_cluster_or_swap_info(
 	return ci;
 }
 
+/*
+ * Take si->lock on the allocation and free paths, counting how often it was
+ * already held so swap-out contention shows up in /proc/vmstat.
+ */
+static inline void lock_swap_info(struct swap_info_struct *si)
+{
+	if (!spin_trylock(&si->lock)) {
+		count_vm_event(SWAP_LOCK_CONTENDED);
+		spin_lock(&si->lock);
+	}
+}
+
 static inline void unlock_cluster_or_swap_info(struct swap_info_struct *si,
 					       struct swap_cluster_info *ci)
 {
@@ -941,6 +953,7 @@ static int scan_swap_map_slots(struct swap_info_struct *si,
 
 scan:
 	VM_WARN_ON(order > 0);
+	count_vm_event(SWAP_ALLOC_SCAN);
 	spin_unlock(&si->lock);
 	while (++offset <= READ_ONCE(si->highest_bit)) {
 		if (unlikely(--latency_ration < 0)) {
@@ -1001,7 +1014,7 @@ int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_order)
 		goto noswap;
 	}
 
-	n_goal = min3((long)n_goal, (long)SWAP_BATCH, avail_pgs);
+	n_goal = min3((long)n_goal, (long)SWAP_BATCH_MAX, avail_pgs);
 
 	atomic_long_sub(n_goal * size, &nr_swap_pages);
 
@@ -1011,7 +1024,7 @@ int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_order)
 		/* requeue si to after same-priority siblings */
 		plist_requeue(&si->avail_lists[node], &swap_avail_heads[node]);
 		spin_unlock(&swap_avail_lock);
-		spin_lock(&si->lock);
+		lock_swap_info(si);
 		if (!si->highest_bit || !(si->flags & SWP_WRITEOK)) {
 			spin_lock(&swap_avail_lock);
 			if (plist_node_empty(&si->avail_lists[node])) {
@@ -1107,7 +1120,7 @@ static struct swap_info_struct *swap_info_get_cont(swp_entry_t entry,
 		if (q != NULL)
 			spin_unlock(&q->lock);
 		if (p != NULL)
-			spin_lock(&p->lock);
+			lock_swap_info(p);
 	}
 	return p;
 }
@@ -3398,29 +3411,47 @@ int swap_duplicate(swp_entry_t entry)
 }
 
 /*
- * @entry: swap entry for which we allocate swap cache.
+ * @entry: first swap entry for which we allocate swap cache.
+ * @nr: number of contiguous swap entries.
  *
- * Called when allocating swap cache for existing swap entry,
- * This can return error codes. Returns 0 at success.
+ * Called when allocating swap cache for existing swap entries,
+ * This can return error codes. Returns 0 at success, in which case all @nr
+ * entries are marked; otherwise none is.
  * -EEXIST means there is a swap cache.
  * Note: return code is different from swap_duplicate().
  */
-int swapcache_prepare(swp_entry_t entry)
+int swapcache_prepare(swp_entry_t entry, int nr)
 {
-	return __swap_duplicate(entry, SWAP_HAS_CACHE);
+	int i, err;
+
+	for (i = 0; i < nr; i++) {
+		err = __swap_duplicate(swp_entry(swp_type(entry),
+						 swp_offset(entry) + i),
+				       SWAP_HAS_CACHE);
+		if (err) {
+			if (i)
+				swapcache_clear(swp_swap_info(entry), entry, i);
+			return err;
+		}
+	}
+
+	return 0;
 }
 
-void swapcache_clear(struct swap_info_struct *si, swp_entry_t entry)
+void swapcache_clear(struct swap_info_struct *si, swp_entry_t entry, int nr)
 {
 	struct swap_cluster_info *ci;
 	unsigned long offset = swp_offset(entry);
 	unsigned char usage;
+	int i;
 
-	ci = lock_cluster_or_swap_info(si, offset);
-	usage = __swap_entry_free_locked(si, offset, SWAP_HAS_CACHE);
-	unlock_cluster_or_swap_info(si, ci);
-	if (!usage)
-		free_swap_slot(entry);
+	for (i = 0; i < nr; i++) {
+		ci = lock_cluster_or_swap_info(si, offset + i);
+		usage = __swap_entry_free_locked(si, offset + i, SWAP_HAS_CACHE);
+		unlock_cluster_or_swap_info(si, ci);
+		if (!usage)
+			free_swap_slot(swp_entry(swp_type(entry), offset + i));
+	}
 }
 
 struct swap_info_struct *swp_swap_info(swp_entry_t entry)
@@ -41,6 +41,7 @@
 #include <linux/hugetlb.h>
 #include <linux/io.h>
 #include <linux/sched/mm.h>
+#include <linux/workqueue.h>
 #include <asm/tlbflush.h>
 #include <asm/shmparam.h>
 
@@ -332,11 +333,24 @@ static void vunmap_pte_range(pmd_t *pmd, unsigned long addr, unsigned long end,
 {
 	pte_t *pte;
 
+	unsigned long size = PAGE_SIZE;
+	pte_t ptent;
+
 	pte = pte_offset_kernel(pmd, addr);
 	do {
-		pte_t ptent = ptep_get_and_clear(&init_mm, addr, pte);
+#ifdef CONFIG_HUGETLB_PAGE
+		size = arch_vmap_pte_range_unmap_size(addr, pte);
+		/* vmap_pte_range() only creates naturally aligned blocks */
+		if (size != PAGE_SIZE &&
+		    WARN_ON(!IS_ALIGNED(addr, size) || end - addr < size))
+			size = PAGE_SIZE;
+		if (size != PAGE_SIZE)
+			ptent = huge_ptep_get_and_clear(&init_mm, addr, pte);
+		else
+#endif
+			ptent = ptep_get_and_clear(&init_mm, addr, pte);
 		WARN_ON(!pte_none(ptent) && !pte_present(ptent));
-	} while (pte++, addr += PAGE_SIZE, addr != end);
+	} while (pte += PFN_DOWN(size), addr += size, addr != end);
 	*mask |= PGTBL_PTE_MODIFIED;
 }
 
@@ -744,9 +758,41 @@ LIST_HEAD(vmap_area_list);
 static struct rb_root vmap_area_root = RB_ROOT;
 static bool vmap_initialized __read_mostly;
 
-static struct rb_root purge_vmap_area_root = RB_ROOT;
-static LIST_HEAD(purge_vmap_area_list);
-static DEFINE_SPINLOCK(purge_vmap_area_lock);
+struct vmap_purge_stat {
+	unsigned long nr_purges;
+	unsigned long nr_pages;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+/*
+ * Lazily freed areas are gathered in per-cpu zones, so that vunmap() on
+ * different CPUs does not serialize on a single lock, and the drain work
+ * can purge the zones in parallel, each flushing only its own range.
+ */
+struct vmap_purge_zone {
+	spinlock_t lock;
+	struct rb_root root;
+	struct list_head list;
+
+	/* Detached areas being purged and the range they span */
+	struct list_head purge_list;
+	unsigned long purge_start;
+	unsigned long purge_end;
+	struct work_struct purge_work;
+
+	struct vmap_purge_stat stat;
+};
+
+static DEFINE_PER_CPU(struct vmap_purge_zone, vmap_purge_zone);
+static struct vmap_purge_stat vmap_full_purge_stat;
+
+/*
+ * Zone purges from the drain work hold this for read and run in parallel.
+ * A full purge holds it for write so that, once it returns, every area that
+ * was lazily freed before it started has been flushed from the TLB.
+ */
+static DECLARE_RWSEM(vmap_purge_zone_rwsem);
 
 /*
  * This kmem_cache is used for vmap_area objects. Instead of
@@ -1728,39 +1774,52 @@ static DEFINE_MUTEX(vmap_purge_lock);
 /* for per-CPU blocks */
 static void purge_fragmented_blocks_allcpus(void);
 
-/*
- * Purges all lazily-freed vmap areas.
- */
-static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
+static void vmap_purge_stat_add(struct vmap_purge_stat *stat,
+				unsigned long nr_pages, u64 start_ns)
 {
-	unsigned long resched_threshold;
-	unsigned int num_purged_areas = 0;
-	struct list_head local_purge_list;
-	struct vmap_area *va, *n_va;
-
-	lockdep_assert_held(&vmap_purge_lock);
+	u64 delta = ktime_get_ns() - start_ns;
 
-	spin_lock(&purge_vmap_area_lock);
-	purge_vmap_area_root = RB_ROOT;
-	list_replace_init(&purge_vmap_area_list, &local_purge_list);
-	spin_unlock(&purge_vmap_area_lock);
+	WRITE_ONCE(stat->nr_purges, stat->nr_purges + 1);
+	WRITE_ONCE(stat->nr_pages, stat->nr_pages + nr_pages);
+	WRITE_ONCE(stat->total_ns, stat->total_ns + delta);
+	if (delta > stat->max_ns)
+		WRITE_ONCE(stat->max_ns, delta);
+}
 
-	if (unlikely(list_empty(&local_purge_list)))
-		goto out;
+/*
+ * Detach the lazily-freed areas of @z onto its purge_list. The list is
+ * sorted by address, so its span is given by the first and last areas.
+ */
+static bool purge_zone_detach(struct vmap_purge_zone *z)
+{
+	spin_lock(&z->lock);
+	z->root = RB_ROOT;
+	list_replace_init(&z->list, &z->purge_list);
+	spin_unlock(&z->lock);
 
-	start = min(start,
-		list_first_entry(&local_purge_list,
-			struct vmap_area, list)->va_start);
+	if (list_empty(&z->purge_list))
+		return false;
 
-	end = max(end,
-		list_last_entry(&local_purge_list,
-			struct vmap_area, list)->va_end);
+	z->purge_start = list_first_entry(&z->purge_list,
+				struct vmap_area, list)->va_start;
+	z->purge_end = list_last_entry(&z->purge_list,
+				struct vmap_area, list)->va_end;
+	return true;
+}
 
-	flush_tlb_kernel_range(start, end);
-	resched_threshold = lazy_max_pages() << 1;
+/*
+ * Return the detached areas of @z, already flushed from the TLB, to the
+ * free tree. Returns the number of areas and adds their pages to @nr_pages.
+ */
+static unsigned int purge_zone_merge(struct vmap_purge_zone *z,
+				     unsigned long *nr_pages)
+{
+	unsigned long resched_threshold = lazy_max_pages() << 1;
+	unsigned int num_purged_areas = 0;
+	struct vmap_area *va, *n_va;
 
 	spin_lock(&free_vmap_area_lock);
-	list_for_each_entry_safe(va, n_va, &local_purge_list, list) {
+	list_for_each_entry_safe(va, n_va, &z->purge_list, list) {
 		unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
 		unsigned long orig_start = va->va_start;
 		unsigned long orig_end = va->va_end;
@@ -1781,6 +1840,7 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 					      va->va_start, va->va_end);
 
 		atomic_long_sub(nr, &vmap_lazy_nr);
+		*nr_pages += nr;
 		num_purged_areas++;
 
 		if (atomic_long_read(&vmap_lazy_nr) < resched_threshold)
@@ -1788,13 +1848,99 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	}
 	spin_unlock(&free_vmap_area_lock);
 
+	/* The areas now live on the free list */
+	INIT_LIST_HEAD(&z->purge_list);
+	return num_purged_areas;
+}
+
+/*
+ * Purges all lazily-freed vmap areas.
+ */
+static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
+{
+	unsigned long span = 0, nr_pages = 0;
+	unsigned int num_purged_areas = 0;
+	unsigned long flush_start = start;
+	unsigned long flush_end = end;
+	struct vmap_purge_zone *z;
+	bool detached = false;
+	u64 start_ns;
+	int cpu;
+
+	lockdep_assert_held(&vmap_purge_lock);
+
+	down_write(&vmap_purge_zone_rwsem);
+	start_ns = ktime_get_ns();
+
+	for_each_possible_cpu(cpu) {
+		z = per_cpu_ptr(&vmap_purge_zone, cpu);
+		if (!purge_zone_detach(z))
+			continue;
+
+		detached = true;
+		flush_start = min(flush_start, z->purge_start);
+		flush_end = max(flush_end, z->purge_end);
+		span += z->purge_end - z->purge_start;
+	}
+
+	if (unlikely(!detached))
+		goto out;
+
+	/*
+	 * Batch the invalidation into one flush over the merged range,
+	 * unless the zones are so scattered that flushing them one by one
+	 * covers less than half of it.
+	 */
+	if (start < end)
+		span += end - start;
+	if (span << 1 >= flush_end - flush_start) {
+		flush_tlb_kernel_range(flush_start, flush_end);
+	} else {
+		if (start < end)
+			flush_tlb_kernel_range(start, end);
+		for_each_possible_cpu(cpu) {
+			z = per_cpu_ptr(&vmap_purge_zone, cpu);
+			if (!list_empty(&z->purge_list))
+				flush_tlb_kernel_range(z->purge_start,
+						       z->purge_end);
+		}
+	}
+
+	for_each_possible_cpu(cpu)
+		num_purged_areas += purge_zone_merge(per_cpu_ptr(&vmap_purge_zone, cpu),
+						     &nr_pages);
+
+	vmap_purge_stat_add(&vmap_full_purge_stat, nr_pages, start_ns);
 out:
-	trace_purge_vmap_area_lazy(start, end, num_purged_areas);
+	up_write(&vmap_purge_zone_rwsem);
+	trace_purge_vmap_area_lazy(flush_start, flush_end, num_purged_areas);
 	return num_purged_areas > 0;
 }
 
+/* Purge the lazily-freed areas of one zone, from the drain work */
+static void purge_vmap_zone_work(struct work_struct *work)
+{
+	struct vmap_purge_zone *z;
+	unsigned int num_purged_areas;
+	unsigned long nr_pages = 0;
+	u64 start_ns;
+
+	z = container_of(work, struct vmap_purge_zone, purge_work);
+
+	down_read(&vmap_purge_zone_rwsem);
+	start_ns = ktime_get_ns();
+	if (purge_zone_detach(z)) {
+		flush_tlb_kernel_range(z->purge_start, z->purge_end);
+		num_purged_areas = purge_zone_merge(z, &nr_pages);
+		vmap_purge_stat_add(&z->stat, nr_pages, start_ns);
+		trace_purge_vmap_area_lazy(z->purge_start, z->purge_end,
+					   num_purged_areas);
+	}
+	up_read(&vmap_purge_zone_rwsem);
+}
+
 /*
- * Reclaim vmap areas by purging fragmented blocks and purge_vmap_area_list.
+ * Reclaim vmap areas by purging fragmented blocks and the lazy purge zones.
  */
 static void reclaim_and_purge_vmap_areas(void)
 
@@ -1808,11 +1954,18 @@ static void reclaim_and_purge_vmap_areas(void)
 static void drain_vmap_area_work(struct work_struct *work)
 {
 	unsigned long nr_lazy;
+	int cpu;
 
 	do {
-		mutex_lock(&vmap_purge_lock);
-		__purge_vmap_area_lazy(ULONG_MAX, 0);
-		mutex_unlock(&vmap_purge_lock);
+		/* Purge every zone with lazily-freed areas in parallel. */
+		for_each_possible_cpu(cpu) {
+			struct vmap_purge_zone *z = per_cpu_ptr(&vmap_purge_zone, cpu);
+
+			if (!list_empty_careful(&z->list))
+				queue_work(system_unbound_wq, &z->purge_work);
+		}
+		for_each_possible_cpu(cpu)
+			flush_work(&per_cpu_ptr(&vmap_purge_zone, cpu)->purge_work);
 
 		/* Recheck if further work is required. */
 		nr_lazy = atomic_long_read(&vmap_lazy_nr);
@@ -1828,6 +1981,7 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 {
 	unsigned long nr_lazy_max = lazy_max_pages();
 	unsigned long va_start = va->va_start;
+	struct vmap_purge_zone *z;
 	unsigned long nr_lazy;
 
 	if (WARN_ON_ONCE(!list_empty(&va->list)))
@@ -1837,12 +1991,12 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 				PAGE_SHIFT, &vmap_lazy_nr);
 
 	/*
-	 * Merge or place it to the purge tree/list.
+	 * Merge or place it to the purge tree/list of this CPU's zone.
 	 */
-	spin_lock(&purge_vmap_area_lock);
-	merge_or_add_vmap_area(va,
-		&purge_vmap_area_root, &purge_vmap_area_list);
-	spin_unlock(&purge_vmap_area_lock);
+	z = raw_cpu_ptr(&vmap_purge_zone);
+	spin_lock(&z->lock);
+	merge_or_add_vmap_area(va, &z->root, &z->list);
+	spin_unlock(&z->lock);
 
 	trace_free_vmap_area_noflush(va_start, nr_lazy, nr_lazy_max);
 
@@ -2961,6 +3115,99 @@ void *vmap(struct page **pages, unsigned int count,
 }
 EXPORT_SYMBOL(vmap);
 
+/*
+ * Number of entries at the start of @pages, at most @count, that cover one
+ * whole compound page in order. Returns 1 for anything else.
+ */
+static unsigned int vmap_compound_run(struct page **pages, unsigned int count)
+{
+	unsigned int i, nr;
+
+	if (!PageHead(pages[0]))
+		return 1;
+
+	nr = compound_nr(pages[0]);
+	if (nr > count)
+		return 1;
+	for (i = 1; i < nr; i++)
+		if (pages[i] != pages[0] + i)
+			return 1;
+	return nr;
+}
+
+/**
+ * vmap_compound - map an array of pages, using large mappings where possible
+ * @pages: array of page pointers
+ * @count: number of pages to map
+ * @flags: vm_area->flags
+ * @prot: page protection for the mapping
+ *
+ * Like vmap(), except that every run of @pages covering a whole compound page
+ * is mapped with the largest block or contiguous mapping the architecture
+ * supports for it. The area is aligned to the largest such run, up to
+ * PMD_SIZE, so runs sorted by decreasing size end up naturally aligned.
+ *
+ * %VM_MAP_PUT_PAGES is not supported.
+ *
+ * Return: the address of the area or %NULL on failure
+ */
+void *vmap_compound(struct page **pages, unsigned int count,
+		    unsigned long flags, pgprot_t prot)
+{
+	unsigned long align = PAGE_SIZE;
+	struct vm_struct *area;
+	unsigned long addr, size;
+	unsigned int i, nr;
+	int err = 0;
+
+	might_sleep();
+
+	if (WARN_ON_ONCE(flags & (VM_FLUSH_RESET_PERMS | VM_MAP_PUT_PAGES)))
+		return NULL;
+	if (WARN_ON_ONCE(flags & VM_NO_GUARD))
+		flags &= ~VM_NO_GUARD;
+
+	if (!count || count > totalram_pages())
+		return NULL;
+
+	for (i = 0; i < count; i += nr) {
+		nr = vmap_compound_run(pages + i, count - i);
+		align = max(align, (unsigned long)nr << PAGE_SHIFT);
+	}
+	align = min_t(unsigned long, align, PMD_SIZE);
+
+	size = (unsigned long)count << PAGE_SHIFT;
+	area = __get_vm_area_node(size, align, PAGE_SHIFT, flags,
+				  VMALLOC_START, VMALLOC_END, NUMA_NO_NODE,
+				  GFP_KERNEL, __builtin_return_address(0));
+	if (!area)
+		return NULL;
+
+	addr = (unsigned long)area->addr;
+	prot = pgprot_nx(prot);
+	for (i = 0; i < count && !err; i += nr) {
+		unsigned long start = addr + ((unsigned long)i << PAGE_SHIFT);
+		unsigned long end;
+
+		nr = vmap_compound_run(pages + i, count - i);
+		end = start + ((unsigned long)nr << PAGE_SHIFT);
+		err = kmsan_vmap_pages_range_noflush(start, end, prot, pages + i,
+						     PAGE_SHIFT);
+		if (!err)
+			err = vmap_range_noflush(start, end,
+						 page_to_phys(pages[i]), prot,
+						 PAGE_SHIFT + ilog2(nr));
+	}
+	flush_cache_vmap(addr, addr + size);
+
+	if (err) {
+		vunmap(area->addr);
+		return NULL;
+	}
+	return area->addr;
+}
+EXPORT_SYMBOL_GPL(vmap_compound);
+
 #ifdef CONFIG_VMAP_PFN
 struct vmap_pfn_data {
 	unsigned long	*pfns;
@@ -4383,17 +4630,43 @@ static void show_numa_info(struct seq_file *m, struct vm_struct *v)
 	}
 }
 
+static void show_purge_stat(struct seq_file *m, const char *name,
+			    struct vmap_purge_stat *stat)
+{
+	unsigned long nr_purges = READ_ONCE(stat->nr_purges);
+
+	if (!nr_purges)
+		return;
+
+	seq_printf(m, "%s: purges=%lu pages=%lu avg_us=%llu max_us=%llu\n",
+		   name, nr_purges, READ_ONCE(stat->nr_pages),
+		   div_u64(READ_ONCE(stat->total_ns), nr_purges * NSEC_PER_USEC),
+		   div_u64(READ_ONCE(stat->max_ns), NSEC_PER_USEC));
+}
+
 static void show_purge_info(struct seq_file *m)
 {
+	struct vmap_purge_zone *z;
 	struct vmap_area *va;
+	char name[32];
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		z = per_cpu_ptr(&vmap_purge_zone, cpu);
+		spin_lock(&z->lock);
+		list_for_each_entry(va, &z->list, list) {
+			seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
+				(void *)va->va_start, (void *)va->va_end,
+				va->va_end - va->va_start);
+		}
+		spin_unlock(&z->lock);
+	}
 
-	spin_lock(&purge_vmap_area_lock);
-	list_for_each_entry(va, &purge_vmap_area_list, list) {
-		seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
-			(void *)va->va_start, (void *)va->va_end,
-			va->va_end - va->va_start);
+	show_purge_stat(m, "lazy purge full", &vmap_full_purge_stat);
+	for_each_possible_cpu(cpu) {
+		snprintf(name, sizeof(name), "lazy purge zone%d", cpu);
+		show_purge_stat(m, name, &per_cpu_ptr(&vmap_purge_zone, cpu)->stat);
 	}
-	spin_unlock(&purge_vmap_area_lock);
 }
 
 static int s_show(struct seq_file *m, void *p)
@@ -4503,6 +4776,16 @@ void __init vmalloc_init(void)
 		xa_init(&vbq->vmap_blocks);
 	}
 
+	for_each_possible_cpu(i) {
+		struct vmap_purge_zone *z = &per_cpu(vmap_purge_zone, i);
+
+		spin_lock_init(&z->lock);
+		z->root = RB_ROOT;
+		INIT_LIST_HEAD(&z->list);
+		INIT_LIST_HEAD(&z->purge_list);
+		INIT_WORK(&z->purge_work, purge_vmap_zone_work);
+	}
+
 	/* Import existing vmlist entries. */
 	for (tmp = vmlist; tmp; tmp = tmp->next) {
 		va = kmem_cache_zalloc(vmap_area_cachep, GFP_NOWAIT);
@@ -4420,13 +4420,16 @@ static struct lru_gen_mm_walk *set_mm_walk(struct pglist_data *pgdat, bool force
 {
 	struct lru_gen_mm_walk *walk = current->reclaim_state->mm_walk;
 
-	if (pgdat && current_is_kswapd()) {
+	/*
+	 * The node's walk belongs to kswapd itself. Its helpers, see
+	 * kswapd_helper(), reclaim the node concurrently and allocate their own
+	 * like direct reclaim does.
+	 */
+	if (pgdat && current == pgdat->kswapd) {
 		VM_WARN_ON_ONCE(walk);
 
 		walk = &pgdat->mm_walk;
 	} else if (!walk && force_alloc) {
-		VM_WARN_ON_ONCE(current_is_kswapd());
-
 		walk = kzalloc(sizeof(*walk), __GFP_HIGH | __GFP_NOMEMALLOC | __GFP_NOWARN);
 	}
 
@@ -4444,7 +4447,9 @@ static void clear_mm_walk(void)
 
 	current->reclaim_state->mm_walk = NULL;
 
-	if (!current_is_kswapd())
+	/* kswapd and its helpers are started with their node as data */
+	if (!current_is_kswapd() ||
+	    walk != &((struct pglist_data *)kthread_data(current))->mm_walk)
 		kfree(walk);
 }
 
@@ -4860,6 +4865,13 @@ static int lru_gen_memcg_seg(struct lruvec *lruvec)
 	return READ_ONCE(lruvec->lrugen.seg);
 }
 
+static int lru_gen_memcg_hint(struct lruvec *lruvec)
+{
+	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
+
+	return memcg ? READ_ONCE(memcg->lru_gen_hint) : LRU_GEN_HINT_NONE;
+}
+
 static void lru_gen_rotate_memcg(struct lruvec *lruvec, int op)
 {
 	int seg;
@@ -4977,6 +4989,77 @@ void lru_gen_soft_reclaim(struct mem_cgroup *memcg, int nid)
 		lru_gen_rotate_memcg(lruvec, MEMCG_LRU_HEAD);
 }
 
+static void lru_gen_age_memcg(struct mem_cgroup *memcg)
+{
+	int nid;
+	unsigned int flags;
+	struct blk_plug plug;
+	struct scan_control sc = {
+		.may_writepage = true,
+		.may_unmap = true,
+		.may_swap = true,
+		.reclaim_idx = MAX_NR_ZONES - 1,
+		.gfp_mask = GFP_KERNEL,
+	};
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+	flags = memalloc_noreclaim_save();
+	blk_start_plug(&plug);
+	if (!set_mm_walk(NULL, true))
+		goto done;
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct lruvec *lruvec = get_lruvec(memcg, nid);
+		bool can_swap = get_swappiness(lruvec, &sc);
+		DEFINE_MAX_SEQ(lruvec);
+		DEFINE_MIN_SEQ(lruvec);
+
+		if (signal_pending(current))
+			break;
+
+		/* leave the oldest generation to the eviction */
+		if (min_seq[!can_swap] + MAX_NR_GENS - 1 <= max_seq)
+			continue;
+
+		try_to_inc_max_seq(lruvec, max_seq, &sc, can_swap, false);
+		cond_resched();
+	}
+done:
+	clear_mm_walk();
+	blk_finish_plug(&plug);
+	memalloc_noreclaim_restore(flags);
+	set_task_reclaim_state(current, NULL);
+}
+
+/*
+ * Called when userspace is about to move an app between the foreground and the
+ * background, e.g., on an app switch. A backgrounded memcg has its generations
+ * aged ahead of time, using the access bits of the last foreground period,
+ * and is moved to the old memcg generation so that global reclaim takes its
+ * cold pages before those of memcgs still in use.
+ */
+void lru_gen_hint_memcg(struct mem_cgroup *memcg, int hint)
+{
+	int nid;
+
+	WRITE_ONCE(memcg->lru_gen_hint, hint);
+
+	if (!lru_gen_enabled() || !mem_cgroup_online(memcg))
+		return;
+
+	if (hint == LRU_GEN_HINT_BACKGROUND)
+		lru_gen_age_memcg(memcg);
+
+	for_each_node(nid) {
+		struct lruvec *lruvec = get_lruvec(memcg, nid);
+
+		if (hint == LRU_GEN_HINT_BACKGROUND)
+			lru_gen_rotate_memcg(lruvec, MEMCG_LRU_OLD);
+		else if (hint == LRU_GEN_HINT_FOREGROUND)
+			lru_gen_rotate_memcg(lruvec, MEMCG_LRU_YOUNG);
+	}
+}
+
 #else /* !CONFIG_MEMCG */
 
 static int lru_gen_memcg_seg(struct lruvec *lruvec)
@@ -4984,6 +5067,11 @@ static int lru_gen_memcg_seg(struct lruvec *lruvec)
 	return 0;
 }
 
+static int lru_gen_memcg_hint(struct lruvec *lruvec)
+{
+	return LRU_GEN_HINT_NONE;
+}
+
 #endif
 
 /******************************************************************************
@@ -5217,6 +5305,9 @@ static int get_type_to_scan(struct lruvec *lruvec, int swappiness, int *tier_idx
 	return type;
 }
 
+/* evict_folios() swappiness which never falls back to file folios */
+#define SWAPPINESS_ANON_ONLY	201
+
 static int isolate_folios(struct lruvec *lruvec, struct scan_control *sc, int swappiness,
 			  int *type_scanned, struct list_head *list)
 {
@@ -5237,7 +5328,7 @@ static int isolate_folios(struct lruvec *lruvec, struct scan_control *sc, int sw
 		type = LRU_GEN_ANON;
 	else if (swappiness == 1)
 		type = LRU_GEN_FILE;
-	else if (swappiness == 200)
+	else if (swappiness >= 200)
 		type = LRU_GEN_ANON;
 	else
 		type = get_type_to_scan(lruvec, swappiness, &tier);
@@ -5247,7 +5338,7 @@ static int isolate_folios(struct lruvec *lruvec, struct scan_control *sc, int sw
 			tier = get_tier_idx(lruvec, type);
 
 		scanned = scan_folios(lruvec, sc, type, tier, list);
-		if (scanned)
+		if (scanned || swappiness == SWAPPINESS_ANON_ONLY)
 			break;
 
 		type = !type;
@@ -5512,6 +5603,7 @@ static bool try_to_shrink_lruvec(struct lruvec *lruvec, struct scan_control *sc)
 static int shrink_one(struct lruvec *lruvec, struct scan_control *sc)
 {
 	bool success;
+	int hint = lru_gen_memcg_hint(lruvec);
 	unsigned long scanned = sc->nr_scanned;
 	unsigned long reclaimed = sc->nr_reclaimed;
 	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
@@ -5530,6 +5622,10 @@ static int shrink_one(struct lruvec *lruvec, struct scan_control *sc)
 		memcg_memory_event(memcg, MEMCG_LOW);
 	}
 
+	/* see the comment on MEMCG_NR_GENS */
+	if (hint == LRU_GEN_HINT_FOREGROUND && lru_gen_memcg_seg(lruvec) != MEMCG_LRU_TAIL)
+		return MEMCG_LRU_TAIL;
+
 	success = try_to_shrink_lruvec(lruvec, sc);
 
 	shrink_slab(sc->gfp_mask, pgdat->node_id, memcg, sc->priority);
@@ -5540,6 +5636,11 @@ static int shrink_one(struct lruvec *lruvec, struct scan_control *sc)
 
 	flush_reclaim_state(sc);
 
+	/* one retry in the old generation if hinted as background */
+	if (success && hint == LRU_GEN_HINT_BACKGROUND &&
+	    lru_gen_memcg_seg(lruvec) != MEMCG_LRU_TAIL && mem_cgroup_online(memcg))
+		return MEMCG_LRU_TAIL;
+
 	if (success && mem_cgroup_online(memcg))
 		return MEMCG_LRU_YOUNG;
 
@@ -5681,6 +5782,71 @@ static void set_initial_priority(struct pglist_data *pgdat, struct scan_control
 	sc->priority = clamp(priority, 0, DEF_PRIORITY);
 }
 
+/**
+ * lru_gen_demote_anon - evict anon folios from the oldest generations
+ * @nid: the node to demote on
+ * @nr_to_reclaim: the number of pages to stop after
+ *
+ * Walk the memcgs on @nid and evict anon folios from each lruvec's oldest
+ * generation, never touching the two youngest ones.  This is used for
+ * proactive demotion into zswap, so file folios and the aging of the
+ * lruvecs are left to regular reclaim.
+ *
+ * Return: the number of pages reclaimed.
+ */
+unsigned long lru_gen_demote_anon(int nid, unsigned long nr_to_reclaim)
+{
+	struct mem_cgroup *memcg;
+	unsigned int flags;
+	struct blk_plug plug;
+	unsigned long reclaimed = 0;
+	struct scan_control sc = {
+		.nr_to_reclaim = nr_to_reclaim,
+		.may_writepage = true,
+		.may_unmap = true,
+		.may_swap = true,
+		.proactive = true,
+		.reclaim_idx = MAX_NR_ZONES - 1,
+		.gfp_mask = GFP_KERNEL,
+	};
+
+	if (!lru_gen_enabled() || !node_state(nid, N_MEMORY))
+		return 0;
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+	flags = memalloc_noreclaim_save();
+	blk_start_plug(&plug);
+	if (!set_mm_walk(NULL, true))
+		goto done;
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		struct lruvec *lruvec = get_lruvec(memcg, nid);
+		DEFINE_MAX_SEQ(lruvec);
+		DEFINE_MIN_SEQ(lruvec);
+
+		if (min_seq[LRU_GEN_ANON] + MIN_NR_GENS > max_seq)
+			continue;
+
+		sc.nr_reclaimed = 0;
+		evict_folios(lruvec, &sc, SWAPPINESS_ANON_ONLY);
+		reclaimed += sc.nr_reclaimed;
+
+		if (reclaimed >= nr_to_reclaim || signal_pending(current)) {
+			mem_cgroup_iter_break(NULL, memcg);
+			break;
+		}
+		cond_resched();
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+done:
+	clear_mm_walk();
+	blk_finish_plug(&plug);
+	memalloc_noreclaim_restore(flags);
+	set_task_reclaim_state(current, NULL);
+
+	return reclaimed;
+}
+
 static void lru_gen_shrink_node(struct pglist_data *pgdat, struct scan_control *sc)
 {
 	struct blk_plug plug;
@@ -6914,6 +7080,8 @@ static void shrink_zones(struct zonelist *zonelist, struct scan_control *sc)
 		if (zone->zone_pgdat == last_pgdat)
 			continue;
 		last_pgdat = zone->zone_pgdat;
+		if (!cgroup_reclaim(sc))
+			atomic_long_inc(&zone->zone_pgdat->nr_direct_reclaim);
 		shrink_node(zone->zone_pgdat, sc);
 	}
 
@@ -7532,6 +7700,195 @@ clear_reclaim_active(pg_data_t *pgdat, int highest_zoneidx)
 	update_reclaim_active(pgdat, highest_zoneidx, false);
 }
 
+/*
+ * vm.kswapd_threads: the number of kswapd threads per node.  The first one is
+ * kswapd itself; the others are helpers which kswapd puts to work while it is
+ * falling behind, i.e. while the watermarks are boosted, it has to raise the
+ * scan priority, or allocations on the node keep entering direct reclaim.
+ * They reclaim through shrink_node() like kswapd does, so concurrent threads
+ * spread over the memcgs: MGLRU rotates each memcg it picks to the tail of its
+ * bin and the classic LRU shares the memcg iterator.
+ */
+#define KSWAPD_MAX_THREADS	16
+
+static int sysctl_kswapd_threads __read_mostly = 1;
+static int kswapd_threads_max = KSWAPD_MAX_THREADS;
+static DEFINE_MUTEX(kswapd_threads_lock);
+
+static void kswapd_scale_helpers(pg_data_t *pgdat, int highest_zoneidx,
+				 int priority)
+{
+	int nr_helpers = READ_ONCE(sysctl_kswapd_threads) - 1;
+	long wanted;
+
+	if (nr_helpers <= 0 || !pgdat->kswapd_helpers)
+		return;
+
+	/* each direct reclaimer since the last pass asks for one more */
+	wanted = atomic_long_xchg(&pgdat->nr_direct_reclaim, 0);
+	if (pgdat_watermark_boosted(pgdat, highest_zoneidx))
+		wanted++;
+	if (priority < DEF_PRIORITY - 2)
+		wanted++;
+	wanted = min_t(long, wanted, nr_helpers);
+
+	if (wanted > atomic_read(&pgdat->kswapd_helpers_wanted)) {
+		WRITE_ONCE(pgdat->kswapd_helper_zoneidx, highest_zoneidx);
+		atomic_set(&pgdat->kswapd_helpers_wanted, wanted);
+		wake_up_all(&pgdat->kswapd_helper_wait);
+	}
+}
+
+static bool kswapd_helper_wanted(pg_data_t *pgdat, int id)
+{
+	return id < atomic_read(&pgdat->kswapd_helpers_wanted);
+}
+
+static void kswapd_helper_reclaim(pg_data_t *pgdat, int id)
+{
+	int highest_zoneidx = READ_ONCE(pgdat->kswapd_helper_zoneidx);
+	unsigned long pflags;
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.priority = DEF_PRIORITY,
+	};
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+	psi_memstall_enter(&pflags);
+	__fs_reclaim_acquire(_THIS_IP_);
+
+	while (kswapd_helper_wanted(pgdat, id) &&
+	       !pgdat_balanced(pgdat, 0, highest_zoneidx)) {
+		unsigned long nr_reclaimed = sc.nr_reclaimed;
+		bool ret;
+
+		sc.order = 0;
+		sc.reclaim_idx = highest_zoneidx;
+		sc.nr_scanned = 0;
+		if (!kswapd_shrink_node(pgdat, &sc) ||
+		    sc.nr_reclaimed == nr_reclaimed) {
+			if (--sc.priority < 1)
+				break;
+		}
+
+		__fs_reclaim_release(_THIS_IP_);
+		ret = try_to_freeze();
+		__fs_reclaim_acquire(_THIS_IP_);
+		if (ret || kthread_should_stop())
+			break;
+	}
+
+	__fs_reclaim_release(_THIS_IP_);
+	psi_memstall_leave(&pflags);
+	set_task_reclaim_state(current, NULL);
+}
+
+static int kswapd_helper(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t *)p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+	int id;
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+
+	current->flags |= PF_MEMALLOC | PF_KSWAPD;
+	set_freezable();
+
+	/* kswapd_update_helpers() stores us before waking us up */
+	for (id = 0; id < KSWAPD_MAX_THREADS - 1; id++)
+		if (READ_ONCE(pgdat->kswapd_helpers[id]) == current)
+			break;
+
+	for ( ; ; ) {
+		wait_event_freezable(pgdat->kswapd_helper_wait,
+				     kthread_should_stop() ||
+				     kswapd_helper_wanted(pgdat, id));
+		if (kthread_should_stop())
+			break;
+
+		kswapd_helper_reclaim(pgdat, id);
+
+		/* wait for kswapd to call us again rather than spin */
+		if (kswapd_helper_wanted(pgdat, id))
+			schedule_timeout_interruptible(HZ / 10);
+	}
+
+	current->flags &= ~(PF_MEMALLOC | PF_KSWAPD);
+
+	return 0;
+}
+
+/* Start or stop the helpers of @pgdat to match vm.kswapd_threads */
+static void kswapd_update_helpers(pg_data_t *pgdat, int nr_threads)
+{
+	struct task_struct *tsk;
+	int i;
+
+	lockdep_assert_held(&kswapd_threads_lock);
+
+	if (!pgdat->kswapd_helpers) {
+		if (nr_threads <= 1)
+			return;
+		pgdat->kswapd_helpers = kcalloc(KSWAPD_MAX_THREADS - 1,
+						sizeof(struct task_struct *),
+						GFP_KERNEL);
+		if (!pgdat->kswapd_helpers)
+			return;
+	}
+
+	for (i = 0; i < KSWAPD_MAX_THREADS - 1; i++) {
+		tsk = pgdat->kswapd_helpers[i];
+		if (i + 1 < nr_threads && !tsk) {
+			tsk = kthread_create(kswapd_helper, pgdat, "kswapd%d:%d",
+					     pgdat->node_id, i + 1);
+			if (IS_ERR(tsk)) {
+				pr_err("Failed to start kswapd helper on node %d\n",
+				       pgdat->node_id);
+				continue;
+			}
+			WRITE_ONCE(pgdat->kswapd_helpers[i], tsk);
+			wake_up_process(tsk);
+		} else if (i + 1 >= nr_threads && tsk) {
+			kthread_stop(tsk);
+			WRITE_ONCE(pgdat->kswapd_helpers[i], NULL);
+		}
+	}
+}
+
+static int kswapd_threads_sysctl_handler(struct ctl_table *table, int write,
+		void *buffer, size_t *length, loff_t *ppos)
+{
+	int ret, nid;
+
+	mutex_lock(&kswapd_threads_lock);
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!ret && write) {
+		for_each_node_state(nid, N_MEMORY)
+			kswapd_update_helpers(NODE_DATA(nid),
+					      sysctl_kswapd_threads);
+	}
+	mutex_unlock(&kswapd_threads_lock);
+
+	return ret;
+}
+
+static struct ctl_table vm_kswapd_table[] = {
+	{
+		.procname	= "kswapd_threads",
+		.data		= &sysctl_kswapd_threads,
+		.maxlen		= sizeof(sysctl_kswapd_threads),
+		.mode		= 0644,
+		.proc_handler	= kswapd_threads_sysctl_handler,
+		.extra1		= SYSCTL_ONE,
+		.extra2		= &kswapd_threads_max,
+	},
+	{ }
+};
+
 /*
  * For kswapd, balance_pgdat() will reclaim pages across a node from zones
  * that are eligible for use by the caller until at least one zone is
@@ -7678,6 +8035,8 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int highest_zoneidx)
 		if (kswapd_shrink_node(pgdat, &sc))
 			raise_priority = false;
 
+		kswapd_scale_helpers(pgdat, highest_zoneidx, sc.priority);
+
 		/*
 		 * If the low watermark is met there is no need for processes
 		 * to be throttled on pfmemalloc_wait as they should not be
@@ -7717,6 +8076,7 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int highest_zoneidx)
 		pgdat->kswapd_failures++;
 
 out:
+	atomic_set(&pgdat->kswapd_helpers_wanted, 0);
 	clear_reclaim_active(pgdat, highest_zoneidx);
 
 	/* If reclaim was boosted, account for the reclaim done in this pass */
@@ -8061,6 +8421,10 @@ void __meminit kswapd_run(int nid)
 		}
 	}
 	pgdat_kswapd_unlock(pgdat);
+
+	mutex_lock(&kswapd_threads_lock);
+	kswapd_update_helpers(pgdat, sysctl_kswapd_threads);
+	mutex_unlock(&kswapd_threads_lock);
 }
 
 /*
@@ -8072,6 +8436,10 @@ void __meminit kswapd_stop(int nid)
 	pg_data_t *pgdat = NODE_DATA(nid);
 	struct task_struct *kswapd;
 
+	mutex_lock(&kswapd_threads_lock);
+	kswapd_update_helpers(pgdat, 1);
+	mutex_unlock(&kswapd_threads_lock);
+
 	pgdat_kswapd_lock(pgdat);
 	kswapd = pgdat->kswapd;
 	if (kswapd) {
@@ -8088,6 +8456,7 @@ static int __init kswapd_init(void)
 	swap_setup();
 	for_each_node_state(nid, N_MEMORY)
  		kswapd_run(nid);
+	register_sysctl_init("vm", vm_kswapd_table);
 	return 0;
 }
 
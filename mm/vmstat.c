@@ -814,9 +814,7 @@ static int refresh_cpu_vm_stats(bool do_pagesets)
 
 	for_each_populated_zone(zone) {
 		struct per_cpu_zonestat __percpu *pzstats = zone->per_cpu_zonestats;
-#ifdef CONFIG_NUMA
 		struct per_cpu_pages __percpu *pcp = zone->per_cpu_pageset;
-#endif
 
 		for (i = 0; i < NR_VM_ZONE_STAT_ITEMS; i++) {
 			int v;
@@ -832,10 +830,12 @@ static int refresh_cpu_vm_stats(bool do_pagesets)
 #endif
 			}
 		}
-#ifdef CONFIG_NUMA
 
 		if (do_pagesets) {
 			cond_resched();
+
+			changes += decay_pcp_high(zone, this_cpu_ptr(pcp));
+#ifdef CONFIG_NUMA
 			/*
 			 * Deal with draining the remote pageset of this
 			 * processor
@@ -862,8 +862,8 @@ static int refresh_cpu_vm_stats(bool do_pagesets)
 				drain_zone_pages(zone, this_cpu_ptr(pcp));
 				changes++;
 			}
-		}
 #endif
+		}
 	}
 
 	for_each_online_pgdat(pgdat) {
@@ -1264,6 +1264,8 @@ const char * const vmstat_text[] = {
 	"pgactivate",
 	"pgdeactivate",
 	"pglazyfree",
+	"pcp_alloc_lock_avoided",
+	"pcp_free_lock_avoided",
 
 	"pgfault",
 	"pgmajfault",
@@ -1389,10 +1391,17 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_SWAP
 	"swap_ra",
 	"swap_ra_hit",
+	"swap_slots_refill",
+	"swap_alloc_scan",
+	"swap_lock_contended",
 #ifdef CONFIG_KSM
 	"ksm_swpin_copy",
 #endif
 #endif
+	"pgsize_fixup_vma",
+	"pgsize_fixup_pages",
+	"pgsize_pad_vma",
+	"pgsize_pad_pages",
 #ifdef CONFIG_KSM
 	"cow_ksm",
 #endif
@@ -1409,6 +1418,14 @@ const char * const vmstat_text[] = {
 	"vma_lock_abort",
 	"vma_lock_retry",
 	"vma_lock_miss",
+	"vma_lock_retry_anon_vma",
+	"vma_lock_retry_fault",
+	"vma_lock_retry_device",
+	"vma_lock_retry_hugetlb",
+	"vma_lock_retry_uffd",
+	"vma_lock_retry_wait",
+	"vma_lock_madvise",
+	"vma_lock_madvise_fallback",
 #endif
 #endif /* CONFIG_VM_EVENT_COUNTERS || CONFIG_MEMCG */
 };
@@ -1742,10 +1759,14 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
+			   "\n              high_min: %i"
+			   "\n              high_max: %i"
 			   "\n              batch: %i",
 			   i,
 			   pcp->count,
 			   pcp->high,
+			   pcp->high_min,
+			   pcp->high_max,
 			   pcp->batch);
 #ifdef CONFIG_SMP
 		pzstats = per_cpu_ptr(zone->per_cpu_zonestats, i);
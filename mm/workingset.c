@@ -295,6 +295,11 @@ static void lru_gen_refault(struct folio *folio, void *shadow)
 		goto unlock;
 
 	mod_lruvec_state(lruvec, WORKINGSET_REFAULT_BASE + type, delta);
+	/* generations between the eviction and min_seq */
+	mem_cgroup_account_refault(lruvec_memcg(lruvec), type,
+			(READ_ONCE(lruvec->lrugen.min_seq[type]) -
+			 (token >> LRU_REFS_WIDTH)) &
+			(EVICTION_MASK >> LRU_REFS_WIDTH), delta);
 
 	if (!recent)
 		goto unlock;
@@ -404,18 +409,8 @@ void *workingset_eviction(struct folio *folio, struct mem_cgroup *target_memcg)
 				folio_test_workingset(folio));
 }
 
-/**
- * workingset_test_recent - tests if the shadow entry is for a folio that was
- * recently evicted. Also fills in @workingset with the value unpacked from
- * shadow.
- * @shadow: the shadow entry to be tested.
- * @file: whether the corresponding folio is from the file lru.
- * @workingset: where the workingset value unpacked from shadow should
- * be stored.
- *
- * Return: true if the shadow is for a recently evicted folio; false otherwise.
- */
-bool workingset_test_recent(void *shadow, bool file, bool *workingset)
+static bool __workingset_test_recent(void *shadow, bool file, bool *workingset,
+				     unsigned long *distance)
 {
 	struct mem_cgroup *eviction_memcg;
 	struct lruvec *eviction_lruvec;
@@ -515,9 +510,27 @@ bool workingset_test_recent(void *shadow, bool file, bool *workingset)
 	}
 
 	mem_cgroup_put(eviction_memcg);
+	if (distance)
+		*distance = refault_distance;
 	return refault_distance <= workingset_size;
 }
 
+/**
+ * workingset_test_recent - tests if the shadow entry is for a folio that was
+ * recently evicted. Also fills in @workingset with the value unpacked from
+ * shadow.
+ * @shadow: the shadow entry to be tested.
+ * @file: whether the corresponding folio is from the file lru.
+ * @workingset: where the workingset value unpacked from shadow should
+ * be stored.
+ *
+ * Return: true if the shadow is for a recently evicted folio; false otherwise.
+ */
+bool workingset_test_recent(void *shadow, bool file, bool *workingset)
+{
+	return __workingset_test_recent(shadow, file, workingset, NULL);
+}
+
 /**
  * workingset_refault - Evaluate the refault of a previously evicted folio.
  * @folio: The freshly allocated replacement folio.
@@ -533,7 +546,9 @@ void workingset_refault(struct folio *folio, void *shadow)
 	struct pglist_data *pgdat;
 	struct mem_cgroup *memcg;
 	struct lruvec *lruvec;
+	unsigned long distance = ULONG_MAX;
 	bool workingset;
+	bool recent;
 	long nr;
 
 	trace_android_vh_count_workingset_refault(folio);
@@ -560,7 +575,11 @@ void workingset_refault(struct folio *folio, void *shadow)
 
 	mod_lruvec_state(lruvec, WORKINGSET_REFAULT_BASE + file, nr);
 
-	if (!workingset_test_recent(shadow, file, &workingset))
+	recent = __workingset_test_recent(shadow, file, &workingset, &distance);
+	if (distance != ULONG_MAX)
+		mem_cgroup_account_refault(memcg, file, fls_long(distance >> 8),
+					   nr);
+	if (!recent)
 		return;
 
 	folio_set_active(folio);
@@ -33,6 +33,7 @@
 /*
  * lock ordering:
  *	page_lock
+ *	zs_pcp->lock
  *	pool->lock
  *	zspage->lock
  */
@@ -56,6 +57,7 @@
 #include <linux/types.h>
 #include <linux/debugfs.h>
 #include <linux/zsmalloc.h>
+#include <linux/workqueue.h>
 #include <linux/zpool.h>
 #include <linux/migrate.h>
 #include <linux/wait.h>
@@ -195,6 +197,10 @@ struct size_class {
 
 	unsigned int index;
 	struct zs_size_stat stats;
+#ifdef CONFIG_ZSMALLOC_STAT
+	/* pool->lock acquisitions on behalf of this class that had to spin */
+	atomic_long_t lock_contended;
+#endif
 };
 
 /*
@@ -217,12 +223,54 @@ struct link_free {
 	};
 };
 
+/*
+ * Per-cpu object caches
+ *
+ * zs_free() parks handles in a per-cpu free magazine and releases them in
+ * batches, under a single pool->lock acquisition. Objects of classes that
+ * own a per-cpu slot stay allocated and are moved to that slot instead, from
+ * where zs_malloc() hands them out without taking pool->lock. Empty slots
+ * are refilled in batches from the class's partially used zspages.
+ *
+ * Cached objects are ordinary allocated objects with a handle, so page
+ * migration deals with them like with any other object. Compaction and pool
+ * destruction drain the caches first, so they don't keep zspages alive.
+ */
+#define ZS_PCP_CLASSES	8
+#define ZS_PCP_OBJS	8
+#define ZS_PCP_FREE	16
+
+/* Background compaction checks fragmentation at most this often */
+#define ZS_COMPACT_INTERVAL	HZ
+
+static unsigned int compact_frag_percent = 25;
+module_param(compact_frag_percent, uint, 0644);
+MODULE_PARM_DESC(compact_frag_percent,
+		 "Compact a pool in the background once this percentage of its pages could be freed by compaction, 0 to disable");
+
+static struct workqueue_struct *zs_compact_wq;
+
+struct zs_pcp_slot {
+	unsigned int class_idx;
+	unsigned int nr;
+	unsigned long handles[ZS_PCP_OBJS];
+};
+
+struct zs_pcp {
+	spinlock_t lock;
+	unsigned int nr_free;
+	unsigned int victim;
+	unsigned long free[ZS_PCP_FREE];
+	struct zs_pcp_slot slots[ZS_PCP_CLASSES];
+};
+
 struct zs_pool {
 	const char *name;
 
 	struct size_class *size_class[ZS_SIZE_CLASSES];
 	struct kmem_cache *handle_cachep;
 	struct kmem_cache *zspage_cachep;
+	struct zs_pcp __percpu *pcp;
 
 	atomic_long_t pages_allocated;
 
@@ -239,6 +287,9 @@ struct zs_pool {
 #endif
 	spinlock_t lock;
 	atomic_t compaction_in_progress;
+
+	struct delayed_work compact_work;
+	unsigned long compact_stamp;
 };
 
 struct zspage {
@@ -535,6 +586,24 @@ static inline unsigned long zs_stat_get(struct size_class *class, int type)
 	return class->stats.objs[type];
 }
 
+static inline void class_stat_contended(struct size_class *class,
+					bool contended)
+{
+#ifdef CONFIG_ZSMALLOC_STAT
+	if (contended)
+		atomic_long_inc(&class->lock_contended);
+#endif
+}
+
+/* Returns whether the lock was contended */
+static bool zs_pool_lock(struct zs_pool *pool)
+{
+	if (spin_trylock(&pool->lock))
+		return false;
+	spin_lock(&pool->lock);
+	return true;
+}
+
 #ifdef CONFIG_ZSMALLOC_STAT
 
 static void __init zs_stat_init(void)
@@ -562,14 +631,14 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 	int objs_per_zspage;
 	unsigned long obj_allocated, obj_used, pages_used, freeable;
 	unsigned long total_objs = 0, total_used_objs = 0, total_pages = 0;
-	unsigned long total_freeable = 0;
+	unsigned long total_freeable = 0, contended, total_contended = 0;
 	unsigned long inuse_totals[NR_FULLNESS_GROUPS] = {0, };
 
-	seq_printf(s, " %5s %5s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %13s %10s %10s %16s %8s\n",
+	seq_printf(s, " %5s %5s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %9s %13s %10s %10s %16s %8s %10s\n",
 			"class", "size", "10%", "20%", "30%", "40%",
 			"50%", "60%", "70%", "80%", "90%", "99%", "100%",
 			"obj_allocated", "obj_used", "pages_used",
-			"pages_per_zspage", "freeable");
+			"pages_per_zspage", "freeable", "contended");
 
 	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
 
@@ -595,14 +664,17 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 		pages_used = obj_allocated / objs_per_zspage *
 				class->pages_per_zspage;
 
-		seq_printf(s, "%13lu %10lu %10lu %16d %8lu\n",
+		contended = atomic_long_read(&class->lock_contended);
+
+		seq_printf(s, "%13lu %10lu %10lu %16d %8lu %10lu\n",
 			   obj_allocated, obj_used, pages_used,
-			   class->pages_per_zspage, freeable);
+			   class->pages_per_zspage, freeable, contended);
 
 		total_objs += obj_allocated;
 		total_used_objs += obj_used;
 		total_pages += pages_used;
 		total_freeable += freeable;
+		total_contended += contended;
 	}
 
 	seq_puts(s, "\n");
@@ -611,14 +683,28 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 	for (fg = ZS_INUSE_RATIO_10; fg < NR_FULLNESS_GROUPS; fg++)
 		seq_printf(s, "%9lu ", inuse_totals[fg]);
 
-	seq_printf(s, "%13lu %10lu %10lu %16s %8lu\n",
+	seq_printf(s, "%13lu %10lu %10lu %16s %8lu %10lu\n",
 		   total_objs, total_used_objs, total_pages, "",
-		   total_freeable);
+		   total_freeable, total_contended);
 
 	return 0;
 }
 DEFINE_SHOW_ATTRIBUTE(zs_stats_size);
 
+static int zs_stats_compaction_show(struct seq_file *s, void *v)
+{
+	struct zs_pool *pool = s->private;
+
+	seq_printf(s, "pages_compacted %ld\n",
+		   atomic_long_read(&pool->stats.pages_compacted));
+	seq_printf(s, "bg_compactions %ld\n",
+		   atomic_long_read(&pool->stats.bg_compactions));
+	seq_printf(s, "bg_last_bytes %ld\n",
+		   atomic_long_read(&pool->stats.bg_last_bytes));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(zs_stats_compaction);
+
 static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 {
 	if (!zs_stat_root) {
@@ -630,6 +716,8 @@ static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 
 	debugfs_create_file("classes", S_IFREG | 0444, pool->stat_dentry, pool,
 			    &zs_stats_size_fops);
+	debugfs_create_file("compaction", S_IFREG | 0444, pool->stat_dentry,
+			    pool, &zs_stats_compaction_fops);
 }
 
 static void zs_pool_stat_destroy(struct zs_pool *pool)
@@ -1346,6 +1434,9 @@ static unsigned long obj_malloc(struct zs_pool *pool,
 	return obj;
 }
 
+static unsigned long zs_pcp_alloc(struct zs_pool *pool,
+				  struct size_class *class);
+static void zs_compact_check(struct zs_pool *pool);
 
 /**
  * zs_malloc - Allocate block of given size from pool.
@@ -1367,16 +1458,20 @@ unsigned long zs_malloc(struct zs_pool *pool, size_t size, gfp_t gfp)
 	if (unlikely(!size || size > ZS_MAX_ALLOC_SIZE))
 		return (unsigned long)ERR_PTR(-EINVAL);
 
-	handle = cache_alloc_handle(pool, gfp);
-	if (!handle)
-		return (unsigned long)ERR_PTR(-ENOMEM);
-
 	/* extra space in chunk to keep the handle */
 	size += ZS_HANDLE_SIZE;
 	class = pool->size_class[get_size_class_index(size)];
 
+	handle = zs_pcp_alloc(pool, class);
+	if (handle)
+		return handle;
+
+	handle = cache_alloc_handle(pool, gfp);
+	if (!handle)
+		return (unsigned long)ERR_PTR(-ENOMEM);
+
 	/* pool->lock effectively protects the zpage migration */
-	spin_lock(&pool->lock);
+	class_stat_contended(class, zs_pool_lock(pool));
 	zspage = find_get_zspage(class);
 	if (likely(zspage)) {
 		obj = obj_malloc(pool, zspage, handle);
@@ -1442,25 +1537,29 @@ static void obj_free(int class_size, unsigned long obj)
 	mod_zspage_inuse(zspage, -1);
 }
 
-void zs_free(struct zs_pool *pool, unsigned long handle)
+/*
+ * The pool->lock protects the race with zpage's migration
+ * so it's safe to get the page from handle.
+ */
+static struct zspage *handle_to_zspage(unsigned long handle,
+				       unsigned long *obj)
 {
-	struct zspage *zspage;
 	struct page *f_page;
-	unsigned long obj;
+
+	*obj = handle_to_obj(handle);
+	obj_to_page(*obj, &f_page);
+	return get_zspage(f_page);
+}
+
+/* Called with pool->lock held, the handle is left to the caller */
+static void __zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	struct zspage *zspage;
 	struct size_class *class;
+	unsigned long obj;
 	int fullness;
 
-	if (IS_ERR_OR_NULL((void *)handle))
-		return;
-
-	/*
-	 * The pool->lock protects the race with zpage's migration
-	 * so it's safe to get the page from handle.
-	 */
-	spin_lock(&pool->lock);
-	obj = handle_to_obj(handle);
-	obj_to_page(obj, &f_page);
-	zspage = get_zspage(f_page);
+	zspage = handle_to_zspage(handle, &obj);
 	class = zspage_class(pool, zspage);
 
 	class_stat_dec(class, ZS_OBJS_INUSE, 1);
@@ -1469,9 +1568,194 @@ void zs_free(struct zs_pool *pool, unsigned long handle)
 	fullness = fix_fullness_group(class, zspage);
 	if (fullness == ZS_INUSE_RATIO_0)
 		free_zspage(pool, class, zspage);
+}
+
+static struct zs_pcp_slot *zs_pcp_find(struct zs_pcp *pcp,
+				       struct size_class *class)
+{
+	int i;
+
+	for (i = 0; i < ZS_PCP_CLASSES; i++)
+		if (pcp->slots[i].class_idx == class->index)
+			return &pcp->slots[i];
+	return NULL;
+}
+
+/* Called with pool->lock held */
+static void zs_pcp_slot_drain(struct zs_pool *pool, struct zs_pcp_slot *slot)
+{
+	unsigned long handle;
 
+	while (slot->nr) {
+		handle = slot->handles[--slot->nr];
+		__zs_free(pool, handle);
+		cache_free_handle(pool, handle);
+	}
+}
+
+/*
+ * Release the parked handles of @pcp under a single pool->lock acquisition.
+ * With @recycle, objects of classes owning a slot go to that slot instead.
+ * Called with pcp->lock held.
+ */
+static void zs_pcp_flush(struct zs_pool *pool, struct zs_pcp *pcp,
+			 bool recycle)
+{
+	bool contended;
+	unsigned int i, nr = 0;
+
+	if (!pcp->nr_free)
+		return;
+
+	contended = zs_pool_lock(pool);
+	for (i = 0; i < pcp->nr_free; i++) {
+		unsigned long handle = pcp->free[i], obj;
+		struct zspage *zspage = handle_to_zspage(handle, &obj);
+		struct size_class *class = zspage_class(pool, zspage);
+		struct zs_pcp_slot *slot;
+
+		/* Accounted to the class that happened to be first */
+		class_stat_contended(class, contended);
+		contended = false;
+
+		slot = recycle ? zs_pcp_find(pcp, class) : NULL;
+		if (slot && slot->nr < ZS_PCP_OBJS) {
+			slot->handles[slot->nr++] = handle;
+			continue;
+		}
+		__zs_free(pool, handle);
+		pcp->free[nr++] = handle;
+	}
 	spin_unlock(&pool->lock);
-	cache_free_handle(pool, handle);
+
+	kmem_cache_free_bulk(pool->handle_cachep, nr, (void **)pcp->free);
+	pcp->nr_free = 0;
+}
+
+/*
+ * Find a slot for a class that doesn't have one: an empty slot if there is
+ * one, otherwise the slots are taken over round robin. Called with
+ * pool->lock held.
+ */
+static struct zs_pcp_slot *zs_pcp_victim(struct zs_pool *pool,
+					 struct zs_pcp *pcp)
+{
+	struct zs_pcp_slot *slot;
+	int i;
+
+	for (i = 0; i < ZS_PCP_CLASSES; i++)
+		if (!pcp->slots[i].nr)
+			return &pcp->slots[i];
+
+	slot = &pcp->slots[pcp->victim++ % ZS_PCP_CLASSES];
+	zs_pcp_slot_drain(pool, slot);
+	return slot;
+}
+
+/*
+ * Refill (or set up) the slot of @class from the partially used zspages of
+ * the class. Handles are allocated in bulk without sleeping, as pcp->lock is
+ * held; zs_malloc() falls back to the regular path when that fails.
+ */
+static struct zs_pcp_slot *zs_pcp_refill(struct zs_pool *pool,
+					 struct zs_pcp *pcp,
+					 struct zs_pcp_slot *slot,
+					 struct size_class *class)
+{
+	unsigned long handles[ZS_PCP_OBJS];
+	struct zspage *zspage;
+	unsigned long obj;
+	int i, nr;
+
+	nr = kmem_cache_alloc_bulk(pool->handle_cachep,
+				   GFP_NOWAIT | __GFP_NOWARN,
+				   ZS_PCP_OBJS, (void **)handles);
+	if (!nr)
+		return NULL;
+
+	class_stat_contended(class, zs_pool_lock(pool));
+	if (!slot) {
+		slot = zs_pcp_victim(pool, pcp);
+		slot->class_idx = class->index;
+	}
+	for (i = 0; i < nr; i++) {
+		zspage = find_get_zspage(class);
+		if (!zspage)
+			break;
+		obj = obj_malloc(pool, zspage, handles[i]);
+		fix_fullness_group(class, zspage);
+		record_obj(handles[i], obj);
+		class_stat_inc(class, ZS_OBJS_INUSE, 1);
+		slot->handles[slot->nr++] = handles[i];
+	}
+	spin_unlock(&pool->lock);
+
+	if (i < nr)
+		kmem_cache_free_bulk(pool->handle_cachep, nr - i,
+				     (void **)&handles[i]);
+	return slot;
+}
+
+static unsigned long zs_pcp_alloc(struct zs_pool *pool,
+				  struct size_class *class)
+{
+	struct zs_pcp *pcp = raw_cpu_ptr(pool->pcp);
+	struct zs_pcp_slot *slot;
+	unsigned long handle = 0;
+
+	/* Caching objects of huge classes would pin whole pages */
+	if (class->objs_per_zspage == 1)
+		return 0;
+
+	spin_lock(&pcp->lock);
+	slot = zs_pcp_find(pcp, class);
+	if (!slot || !slot->nr)
+		slot = zs_pcp_refill(pool, pcp, slot, class);
+	if (slot && slot->nr)
+		handle = slot->handles[--slot->nr];
+	spin_unlock(&pcp->lock);
+
+	return handle;
+}
+
+/* Give back all cached objects, so that their zspages can go */
+static void zs_pcp_drain(struct zs_pool *pool)
+{
+	struct zs_pcp *pcp;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		pcp = per_cpu_ptr(pool->pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		zs_pcp_flush(pool, pcp, false);
+		spin_lock(&pool->lock);
+		for (i = 0; i < ZS_PCP_CLASSES; i++)
+			zs_pcp_slot_drain(pool, &pcp->slots[i]);
+		spin_unlock(&pool->lock);
+		spin_unlock(&pcp->lock);
+	}
+}
+
+void zs_free(struct zs_pool *pool, unsigned long handle)
+{
+	struct zs_pcp *pcp;
+	bool flushed = false;
+
+	if (IS_ERR_OR_NULL((void *)handle))
+		return;
+
+	pcp = raw_cpu_ptr(pool->pcp);
+	spin_lock(&pcp->lock);
+	if (pcp->nr_free == ZS_PCP_FREE) {
+		zs_pcp_flush(pool, pcp, true);
+		flushed = true;
+	}
+	pcp->free[pcp->nr_free++] = handle;
+	spin_unlock(&pcp->lock);
+
+	if (flushed)
+		zs_compact_check(pool);
 }
 EXPORT_SYMBOL_GPL(zs_free);
 
@@ -2063,6 +2347,8 @@ unsigned long zs_compact(struct zs_pool *pool)
 	if (atomic_xchg(&pool->compaction_in_progress, 1))
 		return 0;
 
+	zs_pcp_drain(pool);
+
 	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--) {
 		class = pool->size_class[i];
 		if (class->index != i)
@@ -2076,6 +2362,71 @@ unsigned long zs_compact(struct zs_pool *pool)
 }
 EXPORT_SYMBOL_GPL(zs_compact);
 
+/*
+ * Background compaction only runs while the system is mostly idle, so that
+ * it doesn't compete for pool->lock and CPU time with a busy foreground.
+ */
+static bool zs_system_idle(void)
+{
+	unsigned int cpu, busy = 0;
+
+	for_each_online_cpu(cpu)
+		if (cpu != raw_smp_processor_id() && !available_idle_cpu(cpu))
+			busy++;
+
+	return busy * 4 <= num_online_cpus();
+}
+
+static void zs_compact_workfn(struct work_struct *work)
+{
+	struct zs_pool *pool = container_of(to_delayed_work(work),
+					    struct zs_pool, compact_work);
+	unsigned long pages_freed;
+
+	/* Not idle; zs_compact_check() will try again after a while */
+	if (!zs_system_idle())
+		return;
+
+	pages_freed = zs_compact(pool);
+	atomic_long_inc(&pool->stats.bg_compactions);
+	atomic_long_set(&pool->stats.bg_last_bytes, pages_freed << PAGE_SHIFT);
+}
+
+/*
+ * Called from the free path: kick off background compaction once the pages
+ * compaction could free pass compact_frag_percent of the pool.
+ */
+static void zs_compact_check(struct zs_pool *pool)
+{
+	unsigned int thr = READ_ONCE(compact_frag_percent);
+	unsigned long pages, freeable = 0;
+	struct size_class *class;
+	int i;
+
+	if (!thr || !zs_compact_wq ||
+	    time_before(jiffies, READ_ONCE(pool->compact_stamp)))
+		return;
+	WRITE_ONCE(pool->compact_stamp, jiffies + ZS_COMPACT_INTERVAL);
+
+	if (delayed_work_pending(&pool->compact_work))
+		return;
+
+	pages = atomic_long_read(&pool->pages_allocated);
+	if (!pages)
+		return;
+
+	for (i = ZS_SIZE_CLASSES - 1; i >= 0; i--) {
+		class = pool->size_class[i];
+		if (class->index != i)
+			continue;
+
+		freeable += zs_can_compact(class);
+	}
+
+	if (freeable * 100 >= pages * thr)
+		queue_delayed_work(zs_compact_wq, &pool->compact_work, 0);
+}
+
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
 {
 	memcpy(stats, &pool->stats, sizeof(struct zs_pool_stats));
@@ -2178,6 +2529,7 @@ struct zs_pool *zs_create_pool(const char *name)
 
 	init_deferred_free(pool);
 	spin_lock_init(&pool->lock);
+	INIT_DELAYED_WORK(&pool->compact_work, zs_compact_workfn);
 	atomic_set(&pool->compaction_in_progress, 0);
 
 	pool->name = kstrdup(name, GFP_KERNEL);
@@ -2187,6 +2539,19 @@ struct zs_pool *zs_create_pool(const char *name)
 	if (create_cache(pool))
 		goto err;
 
+	pool->pcp = alloc_percpu(struct zs_pcp);
+	if (!pool->pcp)
+		goto err;
+
+	for_each_possible_cpu(i) {
+		struct zs_pcp *pcp = per_cpu_ptr(pool->pcp, i);
+		int slot;
+
+		spin_lock_init(&pcp->lock);
+		for (slot = 0; slot < ZS_PCP_CLASSES; slot++)
+			pcp->slots[slot].class_idx = ZS_SIZE_CLASSES;
+	}
+
 	/*
 	 * Iterate reversely, because, size of size_class that we want to use
 	 * for merging should be larger or equal to current size.
@@ -2284,6 +2649,11 @@ void zs_destroy_pool(struct zs_pool *pool)
 	int i;
 
 	zs_unregister_shrinker(pool);
+	cancel_delayed_work_sync(&pool->compact_work);
+	if (pool->pcp) {
+		zs_pcp_drain(pool);
+		free_percpu(pool->pcp);
+	}
 	zs_flush_migration(pool);
 	zs_pool_stat_destroy(pool);
 
@@ -2313,6 +2683,26 @@ void zs_destroy_pool(struct zs_pool *pool)
 }
 EXPORT_SYMBOL_GPL(zs_destroy_pool);
 
+static void __init zs_compact_wq_init(void)
+{
+	struct workqueue_attrs *attrs;
+
+	zs_compact_wq = alloc_workqueue("zs_compact",
+					WQ_UNBOUND | WQ_FREEZABLE, 0);
+	if (!zs_compact_wq) {
+		pr_warn("no background compaction workqueue\n");
+		return;
+	}
+
+	/* Background compaction should only use otherwise idle CPU time */
+	attrs = alloc_workqueue_attrs();
+	if (attrs) {
+		attrs->nice = MAX_NICE;
+		apply_workqueue_attrs(zs_compact_wq, attrs);
+		free_workqueue_attrs(attrs);
+	}
+}
+
 static int __init zs_init(void)
 {
 	int ret;
@@ -2322,6 +2712,9 @@ static int __init zs_init(void)
 	if (ret)
 		goto out;
 
+	/* background compaction is optional, don't fail */
+	zs_compact_wq_init();
+
 #ifdef CONFIG_ZPOOL
 	zpool_register_driver(&zs_zpool_driver);
 #endif
@@ -2340,6 +2733,8 @@ static void __exit zs_exit(void)
 	zpool_unregister_driver(&zs_zpool_driver);
 #endif
 	cpuhp_remove_state(CPUHP_MM_ZS_PREPARE);
+	if (zs_compact_wq)
+		destroy_workqueue(zs_compact_wq);
 
 	zs_stat_exit();
 }
@@ -34,6 +34,9 @@
 #include <linux/writeback.h>
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
+#include <linux/blkdev.h>
+#include <linux/sort.h>
+#include <linux/sched/stat.h>
 
 #include "swap.h"
 #include "internal.h"
@@ -69,6 +72,12 @@ static u64 zswap_reject_alloc_fail;
 static u64 zswap_reject_kmemcache_fail;
 /* Duplicate store was encountered (rare) */
 static u64 zswap_duplicate_entry;
+/* Pages demoted into zswap by the idle demotion work */
+static u64 zswap_demoted_pages;
+/* Demoted pages faulted back in from zswap */
+static u64 zswap_demote_hit;
+/* Demoted pages that had to be written back to the swap device */
+static u64 zswap_demote_miss;
 
 /* Shrinker work queue */
 static struct workqueue_struct *shrink_wq;
@@ -141,9 +150,29 @@ static bool zswap_exclusive_loads_enabled = IS_ENABLED(
 		CONFIG_ZSWAP_EXCLUSIVE_LOADS_DEFAULT_ON);
 module_param_named(exclusive_loads, zswap_exclusive_loads_enabled, bool, 0644);
 
+/*
+ * Proactively demote the oldest anon generations into zswap every
+ * demote_interval_ms while the system is idle (0 disables it), at most
+ * demote_batch_pages per node and interval.
+ */
+static unsigned int zswap_demote_interval_ms;
+static int zswap_demote_interval_set(const char *, const struct kernel_param *);
+static const struct kernel_param_ops zswap_demote_interval_param_ops = {
+	.set =		zswap_demote_interval_set,
+	.get =		param_get_uint,
+};
+module_param_cb(demote_interval_ms, &zswap_demote_interval_param_ops,
+		&zswap_demote_interval_ms, 0644);
+
+static unsigned int zswap_demote_batch_pages = 1024;
+module_param_named(demote_batch_pages, zswap_demote_batch_pages, uint, 0644);
+
 /* Number of zpools in zswap_pool (empirically determined for scalability) */
 #define ZSWAP_NR_ZPOOLS 32
 
+/* Number of LRU entries written back under one plug */
+#define ZSWAP_WB_BATCH 16
+
 /*********************************
 * data structures
 **********************************/
@@ -173,6 +202,8 @@ struct zswap_pool {
 	char tfm_name[CRYPTO_MAX_ALG_NAME];
 	struct list_head lru;
 	spinlock_t lru_lock;
+	/* memcgs selecting this pool, which together hold one reference */
+	unsigned int memcg_users;
 };
 
 /*
@@ -197,12 +228,14 @@ struct zswap_pool {
  * value - value of the same-value filled pages which have same content
  * objcg - the obj_cgroup that the compressed memory is charged to
  * lru - handle to the pool's lru used to evict pages.
+ * demoted - stored by the idle demotion work rather than by reclaim
  */
 struct zswap_entry {
 	struct rb_node rbnode;
 	swp_entry_t swpentry;
 	int refcount;
 	unsigned int length;
+	bool demoted;
 	struct zswap_pool *pool;
 	union {
 		unsigned long handle;
@@ -212,6 +245,17 @@ struct zswap_entry {
 	struct list_head lru;
 };
 
+/*
+ * An entry taken off the LRU for writeback. Once the lru lock is dropped the
+ * entry might get freed, so its swap entry is copied and the entry isn't
+ * deref'd again until it is verified to still be alive in the tree.
+ */
+struct zswap_wb_item {
+	struct zswap_entry *entry;
+	struct zswap_tree *tree;
+	swp_entry_t swpentry;
+};
+
 /*
  * The tree lock in the zswap_tree struct protects a few things:
  * - the rbtree
@@ -230,6 +274,8 @@ static LIST_HEAD(zswap_pools);
 static DEFINE_SPINLOCK(zswap_pools_lock);
 /* pool counter to provide unique names to zpool */
 static atomic_t zswap_pools_count = ATOMIC_INIT(0);
+/* protects zswap_pool.memcg_users modification */
+static DEFINE_MUTEX(zswap_memcg_pools_lock);
 
 enum zswap_init_type {
 	ZSWAP_UNINIT,
@@ -254,7 +300,8 @@ static bool zswap_has_pool;
 		 zpool_get_type((p)->zpools[0]))
 
 static int zswap_writeback_entry(struct zswap_entry *entry,
-				 struct zswap_tree *tree);
+				 struct zswap_tree *tree,
+				 struct writeback_control *wbc);
 static int zswap_pool_get(struct zswap_pool *pool);
 static void zswap_pool_put(struct zswap_pool *pool);
 
@@ -577,14 +624,25 @@ static struct zswap_pool *zswap_pool_current_get(void)
 	return pool;
 }
 
+/*
+ * The oldest pool, which is the one to shrink. Pools pinned by memcgs, see
+ * zswap_compressor_get(), are added at the tail but aren't being retired,
+ * so they're only picked when there is no other pool.
+ */
 static struct zswap_pool *zswap_pool_last_get(void)
 {
-	struct zswap_pool *pool, *last = NULL;
+	struct zswap_pool *pool, *last = NULL, *last_pinned = NULL;
 
 	rcu_read_lock();
 
-	list_for_each_entry_rcu(pool, &zswap_pools, list)
-		last = pool;
+	list_for_each_entry_rcu(pool, &zswap_pools, list) {
+		if (READ_ONCE(pool->memcg_users))
+			last_pinned = pool;
+		else
+			last = pool;
+	}
+	if (!last)
+		last = last_pinned;
 	WARN_ONCE(!last && zswap_has_pool,
 		  "%s: no page storage pool!\n", __func__);
 	if (!zswap_pool_get(last))
@@ -617,6 +675,43 @@ static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 	return NULL;
 }
 
+/*
+ * Find the pool memcgs use for @compressor. Must be called under
+ * rcu_read_lock(); the pool stays around while zswap_memcg_pools_lock
+ * is held.
+ */
+static struct zswap_pool *zswap_pool_find_memcg(const char *compressor)
+{
+	struct zswap_pool *pool;
+
+	list_for_each_entry_rcu(pool, &zswap_pools, list) {
+		if (READ_ONCE(pool->memcg_users) &&
+		    !strcmp(pool->tfm_name, compressor))
+			return pool;
+	}
+
+	return NULL;
+}
+
+/* The pool for a store charged to @objcg, see memory.zswap.compressor */
+static struct zswap_pool *zswap_pool_objcg_get(struct obj_cgroup *objcg)
+{
+	char compressor[CRYPTO_MAX_ALG_NAME];
+	struct zswap_pool *pool;
+
+	if (!objcg || !obj_cgroup_zswap_compressor(objcg, compressor,
+						   sizeof(compressor)))
+		return zswap_pool_current_get();
+
+	rcu_read_lock();
+	pool = zswap_pool_find_memcg(compressor);
+	if (!zswap_pool_get(pool))
+		pool = NULL;
+	rcu_read_unlock();
+
+	return pool ?: zswap_pool_current_get();
+}
+
 /*
  * If the entry is still valid in the tree, drop the initial ref and remove it
  * from the tree. This function must be called with an additional ref held,
@@ -629,33 +724,51 @@ static void zswap_invalidate_entry(struct zswap_tree *tree,
 		zswap_entry_put(tree, entry);
 }
 
-static int zswap_reclaim_entry(struct zswap_pool *pool)
+static int zswap_wb_item_cmp(const void *a, const void *b)
+{
+	const struct zswap_wb_item *l = a, *r = b;
+
+	if (l->swpentry.val == r->swpentry.val)
+		return 0;
+	return l->swpentry.val < r->swpentry.val ? -1 : 1;
+}
+
+/*
+ * Take up to @nr entries off the tail of the LRU. They are returned sorted
+ * by swap slot, so that the writes of neighbouring slots can be merged into
+ * multi-page bios while plugged.
+ */
+static int zswap_isolate_entries(struct zswap_pool *pool,
+				 struct zswap_wb_item *items, int nr)
 {
 	struct zswap_entry *entry;
-	struct zswap_tree *tree;
-	pgoff_t swpoffset;
-	int ret;
+	int i;
 
-	/* Get an entry off the LRU */
 	spin_lock(&pool->lru_lock);
-	if (list_empty(&pool->lru)) {
-		spin_unlock(&pool->lru_lock);
-		return -EINVAL;
+	for (i = 0; i < nr && !list_empty(&pool->lru); i++) {
+		entry = list_last_entry(&pool->lru, struct zswap_entry, lru);
+		list_del_init(&entry->lru);
+		items[i].entry = entry;
+		items[i].swpentry = entry->swpentry;
+		items[i].tree = zswap_trees[swp_type(entry->swpentry)];
 	}
-	entry = list_last_entry(&pool->lru, struct zswap_entry, lru);
-	list_del_init(&entry->lru);
-	/*
-	 * Once the lru lock is dropped, the entry might get freed. The
-	 * swpoffset is copied to the stack, and entry isn't deref'd again
-	 * until the entry is verified to still be alive in the tree.
-	 */
-	swpoffset = swp_offset(entry->swpentry);
-	tree = zswap_trees[swp_type(entry->swpentry)];
 	spin_unlock(&pool->lru_lock);
 
+	sort(items, i, sizeof(*items), zswap_wb_item_cmp, NULL);
+	return i;
+}
+
+static int zswap_reclaim_entry(struct zswap_pool *pool,
+			       struct zswap_wb_item *item,
+			       struct writeback_control *wbc)
+{
+	struct zswap_entry *entry = item->entry;
+	struct zswap_tree *tree = item->tree;
+	int ret;
+
 	/* Check for invalidate() race */
 	spin_lock(&tree->lock);
-	if (entry != zswap_rb_search(&tree->rbroot, swpoffset)) {
+	if (entry != zswap_rb_search(&tree->rbroot, swp_offset(item->swpentry))) {
 		ret = -EAGAIN;
 		goto unlock;
 	}
@@ -663,7 +776,7 @@ static int zswap_reclaim_entry(struct zswap_pool *pool)
 	zswap_entry_get(entry);
 	spin_unlock(&tree->lock);
 
-	ret = zswap_writeback_entry(entry, tree);
+	ret = zswap_writeback_entry(entry, tree, wbc);
 
 	spin_lock(&tree->lock);
 	if (ret) {
@@ -693,22 +806,95 @@ static void shrink_worker(struct work_struct *w)
 {
 	struct zswap_pool *pool = container_of(w, typeof(*pool),
 						shrink_work);
-	int ret, failures = 0;
+	struct zswap_wb_item items[ZSWAP_WB_BATCH];
+	struct swap_iocb *swap_plug = NULL;
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+		.swap_plug = &swap_plug,
+	};
+	struct blk_plug plug;
+	int i, nr, failures = 0;
 
 	do {
-		ret = zswap_reclaim_entry(pool);
-		if (ret) {
+		nr = zswap_isolate_entries(pool, items, ZSWAP_WB_BATCH);
+		if (!nr) {
 			zswap_reject_reclaim_fail++;
-			if (ret != -EAGAIN)
-				break;
-			if (++failures == MAX_RECLAIM_RETRIES)
-				break;
+			break;
 		}
+
+		blk_start_plug(&plug);
+		for (i = 0; i < nr; i++) {
+			if (zswap_reclaim_entry(pool, &items[i], &wbc)) {
+				zswap_reject_reclaim_fail++;
+				failures++;
+			}
+		}
+		blk_finish_plug(&plug);
+		if (swap_plug) {
+			swap_write_unplug(swap_plug);
+			swap_plug = NULL;
+		}
+
+		if (failures >= MAX_RECLAIM_RETRIES)
+			break;
 		cond_resched();
 	} while (!zswap_can_accept());
 	zswap_pool_put(pool);
 }
 
+/*********************************
+* idle demotion
+**********************************/
+static void zswap_demote_workfn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(zswap_demote_work, zswap_demote_workfn);
+
+/* Whether the page being stored is demoted by zswap_demote_workfn() */
+static bool zswap_demoting(void)
+{
+	return current_work() == &zswap_demote_work.work;
+}
+
+/* Demotion only runs while at least one CPU has nothing to run */
+static bool zswap_system_idle(void)
+{
+	return nr_running() < num_online_cpus();
+}
+
+static void zswap_demote_workfn(struct work_struct *work)
+{
+	unsigned int interval = READ_ONCE(zswap_demote_interval_ms);
+	unsigned long batch = READ_ONCE(zswap_demote_batch_pages);
+	int nid;
+
+	if (!interval)
+		return;
+
+	if (zswap_enabled && batch && zswap_system_idle() &&
+	    !zswap_pool_reached_full && zswap_can_accept()) {
+		for_each_node_state(nid, N_MEMORY)
+			zswap_demoted_pages += lru_gen_demote_anon(nid, batch);
+	}
+
+	queue_delayed_work(system_unbound_wq, &zswap_demote_work,
+			   msecs_to_jiffies(interval));
+}
+
+/* Set at boot or before zswap is enabled, zswap_setup() starts the work */
+static int zswap_demote_interval_set(const char *val,
+				     const struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&zswap_init_lock);
+	ret = param_set_uint(val, kp);
+	if (!ret && zswap_demote_interval_ms &&
+	    zswap_init_state == ZSWAP_INIT_SUCCEED)
+		mod_delayed_work(system_unbound_wq, &zswap_demote_work,
+				 msecs_to_jiffies(zswap_demote_interval_ms));
+	mutex_unlock(&zswap_init_lock);
+	return ret;
+}
+
 static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 {
 	int i;
@@ -881,6 +1067,79 @@ static void zswap_pool_put(struct zswap_pool *pool)
 	kref_put(&pool->kref, __zswap_pool_empty);
 }
 
+/**
+ * zswap_compressor_get - pin a pool for a per-memcg compressor
+ * @compressor: compressor selected through memory.zswap.compressor
+ *
+ * Makes sure a pool using @compressor, and the current zpool type, exists
+ * for as long as some memcg selects it. Stores charged to such a memcg go to
+ * that pool instead of the current one; entries are always loaded and
+ * written back through the pool that stored them.
+ */
+int zswap_compressor_get(const char *compressor)
+{
+	struct zswap_pool *pool;
+	int ret = 0;
+
+	if (!zswap_has_pool)
+		return -ENODEV;
+	if (!crypto_has_acomp(compressor, 0, 0))
+		return -ENOENT;
+
+	mutex_lock(&zswap_memcg_pools_lock);
+	rcu_read_lock();
+	pool = zswap_pool_find_memcg(compressor);
+	rcu_read_unlock();
+	if (pool) {
+		WRITE_ONCE(pool->memcg_users, pool->memcg_users + 1);
+		goto out;
+	}
+
+	spin_lock(&zswap_pools_lock);
+	pool = zswap_pool_find_get(zswap_zpool_type, (char *)compressor);
+	spin_unlock(&zswap_pools_lock);
+
+	if (!pool) {
+		pool = zswap_pool_create(zswap_zpool_type, (char *)compressor);
+		if (!pool) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		spin_lock(&zswap_pools_lock);
+		list_add_tail_rcu(&pool->list, &zswap_pools);
+		spin_unlock(&zswap_pools_lock);
+	}
+
+	/* the reference taken above now belongs to the memcg users */
+	WRITE_ONCE(pool->memcg_users, 1);
+out:
+	mutex_unlock(&zswap_memcg_pools_lock);
+	return ret;
+}
+
+/**
+ * zswap_compressor_put - unpin a pool pinned by zswap_compressor_get()
+ * @compressor: compressor no longer selected by a memcg
+ */
+void zswap_compressor_put(const char *compressor)
+{
+	struct zswap_pool *pool;
+	bool last = false;
+
+	mutex_lock(&zswap_memcg_pools_lock);
+	rcu_read_lock();
+	pool = zswap_pool_find_memcg(compressor);
+	rcu_read_unlock();
+	if (!WARN_ON_ONCE(!pool)) {
+		WRITE_ONCE(pool->memcg_users, pool->memcg_users - 1);
+		last = !pool->memcg_users;
+	}
+	mutex_unlock(&zswap_memcg_pools_lock);
+
+	if (last)
+		zswap_pool_put(pool);
+}
+
 /*********************************
 * param callbacks
 **********************************/
@@ -1053,7 +1312,8 @@ static int zswap_enabled_param_set(const char *val,
  * freed.
  */
 static int zswap_writeback_entry(struct zswap_entry *entry,
-				 struct zswap_tree *tree)
+				 struct zswap_tree *tree,
+				 struct writeback_control *wbc)
 {
 	swp_entry_t swpentry = entry->swpentry;
 	struct page *page;
@@ -1064,9 +1324,6 @@ static int zswap_writeback_entry(struct zswap_entry *entry,
 	u8 *src, *tmp = NULL;
 	unsigned int dlen;
 	int ret;
-	struct writeback_control wbc = {
-		.sync_mode = WB_SYNC_NONE,
-	};
 
 	if (!zpool_can_sleep_mapped(pool)) {
 		tmp = kmalloc(PAGE_SIZE, GFP_KERNEL);
@@ -1142,9 +1399,11 @@ static int zswap_writeback_entry(struct zswap_entry *entry,
 	SetPageReclaim(page);
 
 	/* start writeback */
-	__swap_writepage(page, &wbc);
+	__swap_writepage(page, wbc);
 	put_page(page);
 	zswap_written_back_pages++;
+	if (entry->demoted)
+		zswap_demote_miss++;
 
 	return ret;
 
@@ -1190,17 +1449,17 @@ static void zswap_fill_page(void *ptr, unsigned long value)
 	memset_l(page, value, PAGE_SIZE / sizeof(unsigned long));
 }
 
-bool zswap_store(struct folio *folio)
+/*
+ * Compress and store one page of a swapcache folio at @offset.  On success the
+ * entry takes its own reference on @objcg.
+ */
+static bool zswap_store_page(struct page *page, int type, pgoff_t offset,
+			     struct obj_cgroup *objcg)
 {
-	swp_entry_t swp = folio->swap;
-	int type = swp_type(swp);
-	pgoff_t offset = swp_offset(swp);
-	struct page *page = &folio->page;
 	struct zswap_tree *tree = zswap_trees[type];
 	struct zswap_entry *entry, *dupentry;
 	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
-	struct obj_cgroup *objcg = NULL;
 	struct zswap_pool *pool;
 	struct zpool *zpool;
 	unsigned int dlen = PAGE_SIZE;
@@ -1210,41 +1469,6 @@ bool zswap_store(struct folio *folio)
 	gfp_t gfp;
 	int ret;
 
-	VM_WARN_ON_ONCE(!folio_test_locked(folio));
-	VM_WARN_ON_ONCE(!folio_test_swapcache(folio));
-
-	/* Large folios aren't supported */
-	if (folio_test_large(folio))
-		return false;
-
-	if (!tree)
-		return false;
-
-	/*
-	 * If this is a duplicate, it must be removed before attempting to store
-	 * it, otherwise, if the store fails the old page won't be removed from
-	 * the tree, and it might be written back overriding the new data.
-	 */
-	spin_lock(&tree->lock);
-	dupentry = zswap_rb_search(&tree->rbroot, offset);
-	if (dupentry) {
-		zswap_duplicate_entry++;
-		zswap_invalidate_entry(tree, dupentry);
-	}
-	spin_unlock(&tree->lock);
-
-	if (!zswap_enabled)
-		return false;
-
-	/*
-	 * XXX: zswap reclaim does not work with cgroups yet. Without a
-	 * cgroup-aware entry LRU, we will push out entries system-wide based on
-	 * local cgroup limits.
-	 */
-	objcg = get_obj_cgroup_from_folio(folio);
-	if (objcg && !obj_cgroup_may_zswap(objcg))
-		goto reject;
-
 	/* reclaim space if needed */
 	if (zswap_is_full()) {
 		zswap_pool_limit_hit++;
@@ -1263,7 +1487,7 @@ bool zswap_store(struct folio *folio)
 	entry = zswap_entry_cache_alloc(GFP_KERNEL);
 	if (!entry) {
 		zswap_reject_kmemcache_fail++;
-		goto reject;
+		return false;
 	}
 
 	if (zswap_same_filled_pages_enabled) {
@@ -1283,7 +1507,7 @@ bool zswap_store(struct folio *folio)
 		goto freepage;
 
 	/* if entry is successfully added, it keeps the reference */
-	entry->pool = zswap_pool_current_get();
+	entry->pool = zswap_pool_objcg_get(objcg);
 	if (!entry->pool)
 		goto freepage;
 
@@ -1342,19 +1566,20 @@ bool zswap_store(struct folio *folio)
 	entry->length = dlen;
 
 insert_entry:
+	entry->demoted = zswap_demoting();
 	entry->objcg = objcg;
 	if (objcg) {
+		obj_cgroup_get(objcg);
 		obj_cgroup_charge_zswap(objcg, entry->length);
-		/* Account before objcg ref is moved to tree */
 		count_objcg_event(objcg, ZSWPOUT);
 	}
 
 	/* map */
 	spin_lock(&tree->lock);
 	/*
-	 * A duplicate entry should have been removed at the beginning of this
-	 * function. Since the swap entry should be pinned, if a duplicate is
-	 * found again here it means that something went wrong in the swap
+	 * A duplicate entry should have been removed at the beginning of
+	 * zswap_store(). Since the swap entry should be pinned, if a duplicate
+	 * is found again here it means that something went wrong in the swap
 	 * cache.
 	 */
 	while (zswap_rb_insert(&tree->rbroot, entry, &dupentry) == -EEXIST) {
@@ -1381,25 +1606,112 @@ bool zswap_store(struct folio *folio)
 	zswap_pool_put(entry->pool);
 freepage:
 	zswap_entry_cache_free(entry);
-reject:
-	if (objcg)
-		obj_cgroup_put(objcg);
 	return false;
 
 shrink:
 	pool = zswap_pool_last_get();
 	if (pool && !queue_work(shrink_wq, &pool->shrink_work))
 		zswap_pool_put(pool);
-	goto reject;
+	return false;
 }
 
-bool zswap_load(struct folio *folio)
+/*
+ * Large folios are stored page by page, as entries at consecutive offsets.
+ * Either all of the pages are stored, or none is, so that swap_writepage()
+ * can fall back to writing the whole folio to the backing device.
+ */
+bool zswap_store(struct folio *folio)
 {
 	swp_entry_t swp = folio->swap;
 	int type = swp_type(swp);
 	pgoff_t offset = swp_offset(swp);
-	struct page *page = &folio->page;
 	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *dupentry;
+	struct obj_cgroup *objcg = NULL;
+	long nr = folio_nr_pages(folio);
+	long i;
+
+	VM_WARN_ON_ONCE(!folio_test_locked(folio));
+	VM_WARN_ON_ONCE(!folio_test_swapcache(folio));
+
+	if (!tree)
+		return false;
+
+	/*
+	 * If this is a duplicate, it must be removed before attempting to store
+	 * it, otherwise, if the store fails the old page won't be removed from
+	 * the tree, and it might be written back overriding the new data.
+	 */
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++) {
+		dupentry = zswap_rb_search(&tree->rbroot, offset + i);
+		if (dupentry) {
+			zswap_duplicate_entry++;
+			zswap_invalidate_entry(tree, dupentry);
+		}
+	}
+	spin_unlock(&tree->lock);
+
+	if (!zswap_enabled)
+		return false;
+
+	/*
+	 * XXX: zswap reclaim does not work with cgroups yet. Without a
+	 * cgroup-aware entry LRU, we will push out entries system-wide based on
+	 * local cgroup limits.
+	 */
+	objcg = get_obj_cgroup_from_folio(folio);
+	if (objcg && !obj_cgroup_may_zswap(objcg))
+		goto reject;
+
+	for (i = 0; i < nr; i++) {
+		if (!zswap_store_page(folio_page(folio, i), type, offset + i,
+				      objcg))
+			goto unwind;
+	}
+
+	if (objcg)
+		obj_cgroup_put(objcg);
+	if (folio_test_large(folio))
+		count_mthp_stat(folio_order(folio), MTHP_STAT_ZSWPOUT);
+	return true;
+
+unwind:
+	spin_lock(&tree->lock);
+	while (i--) {
+		dupentry = zswap_rb_search(&tree->rbroot, offset + i);
+		if (dupentry)
+			zswap_invalidate_entry(tree, dupentry);
+	}
+	spin_unlock(&tree->lock);
+reject:
+	if (objcg)
+		obj_cgroup_put(objcg);
+	return false;
+}
+
+/* Returns how many of the @nr entries starting at @swp are in zswap */
+int zswap_entries_present(swp_entry_t swp, int nr)
+{
+	struct zswap_tree *tree = zswap_trees[swp_type(swp)];
+	pgoff_t offset = swp_offset(swp);
+	int i, present = 0;
+
+	if (!tree)
+		return 0;
+
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++)
+		if (zswap_rb_search(&tree->rbroot, offset + i))
+			present++;
+	spin_unlock(&tree->lock);
+
+	return present;
+}
+
+static bool zswap_load_page(struct folio *folio, struct page *page,
+			    struct zswap_tree *tree, pgoff_t offset)
+{
 	struct zswap_entry *entry;
 	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
@@ -1408,8 +1720,6 @@ bool zswap_load(struct folio *folio)
 	unsigned int dlen;
 	bool ret;
 
-	VM_WARN_ON_ONCE(!folio_test_locked(folio));
-
 	/* find */
 	spin_lock(&tree->lock);
 	entry = zswap_entry_find_get(&tree->rbroot, offset);
@@ -1463,6 +1773,8 @@ bool zswap_load(struct folio *folio)
 
 	ret = true;
 stats:
+	if (entry->demoted)
+		zswap_demote_hit++;
 	count_vm_event(ZSWPIN);
 	if (entry->objcg)
 		count_objcg_event(entry->objcg, ZSWPIN);
@@ -1482,6 +1794,37 @@ bool zswap_load(struct folio *folio)
 	return ret;
 }
 
+/*
+ * A large folio is only swapped in from zswap when all of its entries are
+ * there, see zswap_entries_present(); otherwise it is read from the backing
+ * device as a whole.
+ */
+bool zswap_load(struct folio *folio)
+{
+	swp_entry_t swp = folio->swap;
+	pgoff_t offset = swp_offset(swp);
+	struct zswap_tree *tree = zswap_trees[swp_type(swp)];
+	long nr = folio_nr_pages(folio);
+	long i;
+
+	VM_WARN_ON_ONCE(!folio_test_locked(folio));
+
+	if (!zswap_load_page(folio, folio_page(folio, 0), tree, offset))
+		return false;
+
+	for (i = 1; i < nr; i++) {
+		if (!zswap_load_page(folio, folio_page(folio, i), tree,
+				     offset + i)) {
+			/* the folio stays !uptodate and the fault fails */
+			WARN_ON_ONCE(1);
+			folio_unlock(folio);
+			return true;
+		}
+	}
+
+	return true;
+}
+
 void zswap_invalidate(int type, pgoff_t offset)
 {
 	struct zswap_tree *tree = zswap_trees[type];
@@ -1567,6 +1910,12 @@ static int zswap_debugfs_init(void)
 				zswap_debugfs_root, &zswap_stored_pages);
 	debugfs_create_atomic_t("same_filled_pages", 0444,
 				zswap_debugfs_root, &zswap_same_filled_pages);
+	debugfs_create_u64("demoted_pages", 0444,
+			   zswap_debugfs_root, &zswap_demoted_pages);
+	debugfs_create_u64("demote_hit", 0444,
+			   zswap_debugfs_root, &zswap_demote_hit);
+	debugfs_create_u64("demote_miss", 0444,
+			   zswap_debugfs_root, &zswap_demote_miss);
 
 	return 0;
 }
@@ -1623,6 +1972,9 @@ static int zswap_setup(void)
 	if (zswap_debugfs_init())
 		pr_warn("debugfs initialization failed\n");
 	zswap_init_state = ZSWAP_INIT_SUCCEED;
+	if (zswap_demote_interval_ms)
+		queue_delayed_work(system_unbound_wq, &zswap_demote_work,
+				   msecs_to_jiffies(zswap_demote_interval_ms));
 	return 0;
 
 fallback_fail:
@@ -78,6 +78,7 @@
 #include <linux/slab.h>
 #include <linux/sched.h>
 #include <linux/sched/mm.h>
+#include <linux/sched/topology.h>
 #include <linux/mutex.h>
 #include <linux/rwsem.h>
 #include <linux/string.h>
@@ -4412,7 +4413,7 @@ int __dev_queue_xmit(struct sk_buff *skb, struct net_device *sb_dev)
 }
 EXPORT_SYMBOL(__dev_queue_xmit);
 
-int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id)
+int __dev_direct_xmit_more(struct sk_buff *skb, u16 queue_id, bool more)
 {
 	struct net_device *dev = skb->dev;
 	struct sk_buff *orig_skb = skb;
@@ -4436,7 +4437,7 @@ int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id)
 	dev_xmit_recursion_inc();
 	HARD_TX_LOCK(dev, txq, smp_processor_id());
 	if (!netif_xmit_frozen_or_drv_stopped(txq))
-		ret = netdev_start_xmit(skb, dev, txq, false);
+		ret = netdev_start_xmit(skb, dev, txq, more);
 	HARD_TX_UNLOCK(dev, txq);
 	dev_xmit_recursion_dec();
 
@@ -4447,6 +4448,12 @@ int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id)
 	kfree_skb_list(skb);
 	return NET_XMIT_DROP;
 }
+EXPORT_SYMBOL(__dev_direct_xmit_more);
+
+int __dev_direct_xmit(struct sk_buff *skb, u16 queue_id)
+{
+	return __dev_direct_xmit_more(skb, queue_id, false);
+}
 EXPORT_SYMBOL(__dev_direct_xmit);
 
 /*************************************************************************
@@ -4518,6 +4525,54 @@ EXPORT_SYMBOL(rps_needed);
 struct static_key_false rfs_needed __read_mostly;
 EXPORT_SYMBOL(rfs_needed);
 
+/* Steer RPS flows away from CPUs that are out of capacity */
+int netdev_rps_capacity_aware __read_mostly;
+
+static bool rps_cpu_overloaded(int cpu)
+{
+	struct softnet_data *sd = &per_cpu(softnet_data, cpu);
+
+	if (skb_queue_len_lockless(&sd->input_pkt_queue) >
+	    READ_ONCE(netdev_max_backlog) / 2)
+		return true;
+
+	/* More than ~80% of its capacity in use */
+	return sched_cpu_util(cpu) * 5 > arch_scale_cpu_capacity(cpu) * 4;
+}
+
+/* Spare capacity of @cpu. Waking an idle CPU costs exit latency and
+ * power, so its spare capacity only counts for half: a deeply idle big
+ * core is chosen only if the running candidate is clearly short.
+ */
+static long rps_cpu_headroom(int cpu)
+{
+	long spare = arch_scale_cpu_capacity(cpu) - sched_cpu_util(cpu);
+
+	return idle_cpu(cpu) ? spare / 2 : spare;
+}
+
+/* Pick between the hashed CPU of the flow and a second candidate derived
+ * from the same hash. The hashed CPU wins unless it is overloaded.
+ */
+static u32 rps_capacity_select_cpu(const struct rps_map *map, u32 hash)
+{
+	u32 idx = reciprocal_scale(hash, map->len);
+	u32 alt = reciprocal_scale(ror32(hash, 16), map->len);
+	u32 a, b;
+
+	if (alt == idx)
+		alt = (idx + 1) % map->len;
+	a = map->cpus[idx];
+	b = map->cpus[alt];
+
+	if (!cpu_online(a))
+		return b;
+	if (!cpu_online(b) || !rps_cpu_overloaded(a))
+		return a;
+
+	return rps_cpu_headroom(b) > rps_cpu_headroom(a) ? b : a;
+}
+
 static struct rps_dev_flow *
 set_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 	    struct rps_dev_flow *rflow, u16 next_cpu)
@@ -4653,6 +4708,36 @@ static int get_rps_cpu(struct net_device *dev, struct sk_buff *skb,
 
 try_rps:
 
+	if (map && flow_table && map->len > 1 &&
+	    READ_ONCE(netdev_rps_capacity_aware)) {
+		struct rps_dev_flow *rflow;
+
+		/* The flow table records where the flow went last, so the
+		 * flow keeps its CPU and only moves once its packets queued
+		 * on the old CPU have been processed.
+		 */
+		rflow = &flow_table->flows[hash & flow_table->mask];
+		tcpu = rflow->cpu;
+		if (tcpu >= nr_cpu_ids || !cpu_online(tcpu) ||
+		    ((int)(per_cpu(softnet_data, tcpu).input_queue_head -
+			   rflow->last_qtail) >= 0 && rps_cpu_overloaded(tcpu))) {
+			u32 next_cpu = rps_capacity_select_cpu(map, hash);
+
+			if (next_cpu != tcpu) {
+				if (tcpu < nr_cpu_ids)
+					this_cpu_inc(softnet_data.rps_rebalanced);
+				tcpu = next_cpu;
+				rflow = set_rps_cpu(dev, skb, rflow, next_cpu);
+			}
+		}
+
+		if (cpu_online(tcpu)) {
+			*rflowp = rflow;
+			cpu = tcpu;
+			goto done;
+		}
+	}
+
 	if (map) {
 		tcpu = map->cpus[reciprocal_scale(hash, map->len)];
 		if (cpu_online(tcpu)) {
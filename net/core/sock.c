@@ -286,6 +286,7 @@ EXPORT_SYMBOL(sysctl_rmem_max);
 __u32 sysctl_wmem_default __read_mostly = SK_WMEM_MAX;
 __u32 sysctl_rmem_default __read_mostly = SK_RMEM_MAX;
 int sysctl_mem_pcpu_rsv __read_mostly = SK_MEMORY_PCPU_RESERVE;
+int sysctl_mem_cgroup_charge_batch __read_mostly = SK_MEMCG_CHARGE_BATCH;
 
 /* Maximal space eaten by iovec or ancillary data plus some space */
 int sysctl_optmem_max __read_mostly = sizeof(unsigned long)*(2*UIO_MAXIOV+512);
@@ -2132,6 +2133,9 @@ static void sk_prot_free(struct proto *prot, struct sock *sk)
 	slab = prot->slab;
 
 	cgroup_sk_free(&sk->sk_cgrp_data);
+	if (mem_cgroup_sockets_enabled && sk->sk_memcg &&
+	    sk->sk_memcg_reserve)
+		mem_cgroup_uncharge_skmem(sk->sk_memcg, sk->sk_memcg_reserve);
 	mem_cgroup_sk_free(sk);
 	trace_android_vh_sk_free(sk);
 	security_sk_free(sk);
@@ -2357,6 +2361,7 @@ struct sock *sk_clone_lock(const struct sock *sk, const gfp_t priority)
 
 	/* sk->sk_memcg will be populated at accept() time */
 	newsk->sk_memcg = NULL;
+	newsk->sk_memcg_reserve = 0;
 
 	cgroup_sk_clone(&newsk->sk_cgrp_data);
 
@@ -3048,6 +3053,48 @@ int sk_wait_data(struct sock *sk, long *timeo, const struct sk_buff *skb)
 }
 EXPORT_SYMBOL(sk_wait_data);
 
+/* Socket memory is charged to sk->sk_memcg in batches: a charge that can't
+ * be served from sk->sk_memcg_reserve takes sysctl_mem_cgroup_charge_batch
+ * extra pages, and uncharges refill the reserve, only handing pages back to
+ * the memcg once it holds twice the batch or the memcg is under pressure.
+ * This keeps the page counters out of the per-skb schedule/reclaim cycle.
+ * Serialised by whatever serialises sk_forward_alloc updates.
+ */
+static bool sk_memcg_charge(struct sock *sk, int amt, gfp_t gfp_mask)
+{
+	int batch = READ_ONCE(sysctl_mem_cgroup_charge_batch);
+	int need;
+
+	if (sk->sk_memcg_reserve >= amt) {
+		sk->sk_memcg_reserve -= amt;
+		return true;
+	}
+
+	need = amt - sk->sk_memcg_reserve;
+	if (batch && mem_cgroup_charge_skmem(sk->sk_memcg, need + batch,
+					     gfp_mask & ~__GFP_NOFAIL)) {
+		sk->sk_memcg_reserve = batch;
+		return true;
+	}
+
+	return mem_cgroup_charge_skmem(sk->sk_memcg, amt, gfp_mask);
+}
+
+static void sk_memcg_uncharge(struct sock *sk, int amt)
+{
+	int batch = READ_ONCE(sysctl_mem_cgroup_charge_batch);
+	int reserve = sk->sk_memcg_reserve + amt;
+
+	if (mem_cgroup_under_socket_pressure(sk->sk_memcg))
+		batch = 0;
+
+	if (reserve > 2 * batch) {
+		mem_cgroup_uncharge_skmem(sk->sk_memcg, reserve - batch);
+		reserve = batch;
+	}
+	sk->sk_memcg_reserve = reserve;
+}
+
 /**
  *	__sk_mem_raise_allocated - increase memory_allocated
  *	@sk: socket
@@ -3067,8 +3114,7 @@ int __sk_mem_raise_allocated(struct sock *sk, int size, int amt, int kind)
 	sk_memory_allocated_add(sk, amt);
 	allocated = sk_memory_allocated(sk);
 	if (memcg_charge &&
-	    !(charged = mem_cgroup_charge_skmem(sk->sk_memcg, amt,
-						gfp_memcg_charge())))
+	    !(charged = sk_memcg_charge(sk, amt, gfp_memcg_charge())))
 		goto suppress_allocation;
 
 	/* Under limit. */
@@ -3125,8 +3171,8 @@ int __sk_mem_raise_allocated(struct sock *sk, int size, int amt, int kind)
 		if (sk->sk_wmem_queued + size >= sk->sk_sndbuf) {
 			/* Force charge with __GFP_NOFAIL */
 			if (memcg_charge && !charged) {
-				mem_cgroup_charge_skmem(sk->sk_memcg, amt,
-					gfp_memcg_charge() | __GFP_NOFAIL);
+				sk_memcg_charge(sk, amt,
+						gfp_memcg_charge() | __GFP_NOFAIL);
 			}
 			return 1;
 		}
@@ -3138,7 +3184,7 @@ int __sk_mem_raise_allocated(struct sock *sk, int size, int amt, int kind)
 	sk_memory_allocated_sub(sk, amt);
 
 	if (memcg_charge && charged)
-		mem_cgroup_uncharge_skmem(sk->sk_memcg, amt);
+		sk_memcg_uncharge(sk, amt);
 
 	return 0;
 }
@@ -3177,7 +3223,7 @@ void __sk_mem_reduce_allocated(struct sock *sk, int amount)
 	sk_memory_allocated_sub(sk, amount);
 
 	if (mem_cgroup_sockets_enabled && sk->sk_memcg)
-		mem_cgroup_uncharge_skmem(sk->sk_memcg, amount);
+		sk_memcg_uncharge(sk, amount);
 
 	if (sk_under_global_memory_pressure(sk) &&
 	    (sk_memory_allocated(sk) < sk_prot_mem_limits(sk, 0)))
@@ -169,6 +169,8 @@ static const struct snmp_mib snmp4_udp_list[] = {
 	SNMP_MIB_ITEM("InCsumErrors", UDP_MIB_CSUMERRORS),
 	SNMP_MIB_ITEM("IgnoredMulti", UDP_MIB_IGNOREDMULTI),
 	SNMP_MIB_ITEM("MemErrors", UDP_MIB_MEMERRORS),
+	SNMP_MIB_ITEM("GroPkts", UDP_MIB_GROPKTS),
+	SNMP_MIB_ITEM("GroSegs", UDP_MIB_GROSEGS),
 	SNMP_MIB_SENTINEL
 };
 
@@ -3077,6 +3077,8 @@ int tcp_disconnect(struct sock *sk, int flags)
 	tp->duplicate_sack[0].start_seq = 0;
 	tp->duplicate_sack[0].end_seq = 0;
 	tp->dsack_dups = 0;
+	tp->pacing_burst_ns = 0;
+	tp->pacing_bursts = 0;
 	tp->reord_seen = 0;
 	tp->retrans_out = 0;
 	tp->sacked_out = 0;
@@ -3848,6 +3850,7 @@ void tcp_get_info(struct sock *sk, struct tcp_info *info)
 	info->tcpi_snd_wnd = tp->snd_wnd;
 	info->tcpi_rcv_wnd = tp->rcv_wnd;
 	info->tcpi_rehash = tp->plb_rehash + tp->timeout_rehash;
+	info->tcpi_pacing_bursts = tp->pacing_bursts;
 	info->tcpi_fastopen_client_fail = tp->fastopen_client_fail;
 	unlock_sock_fast(sk, slow);
 }
@@ -48,6 +48,28 @@
 #include <trace/events/tcp.h>
 #include <trace/hooks/net.h>
 
+/* When non zero, paced packets are released in bursts aligned to intervals
+ * of this many usec instead of one by one.
+ */
+int sysctl_tcp_pacing_burst_us __read_mostly;
+
+/* Round a pacing departure time down to the start of its burst interval.
+ * Everything due within one interval then leaves back to back, so that
+ * radios with DRX power states can sleep between bursts. The average
+ * pacing rate, and thus the congestion control model, is unchanged.
+ */
+static u64 tcp_pacing_burst_start(u64 tstamp)
+{
+	u32 burst_us = READ_ONCE(sysctl_tcp_pacing_burst_us);
+	u32 rem;
+
+	if (!burst_us)
+		return tstamp;
+
+	div_u64_rem(tstamp, burst_us * NSEC_PER_USEC, &rem);
+	return tstamp - rem;
+}
+
 /* Refresh clocks of a TCP socket,
  * ensuring monotically increasing values.
  */
@@ -1264,7 +1286,19 @@ static int __tcp_transmit_skb(struct sock *sk, struct sk_buff *skb,
 	tp = tcp_sk(sk);
 	prior_wstamp = tp->tcp_wstamp_ns;
 	tp->tcp_wstamp_ns = max(tp->tcp_wstamp_ns, tp->tcp_clock_cache);
-	skb_set_delivery_time(skb, tp->tcp_wstamp_ns, true);
+	if (sk->sk_pacing_status != SK_PACING_NONE &&
+	    READ_ONCE(sysctl_tcp_pacing_burst_us)) {
+		u64 burst = tcp_pacing_burst_start(tp->tcp_wstamp_ns);
+
+		if (burst != tp->pacing_burst_ns) {
+			tp->pacing_burst_ns = burst;
+			tp->pacing_bursts++;
+		}
+		skb_set_delivery_time(skb, max(burst, tp->tcp_clock_cache),
+				      true);
+	} else {
+		skb_set_delivery_time(skb, tp->tcp_wstamp_ns, true);
+	}
 	if (clone_it) {
 		oskb = skb;
 
@@ -2531,16 +2565,18 @@ static int tcp_mtu_probe(struct sock *sk)
 static bool tcp_pacing_check(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
+	u64 tstamp;
 
 	if (!tcp_needs_internal_pacing(sk))
 		return false;
 
-	if (tp->tcp_wstamp_ns <= tp->tcp_clock_cache)
+	tstamp = tcp_pacing_burst_start(tp->tcp_wstamp_ns);
+	if (tstamp <= tp->tcp_clock_cache)
 		return false;
 
 	if (!hrtimer_is_queued(&tp->pacing_timer)) {
 		hrtimer_start(&tp->pacing_timer,
-			      ns_to_ktime(tp->tcp_wstamp_ns),
+			      ns_to_ktime(tstamp),
 			      HRTIMER_MODE_ABS_PINNED_SOFT);
 		sock_hold(sk);
 	}
@@ -126,6 +126,12 @@ EXPORT_SYMBOL(udp_table);
 long sysctl_udp_mem[3] __read_mostly;
 EXPORT_SYMBOL(sysctl_udp_mem);
 
+/* Look up the destination socket in GRO so that connected sockets get
+ * fraglist aggregation even when no UDP tunnel is configured.
+ */
+int sysctl_udp_gro_auto __read_mostly;
+int sysctl_udp_gro_max_segs __read_mostly = UDP_GRO_CNT_MAX;
+
 atomic_long_t udp_memory_allocated ____cacheline_aligned_in_smp;
 EXPORT_SYMBOL(udp_memory_allocated);
 DEFINE_PER_CPU(int, udp_memory_per_cpu_fw_alloc);
@@ -2200,6 +2206,14 @@ static int udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	struct sk_buff *next, *segs;
 	int ret;
 
+	if (skb_is_gso(skb) && skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		int is_udplite = IS_UDPLITE(sk);
+
+		__UDP_INC_STATS(sock_net(sk), UDP_MIB_GROPKTS, is_udplite);
+		__UDP_ADD_STATS(sock_net(sk), UDP_MIB_GROSEGS,
+				skb_shinfo(skb)->gso_segs, is_udplite);
+	}
+
 	if (likely(!udp_unexpected_gso(sk, skb)))
 		return udp_queue_rcv_one_skb(sk, skb);
 
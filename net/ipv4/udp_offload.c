@@ -478,8 +478,6 @@ static int skb_gro_receive_list(struct sk_buff *p, struct sk_buff *skb)
 	return 0;
 }
 
-
-#define UDP_GRO_CNT_MAX 64
 static struct sk_buff *udp_gro_receive_segment(struct list_head *head,
 					       struct sk_buff *skb)
 {
@@ -551,7 +549,7 @@ static struct sk_buff *udp_gro_receive_segment(struct list_head *head,
 		}
 
 		if (ret || ulen != ntohs(uh2->len) ||
-		    NAPI_GRO_CB(p)->count >= UDP_GRO_CNT_MAX)
+		    NAPI_GRO_CB(p)->count >= READ_ONCE(sysctl_udp_gro_max_segs))
 			pp = p;
 
 		return pp;
@@ -585,6 +583,13 @@ struct sk_buff *udp_gro_receive(struct list_head *head, struct sk_buff *skb,
 
 		if (skb->dev->features & NETIF_F_GRO_FRAGLIST)
 			NAPI_GRO_CB(skb)->is_flist = sk ? !udp_test_bit(GRO_ENABLED, sk) : 1;
+		else if (sk && sk->sk_state == TCP_ESTABLISHED &&
+			 !udp_test_bit(GRO_ENABLED, sk) &&
+			 READ_ONCE(sysctl_udp_gro_auto))
+			/* Connected flow, e.g. QUIC: batch the stack traversal
+			 * and split back into datagrams at the socket.
+			 */
+			NAPI_GRO_CB(skb)->is_flist = 1;
 
 		if ((!sk && (skb->dev->features & NETIF_F_GRO_UDP_FWD)) ||
 		    (sk && udp_test_bit(GRO_ENABLED, sk)) || NAPI_GRO_CB(skb)->is_flist)
@@ -668,7 +673,8 @@ struct sk_buff *udp4_gro_receive(struct list_head *head, struct sk_buff *skb)
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 0;
 
-	if (static_branch_unlikely(&udp_encap_needed_key))
+	if (static_branch_unlikely(&udp_encap_needed_key) ||
+	    READ_ONCE(sysctl_udp_gro_auto))
 		sk = udp4_gro_lookup_skb(skb, uh->source, uh->dest);
 
 	pp = udp_gro_receive(head, skb, uh, sk);
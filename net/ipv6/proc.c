@@ -129,6 +129,8 @@ static const struct snmp_mib snmp6_udp6_list[] = {
 	SNMP_MIB_ITEM("Udp6InCsumErrors", UDP_MIB_CSUMERRORS),
 	SNMP_MIB_ITEM("Udp6IgnoredMulti", UDP_MIB_IGNOREDMULTI),
 	SNMP_MIB_ITEM("Udp6MemErrors", UDP_MIB_MEMERRORS),
+	SNMP_MIB_ITEM("Udp6GroPkts", UDP_MIB_GROPKTS),
+	SNMP_MIB_ITEM("Udp6GroSegs", UDP_MIB_GROSEGS),
 	SNMP_MIB_SENTINEL
 };
 
@@ -141,6 +143,8 @@ static const struct snmp_mib snmp6_udplite6_list[] = {
 	SNMP_MIB_ITEM("UdpLite6SndbufErrors", UDP_MIB_SNDBUFERRORS),
 	SNMP_MIB_ITEM("UdpLite6InCsumErrors", UDP_MIB_CSUMERRORS),
 	SNMP_MIB_ITEM("UdpLite6MemErrors", UDP_MIB_MEMERRORS),
+	SNMP_MIB_ITEM("UdpLite6GroPkts", UDP_MIB_GROPKTS),
+	SNMP_MIB_ITEM("UdpLite6GroSegs", UDP_MIB_GROSEGS),
 	SNMP_MIB_SENTINEL
 };
 
@@ -777,6 +777,14 @@ static int udpv6_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	struct sk_buff *next, *segs;
 	int ret;
 
+	if (skb_is_gso(skb) && skb_shinfo(skb)->gso_type & SKB_GSO_UDP_L4) {
+		int is_udplite = IS_UDPLITE(sk);
+
+		__UDP6_INC_STATS(sock_net(sk), UDP_MIB_GROPKTS, is_udplite);
+		__UDP6_ADD_STATS(sock_net(sk), UDP_MIB_GROSEGS,
+				 skb_shinfo(skb)->gso_segs, is_udplite);
+	}
+
 	if (likely(!udp_unexpected_gso(sk, skb)))
 		return udpv6_queue_rcv_one_skb(sk, skb);
 
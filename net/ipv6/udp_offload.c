@@ -151,7 +151,8 @@ struct sk_buff *udp6_gro_receive(struct list_head *head, struct sk_buff *skb)
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 1;
 
-	if (static_branch_unlikely(&udpv6_encap_needed_key))
+	if (static_branch_unlikely(&udpv6_encap_needed_key) ||
+	    READ_ONCE(sysctl_udp_gro_auto))
 		sk = udp6_gro_lookup_skb(skb, uh->source, uh->dest);
 
 	pp = udp_gro_receive(head, skb, uh, sk);
@@ -505,11 +505,71 @@ u32 nf_ct_get_id(const struct nf_conn *ct)
 }
 EXPORT_SYMBOL_GPL(nf_ct_get_id);
 
+/* Small direct-mapped per-cpu cache of recently found conntracks, indexed
+ * by the raw tuple hash.  A hit is revalidated exactly like a hash table
+ * hit (refcount, then key recheck), so a stale or foreign-cpu entry is
+ * harmless as long as the object is still a conntrack.  To keep that
+ * true across SLAB_TYPESAFE_BY_RCU frees, clean_from_lists() evicts a
+ * conntrack from every cpu's cache once it has been marked dying.
+ */
+#define NF_CT_PCPU_CACHE_SIZE	64
+
+struct nf_ct_pcpu_cache {
+	struct nf_conntrack_tuple_hash	*h[NF_CT_PCPU_CACHE_SIZE];
+	unsigned int			hit;
+	unsigned int			miss;
+};
+
+static DEFINE_PER_CPU(struct nf_ct_pcpu_cache, nf_ct_pcpu_cache);
+
+/* Entries are keyed by the lookup hash, which only matches the hash of
+ * the found direction when both directions share a zone id.
+ */
+static bool nf_ct_pcpu_cacheable(const struct nf_conntrack_zone *zone)
+{
+	return nf_ct_zone_id(zone, IP_CT_DIR_ORIGINAL) ==
+	       nf_ct_zone_id(zone, IP_CT_DIR_REPLY);
+}
+
+static void nf_ct_pcpu_cache_evict_hash(struct nf_conntrack_tuple_hash *h,
+					u32 hash)
+{
+	unsigned int slot = hash % NF_CT_PCPU_CACHE_SIZE;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct nf_ct_pcpu_cache *cache = per_cpu_ptr(&nf_ct_pcpu_cache, cpu);
+
+		if (READ_ONCE(cache->h[slot]) == h)
+			cmpxchg(&cache->h[slot], h, NULL);
+	}
+}
+
+static void nf_ct_pcpu_cache_evict(struct nf_conn *ct)
+{
+	const struct nf_conntrack_zone *zone = nf_ct_zone(ct);
+	struct net *net = nf_ct_net(ct);
+	int dir;
+
+	/* Pairs with smp_mb() in nf_ct_pcpu_cache_insert(): either we see
+	 * the new entry or the inserter sees IPS_DYING.
+	 */
+	smp_mb();
+
+	for (dir = IP_CT_DIR_ORIGINAL; dir < IP_CT_DIR_MAX; dir++) {
+		struct nf_conntrack_tuple_hash *h = &ct->tuplehash[dir];
+
+		nf_ct_pcpu_cache_evict_hash(h,
+			hash_conntrack_raw(&h->tuple, nf_ct_zone_id(zone, dir), net));
+	}
+}
+
 static void
 clean_from_lists(struct nf_conn *ct)
 {
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_ORIGINAL].hnnode);
 	hlist_nulls_del_rcu(&ct->tuplehash[IP_CT_DIR_REPLY].hnnode);
+	nf_ct_pcpu_cache_evict(ct);
 
 	/* Destroy all pending expectations */
 	nf_ct_remove_expectations(ct);
@@ -769,14 +829,78 @@ ____nf_conntrack_find(struct net *net, const struct nf_conntrack_zone *zone,
 	return NULL;
 }
 
+/* Caller holds a reference on the conntrack owning @h. */
+static void nf_ct_pcpu_cache_insert(struct nf_conntrack_tuple_hash *h,
+				    u32 hash)
+{
+	struct nf_ct_pcpu_cache *cache = raw_cpu_ptr(&nf_ct_pcpu_cache);
+	unsigned int slot = hash % NF_CT_PCPU_CACHE_SIZE;
+
+	WRITE_ONCE(cache->h[slot], h);
+
+	/* Pairs with smp_mb() in nf_ct_pcpu_cache_evict() */
+	smp_mb();
+	if (unlikely(nf_ct_is_dying(nf_ct_tuplehash_to_ctrack(h))))
+		cmpxchg(&cache->h[slot], h, NULL);
+}
+
+static struct nf_conntrack_tuple_hash *
+nf_ct_pcpu_cache_find_get(struct net *net, const struct nf_conntrack_zone *zone,
+			  const struct nf_conntrack_tuple *tuple, u32 hash)
+{
+	struct nf_ct_pcpu_cache *cache = raw_cpu_ptr(&nf_ct_pcpu_cache);
+	struct nf_conntrack_tuple_hash *h;
+	struct nf_conn *ct;
+
+	h = READ_ONCE(cache->h[hash % NF_CT_PCPU_CACHE_SIZE]);
+	if (!h)
+		goto miss;
+
+	ct = nf_ct_tuplehash_to_ctrack(h);
+	if (nf_ct_is_expired(ct) || nf_ct_is_dying(ct) ||
+	    !refcount_inc_not_zero(&ct->ct_general.use))
+		goto miss;
+
+	/* re-check key after refcount, as for a hash table hit */
+	smp_acquire__after_ctrl_dep();
+
+	if (likely(nf_ct_key_equal(h, tuple, zone, net) &&
+		   !nf_ct_is_dying(ct))) {
+		cache->hit++;
+		return h;
+	}
+
+	nf_ct_put(ct);
+miss:
+	cache->miss++;
+	return NULL;
+}
+
+void nf_conntrack_pcpu_cache_stat(int cpu, unsigned int *hit,
+				  unsigned int *miss)
+{
+	const struct nf_ct_pcpu_cache *cache = per_cpu_ptr(&nf_ct_pcpu_cache, cpu);
+
+	*hit = READ_ONCE(cache->hit);
+	*miss = READ_ONCE(cache->miss);
+}
+EXPORT_SYMBOL_GPL(nf_conntrack_pcpu_cache_stat);
+
 /* Find a connection corresponding to a tuple. */
 static struct nf_conntrack_tuple_hash *
 __nf_conntrack_find_get(struct net *net, const struct nf_conntrack_zone *zone,
 			const struct nf_conntrack_tuple *tuple, u32 hash)
 {
 	struct nf_conntrack_tuple_hash *h;
+	bool cacheable = nf_ct_pcpu_cacheable(zone);
 	struct nf_conn *ct;
 
+	if (cacheable) {
+		h = nf_ct_pcpu_cache_find_get(net, zone, tuple, hash);
+		if (h)
+			return h;
+	}
+
 	h = ____nf_conntrack_find(net, zone, tuple, hash);
 	if (h) {
 		/* We have a candidate that matches the tuple we're interested
@@ -787,8 +911,11 @@ __nf_conntrack_find_get(struct net *net, const struct nf_conntrack_zone *zone,
 			/* re-check key after refcount */
 			smp_acquire__after_ctrl_dep();
 
-			if (likely(nf_ct_key_equal(h, tuple, zone, net)))
+			if (likely(nf_ct_key_equal(h, tuple, zone, net))) {
+				if (cacheable)
+					nf_ct_pcpu_cache_insert(h, hash);
 				return h;
+			}
 
 			/* TYPESAFE_BY_RCU recycled the candidate */
 			nf_ct_put(ct);
@@ -468,6 +468,19 @@ static const struct seq_operations ct_cpu_seq_ops = {
 	.show	= ct_cpu_seq_show,
 };
 
+static int ct_cache_seq_show(struct seq_file *seq, void *v)
+{
+	unsigned int hit, miss;
+	int cpu;
+
+	seq_puts(seq, "hit      miss\n");
+	for_each_possible_cpu(cpu) {
+		nf_conntrack_pcpu_cache_stat(cpu, &hit, &miss);
+		seq_printf(seq, "%08x %08x\n", hit, miss);
+	}
+	return 0;
+}
+
 static int nf_conntrack_standalone_init_proc(struct net *net)
 {
 	struct proc_dir_entry *pde;
@@ -488,8 +501,15 @@ static int nf_conntrack_standalone_init_proc(struct net *net)
 			&ct_cpu_seq_ops, sizeof(struct seq_net_private));
 	if (!pde)
 		goto out_stat_nf_conntrack;
+
+	pde = proc_create_net_single("nf_conntrack_cache", 0444,
+				     net->proc_net_stat, ct_cache_seq_show, NULL);
+	if (!pde)
+		goto out_stat_nf_conntrack_cache;
 	return 0;
 
+out_stat_nf_conntrack_cache:
+	remove_proc_entry("nf_conntrack", net->proc_net_stat);
 out_stat_nf_conntrack:
 	remove_proc_entry("nf_conntrack", net->proc_net);
 out_nf_conntrack:
@@ -498,6 +518,7 @@ static int nf_conntrack_standalone_init_proc(struct net *net)
 
 static void nf_conntrack_standalone_fini_proc(struct net *net)
 {
+	remove_proc_entry("nf_conntrack_cache", net->proc_net_stat);
 	remove_proc_entry("nf_conntrack", net->proc_net_stat);
 	remove_proc_entry("nf_conntrack", net->proc_net);
 }
@@ -33,6 +33,7 @@
 #include "xsk.h"
 
 #define TX_BATCH_SIZE 32
+#define TX_BATCH_MAX 4096
 
 static DEFINE_PER_CPU(struct list_head, xskmap_flush_list);
 
@@ -710,13 +711,38 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 	return ERR_PTR(err);
 }
 
+/* Hand a complete packet to the driver. @more lets the driver defer its
+ * doorbell because another packet follows right away.
+ */
+static int xsk_generic_xmit_skb(struct xdp_sock *xs, struct sk_buff *skb,
+				bool more)
+{
+	int err;
+
+	err = __dev_direct_xmit_more(skb, xs->queue_id, more);
+	if  (err == NETDEV_TX_BUSY) {
+		/* Tell user-space to retry the send */
+		xskq_cons_cancel_n(xs->tx, xsk_get_num_desc(skb));
+		xsk_consume_skb(skb);
+		return -EAGAIN;
+	}
+
+	/* Ignore NET_XMIT_CN as packet might have been sent */
+	if (err == NET_XMIT_DROP) {
+		/* SKB completed but not sent */
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
 static int __xsk_generic_xmit(struct sock *sk)
 {
 	struct xdp_sock *xs = xdp_sk(sk);
-	u32 max_batch = TX_BATCH_SIZE;
+	u32 max_batch = READ_ONCE(xs->max_tx_budget);
+	struct sk_buff *skb, *pending = NULL;
 	bool sent_frame = false;
 	struct xdp_desc desc;
-	struct sk_buff *skb;
 	int err = 0;
 
 	mutex_lock(&xs->mutex);
@@ -736,6 +762,18 @@ static int __xsk_generic_xmit(struct sock *sk)
 			goto out;
 		}
 
+		/* Packets are only batched to the driver while they are single
+		 * buffer, so that a busy queue never has to unwind past a
+		 * partially built skb.
+		 */
+		if (pending && xp_mb_desc(&desc)) {
+			err = xsk_generic_xmit_skb(xs, pending, false);
+			pending = NULL;
+			if (err)
+				goto out;
+			sent_frame = true;
+		}
+
 		/* This is the backpressure mechanism for the Tx path.
 		 * Reserve space in the completion queue and only proceed
 		 * if there is space in it. This avoids having to implement
@@ -759,26 +797,31 @@ static int __xsk_generic_xmit(struct sock *sk)
 			xs->skb = skb;
 			continue;
 		}
+		xs->skb = NULL;
 
-		err = __dev_direct_xmit(skb, xs->queue_id);
-		if  (err == NETDEV_TX_BUSY) {
-			/* Tell user-space to retry the send */
-			xskq_cons_cancel_n(xs->tx, xsk_get_num_desc(skb));
-			xsk_consume_skb(skb);
-			err = -EAGAIN;
-			goto out;
+		/* Send the previous packet now that we know another one
+		 * follows it.
+		 */
+		if (pending) {
+			err = xsk_generic_xmit_skb(xs, pending, true);
+			pending = NULL;
+			if (err) {
+				/* skb's descriptors follow pending's, hand them back too */
+				xskq_cons_cancel_n(xs->tx, xsk_get_num_desc(skb));
+				xsk_consume_skb(skb);
+				goto out;
+			}
+			sent_frame = true;
 		}
+		pending = skb;
+	}
 
-		/* Ignore NET_XMIT_CN as packet might have been sent */
-		if (err == NET_XMIT_DROP) {
-			/* SKB completed but not sent */
-			err = -EBUSY;
-			xs->skb = NULL;
+	if (pending) {
+		err = xsk_generic_xmit_skb(xs, pending, false);
+		pending = NULL;
+		if (err)
 			goto out;
-		}
-
 		sent_frame = true;
-		xs->skb = NULL;
 	}
 
 	if (xskq_has_descs(xs->tx)) {
@@ -788,6 +831,16 @@ static int __xsk_generic_xmit(struct sock *sk)
 	}
 
 out:
+	/* Nothing was consumed after pending on early exits */
+	if (pending) {
+		int ret = xsk_generic_xmit_skb(xs, pending, false);
+
+		if (!ret)
+			sent_frame = true;
+		else if (!err)
+			err = ret;
+	}
+
 	if (sent_frame)
 		if (xsk_tx_writeable(xs))
 			sk->sk_write_space(sk);
@@ -1349,6 +1402,20 @@ static int xsk_setsockopt(struct socket *sock, int level, int optname,
 		mutex_unlock(&xs->mutex);
 		return err;
 	}
+	case XDP_MAX_TX_SKB_BUDGET:
+	{
+		unsigned int budget;
+
+		if (optlen != sizeof(budget))
+			return -EINVAL;
+		if (copy_from_sockptr(&budget, optval, sizeof(budget)))
+			return -EFAULT;
+		if (!budget || budget > TX_BATCH_MAX)
+			return -EINVAL;
+
+		WRITE_ONCE(xs->max_tx_budget, budget);
+		return 0;
+	}
 	default:
 		break;
 	}
@@ -1646,6 +1713,7 @@ static int xsk_create(struct net *net, struct socket *sock, int protocol,
 
 	xs = xdp_sk(sk);
 	xs->state = XSK_READY;
+	xs->max_tx_budget = TX_BATCH_SIZE;
 	mutex_init(&xs->mutex);
 	spin_lock_init(&xs->rx_lock);
 
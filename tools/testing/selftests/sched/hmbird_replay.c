@@ -0,0 +1,559 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay a frame workload under one or more HMBird/sched_ext configurations.
+ *
+ * Every frame the ui thread runs, hands off to a binder server thread which
+ * hands off to a render thread, while background threads keep the machine
+ * busy. The per-stage run times and the number of threads can be taken from
+ * a sched_switch/sched_wakeup trace of the real scenario. Each -c argument is
+ * written to /proc/hmbird_sched/config before its run, so a single invocation
+ * compares configurations over the same workload.
+ *
+ * Reported per run:
+ *  - frames which finished after their period
+ *  - handoff (wakeup to run) latency percentiles of the binder and render
+ *    stages
+ *  - an energy estimate: per-CPU busy time from /proc/stat multiplied by the
+ *    energy model power of the CPU's average frequency from cpufreq stats,
+ *    in energy model power units times seconds
+ *
+ * Example:
+ *   hmbird_replay -f 120 -d 10 -b 4 -e \
+ *	-c "dl_priq_ctrl=0" -c "dl_priq_ctrl=1 ux_inherit_ms=8"
+ */
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../kselftest.h"
+
+#ifndef SCHED_EXT
+#define SCHED_EXT		7
+#endif
+
+#define HMBIRD_CONFIG		"/proc/hmbird_sched/config"
+#define EM_DIR			"/sys/kernel/debug/energy_model"
+#define MAX_CPUS		64
+#define MAX_PSTATES		64
+#define MAX_BG			32
+#define MAX_CONFIGS		8
+#define NSEC_PER_USEC		1000ULL
+#define NSEC_PER_SEC		1000000000ULL
+
+struct stage {
+	const char	*name;
+	unsigned int	run_us;
+	int		futex;		/* handoff word, bumped by the waker */
+	uint64_t	woken_at;	/* CLOCK_MONOTONIC of the last handoff */
+	uint64_t	*lat;		/* handoff latencies in ns */
+	unsigned int	nr_lat;
+	pthread_t	thread;
+	struct stage	*next;
+};
+
+static unsigned int fps = 60;
+static unsigned int duration_s = 5;
+static unsigned int nr_bg = 2;
+static unsigned int bg_run_us = 4000, bg_sleep_us = 1000;
+static bool use_ext;
+static const char *configs[MAX_CONFIGS];
+static int nr_configs;
+
+static struct stage ui = { .name = "ui", .run_us = 2000 };
+static struct stage binder = { .name = "binder", .run_us = 1500 };
+static struct stage render = { .name = "render", .run_us = 4000 };
+
+static volatile bool stop;
+static unsigned int nr_frames, nr_missed;
+static uint64_t frame_start;
+
+static uint64_t now_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* burn @us of CPU time, preemption doesn't count */
+static void spin_us(unsigned int us)
+{
+	uint64_t end = now_ns(CLOCK_THREAD_CPUTIME_ID) + us * NSEC_PER_USEC;
+
+	while (now_ns(CLOCK_THREAD_CPUTIME_ID) < end)
+		;
+}
+
+static void set_policy(void)
+{
+	struct sched_param param = { 0 };
+
+	if (use_ext && sched_setscheduler(0, SCHED_EXT, &param))
+		ksft_print_msg("SCHED_EXT: %s\n", strerror(errno));
+}
+
+static void handoff(struct stage *s)
+{
+	s->woken_at = now_ns(CLOCK_MONOTONIC);
+	__atomic_add_fetch(&s->futex, 1, __ATOMIC_RELEASE);
+	syscall(SYS_futex, &s->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static bool wait_handoff(struct stage *s, int *seen)
+{
+	struct timespec timeout = { .tv_sec = 1 };
+	int val;
+
+	while ((val = __atomic_load_n(&s->futex, __ATOMIC_ACQUIRE)) == *seen) {
+		if (stop)
+			return false;
+		syscall(SYS_futex, &s->futex, FUTEX_WAIT, val, &timeout, NULL, 0);
+	}
+	*seen = val;
+
+	if (s->nr_lat < fps * duration_s)
+		s->lat[s->nr_lat++] = now_ns(CLOCK_MONOTONIC) - s->woken_at;
+	return true;
+}
+
+static void *stage_fn(void *arg)
+{
+	struct stage *s = arg;
+	int seen = 0;
+
+	set_policy();
+	while (wait_handoff(s, &seen)) {
+		spin_us(s->run_us);
+		if (s->next) {
+			handoff(s->next);
+			continue;
+		}
+		/* last stage, the frame is complete */
+		nr_frames++;
+		if (now_ns(CLOCK_MONOTONIC) - frame_start > NSEC_PER_SEC / fps)
+			nr_missed++;
+	}
+	return NULL;
+}
+
+static void *bg_fn(void *arg)
+{
+	set_policy();
+	while (!stop) {
+		spin_us(bg_run_us);
+		usleep(bg_sleep_us);
+	}
+	return NULL;
+}
+
+/* the ui stage is driven by the frame clock instead of a handoff */
+static void run_frames(void)
+{
+	uint64_t period = NSEC_PER_SEC / fps, next = now_ns(CLOCK_MONOTONIC);
+	unsigned int i;
+
+	set_policy();
+	for (i = 0; i < fps * duration_s; i++) {
+		struct timespec ts;
+
+		next += period;
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+		frame_start = now_ns(CLOCK_MONOTONIC);
+		spin_us(ui.run_us);
+		handoff(ui.next);
+	}
+}
+
+/* energy estimate */
+struct pstate {
+	unsigned long	freq;		/* kHz */
+	unsigned long	power;
+};
+
+struct perf_domain {
+	struct pstate	ps[MAX_PSTATES];
+	int		nr_ps;
+};
+
+static struct perf_domain pds[MAX_CPUS];
+static struct perf_domain *cpu_pd[MAX_CPUS];
+static int nr_cpus;
+
+struct cpu_sample {
+	uint64_t	busy;		/* USER_HZ ticks */
+	uint64_t	freq_time[MAX_PSTATES];	/* time_in_state, 10ms units */
+	unsigned long	freq[MAX_PSTATES];
+	int		nr_freq;
+};
+
+static int read_ulong(const char *path, unsigned long *val)
+{
+	FILE *f = fopen(path, "r");
+	int ret;
+
+	if (!f)
+		return -1;
+	ret = fscanf(f, "%lu", val) == 1 ? 0 : -1;
+	fclose(f);
+	return ret;
+}
+
+static int pstate_cmp(const void *a, const void *b)
+{
+	const struct pstate *pa = a, *pb = b;
+
+	return pa->freq < pb->freq ? -1 : pa->freq > pb->freq;
+}
+
+static void load_energy_model(void)
+{
+	struct dirent *pde, *sde;
+	DIR *dir, *sub;
+	char path[768], cpus[128];
+	int nr_pds = 0;
+
+	dir = opendir(EM_DIR);
+	if (!dir)
+		return;
+
+	while ((pde = readdir(dir)) && nr_pds < MAX_CPUS) {
+		struct perf_domain *pd = &pds[nr_pds];
+		char *tok, *save;
+		FILE *f;
+
+		if (strncmp(pde->d_name, "cpu", 3))
+			continue;
+
+		snprintf(path, sizeof(path), EM_DIR "/%s/cpus", pde->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (!fgets(cpus, sizeof(cpus), f))
+			cpus[0] = '\0';
+		fclose(f);
+
+		snprintf(path, sizeof(path), EM_DIR "/%s", pde->d_name);
+		sub = opendir(path);
+		if (!sub)
+			continue;
+		while ((sde = readdir(sub)) && pd->nr_ps < MAX_PSTATES) {
+			struct pstate *ps = &pd->ps[pd->nr_ps];
+
+			if (strncmp(sde->d_name, "ps:", 3))
+				continue;
+			snprintf(path, sizeof(path), EM_DIR "/%s/%s/frequency",
+				 pde->d_name, sde->d_name);
+			if (read_ulong(path, &ps->freq))
+				continue;
+			snprintf(path, sizeof(path), EM_DIR "/%s/%s/power",
+				 pde->d_name, sde->d_name);
+			if (read_ulong(path, &ps->power))
+				continue;
+			pd->nr_ps++;
+		}
+		closedir(sub);
+		qsort(pd->ps, pd->nr_ps, sizeof(pd->ps[0]), pstate_cmp);
+
+		/* "0-3,6" style cpulist */
+		for (tok = strtok_r(cpus, ",\n", &save); tok;
+		     tok = strtok_r(NULL, ",\n", &save)) {
+			int first, last, cpu;
+
+			if (sscanf(tok, "%d-%d", &first, &last) != 2)
+				last = first = atoi(tok);
+			for (cpu = first; cpu <= last && cpu < MAX_CPUS; cpu++)
+				cpu_pd[cpu] = pd;
+		}
+		nr_pds++;
+	}
+	closedir(dir);
+}
+
+static unsigned long pd_power(struct perf_domain *pd, unsigned long freq)
+{
+	int i;
+
+	for (i = 0; i < pd->nr_ps; i++)
+		if (pd->ps[i].freq >= freq)
+			return pd->ps[i].power;
+	return pd->nr_ps ? pd->ps[pd->nr_ps - 1].power : 0;
+}
+
+static void sample_cpus(struct cpu_sample *smp)
+{
+	char line[512], path[128];
+	FILE *f;
+	int cpu;
+
+	memset(smp, 0, sizeof(*smp) * MAX_CPUS);
+
+	f = fopen("/proc/stat", "r");
+	if (f) {
+		while (fgets(line, sizeof(line), f)) {
+			unsigned long long v[8] = { 0 };
+
+			/* skip the aggregate "cpu " line */
+			if (strncmp(line, "cpu", 3) || line[3] == ' ')
+				continue;
+			if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu",
+				   &cpu, &v[0], &v[1], &v[2], &v[3], &v[4],
+				   &v[5], &v[6], &v[7]) != 9 || cpu >= MAX_CPUS)
+				continue;
+			/* user nice system [idle iowait] irq softirq steal */
+			smp[cpu].busy = v[0] + v[1] + v[2] + v[5] + v[6] + v[7];
+			if (cpu >= nr_cpus)
+				nr_cpus = cpu + 1;
+		}
+		fclose(f);
+	}
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		struct cpu_sample *s = &smp[cpu];
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpufreq/stats/time_in_state",
+			 cpu);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		while (s->nr_freq < MAX_PSTATES &&
+		       fscanf(f, "%lu %llu", &s->freq[s->nr_freq],
+			      (unsigned long long *)&s->freq_time[s->nr_freq]) == 2)
+			s->nr_freq++;
+		fclose(f);
+	}
+}
+
+static double estimate_energy(struct cpu_sample *a, struct cpu_sample *b)
+{
+	long hz = sysconf(_SC_CLK_TCK);
+	double energy = 0;
+	int cpu, i;
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		uint64_t total = 0, weighted = 0, dt;
+		unsigned long freq = 0;
+
+		if (!cpu_pd[cpu])
+			continue;
+
+		for (i = 0; i < b[cpu].nr_freq && i < a[cpu].nr_freq; i++) {
+			dt = b[cpu].freq_time[i] - a[cpu].freq_time[i];
+			total += dt;
+			weighted += dt * b[cpu].freq[i];
+		}
+		if (total)
+			freq = weighted / total;
+		else if (b[cpu].nr_freq)
+			freq = b[cpu].freq[b[cpu].nr_freq - 1];
+
+		energy += (double)(b[cpu].busy - a[cpu].busy) / hz *
+			  pd_power(cpu_pd[cpu], freq);
+	}
+
+	return energy;
+}
+
+/* report */
+static int u64_cmp(const void *a, const void *b)
+{
+	const uint64_t *ua = a, *ub = b;
+
+	return *ua < *ub ? -1 : *ua > *ub;
+}
+
+static void report_latency(struct stage *s)
+{
+	uint64_t *l = s->lat;
+	unsigned int n = s->nr_lat;
+
+	if (!n) {
+		ksft_print_msg("  %-8s no samples\n", s->name);
+		return;
+	}
+
+	qsort(l, n, sizeof(l[0]), u64_cmp);
+	ksft_print_msg("  %-8s wakeup latency us p50=%llu p90=%llu p99=%llu max=%llu\n",
+		       s->name,
+		       (unsigned long long)l[n / 2] / NSEC_PER_USEC,
+		       (unsigned long long)l[n * 90 / 100] / NSEC_PER_USEC,
+		       (unsigned long long)l[n * 99 / 100] / NSEC_PER_USEC,
+		       (unsigned long long)l[n - 1] / NSEC_PER_USEC);
+}
+
+/*
+ * The config file takes one "key=value" per line, in a single write, so
+ * turn the space separated -c list into lines.
+ */
+static int apply_config(const char *config)
+{
+	char buf[4096];
+	size_t i, len = strlen(config);
+	ssize_t n;
+	int fd, ret = 0;
+
+	if (len >= sizeof(buf))
+		return -E2BIG;
+	for (i = 0; i < len; i++)
+		buf[i] = config[i] == ' ' || config[i] == '\t' ? '\n' : config[i];
+
+	fd = open(HMBIRD_CONFIG, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	n = write(fd, buf, len);
+	if (n < 0)
+		ret = -errno;
+	else if (n != (ssize_t)len)
+		ret = -EIO;
+	close(fd);
+	return ret;
+}
+
+static int run_once(const char *config)
+{
+	static struct cpu_sample before[MAX_CPUS], after[MAX_CPUS];
+	struct stage *stages[] = { &binder, &render };
+	pthread_t bg[MAX_BG];
+	unsigned int i;
+	int ret;
+
+	if (config) {
+		ret = apply_config(config);
+		if (ret) {
+			ksft_print_msg("%s: %s\n", HMBIRD_CONFIG, strerror(-ret));
+			return ret;
+		}
+	}
+
+	stop = false;
+	nr_frames = nr_missed = 0;
+	ui.next = &binder;
+	binder.next = &render;
+	render.next = NULL;
+	for (i = 0; i < 2; i++) {
+		stages[i]->futex = 0;
+		stages[i]->nr_lat = 0;
+		stages[i]->lat = calloc(fps * duration_s, sizeof(uint64_t));
+		if (!stages[i]->lat)
+			return -ENOMEM;
+		pthread_create(&stages[i]->thread, NULL, stage_fn, stages[i]);
+	}
+	for (i = 0; i < nr_bg; i++)
+		pthread_create(&bg[i], NULL, bg_fn, NULL);
+
+	sample_cpus(before);
+	run_frames();
+	/* let the last frame drain */
+	usleep(NSEC_PER_SEC / fps / NSEC_PER_USEC * 2);
+	sample_cpus(after);
+
+	stop = true;
+	for (i = 0; i < 2; i++) {
+		syscall(SYS_futex, &stages[i]->futex, FUTEX_WAKE, 1, NULL, NULL, 0);
+		pthread_join(stages[i]->thread, NULL);
+	}
+	for (i = 0; i < nr_bg; i++)
+		pthread_join(bg[i], NULL);
+
+	ksft_print_msg("config: %s\n", config ?: "(current)");
+	ksft_print_msg("  frames=%u missed=%u (%.2f%%)\n", nr_frames, nr_missed,
+		       nr_frames ? 100.0 * nr_missed / nr_frames : 0.0);
+	for (i = 0; i < 2; i++) {
+		report_latency(stages[i]);
+		free(stages[i]->lat);
+	}
+	ksft_print_msg("  est_energy=%.1f (EM power x s)\n",
+		       estimate_energy(before, after));
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-f fps] [-d seconds] [-u ui_us] [-s binder_us] [-r render_us]\n"
+		"       [-b nr_bg] [-B bg_run_us:bg_sleep_us] [-e] [-c config]...\n"
+		"  -e  run the workload threads as SCHED_EXT\n"
+		"  -c  \"key=value ...\" written to " HMBIRD_CONFIG " before a run,\n"
+		"      one run per -c, up to %d\n", prog, MAX_CONFIGS);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "f:d:u:s:r:b:B:ec:h")) != -1) {
+		switch (opt) {
+		case 'f':
+			fps = atoi(optarg);
+			break;
+		case 'd':
+			duration_s = atoi(optarg);
+			break;
+		case 'u':
+			ui.run_us = atoi(optarg);
+			break;
+		case 's':
+			binder.run_us = atoi(optarg);
+			break;
+		case 'r':
+			render.run_us = atoi(optarg);
+			break;
+		case 'b':
+			nr_bg = atoi(optarg);
+			break;
+		case 'B':
+			if (sscanf(optarg, "%u:%u", &bg_run_us, &bg_sleep_us) != 2) {
+				usage(argv[0]);
+				return KSFT_FAIL;
+			}
+			break;
+		case 'e':
+			use_ext = true;
+			break;
+		case 'c':
+			if (nr_configs < MAX_CONFIGS)
+				configs[nr_configs++] = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? KSFT_PASS : KSFT_FAIL;
+		}
+	}
+
+	if (!fps || !duration_s || nr_bg > MAX_BG) {
+		usage(argv[0]);
+		return KSFT_FAIL;
+	}
+
+	if (nr_configs && access(HMBIRD_CONFIG, W_OK)) {
+		ksft_print_msg("%s not writable, HMBird missing or not root\n",
+			       HMBIRD_CONFIG);
+		return KSFT_SKIP;
+	}
+
+	load_energy_model();
+
+	if (!nr_configs)
+		return run_once(NULL) ? KSFT_FAIL : KSFT_PASS;
+
+	for (i = 0; i < nr_configs; i++)
+		if (run_once(configs[i]))
+			ret = KSFT_FAIL;
+
+	return ret ?: KSFT_PASS;
+}